@@ -0,0 +1,71 @@
+--
+-- Logical decoding through the SQL interface
+--
+
+-- the xids of the transactions differ from run to run, leave them out
+CREATE FUNCTION slot_changes(name) RETURNS SETOF text LANGUAGE sql AS $$
+    SELECT regexp_replace(data, E'^(BEGIN|COMMIT) [0-9]+$', E'\\1')
+    FROM pg_logical_slot_get_changes($1)
+$$;
+
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'test_decoding');
+
+-- transactions that only change catalogs aren't decoded
+CREATE TABLE replication_example(id serial primary key, somedata int, note text);
+CREATE TABLE replication_nokey(a int, b text);
+SELECT * FROM slot_changes('regression_slot');
+
+-- a table with a primary key logs the old key only if it changes
+INSERT INTO replication_example(somedata, note) VALUES (1, 'one');
+INSERT INTO replication_example(somedata, note) VALUES (2, NULL);
+BEGIN;
+INSERT INTO replication_example(somedata, note) VALUES (3, 'three');
+UPDATE replication_example SET somedata = 10 WHERE id = 1;
+UPDATE replication_example SET id = -2 WHERE id = 2;
+DELETE FROM replication_example WHERE id = 3;
+COMMIT;
+SELECT * FROM slot_changes('regression_slot');
+
+-- a table without one logs the whole old row
+INSERT INTO replication_nokey VALUES (1, 'a'), (2, NULL);
+UPDATE replication_nokey SET b = 'b' WHERE a = 1;
+DELETE FROM replication_nokey WHERE a = 2;
+SELECT * FROM slot_changes('regression_slot');
+
+-- the changes of aborted transactions and subtransactions are dropped
+BEGIN;
+INSERT INTO replication_example(somedata, note) VALUES (4, 'aborted');
+ROLLBACK;
+BEGIN;
+INSERT INTO replication_example(somedata, note) VALUES (5, 'top');
+SAVEPOINT a;
+INSERT INTO replication_example(somedata, note) VALUES (6, 'released');
+RELEASE SAVEPOINT a;
+SAVEPOINT b;
+INSERT INTO replication_example(somedata, note) VALUES (7, 'rolled back');
+ROLLBACK TO SAVEPOINT b;
+SAVEPOINT c;
+UPDATE replication_example SET somedata = 50 WHERE id = 5;
+RELEASE SAVEPOINT c;
+COMMIT;
+SELECT * FROM slot_changes('regression_slot');
+
+-- peeking returns the same changes again, getting them consumes them
+INSERT INTO replication_nokey VALUES (3, 'c');
+SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot');
+SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot');
+SELECT * FROM slot_changes('regression_slot');
+SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot');
+
+-- the calling transaction's own changes aren't committed yet
+BEGIN;
+INSERT INTO replication_nokey VALUES (4, 'd');
+SELECT * FROM slot_changes('regression_slot');
+COMMIT;
+SELECT * FROM slot_changes('regression_slot');
+
+SELECT 'stop' FROM pg_drop_replication_slot('regression_slot');
+
+DROP TABLE replication_example;
+DROP TABLE replication_nokey;
+DROP FUNCTION slot_changes(name);
@@ -0,0 +1,36 @@
+--
+-- Replication slots
+--
+SELECT 'init' FROM pg_create_physical_replication_slot('regression_physical');
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_logical', 'test_decoding');
+
+-- a logical slot belongs to this database, a physical one retains nothing
+-- until a standby first streams through it
+SELECT slot_name, plugin, slot_type, database = current_database() AS this_database,
+    active, restart_lsn IS NOT NULL AS retains_wal,
+    catalog_xmin IS NOT NULL AS retains_rows
+FROM pg_replication_slots ORDER BY slot_name;
+
+-- slot names must be unique and usable as file names
+SELECT pg_create_physical_replication_slot('regression_physical');
+SELECT pg_create_logical_replication_slot('regression_physical', 'test_decoding');
+SELECT pg_create_physical_replication_slot('Regression-Slot');
+SELECT pg_create_physical_replication_slot('');
+
+-- there are only max_replication_slots of them
+SELECT 'init' FROM pg_create_physical_replication_slot('regression_3');
+SELECT 'init' FROM pg_create_physical_replication_slot('regression_4');
+SELECT pg_create_physical_replication_slot('regression_5');
+SELECT 'stop' FROM pg_drop_replication_slot('regression_3');
+SELECT 'stop' FROM pg_drop_replication_slot('regression_4');
+
+-- only logical slots of this database can be decoded; a failed attempt
+-- leaves the slot inactive
+SELECT data FROM pg_logical_slot_get_changes('regression_physical');
+SELECT data FROM pg_logical_slot_get_changes('regression_nonexistent');
+SELECT slot_name, active FROM pg_replication_slots ORDER BY slot_name;
+
+SELECT 'stop' FROM pg_drop_replication_slot('regression_physical');
+SELECT 'stop' FROM pg_drop_replication_slot('regression_logical');
+SELECT pg_drop_replication_slot('regression_logical');
+SELECT count(*) FROM pg_replication_slots;
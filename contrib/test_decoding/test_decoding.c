@@ -0,0 +1,135 @@
+/*-------------------------------------------------------------------------
+ *
+ * test_decoding.c
+ *		  example output plugin for logical decoding
+ *
+ * Emits a line of text for each transaction boundary and each change, with
+ * the columns as name[type]:value.
+ *
+ * Copyright (c) 2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/tuptoaster.h"
+#include "replication/logical.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+PG_MODULE_MAGIC;
+
+extern void _PG_output_plugin_init(OutputPluginCallbacks *cb);
+
+static void decode_begin_txn(LogicalDecodingContext *ctx,
+				 ReorderBufferTXN *txn);
+static void decode_change(LogicalDecodingContext *ctx,
+			  ReorderBufferTXN *txn, Relation relation,
+			  ReorderBufferChange *change);
+static void decode_commit_txn(LogicalDecodingContext *ctx,
+				  ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
+static void tuple_to_stringinfo(StringInfo s, TupleDesc tupdesc,
+					HeapTuple tuple, bool skip_nulls);
+
+
+void
+_PG_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	cb->begin_cb = decode_begin_txn;
+	cb->change_cb = decode_change;
+	cb->commit_cb = decode_commit_txn;
+}
+
+static void
+decode_begin_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	appendStringInfo(ctx->out, "BEGIN %u", txn->xid);
+}
+
+static void
+decode_commit_txn(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+				  XLogRecPtr commit_lsn)
+{
+	appendStringInfo(ctx->out, "COMMIT %u", txn->xid);
+}
+
+/*
+ * Print the columns of a tuple.  Values stored out of line aren't available
+ * to logical decoding, so they are shown as unchanged.
+ */
+static void
+tuple_to_stringinfo(StringInfo s, TupleDesc tupdesc, HeapTuple tuple,
+					bool skip_nulls)
+{
+	int			natt;
+
+	for (natt = 0; natt < tupdesc->natts; natt++)
+	{
+		Form_pg_attribute attr = tupdesc->attrs[natt];
+		Oid			typoutput;
+		bool		typisvarlena;
+		Datum		origval;
+		bool		isnull;
+
+		if (attr->attisdropped || attr->attnum < 0)
+			continue;
+
+		origval = heap_getattr(tuple, natt + 1, tupdesc, &isnull);
+		if (isnull && skip_nulls)
+			continue;
+
+		appendStringInfoChar(s, ' ');
+		appendStringInfoString(s, quote_identifier(NameStr(attr->attname)));
+		appendStringInfo(s, "[%s]:", format_type_be(attr->atttypid));
+
+		if (isnull)
+		{
+			appendStringInfoString(s, "null");
+			continue;
+		}
+
+		getTypeOutputInfo(attr->atttypid, &typoutput, &typisvarlena);
+		if (typisvarlena && VARATT_IS_EXTERNAL(DatumGetPointer(origval)))
+			appendStringInfoString(s, "unchanged-toast-datum");
+		else
+			appendStringInfoString(s, OidOutputFunctionCall(typoutput, origval));
+	}
+}
+
+static void
+decode_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			  Relation relation, ReorderBufferChange *change)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+
+	appendStringInfo(ctx->out, "table %s: ",
+					 quote_qualified_identifier(
+						get_namespace_name(RelationGetNamespace(relation)),
+						RelationGetRelationName(relation)));
+
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+			appendStringInfoString(ctx->out, "INSERT:");
+			tuple_to_stringinfo(ctx->out, tupdesc, change->newtuple, false);
+			break;
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			appendStringInfoString(ctx->out, "UPDATE:");
+			if (change->oldtuple != NULL)
+			{
+				appendStringInfoString(ctx->out, " old-key:");
+				tuple_to_stringinfo(ctx->out, tupdesc, change->oldtuple, true);
+				appendStringInfoString(ctx->out, " new-tuple:");
+			}
+			tuple_to_stringinfo(ctx->out, tupdesc, change->newtuple, false);
+			break;
+		case REORDER_BUFFER_CHANGE_DELETE:
+			appendStringInfoString(ctx->out, "DELETE:");
+			tuple_to_stringinfo(ctx->out, tupdesc, change->oldtuple, true);
+			break;
+	}
+}
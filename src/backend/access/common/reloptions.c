@@ -219,6 +219,17 @@ static relopt_real realRelOpts[] =
 
 static relopt_string stringRelOpts[] =
 {
+	{
+		{
+			"buffering",
+			"Enables buffering build for this GiST index",
+			RELOPT_KIND_GIST
+		},
+		4,
+		false,
+		gistValidateBufferingOption,
+		"auto"
+	},
 	/* list terminator */
 	{{NULL}}
 };
@@ -483,7 +494,7 @@ add_string_reloption(bits32 kinds, char *name, char *desc, char *default_val,
 	if (default_val)
 		default_len = strlen(default_val);
 
-	newoption = palloc0(sizeof(relopt_string) + default_len);
+	newoption = palloc0(sizeof(relopt_string));
 
 	newoption->gen.name = pstrdup(name);
 	if (desc)
@@ -496,13 +507,13 @@ add_string_reloption(bits32 kinds, char *name, char *desc, char *default_val,
 	newoption->validate_cb = validator;
 	if (default_val)
 	{
-		strcpy(newoption->default_val, default_val);
+		newoption->default_val = pstrdup(default_val);
 		newoption->default_len = default_len;
 		newoption->default_isnull = false;
 	}
 	else
 	{
-		newoption->default_val[0] = '\0';
+		newoption->default_val = "";
 		newoption->default_len = 0;
 		newoption->default_isnull = true;
 	}
@@ -153,48 +153,45 @@ dataLocateItem(GinBtree btree, GinBtreeStack *stack)
 }
 
 /*
- * Searches correct position for value on leaf page.
- * Page should be correctly chosen.
+ * Searches for value on leaf page.  Page should be correctly chosen.
  * Returns true if value found on page.
+ *
+ * Leaf pages are compressed, so there is no position to remember: new
+ * items are merged into the page's contents by dataPlaceToPage.
  */
 static bool
 dataLocateLeafItem(GinBtree btree, GinBtreeStack *stack)
 {
 	Page		page = BufferGetPage(stack->buffer);
-	OffsetNumber low,
+	ItemPointer item = btree->items + btree->curitem;
+	ItemPointer items;
+	int			nitems,
+				low,
 				high;
-	int			result;
+	bool		found = false;
 
 	Assert(GinPageIsLeaf(page));
 	Assert(GinPageIsData(page));
 
+	stack->off = InvalidOffsetNumber;
+
 	if (btree->fullScan)
-	{
-		stack->off = FirstOffsetNumber;
 		return TRUE;
-	}
 
-	low = FirstOffsetNumber;
-	high = GinPageGetOpaque(page)->maxoff;
-
-	if (high < low)
-	{
-		stack->off = FirstOffsetNumber;
-		return false;
-	}
-
-	high++;
+	/* decode only the segments that could contain the value */
+	items = GinDataLeafPageGetItems(page, &nitems, item);
 
+	low = 0;
+	high = nitems;
 	while (high > low)
 	{
-		OffsetNumber mid = low + ((high - low) / 2);
-
-		result = compareItemPointers(btree->items + btree->curitem, (ItemPointer) GinDataPageGetItem(page, mid));
+		int			mid = low + ((high - low) / 2);
+		int			result = compareItemPointers(item, items + mid);
 
 		if (result == 0)
 		{
-			stack->off = mid;
-			return true;
+			found = true;
+			break;
 		}
 		else if (result > 0)
 			low = mid + 1;
@@ -202,8 +199,9 @@ dataLocateLeafItem(GinBtree btree, GinBtreeStack *stack)
 			high = mid;
 	}
 
-	stack->off = high;
-	return false;
+	pfree(items);
+
+	return found;
 }
 
 /*
@@ -269,8 +267,8 @@ dataGetLeftMostPage(GinBtree btree, Page page)
 }
 
 /*
- * add ItemPointer or PostingItem to page. data should point to
- * correct value! depending on leaf or non-leaf page
+ * add PostingItem to non-leaf page. data should point to
+ * correct value!
  */
 void
 GinDataPageAddItem(Page page, void *data, OffsetNumber offset)
@@ -278,6 +276,8 @@ GinDataPageAddItem(Page page, void *data, OffsetNumber offset)
 	OffsetNumber maxoff = GinPageGetOpaque(page)->maxoff;
 	char	   *ptr;
 
+	Assert(!GinPageIsLeaf(page));
+
 	if (offset == InvalidOffsetNumber)
 	{
 		ptr = GinDataPageGetItem(page, maxoff + 1);
@@ -286,13 +286,153 @@ GinDataPageAddItem(Page page, void *data, OffsetNumber offset)
 	{
 		ptr = GinDataPageGetItem(page, offset);
 		if (maxoff + 1 - offset != 0)
-			memmove(ptr + GinSizeOfItem(page), ptr, (maxoff - offset + 1) * GinSizeOfItem(page));
+			memmove(ptr + sizeof(PostingItem), ptr, (maxoff - offset + 1) * sizeof(PostingItem));
 	}
-	memcpy(ptr, data, GinSizeOfItem(page));
+	memcpy(ptr, data, sizeof(PostingItem));
 
 	GinPageGetOpaque(page)->maxoff++;
 }
 
+/*
+ * Returns the items of a leaf page as a palloc'd array.
+ *
+ * If advancePast is given, the caller is only interested in items greater
+ * than it, and segments that hold nothing but smaller ones are skipped
+ * without being decoded.  Some items <= advancePast may still be returned.
+ */
+ItemPointer
+GinDataLeafPageGetItems(Page page, int *nitems, ItemPointer advancePast)
+{
+	GinPostingList *segment = GinDataLeafPageGetPostingList(page);
+	char	   *endptr = ((char *) segment) + GinDataLeafPageGetPostingListSize(page);
+
+	Assert(GinPageIsLeaf(page));
+
+	if (advancePast)
+	{
+		while ((char *) segment < endptr)
+		{
+			GinPostingList *next = GinNextPostingListSegment(segment);
+
+			if ((char *) next >= endptr ||
+				compareItemPointers(&next->first, advancePast) > 0)
+				break;
+			segment = next;
+		}
+	}
+
+	if ((char *) segment >= endptr)
+	{
+		*nitems = 0;
+		return (ItemPointer) palloc(sizeof(ItemPointerData));
+	}
+
+	return ginPostingListDecodeAllSegments(segment, endptr - (char *) segment,
+										   nitems);
+}
+
+/*
+ * Compresses as many of the given items as fit in maxsize bytes into a
+ * series of segments at dst, or just measures them if dst is NULL.
+ * Returns the number of items, and the number of bytes used in *size.
+ *
+ * This is deterministic: WAL replay relies on producing exactly the page
+ * that was logged from the same items.
+ */
+static int
+dataLeafEncode(ItemPointerData *items, int nitems, Size maxsize,
+			   char *dst, Size *size)
+{
+	int			nstored = 0;
+
+	*size = 0;
+	while (nstored < nitems && maxsize - *size >= GinPostingListSegmentMinSize)
+	{
+		GinPostingList *segment;
+		int			nwritten;
+
+		segment = ginCompressPostingList(items + nstored, nitems - nstored,
+										 Min(GinPostingListSegmentMaxSize,
+											 maxsize - *size),
+										 &nwritten);
+		if (dst)
+			memcpy(dst + *size, segment, SizeOfGinPostingList(segment));
+		*size += SizeOfGinPostingList(segment);
+		nstored += nwritten;
+		pfree(segment);
+	}
+
+	return nstored;
+}
+
+/*
+ * Replaces the contents of a leaf page with as many of the given items
+ * as can be compressed into maxsize bytes, and returns their number.
+ */
+int
+GinDataLeafPageSetItems(Page page, ItemPointerData *items, int nitems,
+						Size maxsize)
+{
+	int			nstored;
+	Size		size;
+
+	Assert(GinPageIsLeaf(page));
+	Assert(maxsize <= GinDataLeafMaxContentSize);
+
+	nstored = dataLeafEncode(items, nitems, maxsize,
+							 (char *) GinDataLeafPageGetPostingList(page),
+							 &size);
+
+	GinPageGetOpaque(page)->maxoff = nstored;
+	GinDataLeafPageSetPostingListSize(page, size);
+
+	return nstored;
+}
+
+/*
+ * Merges the items of btree->items, starting from curitem, that belong on
+ * leaf page 'page' into the page's items, and saves the result in
+ * btree->leafItems.  At most GinDataLeafMaxNewItems are taken at once, so
+ * that the result always fits on two pages; insertItemPointer comes back
+ * for the rest.
+ */
+#define GinDataLeafMaxNewItems	(GinDataLeafMaxContentSize / 16)
+
+static void
+dataLeafMergeNewItems(GinBtree btree, Page page)
+{
+	ItemPointer newitems = btree->items + btree->curitem;
+	ItemPointer olditems;
+	int			nold;
+	uint32		nnew = Min(btree->nitem - btree->curitem, GinDataLeafMaxNewItems);
+
+	if (!GinPageRightMost(page))
+	{
+		ItemPointer bound = GinDataPageGetRightBound(page);
+		uint32		i;
+
+		for (i = 0; i < nnew; i++)
+		{
+			if (compareItemPointers(newitems + i, bound) > 0)
+				break;
+		}
+		nnew = i;
+	}
+	Assert(nnew > 0);
+
+	olditems = GinDataLeafPageGetItems(page, &nold, NULL);
+
+	btree->leafItems = (ItemPointerData *)
+		palloc(sizeof(ItemPointerData) * (nold + nnew));
+	btree->nleafItems = MergeItemPointers(btree->leafItems,
+										  olditems, nold, newitems, nnew);
+	btree->nleafNew = nnew;
+	btree->leafAppend = (nold == 0 ||
+						 compareItemPointers(newitems, olditems + nold - 1) > 0);
+
+	pfree(olditems);
+}
+
 /*
  * Deletes posting item from non-leaf page
  */
@@ -325,12 +465,14 @@ dataIsEnoughSpace(GinBtree btree, Buffer buf, OffsetNumber off)
 
 	if (GinPageIsLeaf(page))
 	{
-		if (GinPageRightMost(page) && off > GinPageGetOpaque(page)->maxoff)
-		{
-			if ((btree->nitem - btree->curitem) * sizeof(ItemPointerData) <= GinDataPageGetFreeSpace(page))
-				return true;
-		}
-		else if (sizeof(ItemPointerData) <= GinDataPageGetFreeSpace(page))
+		Size		size;
+
+		/* the merged items are used by dataPlaceToPage or dataSplitPage */
+		dataLeafMergeNewItems(btree, page);
+
+		if (dataLeafEncode(btree->leafItems, btree->nleafItems,
+						   GinDataLeafMaxContentSize, NULL, &size) ==
+			btree->nleafItems)
 			return true;
 	}
 	else if (sizeof(PostingItem) <= GinDataPageGetFreeSpace(page))
@@ -365,15 +507,15 @@ dataPrepareData(GinBtree btree, Page page, OffsetNumber off)
 }
 
 /*
- * Places keys to page and fills WAL record. In case leaf page and
- * build mode puts all ItemPointers to page.
+ * Places keys to page and fills WAL record. In case of leaf page merges
+ * the items prepared by dataIsEnoughSpace into the page; the WAL record
+ * carries the new items, and replay repeats the merge.
  */
 static void
 dataPlaceToPage(GinBtree btree, Buffer buf, OffsetNumber off, XLogRecData **prdata)
 {
 	Page		page = BufferGetPage(buf);
 	static XLogRecData rdata[3];
-	int			sizeofitem = GinSizeOfItem(page);
 	static ginxlogInsert data;
 	int			cnt = 0;
 
@@ -400,7 +542,8 @@ dataPlaceToPage(GinBtree btree, Buffer buf, OffsetNumber off, XLogRecData **prda
 	if (data.updateBlkno == InvalidBlockNumber)
 	{
 		rdata[0].buffer = buf;
-		rdata[0].buffer_std = FALSE;
+		/* the unused middle of a compressed leaf page needn't be logged */
+		rdata[0].buffer_std = GinPageIsLeaf(page) ? TRUE : FALSE;
 		rdata[0].data = NULL;
 		rdata[0].len = 0;
 		rdata[0].next = &rdata[1];
@@ -414,41 +557,133 @@ dataPlaceToPage(GinBtree btree, Buffer buf, OffsetNumber off, XLogRecData **prda
 	cnt++;
 
 	rdata[cnt].buffer = InvalidBuffer;
-	rdata[cnt].data = (GinPageIsLeaf(page)) ? ((char *) (btree->items + btree->curitem)) : ((char *) &(btree->pitem));
-	rdata[cnt].len = sizeofitem;
 	rdata[cnt].next = NULL;
 
 	if (GinPageIsLeaf(page))
 	{
-		if (GinPageRightMost(page) && off > GinPageGetOpaque(page)->maxoff)
-		{
-			/* usually, create index... */
-			uint32		savedPos = btree->curitem;
-
-			while (btree->curitem < btree->nitem)
-			{
-				GinDataPageAddItem(page, btree->items + btree->curitem, off);
-				off++;
-				btree->curitem++;
-			}
-			data.nitem = btree->curitem - savedPos;
-			rdata[cnt].len = sizeofitem * data.nitem;
-		}
-		else
-		{
-			GinDataPageAddItem(page, btree->items + btree->curitem, off);
-			btree->curitem++;
-		}
+		int			nstored;
+
+		nstored = GinDataLeafPageSetItems(page, btree->leafItems,
+										  btree->nleafItems,
+										  GinDataLeafMaxContentSize);
+		if (nstored != btree->nleafItems)
+			elog(PANIC, "failed to add items to posting tree leaf page in \"%s\"",
+				 RelationGetRelationName(btree->index));
+
+		data.offset = InvalidOffsetNumber;
+		data.nitem = btree->nleafNew;
+		rdata[cnt].data = (char *) (btree->items + btree->curitem);
+		rdata[cnt].len = sizeof(ItemPointerData) * btree->nleafNew;
+
+		btree->curitem += btree->nleafNew;
+		pfree(btree->leafItems);
+		btree->leafItems = NULL;
 	}
 	else
+	{
+		rdata[cnt].data = (char *) &(btree->pitem);
+		rdata[cnt].len = sizeof(PostingItem);
+
 		GinDataPageAddItem(page, &(btree->pitem), off);
+	}
+}
+
+/*
+ * split leaf page and fills WAL record.  The items prepared by
+ * dataIsEnoughSpace are distributed between the left page, which is
+ * returned as a shadow page of lbuf, and the right page.
+ */
+static Page
+dataSplitLeafPage(GinBtree btree, Buffer lbuf, Buffer rbuf, XLogRecData **prdata)
+{
+	static ginxlogSplit data;
+	static XLogRecData rdata[2];
+	static char vector[2 * BLCKSZ];
+	Page		lpage = PageGetTempPageCopy(BufferGetPage(lbuf));
+	ItemPointerData oldbound = *GinDataPageGetRightBound(lpage);
+	Page		rpage = BufferGetPage(rbuf);
+	Size		pageSize = PageGetPageSize(lpage);
+	ItemPointer items = btree->leafItems;
+	int			nitems = btree->nleafItems;
+	Size		leftsize;
+	int			nleft,
+				nright;
+
+	*prdata = rdata;
+	data.leftChildBlkno = InvalidBlockNumber;
+	data.updateBlkno = InvalidBlockNumber;
+	btree->rightblkno = InvalidBlockNumber;
+
+	/*
+	 * When appending to the rightmost page, which is how the table is
+	 * usually filled, pack the left page full.  Otherwise split in the
+	 * middle.
+	 */
+	if (GinPageRightMost(lpage) && (btree->isBuild || btree->leafAppend))
+		leftsize = GinDataLeafMaxContentSize;
+	else
+	{
+		(void) dataLeafEncode(items, nitems, 2 * BLCKSZ, NULL, &leftsize);
+		leftsize /= 2;
+	}
+
+	GinInitPage(rpage, GinPageGetOpaque(lpage)->flags, pageSize);
+	GinInitPage(lpage, GinPageGetOpaque(rpage)->flags, pageSize);
+
+	nleft = GinDataLeafPageSetItems(lpage, items, nitems, leftsize);
+	nright = GinDataLeafPageSetItems(rpage, items + nleft, nitems - nleft,
+									 GinDataLeafMaxContentSize);
+	if (nleft == 0 || nleft + nright != nitems)
+		elog(ERROR, "failed to split posting tree leaf page in \"%s\"",
+			 RelationGetRelationName(btree->index));
+
+	PostingItemSetBlockNumber(&(btree->pitem), BufferGetBlockNumber(lbuf));
+	btree->pitem.key = items[nleft - 1];
+	btree->rightblkno = BufferGetBlockNumber(rbuf);
+
+	/* set up right bound for left page */
+	*GinDataPageGetRightBound(lpage) = btree->pitem.key;
+
+	/* set up right bound for right page */
+	*GinDataPageGetRightBound(rpage) = oldbound;
+
+	btree->curitem += btree->nleafNew;
+	pfree(btree->leafItems);
+	btree->leafItems = NULL;
+
+	data.node = btree->index->rd_node;
+	data.rootBlkno = InvalidBlockNumber;
+	data.lblkno = BufferGetBlockNumber(lbuf);
+	data.rblkno = BufferGetBlockNumber(rbuf);
+	data.separator = nleft;
+	data.nitem = nitems;
+	data.isData = TRUE;
+	data.isLeaf = TRUE;
+	data.isRootSplit = FALSE;
+	data.rightbound = oldbound;
+	data.lsize = GinDataLeafPageGetPostingListSize(lpage);
+	data.rsize = GinDataLeafPageGetPostingListSize(rpage);
+
+	/* lpage goes away before the record is inserted, so copy the contents */
+	memcpy(vector, GinDataLeafPageGetPostingList(lpage), data.lsize);
+	memcpy(vector + data.lsize, GinDataLeafPageGetPostingList(rpage), data.rsize);
+
+	rdata[0].buffer = InvalidBuffer;
+	rdata[0].data = (char *) &data;
+	rdata[0].len = sizeof(ginxlogSplit);
+	rdata[0].next = &rdata[1];
+
+	rdata[1].buffer = InvalidBuffer;
+	rdata[1].data = vector;
+	rdata[1].len = data.lsize + data.rsize;
+	rdata[1].next = NULL;
+
+	return lpage;
 }
 
 /*
  * split page and fills WAL record. original buffer(lbuf) leaves untouched,
- * returns shadow page of lbuf filled new data. In leaf page and build mode puts all
- * ItemPointers to pages. Also, in build mode splits data by way to full fulled
- * left page
+ * returns shadow page of lbuf filled new data.
  */
 static Page
 dataSplitPage(GinBtree btree, Buffer lbuf, Buffer rbuf, OffsetNumber off, XLogRecData **prdata)
@@ -459,62 +694,36 @@ dataSplitPage(GinBtree btree, Buffer lbuf, Buffer rbuf, OffsetNumber off, XLogRe
 	char	   *ptr;
 	OffsetNumber separator;
 	ItemPointer bound;
-	Page		lpage = PageGetTempPageCopy(BufferGetPage(lbuf));
-	ItemPointerData oldbound = *GinDataPageGetRightBound(lpage);
-	int			sizeofitem = GinSizeOfItem(lpage);
-	OffsetNumber maxoff = GinPageGetOpaque(lpage)->maxoff;
+	Page		lpage;
+	ItemPointerData oldbound;
+	int			sizeofitem = sizeof(PostingItem);
+	OffsetNumber maxoff;
 	Page		rpage = BufferGetPage(rbuf);
-	Size		pageSize = PageGetPageSize(lpage);
-	Size		freeSpace;
-	uint32		nCopied = 1;
+	Size		pageSize;
 
-	GinInitPage(rpage, GinPageGetOpaque(lpage)->flags, pageSize);
-	freeSpace = GinDataPageGetFreeSpace(rpage);
+	if (GinPageIsLeaf(BufferGetPage(lbuf)))
+		return dataSplitLeafPage(btree, lbuf, rbuf, prdata);
+
+	lpage = PageGetTempPageCopy(BufferGetPage(lbuf));
+	oldbound = *GinDataPageGetRightBound(lpage);
+	maxoff = GinPageGetOpaque(lpage)->maxoff;
+	pageSize = PageGetPageSize(lpage);
 
 	*prdata = rdata;
-	data.leftChildBlkno = (GinPageIsLeaf(lpage)) ?
-		InvalidOffsetNumber : PostingItemGetBlockNumber(&(btree->pitem));
+	data.leftChildBlkno = PostingItemGetBlockNumber(&(btree->pitem));
 	data.updateBlkno = dataPrepareData(btree, lpage, off);
 
 	memcpy(vector, GinDataPageGetItem(lpage, FirstOffsetNumber),
 		   maxoff * sizeofitem);
 
-	if (GinPageIsLeaf(lpage) && GinPageRightMost(lpage) && off > GinPageGetOpaque(lpage)->maxoff)
-	{
-		nCopied = 0;
-		while (btree->curitem < btree->nitem && maxoff * sizeof(ItemPointerData) < 2 * (freeSpace - sizeof(ItemPointerData)))
-		{
-			memcpy(vector + maxoff * sizeof(ItemPointerData), btree->items + btree->curitem,
-				   sizeof(ItemPointerData));
-			maxoff++;
-			nCopied++;
-			btree->curitem++;
-		}
-	}
-	else
-	{
-		ptr = vector + (off - 1) * sizeofitem;
-		if (maxoff + 1 - off != 0)
-			memmove(ptr + sizeofitem, ptr, (maxoff - off + 1) * sizeofitem);
-		if (GinPageIsLeaf(lpage))
-		{
-			memcpy(ptr, btree->items + btree->curitem, sizeofitem);
-			btree->curitem++;
-		}
-		else
-			memcpy(ptr, &(btree->pitem), sizeofitem);
+	ptr = vector + (off - 1) * sizeofitem;
+	if (maxoff + 1 - off != 0)
+		memmove(ptr + sizeofitem, ptr, (maxoff - off + 1) * sizeofitem);
+	memcpy(ptr, &(btree->pitem), sizeofitem);
 
-		maxoff++;
-	}
+	maxoff++;
 
-	/*
-	 * we suppose that during index creation table scaned from begin to end,
-	 * so ItemPointers are monotonically increased..
-	 */
-	if (btree->isBuild && GinPageRightMost(lpage))
-		separator = freeSpace / sizeofitem;
-	else
-		separator = maxoff / 2;
+	separator = maxoff / 2;
 
 	GinInitPage(rpage, GinPageGetOpaque(lpage)->flags, pageSize);
 	GinInitPage(lpage, GinPageGetOpaque(rpage)->flags, pageSize);
@@ -526,11 +735,7 @@ dataSplitPage(GinBtree btree, Buffer lbuf, Buffer rbuf, OffsetNumber off, XLogRe
 	GinPageGetOpaque(rpage)->maxoff = maxoff - separator;
 
 	PostingItemSetBlockNumber(&(btree->pitem), BufferGetBlockNumber(lbuf));
-	if (GinPageIsLeaf(lpage))
-		btree->pitem.key = *(ItemPointerData *) GinDataPageGetItem(lpage,
-											GinPageGetOpaque(lpage)->maxoff);
-	else
-		btree->pitem.key = ((PostingItem *) GinDataPageGetItem(lpage,
+	btree->pitem.key = ((PostingItem *) GinDataPageGetItem(lpage,
 									  GinPageGetOpaque(lpage)->maxoff))->key;
 	btree->rightblkno = BufferGetBlockNumber(rbuf);
 
@@ -549,9 +754,10 @@ dataSplitPage(GinBtree btree, Buffer lbuf, Buffer rbuf, OffsetNumber off, XLogRe
 	data.separator = separator;
 	data.nitem = maxoff;
 	data.isData = TRUE;
-	data.isLeaf = GinPageIsLeaf(lpage) ? TRUE : FALSE;
+	data.isLeaf = FALSE;
 	data.isRootSplit = FALSE;
 	data.rightbound = oldbound;
+	data.lsize = data.rsize = 0;
 
 	rdata[0].buffer = InvalidBuffer;
 	rdata[0].data = (char *) &data;
@@ -35,8 +35,9 @@
  *		- ItemPointerGetOffsetNumber(&itup->t_tid) contains number
  *		  of elements in posting list (number of heap itempointers)
  *		  Macros: GinGetNPosting(itup) / GinSetNPosting(itup,n)
- *		- After standard part of tuple there is a posting list, ie, array
- *		  of heap itempointers
+ *		- After standard part of tuple there is a posting list, ie, a
+ *		  compressed list of heap itempointers (see ginpostinglist.c),
+ *		  read by ginReadTuple()
  *		  Macros: GinGetPosting(itup)
  * 2) Posting tree
  *		- itup->t_info & INDEX_SIZE_MASK contains size of tuple as usual
@@ -74,8 +75,15 @@ GinFormTuple(Relation index, GinState *ginstate,
 
 	if (nipd > 0)
 	{
-		newsize = MAXALIGN(SHORTALIGN(IndexTupleSize(itup)) + sizeof(ItemPointerData) * nipd);
-		if (newsize > Min(INDEX_SIZE_MASK, GinMaxItemSize))
+		GinPostingList *plist;
+		int			nwritten;
+
+		Assert(nipd < GIN_TREE_POSTING);
+
+		plist = ginCompressPostingList(ipd, nipd, GinMaxItemSize, &nwritten);
+
+		newsize = MAXALIGN(SHORTALIGN(IndexTupleSize(itup)) + SizeOfGinPostingList(plist));
+		if (nwritten < nipd || newsize > Min(INDEX_SIZE_MASK, GinMaxItemSize))
 		{
 			if (errorTooBig)
 				ereport(ERROR,
@@ -85,6 +93,7 @@ GinFormTuple(Relation index, GinState *ginstate,
 								(unsigned long) Min(INDEX_SIZE_MASK,
 													GinMaxItemSize),
 								RelationGetRelationName(index))));
+			pfree(plist);
 			return NULL;
 		}
 
@@ -94,9 +103,9 @@ GinFormTuple(Relation index, GinState *ginstate,
 		itup->t_info &= ~INDEX_SIZE_MASK;
 		itup->t_info |= newsize;
 
-		if (ipd)
-			memcpy(GinGetPosting(itup), ipd, sizeof(ItemPointerData) * nipd);
+		memcpy(GinGetPosting(itup), plist, SizeOfGinPostingList(plist));
 		GinSetNPosting(itup, nipd);
+		pfree(plist);
 	}
 	else
 	{
@@ -109,7 +118,7 @@ GinFormTuple(Relation index, GinState *ginstate,
 		 * cleanup during vacuum) will form the same tuple with one
 		 * ItemPointer.
 		 */
-		newsize = MAXALIGN(SHORTALIGN(IndexTupleSize(itup)) + sizeof(ItemPointerData));
+		newsize = MAXALIGN(SHORTALIGN(IndexTupleSize(itup)) + GinPostingListSegmentMinSize);
 		if (newsize > Min(INDEX_SIZE_MASK, GinMaxItemSize))
 		{
 			if (errorTooBig)
@@ -129,25 +138,21 @@ GinFormTuple(Relation index, GinState *ginstate,
 }
 
 /*
- * Sometimes we reduce the number of posting list items in a tuple after
- * having built it with GinFormTuple.  This function adjusts the size
- * fields to match.
+ * Decodes the posting list of an entry tree leaf tuple into a palloc'd
+ * array, and returns the number of items in *nitems.
  */
-void
-GinShortenTuple(IndexTuple itup, uint32 nipd)
+ItemPointer
+ginReadTuple(IndexTuple itup, int *nitems)
 {
-	uint32		newsize;
-
-	Assert(nipd <= GinGetNPosting(itup));
-
-	newsize = MAXALIGN(SHORTALIGN(GinGetOrigSizePosting(itup)) + sizeof(ItemPointerData) * nipd);
-
-	Assert(newsize <= (itup->t_info & INDEX_SIZE_MASK));
+	Assert(!GinIsPostingTree(itup));
 
-	itup->t_info &= ~INDEX_SIZE_MASK;
-	itup->t_info |= newsize;
+	if (GinGetNPosting(itup) == 0)
+	{
+		*nitems = 0;
+		return (ItemPointer) palloc(sizeof(ItemPointerData));
+	}
 
-	GinSetNPosting(itup, nipd);
+	return ginPostingListDecode(GinGetPosting(itup), nitems);
 }
 
 /*
@@ -619,14 +624,22 @@ entrySplitPage(GinBtree btree, Buffer lbuf, Buffer rbuf, OffsetNumber off, XLogR
  */
 IndexTuple
 ginPageGetLinkItup(Buffer buf)
+{
+	return ginPageGetLinkItupByPage(BufferGetPage(buf), BufferGetBlockNumber(buf));
+}
+
+/*
+ * Same as above, for a page that isn't in a buffer (yet)
+ */
+IndexTuple
+ginPageGetLinkItupByPage(Page page, BlockNumber blkno)
 {
 	IndexTuple	itup,
 				nitup;
-	Page		page = BufferGetPage(buf);
 
 	itup = getRightMostTuple(page);
 	nitup = copyIndexTuple(itup, page);
-	ItemPointerSet(&nitup->t_tid, BufferGetBlockNumber(buf), InvalidOffsetNumber);
+	ItemPointerSet(&nitup->t_tid, blkno, InvalidOffsetNumber);
 
 	return nitup;
 }
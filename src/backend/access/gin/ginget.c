@@ -34,30 +34,50 @@ typedef struct pendingPosition
 
 
 /*
- * Tries to refind previously taken ItemPointer on page.
+ * Returns the index of the first item in list[offset .. nlist - 1] that is
+ * greater than advancePast, or nlist if there is none.
  */
-static bool
-findItemInPage(Page page, ItemPointer item, OffsetNumber *off)
+static uint32
+listSkipPast(ItemPointerData *list, uint32 offset, uint32 nlist,
+			 ItemPointer advancePast)
 {
-	OffsetNumber maxoff = GinPageGetOpaque(page)->maxoff;
-	int			res;
-
-	if (GinPageGetOpaque(page)->flags & GIN_DELETED)
-		/* page was deleted by concurrent vacuum */
-		return false;
+	uint32		low = offset,
+				high = nlist;
 
-	/*
-	 * scan page to find equal or first greater value
-	 */
-	for (*off = FirstOffsetNumber; *off <= maxoff; (*off)++)
+	while (high > low)
 	{
-		res = compareItemPointers(item, (ItemPointer) GinDataPageGetItem(page, *off));
+		uint32		mid = low + ((high - low) / 2);
 
-		if (res <= 0)
-			return true;
+		if (compareItemPointers(list + mid, advancePast) > 0)
+			high = mid;
+		else
+			low = mid + 1;
 	}
 
-	return false;
+	return low;
+}
+
+/*
+ * Raises *advancePast, if needed, so that a stream positioned at item can
+ * be skipped to it: every item pointer before item is advanced past, except
+ * those on item's heap page when item is a lossy-page pointer.  Since no
+ * stream returns both exact and lossy pointers for the same page, the items
+ * skipped this way cannot match if item's stream has to match.
+ */
+static void
+advancePastBefore(ItemPointer advancePast, ItemPointer item)
+{
+	ItemPointerData before;
+
+	if (ItemPointerIsLossyPage(item))
+		ItemPointerSet(&before, GinItemPointerGetBlockNumber(item),
+					   InvalidOffsetNumber);
+	else
+		ItemPointerSet(&before, GinItemPointerGetBlockNumber(item),
+					   GinItemPointerGetOffsetNumber(item) - 1);
+
+	if (compareItemPointers(&before, advancePast) > 0)
+		*advancePast = before;
 }
 
 /*
@@ -98,6 +118,8 @@ scanForItems(Relation index, GinScanEntry scanEntry, BlockNumber rootPostingTree
 	Buffer		buffer;
 	Page		page;
 	BlockNumber blkno;
+	ItemPointer items;
+	int			nitems;
 
 	gdi = prepareScanPostingTree(index, rootPostingTree, TRUE);
 
@@ -116,10 +138,10 @@ scanForItems(Relation index, GinScanEntry scanEntry, BlockNumber rootPostingTree
 
 		if ((GinPageGetOpaque(page)->flags & GIN_DELETED) == 0 && GinPageGetOpaque(page)->maxoff >= FirstOffsetNumber)
 		{
-			tbm_add_tuples(scanEntry->partialMatch,
-				   (ItemPointer) GinDataPageGetItem(page, FirstOffsetNumber),
-						   GinPageGetOpaque(page)->maxoff, false);
-			scanEntry->predictNumberResult += GinPageGetOpaque(page)->maxoff;
+			items = GinDataLeafPageGetItems(page, &nitems, NULL);
+			tbm_add_tuples(scanEntry->partialMatch, items, nitems, false);
+			scanEntry->predictNumberResult += nitems;
+			pfree(items);
 		}
 
 		blkno = GinPageGetOpaque(page)->rightlink;
@@ -254,8 +276,13 @@ computePartialMatchList(GinBtreeData *btree, GinBtreeStack *stack, GinScanEntry
 		}
 		else
 		{
-			tbm_add_tuples(scanEntry->partialMatch, GinGetPosting(itup), GinGetNPosting(itup), false);
-			scanEntry->predictNumberResult += GinGetNPosting(itup);
+			ItemPointer items;
+			int			nitems;
+
+			items = ginReadTuple(itup, &nitems);
+			tbm_add_tuples(scanEntry->partialMatch, items, nitems, false);
+			scanEntry->predictNumberResult += nitems;
+			pfree(items);
 		}
 
 		/*
@@ -349,6 +376,7 @@ startScanEntry(Relation index, GinState *ginstate, GinScanEntry entry)
 			BlockNumber rootPostingTree = GinGetPostingTree(itup);
 			GinPostingTreeScan *gdi;
 			Page		page;
+			int			nlist;
 
 			/*
 			 * We should unlock entry page before make deal with posting tree
@@ -376,10 +404,8 @@ startScanEntry(Relation index, GinState *ginstate, GinScanEntry entry)
 			/*
 			 * Keep page content in memory to prevent durable page locking
 			 */
-			entry->list = (ItemPointerData *) palloc(BLCKSZ);
-			entry->nlist = GinPageGetOpaque(page)->maxoff;
-			memcpy(entry->list, GinDataPageGetItem(page, FirstOffsetNumber),
-				   GinPageGetOpaque(page)->maxoff * sizeof(ItemPointerData));
+			entry->list = GinDataLeafPageGetItems(page, &nlist, NULL);
+			entry->nlist = nlist;
 
 			LockBuffer(entry->buffer, GIN_UNLOCK);
 			freeGinBtreeStack(gdi->stack);
@@ -388,9 +414,10 @@ startScanEntry(Relation index, GinState *ginstate, GinScanEntry entry)
 		}
 		else if (GinGetNPosting(itup) > 0)
 		{
-			entry->nlist = GinGetNPosting(itup);
-			entry->list = (ItemPointerData *) palloc(sizeof(ItemPointerData) * entry->nlist);
-			memcpy(entry->list, GinGetPosting(itup), sizeof(ItemPointerData) * entry->nlist);
+			int			nlist;
+
+			entry->list = ginReadTuple(itup, &nlist);
+			entry->nlist = nlist;
 			entry->isFinished = FALSE;
 		}
 	}
@@ -400,8 +427,97 @@ startScanEntry(Relation index, GinState *ginstate, GinScanEntry entry)
 	freeGinBtreeStack(stackEntry);
 }
 
+/* convenience function for invoking a key's consistentFn */
+static inline bool
+callConsistentFn(GinState *ginstate, GinScanKey key)
+{
+	/*
+	 * Initialize recheckCurItem in case the consistentFn doesn't know it
+	 * should set it.  The safe assumption in that case is to force recheck.
+	 */
+	key->recheckCurItem = true;
+
+	return DatumGetBool(FunctionCall6(&ginstate->consistentFn[key->attnum - 1],
+									  PointerGetDatum(key->entryRes),
+									  UInt16GetDatum(key->strategy),
+									  key->query,
+									  UInt32GetDatum(key->nentries),
+									  PointerGetDatum(key->extra_data),
+									  PointerGetDatum(&key->recheckCurItem)));
+}
+
+/*
+ * Keys with more entries than this are scanned without looking for
+ * required entries, as the test below costs 2^(nentries-1) consistentFn
+ * calls per entry.
+ */
+#define GIN_MAX_REQUIRED_CHECK_ENTRIES	8
+
+/*
+ * Find the entries of a key that are required, ie, without which the
+ * consistentFn rejects every combination of the other entries.  For a
+ * query like 'frequent & rare', both are required, and keyGetItem can skip
+ * the frequent entry ahead to the items of the rare one instead of walking
+ * through all of it.
+ *
+ * We probe the consistentFn with all combinations of the other entries,
+ * the most permissive first, so an entry that is not required is usually
+ * recognized by the first call.
+ */
 static void
-startScanKey(Relation index, GinState *ginstate, GinScanKey key)
+setRequiredEntries(GinState *ginstate, MemoryContext tempCtx, GinScanKey key)
+{
+	MemoryContext oldCtx;
+	uint32		ncombos;
+	uint32		i,
+				j;
+
+	key->nrequired = 0;
+	memset(key->entryRequired, FALSE, key->nentries);
+
+	/* with a single entry there is nothing else to skip */
+	if (key->nentries < 2 || key->nentries > GIN_MAX_REQUIRED_CHECK_ENTRIES)
+		return;
+
+	oldCtx = MemoryContextSwitchTo(tempCtx);
+
+	ncombos = 1 << (key->nentries - 1);
+	for (i = 0; i < key->nentries; i++)
+	{
+		bool		required = TRUE;
+		uint32		combo;
+
+		for (combo = 0; combo < ncombos && required; combo++)
+		{
+			uint32		bits = ncombos - 1 - combo;
+			uint32		k = 0;
+
+			for (j = 0; j < key->nentries; j++)
+			{
+				if (j == i)
+					key->entryRes[j] = FALSE;
+				else
+					key->entryRes[j] = (bits & (1 << k++)) ? TRUE : FALSE;
+			}
+
+			if (callConsistentFn(ginstate, key))
+				required = FALSE;
+		}
+
+		if (required)
+		{
+			key->entryRequired[i] = TRUE;
+			key->nrequired++;
+		}
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(tempCtx);
+}
+
+static void
+startScanKey(Relation index, GinState *ginstate, MemoryContext tempCtx,
+			 GinScanKey key)
 {
 	uint32		i;
 
@@ -411,6 +527,8 @@ startScanKey(Relation index, GinState *ginstate, GinScanKey key)
 	for (i = 0; i < key->nentries; i++)
 		startScanEntry(index, ginstate, key->scanEntry + i);
 
+	setRequiredEntries(ginstate, tempCtx, key);
+
 	key->isFinished = FALSE;
 	key->firstCall = FALSE;
 
@@ -443,37 +561,54 @@ startScan(IndexScanDesc scan)
 	GinScanOpaque so = (GinScanOpaque) scan->opaque;
 
 	for (i = 0; i < so->nkeys; i++)
-		startScanKey(scan->indexRelation, &so->ginstate, so->keys + i);
+		startScanKey(scan->indexRelation, &so->ginstate, so->tempCtx,
+					 so->keys + i);
 }
 
 /*
- * Gets next ItemPointer from PostingTree. Note, that we copy
- * page into GinScanEntry->list array and unlock page, but keep it pinned
- * to prevent interference with vacuum
+ * Gets next ItemPointer from PostingTree, skipping any items <= advancePast.
+ * Note, that we decode the page into GinScanEntry->list array and unlock
+ * page, but keep it pinned to prevent interference with vacuum
  */
 static void
-entryGetNextItem(Relation index, GinScanEntry entry)
+entryGetNextItem(Relation index, GinScanEntry entry, ItemPointer advancePast)
 {
 	Page		page;
 	BlockNumber blkno;
+	ItemPointerData skipTo;
+	int			nlist;
 
 	for (;;)
 	{
+		entry->offset = listSkipPast(entry->list, entry->offset, entry->nlist,
+									 advancePast);
 		if (entry->offset < entry->nlist)
 		{
 			entry->curItem = entry->list[entry->offset++];
 			return;
 		}
 
+		/*
+		 * The current page is exhausted.  On the next pages we are only
+		 * interested in items greater than both the last item we returned
+		 * and advancePast.
+		 */
+		if (ItemPointerIsValid(&entry->curItem) &&
+			compareItemPointers(&entry->curItem, advancePast) > 0)
+			skipTo = entry->curItem;
+		else
+			skipTo = *advancePast;
+
 		LockBuffer(entry->buffer, GIN_SHARE);
 		page = BufferGetPage(entry->buffer);
 		for (;;)
 		{
 			/*
-			 * It's needed to go by right link. During that we should refind
-			 * first ItemPointer greater that stored
+			 * It's needed to go by right link.  Pages that were deleted by
+			 * a concurrent vacuum, or whose items are all <= skipTo
+			 * according to their right bound, are stepped over without
+			 * decoding them.
 			 */
-
 			blkno = GinPageGetOpaque(page)->rightlink;
 
 			LockBuffer(entry->buffer, GIN_UNLOCK);
@@ -490,67 +625,39 @@ entryGetNextItem(Relation index, GinScanEntry entry)
 			LockBuffer(entry->buffer, GIN_SHARE);
 			page = BufferGetPage(entry->buffer);
 
-			entry->offset = InvalidOffsetNumber;
-			if (!ItemPointerIsValid(&entry->curItem) ||
-				findItemInPage(page, &entry->curItem, &entry->offset))
-			{
-				/*
-				 * Found position equal to or greater than stored
-				 */
-				entry->nlist = GinPageGetOpaque(page)->maxoff;
-				memcpy(entry->list, GinDataPageGetItem(page, FirstOffsetNumber),
-				   GinPageGetOpaque(page)->maxoff * sizeof(ItemPointerData));
-
-				LockBuffer(entry->buffer, GIN_UNLOCK);
+			if (GinPageIsDeleted(page))
+				continue;
+			if (!GinPageRightMost(page) &&
+				compareItemPointers(GinDataPageGetRightBound(page), &skipTo) <= 0)
+				continue;
 
-				if (!ItemPointerIsValid(&entry->curItem) ||
-					compareItemPointers(&entry->curItem,
-										entry->list + entry->offset - 1) == 0)
-				{
-					/*
-					 * First pages are deleted or empty, or we found exact
-					 * position, so break inner loop and continue outer one.
-					 */
+			break;
+		}
 
-					break;
-				}
+		/*
+		 * Decode the items after skipTo; whole segments of the page that
+		 * precede it are not decoded at all.
+		 */
+		pfree(entry->list);
+		entry->list = GinDataLeafPageGetItems(page, &nlist, &skipTo);
+		entry->nlist = nlist;
 
-				/*
-				 * Find greater than entry->curItem position, store it.
-				 */
-				entry->curItem = entry->list[entry->offset - 1];
+		LockBuffer(entry->buffer, GIN_UNLOCK);
 
-				return;
-			}
-		}
+		entry->offset = listSkipPast(entry->list, 0, entry->nlist, &skipTo);
 	}
 }
 
-/* convenience function for invoking a key's consistentFn */
-static inline bool
-callConsistentFn(GinState *ginstate, GinScanKey key)
-{
-	/*
-	 * Initialize recheckCurItem in case the consistentFn doesn't know it
-	 * should set it.  The safe assumption in that case is to force recheck.
-	 */
-	key->recheckCurItem = true;
-
-	return DatumGetBool(FunctionCall6(&ginstate->consistentFn[key->attnum - 1],
-									  PointerGetDatum(key->entryRes),
-									  UInt16GetDatum(key->strategy),
-									  key->query,
-									  UInt32GetDatum(key->nentries),
-									  PointerGetDatum(key->extra_data),
-									  PointerGetDatum(&key->recheckCurItem)));
-}
-
 #define gin_rand() (((double) random()) / ((double) MAX_RANDOM_VALUE))
 #define dropItem(e) ( gin_rand() > ((double)GinFuzzySearchLimit)/((double)((e)->predictNumberResult)) )
 
 /*
  * Sets entry->curItem to next heap item pointer for one entry of one scan key,
- * or sets entry->isFinished to TRUE if there are no more.
+ * or sets entry->isFinished to TRUE if there are no more.  Items <= advancePast
+ * are skipped where that is cheap: by binary search in a posting list or a
+ * posting tree page, by right bound over posting tree pages, and by heap
+ * page for partial matches.  The result may still be <= advancePast, so the
+ * caller must loop.
  *
  * Item pointers must be returned in ascending order.
  *
@@ -562,7 +669,7 @@ callConsistentFn(GinState *ginstate, GinScanKey key)
  * current implementation this is guaranteed by the behavior of tidbitmaps.
  */
 static void
-entryGetItem(Relation index, GinScanEntry entry)
+entryGetItem(Relation index, GinScanEntry entry, ItemPointer advancePast)
 {
 	Assert(!entry->isFinished);
 
@@ -575,8 +682,10 @@ entryGetItem(Relation index, GinScanEntry entry)
 	{
 		do
 		{
-			if (entry->partialMatchResult == NULL ||
-				entry->offset >= entry->partialMatchResult->ntuples)
+			while (entry->partialMatchResult == NULL ||
+				   entry->offset >= entry->partialMatchResult->ntuples ||
+				   entry->partialMatchResult->blockno <
+				   GinItemPointerGetBlockNumber(advancePast))
 			{
 				entry->partialMatchResult = tbm_iterate(entry->partialMatchIterator);
 
@@ -586,7 +695,7 @@ entryGetItem(Relation index, GinScanEntry entry)
 					tbm_end_iterate(entry->partialMatchIterator);
 					entry->partialMatchIterator = NULL;
 					entry->isFinished = TRUE;
-					break;
+					return;
 				}
 
 				/*
@@ -623,6 +732,8 @@ entryGetItem(Relation index, GinScanEntry entry)
 	}
 	else if (!BufferIsValid(entry->buffer))
 	{
+		entry->offset = listSkipPast(entry->list, entry->offset, entry->nlist,
+									 advancePast);
 		entry->offset++;
 		if (entry->offset <= entry->nlist)
 			entry->curItem = entry->list[entry->offset - 1];
@@ -636,7 +747,7 @@ entryGetItem(Relation index, GinScanEntry entry)
 	{
 		do
 		{
-			entryGetNextItem(index, entry);
+			entryGetNextItem(index, entry, advancePast);
 		} while (entry->isFinished == FALSE &&
 				 entry->reduceResult == TRUE &&
 				 dropItem(entry));
@@ -677,6 +788,48 @@ keyGetItem(Relation index, GinState *ginstate, MemoryContext tempCtx,
 
 	do
 	{
+		/*
+		 * If the key has required entries, an item can only match if all of
+		 * them contain it.  So advance them first, and skip everything else
+		 * ahead to the greatest of their current items, until they agree.
+		 * That way a frequent entry is only read around the items of a rare
+		 * one.
+		 */
+		if (key->nrequired > 0)
+		{
+			ItemPointerData prevAdvancePast;
+
+			do
+			{
+				prevAdvancePast = myAdvancePast;
+
+				for (i = 0; i < key->nentries; i++)
+				{
+					GinScanEntry src;
+
+					if (!key->entryRequired[i])
+						continue;
+
+					/* an entry with a master just copies its state */
+					entry = key->scanEntry + i;
+					src = entry->master ? entry->master : entry;
+
+					while (src->isFinished == FALSE &&
+						 compareItemPointers(&src->curItem, &myAdvancePast) <= 0)
+						entryGetItem(index, src, &myAdvancePast);
+
+					if (src->isFinished)
+					{
+						/* nothing can match any more */
+						key->isFinished = TRUE;
+						return;
+					}
+
+					advancePastBefore(&myAdvancePast, &src->curItem);
+				}
+			} while (compareItemPointers(&myAdvancePast, &prevAdvancePast) != 0);
+		}
+
 		/*
 		 * Advance any entries that are <= myAdvancePast.  In particular,
 		 * since entry->curItem was initialized with ItemPointerSetMin, this
@@ -700,7 +853,7 @@ keyGetItem(Relation index, GinState *ginstate, MemoryContext tempCtx,
 
 			while (entry->isFinished == FALSE &&
 				   compareItemPointers(&entry->curItem, &myAdvancePast) <= 0)
-				entryGetItem(index, entry);
+				entryGetItem(index, entry, &myAdvancePast);
 
 			if (entry->isFinished == FALSE &&
 				compareItemPointers(&entry->curItem, &key->curItem) < 0)
@@ -1336,9 +1489,13 @@ scanGetItem(IndexScanDesc scan, ItemPointer advancePast,
 
 		/*
 		 * No hit.  Update myAdvancePast to this TID, so that on the next
-		 * pass we'll move to the next possible entry.
+		 * pass we'll move to the next possible entry.  Since every key has
+		 * to match, we can skip right ahead to the greatest of their current
+		 * items.
 		 */
 		myAdvancePast = *item;
+		for (i = 0; i < so->nkeys; i++)
+			advancePastBefore(&myAdvancePast, &so->keys[i].curItem);
 	}
 
 	/*
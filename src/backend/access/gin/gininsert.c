@@ -30,6 +30,8 @@ typedef struct
 	MemoryContext tmpCtx;
 	MemoryContext funcCtx;
 	BuildAccumulator accum;
+	GinSortState *sortstate;
+	BlockNumber lastBlock;		/* heap block of the last tuple seen */
 } GinBuildState;
 
 /*
@@ -43,14 +45,20 @@ createPostingTree(Relation index, ItemPointerData *items, uint32 nitems)
 	Buffer		buffer = GinNewBuffer(index);
 	Page		page;
 
-	START_CRIT_SECTION();
-
+	/*
+	 * Compress the items before entering the critical section.  Nobody else
+	 * can see the new page yet.
+	 */
 	GinInitBuffer(buffer, GIN_DATA | GIN_LEAF);
 	page = BufferGetPage(buffer);
 	blkno = BufferGetBlockNumber(buffer);
 
-	memcpy(GinDataPageGetData(page), items, sizeof(ItemPointerData) * nitems);
-	GinPageGetOpaque(page)->maxoff = nitems;
+	if (GinDataLeafPageSetItems(page, items, nitems,
+								GinDataLeafMaxContentSize) != nitems)
+		elog(ERROR, "posting list does not fit on a page in \"%s\"",
+			 RelationGetRelationName(index));
+
+	START_CRIT_SECTION();
 
 	MarkBufferDirty(buffer);
 
@@ -63,6 +71,7 @@ createPostingTree(Relation index, ItemPointerData *items, uint32 nitems)
 		data.node = index->rd_node;
 		data.blkno = blkno;
 		data.nitem = nitems;
+		data.size = GinDataLeafPageGetPostingListSize(page);
 
 		rdata[0].buffer = InvalidBuffer;
 		rdata[0].data = (char *) &data;
@@ -70,12 +79,10 @@ createPostingTree(Relation index, ItemPointerData *items, uint32 nitems)
 		rdata[0].next = &rdata[1];
 
 		rdata[1].buffer = InvalidBuffer;
-		rdata[1].data = (char *) items;
-		rdata[1].len = sizeof(ItemPointerData) * nitems;
+		rdata[1].data = (char *) GinDataLeafPageGetPostingList(page);
+		rdata[1].len = data.size;
 		rdata[1].next = NULL;
 
-
-
 		recptr = XLogInsert(RM_GIN_ID, XLOG_GIN_CREATE_PTREE, rdata);
 		PageSetLSN(page, recptr);
 		PageSetTLI(page, ThisTimeLineID);
@@ -102,29 +109,30 @@ addItemPointersToTuple(Relation index, GinState *ginstate, GinBtreeStack *stack,
 {
 	Datum		key = gin_index_getattr(ginstate, old);
 	OffsetNumber attnum = gintuple_get_attrnum(ginstate, old);
-	IndexTuple	res = GinFormTuple(index, ginstate, attnum, key,
-								   NULL, nitem + GinGetNPosting(old),
-								   false);
+	IndexTuple	res;
+	ItemPointerData *olditems,
+			   *newitems;
+	int			nolditem;
+	uint32		nnewitem;
 
-	if (res)
-	{
-		/* good, small enough */
-		uint32		newnitem;
-
-		newnitem = MergeItemPointers(GinGetPosting(res),
-									 GinGetPosting(old), GinGetNPosting(old),
-									 items, nitem);
-		/* merge might have eliminated some duplicate items */
-		GinShortenTuple(res, newnitem);
-	}
-	else
+	olditems = ginReadTuple(old, &nolditem);
+
+	/* merge might eliminate some duplicate items */
+	newitems = (ItemPointerData *)
+		palloc(sizeof(ItemPointerData) * (nolditem + nitem));
+	nnewitem = MergeItemPointers(newitems, olditems, nolditem, items, nitem);
+
+	res = GinFormTuple(index, ginstate, attnum, key,
+					   newitems, nnewitem, false);
+
+	if (res == NULL)
 	{
 		BlockNumber postingRoot;
 		GinPostingTreeScan *gdi;
 
 		/* posting list becomes big, so we need to make posting's tree */
 		res = GinFormTuple(index, ginstate, attnum, key, NULL, 0, true);
-		postingRoot = createPostingTree(index, GinGetPosting(old), GinGetNPosting(old));
+		postingRoot = createPostingTree(index, olditems, nolditem);
 		GinSetPostingTree(res, postingRoot);
 
 		gdi = prepareScanPostingTree(index, postingRoot, FALSE);
@@ -135,6 +143,9 @@ addItemPointersToTuple(Relation index, GinState *ginstate, GinBtreeStack *stack,
 		pfree(gdi);
 	}
 
+	pfree(olditems);
+	pfree(newitems);
+
 	return res;
 }
 
@@ -241,31 +252,27 @@ ginBuildCallback(Relation index, HeapTuple htup, Datum *values,
 
 	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
 
-	for (i = 0; i < buildstate->ginstate.origTupdesc->natts; i++)
-		if (!isnull[i])
-			buildstate->indtuples += ginHeapTupleBulkInsert(buildstate,
-										   (OffsetNumber) (i + 1), values[i],
-															&htup->t_self);
-
-	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= maintenance_work_mem * 1024L)
+	/*
+	 * If we've maxed out our available memory, spill everything to a sorted
+	 * run.  We only do that between heap pages: item pointers of HOT tuples
+	 * are reported out of order within a page, and ginsort.c relies on each
+	 * run covering whole pages.
+	 */
+	if (buildstate->accum.allocatedMemory >= maintenance_work_mem * 1024L &&
+		ItemPointerGetBlockNumber(&htup->t_self) != buildstate->lastBlock)
 	{
-		ItemPointerData *list;
-		Datum		entry;
-		uint32		nlist;
-		OffsetNumber attnum;
-
-		ginBeginBAScan(&buildstate->accum);
-		while ((list = ginGetEntry(&buildstate->accum, &attnum, &entry, &nlist)) != NULL)
-		{
-			/* there could be many entries, so be willing to abort here */
-			CHECK_FOR_INTERRUPTS();
-			ginEntryInsert(index, &buildstate->ginstate, attnum, entry, list, nlist, TRUE);
-		}
+		ginSortDumpAccum(buildstate->sortstate, &buildstate->accum);
 
 		MemoryContextReset(buildstate->tmpCtx);
 		ginInitBA(&buildstate->accum);
 	}
+	buildstate->lastBlock = ItemPointerGetBlockNumber(&htup->t_self);
+
+	for (i = 0; i < buildstate->ginstate.origTupdesc->natts; i++)
+		if (!isnull[i])
+			buildstate->indtuples += ginHeapTupleBulkInsert(buildstate,
+										   (OffsetNumber) (i + 1), values[i],
+															&htup->t_self);
 
 	MemoryContextSwitchTo(oldCtx);
 }
@@ -281,11 +288,7 @@ ginbuild(PG_FUNCTION_ARGS)
 	GinBuildState buildstate;
 	Buffer		RootBuffer,
 				MetaBuffer;
-	ItemPointerData *list;
-	Datum		entry;
-	uint32		nlist;
 	MemoryContext oldCtx;
-	OffsetNumber attnum;
 
 	if (RelationGetNumberOfBlocks(index) != 0)
 		elog(ERROR, "index \"%s\" already contains data",
@@ -353,22 +356,19 @@ ginbuild(PG_FUNCTION_ARGS)
 	buildstate.accum.ginstate = &buildstate.ginstate;
 	ginInitBA(&buildstate.accum);
 
+	buildstate.sortstate = ginSortBegin(index, &buildstate.ginstate);
+	buildstate.lastBlock = InvalidBlockNumber;
+
 	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
+	 * Do the heap scan.  We disallow sync scan here because ginsort.c needs
+	 * to receive tuples in TID order.
 	 */
 	reltuples = IndexBuildHeapScan(heap, index, indexInfo, false,
 								   ginBuildCallback, (void *) &buildstate);
 
-	/* dump remaining entries to the index */
+	/* merge the spilled runs with the remaining entries and load the index */
 	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
-	ginBeginBAScan(&buildstate.accum);
-	while ((list = ginGetEntry(&buildstate.accum, &attnum, &entry, &nlist)) != NULL)
-	{
-		/* there could be many entries, so be willing to abort here */
-		CHECK_FOR_INTERRUPTS();
-		ginEntryInsert(index, &buildstate.ginstate, attnum, entry, list, nlist, TRUE);
-	}
+	ginSortFinish(buildstate.sortstate, &buildstate.accum);
 	MemoryContextSwitchTo(oldCtx);
 
 	MemoryContextDelete(buildstate.tmpCtx);
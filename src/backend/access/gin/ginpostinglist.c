@@ -0,0 +1,220 @@
+/*-------------------------------------------------------------------------
+ *
+ * ginpostinglist.c
+ *	  routines for dealing with compressed posting lists.
+ *
+ * A posting list is a sorted array of heap item pointers.  Stored as is,
+ * every item takes six bytes, although neighbouring items usually differ
+ * only in the low bits.  So we convert each item pointer to a 64-bit
+ * integer, with the offset number in the low MaxHeapTuplesPerPageBits bits
+ * and the block number above them, and store the difference from the
+ * previous item in varbyte encoding: seven bits per byte, with the high bit
+ * set on all but the last byte.  For a frequent key that means one byte
+ * per item.
+ *
+ * A varbyte stream can only be read from the beginning, so long lists are
+ * broken into segments.  Each segment (a GinPostingList) stores its first
+ * item uncompressed, so a scan that needs the items after some point can
+ * skip whole segments without decoding them.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *			$PostgreSQL$
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/gin.h"
+
+
+/*
+ * Number of bits needed for the offset number of a heap item pointer.
+ * Enough for MaxHeapTuplesPerPage (see htup.h) with the largest BLCKSZ we
+ * support.
+ */
+#define MaxHeapTuplesPerPageBits		11
+
+/* a 43-bit difference takes at most 7 bytes */
+#define MaxBytesPerInteger				7
+
+static uint64
+itemptr_to_uint64(ItemPointer iptr)
+{
+	uint64		val;
+
+	Assert(GinItemPointerGetOffsetNumber(iptr) < (1 << MaxHeapTuplesPerPageBits));
+
+	val = GinItemPointerGetBlockNumber(iptr);
+	val <<= MaxHeapTuplesPerPageBits;
+	val |= GinItemPointerGetOffsetNumber(iptr);
+
+	return val;
+}
+
+static void
+uint64_to_itemptr(uint64 val, ItemPointer iptr)
+{
+	ItemPointerSetOffsetNumber(iptr, val & ((1 << MaxHeapTuplesPerPageBits) - 1));
+	val = val >> MaxHeapTuplesPerPageBits;
+	ItemPointerSetBlockNumber(iptr, (BlockNumber) val);
+}
+
+/*
+ * Varbyte-encode 'val' into *ptr, and advance *ptr past it.
+ */
+static void
+encode_varbyte(uint64 val, unsigned char **ptr)
+{
+	unsigned char *p = *ptr;
+
+	while (val > 0x7F)
+	{
+		*(p++) = 0x80 | (val & 0x7F);
+		val >>= 7;
+	}
+	*(p++) = (unsigned char) val;
+
+	*ptr = p;
+}
+
+/*
+ * Decode a varbyte-encoded integer at *ptr, and advance *ptr past it.
+ */
+static uint64
+decode_varbyte(unsigned char **ptr)
+{
+	unsigned char *p = *ptr;
+	uint64		val = 0;
+	int			shift = 0;
+	unsigned char c;
+
+	do
+	{
+		c = *(p++);
+		val |= ((uint64) (c & 0x7F)) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	*ptr = p;
+
+	return val;
+}
+
+/*
+ * Compress as many items of ipd[] (which must be sorted and free of
+ * duplicates) as fit into a segment of at most maxsize bytes.  The segment
+ * is palloc'd; the number of items it holds is returned in *nwritten.  At
+ * least the first item is always stored, so maxsize must be no less than
+ * GinPostingListSegmentMinSize.
+ */
+GinPostingList *
+ginCompressPostingList(ItemPointerData *ipd, int nipd, int maxsize,
+					   int *nwritten)
+{
+	GinPostingList *result;
+	int			maxbytes;
+	uint64		prev;
+	unsigned char *ptr;
+	unsigned char *endptr;
+	int			totalpacked;
+
+	Assert(nipd > 0);
+	Assert(maxsize >= GinPostingListSegmentMinSize);
+
+	/* keep the total length even, so segments stay SHORTALIGN'd */
+	maxbytes = (maxsize - GinPostingListSegmentMinSize) & ~1;
+
+	result = (GinPostingList *) palloc(GinPostingListSegmentMinSize + maxbytes);
+
+	result->first = ipd[0];
+	prev = itemptr_to_uint64(&result->first);
+
+	ptr = result->bytes;
+	endptr = result->bytes + maxbytes;
+	for (totalpacked = 1; totalpacked < nipd; totalpacked++)
+	{
+		uint64		val = itemptr_to_uint64(&ipd[totalpacked]);
+		uint64		delta = val - prev;
+
+		Assert(val > prev);
+
+		if (endptr - ptr >= MaxBytesPerInteger)
+			encode_varbyte(delta, &ptr);
+		else
+		{
+			/* near the end, check that the next one still fits */
+			unsigned char buf[MaxBytesPerInteger];
+			unsigned char *p = buf;
+
+			encode_varbyte(delta, &p);
+			if (p - buf > endptr - ptr)
+				break;
+
+			memcpy(ptr, buf, p - buf);
+			ptr += (p - buf);
+		}
+		prev = val;
+	}
+	result->nbytes = ptr - result->bytes;
+
+	/* clear the padding byte, if any, so that pages are reproducible */
+	if (result->nbytes != SHORTALIGN(result->nbytes))
+		*ptr = 0;
+
+	*nwritten = totalpacked;
+
+	return result;
+}
+
+/*
+ * Decode a single posting list segment into a palloc'd array.
+ */
+ItemPointer
+ginPostingListDecode(GinPostingList *plist, int *ndecoded)
+{
+	return ginPostingListDecodeAllSegments(plist,
+										   SizeOfGinPostingList(plist),
+										   ndecoded);
+}
+
+/*
+ * Decode the series of posting list segments that takes len bytes starting
+ * at 'segment' into a palloc'd array.
+ */
+ItemPointer
+ginPostingListDecodeAllSegments(GinPostingList *segment, int len, int *ndecoded)
+{
+	ItemPointer result;
+	int			n = 0;
+	char	   *endseg = ((char *) segment) + len;
+
+	/* every item takes at least one byte, so this is enough room */
+	result = (ItemPointer) palloc(Max(len, 1) * sizeof(ItemPointerData));
+
+	while ((char *) segment < endseg)
+	{
+		unsigned char *ptr = segment->bytes;
+		unsigned char *endptr = segment->bytes + segment->nbytes;
+		uint64		val;
+
+		/* copy the first item */
+		result[n++] = segment->first;
+		val = itemptr_to_uint64(&segment->first);
+
+		/* decode the rest */
+		while (ptr < endptr)
+		{
+			val += decode_varbyte(&ptr);
+			uint64_to_itemptr(val, &result[n++]);
+		}
+
+		segment = GinNextPostingListSegment(segment);
+	}
+
+	*ndecoded = n;
+
+	return result;
+}
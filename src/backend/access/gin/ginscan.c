@@ -45,6 +45,8 @@ fillScanKey(GinState *ginstate, GinScanKey key, OffsetNumber attnum, Datum query
 
 	key->nentries = nEntryValues;
 	key->entryRes = (bool *) palloc0(sizeof(bool) * nEntryValues);
+	key->entryRequired = (bool *) palloc0(sizeof(bool) * nEntryValues);
+	key->nrequired = 0;
 	key->scanEntry = (GinScanEntry) palloc(sizeof(GinScanEntryData) * nEntryValues);
 	key->strategy = strategy;
 	key->attnum = attnum;
@@ -148,6 +150,7 @@ freeScanKeys(GinScanKey keys, uint32 nkeys)
 		}
 
 		pfree(key->entryRes);
+		pfree(key->entryRequired);
 		pfree(key->scanEntry);
 	}
 
@@ -0,0 +1,853 @@
+/*-------------------------------------------------------------------------
+ *
+ * ginsort.c
+ *	  Build a GIN index from sorted entries by loading pages sequentially.
+ *
+ * NOTES
+ *
+ * During ginbuild, ginbulk.c collects (key, item pointer) pairs in an
+ * in-memory accumulator.  Formerly, whenever the accumulator filled
+ * maintenance_work_mem its contents were inserted into the index with
+ * ginEntryInsert, one key at a time.  On tables much larger than
+ * maintenance_work_mem that means a random descent of the entry tree for
+ * every key of every batch, and every posting tree gets appended to once
+ * per batch, so the build thrashes the buffer pool much like a btree built
+ * by repeated insertion would.
+ *
+ * Instead, each time the accumulator fills up we write its contents to a
+ * temporary file as a sorted "run"; ginGetEntry already returns the keys
+ * in index order with sorted item pointers.  When the heap scan is done,
+ * the runs and the final contents of the accumulator are merged, and the
+ * merged stream of keys is loaded into the entry tree bottom-up, in the
+ * manner of nbtsort.c.  ginbuild disables synchronized scans and only
+ * spills a run at a heap page boundary, so every item pointer of a run
+ * precedes every item pointer of any later run: merging the posting lists
+ * of equal keys is a simple concatenation in run order.
+ *
+ * A key whose item pointers fit in a leaf tuple gets a posting list.
+ * Otherwise a posting tree is built for it, also bottom-up, as the item
+ * pointers stream by.  Posting tree pages are packed full, because later
+ * insertions come mostly in increasing heap order and only split the
+ * rightmost pages.  Entry tree leaf pages are packed to
+ * GIN_SORT_LEAF_FILLFACTOR and upper pages to GIN_SORT_NONLEAF_FILLFACTOR,
+ * for the same reasons nbtsort.c gives.
+ *
+ * As in nbtsort.c, the pages are built in local memory and written out
+ * with smgrextend, WAL-logged only if WAL archiving is active, and the
+ * file is synced to disk with smgrimmedsync before we return.  The one
+ * exception is the root of the entry tree: it has to live at
+ * GIN_ROOT_BLKNO, which ginbuild has already initialized through the
+ * buffer manager, so the finished root page is copied into that buffer
+ * and always WAL-logged.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *			$PostgreSQL$
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/gin.h"
+#include "access/heapam.h"
+#include "miscadmin.h"
+#include "storage/buffile.h"
+#include "storage/bufmgr.h"
+#include "storage/smgr.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+
+#define GIN_SORT_LEAF_FILLFACTOR	90
+#define GIN_SORT_NONLEAF_FILLFACTOR	70
+
+/*
+ * Item pointers buffered for a posting tree leaf before it is compressed.
+ * Every item takes at least one byte, so this is at least a page's worth.
+ */
+#define GIN_SORT_LEAF_ITEMS			GinDataLeafMaxContentSize
+
+/* size of the read buffer of each run during the merge */
+#define GIN_SORT_RUN_BUFSIZE		(4 * BLCKSZ)
+
+/*
+ * Status record for a page being built on one level of the entry tree or
+ * of a posting tree.  The block number of the first page of a level is
+ * assigned only when the page is finished, so that a level consisting of a
+ * single page can become a root without leaving a hole in the file.
+ */
+typedef struct GinSortPageState
+{
+	Page		page;			/* workspace for page being built */
+	BlockNumber blkno;			/* block # to write this page at */
+	Size		full;			/* "full" if less than this much free space */
+	uint32		level;			/* tree level (0 = leaf) */
+	struct GinSortPageState *next;		/* link to parent level, if any */
+
+	/* item pointers not yet compressed, for posting tree leaves only */
+	ItemPointerData *items;
+	uint32		nitems;
+} GinSortPageState;
+
+/*
+ * A source of sorted entries during the merge: a run in the temporary
+ * file, or (when run is false) the accumulator itself.
+ */
+typedef struct GinSortSource
+{
+	bool		run;
+	bool		exhausted;
+
+	/* current entry */
+	OffsetNumber attnum;
+	Datum		key;
+	IndexTuple	keytup;			/* storage of key, for runs */
+	ItemPointerData *items;
+	uint32		nitems;
+
+	/* read position and buffer, for runs */
+	int			fileno;
+	off_t		offset;
+	char	   *buf;
+	Size		buflen;
+	Size		bufpos;
+} GinSortSource;
+
+struct GinSortState
+{
+	Relation	index;
+	GinState   *ginstate;
+	MemoryContext sortCtx;		/* holds everything below */
+	bool		use_wal;		/* dump pages to WAL? */
+
+	BlockNumber pages_alloced;	/* # pages allocated */
+	BlockNumber pages_written;	/* # pages written out */
+	Page		zeropage;		/* workspace for filling zeroes */
+
+	/* spilled runs */
+	BufFile    *file;
+	int			nruns;
+	int			maxruns;
+	int		   *runfileno;		/* start position of each run */
+	off_t	   *runoffset;
+
+	/* state of the entry tree */
+	GinSortPageState *entrytree;	/* leaf level, or NULL if empty */
+
+	/* key currently being loaded */
+	ItemPointerData *items;		/* buffered item pointers ... */
+	uint32		nitems;
+	uint32		maxitems;
+	GinSortPageState *ptree;	/* ... or leaf level of its posting tree */
+};
+
+
+static BlockNumber
+ginSortAllocPage(GinSortState *gs)
+{
+	return gs->pages_alloced++;
+}
+
+/*
+ * emit a completed page, as _bt_blwritepage does
+ */
+static void
+ginSortWritePage(GinSortState *gs, Page page, BlockNumber blkno)
+{
+	/* Ensure rd_smgr is open (could have been closed by relcache flush!) */
+	RelationOpenSmgr(gs->index);
+
+	/* XLOG stuff */
+	if (gs->use_wal)
+		log_newpage(&gs->index->rd_node, MAIN_FORKNUM, blkno, page);
+	else
+		PageSetTLI(page, ThisTimeLineID);
+
+	/* fill in any holes with zeroes, see _bt_blwritepage */
+	while (blkno > gs->pages_written)
+	{
+		if (!gs->zeropage)
+			gs->zeropage = (Page) palloc0(BLCKSZ);
+		smgrextend(gs->index->rd_smgr, MAIN_FORKNUM,
+				   gs->pages_written++,
+				   (char *) gs->zeropage,
+				   true);
+	}
+
+	if (blkno == gs->pages_written)
+	{
+		/* extending the file... */
+		smgrextend(gs->index->rd_smgr, MAIN_FORKNUM, blkno,
+				   (char *) page, true);
+		gs->pages_written++;
+	}
+	else
+	{
+		/* overwriting a block we zero-filled before */
+		smgrwrite(gs->index->rd_smgr, MAIN_FORKNUM, blkno,
+				  (char *) page, true);
+	}
+
+	pfree(page);
+}
+
+/*
+ * Install the finished root of the entry tree at GIN_ROOT_BLKNO.
+ *
+ * ginbuild created the root through the buffer manager and WAL-logged its
+ * initialization, so we must go through the buffer too, and must log the
+ * new contents even if we don't log the rest of the index: otherwise
+ * replay would leave an empty root behind.
+ */
+static void
+ginSortWriteRoot(GinSortState *gs, Page page)
+{
+	Buffer		buffer;
+
+	buffer = ReadBuffer(gs->index, GIN_ROOT_BLKNO);
+	LockBuffer(buffer, GIN_EXCLUSIVE);
+
+	START_CRIT_SECTION();
+
+	memcpy(BufferGetPage(buffer), page, BLCKSZ);
+	MarkBufferDirty(buffer);
+
+	if (!gs->index->rd_istemp)
+		log_newpage(&gs->index->rd_node, MAIN_FORKNUM, GIN_ROOT_BLKNO,
+					BufferGetPage(buffer));
+
+	END_CRIT_SECTION();
+
+	UnlockReleaseBuffer(buffer);
+
+	pfree(page);
+}
+
+static GinSortPageState *
+ginSortNewPageState(uint32 flags, uint32 level, int fillfactor)
+{
+	GinSortPageState *state = (GinSortPageState *) palloc(sizeof(GinSortPageState));
+
+	state->page = (Page) palloc(BLCKSZ);
+	GinInitPage(state->page, flags, BLCKSZ);
+	state->blkno = InvalidBlockNumber;
+	state->full = BLCKSZ * (100 - fillfactor) / 100;
+	state->level = level;
+	state->next = NULL;
+
+	if ((flags & (GIN_DATA | GIN_LEAF)) == (GIN_DATA | GIN_LEAF))
+		state->items = (ItemPointerData *)
+			palloc(sizeof(ItemPointerData) * GIN_SORT_LEAF_ITEMS);
+	else
+		state->items = NULL;
+	state->nitems = 0;
+
+	return state;
+}
+
+/*
+ * Entry tree pages
+ */
+
+static void
+ginSortEntryAdd(GinSortState *gs, GinSortPageState *state, IndexTuple itup)
+{
+	Page		page = state->page;
+	Size		pgspc = PageGetFreeSpace(page);
+	Size		itupsz = MAXALIGN(IndexTupleSize(itup));
+
+	if (itupsz > Min(INDEX_SIZE_MASK, GinMaxItemSize))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("index row size %lu exceeds maximum %lu for index \"%s\"",
+						(unsigned long) itupsz,
+						(unsigned long) Min(INDEX_SIZE_MASK, GinMaxItemSize),
+						RelationGetRelationName(gs->index))));
+
+	if (pgspc < itupsz ||
+		(pgspc < state->full && PageGetMaxOffsetNumber(page) > 0))
+	{
+		/*
+		 * Finish off the page and write it out.  Its downlink carries a copy
+		 * of its rightmost key, as made by a page split.
+		 */
+		BlockNumber nblkno;
+		IndexTuple	link;
+
+		if (state->blkno == InvalidBlockNumber)
+			state->blkno = ginSortAllocPage(gs);
+		nblkno = ginSortAllocPage(gs);
+
+		GinPageGetOpaque(page)->rightlink = nblkno;
+
+		if (state->next == NULL)
+			state->next = ginSortNewPageState(0, state->level + 1,
+											  GIN_SORT_NONLEAF_FILLFACTOR);
+		link = ginPageGetLinkItupByPage(page, state->blkno);
+		ginSortEntryAdd(gs, state->next, link);
+		pfree(link);
+
+		ginSortWritePage(gs, page, state->blkno);
+
+		state->page = page = (Page) palloc(BLCKSZ);
+		GinInitPage(page, state->level == 0 ? GIN_LEAF : 0, BLCKSZ);
+		state->blkno = nblkno;
+	}
+
+	if (PageAddItem(page, (Item) itup, IndexTupleSize(itup),
+					InvalidOffsetNumber, false, false) == InvalidOffsetNumber)
+		elog(ERROR, "failed to add item to index page in \"%s\"",
+			 RelationGetRelationName(gs->index));
+}
+
+/*
+ * Finish the rightmost page on each level of the entry tree.  The single
+ * page left on the top level is the root.
+ */
+static void
+ginSortEntryFinish(GinSortState *gs)
+{
+	GinSortPageState *state = gs->entrytree;
+
+	while (state->next != NULL)
+	{
+		IndexTuple	link;
+
+		if (state->blkno == InvalidBlockNumber)
+			state->blkno = ginSortAllocPage(gs);
+
+		link = ginPageGetLinkItupByPage(state->page, state->blkno);
+		ginSortEntryAdd(gs, state->next, link);
+		pfree(link);
+
+		ginSortWritePage(gs, state->page, state->blkno);
+		state = state->next;
+	}
+
+	ginSortWriteRoot(gs, state->page);
+}
+
+/*
+ * Posting tree pages
+ */
+
+static ItemPointerData
+ginSortDataRightBound(Page page)
+{
+	OffsetNumber maxoff = GinPageGetOpaque(page)->maxoff;
+
+	Assert(maxoff >= FirstOffsetNumber);
+
+	if (GinPageIsLeaf(page))
+	{
+		ItemPointerData bound;
+		ItemPointer items;
+		int			nitems;
+
+		items = GinDataLeafPageGetItems(page, &nitems, NULL);
+		bound = items[nitems - 1];
+		pfree(items);
+
+		return bound;
+	}
+	else
+		return ((PostingItem *) GinDataPageGetItem(page, maxoff))->key;
+}
+
+static void ginSortDataAdd(GinSortState *gs, GinSortPageState *state,
+			   PostingItem *pitem);
+
+/*
+ * Finish off the current page of a posting tree level and write it out,
+ * and start a new one.  The right bound of the page and the key of its
+ * downlink are both its last item.
+ */
+static void
+ginSortDataNextPage(GinSortState *gs, GinSortPageState *state)
+{
+	Page		page = state->page;
+	BlockNumber nblkno;
+	PostingItem pitem;
+
+	if (state->blkno == InvalidBlockNumber)
+		state->blkno = ginSortAllocPage(gs);
+	nblkno = ginSortAllocPage(gs);
+
+	GinPageGetOpaque(page)->rightlink = nblkno;
+	*GinDataPageGetRightBound(page) = ginSortDataRightBound(page);
+
+	if (state->next == NULL)
+		state->next = ginSortNewPageState(GIN_DATA, state->level + 1, 100);
+	PostingItemSetBlockNumber(&pitem, state->blkno);
+	pitem.key = *GinDataPageGetRightBound(page);
+	ginSortDataAdd(gs, state->next, &pitem);
+
+	ginSortWritePage(gs, page, state->blkno);
+
+	state->page = page = (Page) palloc(BLCKSZ);
+	GinInitPage(page, state->level == 0 ? GIN_DATA | GIN_LEAF : GIN_DATA,
+				BLCKSZ);
+	state->blkno = nblkno;
+}
+
+/*
+ * Add a downlink to an internal page of a posting tree.
+ */
+static void
+ginSortDataAdd(GinSortState *gs, GinSortPageState *state, PostingItem *pitem)
+{
+	Assert(!GinPageIsLeaf(state->page));
+
+	if (GinDataPageGetFreeSpace(state->page) < sizeof(PostingItem))
+		ginSortDataNextPage(gs, state);
+
+	GinDataPageAddItem(state->page, pitem, InvalidOffsetNumber);
+}
+
+/*
+ * Compress the buffered item pointers of a posting tree leaf level into
+ * full pages.  Unless this is the last call for the tree, we only do so
+ * once there are enough of them to fill a page, keeping the rest buffered.
+ */
+static void
+ginSortDataFlushItems(GinSortState *gs, GinSortPageState *state, bool last)
+{
+	while (state->nitems >= (last ? 1 : GIN_SORT_LEAF_ITEMS))
+	{
+		int			nstored;
+
+		if (GinPageGetOpaque(state->page)->maxoff > 0)
+			ginSortDataNextPage(gs, state);
+
+		nstored = GinDataLeafPageSetItems(state->page, state->items,
+										  state->nitems,
+										  GinDataLeafMaxContentSize);
+		Assert(nstored > 0);
+
+		state->nitems -= nstored;
+		memmove(state->items, state->items + nstored,
+				sizeof(ItemPointerData) * state->nitems);
+	}
+}
+
+/*
+ * Add item pointers, in order, to the leaf level of a posting tree.
+ */
+static void
+ginSortDataAddItems(GinSortState *gs, GinSortPageState *state,
+					ItemPointerData *items, uint32 nitems)
+{
+	Assert(GinPageIsLeaf(state->page));
+
+	while (nitems > 0)
+	{
+		uint32		n = Min(nitems, GIN_SORT_LEAF_ITEMS - state->nitems);
+
+		memcpy(state->items + state->nitems, items,
+			   sizeof(ItemPointerData) * n);
+		state->nitems += n;
+		items += n;
+		nitems -= n;
+
+		ginSortDataFlushItems(gs, state, false);
+	}
+}
+
+/*
+ * Finish the rightmost page on each level of a posting tree, and return
+ * the block number of its root.
+ */
+static BlockNumber
+ginSortDataFinish(GinSortState *gs, GinSortPageState *state)
+{
+	BlockNumber rootblkno;
+
+	ginSortDataFlushItems(gs, state, true);
+
+	for (;;)
+	{
+		GinSortPageState *parent = state->next;
+
+		if (state->blkno == InvalidBlockNumber)
+			state->blkno = ginSortAllocPage(gs);
+
+		if (parent != NULL)
+		{
+			PostingItem pitem;
+
+			PostingItemSetBlockNumber(&pitem, state->blkno);
+			pitem.key = ginSortDataRightBound(state->page);
+			ginSortDataAdd(gs, parent, &pitem);
+		}
+
+		rootblkno = state->blkno;
+		ginSortWritePage(gs, state->page, state->blkno);
+		if (state->items)
+			pfree(state->items);
+		pfree(state);
+
+		if (parent == NULL)
+			break;
+		state = parent;
+	}
+
+	return rootblkno;
+}
+
+/*
+ * Load a sorted stream of keys.  The item pointers of a key arrive in one
+ * or more calls of ginSortAddItems between ginSortStartKey and
+ * ginSortEndKey.
+ */
+
+static void
+ginSortStartKey(GinSortState *gs)
+{
+	gs->nitems = 0;
+	gs->ptree = NULL;
+}
+
+static void
+ginSortAddItems(GinSortState *gs, ItemPointerData *items, uint32 nitems)
+{
+	Assert(nitems > 0);
+	Assert(gs->nitems == 0 ||
+		   compareItemPointers(&gs->items[gs->nitems - 1], items) < 0);
+
+	if (gs->ptree == NULL)
+	{
+		if (gs->nitems + nitems <= gs->maxitems)
+		{
+			/* could still fit in a posting list, so just buffer them */
+			memcpy(gs->items + gs->nitems, items,
+				   sizeof(ItemPointerData) * nitems);
+			gs->nitems += nitems;
+			return;
+		}
+
+		/* too many for a posting list, start a posting tree */
+		gs->ptree = ginSortNewPageState(GIN_DATA | GIN_LEAF, 0, 100);
+		ginSortDataAddItems(gs, gs->ptree, gs->items, gs->nitems);
+		gs->nitems = 0;
+	}
+
+	ginSortDataAddItems(gs, gs->ptree, items, nitems);
+}
+
+static void
+ginSortEndKey(GinSortState *gs, OffsetNumber attnum, Datum key)
+{
+	IndexTuple	itup = NULL;
+
+	if (gs->ptree == NULL)
+	{
+		itup = GinFormTuple(gs->index, gs->ginstate, attnum, key,
+							gs->items, gs->nitems, false);
+
+		if (itup == NULL)
+		{
+			/* posting list doesn't fit after all, move it to a tree */
+			gs->ptree = ginSortNewPageState(GIN_DATA | GIN_LEAF, 0, 100);
+			ginSortDataAddItems(gs, gs->ptree, gs->items, gs->nitems);
+		}
+	}
+
+	if (gs->ptree != NULL)
+	{
+		BlockNumber postingRoot = ginSortDataFinish(gs, gs->ptree);
+
+		itup = GinFormTuple(gs->index, gs->ginstate, attnum, key,
+							NULL, 0, true);
+		GinSetPostingTree(itup, postingRoot);
+		gs->ptree = NULL;
+	}
+
+	if (gs->entrytree == NULL)
+		gs->entrytree = ginSortNewPageState(GIN_LEAF, 0,
+											GIN_SORT_LEAF_FILLFACTOR);
+	ginSortEntryAdd(gs, gs->entrytree, itup);
+	pfree(itup);
+}
+
+/*
+ * Runs
+ */
+
+static void
+ginSortRunRead(GinSortState *gs, GinSortSource *src, void *ptr, Size size)
+{
+	char	   *dst = (char *) ptr;
+
+	while (size > 0)
+	{
+		Size		n;
+
+		if (src->bufpos >= src->buflen)
+		{
+			if (BufFileSeek(gs->file, src->fileno, src->offset, SEEK_SET) != 0)
+				elog(ERROR, "could not seek in GIN build temporary file");
+			src->buflen = BufFileRead(gs->file, src->buf, GIN_SORT_RUN_BUFSIZE);
+			if (src->buflen == 0)
+				elog(ERROR, "unexpected end of data in GIN build temporary file");
+			BufFileTell(gs->file, &src->fileno, &src->offset);
+			src->bufpos = 0;
+		}
+
+		n = Min(size, src->buflen - src->bufpos);
+		memcpy(dst, src->buf + src->bufpos, n);
+		src->bufpos += n;
+		dst += n;
+		size -= n;
+	}
+}
+
+static void
+ginSortRunWrite(GinSortState *gs, void *ptr, Size size)
+{
+	if (BufFileWrite(gs->file, ptr, size) != size)
+		elog(ERROR, "could not write to GIN build temporary file");
+}
+
+/*
+ * Advance a source to its next entry, or mark it exhausted.
+ */
+static void
+ginSortSourceNext(GinSortState *gs, GinSortSource *src, BuildAccumulator *accum)
+{
+	if (!src->run)
+	{
+		src->items = ginGetEntry(accum, &src->attnum, &src->key, &src->nitems);
+		src->exhausted = (src->items == NULL);
+		return;
+	}
+
+	if (src->keytup)
+		pfree(src->keytup);
+	if (src->items)
+		pfree(src->items);
+	src->keytup = NULL;
+	src->items = NULL;
+
+	/*
+	 * Each entry of a run is the key as an IndexTuple without posting list,
+	 * preceded by its length, followed by the count of item pointers and the
+	 * item pointers themselves.  A zero length ends the run.
+	 */
+	{
+		uint32		len;
+
+		ginSortRunRead(gs, src, &len, sizeof(len));
+		if (len == 0)
+		{
+			src->exhausted = true;
+			return;
+		}
+
+		src->keytup = (IndexTuple) palloc(len);
+		ginSortRunRead(gs, src, src->keytup, len);
+		src->attnum = gintuple_get_attrnum(gs->ginstate, src->keytup);
+		src->key = gin_index_getattr(gs->ginstate, src->keytup);
+
+		ginSortRunRead(gs, src, &src->nitems, sizeof(src->nitems));
+		src->items = (ItemPointerData *)
+			palloc(sizeof(ItemPointerData) * src->nitems);
+		ginSortRunRead(gs, src, src->items,
+					   sizeof(ItemPointerData) * src->nitems);
+	}
+}
+
+/*
+ * Prepare to load a GIN index whose metapage and root have been set up.
+ */
+GinSortState *
+ginSortBegin(Relation index, GinState *ginstate)
+{
+	GinSortState *gs;
+	MemoryContext sortCtx;
+	MemoryContext oldCtx;
+
+	sortCtx = AllocSetContextCreate(CurrentMemoryContext,
+									"Gin sorted build context",
+									ALLOCSET_DEFAULT_MINSIZE,
+									ALLOCSET_DEFAULT_INITSIZE,
+									ALLOCSET_DEFAULT_MAXSIZE);
+	oldCtx = MemoryContextSwitchTo(sortCtx);
+
+	gs = (GinSortState *) palloc0(sizeof(GinSortState));
+	gs->index = index;
+	gs->ginstate = ginstate;
+	gs->sortCtx = sortCtx;
+
+	/*
+	 * We need to log index creation in WAL iff WAL archiving is enabled AND
+	 * it's not a temp index.
+	 */
+	gs->use_wal = XLogIsNeeded() && !index->rd_istemp;
+
+	/* the metapage and the root are already there */
+	gs->pages_alloced = gs->pages_written = RelationGetNumberOfBlocks(index);
+	Assert(gs->pages_alloced == GIN_ROOT_BLKNO + 1);
+
+	/*
+	 * No posting list can hold more item pointers than this, as each takes
+	 * at least a byte when compressed.
+	 */
+	gs->maxitems = GinMaxItemSize;
+	gs->items = (ItemPointerData *) palloc(sizeof(ItemPointerData) * gs->maxitems);
+
+	MemoryContextSwitchTo(oldCtx);
+
+	return gs;
+}
+
+/*
+ * Write out the contents of the accumulator as a sorted run.  The caller
+ * is responsible for resetting the accumulator afterwards.
+ */
+void
+ginSortDumpAccum(GinSortState *gs, BuildAccumulator *accum)
+{
+	MemoryContext oldCtx = MemoryContextSwitchTo(gs->sortCtx);
+	ItemPointerData *list;
+	OffsetNumber attnum;
+	Datum		entry;
+	uint32		nlist;
+	uint32		len;
+
+	if (gs->file == NULL)
+	{
+		gs->file = BufFileCreateTemp(false);
+		gs->maxruns = 16;
+		gs->runfileno = (int *) palloc(sizeof(int) * gs->maxruns);
+		gs->runoffset = (off_t *) palloc(sizeof(off_t) * gs->maxruns);
+	}
+	else if (gs->nruns >= gs->maxruns)
+	{
+		gs->maxruns *= 2;
+		gs->runfileno = (int *) repalloc(gs->runfileno, sizeof(int) * gs->maxruns);
+		gs->runoffset = (off_t *) repalloc(gs->runoffset, sizeof(off_t) * gs->maxruns);
+	}
+
+	BufFileTell(gs->file, &gs->runfileno[gs->nruns], &gs->runoffset[gs->nruns]);
+	gs->nruns++;
+
+	MemoryContextSwitchTo(oldCtx);
+
+	ginBeginBAScan(accum);
+	while ((list = ginGetEntry(accum, &attnum, &entry, &nlist)) != NULL)
+	{
+		IndexTuple	keytup;
+
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		keytup = GinFormTuple(gs->index, gs->ginstate, attnum, entry,
+							  NULL, 0, true);
+		len = IndexTupleSize(keytup);
+		ginSortRunWrite(gs, &len, sizeof(len));
+		ginSortRunWrite(gs, keytup, len);
+		ginSortRunWrite(gs, &nlist, sizeof(nlist));
+		ginSortRunWrite(gs, list, sizeof(ItemPointerData) * nlist);
+		pfree(keytup);
+	}
+
+	len = 0;
+	ginSortRunWrite(gs, &len, sizeof(len));
+}
+
+/*
+ * Merge the spilled runs and the remaining contents of the accumulator,
+ * load the result into the index, and clean up.
+ *
+ * There are rarely more than a handful of runs, so we simply look for the
+ * smallest current key with a linear scan of the sources.
+ */
+void
+ginSortFinish(GinSortState *gs, BuildAccumulator *accum)
+{
+	MemoryContext oldCtx = MemoryContextSwitchTo(gs->sortCtx);
+	int			nsources = gs->nruns + 1;
+	GinSortSource *sources;
+	GinSortSource **equal;
+	int			i;
+
+	sources = (GinSortSource *) palloc0(sizeof(GinSortSource) * nsources);
+	equal = (GinSortSource **) palloc(sizeof(GinSortSource *) * nsources);
+
+	for (i = 0; i < gs->nruns; i++)
+	{
+		sources[i].run = true;
+		sources[i].fileno = gs->runfileno[i];
+		sources[i].offset = gs->runoffset[i];
+		sources[i].buf = (char *) palloc(GIN_SORT_RUN_BUFSIZE);
+		ginSortSourceNext(gs, &sources[i], accum);
+	}
+
+	/* the accumulator holds the last part of the heap, so it goes last */
+	sources[gs->nruns].run = false;
+	ginBeginBAScan(accum);
+	ginSortSourceNext(gs, &sources[gs->nruns], accum);
+
+	for (;;)
+	{
+		GinSortSource *min = NULL;
+		int			nequal = 0;
+
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		for (i = 0; i < nsources; i++)
+		{
+			GinSortSource *src = &sources[i];
+			int			cmp;
+
+			if (src->exhausted)
+				continue;
+
+			cmp = (min == NULL) ? -1 :
+				compareAttEntries(gs->ginstate, src->attnum, src->key,
+								  min->attnum, min->key);
+			if (cmp < 0)
+			{
+				min = src;
+				nequal = 0;
+			}
+			if (cmp <= 0)
+				equal[nequal++] = src;
+		}
+
+		if (min == NULL)
+			break;
+
+		/* sources are in heap order, so this keeps item pointers sorted */
+		ginSortStartKey(gs);
+		for (i = 0; i < nequal; i++)
+			ginSortAddItems(gs, equal[i]->items, equal[i]->nitems);
+		ginSortEndKey(gs, min->attnum, min->key);
+
+		for (i = 0; i < nequal; i++)
+			ginSortSourceNext(gs, equal[i], accum);
+	}
+
+	/* an empty index keeps the empty root ginbuild made */
+	if (gs->entrytree != NULL)
+		ginSortEntryFinish(gs);
+
+	/*
+	 * If the index isn't temp, we must fsync it down to disk before it's safe
+	 * to commit the transaction, as explained in nbtsort.c.
+	 */
+	if (!gs->index->rd_istemp)
+	{
+		RelationOpenSmgr(gs->index);
+		smgrimmedsync(gs->index->rd_smgr, MAIN_FORKNUM);
+	}
+
+	if (gs->file)
+		BufFileClose(gs->file);
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextDelete(gs->sortCtx);
+}
@@ -205,6 +205,10 @@ GinInitPage(Page page, uint32 f, Size pageSize)
 	memset(opaque, 0, sizeof(GinPageOpaqueData));
 	opaque->flags = f;
 	opaque->rightlink = InvalidBlockNumber;
+
+	/* posting tree leaves keep the end of their contents in pd_lower */
+	if ((f & GIN_DATA) && (f & GIN_LEAF))
+		GinDataLeafPageSetPostingListSize(page, 0);
 }
 
 void
@@ -101,10 +101,9 @@ xlogVacuumPage(Relation index, Buffer buffer)
 
 	if (GinPageIsData(page))
 	{
-		backup = GinDataPageGetData(page);
+		backup = (char *) GinDataLeafPageGetPostingList(page);
 		data.nitem = GinPageGetOpaque(page)->maxoff;
-		if (data.nitem)
-			len = MAXALIGN(sizeof(ItemPointerData) * data.nitem);
+		len = GinDataLeafPageGetPostingListSize(page);
 	}
 	else
 	{
@@ -125,7 +124,7 @@ xlogVacuumPage(Relation index, Buffer buffer)
 	}
 
 	rdata[0].buffer = buffer;
-	rdata[0].buffer_std = (GinPageIsData(page)) ? FALSE : TRUE;
+	rdata[0].buffer_std = TRUE;
 	rdata[0].len = 0;
 	rdata[0].data = NULL;
 	rdata[0].next = rdata + 1;
@@ -180,23 +179,34 @@ ginVacuumPostingTreeLeaves(GinVacuumState *gvs, BlockNumber blkno, bool isRoot,
 
 	if (GinPageIsLeaf(page))
 	{
-		OffsetNumber newMaxOff,
-					oldMaxOff = GinPageGetOpaque(page)->maxoff;
-		ItemPointerData *cleaned = NULL;
+		ItemPointerData *items;
+		int			oldMaxOff;
+		uint32		newMaxOff;
 
-		newMaxOff = ginVacuumPostingList(gvs,
-				(ItemPointer) GinDataPageGetData(page), oldMaxOff, &cleaned);
+		/* vacuum the decoded items in place */
+		items = GinDataLeafPageGetItems(page, &oldMaxOff, NULL);
+		newMaxOff = ginVacuumPostingList(gvs, items, oldMaxOff, &items);
 
 		/* saves changes about deleted tuple ... */
 		if (oldMaxOff != newMaxOff)
 		{
+			Page		newpage;
+
+			/*
+			 * Recompress the remaining items on a copy of the page first, so
+			 * that nothing can fail inside the critical section.  Removing
+			 * items should never make the compressed list longer, but
+			 * check anyway.
+			 */
+			newpage = PageGetTempPageCopy(page);
+			if (GinDataLeafPageSetItems(newpage, items, newMaxOff,
+										GinDataLeafMaxContentSize) != newMaxOff)
+				elog(ERROR, "failed to recompress posting tree page in \"%s\"",
+					 RelationGetRelationName(gvs->index));
 
 			START_CRIT_SECTION();
 
-			if (newMaxOff > 0)
-				memcpy(GinDataPageGetData(page), cleaned, sizeof(ItemPointerData) * newMaxOff);
-			pfree(cleaned);
-			GinPageGetOpaque(page)->maxoff = newMaxOff;
+			PageRestoreTempPage(newpage, page);
 
 			MarkBufferDirty(buffer);
 			xlogVacuumPage(gvs->index, buffer);
@@ -207,6 +217,8 @@ ginVacuumPostingTreeLeaves(GinVacuumState *gvs, BlockNumber blkno, bool isRoot,
 			if (!isRoot && GinPageGetOpaque(page)->maxoff < FirstOffsetNumber)
 				hasVoidPage = TRUE;
 		}
+
+		pfree(items);
 	}
 	else
 	{
@@ -524,14 +536,15 @@ ginVacuumEntryPage(GinVacuumState *gvs, Buffer buffer, BlockNumber *roots, uint3
 		}
 		else if (GinGetNPosting(itup) > 0)
 		{
-			/*
-			 * if we already create temporary page, we will make changes in
-			 * place
-			 */
-			ItemPointerData *cleaned = (tmppage == origpage) ? NULL : GinGetPosting(itup);
-			uint32		newN = ginVacuumPostingList(gvs, GinGetPosting(itup), GinGetNPosting(itup), &cleaned);
+			ItemPointerData *items;
+			int			nitems;
+			uint32		newN;
+
+			/* vacuum the decoded items in place */
+			items = ginReadTuple(itup, &nitems);
+			newN = ginVacuumPostingList(gvs, items, nitems, &items);
 
-			if (GinGetNPosting(itup) != newN)
+			if (nitems != newN)
 			{
 				Datum		value;
 				OffsetNumber attnum;
@@ -549,15 +562,6 @@ ginVacuumEntryPage(GinVacuumState *gvs, Buffer buffer, BlockNumber *roots, uint3
 					 */
 					tmppage = PageGetTempPageCopy(origpage);
 
-					if (newN > 0)
-					{
-						Size		pos = ((char *) GinGetPosting(itup)) - ((char *) origpage);
-
-						memcpy(tmppage + pos, cleaned, sizeof(ItemPointerData) * newN);
-					}
-
-					pfree(cleaned);
-
 					/* set itup pointer to new page */
 					itup = (IndexTuple) PageGetItem(tmppage, PageGetItemId(tmppage, i));
 				}
@@ -565,7 +569,7 @@ ginVacuumEntryPage(GinVacuumState *gvs, Buffer buffer, BlockNumber *roots, uint3
 				value = gin_index_getattr(&gvs->ginstate, itup);
 				attnum = gintuple_get_attrnum(&gvs->ginstate, itup);
 				itup = GinFormTuple(gvs->index, &gvs->ginstate, attnum, value,
-									GinGetPosting(itup), newN, true);
+									items, newN, true);
 				PageIndexTupleDelete(tmppage, i);
 
 				if (PageAddItem(tmppage, (Item) itup, IndexTupleSize(itup), i, false, false) != i)
@@ -574,6 +578,7 @@ ginVacuumEntryPage(GinVacuumState *gvs, Buffer buffer, BlockNumber *roots, uint3
 
 				pfree(itup);
 			}
+			pfree(items);
 		}
 	}
 
@@ -102,7 +102,7 @@ static void
 ginRedoCreatePTree(XLogRecPtr lsn, XLogRecord *record)
 {
 	ginxlogCreatePostingTree *data = (ginxlogCreatePostingTree *) XLogRecGetData(record);
-	ItemPointerData *items = (ItemPointerData *) (XLogRecGetData(record) + sizeof(ginxlogCreatePostingTree));
+	char	   *ptr = XLogRecGetData(record) + sizeof(ginxlogCreatePostingTree);
 	Buffer		buffer;
 	Page		page;
 
@@ -111,7 +111,8 @@ ginRedoCreatePTree(XLogRecPtr lsn, XLogRecord *record)
 	page = (Page) BufferGetPage(buffer);
 
 	GinInitBuffer(buffer, GIN_DATA | GIN_LEAF);
-	memcpy(GinDataPageGetData(page), items, sizeof(ItemPointerData) * data->nitem);
+	memcpy(GinDataLeafPageGetPostingList(page), ptr, data->size);
+	GinDataLeafPageSetPostingListSize(page, data->size);
 	GinPageGetOpaque(page)->maxoff = data->nitem;
 
 	PageSetLSN(page, lsn);
@@ -145,14 +146,32 @@ ginRedoInsert(XLogRecPtr lsn, XLogRecord *record)
 		{
 			if (data->isLeaf)
 			{
-				OffsetNumber i;
 				ItemPointerData *items = (ItemPointerData *) (XLogRecGetData(record) + sizeof(ginxlogInsert));
+				ItemPointerData *olditems;
+				ItemPointerData *newitems;
+				int			nold;
+				uint32		nnew;
 
 				Assert(GinPageIsLeaf(page));
 				Assert(data->updateBlkno == InvalidBlockNumber);
 
-				for (i = 0; i < data->nitem; i++)
-					GinDataPageAddItem(page, items + i, data->offset + i);
+				/*
+				 * The record carries only the new items; merge them into the
+				 * page's items and recompress, just as dataPlaceToPage did.
+				 */
+				olditems = GinDataLeafPageGetItems(page, &nold, NULL);
+				newitems = (ItemPointerData *)
+					palloc(sizeof(ItemPointerData) * (nold + data->nitem));
+				nnew = MergeItemPointers(newitems, olditems, nold,
+										 items, data->nitem);
+
+				if (GinDataLeafPageSetItems(page, newitems, nnew,
+											GinDataLeafMaxContentSize) != nnew)
+					elog(ERROR, "failed to add items to posting tree page in %u/%u/%u",
+						 data->node.spcNode, data->node.dbNode, data->node.relNode);
+
+				pfree(olditems);
+				pfree(newitems);
 			}
 			else
 			{
@@ -257,31 +276,54 @@ ginRedoSplit(XLogRecPtr lsn, XLogRecord *record)
 	GinPageGetOpaque(lpage)->rightlink = BufferGetBlockNumber(rbuffer);
 	GinPageGetOpaque(rpage)->rightlink = data->rrlink;
 
-	if (data->isData)
+	if (data->isData && data->isLeaf)
+	{
+		char	   *ptr = XLogRecGetData(record) + sizeof(ginxlogSplit);
+		ItemPointer bound;
+		ItemPointer items;
+		int			nitems;
+
+		/* the record carries both pages' compressed contents */
+		memcpy(GinDataLeafPageGetPostingList(lpage), ptr, data->lsize);
+		GinDataLeafPageSetPostingListSize(lpage, data->lsize);
+		GinPageGetOpaque(lpage)->maxoff = data->separator;
+		ptr += data->lsize;
+
+		memcpy(GinDataLeafPageGetPostingList(rpage), ptr, data->rsize);
+		GinDataLeafPageSetPostingListSize(rpage, data->rsize);
+		GinPageGetOpaque(rpage)->maxoff = data->nitem - data->separator;
+
+		/* set up right key */
+		items = GinDataLeafPageGetItems(lpage, &nitems, NULL);
+		Assert(nitems > 0);
+		bound = GinDataPageGetRightBound(lpage);
+		*bound = items[nitems - 1];
+		pfree(items);
+
+		bound = GinDataPageGetRightBound(rpage);
+		*bound = data->rightbound;
+	}
+	else if (data->isData)
 	{
 		char	   *ptr = XLogRecGetData(record) + sizeof(ginxlogSplit);
-		Size		sizeofitem = GinSizeOfItem(lpage);
 		OffsetNumber i;
 		ItemPointer bound;
 
 		for (i = 0; i < data->separator; i++)
 		{
 			GinDataPageAddItem(lpage, ptr, InvalidOffsetNumber);
-			ptr += sizeofitem;
+			ptr += sizeof(PostingItem);
 		}
 
 		for (i = data->separator; i < data->nitem; i++)
 		{
 			GinDataPageAddItem(rpage, ptr, InvalidOffsetNumber);
-			ptr += sizeofitem;
+			ptr += sizeof(PostingItem);
 		}
 
 		/* set up right key */
 		bound = GinDataPageGetRightBound(lpage);
-		if (data->isLeaf)
-			*bound = *(ItemPointerData *) GinDataPageGetItem(lpage, GinPageGetOpaque(lpage)->maxoff);
-		else
-			*bound = ((PostingItem *) GinDataPageGetItem(lpage, GinPageGetOpaque(lpage)->maxoff))->key;
+		*bound = ((PostingItem *) GinDataPageGetItem(lpage, GinPageGetOpaque(lpage)->maxoff))->key;
 
 		bound = GinDataPageGetRightBound(rpage);
 		*bound = data->rightbound;
@@ -367,8 +409,11 @@ ginRedoVacuumPage(XLogRecPtr lsn, XLogRecord *record)
 
 	if (GinPageIsData(page))
 	{
-		memcpy(GinDataPageGetData(page), XLogRecGetData(record) + sizeof(ginxlogVacuumPage),
-			   GinSizeOfItem(page) *data->nitem);
+		Size		len = record->xl_len - sizeof(ginxlogVacuumPage);
+
+		memcpy(GinDataLeafPageGetPostingList(page),
+			   XLogRecGetData(record) + sizeof(ginxlogVacuumPage), len);
+		GinDataLeafPageSetPostingListSize(page, len);
 		GinPageGetOpaque(page)->maxoff = data->nitem;
 	}
 	else
@@ -770,8 +815,14 @@ ginContinueSplit(ginIncompleteSplit *split)
 
 		PostingItemSetBlockNumber(&(btree.pitem), split->leftBlkno);
 		if (GinPageIsLeaf(page))
-			btree.pitem.key = *(ItemPointerData *) GinDataPageGetItem(page,
-											 GinPageGetOpaque(page)->maxoff);
+		{
+			ItemPointer items;
+			int			nitems;
+
+			items = GinDataLeafPageGetItems(page, &nitems, NULL);
+			btree.pitem.key = items[nitems - 1];
+			pfree(items);
+		}
 		else
 			btree.pitem.key = ((PostingItem *) GinDataPageGetItem(page,
 									   GinPageGetOpaque(page)->maxoff))->key;
@@ -0,0 +1,624 @@
+/*-------------------------------------------------------------------------
+ *
+ * gistbuild.c
+ *	  build algorithm for GiST indexes implementation.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/genam.h"
+#include "access/gist_private.h"
+#include "catalog/index.h"
+#include "miscadmin.h"
+#include "optimizer/cost.h"
+#include "storage/bufmgr.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/* Step of index tuples for check whether to switch to buffering build mode */
+#define BUFFERING_MODE_SWITCH_CHECK_STEP 256
+
+/*
+ * Number of tuples to process in the slow way before switching to buffering
+ * mode, when buffering is explicitly turned on.  Also, the number of tuples
+ * to process between readjusting the buffer size parameter, while in
+ * buffering mode.
+ */
+#define BUFFERING_MODE_TUPLE_SIZE_STATS_TARGET 4096
+
+typedef enum
+{
+	GIST_BUFFERING_DISABLED,	/* in regular build mode and aren't going to
+								 * switch */
+	GIST_BUFFERING_AUTO,		/* in regular build mode, but will switch to
+								 * buffering build mode if the index grows
+								 * too big */
+	GIST_BUFFERING_STATS,		/* gathering statistics of index tuple size
+								 * before switching to the buffering build
+								 * mode */
+	GIST_BUFFERING_ACTIVE		/* in buffering build mode */
+} GistBufferingMode;
+
+/* Working state for gistbuild and its callback */
+typedef struct
+{
+	Relation	indexrel;
+	GISTSTATE	giststate;
+	int			numindexattrs;
+	double		indtuples;		/* number of tuples indexed */
+	double		indtuplesSize;	/* total size of all indexed tuples */
+	Size		freespace;		/* amount of free space to leave on pages */
+	MemoryContext tmpCtx;
+
+	GistBufferingMode bufferingMode;
+	GISTBuildBuffers *gfbb;		/* node buffers, in buffering mode */
+	int			rootlevel;		/* level of the root page, leaves are 0 */
+	bool		bufferOverflowed;	/* did a buffer overflow while emptying
+									 * its parent? */
+} GISTBuildState;
+
+static void gistbuildCallback(Relation index,
+				  HeapTuple htup,
+				  Datum *values,
+				  bool *isnull,
+				  bool tupleIsAlive,
+				  void *state);
+static void gistInitBuffering(GISTBuildState *buildstate);
+static int	gistGetRootLevel(Relation index);
+static void gistBufferingRouteTuple(GISTBuildState *buildstate,
+						IndexTuple itup, int startLevel);
+static void gistProcessEmptyingQueue(GISTBuildState *buildstate);
+static void gistEmptyAllBuffers(GISTBuildState *buildstate);
+
+
+/*
+ * Routine to build an index.
+ *
+ * Tuples are inserted one at a time, like regular insertions do, until the
+ * index grows larger than effective_cache_size.  After that point random
+ * insertions would make the build I/O bound, so we switch to the buffering
+ * algorithm (see gist_private.h and the README), which instead pushes tuples
+ * down the tree in batches.  The "buffering" reloption can be used to force
+ * buffering on or off.
+ */
+Datum
+gistbuild(PG_FUNCTION_ARGS)
+{
+	Relation	heap = (Relation) PG_GETARG_POINTER(0);
+	Relation	index = (Relation) PG_GETARG_POINTER(1);
+	IndexInfo  *indexInfo = (IndexInfo *) PG_GETARG_POINTER(2);
+	IndexBuildResult *result;
+	double		reltuples;
+	GISTBuildState buildstate;
+	Buffer		buffer;
+	Page		page;
+
+	/*
+	 * We expect to be called exactly once for any index relation. If that's
+	 * not the case, big trouble's what we have.
+	 */
+	if (RelationGetNumberOfBlocks(index) != 0)
+		elog(ERROR, "index \"%s\" already contains data",
+			 RelationGetRelationName(index));
+
+	buildstate.indexrel = index;
+
+	/* determine whether to use the buffering build */
+	if (index->rd_options)
+	{
+		GiSTOptions *options = (GiSTOptions *) index->rd_options;
+		char	   *bufferingMode = (char *) options + options->bufferingModeOffset;
+
+		if (strcmp(bufferingMode, "on") == 0)
+			buildstate.bufferingMode = GIST_BUFFERING_STATS;
+		else if (strcmp(bufferingMode, "off") == 0)
+			buildstate.bufferingMode = GIST_BUFFERING_DISABLED;
+		else
+			buildstate.bufferingMode = GIST_BUFFERING_AUTO;
+	}
+	else
+		buildstate.bufferingMode = GIST_BUFFERING_AUTO;
+
+	/* no locking is needed */
+	initGISTstate(&buildstate.giststate, index);
+
+	/* initialize the root page */
+	buffer = gistNewBuffer(index);
+	Assert(BufferGetBlockNumber(buffer) == GIST_ROOT_BLKNO);
+	page = BufferGetPage(buffer);
+
+	START_CRIT_SECTION();
+
+	GISTInitBuffer(buffer, F_LEAF);
+
+	MarkBufferDirty(buffer);
+
+	if (!index->rd_istemp)
+	{
+		XLogRecPtr	recptr;
+		XLogRecData rdata;
+
+		rdata.data = (char *) &(index->rd_node);
+		rdata.len = sizeof(RelFileNode);
+		rdata.buffer = InvalidBuffer;
+		rdata.next = NULL;
+
+		recptr = XLogInsert(RM_GIST_ID, XLOG_GIST_CREATE_INDEX, &rdata);
+		PageSetLSN(page, recptr);
+		PageSetTLI(page, ThisTimeLineID);
+	}
+	else
+		PageSetLSN(page, XLogRecPtrForTemp);
+
+	UnlockReleaseBuffer(buffer);
+
+	END_CRIT_SECTION();
+
+	/* build the index */
+	buildstate.numindexattrs = indexInfo->ii_NumIndexAttrs;
+	buildstate.indtuples = 0;
+	buildstate.indtuplesSize = 0;
+	buildstate.gfbb = NULL;
+	buildstate.rootlevel = 0;
+	buildstate.bufferOverflowed = false;
+
+	/*
+	 * In this path we respect the fillfactor setting, whereas insertions
+	 * after initial build do not.
+	 */
+	buildstate.freespace = RelationGetTargetPageFreeSpace(index,
+													  GIST_DEFAULT_FILLFACTOR);
+
+	/*
+	 * create a temporary memory context that is reset once for each tuple
+	 * inserted into the index
+	 */
+	buildstate.tmpCtx = createTempGistContext();
+
+	/* do the heap scan */
+	reltuples = IndexBuildHeapScan(heap, index, indexInfo, true,
+								   gistbuildCallback, (void *) &buildstate);
+
+	/*
+	 * If buffering was used, flush out all the tuples that are still in the
+	 * buffers.
+	 */
+	if (buildstate.bufferingMode == GIST_BUFFERING_ACTIVE)
+	{
+		elog(DEBUG1, "all tuples processed, emptying buffers");
+		gistEmptyAllBuffers(&buildstate);
+		gistFreeBuildBuffers(buildstate.gfbb);
+	}
+
+	/* okay, all heap tuples are indexed */
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	freeGISTstate(&buildstate.giststate);
+
+	/*
+	 * Return statistics
+	 */
+	result = (IndexBuildResult *) palloc(sizeof(IndexBuildResult));
+
+	result->heap_tuples = reltuples;
+	result->index_tuples = buildstate.indtuples;
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Validator for "buffering" reloption on GiST indexes. Allows "on", "off"
+ * and "auto" values.
+ */
+void
+gistValidateBufferingOption(char *value)
+{
+	if (value == NULL ||
+		(strcmp(value, "on") != 0 &&
+		 strcmp(value, "off") != 0 &&
+		 strcmp(value, "auto") != 0))
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid value for \"buffering\" option"),
+			  errdetail("Valid values are \"on\", \"off\", and \"auto\".")));
+	}
+}
+
+/*
+ * Per-tuple callback from IndexBuildHeapScan
+ */
+static void
+gistbuildCallback(Relation index,
+				  HeapTuple htup,
+				  Datum *values,
+				  bool *isnull,
+				  bool tupleIsAlive,
+				  void *state)
+{
+	GISTBuildState *buildstate = (GISTBuildState *) state;
+	IndexTuple	itup;
+	MemoryContext oldCtx;
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+	/* form an index tuple and point it at the heap tuple */
+	itup = gistFormTuple(&buildstate->giststate, index,
+						 values, isnull, true /* size is currently bogus */ );
+	itup->t_tid = htup->t_self;
+
+	/* update tuple count and total size, for the buffering parameters */
+	buildstate->indtuples += 1;
+	buildstate->indtuplesSize += IndexTupleSize(itup);
+
+	if (buildstate->bufferingMode == GIST_BUFFERING_ACTIVE)
+	{
+		/*
+		 * Route the tuple to the topmost node buffer, and empty any buffers
+		 * that became half full as a result.
+		 */
+		gistBufferingRouteTuple(buildstate, itup, INT_MAX);
+		gistProcessEmptyingQueue(buildstate);
+	}
+	else
+	{
+		/*
+		 * Since we already have the index relation locked, we call
+		 * gistdoinsert directly.  Normal access method calls dispatch
+		 * through gistinsert, which locks the relation for write.  This is
+		 * the right thing to do if you're inserting single tups, but not
+		 * when you're initializing the whole index at once.
+		 */
+		gistdoinsert(index, itup, buildstate->freespace,
+					 &buildstate->giststate);
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->tmpCtx);
+
+	/*
+	 * In auto mode, check every now and then whether the index has outgrown
+	 * effective_cache_size, and switch to buffering mode if so.  When
+	 * buffering was requested explicitly, switch as soon as we have seen
+	 * enough tuples to estimate their average size.
+	 */
+	if ((buildstate->bufferingMode == GIST_BUFFERING_AUTO &&
+		 fmod(buildstate->indtuples, BUFFERING_MODE_SWITCH_CHECK_STEP) == 0 &&
+		 effective_cache_size < RelationGetNumberOfBlocks(index)) ||
+		(buildstate->bufferingMode == GIST_BUFFERING_STATS &&
+		 buildstate->indtuples >= BUFFERING_MODE_TUPLE_SIZE_STATS_TARGET))
+	{
+		gistInitBuffering(buildstate);
+	}
+}
+
+/*
+ * Switch to the buffering build mode.
+ *
+ * The distance between buffered levels (levelStep) is chosen so that a
+ * subtree of levelStep levels fits comfortably in effective_cache_size, and
+ * so that one page for each buffer on the bottom level of such a subtree
+ * fits in maintenance_work_mem.  That way, emptying a buffer touches only
+ * pages that stay cached, and all the buffers it pushes tuples to can be
+ * kept loaded at the same time.
+ */
+static void
+gistInitBuffering(GISTBuildState *buildstate)
+{
+	Relation	index = buildstate->indexrel;
+	int			pagesPerBuffer;
+	Size		pageFreeSpace;
+	Size		itupAvgSize,
+				itupMinSize;
+	double		avgIndexTuplesPerPage,
+				maxIndexTuplesPerPage;
+	int			i;
+	int			levelStep;
+
+	/* space available for index tuples on a page, after fillfactor */
+	pageFreeSpace = BLCKSZ - SizeOfPageHeaderData - sizeof(GISTPageOpaqueData)
+		- buildstate->freespace;
+
+	/*
+	 * Estimate the average size of an index tuple from the tuples seen so
+	 * far, and the minimum size from the tuple descriptor.
+	 */
+	itupAvgSize = (Size) ceil(buildstate->indtuplesSize /
+							  buildstate->indtuples) + sizeof(ItemIdData);
+
+	itupMinSize = (Size) MAXALIGN(sizeof(IndexTupleData));
+	for (i = 0; i < index->rd_att->natts; i++)
+	{
+		if (index->rd_att->attrs[i]->attlen < 0)
+			itupMinSize += VARHDRSZ;
+		else
+			itupMinSize += index->rd_att->attrs[i]->attlen;
+	}
+	itupMinSize += sizeof(ItemIdData);
+
+	avgIndexTuplesPerPage = pageFreeSpace / itupAvgSize;
+	maxIndexTuplesPerPage = pageFreeSpace / itupMinSize;
+
+	levelStep = 1;
+	for (;;)
+	{
+		double		subtreesize;
+		double		maxlowestlevelpages;
+
+		/* number of pages in an average subtree of levelStep levels */
+		subtreesize =
+			(1 - pow(avgIndexTuplesPerPage, (double) (levelStep + 1))) /
+			(1 - avgIndexTuplesPerPage);
+
+		/* maximum number of pages on the bottom level of such a subtree */
+		maxlowestlevelpages = pow(maxIndexTuplesPerPage, (double) levelStep);
+
+		/* the subtree must fit in cache, with a safety factor of 4 */
+		if (subtreesize > effective_cache_size / 4)
+			break;
+
+		/* and each bottom-level buffer needs one page of memory */
+		if (maxlowestlevelpages > ((double) maintenance_work_mem * 1024) / BLCKSZ)
+			break;
+
+		levelStep++;
+	}
+	levelStep--;
+
+	/*
+	 * If there's not enough cache or maintenance_work_mem for even a single
+	 * level, buffering can't help.  Honor an explicit "buffering = on"
+	 * anyway, using the smallest possible step.
+	 */
+	if (levelStep <= 0)
+	{
+		if (buildstate->bufferingMode == GIST_BUFFERING_AUTO)
+		{
+			elog(DEBUG1, "failed to switch to buffered GiST build");
+			buildstate->bufferingMode = GIST_BUFFERING_DISABLED;
+			return;
+		}
+		levelStep = 1;
+	}
+
+	/*
+	 * A buffer holds enough tuples to fill, on average, twice the pages on
+	 * the bottom level of the subtree it feeds.
+	 */
+	pagesPerBuffer = (int) (2 * pow(avgIndexTuplesPerPage, levelStep));
+	if (pagesPerBuffer < 2)
+		pagesPerBuffer = 2;
+
+	buildstate->gfbb = gistInitBuildBuffers(pagesPerBuffer, levelStep);
+	buildstate->rootlevel = gistGetRootLevel(index);
+	buildstate->bufferingMode = GIST_BUFFERING_ACTIVE;
+
+	elog(DEBUG1, "switched to buffered GiST build; level step = %d, pagesPerBuffer = %d",
+		 levelStep, pagesPerBuffer);
+}
+
+/*
+ * Find the level of the root page, by walking down the leftmost path of
+ * the tree.  Leaf pages are on level 0.
+ */
+static int
+gistGetRootLevel(Relation index)
+{
+	BlockNumber blkno = GIST_ROOT_BLKNO;
+	int			level = 0;
+
+	for (;;)
+	{
+		Buffer		buffer;
+		Page		page;
+		IndexTuple	itup;
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, GIST_SHARE);
+		gistcheckpage(index, buffer);
+		page = (Page) BufferGetPage(buffer);
+
+		if (GistPageIsLeaf(page))
+		{
+			UnlockReleaseBuffer(buffer);
+			break;
+		}
+
+		itup = (IndexTuple) PageGetItem(page,
+									  PageGetItemId(page, FirstOffsetNumber));
+		blkno = ItemPointerGetBlockNumber(&(itup->t_tid));
+		UnlockReleaseBuffer(buffer);
+
+		level++;
+	}
+
+	return level;
+}
+
+/*
+ * Route an index tuple down the tree, in buffering mode.
+ *
+ * The tuple is placed in the buffer of the page on the highest buffered
+ * level that is below startLevel.  If there is no such level, ie. the
+ * tuple comes from a buffer on the lowest buffered level or the tree is
+ * not tall enough to have buffers, it is inserted into the leaf level
+ * right away.
+ *
+ * Routing always starts from the root, using the current downlink keys, so
+ * that page splits that happened after a tuple was buffered are taken into
+ * account.  The upper levels of the tree are small enough to stay cached.
+ */
+static void
+gistBufferingRouteTuple(GISTBuildState *buildstate, IndexTuple itup,
+						int startLevel)
+{
+	GISTBuildBuffers *gfbb = buildstate->gfbb;
+	Relation	index = buildstate->indexrel;
+	GISTNodeBuffer *nodeBuffer;
+	BlockNumber blkno;
+	int			targetLevel;
+	int			level;
+
+	/* the root page never has a buffer */
+	targetLevel = Min(startLevel, buildstate->rootlevel) - 1;
+	if (targetLevel > 0)
+		targetLevel -= targetLevel % gfbb->levelStep;
+
+	if (targetLevel <= 0)
+	{
+		if (gistdoinsert(index, itup, buildstate->freespace,
+						 &buildstate->giststate))
+			buildstate->rootlevel++;
+		return;
+	}
+
+	/* walk down to the target level */
+	blkno = GIST_ROOT_BLKNO;
+	for (level = buildstate->rootlevel; level > targetLevel; level--)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber childoffnum;
+		IndexTuple	idxtuple;
+
+		buffer = ReadBuffer(index, blkno);
+		LockBuffer(buffer, GIST_SHARE);
+		gistcheckpage(index, buffer);
+		page = (Page) BufferGetPage(buffer);
+
+		if (GistPageIsLeaf(page))
+			elog(ERROR, "unexpected leaf page %u on level %d in index \"%s\"",
+				 blkno, level, RelationGetRelationName(index));
+
+		childoffnum = gistchoose(index, page, itup, &buildstate->giststate);
+		idxtuple = (IndexTuple) PageGetItem(page,
+											PageGetItemId(page, childoffnum));
+		blkno = ItemPointerGetBlockNumber(&(idxtuple->t_tid));
+		UnlockReleaseBuffer(buffer);
+	}
+
+	nodeBuffer = gistGetNodeBuffer(gfbb, blkno, targetLevel);
+	gistPushItupToNodeBuffer(gfbb, nodeBuffer, itup);
+
+	if (BUFFER_HALF_FILLED(nodeBuffer, gfbb) && !nodeBuffer->queuedForEmptying)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(gfbb->context);
+
+		/* lower buffers go first, so that they are emptied before they grow */
+		gfbb->bufferEmptyingQueue = lcons(nodeBuffer,
+										  gfbb->bufferEmptyingQueue);
+		nodeBuffer->queuedForEmptying = true;
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	if (BUFFER_OVERFLOWED(nodeBuffer, gfbb))
+		buildstate->bufferOverflowed = true;
+}
+
+/*
+ * Empty the buffers in the emptying queue, until the queue is empty.
+ *
+ * Emptying a buffer moves its tuples one buffered level down.  If one of
+ * the receiving buffers overflows, we stop and empty that one first; the
+ * partially emptied buffer is requeued if it's still half full.  Must be
+ * called in the per-tuple memory context.
+ */
+static void
+gistProcessEmptyingQueue(GISTBuildState *buildstate)
+{
+	GISTBuildBuffers *gfbb = buildstate->gfbb;
+
+	while (gfbb->bufferEmptyingQueue != NIL)
+	{
+		GISTNodeBuffer *emptyingNodeBuffer;
+
+		emptyingNodeBuffer = (GISTNodeBuffer *) linitial(gfbb->bufferEmptyingQueue);
+		gfbb->bufferEmptyingQueue = list_delete_first(gfbb->bufferEmptyingQueue);
+		emptyingNodeBuffer->queuedForEmptying = false;
+
+		/*
+		 * Only the buffers fed by this one need to stay in memory while it
+		 * is emptied, so write out the others.
+		 */
+		gistUnloadNodeBuffers(gfbb);
+
+		buildstate->bufferOverflowed = false;
+		while (!buildstate->bufferOverflowed)
+		{
+			IndexTuple	itup;
+
+			if (!gistPopItupFromNodeBuffer(gfbb, emptyingNodeBuffer, &itup))
+				break;
+
+			gistBufferingRouteTuple(buildstate, itup, emptyingNodeBuffer->level);
+
+			MemoryContextReset(buildstate->tmpCtx);
+		}
+
+		if (BUFFER_HALF_FILLED(emptyingNodeBuffer, gfbb) &&
+			!emptyingNodeBuffer->queuedForEmptying)
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(gfbb->context);
+
+			gfbb->bufferEmptyingQueue = lappend(gfbb->bufferEmptyingQueue,
+												emptyingNodeBuffer);
+			emptyingNodeBuffer->queuedForEmptying = true;
+			MemoryContextSwitchTo(oldcxt);
+		}
+	}
+}
+
+/*
+ * Empty all the node buffers, at the end of the build.  Buffers are
+ * processed from the top level down, so that each level has received all
+ * its tuples before it is emptied.
+ */
+static void
+gistEmptyAllBuffers(GISTBuildState *buildstate)
+{
+	GISTBuildBuffers *gfbb = buildstate->gfbb;
+	MemoryContext oldCtx;
+	int			level;
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+	for (level = gfbb->buffersOnLevelsLen - 1; level > 0; level--)
+	{
+		while (gfbb->buffersOnLevels[level] != NIL)
+		{
+			GISTNodeBuffer *nodeBuffer;
+
+			nodeBuffer = (GISTNodeBuffer *) linitial(gfbb->buffersOnLevels[level]);
+
+			/* the buffer may have been left partially emptied, so loop */
+			while (nodeBuffer->blocksCount > 0)
+			{
+				if (!nodeBuffer->queuedForEmptying)
+				{
+					MemoryContextSwitchTo(gfbb->context);
+					gfbb->bufferEmptyingQueue = lcons(nodeBuffer,
+												gfbb->bufferEmptyingQueue);
+					nodeBuffer->queuedForEmptying = true;
+					MemoryContextSwitchTo(buildstate->tmpCtx);
+				}
+				gistProcessEmptyingQueue(buildstate);
+			}
+
+			gfbb->buffersOnLevels[level] =
+				list_delete_first(gfbb->buffersOnLevels[level]);
+		}
+		elog(DEBUG2, "emptied all buffers at level %d", level);
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+}
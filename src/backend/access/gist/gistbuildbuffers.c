@@ -0,0 +1,361 @@
+/*-------------------------------------------------------------------------
+ *
+ * gistbuildbuffers.c
+ *	  node buffer management for the GiST buffering build algorithm.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/gist_private.h"
+#include "storage/buffile.h"
+#include "utils/memutils.h"
+
+static GISTNodeBufferPage *gistAllocateNewPageBuffer(GISTBuildBuffers *gfbb);
+static void gistLoadNodeBuffer(GISTBuildBuffers *gfbb,
+				   GISTNodeBuffer *nodeBuffer);
+static void gistUnloadNodeBuffer(GISTBuildBuffers *gfbb,
+					 GISTNodeBuffer *nodeBuffer);
+static long gistBuffersGetFreeBlock(GISTBuildBuffers *gfbb);
+static void gistBuffersReleaseBlock(GISTBuildBuffers *gfbb, long blocknum);
+static void ReadTempFileBlock(BufFile *file, long blknum, void *ptr);
+static void WriteTempFileBlock(BufFile *file, long blknum, void *ptr);
+
+
+/*
+ * Initialize the node buffers of a buffering build.  All the working
+ * memory is allocated in the current memory context.
+ */
+GISTBuildBuffers *
+gistInitBuildBuffers(int pagesPerBuffer, int levelStep)
+{
+	GISTBuildBuffers *gfbb;
+	HASHCTL		hashCtl;
+
+	gfbb = palloc0(sizeof(GISTBuildBuffers));
+	gfbb->context = CurrentMemoryContext;
+	gfbb->pagesPerBuffer = pagesPerBuffer;
+	gfbb->levelStep = levelStep;
+
+	/* the temporary file is deleted automatically at end of transaction */
+	gfbb->pfile = BufFileCreateTemp(false);
+	gfbb->nFileBlocks = 0;
+
+	gfbb->nFreeBlocks = 0;
+	gfbb->freeBlocksLen = 32;
+	gfbb->freeBlocks = (long *) palloc(gfbb->freeBlocksLen * sizeof(long));
+
+	MemSet(&hashCtl, 0, sizeof(hashCtl));
+	hashCtl.keysize = sizeof(BlockNumber);
+	hashCtl.entrysize = sizeof(GISTNodeBuffer);
+	hashCtl.hash = tag_hash;
+	hashCtl.hcxt = CurrentMemoryContext;
+	gfbb->nodeBuffersTab = hash_create("gistbuildbuffers",
+									   1024,
+									   &hashCtl,
+									   HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	gfbb->bufferEmptyingQueue = NIL;
+
+	gfbb->buffersOnLevelsLen = 1;
+	gfbb->buffersOnLevels = (List **) palloc(sizeof(List *) *
+											 gfbb->buffersOnLevelsLen);
+	gfbb->buffersOnLevels[0] = NIL;
+
+	gfbb->loadedBuffersLen = 32;
+	gfbb->loadedBuffers = (GISTNodeBuffer **) palloc(gfbb->loadedBuffersLen *
+												   sizeof(GISTNodeBuffer *));
+	gfbb->loadedBuffersCount = 0;
+
+	return gfbb;
+}
+
+/*
+ * Return the node buffer of the given index page, creating an empty one
+ * if it doesn't exist yet.
+ */
+GISTNodeBuffer *
+gistGetNodeBuffer(GISTBuildBuffers *gfbb, BlockNumber nodeBlocknum, int level)
+{
+	GISTNodeBuffer *nodeBuffer;
+	bool		found;
+
+	nodeBuffer = (GISTNodeBuffer *) hash_search(gfbb->nodeBuffersTab,
+												(const void *) &nodeBlocknum,
+												HASH_ENTER,
+												&found);
+	if (!found)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(gfbb->context);
+
+		nodeBuffer->blocksCount = 0;
+		nodeBuffer->pageBlocknum = InvalidBlockNumber;
+		nodeBuffer->pageBuffer = NULL;
+		nodeBuffer->queuedForEmptying = false;
+		nodeBuffer->level = level;
+
+		/* remember the buffer in the list of buffers on its level */
+		if (level >= gfbb->buffersOnLevelsLen)
+		{
+			int			i;
+
+			gfbb->buffersOnLevels =
+				(List **) repalloc(gfbb->buffersOnLevels,
+								   (level + 1) * sizeof(List *));
+			for (i = gfbb->buffersOnLevelsLen; i <= level; i++)
+				gfbb->buffersOnLevels[i] = NIL;
+			gfbb->buffersOnLevelsLen = level + 1;
+		}
+		gfbb->buffersOnLevels[level] = lcons(nodeBuffer,
+											 gfbb->buffersOnLevels[level]);
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	else
+		Assert(nodeBuffer->level == level);
+
+	return nodeBuffer;
+}
+
+/*
+ * Allocate an empty in-memory buffer page.
+ */
+static GISTNodeBufferPage *
+gistAllocateNewPageBuffer(GISTBuildBuffers *gfbb)
+{
+	GISTNodeBufferPage *pageBuffer;
+
+	pageBuffer = (GISTNodeBufferPage *) MemoryContextAlloc(gfbb->context,
+														   BLCKSZ);
+	pageBuffer->prev = InvalidBlockNumber;
+	pageBuffer->freespace = PAGE_FREE_SPACE_EMPTY;
+	return pageBuffer;
+}
+
+/*
+ * Bring the last page of a node buffer into memory.  The temp file block
+ * it was stored in is released, the page will be written to a new block
+ * when the buffer is unloaded.
+ */
+static void
+gistLoadNodeBuffer(GISTBuildBuffers *gfbb, GISTNodeBuffer *nodeBuffer)
+{
+	Assert(nodeBuffer->pageBuffer == NULL);
+
+	nodeBuffer->pageBuffer = gistAllocateNewPageBuffer(gfbb);
+	if (nodeBuffer->blocksCount > 0)
+	{
+		ReadTempFileBlock(gfbb->pfile, nodeBuffer->pageBlocknum,
+						  nodeBuffer->pageBuffer);
+		gistBuffersReleaseBlock(gfbb, nodeBuffer->pageBlocknum);
+		nodeBuffer->pageBlocknum = InvalidBlockNumber;
+	}
+
+	/* remember the buffer so that gistUnloadNodeBuffers can find it */
+	if (gfbb->loadedBuffersCount >= gfbb->loadedBuffersLen)
+	{
+		gfbb->loadedBuffersLen *= 2;
+		gfbb->loadedBuffers = (GISTNodeBuffer **)
+			repalloc(gfbb->loadedBuffers,
+					 gfbb->loadedBuffersLen * sizeof(GISTNodeBuffer *));
+	}
+	gfbb->loadedBuffers[gfbb->loadedBuffersCount++] = nodeBuffer;
+}
+
+/*
+ * Write the in-memory last page of a node buffer out to the temp file.
+ */
+static void
+gistUnloadNodeBuffer(GISTBuildBuffers *gfbb, GISTNodeBuffer *nodeBuffer)
+{
+	if (nodeBuffer->pageBuffer == NULL)
+		return;
+
+	if (!PAGE_IS_EMPTY(nodeBuffer->pageBuffer))
+	{
+		long		blkno = gistBuffersGetFreeBlock(gfbb);
+
+		WriteTempFileBlock(gfbb->pfile, blkno, nodeBuffer->pageBuffer);
+		nodeBuffer->pageBlocknum = (BlockNumber) blkno;
+	}
+	else
+		Assert(nodeBuffer->blocksCount == 0);
+
+	pfree(nodeBuffer->pageBuffer);
+	nodeBuffer->pageBuffer = NULL;
+}
+
+/*
+ * Unload all the currently loaded node buffers.
+ */
+void
+gistUnloadNodeBuffers(GISTBuildBuffers *gfbb)
+{
+	int			i;
+
+	for (i = 0; i < gfbb->loadedBuffersCount; i++)
+		gistUnloadNodeBuffer(gfbb, gfbb->loadedBuffers[i]);
+	gfbb->loadedBuffersCount = 0;
+}
+
+/*
+ * Add an index tuple to a node buffer.
+ */
+void
+gistPushItupToNodeBuffer(GISTBuildBuffers *gfbb, GISTNodeBuffer *nodeBuffer,
+						 IndexTuple itup)
+{
+	Size		itupsz = IndexTupleSize(itup);
+	GISTNodeBufferPage *pageBuffer;
+
+	if (MAXALIGN(itupsz) > PAGE_FREE_SPACE_EMPTY)
+		elog(ERROR, "index row size %lu exceeds maximum for GiST node buffer",
+			 (unsigned long) itupsz);
+
+	if (nodeBuffer->pageBuffer == NULL)
+		gistLoadNodeBuffer(gfbb, nodeBuffer);
+	pageBuffer = nodeBuffer->pageBuffer;
+
+	/* if the last page is full, write it out and start a new one */
+	if (PAGE_NO_SPACE(pageBuffer, itup))
+	{
+		long		blkno = gistBuffersGetFreeBlock(gfbb);
+
+		WriteTempFileBlock(gfbb->pfile, blkno, pageBuffer);
+
+		pageBuffer->prev = (BlockNumber) blkno;
+		pageBuffer->freespace = PAGE_FREE_SPACE_EMPTY;
+	}
+
+	if (PAGE_IS_EMPTY(pageBuffer))
+		nodeBuffer->blocksCount++;
+
+	/* tuples are stored from the end of the page towards the beginning */
+	pageBuffer->freespace -= MAXALIGN(itupsz);
+	memcpy(PAGE_FREE_SPACE_PTR(pageBuffer), itup, itupsz);
+}
+
+/*
+ * Remove an index tuple from a node buffer.  The tuple is copied into
+ * palloc'd memory in the caller's context.  Returns false if the buffer
+ * is empty.
+ */
+bool
+gistPopItupFromNodeBuffer(GISTBuildBuffers *gfbb, GISTNodeBuffer *nodeBuffer,
+						  IndexTuple *itup)
+{
+	GISTNodeBufferPage *pageBuffer;
+	IndexTuple	ptr;
+	Size		itupsz;
+
+	if (nodeBuffer->blocksCount <= 0)
+		return false;
+
+	if (nodeBuffer->pageBuffer == NULL)
+		gistLoadNodeBuffer(gfbb, nodeBuffer);
+	pageBuffer = nodeBuffer->pageBuffer;
+	Assert(!PAGE_IS_EMPTY(pageBuffer));
+
+	/* the most recently added tuple is at the lowest offset */
+	ptr = (IndexTuple) PAGE_FREE_SPACE_PTR(pageBuffer);
+	itupsz = IndexTupleSize(ptr);
+	*itup = (IndexTuple) palloc(itupsz);
+	memcpy(*itup, ptr, itupsz);
+	pageBuffer->freespace += MAXALIGN(itupsz);
+
+	if (PAGE_IS_EMPTY(pageBuffer))
+	{
+		BlockNumber prevblkno = pageBuffer->prev;
+
+		nodeBuffer->blocksCount--;
+
+		/* continue with the previous page of the buffer, if any */
+		if (prevblkno != InvalidBlockNumber)
+		{
+			Assert(nodeBuffer->blocksCount > 0);
+			ReadTempFileBlock(gfbb->pfile, prevblkno, pageBuffer);
+			gistBuffersReleaseBlock(gfbb, prevblkno);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Select a currently unused block of the temporary file.
+ */
+static long
+gistBuffersGetFreeBlock(GISTBuildBuffers *gfbb)
+{
+	if (gfbb->nFreeBlocks > 0)
+		return gfbb->freeBlocks[--gfbb->nFreeBlocks];
+
+	return gfbb->nFileBlocks++;
+}
+
+/*
+ * Return a block of the temporary file to the free list.
+ */
+static void
+gistBuffersReleaseBlock(GISTBuildBuffers *gfbb, long blocknum)
+{
+	if (gfbb->nFreeBlocks >= gfbb->freeBlocksLen)
+	{
+		gfbb->freeBlocksLen *= 2;
+		gfbb->freeBlocks = (long *) repalloc(gfbb->freeBlocks,
+											 gfbb->freeBlocksLen *
+											 sizeof(long));
+	}
+	gfbb->freeBlocks[gfbb->nFreeBlocks++] = blocknum;
+}
+
+/*
+ * Release all the resources of the node buffers.
+ */
+void
+gistFreeBuildBuffers(GISTBuildBuffers *gfbb)
+{
+	int			i;
+
+	for (i = 0; i < gfbb->loadedBuffersCount; i++)
+	{
+		GISTNodeBuffer *nodeBuffer = gfbb->loadedBuffers[i];
+
+		if (nodeBuffer->pageBuffer)
+			pfree(nodeBuffer->pageBuffer);
+		nodeBuffer->pageBuffer = NULL;
+	}
+	gfbb->loadedBuffersCount = 0;
+
+	hash_destroy(gfbb->nodeBuffersTab);
+	BufFileClose(gfbb->pfile);
+	gfbb->pfile = NULL;
+}
+
+static void
+ReadTempFileBlock(BufFile *file, long blknum, void *ptr)
+{
+	if (BufFileSeekBlock(file, blknum) != 0)
+		elog(ERROR, "could not seek temporary file: %m");
+	if (BufFileRead(file, ptr, BLCKSZ) != BLCKSZ)
+		elog(ERROR, "could not read temporary file: %m");
+}
+
+static void
+WriteTempFileBlock(BufFile *file, long blknum, void *ptr)
+{
+	if (BufFileSeekBlock(file, blknum) != 0)
+		elog(ERROR, "could not seek temporary file: %m");
+	if (BufFileWrite(file, ptr, BLCKSZ) != BLCKSZ)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write block %ld of temporary file: %m",
+						blknum)));
+}
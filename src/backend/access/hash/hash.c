@@ -22,6 +22,7 @@
 #include "access/relscan.h"
 #include "catalog/index.h"
 #include "commands/vacuum.h"
+#include "miscadmin.h"
 #include "optimizer/cost.h"
 #include "optimizer/plancat.h"
 #include "storage/bufmgr.h"
@@ -234,9 +235,10 @@ hashgettuple(PG_FUNCTION_ARGS)
 		 * An insertion into the current index page could have happened while
 		 * we didn't have read lock on it.  Re-find our position by looking
 		 * for the TID we previously returned.	(Because we hold share lock on
-		 * the bucket, no deletions or splits could have occurred; therefore
-		 * we can expect that the TID still exists in the current index page,
-		 * at an offset >= where we were.)
+		 * the bucket, and on the bucket it's being split from if any, no
+		 * deletions or splits could have occurred; therefore we can expect
+		 * that the TID still exists in the current index page, at an offset
+		 * >= where we were.)
 		 */
 		OffsetNumber maxoffnum;
 
@@ -375,6 +377,9 @@ hashbeginscan(PG_FUNCTION_ARGS)
 	so = (HashScanOpaque) palloc(sizeof(HashScanOpaqueData));
 	so->hashso_bucket_valid = false;
 	so->hashso_bucket_blkno = 0;
+	so->hashso_split_bucket_blkno = 0;
+	so->hashso_bucket_buf = InvalidBuffer;
+	so->hashso_split_bucket_buf = InvalidBuffer;
 	so->hashso_curbuf = InvalidBuffer;
 	/* set position invalid (this will cause _hash_first call) */
 	ItemPointerSetInvalid(&(so->hashso_curpos));
@@ -402,15 +407,8 @@ hashrescan(PG_FUNCTION_ARGS)
 	/* if we are called from beginscan, so is still NULL */
 	if (so)
 	{
-		/* release any pin we still hold */
-		if (BufferIsValid(so->hashso_curbuf))
-			_hash_dropbuf(rel, so->hashso_curbuf);
-		so->hashso_curbuf = InvalidBuffer;
-
-		/* release lock on bucket, too */
-		if (so->hashso_bucket_blkno)
-			_hash_droplock(rel, so->hashso_bucket_blkno, HASH_SHARE);
-		so->hashso_bucket_blkno = 0;
+		/* release any pins and bucket locks we still hold */
+		_hash_dropscanbuf(rel, so);
 
 		/* set position invalid (this will cause _hash_first call) */
 		ItemPointerSetInvalid(&(so->hashso_curpos));
@@ -443,15 +441,8 @@ hashendscan(PG_FUNCTION_ARGS)
 	/* don't need scan registered anymore */
 	_hash_dropscan(scan);
 
-	/* release any pin we still hold */
-	if (BufferIsValid(so->hashso_curbuf))
-		_hash_dropbuf(rel, so->hashso_curbuf);
-	so->hashso_curbuf = InvalidBuffer;
-
-	/* release lock on bucket, too */
-	if (so->hashso_bucket_blkno)
-		_hash_droplock(rel, so->hashso_bucket_blkno, HASH_SHARE);
-	so->hashso_bucket_blkno = 0;
+	/* release any pins and bucket locks we still hold */
+	_hash_dropscanbuf(rel, so);
 
 	pfree(so);
 	scan->opaque = NULL;
@@ -532,6 +523,7 @@ loop_top:
 		BlockNumber bucket_blkno;
 		BlockNumber blkno;
 		bool		bucket_dirty = false;
+		bool		split_pending = false;
 
 		/* Get address of bucket's start page */
 		bucket_blkno = BUCKET_TO_BLKNO(&local_metapage, cur_bucket);
@@ -564,6 +556,9 @@ loop_top:
 			opaque = (HashPageOpaque) PageGetSpecialPointer(page);
 			Assert(opaque->hasho_bucket == cur_bucket);
 
+			if (blkno == bucket_blkno)
+				split_pending = H_BUCKET_SPLIT_PENDING(opaque);
+
 			/* Scan each tuple in page */
 			maxoffno = PageGetMaxOffsetNumber(page);
 			for (offno = FirstOffsetNumber;
@@ -593,16 +588,61 @@ loop_top:
 
 			if (ndeletable > 0)
 			{
+				/* No ereport(ERROR) until changes are logged */
+				START_CRIT_SECTION();
+
 				PageIndexMultiDelete(page, deletable, ndeletable);
-				_hash_wrtbuf(rel, buf);
+				MarkBufferDirty(buf);
+
+				/* XLOG stuff */
+				if (!rel->rd_istemp)
+				{
+					xl_hash_delete xlrec;
+					XLogRecPtr	recptr;
+					XLogRecData rdata[2];
+
+					xlrec.node = rel->rd_node;
+					xlrec.bucket_blkno = bucket_blkno;
+					xlrec.blkno = BufferGetBlockNumber(buf);
+
+					rdata[0].data = (char *) &xlrec;
+					rdata[0].len = SizeOfHashDelete;
+					rdata[0].buffer = InvalidBuffer;
+					rdata[0].next = &(rdata[1]);
+
+					/*
+					 * The target-offsets array is not in the buffer, but pretend
+					 * that it is.  When XLogInsert stores the whole buffer, the
+					 * offsets array need not be stored too.
+					 */
+					rdata[1].data = (char *) deletable;
+					rdata[1].len = ndeletable * sizeof(OffsetNumber);
+					rdata[1].buffer = buf;
+					rdata[1].buffer_std = true;
+					rdata[1].next = NULL;
+
+					recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_DELETE, rdata);
+
+					PageSetLSN(page, recptr);
+					PageSetTLI(page, ThisTimeLineID);
+				}
+
+				END_CRIT_SECTION();
+
+				_hash_relbuf(rel, buf);
 				bucket_dirty = true;
 			}
 			else
 				_hash_relbuf(rel, buf);
 		}
 
-		/* If we deleted anything, try to compact free space */
-		if (bucket_dirty)
+		/*
+		 * If we deleted anything, try to compact free space.  Not while a
+		 * split of the bucket is pending, though: the split relies on the
+		 * bucket's pages staying put until it's complete, and will squeeze
+		 * the old bucket itself when done.
+		 */
+		if (bucket_dirty && !split_pending)
 			_hash_squeezebucket(rel, cur_bucket, bucket_blkno,
 								info->strategy);
 
@@ -627,6 +667,7 @@ loop_top:
 	}
 
 	/* Okay, we're really done.  Update tuple count in metapage. */
+	START_CRIT_SECTION();
 
 	if (orig_maxbucket == metap->hashm_maxbucket &&
 		orig_ntuples == metap->hashm_ntuples)
@@ -652,7 +693,12 @@ loop_top:
 		num_index_tuples = metap->hashm_ntuples;
 	}
 
-	_hash_wrtbuf(rel, metabuf);
+	MarkBufferDirty(metabuf);
+	_hash_log_metapage(rel, metabuf);
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, metabuf);
 
 	/* return statistics */
 	if (stats == NULL)
@@ -690,14 +736,3 @@ hashvacuumcleanup(PG_FUNCTION_ARGS)
 	PG_RETURN_POINTER(stats);
 }
 
-
-void
-hash_redo(XLogRecPtr lsn, XLogRecord *record)
-{
-	elog(PANIC, "hash_redo: unimplemented");
-}
-
-void
-hash_desc(StringInfo buf, uint8 xl_info, char *rec)
-{
-}
@@ -16,6 +16,7 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "miscadmin.h"
 #include "storage/bufmgr.h"
 #include "utils/rel.h"
 
@@ -36,7 +37,9 @@ _hash_doinsert(Relation rel, IndexTuple itup)
 	Page		page;
 	HashPageOpaque pageopaque;
 	Size		itemsz;
+	OffsetNumber itup_off;
 	bool		do_expand;
+	bool		split_pending;
 	uint32		hashkey;
 	Bucket		bucket;
 
@@ -101,6 +104,14 @@ _hash_doinsert(Relation rel, IndexTuple itup)
 	pageopaque = (HashPageOpaque) PageGetSpecialPointer(page);
 	Assert(pageopaque->hasho_bucket == bucket);
 
+	/*
+	 * If the bucket takes part in a split that has not been finished, we'll
+	 * try to finish it once we're done with our insertion.  (The insertion
+	 * itself need not care: hashkeys that belong in the new bucket are
+	 * already mapped to it by the metapage.)
+	 */
+	split_pending = H_BUCKET_SPLIT_PENDING(pageopaque);
+
 	/* Do the insertion */
 	while (PageGetFreeSpace(page) < itemsz)
 	{
@@ -141,29 +152,80 @@ _hash_doinsert(Relation rel, IndexTuple itup)
 		Assert(pageopaque->hasho_bucket == bucket);
 	}
 
-	/* found page with enough space, so add the item here */
-	(void) _hash_pgaddtup(rel, buf, itemsz, itup);
-
-	/* write and release the modified page */
-	_hash_wrtbuf(rel, buf);
-
-	/* We can drop the bucket lock now */
-	_hash_droplock(rel, blkno, HASH_SHARE);
-
 	/*
-	 * Write-lock the metapage so we can increment the tuple count. After
-	 * incrementing it, check to see if it's time for a split.
+	 * Write-lock the metapage too, so that adding the item and incrementing
+	 * the tuple count can be logged as a single action.  Locking the
+	 * metapage while holding a bucket page lock is safe: nobody acquires a
+	 * bucket page lock while holding the metapage lock, except when they
+	 * hold an exclusive lock on that bucket (see README).
 	 */
 	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
 
+	/* NO ELOG(ERROR) from here till changes are logged */
+	START_CRIT_SECTION();
+
+	/* found page with enough space, so add the item here */
+	itup_off = _hash_pgaddtup(rel, buf, itemsz, itup);
+	MarkBufferDirty(buf);
+
+	/* and increment the tuple count */
 	metap->hashm_ntuples += 1;
+	MarkBufferDirty(metabuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_insert xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[3];
+
+		xlrec.node = rel->rd_node;
+		xlrec.blkno = BufferGetBlockNumber(buf);
+		xlrec.offnum = itup_off;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = SizeOfHashInsert;
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = (char *) itup;
+		rdata[1].len = itemsz;
+		rdata[1].buffer = buf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = &(rdata[2]);
+
+		rdata[2].data = NULL;
+		rdata[2].len = 0;
+		rdata[2].buffer = metabuf;
+		rdata[2].buffer_std = true;
+		rdata[2].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_INSERT, rdata);
+
+		PageSetLSN(page, recptr);
+		PageSetTLI(page, ThisTimeLineID);
+		PageSetLSN(BufferGetPage(metabuf), recptr);
+		PageSetTLI(BufferGetPage(metabuf), ThisTimeLineID);
+	}
+
+	END_CRIT_SECTION();
 
 	/* Make sure this stays in sync with _hash_expandtable() */
 	do_expand = metap->hashm_ntuples >
 		(double) metap->hashm_ffactor * (metap->hashm_maxbucket + 1);
 
-	/* Write out the metapage and drop lock, but keep pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+	/* Drop the metapage lock, but keep pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
+	/* release the modified page */
+	_hash_relbuf(rel, buf);
+
+	/* We can drop the bucket lock now */
+	_hash_droplock(rel, blkno, HASH_SHARE);
+
+	/* Help along a split that someone else could not finish */
+	if (split_pending)
+		_hash_finish_split(rel, metabuf, bucket);
 
 	/* Attempt to split if a split is needed */
 	if (do_expand)
@@ -176,9 +238,9 @@ _hash_doinsert(Relation rel, IndexTuple itup)
 /*
  *	_hash_pgaddtup() -- add a tuple to a particular page in the index.
  *
- * This routine adds the tuple to the page as requested; it does not write out
- * the page.  It is an error to call pgaddtup() without pin and write lock on
- * the target buffer.
+ * This routine adds the tuple to the page as requested; it does not mark the
+ * buffer dirty nor write WAL, which is the caller's business.  It is an error
+ * to call pgaddtup() without pin and write lock on the target buffer.
  *
  * Returns the offset number at which the tuple was inserted.  This function
  * is responsible for preserving the condition that tuples in a hash index
@@ -205,3 +267,116 @@ _hash_pgaddtup(Relation rel, Buffer buf, Size itemsize, IndexTuple itup)
 
 	return itup_off;
 }
+
+/*
+ *	_hash_move_tuples() -- move tuples from one page to another.
+ *
+ * The tuples in itups[], which live on rbuf's page at the offsets given in
+ * itup_offsets[], are added to wbuf's page and deleted from rbuf's page, and
+ * the whole thing is WAL-logged as one atomic action.  Both buffers must be
+ * pinned and write-locked, and wbuf's page must have room for all the
+ * tuples.  bucket_blkno is the primary page of the bucket rbuf belongs to;
+ * replay needs it to lock out hot standby scans of that bucket.
+ *
+ * This is used by bucket splits and by _hash_squeezebucket.  Note that the
+ * deletion renumbers whatever tuples remain on rbuf's page.
+ */
+void
+_hash_move_tuples(Relation rel, Buffer wbuf, Buffer rbuf,
+				  BlockNumber bucket_blkno, IndexTuple *itups,
+				  OffsetNumber *itup_offsets, uint16 nitups)
+{
+	Page		wpage = BufferGetPage(wbuf);
+	Page		rpage = BufferGetPage(rbuf);
+	char	   *tupdata;
+	char	   *ptr;
+	Size		datalen;
+	int			i;
+
+	/*
+	 * Copy the tuples out of the read page first; they will be gone from it
+	 * by the time we write the WAL record.
+	 */
+	datalen = 0;
+	for (i = 0; i < nitups; i++)
+		datalen += MAXALIGN(IndexTupleDSize(*itups[i]));
+
+	tupdata = palloc(datalen);
+	ptr = tupdata;
+	for (i = 0; i < nitups; i++)
+	{
+		Size		itemsz = MAXALIGN(IndexTupleDSize(*itups[i]));
+
+		memcpy(ptr, itups[i], itemsz);
+		ptr += itemsz;
+	}
+
+	/* NO ELOG(ERROR) from here till changes are logged */
+	START_CRIT_SECTION();
+
+	ptr = tupdata;
+	for (i = 0; i < nitups; i++)
+	{
+		IndexTuple	itup = (IndexTuple) ptr;
+		Size		itemsz = MAXALIGN(IndexTupleDSize(*itup));
+
+		(void) _hash_pgaddtup(rel, wbuf, itemsz, itup);
+		ptr += itemsz;
+	}
+	MarkBufferDirty(wbuf);
+
+	PageIndexMultiDelete(rpage, itup_offsets, nitups);
+	MarkBufferDirty(rbuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_move_tuples xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[5];
+
+		xlrec.node = rel->rd_node;
+		xlrec.bucket_blkno = bucket_blkno;
+		xlrec.wblkno = BufferGetBlockNumber(wbuf);
+		xlrec.rblkno = BufferGetBlockNumber(rbuf);
+		xlrec.ntuples = nitups;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = SizeOfHashMoveTuples;
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = (char *) itup_offsets;
+		rdata[1].len = nitups * sizeof(OffsetNumber);
+		rdata[1].buffer = InvalidBuffer;
+		rdata[1].next = &(rdata[2]);
+
+		rdata[2].data = tupdata;
+		rdata[2].len = datalen;
+		rdata[2].buffer = InvalidBuffer;
+		rdata[2].next = &(rdata[3]);
+
+		rdata[3].data = NULL;
+		rdata[3].len = 0;
+		rdata[3].buffer = wbuf;
+		rdata[3].buffer_std = true;
+		rdata[3].next = &(rdata[4]);
+
+		rdata[4].data = NULL;
+		rdata[4].len = 0;
+		rdata[4].buffer = rbuf;
+		rdata[4].buffer_std = true;
+		rdata[4].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_MOVE_TUPLES, rdata);
+
+		PageSetLSN(wpage, recptr);
+		PageSetTLI(wpage, ThisTimeLineID);
+		PageSetLSN(rpage, recptr);
+		PageSetTLI(rpage, ThisTimeLineID);
+	}
+
+	END_CRIT_SECTION();
+
+	pfree(tupdata);
+}
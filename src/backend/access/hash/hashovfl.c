@@ -18,12 +18,16 @@
 #include "postgres.h"
 
 #include "access/hash.h"
+#include "access/heapam.h"
+#include "miscadmin.h"
 #include "storage/bufmgr.h"
 #include "utils/rel.h"
 
 
 static Buffer _hash_getovflpage(Relation rel, Buffer metabuf);
 static uint32 _hash_firstfreebit(uint32 map);
+static void _hash_updatebitmap(Relation rel, Buffer mapbuf,
+				   uint32 bitmapbit, bool setbit);
 
 
 /*
@@ -137,6 +141,9 @@ _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf)
 		buf = _hash_getbuf(rel, nextblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
 	}
 
+	/* NO ELOG(ERROR) from here till changes are logged */
+	START_CRIT_SECTION();
+
 	/* now that we have correct backlink, initialize new overflow page */
 	ovflpage = BufferGetPage(ovflbuf);
 	ovflopaque = (HashPageOpaque) PageGetSpecialPointer(ovflpage);
@@ -150,7 +157,43 @@ _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf)
 
 	/* logically chain overflow page to previous page */
 	pageopaque->hasho_nextblkno = BufferGetBlockNumber(ovflbuf);
-	_hash_wrtbuf(rel, buf);
+	MarkBufferDirty(buf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_add_ovfl_page xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[2];
+
+		xlrec.node = rel->rd_node;
+		xlrec.ovflblkno = BufferGetBlockNumber(ovflbuf);
+		xlrec.prevblkno = BufferGetBlockNumber(buf);
+		xlrec.bucket = pageopaque->hasho_bucket;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = sizeof(xl_hash_add_ovfl_page);
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		/* the new page is reinitialized on replay, so needs no image */
+		rdata[1].data = NULL;
+		rdata[1].len = 0;
+		rdata[1].buffer = buf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_ADD_OVFL_PAGE, rdata);
+
+		PageSetLSN(ovflpage, recptr);
+		PageSetTLI(ovflpage, ThisTimeLineID);
+		PageSetLSN(page, recptr);
+		PageSetTLI(page, ThisTimeLineID);
+	}
+
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, buf);
 
 	return ovflbuf;
 }
@@ -282,6 +325,9 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	 */
 	newbuf = _hash_getnewbuf(rel, blkno);
 
+	/* NO ELOG(ERROR) from here till changes are logged */
+	START_CRIT_SECTION();
+
 	metap->hashm_spares[splitnum]++;
 
 	/*
@@ -291,8 +337,13 @@ _hash_getovflpage(Relation rel, Buffer metabuf)
 	if (metap->hashm_firstfree == orig_firstfree)
 		metap->hashm_firstfree = bit + 1;
 
-	/* Write updated metapage and release lock, but not pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+	MarkBufferDirty(metabuf);
+	_hash_log_metapage(rel, metabuf);
+
+	END_CRIT_SECTION();
+
+	/* Release metapage lock, but not pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
 	return newbuf;
 
@@ -301,8 +352,8 @@ found:
 	bit += _hash_firstfreebit(freep[j]);
 
 	/* mark page "in use" in the bitmap */
-	SETBIT(freep, bit);
-	_hash_wrtbuf(rel, mapbuf);
+	_hash_updatebitmap(rel, mapbuf, bit, true);
+	_hash_relbuf(rel, mapbuf);
 
 	/* Reacquire exclusive lock on the meta page */
 	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
@@ -319,10 +370,14 @@ found:
 	 */
 	if (metap->hashm_firstfree == orig_firstfree)
 	{
+		START_CRIT_SECTION();
 		metap->hashm_firstfree = bit + 1;
+		MarkBufferDirty(metabuf);
+		_hash_log_metapage(rel, metabuf);
+		END_CRIT_SECTION();
 
-		/* Write updated metapage and release lock, but not pin */
-		_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+		/* Release metapage lock, but not pin */
+		_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 	}
 	else
 	{
@@ -358,12 +413,67 @@ _hash_firstfreebit(uint32 map)
 	return 0;					/* keep compiler quiet */
 }
 
+/*
+ *	_hash_updatebitmap()
+ *
+ *	Set or clear one bit of a bitmap page, and WAL-log the change.  The
+ *	bitmap page must be pinned and write-locked; it is left that way.
+ */
+static void
+_hash_updatebitmap(Relation rel, Buffer mapbuf, uint32 bitmapbit, bool setbit)
+{
+	Page		mappage = BufferGetPage(mapbuf);
+	uint32	   *freep = HashPageGetBitmap(mappage);
+
+	/* NO ELOG(ERROR) from here till change is logged */
+	START_CRIT_SECTION();
+
+	if (setbit)
+		SETBIT(freep, bitmapbit);
+	else
+		CLRBIT(freep, bitmapbit);
+	MarkBufferDirty(mapbuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_update_bitmap xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[2];
+
+		xlrec.node = rel->rd_node;
+		xlrec.mapblkno = BufferGetBlockNumber(mapbuf);
+		xlrec.bitmapbit = bitmapbit;
+		xlrec.setbit = setbit;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = sizeof(xl_hash_update_bitmap);
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = NULL;
+		rdata[1].len = 0;
+		rdata[1].buffer = mapbuf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_UPDATE_BITMAP, rdata);
+
+		PageSetLSN(mappage, recptr);
+		PageSetTLI(mappage, ThisTimeLineID);
+	}
+
+	END_CRIT_SECTION();
+}
+
 /*
  *	_hash_freeovflpage() -
  *
  *	Remove this overflow page from its bucket's chain, and mark the page as
  *	free.  On entry, ovflbuf is write-locked; it is released before exiting.
  *
+ *	bucket_blkno is the primary page of the bucket the page belongs to.
+ *
  *	Since this function is invoked in VACUUM, we provide an access strategy
  *	parameter that controls fetches of the bucket pages.
  *
@@ -373,22 +483,30 @@ _hash_firstfreebit(uint32 map)
  *	NB: caller must not hold lock on metapage, nor on either page that's
  *	adjacent in the bucket chain.  The caller had better hold exclusive lock
  *	on the bucket, too.
+ *
+ *	Unlinking the page and clearing its bitmap bit are logged as separate
+ *	WAL records.  A crash in between leaves the page allocated but not part
+ *	of any bucket; that wastes the page, but is otherwise harmless.
  */
 BlockNumber
-_hash_freeovflpage(Relation rel, Buffer ovflbuf,
+_hash_freeovflpage(Relation rel, Buffer ovflbuf, BlockNumber bucket_blkno,
 				   BufferAccessStrategy bstrategy)
 {
 	HashMetaPage metap;
 	Buffer		metabuf;
 	Buffer		mapbuf;
+	Buffer		prevbuf;
+	Buffer		nextbuf = InvalidBuffer;
 	BlockNumber ovflblkno;
 	BlockNumber prevblkno;
 	BlockNumber blkno;
 	BlockNumber nextblkno;
 	HashPageOpaque ovflopaque;
+	HashPageOpaque prevopaque;
+	HashPageOpaque nextopaque = NULL;
 	Page		ovflpage;
-	Page		mappage;
-	uint32	   *freep;
+	Page		prevpage;
+	Page		nextpage = NULL;
 	uint32		ovflbitno;
 	int32		bitmappage,
 				bitmapbit;
@@ -403,49 +521,115 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
 	prevblkno = ovflopaque->hasho_prevblkno;
 	bucket = ovflopaque->hasho_bucket;
 
-	/*
-	 * Zero the page for debugging's sake; then write and release it. (Note:
-	 * if we failed to zero the page here, we'd have problems with the Assert
-	 * in _hash_pageinit() when the page is reused.)
-	 */
-	MemSet(ovflpage, 0, BufferGetPageSize(ovflbuf));
-	_hash_wrtbuf(rel, ovflbuf);
-
 	/*
 	 * Fix up the bucket chain.  this is a doubly-linked list, so we must fix
 	 * up the bucket chain members behind and ahead of the overflow page being
 	 * deleted.  No concurrency issues since we hold exclusive lock on the
-	 * entire bucket.
+	 * entire bucket, which also makes it okay to lock all three pages at
+	 * once.  An overflow page always has a predecessor.
 	 */
-	if (BlockNumberIsValid(prevblkno))
-	{
-		Buffer		prevbuf = _hash_getbuf_with_strategy(rel,
-														 prevblkno,
-														 HASH_WRITE,
-										   LH_BUCKET_PAGE | LH_OVERFLOW_PAGE,
-														 bstrategy);
-		Page		prevpage = BufferGetPage(prevbuf);
-		HashPageOpaque prevopaque = (HashPageOpaque) PageGetSpecialPointer(prevpage);
-
-		Assert(prevopaque->hasho_bucket == bucket);
-		prevopaque->hasho_nextblkno = nextblkno;
-		_hash_wrtbuf(rel, prevbuf);
-	}
+	Assert(BlockNumberIsValid(prevblkno));
+	prevbuf = _hash_getbuf_with_strategy(rel,
+										 prevblkno,
+										 HASH_WRITE,
+										 LH_BUCKET_PAGE | LH_OVERFLOW_PAGE,
+										 bstrategy);
+	prevpage = BufferGetPage(prevbuf);
+	prevopaque = (HashPageOpaque) PageGetSpecialPointer(prevpage);
+	Assert(prevopaque->hasho_bucket == bucket);
+
 	if (BlockNumberIsValid(nextblkno))
 	{
-		Buffer		nextbuf = _hash_getbuf_with_strategy(rel,
-														 nextblkno,
-														 HASH_WRITE,
-														 LH_OVERFLOW_PAGE,
-														 bstrategy);
-		Page		nextpage = BufferGetPage(nextbuf);
-		HashPageOpaque nextopaque = (HashPageOpaque) PageGetSpecialPointer(nextpage);
-
+		nextbuf = _hash_getbuf_with_strategy(rel,
+											 nextblkno,
+											 HASH_WRITE,
+											 LH_OVERFLOW_PAGE,
+											 bstrategy);
+		nextpage = BufferGetPage(nextbuf);
+		nextopaque = (HashPageOpaque) PageGetSpecialPointer(nextpage);
 		Assert(nextopaque->hasho_bucket == bucket);
+	}
+
+	/* NO ELOG(ERROR) from here till changes are logged */
+	START_CRIT_SECTION();
+
+	prevopaque->hasho_nextblkno = nextblkno;
+	MarkBufferDirty(prevbuf);
+
+	if (BufferIsValid(nextbuf))
+	{
 		nextopaque->hasho_prevblkno = prevblkno;
-		_hash_wrtbuf(rel, nextbuf);
+		MarkBufferDirty(nextbuf);
+	}
+
+	/*
+	 * Reinitialize the freed page as an unused page.  (It will be zeroed
+	 * again by _hash_getinitbuf when it is recycled.)
+	 */
+	PageInit(ovflpage, BufferGetPageSize(ovflbuf), sizeof(HashPageOpaqueData));
+	ovflopaque = (HashPageOpaque) PageGetSpecialPointer(ovflpage);
+	ovflopaque->hasho_prevblkno = InvalidBlockNumber;
+	ovflopaque->hasho_nextblkno = InvalidBlockNumber;
+	ovflopaque->hasho_bucket = -1;
+	ovflopaque->hasho_flag = LH_UNUSED_PAGE;
+	ovflopaque->hasho_page_id = HASHO_PAGE_ID;
+	MarkBufferDirty(ovflbuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_free_ovfl_page xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[3];
+
+		xlrec.node = rel->rd_node;
+		xlrec.bucket_blkno = bucket_blkno;
+		xlrec.ovflblkno = ovflblkno;
+		xlrec.prevblkno = prevblkno;
+		xlrec.nextblkno = nextblkno;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = sizeof(xl_hash_free_ovfl_page);
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = NULL;
+		rdata[1].len = 0;
+		rdata[1].buffer = prevbuf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = NULL;
+
+		if (BufferIsValid(nextbuf))
+		{
+			rdata[1].next = &(rdata[2]);
+
+			rdata[2].data = NULL;
+			rdata[2].len = 0;
+			rdata[2].buffer = nextbuf;
+			rdata[2].buffer_std = true;
+			rdata[2].next = NULL;
+		}
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_FREE_OVFL_PAGE, rdata);
+
+		PageSetLSN(ovflpage, recptr);
+		PageSetTLI(ovflpage, ThisTimeLineID);
+		PageSetLSN(prevpage, recptr);
+		PageSetTLI(prevpage, ThisTimeLineID);
+		if (BufferIsValid(nextbuf))
+		{
+			PageSetLSN(nextpage, recptr);
+			PageSetTLI(nextpage, ThisTimeLineID);
+		}
 	}
 
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, ovflbuf);
+	_hash_relbuf(rel, prevbuf);
+	if (BufferIsValid(nextbuf))
+		_hash_relbuf(rel, nextbuf);
+
 	/* Note: bstrategy is intentionally not used for metapage and bitmap */
 
 	/* Read the metapage so we can determine which bitmap page to use */
@@ -467,11 +651,9 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
 
 	/* Clear the bitmap bit to indicate that this overflow page is free */
 	mapbuf = _hash_getbuf(rel, blkno, HASH_WRITE, LH_BITMAP_PAGE);
-	mappage = BufferGetPage(mapbuf);
-	freep = HashPageGetBitmap(mappage);
-	Assert(ISSET(freep, bitmapbit));
-	CLRBIT(freep, bitmapbit);
-	_hash_wrtbuf(rel, mapbuf);
+	Assert(ISSET(HashPageGetBitmap(BufferGetPage(mapbuf)), bitmapbit));
+	_hash_updatebitmap(rel, mapbuf, bitmapbit, false);
+	_hash_relbuf(rel, mapbuf);
 
 	/* Get write-lock on metapage to update firstfree */
 	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_WRITE);
@@ -479,15 +661,15 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
 	/* if this is now the first free page, update hashm_firstfree */
 	if (ovflbitno < metap->hashm_firstfree)
 	{
+		START_CRIT_SECTION();
 		metap->hashm_firstfree = ovflbitno;
-		_hash_wrtbuf(rel, metabuf);
-	}
-	else
-	{
-		/* no need to change metapage */
-		_hash_relbuf(rel, metabuf);
+		MarkBufferDirty(metabuf);
+		_hash_log_metapage(rel, metabuf);
+		END_CRIT_SECTION();
 	}
 
+	_hash_relbuf(rel, metabuf);
+
 	return nextblkno;
 }
 
@@ -496,7 +678,8 @@ _hash_freeovflpage(Relation rel, Buffer ovflbuf,
  *	_hash_initbitmap()
  *
  *	 Initialize a new bitmap page.	The metapage has a write-lock upon
- *	 entering the function, and must be written by caller after return.
+ *	 entering the function, and must be written and WAL-logged by caller
+ *	 after return.
  *
  * 'blkno' is the block number of the new bitmap page.
  *
@@ -535,8 +718,11 @@ _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno)
 	freep = HashPageGetBitmap(pg);
 	MemSet(freep, 0xFF, BMPGSZ_BYTE(metap));
 
-	/* write out the new bitmap page (releasing write lock and pin) */
-	_hash_wrtbuf(rel, buf);
+	/* write out the new bitmap page, logging its whole image */
+	MarkBufferDirty(buf);
+	if (!rel->rd_istemp)
+		log_newpage(&rel->rd_node, MAIN_FORKNUM, blkno, pg);
+	_hash_relbuf(rel, buf);
 
 	/* add the new bitmap page to the metapage's list of bitmaps */
 	/* metapage already has a write lock */
@@ -570,6 +756,10 @@ _hash_initbitmap(Relation rel, HashMetaPage metap, BlockNumber blkno)
  *	required that to be true on entry as well, but it's a lot easier for
  *	callers to leave empty overflow pages and let this guy clean it up.
  *
+ *	Tuples are moved in batches, one batch per pair of read and write
+ *	pages, each of which is applied and WAL-logged atomically by
+ *	_hash_move_tuples.
+ *
  *	Caller must hold exclusive lock on the target bucket.  This allows
  *	us to safely lock multiple pages in the bucket.
  *
@@ -590,7 +780,7 @@ _hash_squeezebucket(Relation rel,
 	Page		rpage;
 	HashPageOpaque wopaque;
 	HashPageOpaque ropaque;
-	bool		wbuf_dirty;
+	Size		wfree;
 
 	/*
 	 * start squeezing into the base bucket page.
@@ -639,19 +829,23 @@ _hash_squeezebucket(Relation rel,
 	/*
 	 * squeeze the tuples.
 	 */
-	wbuf_dirty = false;
+	wfree = PageGetExactFreeSpace(wpage);
 	for (;;)
 	{
 		OffsetNumber roffnum;
 		OffsetNumber maxroffnum;
 		OffsetNumber deletable[MaxOffsetNumber];
-		int			ndeletable = 0;
+		IndexTuple	itups[MaxIndexTuplesPerPage];
+		uint16		nitups = 0;
 
-		/* Scan each tuple in "read" page */
+		/*
+		 * Collect tuples from the "read" page for as long as they fit on the
+		 * "write" page.  Everything we collect is a prefix of the read page,
+		 * since we move every tuple we look at.
+		 */
+		roffnum = FirstOffsetNumber;
 		maxroffnum = PageGetMaxOffsetNumber(rpage);
-		for (roffnum = FirstOffsetNumber;
-			 roffnum <= maxroffnum;
-			 roffnum = OffsetNumberNext(roffnum))
+		while (roffnum <= maxroffnum)
 		{
 			IndexTuple	itup;
 			Size		itemsz;
@@ -661,33 +855,36 @@ _hash_squeezebucket(Relation rel,
 			itemsz = IndexTupleDSize(*itup);
 			itemsz = MAXALIGN(itemsz);
 
-			/*
-			 * Walk up the bucket chain, looking for a page big enough for
-			 * this item.  Exit if we reach the read page.
-			 */
-			while (PageGetFreeSpace(wpage) < itemsz)
+			if (itemsz + sizeof(ItemIdData) > wfree)
 			{
+				/*
+				 * No room on the write page.  Move what we have collected so
+				 * far; the remaining tuples get renumbered from the start.
+				 */
+				if (nitups > 0)
+				{
+					_hash_move_tuples(rel, wbuf, rbuf, bucket_blkno,
+									  itups, deletable, nitups);
+					nitups = 0;
+					roffnum = FirstOffsetNumber;
+					maxroffnum = PageGetMaxOffsetNumber(rpage);
+				}
+
+				/*
+				 * Walk up the bucket chain, looking for a page big enough
+				 * for this item.  Exit if we reach the read page.
+				 */
 				Assert(!PageIsEmpty(wpage));
 
 				wblkno = wopaque->hasho_nextblkno;
 				Assert(BlockNumberIsValid(wblkno));
 
-				if (wbuf_dirty)
-					_hash_wrtbuf(rel, wbuf);
-				else
-					_hash_relbuf(rel, wbuf);
+				_hash_relbuf(rel, wbuf);
 
 				/* nothing more to do if we reached the read page */
 				if (rblkno == wblkno)
 				{
-					if (ndeletable > 0)
-					{
-						/* Delete tuples we already moved off read page */
-						PageIndexMultiDelete(rpage, deletable, ndeletable);
-						_hash_wrtbuf(rel, rbuf);
-					}
-					else
-						_hash_relbuf(rel, rbuf);
+					_hash_relbuf(rel, rbuf);
 					return;
 				}
 
@@ -699,27 +896,30 @@ _hash_squeezebucket(Relation rel,
 				wpage = BufferGetPage(wbuf);
 				wopaque = (HashPageOpaque) PageGetSpecialPointer(wpage);
 				Assert(wopaque->hasho_bucket == bucket);
-				wbuf_dirty = false;
+				wfree = PageGetExactFreeSpace(wpage);
+
+				/* look at the same tuple again */
+				continue;
 			}
 
-			/*
-			 * we have found room so insert on the "write" page, being careful
-			 * to preserve hashkey ordering.  (If we insert many tuples into
-			 * the same "write" page it would be worth qsort'ing instead of
-			 * doing repeated _hash_pgaddtup.)
-			 */
-			(void) _hash_pgaddtup(rel, wbuf, itemsz, itup);
-			wbuf_dirty = true;
-
-			/* remember tuple for deletion from "read" page */
-			deletable[ndeletable++] = roffnum;
+			/* remember tuple for moving to the "write" page */
+			itups[nitups] = itup;
+			deletable[nitups] = roffnum;
+			nitups++;
+			wfree -= itemsz + sizeof(ItemIdData);
+
+			roffnum = OffsetNumberNext(roffnum);
 		}
 
+		/* Move whatever is left on the read page */
+		if (nitups > 0)
+			_hash_move_tuples(rel, wbuf, rbuf, bucket_blkno,
+							  itups, deletable, nitups);
+
 		/*
 		 * If we reach here, there are no live tuples on the "read" page ---
 		 * it was empty when we got to it, or we moved them all.  So we can
-		 * just free the page without bothering with deleting tuples
-		 * individually.  Then advance to the previous "read" page.
+		 * free the page.  Then advance to the previous "read" page.
 		 *
 		 * Tricky point here: if our read and write pages are adjacent in the
 		 * bucket chain, our write lock on wbuf will conflict with
@@ -734,18 +934,15 @@ _hash_squeezebucket(Relation rel,
 		if (rblkno == wblkno)
 		{
 			/* yes, so release wbuf lock first */
-			if (wbuf_dirty)
-				_hash_wrtbuf(rel, wbuf);
-			else
-				_hash_relbuf(rel, wbuf);
+			_hash_relbuf(rel, wbuf);
 			/* free this overflow page (releases rbuf) */
-			_hash_freeovflpage(rel, rbuf, bstrategy);
+			_hash_freeovflpage(rel, rbuf, bucket_blkno, bstrategy);
 			/* done */
 			return;
 		}
 
 		/* free this overflow page, then get the previous one */
-		_hash_freeovflpage(rel, rbuf, bstrategy);
+		_hash_freeovflpage(rel, rbuf, bucket_blkno, bstrategy);
 
 		rbuf = _hash_getbuf_with_strategy(rel,
 										  rblkno,
@@ -30,6 +30,7 @@
 
 #include "access/genam.h"
 #include "access/hash.h"
+#include "access/heapam.h"
 #include "miscadmin.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
@@ -42,9 +43,7 @@ static bool _hash_alloc_buckets(Relation rel, BlockNumber firstblock,
 static void _hash_splitbucket(Relation rel, Buffer metabuf,
 				  Bucket obucket, Bucket nbucket,
 				  BlockNumber start_oblkno,
-				  BlockNumber start_nblkno,
-				  uint32 maxbucket,
-				  uint32 highmask, uint32 lowmask);
+				  BlockNumber start_nblkno);
 
 
 /*
@@ -265,25 +264,6 @@ _hash_dropbuf(Relation rel, Buffer buf)
 	ReleaseBuffer(buf);
 }
 
-/*
- *	_hash_wrtbuf() -- write a hash page to disk.
- *
- *		This routine releases the lock held on the buffer and our refcount
- *		for it.  It is an error to call _hash_wrtbuf() without a write lock
- *		and a pin on the buffer.
- *
- * NOTE: this routine should go away when/if hash indexes are WAL-ified.
- * The correct sequence of operations is to mark the buffer dirty, then
- * write the WAL record, then release the lock and pin; so marking dirty
- * can't be combined with releasing.
- */
-void
-_hash_wrtbuf(Relation rel, Buffer buf)
-{
-	MarkBufferDirty(buf);
-	UnlockReleaseBuffer(buf);
-}
-
 /*
  * _hash_chgbufaccess() -- Change the lock type on a buffer, without
  *			dropping our pin on it.
@@ -292,9 +272,11 @@ _hash_wrtbuf(Relation rel, Buffer buf)
  * the last indicating that no buffer-level lock is held or wanted.
  *
  * When from_access == HASH_WRITE, we assume the buffer is dirty and tell
- * bufmgr it must be written out.  If the caller wants to release a write
- * lock on a page that's not been modified, it's okay to pass from_access
- * as HASH_READ (a bit ugly, but handy in some places).
+ * bufmgr it must be written out.  (Callers that modified the page must
+ * have WAL-logged the change already; see _hash_log_metapage.)  If the
+ * caller wants to release a write lock on a page that's not been modified,
+ * it's okay to pass from_access as HASH_READ (a bit ugly, but handy in
+ * some places).
  */
 void
 _hash_chgbufaccess(Relation rel,
@@ -310,6 +292,45 @@ _hash_chgbufaccess(Relation rel,
 		LockBuffer(buf, to_access);
 }
 
+/*
+ * _hash_log_metapage() -- WAL-log the current contents of the metapage.
+ *
+ * This is used for the metapage changes that have no more specific WAL
+ * record: overflow page accounting, the bitmap page list, and the tuple
+ * count computed by VACUUM.  The caller must hold write lock on metabuf,
+ * must have marked it dirty, and must be inside a critical section.
+ */
+void
+_hash_log_metapage(Relation rel, Buffer metabuf)
+{
+	Page		page = BufferGetPage(metabuf);
+	xl_hash_metapage xlrec;
+	XLogRecPtr	recptr;
+	XLogRecData rdata[2];
+
+	if (rel->rd_istemp)
+		return;
+
+	xlrec.node = rel->rd_node;
+	memcpy(&xlrec.metadata, HashPageGetMeta(page), sizeof(HashMetaPageData));
+
+	rdata[0].data = (char *) &xlrec;
+	rdata[0].len = sizeof(xl_hash_metapage);
+	rdata[0].buffer = InvalidBuffer;
+	rdata[0].next = &(rdata[1]);
+
+	rdata[1].data = NULL;
+	rdata[1].len = 0;
+	rdata[1].buffer = metabuf;
+	rdata[1].buffer_std = true;
+	rdata[1].next = NULL;
+
+	recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_METAPAGE, rdata);
+
+	PageSetLSN(page, recptr);
+	PageSetTLI(page, ThisTimeLineID);
+}
+
 
 /*
  *	_hash_metapinit() -- Initialize the metadata page of a hash index,
@@ -322,6 +343,8 @@ _hash_chgbufaccess(Relation rel,
  * We are fairly cavalier about locking here, since we know that no one else
  * could be accessing this index.  In particular the rule about not holding
  * multiple buffer locks is ignored.
+ *
+ * Each page is WAL-logged as a full-page image as soon as it's complete.
  */
 uint32
 _hash_metapinit(Relation rel, double num_tuples)
@@ -459,7 +482,11 @@ _hash_metapinit(Relation rel, double num_tuples)
 		pageopaque->hasho_bucket = i;
 		pageopaque->hasho_flag = LH_BUCKET_PAGE;
 		pageopaque->hasho_page_id = HASHO_PAGE_ID;
-		_hash_wrtbuf(rel, buf);
+		MarkBufferDirty(buf);
+		if (!rel->rd_istemp)
+			log_newpage(&rel->rd_node, MAIN_FORKNUM,
+						BufferGetBlockNumber(buf), pg);
+		_hash_relbuf(rel, buf);
 	}
 
 	/* Now reacquire buffer lock on metapage */
@@ -471,7 +498,11 @@ _hash_metapinit(Relation rel, double num_tuples)
 	_hash_initbitmap(rel, metap, num_buckets + 1);
 
 	/* all done */
-	_hash_wrtbuf(rel, metabuf);
+	MarkBufferDirty(metabuf);
+	if (!rel->rd_istemp)
+		log_newpage(&rel->rd_node, MAIN_FORKNUM, HASH_METAPAGE,
+					BufferGetPage(metabuf));
+	_hash_relbuf(rel, metabuf);
 
 	return num_buckets;
 }
@@ -491,6 +522,9 @@ _hash_pageinit(Page page, Size size)
  *
  * This will silently do nothing if it cannot get the needed locks.
  *
+ * If the bucket to be split is itself still involved in an unfinished split,
+ * we finish that split instead; see _hash_finish_split.
+ *
  * The caller should hold no locks on the hash index.
  *
  * The caller must hold a pin, but no lock, on the metapage buffer.
@@ -505,9 +539,13 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 	uint32		spare_ndx;
 	BlockNumber start_oblkno;
 	BlockNumber start_nblkno;
-	uint32		maxbucket;
-	uint32		highmask;
-	uint32		lowmask;
+	BlockNumber lastblkno = InvalidBlockNumber;
+	Buffer		obuf;
+	Buffer		nbuf;
+	Page		opage;
+	Page		npage;
+	HashPageOpaque oopaque;
+	HashPageOpaque nopaque;
 
 	/*
 	 * Obtain the page-zero lock to assert the right to begin a split (see
@@ -577,6 +615,31 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 	if (!_hash_try_getlock(rel, start_oblkno, HASH_EXCLUSIVE))
 		goto fail;
 
+	/*
+	 * A bucket must not be split again before its previous split has been
+	 * completed, whether it was the old or the new half of that split.  If
+	 * it hasn't been, complete it now and leave the new split to a later
+	 * insertion.
+	 *
+	 * It's okay to lock the old bucket's primary page while holding the
+	 * metapage lock, since nobody else can be holding a lock on any page of
+	 * the bucket while we hold the bucket's exclusive lock.
+	 */
+	obuf = _hash_getbuf(rel, start_oblkno, HASH_WRITE, LH_BUCKET_PAGE);
+	opage = BufferGetPage(obuf);
+	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
+
+	if (H_BUCKET_SPLIT_PENDING(oopaque))
+	{
+		_hash_relbuf(rel, obuf);
+		_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
+		_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+		_hash_droplock(rel, 0, HASH_EXCLUSIVE);
+
+		_hash_finish_split(rel, metabuf, old_bucket);
+		return;
+	}
+
 	/*
 	 * Likewise lock the new bucket (should never fail).
 	 *
@@ -611,20 +674,27 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 		if (!_hash_alloc_buckets(rel, start_nblkno, new_bucket))
 		{
 			/* can't split due to BlockNumber overflow */
+			_hash_relbuf(rel, obuf);
 			_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
 			_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
 			goto fail;
 		}
+		lastblkno = start_nblkno + new_bucket - 1;
 	}
 
 	/*
-	 * Okay to proceed with split.	Update the metapage bucket mapping info.
-	 *
-	 * Since we are scribbling on the metapage data right in the shared
-	 * buffer, any failure in this next little bit leaves us with a big
-	 * problem: the metapage is effectively corrupt but could get written back
-	 * to disk.  We don't really expect any failure, but just to be sure,
-	 * establish a critical section.
+	 * Get the new bucket's primary page.  The metapage lock makes it safe to
+	 * extend the index here.
+	 */
+	nbuf = _hash_getnewbuf(rel, start_nblkno);
+	npage = BufferGetPage(nbuf);
+
+	/*
+	 * Okay to proceed with split.	Update the metapage bucket mapping info,
+	 * mark the old bucket as being split, and initialize the new bucket's
+	 * primary page as being populated.  These changes are logged as a single
+	 * WAL record, so that after a crash the split can be completed by
+	 * whoever next comes across either bucket.
 	 */
 	START_CRIT_SECTION();
 
@@ -649,34 +719,81 @@ _hash_expandtable(Relation rel, Buffer metabuf)
 		metap->hashm_ovflpoint = spare_ndx;
 	}
 
-	/* Done mucking with metapage */
+	MarkBufferDirty(metabuf);
+
+	oopaque->hasho_flag |= LH_BUCKET_BEING_SPLIT;
+	MarkBufferDirty(obuf);
+
+	/* initialize the new bucket's primary page */
+	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
+	nopaque->hasho_prevblkno = InvalidBlockNumber;
+	nopaque->hasho_nextblkno = InvalidBlockNumber;
+	nopaque->hasho_bucket = new_bucket;
+	nopaque->hasho_flag = LH_BUCKET_PAGE | LH_BUCKET_BEING_POPULATED;
+	nopaque->hasho_page_id = HASHO_PAGE_ID;
+	MarkBufferDirty(nbuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_split_allocate xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[3];
+		Page		metapage = BufferGetPage(metabuf);
+
+		xlrec.node = rel->rd_node;
+		xlrec.old_bucket = old_bucket;
+		xlrec.new_bucket = new_bucket;
+		xlrec.old_blkno = start_oblkno;
+		xlrec.new_blkno = start_nblkno;
+		xlrec.lastblkno = lastblkno;
+		xlrec.maxbucket = metap->hashm_maxbucket;
+		xlrec.highmask = metap->hashm_highmask;
+		xlrec.lowmask = metap->hashm_lowmask;
+		xlrec.ovflpoint = metap->hashm_ovflpoint;
+		xlrec.ovflpoint_spares = metap->hashm_spares[metap->hashm_ovflpoint];
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = sizeof(xl_hash_split_allocate);
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = NULL;
+		rdata[1].len = 0;
+		rdata[1].buffer = metabuf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = &(rdata[2]);
+
+		rdata[2].data = NULL;
+		rdata[2].len = 0;
+		rdata[2].buffer = obuf;
+		rdata[2].buffer_std = true;
+		rdata[2].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_SPLIT_ALLOCATE, rdata);
+
+		PageSetLSN(metapage, recptr);
+		PageSetTLI(metapage, ThisTimeLineID);
+		PageSetLSN(opage, recptr);
+		PageSetTLI(opage, ThisTimeLineID);
+		PageSetLSN(npage, recptr);
+		PageSetTLI(npage, ThisTimeLineID);
+	}
+
 	END_CRIT_SECTION();
 
-	/*
-	 * Copy bucket mapping info now; this saves re-accessing the meta page
-	 * inside _hash_splitbucket's inner loop.  Note that once we drop the
-	 * split lock, other splits could begin, so these values might be out of
-	 * date before _hash_splitbucket finishes.	That's okay, since all it
-	 * needs is to tell which of these two buckets to map hashkeys into.
-	 */
-	maxbucket = metap->hashm_maxbucket;
-	highmask = metap->hashm_highmask;
-	lowmask = metap->hashm_lowmask;
+	_hash_relbuf(rel, obuf);
+	_hash_relbuf(rel, nbuf);
 
-	/* Write out the metapage and drop lock, but keep pin */
-	_hash_chgbufaccess(rel, metabuf, HASH_WRITE, HASH_NOLOCK);
+	/* Drop the metapage lock, but keep pin */
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
 
 	/* Release split lock; okay for other splits to occur now */
 	_hash_droplock(rel, 0, HASH_EXCLUSIVE);
 
-	/* Relocate records to the new bucket */
+	/* Relocate records to the new bucket; this releases the bucket locks */
 	_hash_splitbucket(rel, metabuf, old_bucket, new_bucket,
-					  start_oblkno, start_nblkno,
-					  maxbucket, highmask, lowmask);
-
-	/* Release bucket locks, allowing others to access them */
-	_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
-	_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+					  start_oblkno, start_nblkno);
 
 	return;
 
@@ -747,8 +864,19 @@ _hash_alloc_buckets(Relation rel, BlockNumber firstblock, uint32 nblocks)
  * belong in the new bucket, and compress out any free space in the old
  * bucket.
  *
+ * The split has already been recorded in the metapage, and the buckets'
+ * primary pages have been marked as being split and being populated.  This
+ * may also be a resumption of a split that was interrupted, either by a
+ * crash or because we gave up our locks; tuples already relocated are gone
+ * from the old bucket, so we simply start over from its first page.
+ *
  * The caller must hold exclusive locks on both buckets to ensure that
- * no one else is trying to access them (see README).
+ * no one else is trying to access them (see README).  Between pages of the
+ * old bucket we release both locks, so that inserts and scans of the two
+ * buckets aren't blocked for the whole duration of the split, and then try
+ * to reacquire them.  If we can't, we leave the rest of the split to be
+ * completed by the next inserter into either bucket.  Both bucket locks
+ * have been released on return.
  *
  * The caller must hold a pin, but no lock, on the metapage buffer.
  * The buffer is returned in the same state.  (The metapage is only
@@ -760,10 +888,7 @@ _hash_splitbucket(Relation rel,
 				  Bucket obucket,
 				  Bucket nbucket,
 				  BlockNumber start_oblkno,
-				  BlockNumber start_nblkno,
-				  uint32 maxbucket,
-				  uint32 highmask,
-				  uint32 lowmask)
+				  BlockNumber start_nblkno)
 {
 	BlockNumber oblkno;
 	BlockNumber nblkno;
@@ -774,134 +899,309 @@ _hash_splitbucket(Relation rel,
 	HashPageOpaque oopaque;
 	HashPageOpaque nopaque;
 
-	/*
-	 * It should be okay to simultaneously write-lock pages from each bucket,
-	 * since no one else can be trying to acquire buffer lock on pages of
-	 * either bucket.
-	 */
-	oblkno = start_oblkno;
-	obuf = _hash_getbuf(rel, oblkno, HASH_WRITE, LH_BUCKET_PAGE);
-	opage = BufferGetPage(obuf);
-	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
-
-	nblkno = start_nblkno;
-	nbuf = _hash_getnewbuf(rel, nblkno);
-	npage = BufferGetPage(nbuf);
-
-	/* initialize the new bucket's primary page */
-	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
-	nopaque->hasho_prevblkno = InvalidBlockNumber;
-	nopaque->hasho_nextblkno = InvalidBlockNumber;
-	nopaque->hasho_bucket = nbucket;
-	nopaque->hasho_flag = LH_BUCKET_PAGE;
-	nopaque->hasho_page_id = HASHO_PAGE_ID;
-
 	/*
 	 * Partition the tuples in the old bucket between the old bucket and the
 	 * new bucket, advancing along the old bucket's overflow bucket chain and
 	 * adding overflow pages to the new bucket as needed.  Outer loop iterates
 	 * once per page in old bucket.
+	 *
+	 * It should be okay to simultaneously write-lock pages from each bucket,
+	 * since no one else can be trying to acquire buffer lock on pages of
+	 * either bucket.  No pages can be removed from either bucket while the
+	 * split is pending, so block numbers remain valid even across the
+	 * intervals where we don't hold the bucket locks.
 	 */
+	oblkno = start_oblkno;
+	nblkno = start_nblkno;
 	for (;;)
 	{
-		OffsetNumber ooffnum;
-		OffsetNumber omaxoffnum;
-		OffsetNumber deletable[MaxOffsetNumber];
-		int			ndeletable = 0;
-
-		/* Scan each tuple in old page */
-		omaxoffnum = PageGetMaxOffsetNumber(opage);
-		for (ooffnum = FirstOffsetNumber;
-			 ooffnum <= omaxoffnum;
-			 ooffnum = OffsetNumberNext(ooffnum))
-		{
-			IndexTuple	itup;
-			Size		itemsz;
-			Bucket		bucket;
-
-			/*
-			 * Fetch the item's hash key (conveniently stored in the item) and
-			 * determine which bucket it now belongs in.
-			 */
-			itup = (IndexTuple) PageGetItem(opage,
-											PageGetItemId(opage, ooffnum));
-			bucket = _hash_hashkey2bucket(_hash_get_indextuple_hashkey(itup),
-										  maxbucket, highmask, lowmask);
+		obuf = _hash_getbuf(rel, oblkno, HASH_WRITE,
+							LH_BUCKET_PAGE | LH_OVERFLOW_PAGE);
+		opage = BufferGetPage(obuf);
+		oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
+		Assert(oopaque->hasho_bucket == obucket);
 
-			if (bucket == nbucket)
+		/*
+		 * Move the tuples that belong in the new bucket, one batch per page
+		 * of the new bucket that we fill.
+		 */
+		for (;;)
+		{
+			OffsetNumber ooffnum;
+			OffsetNumber omaxoffnum;
+			OffsetNumber deletable[MaxOffsetNumber];
+			IndexTuple	itups[MaxIndexTuplesPerPage];
+			uint16		nitups = 0;
+			Size		nfree;
+			bool		npage_full = false;
+
+			nbuf = _hash_getbuf(rel, nblkno, HASH_WRITE,
+								LH_BUCKET_PAGE | LH_OVERFLOW_PAGE);
+			npage = BufferGetPage(nbuf);
+			nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
+			Assert(nopaque->hasho_bucket == nbucket);
+			nfree = PageGetExactFreeSpace(npage);
+
+			/* Scan each tuple in old page */
+			omaxoffnum = PageGetMaxOffsetNumber(opage);
+			for (ooffnum = FirstOffsetNumber;
+				 ooffnum <= omaxoffnum;
+				 ooffnum = OffsetNumberNext(ooffnum))
 			{
+				IndexTuple	itup;
+				Size		itemsz;
+
 				/*
-				 * insert the tuple into the new bucket.  if it doesn't fit on
-				 * the current page in the new bucket, we must allocate a new
-				 * overflow page and place the tuple on that page instead.
+				 * Fetch the item's hash key (conveniently stored in the item)
+				 * and determine whether it belongs in the new bucket.
 				 */
+				itup = (IndexTuple) PageGetItem(opage,
+												PageGetItemId(opage, ooffnum));
+				if (!_hash_tuple_moves_to(_hash_get_indextuple_hashkey(itup),
+										  nbucket))
+					continue;
+
 				itemsz = IndexTupleDSize(*itup);
 				itemsz = MAXALIGN(itemsz);
 
-				if (PageGetFreeSpace(npage) < itemsz)
+				if (itemsz + sizeof(ItemIdData) > nfree)
 				{
-					/* write out nbuf and drop lock, but keep pin */
-					_hash_chgbufaccess(rel, nbuf, HASH_WRITE, HASH_NOLOCK);
-					/* chain to a new overflow page */
-					nbuf = _hash_addovflpage(rel, metabuf, nbuf);
-					npage = BufferGetPage(nbuf);
-					/* we don't need nblkno or nopaque within the loop */
+					npage_full = true;
+					break;
 				}
 
-				/*
-				 * Insert tuple on new page, using _hash_pgaddtup to ensure
-				 * correct ordering by hashkey.  This is a tad inefficient
-				 * since we may have to shuffle itempointers repeatedly.
-				 * Possible future improvement: accumulate all the items for
-				 * the new page and qsort them before insertion.
-				 */
-				(void) _hash_pgaddtup(rel, nbuf, itemsz, itup);
+				itups[nitups] = itup;
+				deletable[nitups] = ooffnum;
+				nitups++;
+				nfree -= itemsz + sizeof(ItemIdData);
+			}
 
-				/*
-				 * Mark tuple for deletion from old page.
-				 */
-				deletable[ndeletable++] = ooffnum;
+			/*
+			 * Move the batch.  _hash_move_tuples keeps the new page in
+			 * hashkey order, and deletes the tuples from the old page in the
+			 * same WAL-logged action.
+			 */
+			if (nitups > 0)
+				_hash_move_tuples(rel, nbuf, obuf, start_oblkno,
+								  itups, deletable, nitups);
+
+			if (!npage_full)
+			{
+				_hash_relbuf(rel, nbuf);
+				break;
+			}
+
+			/*
+			 * The current page of the new bucket is full.  Advance to the next
+			 * one, chaining a new overflow page if there is none, and rescan
+			 * the old page for the remaining tuples.
+			 */
+			if (BlockNumberIsValid(nopaque->hasho_nextblkno))
+			{
+				nblkno = nopaque->hasho_nextblkno;
+				_hash_relbuf(rel, nbuf);
 			}
 			else
 			{
-				/*
-				 * the tuple stays on this page, so nothing to do.
-				 */
-				Assert(bucket == obucket);
+				/* _hash_addovflpage wants the tail page pinned, not locked */
+				_hash_chgbufaccess(rel, nbuf, HASH_READ, HASH_NOLOCK);
+				nbuf = _hash_addovflpage(rel, metabuf, nbuf);
+				nblkno = BufferGetBlockNumber(nbuf);
+				_hash_relbuf(rel, nbuf);
 			}
 		}
 
 		oblkno = oopaque->hasho_nextblkno;
+		_hash_relbuf(rel, obuf);
+
+		/* Exit loop if no more overflow pages in old bucket */
+		if (!BlockNumberIsValid(oblkno))
+			break;
 
 		/*
-		 * Done scanning this old page.  If we moved any tuples, delete them
-		 * from the old page.
+		 * Give anyone waiting for either bucket a chance to get in.  If we
+		 * can't get both locks back right away, leave the rest of the split
+		 * for later.  Likewise if somebody else completed the split while we
+		 * weren't holding the locks.
 		 */
-		if (ndeletable > 0)
+		_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
+		_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+
+		if (!_hash_try_getlock(rel, start_oblkno, HASH_EXCLUSIVE))
+			return;
+		if (!_hash_try_getlock(rel, start_nblkno, HASH_EXCLUSIVE))
 		{
-			PageIndexMultiDelete(opage, deletable, ndeletable);
-			_hash_wrtbuf(rel, obuf);
+			_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
+			return;
 		}
-		else
-			_hash_relbuf(rel, obuf);
-
-		/* Exit loop if no more overflow pages in old bucket */
-		if (!BlockNumberIsValid(oblkno))
-			break;
 
-		/* Else, advance to next old page */
-		obuf = _hash_getbuf(rel, oblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
-		opage = BufferGetPage(obuf);
-		oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
+		nbuf = _hash_getbuf(rel, start_nblkno, HASH_READ, LH_BUCKET_PAGE);
+		nopaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(nbuf));
+		if (!H_BUCKET_BEING_POPULATED(nopaque))
+		{
+			_hash_relbuf(rel, nbuf);
+			_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
+			_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+			return;
+		}
+		_hash_relbuf(rel, nbuf);
 	}
 
 	/*
 	 * We're at the end of the old bucket chain, so we're done partitioning
-	 * the tuples.	Before quitting, call _hash_squeezebucket to ensure the
-	 * tuples remaining in the old bucket (including the overflow pages) are
-	 * packed as tightly as possible.  The new bucket is already tight.
+	 * the tuples.  Mark the split as complete.
 	 */
-	_hash_wrtbuf(rel, nbuf);
+	obuf = _hash_getbuf(rel, start_oblkno, HASH_WRITE, LH_BUCKET_PAGE);
+	opage = BufferGetPage(obuf);
+	oopaque = (HashPageOpaque) PageGetSpecialPointer(opage);
+
+	nbuf = _hash_getbuf(rel, start_nblkno, HASH_WRITE, LH_BUCKET_PAGE);
+	npage = BufferGetPage(nbuf);
+	nopaque = (HashPageOpaque) PageGetSpecialPointer(npage);
+
+	START_CRIT_SECTION();
+
+	oopaque->hasho_flag &= ~LH_BUCKET_BEING_SPLIT;
+	MarkBufferDirty(obuf);
+
+	nopaque->hasho_flag &= ~LH_BUCKET_BEING_POPULATED;
+	MarkBufferDirty(nbuf);
+
+	/* XLOG stuff */
+	if (!rel->rd_istemp)
+	{
+		xl_hash_split_complete xlrec;
+		XLogRecPtr	recptr;
+		XLogRecData rdata[3];
+
+		xlrec.node = rel->rd_node;
+		xlrec.old_blkno = start_oblkno;
+		xlrec.new_blkno = start_nblkno;
+
+		rdata[0].data = (char *) &xlrec;
+		rdata[0].len = sizeof(xl_hash_split_complete);
+		rdata[0].buffer = InvalidBuffer;
+		rdata[0].next = &(rdata[1]);
+
+		rdata[1].data = NULL;
+		rdata[1].len = 0;
+		rdata[1].buffer = obuf;
+		rdata[1].buffer_std = true;
+		rdata[1].next = &(rdata[2]);
+
+		rdata[2].data = NULL;
+		rdata[2].len = 0;
+		rdata[2].buffer = nbuf;
+		rdata[2].buffer_std = true;
+		rdata[2].next = NULL;
+
+		recptr = XLogInsert(RM_HASH_ID, XLOG_HASH_SPLIT_COMPLETE, rdata);
+
+		PageSetLSN(opage, recptr);
+		PageSetTLI(opage, ThisTimeLineID);
+		PageSetLSN(npage, recptr);
+		PageSetTLI(npage, ThisTimeLineID);
+	}
 
+	END_CRIT_SECTION();
+
+	_hash_relbuf(rel, obuf);
+	_hash_relbuf(rel, nbuf);
+
+	/* The new bucket is already tight, so others may use it now */
+	_hash_droplock(rel, start_nblkno, HASH_EXCLUSIVE);
+
+	/*
+	 * Before quitting, call _hash_squeezebucket to ensure the tuples
+	 * remaining in the old bucket (including the overflow pages) are packed
+	 * as tightly as possible.
+	 */
 	_hash_squeezebucket(rel, obucket, start_oblkno, NULL);
+
+	_hash_droplock(rel, start_oblkno, HASH_EXCLUSIVE);
+}
+
+/*
+ * _hash_finish_split -- complete an interrupted split of a bucket
+ *
+ * 'bucket' is either half of a split that is still pending, as shown by the
+ * flags on its primary page.  We work out the other half, and if we can get
+ * exclusive locks on both buckets without waiting, relocate the remaining
+ * tuples.  If we can't, we just return; the split will be completed by some
+ * later caller.
+ *
+ * The caller must hold a pin, but no lock, on the metapage buffer, and no
+ * locks on either bucket.
+ */
+void
+_hash_finish_split(Relation rel, Buffer metabuf, Bucket bucket)
+{
+	HashMetaPageData metad;
+	Buffer		buf;
+	HashPageOpaque opaque;
+	Bucket		obucket;
+	Bucket		nbucket;
+	BlockNumber oblkno;
+	BlockNumber nblkno;
+	uint16		flag;
+
+	/*
+	 * Take a copy of the metapage, so that we can map buckets to blocks
+	 * without holding the metapage lock.  That's okay because the blocks of
+	 * existing buckets never move.
+	 */
+	_hash_chgbufaccess(rel, metabuf, HASH_NOLOCK, HASH_READ);
+	memcpy(&metad, HashPageGetMeta(BufferGetPage(metabuf)), sizeof(metad));
+	_hash_chgbufaccess(rel, metabuf, HASH_READ, HASH_NOLOCK);
+
+	buf = _hash_getbuf(rel, BUCKET_TO_BLKNO(&metad, bucket), HASH_READ,
+					   LH_BUCKET_PAGE);
+	opaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(buf));
+	flag = opaque->hasho_flag;
+	_hash_relbuf(rel, buf);
+
+	if (flag & LH_BUCKET_BEING_POPULATED)
+	{
+		nbucket = bucket;
+		obucket = _hash_get_oldbucket(bucket);
+	}
+	else if (flag & LH_BUCKET_BEING_SPLIT)
+	{
+		obucket = bucket;
+		nbucket = _hash_get_newbucket(bucket, metad.hashm_lowmask,
+									  metad.hashm_maxbucket);
+	}
+	else
+		return;					/* somebody else finished it already */
+
+	oblkno = BUCKET_TO_BLKNO(&metad, obucket);
+	nblkno = BUCKET_TO_BLKNO(&metad, nbucket);
+
+	/* As in _hash_expandtable, our own scans aren't excluded by the locks */
+	if (_hash_has_active_scan(rel, obucket) ||
+		_hash_has_active_scan(rel, nbucket))
+		return;
+
+	if (!_hash_try_getlock(rel, oblkno, HASH_EXCLUSIVE))
+		return;
+	if (!_hash_try_getlock(rel, nblkno, HASH_EXCLUSIVE))
+	{
+		_hash_droplock(rel, oblkno, HASH_EXCLUSIVE);
+		return;
+	}
+
+	/* Recheck now that we hold the locks */
+	buf = _hash_getbuf(rel, nblkno, HASH_READ, LH_BUCKET_PAGE);
+	opaque = (HashPageOpaque) PageGetSpecialPointer(BufferGetPage(buf));
+	if (!H_BUCKET_BEING_POPULATED(opaque))
+	{
+		_hash_relbuf(rel, buf);
+		_hash_droplock(rel, oblkno, HASH_EXCLUSIVE);
+		_hash_droplock(rel, nblkno, HASH_EXCLUSIVE);
+		return;
+	}
+	_hash_relbuf(rel, buf);
+
+	/* This releases both bucket locks */
+	_hash_splitbucket(rel, metabuf, obucket, nbucket, oblkno, nblkno);
 }
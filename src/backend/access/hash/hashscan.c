@@ -130,6 +130,9 @@ _hash_dropscan(IndexScanDesc scan)
 
 /*
  * Is there an active scan in this bucket?
+ *
+ * A scan of a bucket that is still being populated by a split also counts
+ * as a scan of the bucket it is being split from.
  */
 bool
 _hash_has_active_scan(Relation rel, Bucket bucket)
@@ -146,6 +149,9 @@ _hash_has_active_scan(Relation rel, Bucket bucket)
 			if (so->hashso_bucket_valid &&
 				so->hashso_bucket == bucket)
 				return true;
+			if (so->hashso_split_bucket_blkno &&
+				so->hashso_split_bucket == bucket)
+				return true;
 		}
 	}
 
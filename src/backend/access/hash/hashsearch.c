@@ -65,21 +65,31 @@ _hash_next(IndexScanDesc scan, ScanDirection dir)
 
 /*
  * Advance to next page in a bucket, if any.
+ *
+ * If the bucket is still being populated by a split, the end of its chain
+ * is followed by the bucket it is being split from.
  */
 static void
-_hash_readnext(Relation rel,
+_hash_readnext(IndexScanDesc scan,
 			   Buffer *bufp, Page *pagep, HashPageOpaque *opaquep)
 {
+	Relation	rel = scan->indexRelation;
+	HashScanOpaque so = (HashScanOpaque) scan->opaque;
 	BlockNumber blkno;
 
 	blkno = (*opaquep)->hasho_nextblkno;
+	if (!BlockNumberIsValid(blkno) &&
+		so->hashso_split_bucket_blkno &&
+		(*opaquep)->hasho_bucket == so->hashso_bucket)
+		blkno = so->hashso_split_bucket_blkno;
 	_hash_relbuf(rel, *bufp);
 	*bufp = InvalidBuffer;
 	/* check for interrupts while we're not holding any buffer lock */
 	CHECK_FOR_INTERRUPTS();
 	if (BlockNumberIsValid(blkno))
 	{
-		*bufp = _hash_getbuf(rel, blkno, HASH_READ, LH_OVERFLOW_PAGE);
+		*bufp = _hash_getbuf(rel, blkno, HASH_READ,
+							 LH_BUCKET_PAGE | LH_OVERFLOW_PAGE);
 		*pagep = BufferGetPage(*bufp);
 		*opaquep = (HashPageOpaque) PageGetSpecialPointer(*pagep);
 	}
@@ -87,19 +97,44 @@ _hash_readnext(Relation rel,
 
 /*
  * Advance to previous page in a bucket, if any.
+ *
+ * This is the reverse of _hash_readnext: before the primary page of the
+ * bucket being split from comes the last page of the bucket being populated.
  */
 static void
-_hash_readprev(Relation rel,
+_hash_readprev(IndexScanDesc scan,
 			   Buffer *bufp, Page *pagep, HashPageOpaque *opaquep)
 {
+	Relation	rel = scan->indexRelation;
+	HashScanOpaque so = (HashScanOpaque) scan->opaque;
 	BlockNumber blkno;
+	bool		to_new_bucket;
 
 	blkno = (*opaquep)->hasho_prevblkno;
+	to_new_bucket = (!BlockNumberIsValid(blkno) &&
+					 so->hashso_split_bucket_blkno &&
+					 (*opaquep)->hasho_bucket == so->hashso_split_bucket);
 	_hash_relbuf(rel, *bufp);
 	*bufp = InvalidBuffer;
 	/* check for interrupts while we're not holding any buffer lock */
 	CHECK_FOR_INTERRUPTS();
-	if (BlockNumberIsValid(blkno))
+	if (to_new_bucket)
+	{
+		/* walk to the end of the bucket being populated */
+		*bufp = _hash_getbuf(rel, so->hashso_bucket_blkno, HASH_READ,
+							 LH_BUCKET_PAGE);
+		*pagep = BufferGetPage(*bufp);
+		*opaquep = (HashPageOpaque) PageGetSpecialPointer(*pagep);
+		while (BlockNumberIsValid((*opaquep)->hasho_nextblkno))
+		{
+			blkno = (*opaquep)->hasho_nextblkno;
+			_hash_relbuf(rel, *bufp);
+			*bufp = _hash_getbuf(rel, blkno, HASH_READ, LH_OVERFLOW_PAGE);
+			*pagep = BufferGetPage(*bufp);
+			*opaquep = (HashPageOpaque) PageGetSpecialPointer(*pagep);
+		}
+	}
+	else if (BlockNumberIsValid(blkno))
 	{
 		*bufp = _hash_getbuf(rel, blkno, HASH_READ,
 							 LH_BUCKET_PAGE | LH_OVERFLOW_PAGE);
@@ -108,6 +143,34 @@ _hash_readprev(Relation rel,
 	}
 }
 
+/*
+ *	_hash_dropscanbuf() -- release the buffers and locks held by a scan.
+ */
+void
+_hash_dropscanbuf(Relation rel, HashScanOpaque so)
+{
+	/* release any pin we still hold on the current page */
+	if (BufferIsValid(so->hashso_curbuf))
+		_hash_dropbuf(rel, so->hashso_curbuf);
+	so->hashso_curbuf = InvalidBuffer;
+
+	/* release pins on the primary bucket pages */
+	if (BufferIsValid(so->hashso_bucket_buf))
+		_hash_dropbuf(rel, so->hashso_bucket_buf);
+	so->hashso_bucket_buf = InvalidBuffer;
+	if (BufferIsValid(so->hashso_split_bucket_buf))
+		_hash_dropbuf(rel, so->hashso_split_bucket_buf);
+	so->hashso_split_bucket_buf = InvalidBuffer;
+
+	/* release locks on the buckets, too */
+	if (so->hashso_bucket_blkno)
+		_hash_droplock(rel, so->hashso_bucket_blkno, HASH_SHARE);
+	so->hashso_bucket_blkno = 0;
+	if (so->hashso_split_bucket_blkno)
+		_hash_droplock(rel, so->hashso_split_bucket_blkno, HASH_SHARE);
+	so->hashso_split_bucket_blkno = 0;
+}
+
 /*
  *	_hash_first() -- Find the first item in a scan.
  *
@@ -126,6 +189,7 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 	uint32		hashkey;
 	Bucket		bucket;
 	BlockNumber blkno;
+	BlockNumber old_blkno = InvalidBlockNumber;
 	Buffer		buf;
 	Buffer		metabuf;
 	Page		page;
@@ -191,6 +255,8 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 	 */
 	_hash_getlock(rel, 0, HASH_SHARE);
 
+retry:
+
 	/* Read the metapage */
 	metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
 	metap = HashPageGetMeta(BufferGetPage(metabuf));
@@ -205,6 +271,10 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 
 	blkno = BUCKET_TO_BLKNO(metap, bucket);
 
+	/* in case the bucket turns out to be still being populated by a split */
+	if (bucket > 0)
+		old_blkno = BUCKET_TO_BLKNO(metap, _hash_get_oldbucket(bucket));
+
 	/* done with the metapage */
 	_hash_relbuf(rel, metabuf);
 
@@ -213,24 +283,81 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 	 */
 	_hash_getlock(rel, blkno, HASH_SHARE);
 
+	/* Fetch the primary bucket page for the bucket */
+	buf = _hash_getbuf(rel, blkno, HASH_READ, LH_BUCKET_PAGE);
+
+	/*
+	 * During hot standby, the startup process takes none of the lmgr locks,
+	 * so the bucket might have been split between our reading the metapage
+	 * and pinning its primary page.  Once the page is pinned, WAL replay
+	 * cannot move tuples out of the bucket, so we need only make sure that
+	 * the metapage still maps our hash key to it.
+	 */
+	if (RecoveryInProgress())
+	{
+		Bucket		check_bucket;
+
+		metabuf = _hash_getbuf(rel, HASH_METAPAGE, HASH_READ, LH_META_PAGE);
+		metap = HashPageGetMeta(BufferGetPage(metabuf));
+		check_bucket = _hash_hashkey2bucket(hashkey,
+											metap->hashm_maxbucket,
+											metap->hashm_highmask,
+											metap->hashm_lowmask);
+		_hash_relbuf(rel, metabuf);
+
+		if (check_bucket != bucket)
+		{
+			_hash_relbuf(rel, buf);
+			_hash_droplock(rel, blkno, HASH_SHARE);
+			goto retry;
+		}
+	}
+
 	_hash_droplock(rel, 0, HASH_SHARE);
 
+	page = BufferGetPage(buf);
+	opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+	Assert(opaque->hasho_bucket == bucket);
+
 	/* Update scan opaque state to show we have lock on the bucket */
 	so->hashso_bucket = bucket;
 	so->hashso_bucket_valid = true;
 	so->hashso_bucket_blkno = blkno;
 
-	/* Fetch the primary bucket page for the bucket */
-	buf = _hash_getbuf(rel, blkno, HASH_READ, LH_BUCKET_PAGE);
-	page = BufferGetPage(buf);
-	opaque = (HashPageOpaque) PageGetSpecialPointer(page);
-	Assert(opaque->hasho_bucket == bucket);
+	/* Keep the primary page pinned until the end of the scan */
+	IncrBufferRefCount(buf);
+	so->hashso_bucket_buf = buf;
+
+	/*
+	 * If the bucket is still being populated by a split, the tuples that have
+	 * not been relocated yet are in the bucket being split, so we must scan
+	 * that too.  Lock and pin its primary page like the one of our own
+	 * bucket.  Don't hold the buffer lock while waiting for the bucket lock.
+	 */
+	if (H_BUCKET_BEING_POPULATED(opaque))
+	{
+		Assert(BlockNumberIsValid(old_blkno));
+
+		_hash_chgbufaccess(rel, buf, HASH_READ, HASH_NOLOCK);
+
+		_hash_getlock(rel, old_blkno, HASH_SHARE);
+
+		so->hashso_split_bucket = _hash_get_oldbucket(bucket);
+		so->hashso_split_bucket_blkno = old_blkno;
+		so->hashso_split_bucket_buf = _hash_getbuf(rel, old_blkno,
+												   HASH_NOLOCK,
+												   LH_BUCKET_PAGE);
+
+		_hash_chgbufaccess(rel, buf, HASH_NOLOCK, HASH_READ);
+	}
 
 	/* If a backwards scan is requested, move to the end of the chain */
 	if (ScanDirectionIsBackward(dir))
 	{
-		while (BlockNumberIsValid(opaque->hasho_nextblkno))
-			_hash_readnext(rel, &buf, &page, &opaque);
+		while (BlockNumberIsValid(opaque->hasho_nextblkno) ||
+			   (so->hashso_split_bucket_blkno &&
+				opaque->hasho_bucket == so->hashso_bucket))
+			_hash_readnext(scan, &buf, &page, &opaque);
 	}
 
 	/* Now find the first tuple satisfying the qualification */
@@ -250,6 +377,9 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 /*
  *	_hash_step() -- step to the next valid item in a scan in the bucket.
  *
+ *		If the bucket is still being populated by a split, this continues
+ *		into the bucket being split from; see _hash_readnext.
+ *
  *		If no valid record exists in the requested direction, return
  *		false.	Else, return true and set the hashso_curpos for the
  *		scan to the right thing.
@@ -326,7 +456,7 @@ _hash_step(IndexScanDesc scan, Buffer *bufP, ScanDirection dir)
 					/*
 					 * ran off the end of this page, try the next
 					 */
-					_hash_readnext(rel, &buf, &page, &opaque);
+					_hash_readnext(scan, &buf, &page, &opaque);
 					if (BufferIsValid(buf))
 					{
 						maxoff = PageGetMaxOffsetNumber(page);
@@ -367,7 +497,7 @@ _hash_step(IndexScanDesc scan, Buffer *bufP, ScanDirection dir)
 					/*
 					 * ran off the end of this page, try the next
 					 */
-					_hash_readprev(rel, &buf, &page, &opaque);
+					_hash_readprev(scan, &buf, &page, &opaque);
 					if (BufferIsValid(buf))
 					{
 						maxoff = PageGetMaxOffsetNumber(page);
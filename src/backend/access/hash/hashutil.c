@@ -142,6 +142,61 @@ _hash_log2(uint32 num)
 	return i;
 }
 
+/*
+ * _hash_get_oldbucket -- the bucket that new_bucket was split from
+ *
+ * That is simply new_bucket with its most significant bit cleared.
+ */
+Bucket
+_hash_get_oldbucket(Bucket new_bucket)
+{
+	uint32		mask;
+
+	Assert(new_bucket > 0);
+	mask = (((uint32) 1) << _hash_log2(new_bucket + 1)) - 1;
+
+	return new_bucket & (mask >> 1);
+}
+
+/*
+ * _hash_get_newbucket -- the bucket most recently split off old_bucket
+ *
+ * lowmask and maxbucket are the current metapage values.  This is only
+ * meaningful while old_bucket is marked as being split: such a bucket is not
+ * split again before the pending split completes, so its newest child is
+ * either in the current doubling or, if that child does not exist yet, in
+ * the previous one.
+ */
+Bucket
+_hash_get_newbucket(Bucket old_bucket, uint32 lowmask, uint32 maxbucket)
+{
+	Bucket		new_bucket;
+
+	new_bucket = old_bucket + lowmask + 1;
+	if (new_bucket > maxbucket)
+		new_bucket = old_bucket + ((lowmask + 1) >> 1);
+
+	return new_bucket;
+}
+
+/*
+ * _hash_tuple_moves_to -- does a tuple of the old bucket belong in new_bucket?
+ *
+ * A tuple with this hashkey that lives in new_bucket's old bucket must move
+ * if and only if its low-order bits, up to and including new_bucket's most
+ * significant bit, equal new_bucket.  This does not depend on the current
+ * metapage state, so an interrupted split can be resumed at any later time.
+ */
+bool
+_hash_tuple_moves_to(uint32 hashkey, Bucket new_bucket)
+{
+	uint32		mask;
+
+	mask = (((uint32) 1) << _hash_log2(new_bucket + 1)) - 1;
+
+	return (hashkey & mask) == new_bucket;
+}
+
 /*
  * _hash_checkpage -- sanity checks on the format of all hash pages
  *
@@ -0,0 +1,767 @@
+/*-------------------------------------------------------------------------
+ *
+ * hashxlog.c
+ *	  WAL replay logic for hash index.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/hash.h"
+#include "access/xlog_internal.h"
+#include "access/xlogutils.h"
+#include "storage/bufmgr.h"
+#include "storage/smgr.h"
+
+
+/*
+ * Get a cleanup lock on a bucket's primary page.
+ *
+ * Records that remove tuples from a bucket, or move them around within it
+ * or out of it, are replayed while holding a cleanup lock on the bucket's
+ * primary page.  Hot standby scans keep that page pinned for as long as they
+ * are in the bucket, so this plays the role of the exclusive bucket lock
+ * the master held, which the startup process does not take.  Returns
+ * InvalidBuffer if the page no longer exists.
+ */
+static Buffer
+hash_xlog_lock_bucket(RelFileNode node, BlockNumber bucket_blkno)
+{
+	Buffer		buffer;
+
+	buffer = XLogReadBufferExtended(node, MAIN_FORKNUM, bucket_blkno,
+									RBM_NORMAL);
+	if (BufferIsValid(buffer))
+		LockBufferForCleanup(buffer);
+
+	return buffer;
+}
+
+/*
+ * Same as RestoreBkpBlocks, except that the bucket's primary page, which the
+ * caller has already locked via hash_xlog_lock_bucket, is restored in place
+ * without being locked a second time.
+ */
+static void
+hash_xlog_restore_bkp_blocks(XLogRecPtr lsn, XLogRecord *record,
+							 Buffer bucketbuf)
+{
+	Buffer		buffer;
+	Page		page;
+	BkpBlock	bkpb;
+	char	   *blk;
+	int			i;
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_MASK))
+		return;
+
+	blk = (char *) XLogRecGetData(record) + record->xl_len;
+	for (i = 0; i < XLR_MAX_BKP_BLOCKS; i++)
+	{
+		if (!(record->xl_info & XLR_SET_BKP_BLOCK(i)))
+			continue;
+
+		memcpy(&bkpb, blk, sizeof(BkpBlock));
+		blk += sizeof(BkpBlock);
+
+		if (BufferIsValid(bucketbuf) && bkpb.fork == MAIN_FORKNUM &&
+			bkpb.block == BufferGetBlockNumber(bucketbuf))
+			buffer = bucketbuf;
+		else
+		{
+			buffer = XLogReadBufferExtended(bkpb.node, bkpb.fork, bkpb.block,
+											RBM_ZERO);
+			Assert(BufferIsValid(buffer));
+			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		}
+
+		page = (Page) BufferGetPage(buffer);
+
+		blk = RestoreBkpBlockImage(&bkpb, blk, (char *) page);
+
+		PageSetLSN(page, lsn);
+		PageSetTLI(page, ThisTimeLineID);
+		MarkBufferDirty(buffer);
+		if (buffer != bucketbuf)
+			UnlockReleaseBuffer(buffer);
+	}
+}
+
+/*
+ * Read and exclusive-lock a page, reusing the bucket's primary page buffer
+ * if that is the page wanted.
+ */
+static Buffer
+hash_xlog_readbuf(RelFileNode node, BlockNumber blkno, Buffer bucketbuf)
+{
+	if (BufferIsValid(bucketbuf) && BufferGetBlockNumber(bucketbuf) == blkno)
+		return bucketbuf;
+	return XLogReadBuffer(node, blkno, false);
+}
+
+static void
+hash_xlog_relbuf(Buffer buffer, Buffer bucketbuf)
+{
+	if (buffer != bucketbuf)
+		UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * Initialize a hash page from scratch, the way the master did.
+ */
+static void
+hash_xlog_initpage(Buffer buffer, BlockNumber prevblkno,
+				   Bucket bucket, uint16 flag)
+{
+	Page		page = BufferGetPage(buffer);
+	HashPageOpaque opaque;
+
+	_hash_pageinit(page, BufferGetPageSize(buffer));
+
+	opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+	opaque->hasho_prevblkno = prevblkno;
+	opaque->hasho_nextblkno = InvalidBlockNumber;
+	opaque->hasho_bucket = bucket;
+	opaque->hasho_flag = flag;
+	opaque->hasho_page_id = HASHO_PAGE_ID;
+}
+
+/*
+ * Add a logged index tuple to a page at the position _hash_pgaddtup would
+ * choose, and return the (MAXALIGN'd) space it took up in the record.  The
+ * tuple need not be aligned within the record.
+ */
+static Size
+hash_xlog_addtup(Page page, char *tup)
+{
+	IndexTupleData itupdata;
+	uint32		hashkey;
+	Size		itemsz;
+	OffsetNumber offnum;
+
+	/* Need to copy tuple header and hash key due to alignment considerations */
+	memcpy(&itupdata, tup, sizeof(IndexTupleData));
+	itemsz = MAXALIGN(IndexTupleDSize(itupdata));
+	memcpy(&hashkey, tup + IndexInfoFindDataOffset(itupdata.t_info),
+		   sizeof(uint32));
+
+	offnum = _hash_binsearch(page, hashkey);
+	if (PageAddItem(page, (Item) tup, itemsz, offnum,
+					false, false) == InvalidOffsetNumber)
+		elog(PANIC, "hash_redo: failed to add index item");
+
+	return itemsz;
+}
+
+static void
+hash_xlog_insert(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_insert *xlrec = (xl_hash_insert *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->blkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				char	   *tup = (char *) xlrec + SizeOfHashInsert;
+				Size		itemsz = record->xl_len - SizeOfHashInsert;
+
+				if (PageAddItem(page, (Item) tup, itemsz, xlrec->offnum,
+								false, false) == InvalidOffsetNumber)
+					elog(PANIC, "hash_xlog_insert: failed to add index item");
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_2))
+	{
+		buffer = XLogReadBuffer(xlrec->node, HASH_METAPAGE, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				HashPageGetMeta(page)->hashm_ntuples += 1;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+}
+
+static void
+hash_xlog_add_ovfl_page(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_add_ovfl_page *xlrec = (xl_hash_add_ovfl_page *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	/* The new overflow page is always initialized from scratch */
+	buffer = XLogReadBuffer(xlrec->node, xlrec->ovflblkno, true);
+	Assert(BufferIsValid(buffer));
+	hash_xlog_initpage(buffer, xlrec->prevblkno, xlrec->bucket,
+					   LH_OVERFLOW_PAGE);
+	page = BufferGetPage(buffer);
+	PageSetLSN(page, lsn);
+	PageSetTLI(page, ThisTimeLineID);
+	MarkBufferDirty(buffer);
+	UnlockReleaseBuffer(buffer);
+
+	/* Chain it after the bucket's tail page */
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->prevblkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				HashPageOpaque opaque;
+
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_nextblkno = xlrec->ovflblkno;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+}
+
+static void
+hash_xlog_update_bitmap(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_update_bitmap *xlrec = (xl_hash_update_bitmap *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	if (record->xl_info & XLR_BKP_BLOCK_1)
+		return;
+
+	buffer = XLogReadBuffer(xlrec->node, xlrec->mapblkno, false);
+	if (!BufferIsValid(buffer))
+		return;
+	page = BufferGetPage(buffer);
+
+	if (!XLByteLE(lsn, PageGetLSN(page)))
+	{
+		uint32	   *freep = HashPageGetBitmap(page);
+
+		if (xlrec->setbit)
+			SETBIT(freep, xlrec->bitmapbit);
+		else
+			CLRBIT(freep, xlrec->bitmapbit);
+
+		PageSetLSN(page, lsn);
+		PageSetTLI(page, ThisTimeLineID);
+		MarkBufferDirty(buffer);
+	}
+	UnlockReleaseBuffer(buffer);
+}
+
+static void
+hash_xlog_metapage(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_metapage *xlrec = (xl_hash_metapage *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	if (record->xl_info & XLR_BKP_BLOCK_1)
+		return;
+
+	buffer = XLogReadBuffer(xlrec->node, HASH_METAPAGE, false);
+	if (!BufferIsValid(buffer))
+		return;
+	page = BufferGetPage(buffer);
+
+	if (!XLByteLE(lsn, PageGetLSN(page)))
+	{
+		memcpy(HashPageGetMeta(page), &xlrec->metadata,
+			   sizeof(HashMetaPageData));
+
+		PageSetLSN(page, lsn);
+		PageSetTLI(page, ThisTimeLineID);
+		MarkBufferDirty(buffer);
+	}
+	UnlockReleaseBuffer(buffer);
+}
+
+static void
+hash_xlog_move_tuples(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_move_tuples *xlrec = (xl_hash_move_tuples *) XLogRecGetData(record);
+	OffsetNumber *offsets;
+	Buffer		bucketbuf;
+	Buffer		buffer;
+	Page		page;
+
+	offsets = (OffsetNumber *) ((char *) xlrec + SizeOfHashMoveTuples);
+
+	bucketbuf = hash_xlog_lock_bucket(xlrec->node, xlrec->bucket_blkno);
+	hash_xlog_restore_bkp_blocks(lsn, record, bucketbuf);
+
+	/* Add the tuples to the write page */
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = hash_xlog_readbuf(xlrec->node, xlrec->wblkno, bucketbuf);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				char	   *tup = (char *) (offsets + xlrec->ntuples);
+				int			i;
+
+				for (i = 0; i < xlrec->ntuples; i++)
+					tup += hash_xlog_addtup(page, tup);
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			hash_xlog_relbuf(buffer, bucketbuf);
+		}
+	}
+
+	/* And delete them from the read page */
+	if (!(record->xl_info & XLR_BKP_BLOCK_2))
+	{
+		buffer = hash_xlog_readbuf(xlrec->node, xlrec->rblkno, bucketbuf);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				PageIndexMultiDelete(page, offsets, xlrec->ntuples);
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			hash_xlog_relbuf(buffer, bucketbuf);
+		}
+	}
+
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+static void
+hash_xlog_free_ovfl_page(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_free_ovfl_page *xlrec = (xl_hash_free_ovfl_page *) XLogRecGetData(record);
+	Buffer		bucketbuf;
+	Buffer		buffer;
+	Page		page;
+	HashPageOpaque opaque;
+
+	bucketbuf = hash_xlog_lock_bucket(xlrec->node, xlrec->bucket_blkno);
+	hash_xlog_restore_bkp_blocks(lsn, record, bucketbuf);
+
+	/* Unlink the page from its neighbours */
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = hash_xlog_readbuf(xlrec->node, xlrec->prevblkno, bucketbuf);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_nextblkno = xlrec->nextblkno;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			hash_xlog_relbuf(buffer, bucketbuf);
+		}
+	}
+
+	if (BlockNumberIsValid(xlrec->nextblkno) &&
+		!(record->xl_info & XLR_BKP_BLOCK_2))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->nextblkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_prevblkno = xlrec->prevblkno;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	/* The freed page is reinitialized as an unused page */
+	buffer = XLogReadBuffer(xlrec->node, xlrec->ovflblkno, true);
+	Assert(BufferIsValid(buffer));
+	hash_xlog_initpage(buffer, InvalidBlockNumber, (Bucket) -1,
+					   LH_UNUSED_PAGE);
+	page = BufferGetPage(buffer);
+	PageSetLSN(page, lsn);
+	PageSetTLI(page, ThisTimeLineID);
+	MarkBufferDirty(buffer);
+	UnlockReleaseBuffer(buffer);
+
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+static void
+hash_xlog_delete(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_delete *xlrec = (xl_hash_delete *) XLogRecGetData(record);
+	Buffer		bucketbuf;
+	Buffer		buffer;
+	Page		page;
+
+	bucketbuf = hash_xlog_lock_bucket(xlrec->node, xlrec->bucket_blkno);
+	hash_xlog_restore_bkp_blocks(lsn, record, bucketbuf);
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = hash_xlog_readbuf(xlrec->node, xlrec->blkno, bucketbuf);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				OffsetNumber *unused;
+				OffsetNumber *unend;
+
+				unused = (OffsetNumber *) ((char *) xlrec + SizeOfHashDelete);
+				unend = (OffsetNumber *) ((char *) xlrec + record->xl_len);
+
+				if ((unend - unused) > 0)
+					PageIndexMultiDelete(page, unused, unend - unused);
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			hash_xlog_relbuf(buffer, bucketbuf);
+		}
+	}
+
+	if (BufferIsValid(bucketbuf))
+		UnlockReleaseBuffer(bucketbuf);
+}
+
+static void
+hash_xlog_split_allocate(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_split_allocate *xlrec = (xl_hash_split_allocate *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+
+	/*
+	 * If the split began a new splitpoint, make sure the file extends to the
+	 * end of it, as _hash_alloc_buckets did.  The block is only written if
+	 * it doesn't exist yet; it might already hold a bucket initialized by a
+	 * later record.
+	 */
+	if (BlockNumberIsValid(xlrec->lastblkno))
+	{
+		SMgrRelation smgr = smgropen(xlrec->node, InvalidBackendId);
+
+		smgrcreate(smgr, MAIN_FORKNUM, true);
+		if (smgrnblocks(smgr, MAIN_FORKNUM) <= xlrec->lastblkno)
+		{
+			char		zerobuf[BLCKSZ];
+
+			MemSet(zerobuf, 0, sizeof(zerobuf));
+			smgrextend(smgr, MAIN_FORKNUM, xlrec->lastblkno, zerobuf, false);
+		}
+	}
+
+	/* Update the bucket mapping in the metapage */
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = XLogReadBuffer(xlrec->node, HASH_METAPAGE, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				HashMetaPage metap = HashPageGetMeta(page);
+
+				metap->hashm_maxbucket = xlrec->maxbucket;
+				metap->hashm_highmask = xlrec->highmask;
+				metap->hashm_lowmask = xlrec->lowmask;
+				metap->hashm_ovflpoint = xlrec->ovflpoint;
+				metap->hashm_spares[xlrec->ovflpoint] = xlrec->ovflpoint_spares;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	/* Mark the old bucket as being split */
+	if (!(record->xl_info & XLR_BKP_BLOCK_2))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->old_blkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				HashPageOpaque opaque;
+
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_flag |= LH_BUCKET_BEING_SPLIT;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	/* And initialize the new bucket's primary page */
+	buffer = XLogReadBuffer(xlrec->node, xlrec->new_blkno, true);
+	Assert(BufferIsValid(buffer));
+	hash_xlog_initpage(buffer, InvalidBlockNumber, xlrec->new_bucket,
+					   LH_BUCKET_PAGE | LH_BUCKET_BEING_POPULATED);
+	page = BufferGetPage(buffer);
+	PageSetLSN(page, lsn);
+	PageSetTLI(page, ThisTimeLineID);
+	MarkBufferDirty(buffer);
+	UnlockReleaseBuffer(buffer);
+}
+
+static void
+hash_xlog_split_complete(XLogRecPtr lsn, XLogRecord *record)
+{
+	xl_hash_split_complete *xlrec = (xl_hash_split_complete *) XLogRecGetData(record);
+	Buffer		buffer;
+	Page		page;
+	HashPageOpaque opaque;
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_1))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->old_blkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_flag &= ~LH_BUCKET_BEING_SPLIT;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+
+	if (!(record->xl_info & XLR_BKP_BLOCK_2))
+	{
+		buffer = XLogReadBuffer(xlrec->node, xlrec->new_blkno, false);
+		if (BufferIsValid(buffer))
+		{
+			page = BufferGetPage(buffer);
+			if (!XLByteLE(lsn, PageGetLSN(page)))
+			{
+				opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+				opaque->hasho_flag &= ~LH_BUCKET_BEING_POPULATED;
+
+				PageSetLSN(page, lsn);
+				PageSetTLI(page, ThisTimeLineID);
+				MarkBufferDirty(buffer);
+			}
+			UnlockReleaseBuffer(buffer);
+		}
+	}
+}
+
+void
+hash_redo(XLogRecPtr lsn, XLogRecord *record)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+
+	/*
+	 * Records that delete or move tuples restore their backup blocks
+	 * themselves, under a cleanup lock on the bucket; see
+	 * hash_xlog_lock_bucket.
+	 */
+	if (info != XLOG_HASH_MOVE_TUPLES &&
+		info != XLOG_HASH_FREE_OVFL_PAGE &&
+		info != XLOG_HASH_DELETE)
+		RestoreBkpBlocks(lsn, record, false);
+
+	switch (info)
+	{
+		case XLOG_HASH_INSERT:
+			hash_xlog_insert(lsn, record);
+			break;
+		case XLOG_HASH_ADD_OVFL_PAGE:
+			hash_xlog_add_ovfl_page(lsn, record);
+			break;
+		case XLOG_HASH_UPDATE_BITMAP:
+			hash_xlog_update_bitmap(lsn, record);
+			break;
+		case XLOG_HASH_METAPAGE:
+			hash_xlog_metapage(lsn, record);
+			break;
+		case XLOG_HASH_MOVE_TUPLES:
+			hash_xlog_move_tuples(lsn, record);
+			break;
+		case XLOG_HASH_FREE_OVFL_PAGE:
+			hash_xlog_free_ovfl_page(lsn, record);
+			break;
+		case XLOG_HASH_DELETE:
+			hash_xlog_delete(lsn, record);
+			break;
+		case XLOG_HASH_SPLIT_ALLOCATE:
+			hash_xlog_split_allocate(lsn, record);
+			break;
+		case XLOG_HASH_SPLIT_COMPLETE:
+			hash_xlog_split_complete(lsn, record);
+			break;
+		default:
+			elog(PANIC, "hash_redo: unknown op code %u", info);
+	}
+}
+
+static void
+out_target(StringInfo buf, RelFileNode node, BlockNumber blkno)
+{
+	appendStringInfo(buf, "rel %u/%u/%u; blk %u",
+					 node.spcNode, node.dbNode, node.relNode, blkno);
+}
+
+void
+hash_desc(StringInfo buf, uint8 xl_info, char *rec)
+{
+	uint8		info = xl_info & ~XLR_INFO_MASK;
+
+	switch (info)
+	{
+		case XLOG_HASH_INSERT:
+			{
+				xl_hash_insert *xlrec = (xl_hash_insert *) rec;
+
+				appendStringInfo(buf, "insert: ");
+				out_target(buf, xlrec->node, xlrec->blkno);
+				appendStringInfo(buf, "; off %u", xlrec->offnum);
+				break;
+			}
+		case XLOG_HASH_ADD_OVFL_PAGE:
+			{
+				xl_hash_add_ovfl_page *xlrec = (xl_hash_add_ovfl_page *) rec;
+
+				appendStringInfo(buf, "add overflow page: ");
+				out_target(buf, xlrec->node, xlrec->ovflblkno);
+				appendStringInfo(buf, "; prev %u; bucket %u",
+								 xlrec->prevblkno, xlrec->bucket);
+				break;
+			}
+		case XLOG_HASH_UPDATE_BITMAP:
+			{
+				xl_hash_update_bitmap *xlrec = (xl_hash_update_bitmap *) rec;
+
+				appendStringInfo(buf, "%s bitmap bit: ",
+								 xlrec->setbit ? "set" : "clear");
+				out_target(buf, xlrec->node, xlrec->mapblkno);
+				appendStringInfo(buf, "; bit %u", xlrec->bitmapbit);
+				break;
+			}
+		case XLOG_HASH_METAPAGE:
+			{
+				xl_hash_metapage *xlrec = (xl_hash_metapage *) rec;
+
+				appendStringInfo(buf, "update metapage: ");
+				out_target(buf, xlrec->node, HASH_METAPAGE);
+				appendStringInfo(buf, "; firstfree %u; nmaps %u",
+								 xlrec->metadata.hashm_firstfree,
+								 xlrec->metadata.hashm_nmaps);
+				break;
+			}
+		case XLOG_HASH_MOVE_TUPLES:
+			{
+				xl_hash_move_tuples *xlrec = (xl_hash_move_tuples *) rec;
+
+				appendStringInfo(buf, "move tuples: ");
+				out_target(buf, xlrec->node, xlrec->rblkno);
+				appendStringInfo(buf, "; to blk %u; ntuples %u; bucket blk %u",
+								 xlrec->wblkno, xlrec->ntuples,
+								 xlrec->bucket_blkno);
+				break;
+			}
+		case XLOG_HASH_FREE_OVFL_PAGE:
+			{
+				xl_hash_free_ovfl_page *xlrec = (xl_hash_free_ovfl_page *) rec;
+
+				appendStringInfo(buf, "free overflow page: ");
+				out_target(buf, xlrec->node, xlrec->ovflblkno);
+				appendStringInfo(buf, "; prev %u; next %u",
+								 xlrec->prevblkno, xlrec->nextblkno);
+				break;
+			}
+		case XLOG_HASH_DELETE:
+			{
+				xl_hash_delete *xlrec = (xl_hash_delete *) rec;
+
+				appendStringInfo(buf, "delete: ");
+				out_target(buf, xlrec->node, xlrec->blkno);
+				appendStringInfo(buf, "; bucket blk %u", xlrec->bucket_blkno);
+				break;
+			}
+		case XLOG_HASH_SPLIT_ALLOCATE:
+			{
+				xl_hash_split_allocate *xlrec = (xl_hash_split_allocate *) rec;
+
+				appendStringInfo(buf, "split allocate: ");
+				out_target(buf, xlrec->node, xlrec->new_blkno);
+				appendStringInfo(buf, "; old bucket %u; new bucket %u",
+								 xlrec->old_bucket, xlrec->new_bucket);
+				break;
+			}
+		case XLOG_HASH_SPLIT_COMPLETE:
+			{
+				xl_hash_split_complete *xlrec = (xl_hash_split_complete *) rec;
+
+				appendStringInfo(buf, "split complete: ");
+				out_target(buf, xlrec->node, xlrec->new_blkno);
+				appendStringInfo(buf, "; old blk %u", xlrec->old_blkno);
+				break;
+			}
+		default:
+			appendStringInfo(buf, "UNKNOWN");
+			break;
+	}
+}
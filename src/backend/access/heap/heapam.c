@@ -78,11 +78,25 @@ static HeapScanDesc heap_beginscan_internal(Relation relation,
 						int nkeys, ScanKey key,
 						bool allow_strat, bool allow_sync,
 						bool is_bitmapscan);
+static HeapTuple heap_prepare_insert(Relation relation, HeapTuple tup,
+					TransactionId xid, CommandId cid, int options);
 static XLogRecPtr log_heap_update(Relation reln, Buffer oldbuf,
 				ItemPointerData from, Buffer newbuf, HeapTuple newtup,
+				HeapTuple oldkey,
 				bool all_visible_cleared, bool new_all_visible_cleared);
 static bool HeapSatisfiesHOTUpdate(Relation relation, Bitmapset *hot_attrs,
 					   HeapTuple oldtup, HeapTuple newtup);
+static HeapTuple ExtractKeyTuple(Relation relation, HeapTuple tp,
+				Bitmapset *key_attrs);
+
+/*
+ * Do changes to this relation have to carry enough information in WAL for
+ * logical decoding to reconstruct them?  System catalogs and TOAST tables
+ * are never decoded, so we don't bother for them.
+ */
+#define RelationIsLogicallyLogged(relation) \
+	(XLogLogicalInfoActive() && !(relation)->rd_istemp && \
+	 !IsSystemRelation(relation))
 
 
 /* ----------------------------------------------------------------
@@ -90,6 +104,37 @@ static bool HeapSatisfiesHOTUpdate(Relation relation, Bitmapset *hot_attrs,
  * ----------------------------------------------------------------
  */
 
+/* ----------------
+ *		heap_scan_stream_next - read stream callback for seqscans
+ *
+ *		A forward seqscan reads the pages from rs_startblock up to the end
+ *		of the relation, and then wraps around to the pages before
+ *		rs_startblock.  Backward scans don't match this, but the stream
+ *		copes with that by reading the pages directly.
+ * ----------------
+ */
+static BlockNumber
+heap_scan_stream_next(void *callback_private, BlockNumber prevBlock,
+					  bool restart)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private;
+	BlockNumber next;
+
+	if (scan->rs_nblocks == 0)
+		return InvalidBlockNumber;
+
+	if (!BlockNumberIsValid(prevBlock))
+		return scan->rs_startblock;
+
+	next = prevBlock + 1;
+	if (next >= scan->rs_nblocks)
+		next = 0;
+	if (next == scan->rs_startblock)
+		return InvalidBlockNumber;
+
+	return next;
+}
+
 /* ----------------
  *		initscan - scan code common to heap_beginscan and heap_rescan
  * ----------------
@@ -165,6 +210,21 @@ initscan(HeapScanDesc scan, ScanKey key, bool is_rescan)
 		scan->rs_startblock = 0;
 	}
 
+	/*
+	 * Set up a read stream to read ahead the pages of a plain seqscan.  It
+	 * must be made over if the strategy changed, so just always do that.
+	 */
+	if (scan->rs_stream != NULL)
+	{
+		ReadStreamEnd(scan->rs_stream);
+		scan->rs_stream = NULL;
+	}
+	if (!scan->rs_bitmapscan)
+		scan->rs_stream = ReadStreamBegin(scan->rs_rd, MAIN_FORKNUM,
+										  scan->rs_strategy,
+										  heap_scan_stream_next,
+										  (void *) scan);
+
 	scan->rs_inited = false;
 	scan->rs_ctup.t_data = NULL;
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
@@ -218,9 +278,8 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 		scan->rs_cbuf = InvalidBuffer;
 	}
 
-	/* read page using selected strategy */
-	scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
-									   RBM_NORMAL, scan->rs_strategy);
+	/* read page using selected strategy, through the read-ahead stream */
+	scan->rs_cbuf = ReadStreamReadBuffer(scan->rs_stream, page);
 	scan->rs_cblock = page;
 
 	if (!scan->rs_pageatatime)
@@ -1210,6 +1269,7 @@ heap_beginscan_internal(Relation relation, Snapshot snapshot,
 	scan->rs_nkeys = nkeys;
 	scan->rs_bitmapscan = is_bitmapscan;
 	scan->rs_strategy = NULL;	/* set in initscan */
+	scan->rs_stream = NULL;		/* set in initscan */
 	scan->rs_allow_strat = allow_strat;
 	scan->rs_allow_sync = allow_sync;
 
@@ -1281,6 +1341,9 @@ heap_endscan(HeapScanDesc scan)
 	if (scan->rs_key)
 		pfree(scan->rs_key);
 
+	if (scan->rs_stream != NULL)
+		ReadStreamEnd(scan->rs_stream);
+
 	if (scan->rs_strategy != NULL)
 		FreeAccessStrategy(scan->rs_strategy);
 
@@ -1838,55 +1901,14 @@ heap_insert(Relation relation, HeapTuple tup, CommandId cid,
 	Buffer		buffer;
 	bool		all_visible_cleared = false;
 
-	if (relation->rd_rel->relhasoids)
-	{
-#ifdef NOT_USED
-		/* this is redundant with an Assert in HeapTupleSetOid */
-		Assert(tup->t_data->t_infomask & HEAP_HASOID);
-#endif
-
-		/*
-		 * If the object id of this tuple has already been assigned, trust the
-		 * caller.	There are a couple of ways this can happen.  At initial db
-		 * creation, the backend program sets oids for tuples. When we define
-		 * an index, we set the oid.  Finally, in the future, we may allow
-		 * users to set their own object ids in order to support a persistent
-		 * object store (objects need to contain pointers to one another).
-		 */
-		if (!OidIsValid(HeapTupleGetOid(tup)))
-			HeapTupleSetOid(tup, GetNewOid(relation));
-	}
-	else
-	{
-		/* check there is not space for an OID */
-		Assert(!(tup->t_data->t_infomask & HEAP_HASOID));
-	}
-
-	tup->t_data->t_infomask &= ~(HEAP_XACT_MASK);
-	tup->t_data->t_infomask2 &= ~(HEAP2_XACT_MASK);
-	tup->t_data->t_infomask |= HEAP_XMAX_INVALID;
-	HeapTupleHeaderSetXmin(tup->t_data, xid);
-	HeapTupleHeaderSetCmin(tup->t_data, cid);
-	HeapTupleHeaderSetXmax(tup->t_data, 0);		/* for cleanliness */
-	tup->t_tableOid = RelationGetRelid(relation);
-
 	/*
-	 * If the new tuple is too big for storage or contains already toasted
-	 * out-of-line attributes from some other relation, invoke the toaster.
+	 * Fill in tuple header fields, assign an OID, and toast the tuple if
+	 * necessary.
 	 *
 	 * Note: below this point, heaptup is the data we actually intend to store
 	 * into the relation; tup is the caller's original untoasted data.
 	 */
-	if (relation->rd_rel->relkind != RELKIND_RELATION)
-	{
-		/* toast table entries should never be recursively toasted */
-		Assert(!HeapTupleHasExternal(tup));
-		heaptup = tup;
-	}
-	else if (HeapTupleHasExternal(tup) || tup->t_len > TOAST_TUPLE_THRESHOLD)
-		heaptup = toast_insert_or_update(relation, tup, NULL, options);
-	else
-		heaptup = tup;
+	heaptup = heap_prepare_insert(relation, tup, xid, cid, options);
 
 	/* Find buffer to insert this tuple into */
 	buffer = RelationGetBufferForTuple(relation, heaptup->t_len,
@@ -1968,6 +1990,13 @@ heap_insert(Relation relation, HeapTuple tup, CommandId cid,
 			rdata[1].buffer = rdata[2].buffer = InvalidBuffer;
 		}
 
+		/*
+		 * Logical decoding needs the tuple even if the whole page is
+		 * backed up.
+		 */
+		if (RelationIsLogicallyLogged(relation))
+			rdata[1].buffer = rdata[2].buffer = InvalidBuffer;
+
 		recptr = XLogInsert(RM_HEAP_ID, info, rdata);
 
 		PageSetLSN(page, recptr);
@@ -1991,7 +2020,7 @@ heap_insert(Relation relation, HeapTuple tup, CommandId cid,
 	 */
 	CacheInvalidateHeapTuple(relation, heaptup);
 
-	pgstat_count_heap_insert(relation);
+	pgstat_count_heap_insert(relation, 1);
 
 	/*
 	 * If heaptup is a private copy, release it.  Don't forget to copy t_self
@@ -2006,6 +2035,288 @@ heap_insert(Relation relation, HeapTuple tup, CommandId cid,
 	return HeapTupleGetOid(tup);
 }
 
+/*
+ * Subroutine for heap_insert() and heap_multi_insert().  Prepares a tuple
+ * for insertion: sets the tuple header fields, assigns an OID, and toasts
+ * the tuple if necessary.  Returns a toasted version of the tuple if it was
+ * toasted, or the original tuple if not.
+ */
+static HeapTuple
+heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
+					CommandId cid, int options)
+{
+	if (relation->rd_rel->relhasoids)
+	{
+#ifdef NOT_USED
+		/* this is redundant with an Assert in HeapTupleSetOid */
+		Assert(tup->t_data->t_infomask & HEAP_HASOID);
+#endif
+
+		/*
+		 * If the object id of this tuple has already been assigned, trust the
+		 * caller.	There are a couple of ways this can happen.  At initial db
+		 * creation, the backend program sets oids for tuples. When we define
+		 * an index, we set the oid.  Finally, in the future, we may allow
+		 * users to set their own object ids in order to support a persistent
+		 * object store (objects need to contain pointers to one another).
+		 */
+		if (!OidIsValid(HeapTupleGetOid(tup)))
+			HeapTupleSetOid(tup, GetNewOid(relation));
+	}
+	else
+	{
+		/* check there is not space for an OID */
+		Assert(!(tup->t_data->t_infomask & HEAP_HASOID));
+	}
+
+	tup->t_data->t_infomask &= ~(HEAP_XACT_MASK);
+	tup->t_data->t_infomask2 &= ~(HEAP2_XACT_MASK);
+	tup->t_data->t_infomask |= HEAP_XMAX_INVALID;
+	HeapTupleHeaderSetXmin(tup->t_data, xid);
+	HeapTupleHeaderSetCmin(tup->t_data, cid);
+	HeapTupleHeaderSetXmax(tup->t_data, 0);		/* for cleanliness */
+	tup->t_tableOid = RelationGetRelid(relation);
+
+	/*
+	 * If the new tuple is too big for storage or contains already toasted
+	 * out-of-line attributes from some other relation, invoke the toaster.
+	 */
+	if (relation->rd_rel->relkind != RELKIND_RELATION)
+	{
+		/* toast table entries should never be recursively toasted */
+		Assert(!HeapTupleHasExternal(tup));
+		return tup;
+	}
+	else if (HeapTupleHasExternal(tup) || tup->t_len > TOAST_TUPLE_THRESHOLD)
+		return toast_insert_or_update(relation, tup, NULL, options);
+	else
+		return tup;
+}
+
+/*
+ *	heap_multi_insert	- insert multiple tuples into a heap
+ *
+ * This is like heap_insert(), but inserts multiple tuples in one operation.
+ * That's faster than calling heap_insert() in a loop, because when multiple
+ * tuples can be inserted on a single page, we can write just a single WAL
+ * record covering all of them, and only need to lock/unlock the page once.
+ *
+ * Note: this leaks memory into the current memory context.  You can create a
+ * temporary context before calling this, if that's a problem.
+ */
+void
+heap_multi_insert(Relation relation, HeapTuple *tuples, int ntuples,
+				  CommandId cid, int options, BulkInsertState bistate)
+{
+	TransactionId xid = GetCurrentTransactionId();
+	HeapTuple  *heaptuples;
+	int			i;
+	int			ndone;
+	char	   *scratch = NULL;
+	Page		page;
+	bool		needwal;
+	Size		saveFreeSpace;
+
+	needwal = !(options & HEAP_INSERT_SKIP_WAL) && !relation->rd_istemp;
+	saveFreeSpace = RelationGetTargetPageFreeSpace(relation,
+												   HEAP_DEFAULT_FILLFACTOR);
+
+	/* Toast and set header data in all the tuples */
+	heaptuples = palloc(ntuples * sizeof(HeapTuple));
+	for (i = 0; i < ntuples; i++)
+		heaptuples[i] = heap_prepare_insert(relation, tuples[i],
+											xid, cid, options);
+
+	/*
+	 * Allocate some memory to use for constructing the WAL record. Using
+	 * palloc() within a critical section is not safe, so we allocate this
+	 * beforehand.
+	 */
+	if (needwal)
+		scratch = palloc(BLCKSZ);
+
+	ndone = 0;
+	while (ndone < ntuples)
+	{
+		Buffer		buffer;
+		bool		all_visible_cleared = false;
+		int			nthispage;
+
+		/* Find buffer where at least the next tuple will fit */
+		buffer = RelationGetBufferForTuple(relation, heaptuples[ndone]->t_len,
+										   InvalidBuffer, options, bistate);
+		page = BufferGetPage(buffer);
+
+		/* NO EREPORT(ERROR) from here till changes are logged */
+		START_CRIT_SECTION();
+
+		/*
+		 * RelationGetBufferForTuple has ensured that the first tuple fits.
+		 * Put that on the page, and then as many other tuples as fit.
+		 */
+		RelationPutHeapTuple(relation, buffer, heaptuples[ndone]);
+		for (nthispage = 1; ndone + nthispage < ntuples; nthispage++)
+		{
+			HeapTuple	heaptup = heaptuples[ndone + nthispage];
+
+			if (PageGetHeapFreeSpace(page) <
+				MAXALIGN(heaptup->t_len) + saveFreeSpace)
+				break;
+
+			RelationPutHeapTuple(relation, buffer, heaptup);
+		}
+
+		if (PageIsAllVisible(page))
+		{
+			all_visible_cleared = true;
+			PageClearAllVisible(page);
+		}
+
+		/*
+		 * XXX Should we set PageSetPrunable on this page ? See heap_insert()
+		 */
+
+		MarkBufferDirty(buffer);
+
+		/* XLOG stuff */
+		if (needwal)
+		{
+			XLogRecPtr	recptr;
+			xl_heap_multi_insert *xlrec;
+			XLogRecData rdata[2];
+			uint8		info = XLOG_HEAP2_MULTI_INSERT;
+			char	   *tupledata;
+			int			totaldatalen;
+			char	   *scratchptr = scratch;
+			bool		init;
+
+			/*
+			 * If the page was previously empty, we can reinit the page
+			 * instead of restoring the whole thing.
+			 */
+			init = (ItemPointerGetOffsetNumber(&(heaptuples[ndone]->t_self)) == FirstOffsetNumber &&
+					PageGetMaxOffsetNumber(page) == FirstOffsetNumber + nthispage - 1);
+
+			/* allocate xl_heap_multi_insert struct from the scratch area */
+			xlrec = (xl_heap_multi_insert *) scratchptr;
+			scratchptr += SizeOfHeapMultiInsert;
+
+			/*
+			 * Allocate offsets array.  Unless we're reinitializing the page,
+			 * in that case the tuples are stored in order starting at
+			 * FirstOffsetNumber and we don't need to store the offsets
+			 * explicitly.
+			 */
+			if (!init)
+				scratchptr += nthispage * sizeof(OffsetNumber);
+
+			/* the rest of the scratch space is used for tuple data */
+			tupledata = scratchptr;
+
+			xlrec->all_visible_cleared = all_visible_cleared;
+			xlrec->node = relation->rd_node;
+			xlrec->blkno = BufferGetBlockNumber(buffer);
+			xlrec->ntuples = nthispage;
+
+			/*
+			 * Write out an xl_multi_insert_tuple and the tuple data itself
+			 * for each tuple.
+			 */
+			for (i = 0; i < nthispage; i++)
+			{
+				HeapTuple	heaptup = heaptuples[ndone + i];
+				xl_multi_insert_tuple *tuphdr;
+				int			datalen;
+
+				if (!init)
+					xlrec->offsets[i] = ItemPointerGetOffsetNumber(&heaptup->t_self);
+				/* xl_multi_insert_tuple needs two-byte alignment. */
+				tuphdr = (xl_multi_insert_tuple *) SHORTALIGN(scratchptr);
+				scratchptr = ((char *) tuphdr) + SizeOfMultiInsertTuple;
+
+				tuphdr->t_infomask2 = heaptup->t_data->t_infomask2;
+				tuphdr->t_infomask = heaptup->t_data->t_infomask;
+				tuphdr->t_hoff = heaptup->t_data->t_hoff;
+
+				/* PG73FORMAT: write bitmap [+ padding] [+ oid] + data */
+				datalen = heaptup->t_len - offsetof(HeapTupleHeaderData, t_bits);
+				memcpy(scratchptr,
+					   (char *) heaptup->t_data + offsetof(HeapTupleHeaderData, t_bits),
+					   datalen);
+				tuphdr->datalen = datalen;
+				scratchptr += datalen;
+			}
+			totaldatalen = scratchptr - tupledata;
+			Assert((scratchptr - scratch) < BLCKSZ);
+
+			rdata[0].data = (char *) xlrec;
+			rdata[0].len = tupledata - scratch;
+			rdata[0].buffer = InvalidBuffer;
+			rdata[0].next = &rdata[1];
+
+			/*
+			 * As in heap_insert, the tuple data is marked as belonging to the
+			 * buffer, so that it needn't be stored if XLogInsert decides to
+			 * write the whole page.
+			 */
+			rdata[1].data = tupledata;
+			rdata[1].len = totaldatalen;
+			rdata[1].buffer = buffer;
+			rdata[1].buffer_std = true;
+			rdata[1].next = NULL;
+
+			/*
+			 * If we're going to reinitialize the whole page using the WAL
+			 * record, hide buffer reference from XLogInsert.
+			 */
+			if (init)
+			{
+				rdata[1].buffer = InvalidBuffer;
+				info |= XLOG_HEAP_INIT_PAGE;
+			}
+
+			/* Logical decoding needs the tuples, as in heap_insert */
+			if (RelationIsLogicallyLogged(relation))
+				rdata[1].buffer = InvalidBuffer;
+
+			recptr = XLogInsert(RM_HEAP2_ID, info, rdata);
+
+			PageSetLSN(page, recptr);
+			PageSetTLI(page, ThisTimeLineID);
+		}
+
+		END_CRIT_SECTION();
+
+		UnlockReleaseBuffer(buffer);
+
+		/* Clear the bit in the visibility map if necessary */
+		if (all_visible_cleared)
+			visibilitymap_clear(relation,
+						ItemPointerGetBlockNumber(&(heaptuples[ndone]->t_self)));
+
+		ndone += nthispage;
+	}
+
+	/*
+	 * If tuples are cachable, mark them for invalidation from the caches in
+	 * case we abort.  Note it is OK to do this after releasing the buffer,
+	 * because the heaptuples data structure is all in local memory, not in
+	 * the shared buffer.
+	 */
+	for (i = 0; i < ntuples; i++)
+		CacheInvalidateHeapTuple(relation, heaptuples[i]);
+
+	/*
+	 * Copy t_self fields back to the caller's original tuples.  This does
+	 * nothing for untoasted tuples (tuples[i] == heaptuples[i]), but it's
+	 * probably faster to always copy than check.
+	 */
+	for (i = 0; i < ntuples; i++)
+		tuples[i]->t_self = heaptuples[i]->t_self;
+
+	pgstat_count_heap_insert(relation, ntuples);
+}
+
 /*
  *	simple_heap_insert - insert a tuple
  *
@@ -2060,9 +2371,19 @@ heap_delete(Relation relation, ItemPointer tid,
 	bool		have_tuple_lock = false;
 	bool		iscombo;
 	bool		all_visible_cleared = false;
+	Bitmapset  *key_attrs = NULL;
+	HeapTuple	old_key_tuple = NULL;
 
 	Assert(ItemPointerIsValid(tid));
 
+	/*
+	 * If the deletion is to be decoded, fetch the primary key columns now,
+	 * for the same reasons heap_update fetches its index columns before
+	 * locking the buffer.
+	 */
+	if (RelationIsLogicallyLogged(relation))
+		key_attrs = RelationGetIndexAttrBitmap(relation, true);
+
 	buffer = ReadBuffer(relation, ItemPointerGetBlockNumber(tid));
 	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 
@@ -2189,12 +2510,17 @@ l1:
 		UnlockReleaseBuffer(buffer);
 		if (have_tuple_lock)
 			UnlockTuple(relation, &(tp.t_self), ExclusiveLock);
+		bms_free(key_attrs);
 		return result;
 	}
 
 	/* replace cid with a combo cid if necessary */
 	HeapTupleHeaderAdjustCmax(tp.t_data, &cid, &iscombo);
 
+	/* Extract the old row's key for logical decoding, if needed */
+	if (RelationIsLogicallyLogged(relation))
+		old_key_tuple = ExtractKeyTuple(relation, &tp, key_attrs);
+
 	START_CRIT_SECTION();
 
 	/*
@@ -2230,8 +2556,9 @@ l1:
 	if (!relation->rd_istemp)
 	{
 		xl_heap_delete xlrec;
+		xl_heap_header xlhdr;
 		XLogRecPtr	recptr;
-		XLogRecData rdata[2];
+		XLogRecData rdata[4];
 
 		xlrec.all_visible_cleared = all_visible_cleared;
 		xlrec.target.node = relation->rd_node;
@@ -2247,6 +2574,31 @@ l1:
 		rdata[1].buffer_std = true;
 		rdata[1].next = NULL;
 
+		/*
+		 * Append the old key for logical decoding.  It is not associated
+		 * with the buffer, since redo doesn't need it.
+		 */
+		if (old_key_tuple != NULL)
+		{
+			xlhdr.t_infomask2 = old_key_tuple->t_data->t_infomask2;
+			xlhdr.t_infomask = old_key_tuple->t_data->t_infomask;
+			xlhdr.t_hoff = old_key_tuple->t_data->t_hoff;
+
+			rdata[1].next = &(rdata[2]);
+
+			rdata[2].data = (char *) &xlhdr;
+			rdata[2].len = SizeOfHeapHeader;
+			rdata[2].buffer = InvalidBuffer;
+			rdata[2].next = &(rdata[3]);
+
+			rdata[3].data = (char *) old_key_tuple->t_data +
+				offsetof(HeapTupleHeaderData, t_bits);
+			rdata[3].len = old_key_tuple->t_len -
+				offsetof(HeapTupleHeaderData, t_bits);
+			rdata[3].buffer = InvalidBuffer;
+			rdata[3].next = NULL;
+		}
+
 		recptr = XLogInsert(RM_HEAP_ID, XLOG_HEAP_DELETE, rdata);
 
 		PageSetLSN(page, recptr);
@@ -2285,6 +2637,10 @@ l1:
 	/* Now we can release the buffer */
 	ReleaseBuffer(buffer);
 
+	if (old_key_tuple != NULL)
+		heap_freetuple(old_key_tuple);
+	bms_free(key_attrs);
+
 	/*
 	 * Release the lmgr tuple lock, if we had it.
 	 */
@@ -2376,9 +2732,11 @@ heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 	HTSU_Result result;
 	TransactionId xid = GetCurrentTransactionId();
 	Bitmapset  *hot_attrs;
+	Bitmapset  *key_attrs = NULL;
 	ItemId		lp;
 	HeapTupleData oldtup;
 	HeapTuple	heaptup;
+	HeapTuple	old_key_tuple = NULL;
 	Page		page;
 	Buffer		buffer,
 				newbuf;
@@ -2406,7 +2764,9 @@ heap_update(Relation relation, ItemPointer otid, HeapTuple newtup,
 	 * Note that we get a copy here, so we need not worry about relcache flush
 	 * happening midway through.
 	 */
-	hot_attrs = RelationGetIndexAttrBitmap(relation);
+	hot_attrs = RelationGetIndexAttrBitmap(relation, false);
+	if (RelationIsLogicallyLogged(relation))
+		key_attrs = RelationGetIndexAttrBitmap(relation, true);
 
 	buffer = ReadBuffer(relation, ItemPointerGetBlockNumber(otid));
 	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
@@ -2542,6 +2902,7 @@ l2:
 		if (have_tuple_lock)
 			UnlockTuple(relation, &(oldtup.t_self), ExclusiveLock);
 		bms_free(hot_attrs);
+		bms_free(key_attrs);
 		return result;
 	}
 
@@ -2711,6 +3072,22 @@ l2:
 		PageSetFull(page);
 	}
 
+	/*
+	 * For logical decoding, log the old row's key if the update changed it.
+	 * Without a primary key the whole old row identifies it, so log that
+	 * always.  HeapSatisfiesHOTUpdate consumes its bitmap, so give it a
+	 * copy.
+	 */
+	if (RelationIsLogicallyLogged(relation))
+	{
+		Bitmapset  *check_attrs = bms_copy(key_attrs);
+
+		if (key_attrs == NULL ||
+			!HeapSatisfiesHOTUpdate(relation, check_attrs, &oldtup, heaptup))
+			old_key_tuple = ExtractKeyTuple(relation, &oldtup, key_attrs);
+		bms_free(check_attrs);
+	}
+
 	/* NO EREPORT(ERROR) from here till changes are logged */
 	START_CRIT_SECTION();
 
@@ -2783,7 +3160,7 @@ l2:
 	if (!relation->rd_istemp)
 	{
 		XLogRecPtr	recptr = log_heap_update(relation, buffer, oldtup.t_self,
-											 newbuf, heaptup,
+											 newbuf, heaptup, old_key_tuple,
 											 all_visible_cleared,
 											 all_visible_cleared_new);
 
@@ -2846,7 +3223,10 @@ l2:
 		heap_freetuple(heaptup);
 	}
 
+	if (old_key_tuple != NULL)
+		heap_freetuple(old_key_tuple);
 	bms_free(hot_attrs);
+	bms_free(key_attrs);
 
 	return HeapTupleMayBeUpdated;
 }
@@ -3965,20 +4345,65 @@ log_heap_freeze(Relation reln, Buffer buffer,
 	return recptr;
 }
 
+/*
+ * Build the tuple that identifies an updated or deleted row for logical
+ * decoding: a copy of tp in which every column that is not part of the
+ * primary key (key_attrs) is set to null.  If the relation has no primary
+ * key, key_attrs is NULL and the whole row is copied.
+ *
+ * Out-of-line TOAST values are copied as pointers; fetching them here
+ * would mean doing I/O while the caller holds a buffer lock.
+ */
+static HeapTuple
+ExtractKeyTuple(Relation relation, HeapTuple tp, Bitmapset *key_attrs)
+{
+	TupleDesc	desc = RelationGetDescr(relation);
+	Datum	   *values;
+	bool	   *nulls;
+	HeapTuple	key_tuple;
+	int			natt;
+
+	if (key_attrs == NULL)
+		return heap_copytuple(tp);
+
+	values = (Datum *) palloc(desc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(desc->natts * sizeof(bool));
+
+	heap_deform_tuple(tp, desc, values, nulls);
+
+	for (natt = 0; natt < desc->natts; natt++)
+	{
+		if (!bms_is_member(natt + 1 - FirstLowInvalidHeapAttributeNumber,
+						   key_attrs))
+			nulls[natt] = true;
+	}
+
+	key_tuple = heap_form_tuple(desc, values, nulls);
+
+	pfree(values);
+	pfree(nulls);
+
+	return key_tuple;
+}
+
 /*
  * Perform XLogInsert for a heap-update operation.	Caller must already
  * have modified the buffer(s) and marked them dirty.
+ *
+ * oldkey, if not NULL, is the old row's key as built by ExtractKeyTuple;
+ * it is logged for logical decoding only.
  */
 static XLogRecPtr
 log_heap_update(Relation reln, Buffer oldbuf, ItemPointerData from,
-				Buffer newbuf, HeapTuple newtup,
+				Buffer newbuf, HeapTuple newtup, HeapTuple oldkey,
 				bool all_visible_cleared, bool new_all_visible_cleared)
 {
 	xl_heap_update xlrec;
 	xl_heap_header xlhdr;
+	xl_heap_header xlhdr_key;
 	uint8		info;
 	XLogRecPtr	recptr;
-	XLogRecData rdata[4];
+	XLogRecData rdata[6];
 	Page		page = BufferGetPage(newbuf);
 
 	/* Caller should not call me on a temp relation */
@@ -3994,6 +4419,7 @@ log_heap_update(Relation reln, Buffer oldbuf, ItemPointerData from,
 	xlrec.all_visible_cleared = all_visible_cleared;
 	xlrec.newtid = newtup->t_self;
 	xlrec.new_all_visible_cleared = new_all_visible_cleared;
+	xlrec.old_key_len = 0;
 
 	rdata[0].data = (char *) &xlrec;
 	rdata[0].len = SizeOfHeapUpdate;
@@ -4035,6 +4461,39 @@ log_heap_update(Relation reln, Buffer oldbuf, ItemPointerData from,
 		rdata[2].buffer = rdata[3].buffer = InvalidBuffer;
 	}
 
+	/*
+	 * Logical decoding needs the new tuple even if the page is backed up,
+	 * plus the old key, if any.  heap_xlog_update relies on the new tuple
+	 * always being present when there's an old key behind it.
+	 */
+	if (RelationIsLogicallyLogged(reln))
+	{
+		rdata[2].buffer = rdata[3].buffer = InvalidBuffer;
+
+		if (oldkey != NULL)
+		{
+			xlhdr_key.t_infomask2 = oldkey->t_data->t_infomask2;
+			xlhdr_key.t_infomask = oldkey->t_data->t_infomask;
+			xlhdr_key.t_hoff = oldkey->t_data->t_hoff;
+
+			rdata[3].next = &(rdata[4]);
+
+			rdata[4].data = (char *) &xlhdr_key;
+			rdata[4].len = SizeOfHeapHeader;
+			rdata[4].buffer = InvalidBuffer;
+			rdata[4].next = &(rdata[5]);
+
+			rdata[5].data = (char *) oldkey->t_data +
+				offsetof(HeapTupleHeaderData, t_bits);
+			rdata[5].len = oldkey->t_len -
+				offsetof(HeapTupleHeaderData, t_bits);
+			rdata[5].buffer = InvalidBuffer;
+			rdata[5].next = NULL;
+
+			xlrec.old_key_len = rdata[4].len + rdata[5].len;
+		}
+	}
+
 	recptr = XLogInsert(RM_HEAP_ID, info, rdata);
 
 	return recptr;
@@ -4466,6 +4925,147 @@ heap_xlog_insert(XLogRecPtr lsn, XLogRecord *record)
 		XLogRecordPageWithFreeSpace(xlrec->target.node, blkno, freespace);
 }
 
+/*
+ * Handles MULTI_INSERT record type.
+ */
+static void
+heap_xlog_multi_insert(XLogRecPtr lsn, XLogRecord *record)
+{
+	char	   *recdata = XLogRecGetData(record);
+	xl_heap_multi_insert *xlrec;
+	Buffer		buffer;
+	Page		page;
+	struct
+	{
+		HeapTupleHeaderData hdr;
+		char		data[MaxHeapTupleSize];
+	}			tbuf;
+	HeapTupleHeader htup;
+	uint32		newlen;
+	Size		freespace;
+	BlockNumber blkno;
+	int			i;
+	bool		isinit = (record->xl_info & XLOG_HEAP_INIT_PAGE) != 0;
+
+	xlrec = (xl_heap_multi_insert *) recdata;
+	recdata += SizeOfHeapMultiInsert;
+
+	/*
+	 * If we're reinitializing the page, the tuples are stored in order from
+	 * FirstOffsetNumber. Otherwise there's an array of offsets in the WAL
+	 * record.
+	 */
+	if (!isinit)
+		recdata += sizeof(OffsetNumber) * xlrec->ntuples;
+
+	blkno = xlrec->blkno;
+
+	/*
+	 * The visibility map may need to be fixed even if the heap page is
+	 * already up-to-date.
+	 */
+	if (xlrec->all_visible_cleared)
+	{
+		Relation	reln = CreateFakeRelcacheEntry(xlrec->node);
+
+		visibilitymap_clear(reln, blkno);
+		FreeFakeRelcacheEntry(reln);
+	}
+
+	/*
+	 * Insertion doesn't overwrite MVCC data, so no conflict processing is
+	 * required.
+	 */
+	RestoreBkpBlocks(lsn, record, false);
+
+	if (record->xl_info & XLR_BKP_BLOCK_1)
+		return;
+
+	if (isinit)
+	{
+		buffer = XLogReadBuffer(xlrec->node, blkno, true);
+		Assert(BufferIsValid(buffer));
+		page = (Page) BufferGetPage(buffer);
+
+		PageInit(page, BufferGetPageSize(buffer), 0);
+	}
+	else
+	{
+		buffer = XLogReadBuffer(xlrec->node, blkno, false);
+		if (!BufferIsValid(buffer))
+			return;
+		page = (Page) BufferGetPage(buffer);
+
+		if (XLByteLE(lsn, PageGetLSN(page)))	/* changes are applied */
+		{
+			UnlockReleaseBuffer(buffer);
+			return;
+		}
+	}
+
+	for (i = 0; i < xlrec->ntuples; i++)
+	{
+		OffsetNumber offnum;
+		xl_multi_insert_tuple *xlhdr;
+
+		if (isinit)
+			offnum = FirstOffsetNumber + i;
+		else
+			offnum = xlrec->offsets[i];
+		if (PageGetMaxOffsetNumber(page) + 1 < offnum)
+			elog(PANIC, "heap_multi_insert_redo: invalid max offset number");
+
+		xlhdr = (xl_multi_insert_tuple *) SHORTALIGN(recdata);
+		recdata = ((char *) xlhdr) + SizeOfMultiInsertTuple;
+
+		newlen = xlhdr->datalen;
+		Assert(newlen <= MaxHeapTupleSize);
+		htup = &tbuf.hdr;
+		MemSet((char *) htup, 0, sizeof(HeapTupleHeaderData));
+		/* PG73FORMAT: get bitmap [+ padding] [+ oid] + data */
+		memcpy((char *) htup + offsetof(HeapTupleHeaderData, t_bits),
+			   (char *) recdata,
+			   newlen);
+		recdata += newlen;
+
+		newlen += offsetof(HeapTupleHeaderData, t_bits);
+		htup->t_infomask2 = xlhdr->t_infomask2;
+		htup->t_infomask = xlhdr->t_infomask;
+		htup->t_hoff = xlhdr->t_hoff;
+		HeapTupleHeaderSetXmin(htup, record->xl_xid);
+		HeapTupleHeaderSetCmin(htup, FirstCommandId);
+		ItemPointerSetBlockNumber(&htup->t_ctid, blkno);
+		ItemPointerSetOffsetNumber(&htup->t_ctid, offnum);
+
+		offnum = PageAddItem(page, (Item) htup, newlen, offnum, true, true);
+		if (offnum == InvalidOffsetNumber)
+			elog(PANIC, "heap_multi_insert_redo: failed to add tuple");
+	}
+
+	freespace = PageGetHeapFreeSpace(page);		/* needed to update FSM below */
+
+	PageSetLSN(page, lsn);
+	PageSetTLI(page, ThisTimeLineID);
+
+	if (xlrec->all_visible_cleared)
+		PageClearAllVisible(page);
+
+	MarkBufferDirty(buffer);
+	UnlockReleaseBuffer(buffer);
+
+	/*
+	 * If the page is running low on free space, update the FSM as well.
+	 * Arbitrarily, our definition of "low" is less than 20%. We can't do much
+	 * better than that without knowing the fill-factor for the table.
+	 *
+	 * XXX: We don't get here if the page was restored from full page image.
+	 * We don't bother to update the FSM in that case, it doesn't need to be
+	 * totally accurate anyway.
+	 */
+	if (freespace < BLCKSZ / 5)
+		XLogRecordPageWithFreeSpace(xlrec->node, blkno, freespace);
+}
+
 /*
  * Handles UPDATE and HOT_UPDATE
  */
@@ -4620,7 +5220,8 @@ newsame:;
 
 	hsize = SizeOfHeapUpdate + SizeOfHeapHeader;
 
-	newlen = record->xl_len - hsize;
+	/* the old key for logical decoding, if any, is at the very end */
+	newlen = record->xl_len - hsize - xlrec->old_key_len;
 	Assert(newlen <= MaxHeapTupleSize);
 	memcpy((char *) &xlhdr,
 		   (char *) xlrec + SizeOfHeapUpdate,
@@ -4845,6 +5446,9 @@ heap2_redo(XLogRecPtr lsn, XLogRecord *record)
 		case XLOG_HEAP2_CLEANUP_INFO:
 			heap_xlog_cleanup_info(lsn, record);
 			break;
+		case XLOG_HEAP2_MULTI_INSERT:
+			heap_xlog_multi_insert(lsn, record);
+			break;
 		default:
 			elog(PANIC, "heap2_redo: unknown op code %u", info);
 	}
@@ -4894,6 +5498,8 @@ heap_desc(StringInfo buf, uint8 xl_info, char *rec)
 		appendStringInfo(buf, "; new %u/%u",
 						 ItemPointerGetBlockNumber(&(xlrec->newtid)),
 						 ItemPointerGetOffsetNumber(&(xlrec->newtid)));
+		if (xlrec->old_key_len > 0)
+			appendStringInfo(buf, "; old key %u bytes", xlrec->old_key_len);
 	}
 	else if (info == XLOG_HEAP_HOT_UPDATE)
 	{
@@ -4907,6 +5513,8 @@ heap_desc(StringInfo buf, uint8 xl_info, char *rec)
 		appendStringInfo(buf, "; new %u/%u",
 						 ItemPointerGetBlockNumber(&(xlrec->newtid)),
 						 ItemPointerGetOffsetNumber(&(xlrec->newtid)));
+		if (xlrec->old_key_len > 0)
+			appendStringInfo(buf, "; old key %u bytes", xlrec->old_key_len);
 	}
 	else if (info == XLOG_HEAP_NEWPAGE)
 	{
@@ -4974,10 +5582,128 @@ heap2_desc(StringInfo buf, uint8 xl_info, char *rec)
 		appendStringInfo(buf, "cleanup info: remxid %u",
 						 xlrec->latestRemovedXid);
 	}
+	else if (info == XLOG_HEAP2_MULTI_INSERT)
+	{
+		xl_heap_multi_insert *xlrec = (xl_heap_multi_insert *) rec;
+
+		if (xl_info & XLOG_HEAP_INIT_PAGE)
+			appendStringInfo(buf, "multi-insert (init): ");
+		else
+			appendStringInfo(buf, "multi-insert: ");
+		appendStringInfo(buf, "rel %u/%u/%u; blk %u; %d tuples",
+				xlrec->node.spcNode, xlrec->node.dbNode, xlrec->node.relNode,
+						 xlrec->blkno, xlrec->ntuples);
+	}
 	else
 		appendStringInfo(buf, "UNKNOWN");
 }
 
+/*
+ * Report the heap pages that redo of a heap record will modify.  The
+ * mapping to backup blocks must match the heap_xlog_* routines above.
+ * Apart from the free space map and the visibility map, these records
+ * change nothing else, except that pruning and freezing must wait for
+ * conflicting hot standby queries.
+ */
+bool
+heap_blockrefs(XLogRecord *record, XLogBlockRefCallback callback, void *arg)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *rec = XLogRecGetData(record);
+	xl_heaptid *target = (xl_heaptid *) rec;
+	BlockNumber blkno;
+
+	if (record->xl_len < SizeOfHeapTid)
+		return false;
+	blkno = ItemPointerGetBlockNumber(&target->tid);
+
+	switch (info & XLOG_HEAP_OPMASK)
+	{
+		case XLOG_HEAP_INSERT:
+			callback(target->node, MAIN_FORKNUM, blkno,
+					 !(record->xl_info & XLR_BKP_BLOCK_1) &&
+					 !(record->xl_info & XLOG_HEAP_INIT_PAGE), arg);
+			return true;
+		case XLOG_HEAP_DELETE:
+		case XLOG_HEAP_LOCK:
+		case XLOG_HEAP_INPLACE:
+			callback(target->node, MAIN_FORKNUM, blkno,
+					 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+			return true;
+		case XLOG_HEAP_UPDATE:
+		case XLOG_HEAP_HOT_UPDATE:
+			{
+				xl_heap_update *xlrec = (xl_heap_update *) rec;
+				BlockNumber newblk;
+
+				callback(target->node, MAIN_FORKNUM, blkno,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+				if (record->xl_len < SizeOfHeapUpdate)
+					return false;
+				newblk = ItemPointerGetBlockNumber(&xlrec->newtid);
+				if (newblk != blkno)
+					callback(target->node, MAIN_FORKNUM, newblk,
+							 !(record->xl_info & XLR_BKP_BLOCK_2) &&
+							 !(record->xl_info & XLOG_HEAP_INIT_PAGE), arg);
+			}
+			return true;
+		case XLOG_HEAP_NEWPAGE:
+			{
+				xl_heap_newpage *xlrec = (xl_heap_newpage *) rec;
+
+				if (record->xl_len < SizeOfHeapNewpage)
+					return false;
+				callback(xlrec->node, xlrec->forknum, xlrec->blkno,
+						 false, arg);
+			}
+			return true;
+	}
+	return false;
+}
+
+bool
+heap2_blockrefs(XLogRecord *record, XLogBlockRefCallback callback, void *arg)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *rec = XLogRecGetData(record);
+
+	switch (info & XLOG_HEAP_OPMASK)
+	{
+		case XLOG_HEAP2_FREEZE:
+			{
+				xl_heap_freeze *xlrec = (xl_heap_freeze *) rec;
+
+				if (record->xl_len < offsetof(xl_heap_freeze, cutoff_xid))
+					return false;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->block,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+			}
+			return !InHotStandby;
+		case XLOG_HEAP2_CLEAN:
+			{
+				xl_heap_clean *xlrec = (xl_heap_clean *) rec;
+
+				if (record->xl_len < SizeOfHeapClean)
+					return false;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->block,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+			}
+			return !InHotStandby;
+		case XLOG_HEAP2_MULTI_INSERT:
+			{
+				xl_heap_multi_insert *xlrec = (xl_heap_multi_insert *) rec;
+
+				if (record->xl_len < SizeOfHeapMultiInsert)
+					return false;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->blkno,
+						 !(record->xl_info & XLR_BKP_BLOCK_1) &&
+						 !(record->xl_info & XLOG_HEAP_INIT_PAGE), arg);
+			}
+			return true;
+	}
+	return false;
+}
+
 /*
  *	heap_sync		- sync a heap, for use when no WAL has been written
  *
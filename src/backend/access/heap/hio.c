@@ -95,6 +95,83 @@ ReadBufferBI(Relation relation, BlockNumber targetBlock,
 	return buffer;
 }
 
+/*
+ * Extend a relation by multiple blocks to avoid future contention on the
+ * relation extension lock.  Our goal is to pre-extend the relation by an
+ * amount which ramps up as the degree of contention ramps up, but limiting
+ * the result to some sane overall value.
+ *
+ * The new blocks are allocated with smgrzeroextend, which can use
+ * posix_fallocate() instead of writing out zero pages one at a time.  Each
+ * page is then initialized in a zeroed buffer and recorded in the free
+ * space map, so that the backends waiting for the extension lock can find
+ * it there instead of extending the relation themselves.
+ *
+ * Caller must hold the relation extension lock.
+ */
+static void
+RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
+{
+	BlockNumber firstBlock;
+	BlockNumber blockNum;
+	int			extraBlocks;
+	int			lockWaiters;
+	Size		freespace = 0;
+
+	/* Use the length of the lock wait queue to judge how much to extend. */
+	lockWaiters = RelationExtensionLockWaiterCount(relation);
+	if (lockWaiters <= 0)
+		return;
+
+	/*
+	 * It might seem like multiplying the number of lock waiters by as much
+	 * as 20 is too aggressive, but benchmarking revealed that smaller numbers
+	 * were insufficient.  512 is just an arbitrary cap to prevent
+	 * pathological results.
+	 */
+	extraBlocks = Min(512, lockWaiters * 20);
+
+	RelationOpenSmgr(relation);
+	firstBlock = smgrnblocks(relation->rd_smgr, MAIN_FORKNUM);
+
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock, extraBlocks,
+				   relation->rd_istemp);
+
+	for (blockNum = firstBlock; blockNum < firstBlock + extraBlocks; blockNum++)
+	{
+		Buffer		buffer;
+		Page		page;
+
+		/*
+		 * The block exists on disk now, so RBM_ZERO just gives us a zeroed
+		 * buffer for it without reading it in.
+		 */
+		buffer = ReadBufferExtended(relation, MAIN_FORKNUM, blockNum,
+									RBM_ZERO,
+									bistate ? bistate->strategy : NULL);
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buffer);
+
+		/*
+		 * The page is not WAL-logged; if we crash before it's written out,
+		 * it comes back all-zeroes.  RelationGetBufferForTuple initializes
+		 * such a page when the FSM hands it out, and VACUUM fixes it up if
+		 * it gets there first.
+		 */
+		PageInit(page, BufferGetPageSize(buffer), 0);
+		MarkBufferDirty(buffer);
+		freespace = PageGetHeapFreeSpace(page);
+		UnlockReleaseBuffer(buffer);
+	}
+
+	/*
+	 * Record all the new pages in the FSM at once, updating the upper levels
+	 * too so that the waiters will find them.
+	 */
+	RecordNewPagesWithFreeSpace(relation, firstBlock,
+								firstBlock + extraBlocks, freespace);
+}
+
 /*
  * RelationGetBufferForTuple
  *
@@ -209,6 +286,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	else
 		targetBlock = RelationGetTargetBlock(relation);
 
+loop:
 	if (targetBlock == InvalidBlockNumber && use_fsm)
 	{
 		/*
@@ -265,11 +343,23 @@ RelationGetBufferForTuple(Relation relation, Size len,
 			LockBuffer(otherBuffer, BUFFER_LOCK_EXCLUSIVE);
 		}
 
+		/*
+		 * A page added by RelationAddExtraBlocks can be all-zeroes if we
+		 * crashed before it was written out.  Initialize it now, since it's
+		 * about to be used; otherwise it would look full and be skipped
+		 * until VACUUM got around to it.
+		 */
+		page = BufferGetPage(buffer);
+		if (PageIsNew(page))
+		{
+			PageInit(page, BufferGetPageSize(buffer), 0);
+			MarkBufferDirty(buffer);
+		}
+
 		/*
 		 * Now we can check to see if there's enough free space here. If so,
 		 * we're done.
 		 */
-		page = BufferGetPage(buffer);
 		pageFreeSpace = PageGetHeapFreeSpace(page);
 		if (len + saveFreeSpace <= pageFreeSpace)
 		{
@@ -314,11 +404,44 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	 * same time, else we will both try to initialize the same new page.  We
 	 * can skip locking for new or temp relations, however, since no one else
 	 * could be accessing them.
+	 *
+	 * If we have to wait for the lock, somebody else was extending the rel,
+	 * and may have added more pages than they needed to the FSM (see
+	 * RelationAddExtraBlocks), so look there again once we have the lock.
+	 * If there's still nothing, extend by several pages at once on behalf of
+	 * the other backends that are waiting, too.
 	 */
 	needLock = !RELATION_IS_LOCAL(relation);
 
 	if (needLock)
-		LockRelationForExtension(relation, ExclusiveLock);
+	{
+		if (!use_fsm)
+			LockRelationForExtension(relation, ExclusiveLock);
+		else if (!ConditionalLockRelationForExtension(relation, ExclusiveLock))
+		{
+			/* Couldn't get the lock immediately; wait for it. */
+			LockRelationForExtension(relation, ExclusiveLock);
+
+			/*
+			 * Check if some other backend has extended a block for us while
+			 * we were waiting on the lock.
+			 */
+			targetBlock = GetPageWithFreeSpace(relation, len + saveFreeSpace);
+
+			/*
+			 * If some other waiter has already extended the relation, we
+			 * don't need to do so; just use the existing freespace.
+			 */
+			if (targetBlock != InvalidBlockNumber)
+			{
+				UnlockRelationForExtension(relation, ExclusiveLock);
+				goto loop;
+			}
+
+			/* Time to bulk-extend. */
+			RelationAddExtraBlocks(relation, bistate);
+		}
+	}
 
 	/*
 	 * XXX This does an lseek - rather expensive - but at the moment it is the
@@ -377,6 +500,8 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	 * (until VACUUM sees it)?	Seems to depend on whether you expect the
 	 * current backend to make more insertions or not, which is probably a
 	 * good bet most of the time.  So for now, don't add it to FSM yet.
+	 * (The extra pages added by RelationAddExtraBlocks are a different
+	 * matter: they're meant for other backends, so they do go into the FSM.)
 	 */
 	RelationSetTargetBlock(relation, BufferGetBlockNumber(buffer));
 
@@ -115,6 +115,9 @@ RelationGetIndexScan(Relation indexRelation,
 	scan->xs_next_hot = InvalidOffsetNumber;
 	scan->xs_prev_xmax = InvalidTransactionId;
 
+	scan->xs_stream_next = NULL;	/* may be set by the AM */
+	scan->xs_stream = NULL;		/* set by index_beginscan */
+
 	/*
 	 * Let the AM fill in the key and any opaque data it wants.
 	 */
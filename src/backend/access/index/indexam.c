@@ -226,6 +226,12 @@ index_beginscan(Relation heapRelation,
 	scan->heapRelation = heapRelation;
 	scan->xs_snapshot = snapshot;
 
+	/* Read the heap ahead, if the AM can tell us which blocks to read */
+	if (scan->xs_stream_next != NULL)
+		scan->xs_stream = ReadStreamBegin(heapRelation, MAIN_FORKNUM, NULL,
+										  scan->xs_stream_next,
+										  (void *) scan);
+
 	return scan;
 }
 
@@ -310,6 +316,10 @@ index_rescan(IndexScanDesc scan, ScanKey key)
 		scan->xs_cbuf = InvalidBuffer;
 	}
 
+	/* Forget the heap blocks read ahead for the old scan position */
+	if (scan->xs_stream != NULL)
+		ReadStreamReset(scan->xs_stream);
+
 	scan->xs_next_hot = InvalidOffsetNumber;
 
 	scan->kill_prior_tuple = false;		/* for safety */
@@ -338,6 +348,13 @@ index_endscan(IndexScanDesc scan)
 		scan->xs_cbuf = InvalidBuffer;
 	}
 
+	/* Release the read-ahead stream, and any pins it holds */
+	if (scan->xs_stream != NULL)
+	{
+		ReadStreamEnd(scan->xs_stream);
+		scan->xs_stream = NULL;
+	}
+
 	/* End the AM's scan */
 	FunctionCall1(procedure, PointerGetDatum(scan));
 
@@ -393,6 +410,10 @@ index_restrpos(IndexScanDesc scan)
 
 	scan->kill_prior_tuple = false;		/* for safety */
 
+	/* The blocks read ahead are for the position we're leaving */
+	if (scan->xs_stream != NULL)
+		ReadStreamReset(scan->xs_stream);
+
 	FunctionCall1(procedure, PointerGetDatum(scan));
 }
 
@@ -481,10 +502,27 @@ index_getnext(IndexScanDesc scan, ScanDirection direction)
 
 			pgstat_count_index_tuples(scan->indexRelation, 1);
 
-			/* Switch to correct buffer if we don't have it already */
+			/*
+			 * Switch to correct buffer if we don't have it already.  The AM's
+			 * stream callback predicts the blocks of a forward scan only.
+			 */
 			prev_buf = scan->xs_cbuf;
-			scan->xs_cbuf = ReleaseAndReadBuffer(scan->xs_cbuf,
-												 scan->heapRelation,
+			if (scan->xs_stream != NULL && ScanDirectionIsForward(direction))
+			{
+				BlockNumber blkno = ItemPointerGetBlockNumber(tid);
+
+				if (!BufferIsValid(prev_buf) ||
+					BufferGetBlockNumber(prev_buf) != blkno)
+				{
+					if (BufferIsValid(prev_buf))
+						ReleaseBuffer(prev_buf);
+					scan->xs_cbuf = ReadStreamReadBuffer(scan->xs_stream,
+														 blkno);
+				}
+			}
+			else
+				scan->xs_cbuf = ReleaseAndReadBuffer(scan->xs_cbuf,
+													 scan->heapRelation,
 											 ItemPointerGetBlockNumber(tid));
 
 			/*
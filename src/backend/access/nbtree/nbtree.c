@@ -75,6 +75,8 @@ static void btvacuumscan(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
 			 BTCycleId cycleid);
 static void btvacuumpage(BTVacState *vstate, BlockNumber blkno,
 			 BlockNumber orig_blkno);
+static BlockNumber btstreamnext(void *callback_private, BlockNumber prevBlock,
+			 bool restart);
 
 
 /*
@@ -344,9 +346,49 @@ btbeginscan(PG_FUNCTION_ARGS)
 	/* get the scan */
 	scan = RelationGetIndexScan(rel, keysz, scankey);
 
+	/* we can tell index_getnext which heap blocks are coming up */
+	scan->xs_stream_next = btstreamnext;
+
 	PG_RETURN_POINTER(scan);
 }
 
+/*
+ *	btstreamnext() -- read stream callback for the heap of a btree scan
+ *
+ * The heap TIDs of all the matching items on the current leaf page are
+ * already in so->currPos, so we can hand out their heap blocks ahead of
+ * time.  Consecutive items pointing to the same heap block need just one
+ * read, so we skip them like index_getnext does.  We don't look beyond the
+ * current leaf page; when the scan steps to the next one, its first heap
+ * fetch doesn't match any prediction and the stream restarts from there.
+ * Only forward scans use the stream, so we needn't care about direction.
+ */
+static BlockNumber
+btstreamnext(void *callback_private, BlockNumber prevBlock, bool restart)
+{
+	IndexScanDesc scan = (IndexScanDesc) callback_private;
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+
+	if (!BTScanPosIsValid(so->currPos))
+		return InvalidBlockNumber;
+
+	/* the caller is fetching the heap tuple of the current item */
+	if (restart)
+		so->streamItemIndex = so->currPos.itemIndex;
+
+	while (so->streamItemIndex >= so->currPos.firstItem &&
+		   so->streamItemIndex <= so->currPos.lastItem)
+	{
+		BTScanPosItem *item = &so->currPos.items[so->streamItemIndex++];
+		BlockNumber blkno = ItemPointerGetBlockNumber(&item->heapTid);
+
+		if (blkno != prevBlock)
+			return blkno;
+	}
+
+	return InvalidBlockNumber;
+}
+
 /*
  *	btrescan() -- rescan an index relation
  */
@@ -369,6 +411,7 @@ btrescan(PG_FUNCTION_ARGS)
 			so->keyData = NULL;
 		so->killedItems = NULL; /* until needed */
 		so->numKilled = 0;
+		so->streamItemIndex = 0;
 		scan->opaque = so;
 	}
 
@@ -1190,6 +1190,116 @@ btree_desc(StringInfo buf, uint8 xl_info, char *rec)
 	}
 }
 
+/*
+ * Report the index pages that redo of a btree record will modify.  The
+ * mapping to backup blocks must match the btree_xlog_* routines above.
+ * Pages that redo rebuilds from scratch (the new right half of a split,
+ * a new root, a deleted page, the metapage) are reported as not needing a
+ * read.
+ *
+ * Only leaf insertions, and outside hot standby deletions and vacuuming of
+ * a leaf page, change nothing but the reported page.  Everything else
+ * touches several pages, keeps track of incomplete splits, or must wait
+ * for conflicting hot standby queries.
+ */
+bool
+btree_blockrefs(XLogRecord *record, XLogBlockRefCallback callback, void *arg)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *rec = XLogRecGetData(record);
+
+	switch (info)
+	{
+		case XLOG_BTREE_INSERT_LEAF:
+		case XLOG_BTREE_INSERT_UPPER:
+		case XLOG_BTREE_INSERT_META:
+			{
+				xl_btree_insert *xlrec = (xl_btree_insert *) rec;
+
+				if (record->xl_len < SizeOfBtreeInsert)
+					break;
+				callback(xlrec->target.node, MAIN_FORKNUM,
+						 ItemPointerGetBlockNumber(&(xlrec->target.tid)),
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+				if (info == XLOG_BTREE_INSERT_META)
+					callback(xlrec->target.node, MAIN_FORKNUM,
+							 BTREE_METAPAGE, false, arg);
+			}
+			return (info == XLOG_BTREE_INSERT_LEAF);
+		case XLOG_BTREE_SPLIT_L:
+		case XLOG_BTREE_SPLIT_R:
+		case XLOG_BTREE_SPLIT_L_ROOT:
+		case XLOG_BTREE_SPLIT_R_ROOT:
+			{
+				xl_btree_split *xlrec = (xl_btree_split *) rec;
+
+				if (record->xl_len < SizeOfBtreeSplit)
+					break;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->leftsib,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->rightsib,
+						 false, arg);
+				if (xlrec->rnext != P_NONE)
+					callback(xlrec->node, MAIN_FORKNUM, xlrec->rnext,
+							 !(record->xl_info & XLR_BKP_BLOCK_2), arg);
+			}
+			break;
+		case XLOG_BTREE_DELETE:
+			{
+				xl_btree_delete *xlrec = (xl_btree_delete *) rec;
+
+				if (record->xl_len < SizeOfBtreeDelete)
+					break;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->block,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+			}
+			return !InHotStandby;
+		case XLOG_BTREE_VACUUM:
+			{
+				xl_btree_vacuum *xlrec = (xl_btree_vacuum *) rec;
+
+				if (record->xl_len < SizeOfBtreeVacuum)
+					break;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->block,
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+			}
+			return !InHotStandby;
+		case XLOG_BTREE_DELETE_PAGE:
+		case XLOG_BTREE_DELETE_PAGE_META:
+		case XLOG_BTREE_DELETE_PAGE_HALF:
+			{
+				xl_btree_delete_page *xlrec = (xl_btree_delete_page *) rec;
+				RelFileNode node = xlrec->target.node;
+
+				if (record->xl_len < SizeOfBtreeDeletePage)
+					break;
+				callback(node, MAIN_FORKNUM,
+						 ItemPointerGetBlockNumber(&(xlrec->target.tid)),
+						 !(record->xl_info & XLR_BKP_BLOCK_1), arg);
+				callback(node, MAIN_FORKNUM, xlrec->rightblk,
+						 !(record->xl_info & XLR_BKP_BLOCK_2), arg);
+				if (xlrec->leftblk != P_NONE)
+					callback(node, MAIN_FORKNUM, xlrec->leftblk,
+							 !(record->xl_info & XLR_BKP_BLOCK_3), arg);
+				callback(node, MAIN_FORKNUM, xlrec->deadblk, false, arg);
+				if (info == XLOG_BTREE_DELETE_PAGE_META)
+					callback(node, MAIN_FORKNUM, BTREE_METAPAGE, false, arg);
+			}
+			break;
+		case XLOG_BTREE_NEWROOT:
+			{
+				xl_btree_newroot *xlrec = (xl_btree_newroot *) rec;
+
+				if (record->xl_len < SizeOfBtreeNewroot)
+					break;
+				callback(xlrec->node, MAIN_FORKNUM, xlrec->rootblk, false, arg);
+				callback(xlrec->node, MAIN_FORKNUM, BTREE_METAPAGE, false, arg);
+			}
+			break;
+	}
+	return false;
+}
+
 void
 btree_xlog_startup(void)
 {
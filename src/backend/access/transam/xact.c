@@ -36,6 +36,8 @@
 #include "libpq/be-fsstubs.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/copyworker.h"
+#include "replication/syncrep.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
 #include "storage/fd.h"
@@ -63,7 +65,7 @@ int			XactIsoLevel;
 bool		DefaultXactReadOnly = false;
 bool		XactReadOnly;
 
-bool		XactSyncCommit = true;
+int			synchronous_commit = SYNCHRONOUS_COMMIT_ON;
 
 int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
@@ -1048,7 +1050,8 @@ RecordTransactionCommit(void)
 	 * asynchronous commit if all to-be-deleted tables are temporary though,
 	 * since they are lost anyway if we crash.)
 	 */
-	if (XactSyncCommit || forceSyncCommit || nrels > 0)
+	if (synchronous_commit > SYNCHRONOUS_COMMIT_OFF ||
+		forceSyncCommit || nrels > 0)
 	{
 		/*
 		 * Synchronous commit case:
@@ -1115,6 +1118,15 @@ RecordTransactionCommit(void)
 		END_CRIT_SECTION();
 	}
 
+	/*
+	 * Wait for synchronous replication, if required.  This must happen after
+	 * the commit record is flushed locally but before the transaction is
+	 * marked as no longer running in the procarray, so that other sessions
+	 * cannot see its effects until the standby has confirmed it.
+	 */
+	if (markXidCommitted)
+		SyncRepWaitForLSN(XactLastRecEnd);
+
 	/* Compute latestXid while we have the child XIDs handy */
 	latestXid = TransactionIdLatest(xid, nchildren, children);
 
@@ -2215,6 +2227,7 @@ AbortTransaction(void)
 	AfterTriggerEndXact(false); /* 'false' means it's abort */
 	AtAbort_Portals();
 	AtEOXact_LargeObject(false);
+	AtAbort_CopyWorkers();
 	AtAbort_Notify();
 	AtEOXact_RelationMap(false);
 
@@ -3946,6 +3959,8 @@ CommitSubTransaction(void)
 						s->parent->curTransactionOwner);
 	AtEOSubXact_LargeObject(true, s->subTransactionId,
 							s->parent->subTransactionId);
+	AtEOSubXact_CopyWorkers(true, s->subTransactionId,
+							s->parent->subTransactionId);
 	AtSubCommit_Notify();
 
 	CallSubXactCallbacks(SUBXACT_EVENT_COMMIT_SUB, s->subTransactionId,
@@ -4065,6 +4080,8 @@ AbortSubTransaction(void)
 						   s->parent->curTransactionOwner);
 		AtEOSubXact_LargeObject(false, s->subTransactionId,
 								s->parent->subTransactionId);
+		AtEOSubXact_CopyWorkers(false, s->subTransactionId,
+								s->parent->subTransactionId);
 		AtSubAbort_Notify();
 
 		/* Advertise the fact that we aborted in pg_clog. */
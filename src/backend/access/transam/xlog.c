@@ -31,6 +31,7 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
 #include "catalog/pg_control.h"
@@ -41,6 +42,9 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/fork_process.h"
+#include "postmaster/redoworker.h"
+#include "replication/slot.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
@@ -53,13 +57,13 @@
 #include "storage/spin.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
+#include "utils/pg_lzcompress.h"
 #include "utils/ps_status.h"
 #include "utils/relmapper.h"
 #include "pg_trace.h"
 
 
 /* File path names (all relative to $PGDATA) */
-#define BACKUP_LABEL_FILE		"backup_label"
 #define BACKUP_LABEL_OLD		"backup_label.old"
 #define RECOVERY_COMMAND_FILE	"recovery.conf"
 #define RECOVERY_COMMAND_DONE	"recovery.done"
@@ -74,6 +78,7 @@ bool		XLogArchiveMode = false;
 char	   *XLogArchiveCommand = NULL;
 bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
+bool		fullPageCompression = false;
 bool		log_checkpoints = false;
 int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_MINIMAL;
@@ -102,6 +107,7 @@ const struct config_enum_entry wal_level_options[] = {
 	{"minimal", WAL_LEVEL_MINIMAL, false},
 	{"archive", WAL_LEVEL_ARCHIVE, false},
 	{"hot_standby", WAL_LEVEL_HOT_STANDBY, false},
+	{"logical", WAL_LEVEL_LOGICAL, false},
 	{NULL, 0, false}
 };
 
@@ -159,6 +165,12 @@ static XLogRecPtr LastRec;
  */
 static bool LocalRecoveryInProgress = true;
 
+/*
+ * Local copy of SharedHotStandbyActive variable. False actually means "not
+ * known, need to check the shared state".
+ */
+static bool LocalHotStandbyActive = false;
+
 /*
  * Local state for XLogInsertAllowed():
  *		1: unconditionally allowed to insert XLOG
@@ -181,6 +193,7 @@ static bool restoredFromArchive = false;
 static char *recoveryRestoreCommand = NULL;
 static char *recoveryEndCommand = NULL;
 static char *archiveCleanupCommand = NULL;
+static int	restorePrefetchSegments = 0;
 static RecoveryTargetType recoveryTarget = RECOVERY_TARGET_UNSET;
 static bool recoveryTargetInclusive = true;
 static TransactionId recoveryTargetXid;
@@ -189,6 +202,7 @@ static TimestampTz recoveryTargetTime;
 /* options taken from recovery.conf for XLOG streaming */
 static bool StandbyMode = false;
 static char *PrimaryConnInfo = NULL;
+static char *PrimarySlotName = NULL;
 static char *TriggerFile = NULL;
 
 /* if recoveryStopsHere returns true, it saves actual stop xid/time here */
@@ -309,7 +323,7 @@ static XLogRecPtr RedoStartLSN = {0, 0};
  *
  * CheckpointLock: must be held to do a checkpoint or restartpoint (ensures
  * only one checkpointer at a time; currently, with all checkpoints done by
- * the bgwriter, this is just pro forma).
+ * the checkpointer, this is just pro forma).
  *
  *----------
  */
@@ -338,6 +352,11 @@ typedef struct XLogCtlInsert
 	char	   *currpos;		/* current insertion point in cache */
 	XLogRecPtr	RedoRecPtr;		/* current redo point for insertions */
 	bool		forcePageWrites;	/* forcing full-page writes for PITR? */
+
+	/* statistics about backup blocks, reported by checkpoints */
+	uint64		fpiWritten;		/* # of backup blocks inserted */
+	uint64		fpiBytes;		/* bytes of backup block data inserted */
+	uint64		fpiRawBytes;	/* same, before compression */
 } XLogCtlInsert;
 
 /*
@@ -383,7 +402,7 @@ typedef struct XLogCtlData
 
 	/*
 	 * archiveCleanupCommand is read from recovery.conf but needs to be in
-	 * shared memory so that the bgwriter process can access it.
+	 * shared memory so that the checkpointer process can access it.
 	 */
 	char		archiveCleanupCommand[MAXPGPATH];
 
@@ -393,6 +412,12 @@ typedef struct XLogCtlData
 	 */
 	bool		SharedRecoveryInProgress;
 
+	/*
+	 * SharedHotStandbyActive indicates if we're allowing queries during
+	 * recovery yet.  Protected by info_lck.
+	 */
+	bool		SharedHotStandbyActive;
+
 	/*
 	 * recoveryWakeupLatch is used to wake up the startup process to
 	 * continue WAL replay, if it is waiting for WAL to arrive or failover
@@ -416,6 +441,12 @@ typedef struct XLogCtlData
 	/* timestamp of last COMMIT/ABORT record replayed (or being replayed) */
 	TimestampTz recoveryLastXTime;
 
+	/*
+	 * Oldest WAL location any replication slot still needs, or 0/0 if
+	 * none.  Protected by info_lck.
+	 */
+	XLogRecPtr	replicationSlotMinLSN;
+
 	slock_t		info_lck;		/* locks shared variables shown above */
 } XLogCtlData;
 
@@ -491,6 +522,16 @@ static uint32 readOff = 0;
 static uint32 readLen = 0;
 static int	readSource = 0;		/* XLOG_FROM_* code */
 
+/*
+ * File used by XLogPrefetchReadPage to look at WAL ahead of the replay
+ * position.  It's separate from readFile so as not to disturb ReadRecord.
+ */
+static int	readAheadFile = -1;
+static uint32 readAheadId = 0;
+static uint32 readAheadSeg = 0;
+static TimeLineID readAheadTLI = 0;
+static int	readAheadSource = 0;
+
 /*
  * Keeps track of which sources we've tried to read the current WAL
  * record from and failed.
@@ -513,6 +554,22 @@ static char *readBuf = NULL;
 static char *readRecordBuf = NULL;
 static uint32 readRecordBufSize = 0;
 
+/*
+ * Buffers for compressing and decompressing backup blocks.  The compressed
+ * images built by XLogInsert must survive until the record has been copied
+ * into the WAL buffers, so there's one for each backup block of a record.
+ * pglz wants its input in one piece and its compressed data aligned, so
+ * the page minus its hole is gathered in holelessPage.
+ */
+typedef union
+{
+	PGLZ_Header hdr;
+	char		data[PGLZ_MAX_OUTPUT(BLCKSZ)];
+} CompressedPage;
+
+static CompressedPage compressedPages[XLR_MAX_BKP_BLOCKS];
+static char holelessPage[BLCKSZ];
+
 /* State information for XLOG reading */
 static XLogRecPtr ReadRecPtr;	/* start of last record read */
 static XLogRecPtr EndRecPtr;	/* end+1 of last record read */
@@ -525,7 +582,7 @@ static bool reachedMinRecoveryPoint = false;
 
 static bool InRedo = false;
 
-/* Have we launched bgwriter during recovery? */
+/* Have we launched bgwriter and checkpointer during recovery? */
 static bool bgwriterLaunched = false;
 
 /*
@@ -571,6 +628,7 @@ static void CheckPointGuts(XLogRecPtr checkPointRedo, int flags);
 
 static bool XLogCheckBuffer(XLogRecData *rdata, bool doPageWrites,
 				XLogRecPtr *lsn, BkpBlock *bkpb);
+static char *XLogCompressBackupBlock(BkpBlock *bkpb, char *page, int slot);
 static bool AdvanceXLInsertBuffer(bool new_segment);
 static bool XLogCheckpointNeeded(uint32 logid, uint32 logseg);
 static void XLogWrite(XLogwrtRqst WriteRqst, bool flexible, bool xlog_switch);
@@ -587,10 +645,20 @@ static int	emode_for_corrupt_record(int emode, XLogRecPtr RecPtr);
 static void XLogFileClose(void);
 static bool RestoreArchivedFile(char *path, const char *xlogfname,
 					const char *recovername, off_t expectedSize);
+static void BuildRestoreCommand(char *xlogRestoreCmd, const char *xlogpath,
+					const char *xlogfname, const char *lastRestartPointFname);
+#ifndef WIN32
+static bool RestorePrefetchedFile(const char *xlogfname, const char *xlogpath);
+static void RestorePrefetchStart(const char *xlogfname,
+					 const char *lastRestartPointFname);
+static void RestorePrefetchDiscard(int slot);
+#endif
+static void RestorePrefetchCleanup(void);
 static void ExecuteRecoveryCommand(char *command, char *commandName,
 					   bool failOnerror);
 static void PreallocXlogFiles(XLogRecPtr endptr);
 static void RemoveOldXlogFiles(uint32 log, uint32 seg, XLogRecPtr endptr);
+static void KeepLogSeg(XLogRecPtr recptr, uint32 *logId, uint32 *logSeg);
 static void UpdateLastRemovedPtr(char *filename);
 static void ValidateXLOGDirectoryStructure(void);
 static void CleanupBackupHistory(void);
@@ -771,7 +839,9 @@ begin:;
 	}
 
 	/*
-	 * Now add the backup block headers and data into the CRC
+	 * Now add the backup block headers and data into the CRC, compressing
+	 * the blocks first if requested.  Like the CRC calculation, compression
+	 * is done before taking the insert lock.
 	 */
 	for (i = 0; i < XLR_MAX_BKP_BLOCKS; i++)
 	{
@@ -779,12 +849,24 @@ begin:;
 		{
 			BkpBlock   *bkpb = &(dtbuf_xlg[i]);
 			char	   *page;
+			char	   *cdata = NULL;
+
+			page = (char *) BufferGetBlock(dtbuf[i]);
+			bkpb->compress_method = BKPBLOCK_COMPRESS_NONE;
+			bkpb->compress_length = 0;
+			if (fullPageCompression)
+				cdata = XLogCompressBackupBlock(bkpb, page, i);
 
 			COMP_CRC32(rdata_crc,
 					   (char *) bkpb,
 					   sizeof(BkpBlock));
-			page = (char *) BufferGetBlock(dtbuf[i]);
-			if (bkpb->hole_length == 0)
+			if (cdata != NULL)
+			{
+				COMP_CRC32(rdata_crc,
+						   cdata,
+						   bkpb->compress_length);
+			}
+			else if (bkpb->hole_length == 0)
 			{
 				COMP_CRC32(rdata_crc,
 						   page,
@@ -901,7 +983,19 @@ begin:;
 		rdt->next = &(dtbuf_rdt2[i]);
 		rdt = rdt->next;
 
-		if (bkpb->hole_length == 0)
+		Insert->fpiWritten++;
+		Insert->fpiBytes += BkpBlockDataLength(bkpb);
+		Insert->fpiRawBytes += BLCKSZ - bkpb->hole_length;
+
+		if (bkpb->compress_method != BKPBLOCK_COMPRESS_NONE)
+		{
+			/* compressed data is in one piece */
+			rdt->data = compressedPages[i].data + sizeof(PGLZ_Header);
+			rdt->len = bkpb->compress_length;
+			write_len += bkpb->compress_length;
+			rdt->next = NULL;
+		}
+		else if (bkpb->hole_length == 0)
 		{
 			rdt->data = page;
 			rdt->len = BLCKSZ;
@@ -1257,6 +1351,44 @@ XLogCheckBuffer(XLogRecData *rdata, bool doPageWrites,
 	return false;				/* buffer does not need to be backed up */
 }
 
+/*
+ * Try to compress the page image described by *bkpb, using the slot'th
+ * compression buffer.  On success, set the compression fields of *bkpb and
+ * return a pointer to the compressed data; if the page doesn't compress
+ * well enough to be worth it, return NULL.
+ */
+static char *
+XLogCompressBackupBlock(BkpBlock *bkpb, char *page, int slot)
+{
+	CompressedPage *dest = &compressedPages[slot];
+	char	   *source;
+	int32		rawlen = BLCKSZ - bkpb->hole_length;
+	int32		len;
+
+	if (bkpb->hole_length == 0)
+		source = page;
+	else
+	{
+		memcpy(holelessPage, page, bkpb->hole_offset);
+		memcpy(holelessPage + bkpb->hole_offset,
+			   page + (bkpb->hole_offset + bkpb->hole_length),
+			   BLCKSZ - (bkpb->hole_offset + bkpb->hole_length));
+		source = holelessPage;
+	}
+
+	if (!pglz_compress(source, rawlen, &dest->hdr, PGLZ_strategy_default))
+		return NULL;
+
+	/* we store the compressed data without the pglz header */
+	len = VARSIZE(&dest->hdr) - sizeof(PGLZ_Header);
+	if (len >= rawlen)
+		return NULL;
+
+	bkpb->compress_method = BKPBLOCK_COMPRESS_PGLZ;
+	bkpb->compress_length = (uint16) len;
+	return dest->data + sizeof(PGLZ_Header);
+}
+
 /*
  * XLogArchiveNotify
  *
@@ -1798,11 +1930,11 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible, bool xlog_switch)
 				Write->lastSegSwitchTime = (pg_time_t) time(NULL);
 
 				/*
-				 * Signal bgwriter to start a checkpoint if we've consumed too
-				 * much xlog since the last one.  For speed, we first check
-				 * using the local copy of RedoRecPtr, which might be out of
-				 * date; if it looks like a checkpoint is needed, forcibly
-				 * update RedoRecPtr and recheck.
+				 * Signal checkpointer to start a checkpoint if we've consumed
+				 * too much xlog since the last one.  For speed, we first
+				 * check using the local copy of RedoRecPtr, which might be
+				 * out of date; if it looks like a checkpoint is needed,
+				 * forcibly update RedoRecPtr and recheck.
 				 */
 				if (IsUnderPostmaster &&
 					XLogCheckpointNeeded(openLogId, openLogSeg))
@@ -1985,8 +2117,8 @@ XLogFlush(XLogRecPtr record)
 	 * During REDO, we are reading not writing WAL.  Therefore, instead of
 	 * trying to flush the WAL, we should update minRecoveryPoint instead. We
 	 * test XLogInsertAllowed(), not InRecovery, because we need the bgwriter
-	 * to act this way too, and because when the bgwriter tries to write the
-	 * end-of-recovery checkpoint, it should indeed flush.
+	 * and checkpointer to act this way too, and because when the checkpointer
+	 * tries to write the end-of-recovery checkpoint, it should indeed flush.
 	 */
 	if (!XLogInsertAllowed())
 	{
@@ -2817,9 +2949,6 @@ RestoreArchivedFile(char *path, const char *xlogfname,
 	char		xlogpath[MAXPGPATH];
 	char		xlogRestoreCmd[MAXPGPATH];
 	char		lastRestartPointFname[MAXPGPATH];
-	char	   *dp;
-	char	   *endp;
-	const char *sp;
 	int			rc;
 	bool		signaled;
 	struct stat stat_buf;
@@ -2905,57 +3034,23 @@ RestoreArchivedFile(char *path, const char *xlogfname,
 		XLogFileName(lastRestartPointFname, 0, 0, 0);
 
 	/*
-	 * construct the command to be executed
+	 * If the segment was already fetched in the background, use that copy.
 	 */
-	dp = xlogRestoreCmd;
-	endp = xlogRestoreCmd + MAXPGPATH - 1;
-	*endp = '\0';
-
-	for (sp = recoveryRestoreCommand; *sp; sp++)
+#ifndef WIN32
+	if (expectedSize == XLogSegSize &&
+		RestorePrefetchedFile(xlogfname, xlogpath))
 	{
-		if (*sp == '%')
-		{
-			switch (sp[1])
-			{
-				case 'p':
-					/* %p: relative path of target file */
-					sp++;
-					StrNCpy(dp, xlogpath, endp - dp);
-					make_native_path(dp);
-					dp += strlen(dp);
-					break;
-				case 'f':
-					/* %f: filename of desired file */
-					sp++;
-					StrNCpy(dp, xlogfname, endp - dp);
-					dp += strlen(dp);
-					break;
-				case 'r':
-					/* %r: filename of last restartpoint */
-					sp++;
-					StrNCpy(dp, lastRestartPointFname, endp - dp);
-					dp += strlen(dp);
-					break;
-				case '%':
-					/* convert %% to a single % */
-					sp++;
-					if (dp < endp)
-						*dp++ = *sp;
-					break;
-				default:
-					/* otherwise treat the % as not special */
-					if (dp < endp)
-						*dp++ = *sp;
-					break;
-			}
-		}
-		else
-		{
-			if (dp < endp)
-				*dp++ = *sp;
-		}
+		ereport(LOG,
+				(errmsg("restored log file \"%s\" from archive",
+						xlogfname)));
+		RestorePrefetchStart(xlogfname, lastRestartPointFname);
+		strcpy(path, xlogpath);
+		return true;
 	}
-	*dp = '\0';
+#endif
+
+	BuildRestoreCommand(xlogRestoreCmd, xlogpath, xlogfname,
+						lastRestartPointFname);
 
 	ereport(DEBUG3,
 			(errmsg_internal("executing restore command \"%s\"",
@@ -3018,6 +3113,10 @@ RestoreArchivedFile(char *path, const char *xlogfname,
 				ereport(LOG,
 						(errmsg("restored log file \"%s\" from archive",
 								xlogfname)));
+#ifndef WIN32
+				if (expectedSize == XLogSegSize)
+					RestorePrefetchStart(xlogfname, lastRestartPointFname);
+#endif
 				strcpy(path, xlogpath);
 				return true;
 			}
@@ -3082,6 +3181,289 @@ not_available:
 	return false;
 }
 
+/*
+ * Construct the restore_command to be executed to copy xlogfname from the
+ * archive to xlogpath.
+ */
+static void
+BuildRestoreCommand(char *xlogRestoreCmd, const char *xlogpath,
+					const char *xlogfname, const char *lastRestartPointFname)
+{
+	char	   *dp;
+	char	   *endp;
+	const char *sp;
+
+	dp = xlogRestoreCmd;
+	endp = xlogRestoreCmd + MAXPGPATH - 1;
+	*endp = '\0';
+
+	for (sp = recoveryRestoreCommand; *sp; sp++)
+	{
+		if (*sp == '%')
+		{
+			switch (sp[1])
+			{
+				case 'p':
+					/* %p: relative path of target file */
+					sp++;
+					StrNCpy(dp, xlogpath, endp - dp);
+					make_native_path(dp);
+					dp += strlen(dp);
+					break;
+				case 'f':
+					/* %f: filename of desired file */
+					sp++;
+					StrNCpy(dp, xlogfname, endp - dp);
+					dp += strlen(dp);
+					break;
+				case 'r':
+					/* %r: filename of last restartpoint */
+					sp++;
+					StrNCpy(dp, lastRestartPointFname, endp - dp);
+					dp += strlen(dp);
+					break;
+				case '%':
+					/* convert %% to a single % */
+					sp++;
+					if (dp < endp)
+						*dp++ = *sp;
+					break;
+				default:
+					/* otherwise treat the % as not special */
+					if (dp < endp)
+						*dp++ = *sp;
+					break;
+			}
+		}
+		else
+		{
+			if (dp < endp)
+				*dp++ = *sp;
+		}
+	}
+	*dp = '\0';
+}
+
+/*
+ * Background prefetching of WAL segments from the archive.
+ *
+ * With restore_prefetch_segments > 0, whenever a segment has been restored
+ * we launch restore_command in the background for that many segments
+ * following it, each into its own RECOVERYPREFETCHn file.  When recovery
+ * then asks for one of those segments, we only need to wait for the
+ * command that's already in progress, or not at all, so that the latency
+ * of fetching from the archive overlaps with replay.  If a prefetch fails
+ * for whatever reason, the segment is simply restored the normal way.
+ *
+ * This is only used for WAL segments; history files and the like are
+ * always restored synchronously.
+ */
+#define MAX_RESTORE_PREFETCH	16
+
+typedef struct RestorePrefetchSlot
+{
+	pid_t		pid;			/* PID of the restore command, or 0 */
+	int			status;			/* its exit status, once it has finished */
+	char		xlogfname[MAXFNAMELEN];	/* segment being fetched, or "" */
+} RestorePrefetchSlot;
+
+static RestorePrefetchSlot restorePrefetch[MAX_RESTORE_PREFETCH];
+
+#define RestorePrefetchPath(path, slot)	\
+	snprintf(path, MAXPGPATH, XLOGDIR "/RECOVERYPREFETCH%d", slot)
+
+#ifndef WIN32
+
+/*
+ * If xlogfname has been prefetched, wait for the prefetch to finish and
+ * move the file into place as xlogpath.  Returns false if the segment
+ * wasn't being prefetched, or the prefetch didn't produce a complete file.
+ */
+static bool
+RestorePrefetchedFile(const char *xlogfname, const char *xlogpath)
+{
+	char		prefetchpath[MAXPGPATH];
+	struct stat stat_buf;
+	int			slot;
+
+	for (slot = 0; slot < MAX_RESTORE_PREFETCH; slot++)
+	{
+		if (strcmp(restorePrefetch[slot].xlogfname, xlogfname) == 0)
+			break;
+	}
+	if (slot >= MAX_RESTORE_PREFETCH)
+		return false;
+
+	/*
+	 * Wait for the command to finish.  Like while running restore_command
+	 * ourselves, it's safe to exit right away on SIGTERM.
+	 */
+	if (restorePrefetch[slot].pid != 0)
+	{
+		in_restore_command = true;
+		if (shutdown_requested)
+			proc_exit(1);
+		while (waitpid(restorePrefetch[slot].pid,
+					   &restorePrefetch[slot].status, 0) < 0)
+		{
+			if (errno != EINTR)
+			{
+				restorePrefetch[slot].status = -1;
+				break;
+			}
+		}
+		in_restore_command = false;
+		restorePrefetch[slot].pid = 0;
+	}
+
+	RestorePrefetchPath(prefetchpath, slot);
+	if (restorePrefetch[slot].status != 0 ||
+		stat(prefetchpath, &stat_buf) != 0 ||
+		stat_buf.st_size != XLogSegSize)
+	{
+		ereport(DEBUG2,
+				(errmsg("prefetch of file \"%s\" from archive failed: return code %d",
+						xlogfname, restorePrefetch[slot].status)));
+		RestorePrefetchDiscard(slot);
+		return false;
+	}
+
+	if (rename(prefetchpath, xlogpath) != 0)
+		ereport(FATAL,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						prefetchpath, xlogpath)));
+	restorePrefetch[slot].xlogfname[0] = '\0';
+
+	return true;
+}
+
+/*
+ * Start prefetching the restore_prefetch_segments segments that follow
+ * xlogfname, on the same timeline.  Prefetches of any other segments are
+ * cancelled, since recovery has evidently gone elsewhere.
+ */
+static void
+RestorePrefetchStart(const char *xlogfname, const char *lastRestartPointFname)
+{
+	char		wanted[MAX_RESTORE_PREFETCH][MAXFNAMELEN];
+	char		prefetchpath[MAXPGPATH];
+	char		xlogRestoreCmd[MAXPGPATH];
+	TimeLineID	tli;
+	uint32		log;
+	uint32		seg;
+	int			nwanted;
+	int			slot;
+	int			i;
+
+	if (restorePrefetchSegments <= 0 || shutdown_requested ||
+		strlen(xlogfname) != 24 ||
+		sscanf(xlogfname, "%08X%08X%08X", &tli, &log, &seg) != 3)
+		return;
+
+	nwanted = Min(restorePrefetchSegments, MAX_RESTORE_PREFETCH);
+	for (i = 0; i < nwanted; i++)
+	{
+		NextLogSeg(log, seg);
+		XLogFileName(wanted[i], tli, log, seg);
+	}
+
+	/* Cancel prefetches that are no longer interesting */
+	for (slot = 0; slot < MAX_RESTORE_PREFETCH; slot++)
+	{
+		if (restorePrefetch[slot].xlogfname[0] == '\0')
+			continue;
+		for (i = 0; i < nwanted; i++)
+		{
+			if (strcmp(restorePrefetch[slot].xlogfname, wanted[i]) == 0)
+			{
+				wanted[i][0] = '\0';	/* already in progress */
+				break;
+			}
+		}
+		if (i >= nwanted)
+			RestorePrefetchDiscard(slot);
+	}
+
+	/* And launch the rest, oldest first */
+	slot = 0;
+	for (i = 0; i < nwanted; i++)
+	{
+		if (wanted[i][0] == '\0')
+			continue;
+		while (restorePrefetch[slot].xlogfname[0] != '\0')
+			slot++;
+		Assert(slot < MAX_RESTORE_PREFETCH);
+
+		RestorePrefetchPath(prefetchpath, slot);
+		unlink(prefetchpath);	/* might be left over from a crash */
+		BuildRestoreCommand(xlogRestoreCmd, prefetchpath, wanted[i],
+							lastRestartPointFname);
+
+		ereport(DEBUG3,
+				(errmsg_internal("executing restore command \"%s\" in background",
+								 xlogRestoreCmd)));
+
+		restorePrefetch[slot].pid = fork_process();
+		if (restorePrefetch[slot].pid == 0)
+		{
+			/* in child: run the command the same way system(3) would */
+			execl("/bin/sh", "sh", "-c", xlogRestoreCmd, (char *) NULL);
+			_exit(127);
+		}
+		if (restorePrefetch[slot].pid < 0)
+		{
+			/* not fatal; the segment will just be restored normally */
+			ereport(LOG,
+					(errmsg("could not fork restore command: %m")));
+			restorePrefetch[slot].pid = 0;
+			return;
+		}
+		restorePrefetch[slot].status = 0;
+		strlcpy(restorePrefetch[slot].xlogfname, wanted[i], MAXFNAMELEN);
+	}
+}
+
+/*
+ * Cancel a prefetch, if it's still running, and remove its file.
+ */
+static void
+RestorePrefetchDiscard(int slot)
+{
+	char		prefetchpath[MAXPGPATH];
+
+	if (restorePrefetch[slot].pid != 0)
+	{
+		kill(restorePrefetch[slot].pid, SIGTERM);
+		while (waitpid(restorePrefetch[slot].pid, NULL, 0) < 0 &&
+			   errno == EINTR)
+			;
+		restorePrefetch[slot].pid = 0;
+	}
+
+	RestorePrefetchPath(prefetchpath, slot);
+	unlink(prefetchpath);		/* ignore any error */
+	restorePrefetch[slot].xlogfname[0] = '\0';
+}
+#endif   /* WIN32 */
+
+/*
+ * Cancel all prefetches at the end of archive recovery.
+ */
+static void
+RestorePrefetchCleanup(void)
+{
+#ifndef WIN32
+	int			slot;
+
+	for (slot = 0; slot < MAX_RESTORE_PREFETCH; slot++)
+	{
+		if (restorePrefetch[slot].xlogfname[0] != '\0')
+			RestorePrefetchDiscard(slot);
+	}
+#endif
+}
+
 /*
  * Attempt to execute an external shell command during recovery.
  *
@@ -3551,27 +3933,57 @@ RestoreBkpBlocks(XLogRecPtr lsn, XLogRecord *record, bool cleanup)
 
 		page = (Page) BufferGetPage(buffer);
 
-		if (bkpb.hole_length == 0)
-		{
-			memcpy((char *) page, blk, BLCKSZ);
-		}
-		else
-		{
-			/* must zero-fill the hole */
-			MemSet((char *) page, 0, BLCKSZ);
-			memcpy((char *) page, blk, bkpb.hole_offset);
-			memcpy((char *) page + (bkpb.hole_offset + bkpb.hole_length),
-				   blk + bkpb.hole_offset,
-				   BLCKSZ - (bkpb.hole_offset + bkpb.hole_length));
-		}
+		blk = RestoreBkpBlockImage(&bkpb, blk, (char *) page);
 
 		PageSetLSN(page, lsn);
 		PageSetTLI(page, ThisTimeLineID);
 		MarkBufferDirty(buffer);
 		UnlockReleaseBuffer(buffer);
+	}
+}
 
-		blk += BLCKSZ - bkpb.hole_length;
+/*
+ * Reconstruct the page image of a backup block into *page.  blk points to
+ * the block data following *bkpb; the return value points past it.
+ *
+ * The hole is zero-filled, and compressed images are decompressed.
+ */
+char *
+RestoreBkpBlockImage(BkpBlock *bkpb, char *blk, char *page)
+{
+	char	   *source = blk;
+
+	if (bkpb->compress_method != BKPBLOCK_COMPRESS_NONE)
+	{
+		CompressedPage *cpage = &compressedPages[0];
+
+		if (bkpb->compress_method != BKPBLOCK_COMPRESS_PGLZ)
+			elog(ERROR, "unrecognized backup block compression method: %u",
+				 bkpb->compress_method);
+
+		/* put the pglz header back in front of the data, aligned */
+		SET_VARSIZE(&cpage->hdr, sizeof(PGLZ_Header) + bkpb->compress_length);
+		cpage->hdr.rawsize = BLCKSZ - bkpb->hole_length;
+		memcpy(cpage->data + sizeof(PGLZ_Header), blk, bkpb->compress_length);
+		pglz_decompress(&cpage->hdr, holelessPage);
+		source = holelessPage;
+	}
+
+	if (bkpb->hole_length == 0)
+	{
+		memcpy(page, source, BLCKSZ);
+	}
+	else
+	{
+		/* must zero-fill the hole */
+		MemSet(page, 0, BLCKSZ);
+		memcpy(page, source, bkpb->hole_offset);
+		memcpy(page + (bkpb->hole_offset + bkpb->hole_length),
+			   source + bkpb->hole_offset,
+			   BLCKSZ - (bkpb->hole_offset + bkpb->hole_length));
 	}
+
+	return blk + BkpBlockDataLength(bkpb);
 }
 
 /*
@@ -3580,8 +3992,10 @@ RestoreBkpBlocks(XLogRecPtr lsn, XLogRecord *record, bool cleanup)
  * data to read in) until we've checked the CRCs.
  *
  * We assume all of the record has been read into memory at *record.
+ *
+ * This is also used by xlogreader.c.
  */
-static bool
+bool
 RecordIsValid(XLogRecord *record, XLogRecPtr recptr, int emode)
 {
 	pg_crc32	crc;
@@ -3611,7 +4025,15 @@ RecordIsValid(XLogRecord *record, XLogRecPtr recptr, int emode)
 							recptr.xlogid, recptr.xrecoff)));
 			return false;
 		}
-		blen = sizeof(BkpBlock) + BLCKSZ - bkpb.hole_length;
+		if (bkpb.compress_method != BKPBLOCK_COMPRESS_NONE &&
+			bkpb.compress_length >= BLCKSZ - bkpb.hole_length)
+		{
+			ereport(emode_for_corrupt_record(emode, recptr),
+					(errmsg("incorrect compressed backup block size in record at %X/%X",
+							recptr.xlogid, recptr.xrecoff)));
+			return false;
+		}
+		blen = sizeof(BkpBlock) + BkpBlockDataLength(&bkpb);
 		COMP_CRC32(crc, blk, blen);
 		blk += blen;
 	}
@@ -4846,6 +5268,7 @@ XLOGShmemInit(void)
 	 */
 	XLogCtl->XLogCacheBlck = XLOGbuffers - 1;
 	XLogCtl->SharedRecoveryInProgress = true;
+	XLogCtl->SharedHotStandbyActive = false;
 	XLogCtl->Insert.currpage = (XLogPageHeader) (XLogCtl->pages);
 	SpinLockInit(&XLogCtl->info_lck);
 	InitSharedLatch(&XLogCtl->recoveryWakeupLatch);
@@ -5176,6 +5599,20 @@ readRecoveryCommandFile(void)
 					(errmsg("archive_cleanup_command = '%s'",
 							archiveCleanupCommand)));
 		}
+		else if (strcmp(tok1, "restore_prefetch_segments") == 0)
+		{
+			errno = 0;
+			restorePrefetchSegments = (int) strtol(tok2, NULL, 0);
+			if (errno == EINVAL || errno == ERANGE ||
+				restorePrefetchSegments < 0 ||
+				restorePrefetchSegments > MAX_RESTORE_PREFETCH)
+				ereport(FATAL,
+						(errmsg("restore_prefetch_segments must be between 0 and %d: \"%s\"",
+								MAX_RESTORE_PREFETCH, tok2)));
+			ereport(DEBUG2,
+					(errmsg("restore_prefetch_segments = %d",
+							restorePrefetchSegments)));
+		}
 		else if (strcmp(tok1, "recovery_target_timeline") == 0)
 		{
 			rtliGiven = true;
@@ -5260,6 +5697,13 @@ readRecoveryCommandFile(void)
 					(errmsg("primary_conninfo = '%s'",
 							PrimaryConnInfo)));
 		}
+		else if (strcmp(tok1, "primary_slot_name") == 0)
+		{
+			PrimarySlotName = pstrdup(tok2);
+			ereport(DEBUG2,
+					(errmsg("primary_slot_name = '%s'",
+							PrimarySlotName)));
+		}
 		else if (strcmp(tok1, "trigger_file") == 0)
 		{
 			TriggerFile = pstrdup(tok2);
@@ -5343,6 +5787,12 @@ exitArchiveRecovery(TimeLineID endTLI, uint32 endLogId, uint32 endLogSeg)
 	 */
 	InArchiveRecovery = false;
 
+	/*
+	 * Segments prefetched from the archive beyond the end of recovery won't
+	 * be needed.
+	 */
+	RestorePrefetchCleanup();
+
 	/*
 	 * Update min recovery point one last time.
 	 */
@@ -5568,7 +6018,7 @@ recoveryStopsHere(XLogRecord *record, bool *includeThis)
  *
  * We keep this in XLogCtl, not a simple static variable, so that it can be
  * seen by processes other than the startup process.  Note in particular
- * that CreateRestartPoint is executed in the bgwriter.
+ * that CreateRestartPoint is executed in the checkpointer.
  */
 static void
 SetLatestXTime(TimestampTz xtime)
@@ -5768,6 +6218,12 @@ StartupXLOG(void)
 	 */
 	RelationCacheInitFileRemove();
 
+	/*
+	 * Load the replication slots, so that the WAL they need isn't removed by
+	 * the restartpoints and checkpoints to come.
+	 */
+	StartupReplicationSlots();
+
 	/*
 	 * Initialize on the assumption we want to recover to the same timeline
 	 * that's active according to pg_control.
@@ -6119,20 +6575,26 @@ StartupXLOG(void)
 
 		/*
 		 * Let postmaster know we've started redo now, so that it can launch
-		 * bgwriter to perform restartpoints.  We don't bother during crash
+		 * checkpointer to perform restartpoints.  We don't bother during crash
 		 * recovery as restartpoints can only be performed during archive
 		 * recovery.  And we'd like to keep crash recovery simple, to avoid
 		 * introducing bugs that could affect you when recovering after crash.
 		 *
 		 * After this point, we can no longer assume that we're the only
 		 * process in addition to postmaster!  Also, fsync requests are
-		 * subsequently to be handled by the bgwriter, not locally.
+		 * subsequently to be handled by the checkpointer, not locally.
 		 */
 		if (InArchiveRecovery && IsUnderPostmaster)
 		{
 			SetForwardFsyncRequests();
 			SendPostmasterSignal(PMSIGNAL_RECOVERY_STARTED);
 			bgwriterLaunched = true;
+
+			/*
+			 * Now that fsyncs are forwarded, other processes can help with
+			 * replay, too.
+			 */
+			RedoWorkersStart();
 		}
 
 		/*
@@ -6212,6 +6674,12 @@ StartupXLOG(void)
 						break;
 				}
 
+				/*
+				 * Start reading the blocks that upcoming records will need,
+				 * so that their I/O overlaps with replay of this one.
+				 */
+				XLogPrefetchAhead(EndRecPtr, ReadRecPtr);
+
 				/* Setup error traceback support for ereport() */
 				errcontext.callback = rm_redo_error_callback;
 				errcontext.arg = (void *) record;
@@ -6242,14 +6710,23 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
-				RmgrTable[record->xl_rmid].rm_redo(EndRecPtr, record);
+				/*
+				 * Hand the record to a redo worker if possible; otherwise
+				 * (or after waiting for the workers to catch up, if the
+				 * record depends on what they're doing) replay it here.
+				 */
+				if (!RedoWorkerDispatch(EndRecPtr, record))
+					RmgrTable[record->xl_rmid].rm_redo(EndRecPtr, record);
 
 				/* Pop the error context stack */
 				error_context_stack = errcontext.previous;
 
 				/*
 				 * Update shared recoveryLastRecPtr after this record has been
-				 * replayed.
+				 * replayed.  With parallel redo, a redo worker may still be
+				 * applying it; anything that needs the effects of all
+				 * earlier records, such as a restartpoint or the start of
+				 * hot standby, waits for the workers first.
 				 */
 				SpinLockAcquire(&xlogctl->info_lck);
 				xlogctl->recoveryLastRecPtr = EndRecPtr;
@@ -6264,6 +6741,14 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			RedoWorkersStop();
+			XLogPrefetchEnd();
+			if (readAheadFile >= 0)
+			{
+				close(readAheadFile);
+				readAheadFile = -1;
+			}
+
 			ereport(LOG,
 					(errmsg("redo done at %X/%X",
 							ReadRecPtr.xlogid, ReadRecPtr.xrecoff)));
@@ -6564,6 +7049,12 @@ StartupXLOG(void)
 		xlogctl->SharedRecoveryInProgress = false;
 		SpinLockRelease(&xlogctl->info_lck);
 	}
+
+	/*
+	 * Wake up any walsenders cascading WAL to further standbys, so that
+	 * they notice the end of recovery promptly.
+	 */
+	WalSndWakeup();
 }
 
 /*
@@ -6599,11 +7090,52 @@ CheckRecoveryConsistency(void)
 		reachedMinRecoveryPoint &&
 		IsUnderPostmaster)
 	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile XLogCtlData *xlogctl = XLogCtl;
+
 		backendsAllowed = true;
+
+		/* Queries must not see pages the redo workers haven't caught up on */
+		RedoWorkersWaitIdle();
+
+		SpinLockAcquire(&xlogctl->info_lck);
+		xlogctl->SharedHotStandbyActive = true;
+		SpinLockRelease(&xlogctl->info_lck);
+
 		SendPostmasterSignal(PMSIGNAL_BEGIN_HOT_STANDBY);
 	}
 }
 
+/*
+ * Are we allowing queries during recovery yet?  Once true, this stays true
+ * until the end of recovery; after that it doesn't matter.
+ *
+ * Works in any process that's connected to shared memory.
+ */
+bool
+HotStandbyActive(void)
+{
+	/*
+	 * We check shared state each time only until Hot Standby is active. We
+	 * can't de-activate Hot Standby, so there's no need to keep checking
+	 * after the shared variable has once been seen true.
+	 */
+	if (LocalHotStandbyActive)
+		return true;
+	else
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile XLogCtlData *xlogctl = XLogCtl;
+
+		/* spinlock is essential on machines with weak memory ordering! */
+		SpinLockAcquire(&xlogctl->info_lck);
+		LocalHotStandbyActive = xlogctl->SharedHotStandbyActive;
+		SpinLockRelease(&xlogctl->info_lck);
+
+		return LocalHotStandbyActive;
+	}
+}
+
 /*
  * Is the system still in recovery?
  *
@@ -6889,6 +7421,74 @@ GetFlushRecPtr(void)
 	return recptr;
 }
 
+/*
+ * GetXLogInsertRecPtr -- Returns the current insert position, that is where
+ * the next WAL record will be inserted (or a page boundary before it).
+ */
+XLogRecPtr
+GetXLogInsertRecPtr(void)
+{
+	XLogCtlInsert *Insert = &XLogCtl->Insert;
+	XLogRecPtr	current_recptr;
+
+	LWLockAcquire(WALInsertLock, LW_SHARED);
+	INSERT_RECPTR(current_recptr, Insert, Insert->curridx);
+	LWLockRelease(WALInsertLock);
+
+	return current_recptr;
+}
+
+/*
+ * GetXLogReplayRecPtr -- Returns the end+1 of the last WAL record replayed
+ * during recovery, or InvalidXLogRecPtr if replay has not started.
+ */
+XLogRecPtr
+GetXLogReplayRecPtr(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile XLogCtlData *xlogctl = XLogCtl;
+	XLogRecPtr	recptr;
+
+	SpinLockAcquire(&xlogctl->info_lck);
+	recptr = xlogctl->recoveryLastRecPtr;
+	SpinLockRelease(&xlogctl->info_lck);
+
+	return recptr;
+}
+
+/*
+ * Record the oldest WAL location any replication slot needs, for
+ * checkpoints to keep.
+ */
+void
+XLogSetReplicationSlotMinimumLSN(XLogRecPtr lsn)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile XLogCtlData *xlogctl = XLogCtl;
+
+	SpinLockAcquire(&xlogctl->info_lck);
+	xlogctl->replicationSlotMinLSN = lsn;
+	SpinLockRelease(&xlogctl->info_lck);
+}
+
+/*
+ * Return the oldest WAL location any replication slot needs, or 0/0 if
+ * there are no slots holding back WAL.
+ */
+XLogRecPtr
+XLogGetReplicationSlotMinimumLSN(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile XLogCtlData *xlogctl = XLogCtl;
+	XLogRecPtr	retval;
+
+	SpinLockAcquire(&xlogctl->info_lck);
+	retval = xlogctl->replicationSlotMinLSN;
+	SpinLockRelease(&xlogctl->info_lck);
+
+	return retval;
+}
+
 /*
  * Get the time of the last xlog segment switch
  */
@@ -7052,7 +7652,9 @@ LogCheckpointEnd(bool restartpoint)
 	else
 		elog(LOG, "checkpoint complete: wrote %d buffers (%.1f%%); "
 			 "%d transaction log file(s) added, %d removed, %d recycled; "
-			 "write=%ld.%03d s, sync=%ld.%03d s, total=%ld.%03d s",
+			 "write=%ld.%03d s, sync=%ld.%03d s, total=%ld.%03d s; "
+			 "full-page images=" UINT64_FORMAT ", "
+			 "size=" UINT64_FORMAT " kB (" UINT64_FORMAT " kB uncompressed)",
 			 CheckpointStats.ckpt_bufs_written,
 			 (double) CheckpointStats.ckpt_bufs_written * 100 / NBuffers,
 			 CheckpointStats.ckpt_segs_added,
@@ -7060,7 +7662,10 @@ LogCheckpointEnd(bool restartpoint)
 			 CheckpointStats.ckpt_segs_recycled,
 			 write_secs, write_usecs / 1000,
 			 sync_secs, sync_usecs / 1000,
-			 total_secs, total_usecs / 1000);
+			 total_secs, total_usecs / 1000,
+			 CheckpointStats.ckpt_fpi_written,
+			 CheckpointStats.ckpt_fpi_bytes / 1024,
+			 CheckpointStats.ckpt_fpi_raw_bytes / 1024);
 }
 
 /*
@@ -7239,6 +7844,25 @@ CreateCheckPoint(int flags)
 		SpinLockRelease(&xlogctl->info_lck);
 	}
 
+	/*
+	 * Collect the full-page image statistics while we have the insert lock.
+	 * Since the new redo pointer is in effect from here on, these are the
+	 * images that the previous checkpoint made necessary.
+	 */
+	{
+		static uint64 prevFpiWritten = 0;
+		static uint64 prevFpiBytes = 0;
+		static uint64 prevFpiRawBytes = 0;
+
+		CheckpointStats.ckpt_fpi_written = Insert->fpiWritten - prevFpiWritten;
+		CheckpointStats.ckpt_fpi_bytes = Insert->fpiBytes - prevFpiBytes;
+		CheckpointStats.ckpt_fpi_raw_bytes =
+			Insert->fpiRawBytes - prevFpiRawBytes;
+		prevFpiWritten = Insert->fpiWritten;
+		prevFpiBytes = Insert->fpiBytes;
+		prevFpiRawBytes = Insert->fpiRawBytes;
+	}
+
 	/*
 	 * Now we can release WAL insert lock, allowing other xacts to proceed
 	 * while we are flushing disk buffers.
@@ -7428,46 +8052,7 @@ CreateCheckPoint(int flags)
 	 */
 	if (_logId || _logSeg)
 	{
-		/*
-		 * Calculate the last segment that we need to retain because of
-		 * wal_keep_segments, by subtracting wal_keep_segments from the new
-		 * checkpoint location.
-		 */
-		if (wal_keep_segments > 0)
-		{
-			uint32		log;
-			uint32		seg;
-			int			d_log;
-			int			d_seg;
-
-			XLByteToSeg(recptr, log, seg);
-
-			d_seg = wal_keep_segments % XLogSegsPerFile;
-			d_log = wal_keep_segments / XLogSegsPerFile;
-			if (seg < d_seg)
-			{
-				d_log += 1;
-				seg = seg - d_seg + XLogSegsPerFile;
-			}
-			else
-				seg = seg - d_seg;
-			/* avoid underflow, don't go below (0,1) */
-			if (log < d_log || (log == d_log && seg == 0))
-			{
-				log = 0;
-				seg = 1;
-			}
-			else
-				log = log - d_log;
-
-			/* don't delete WAL segments newer than the calculated segment */
-			if (log < _logId || (log == _logId && seg < _logSeg))
-			{
-				_logId = log;
-				_logSeg = seg;
-			}
-		}
-
+		KeepLogSeg(recptr, &_logId, &_logSeg);
 		PrevLogSeg(_logId, _logSeg);
 		RemoveOldXlogFiles(_logId, _logSeg, recptr);
 	}
@@ -7502,6 +8087,73 @@ CreateCheckPoint(int flags)
 	LWLockRelease(CheckpointLock);
 }
 
+/*
+ * Move back logId and logSeg, the oldest segment a checkpoint or
+ * restartpoint would keep, to also keep the segments still needed because
+ * of wal_keep_segments and replication slots.  recptr is the new checkpoint
+ * location, or the current end of WAL.
+ */
+static void
+KeepLogSeg(XLogRecPtr recptr, uint32 *logId, uint32 *logSeg)
+{
+	XLogRecPtr	slotminptr;
+
+	/*
+	 * Calculate the last segment that we need to retain because of
+	 * wal_keep_segments, by subtracting wal_keep_segments from the given
+	 * location.
+	 */
+	if (wal_keep_segments > 0)
+	{
+		uint32		log;
+		uint32		seg;
+		int			d_log;
+		int			d_seg;
+
+		XLByteToSeg(recptr, log, seg);
+
+		d_seg = wal_keep_segments % XLogSegsPerFile;
+		d_log = wal_keep_segments / XLogSegsPerFile;
+		if (seg < d_seg)
+		{
+			d_log += 1;
+			seg = seg - d_seg + XLogSegsPerFile;
+		}
+		else
+			seg = seg - d_seg;
+		/* avoid underflow, don't go below (0,1) */
+		if (log < d_log || (log == d_log && seg == 0))
+		{
+			log = 0;
+			seg = 1;
+		}
+		else
+			log = log - d_log;
+
+		/* don't delete WAL segments newer than the calculated segment */
+		if (log < *logId || (log == *logId && seg < *logSeg))
+		{
+			*logId = log;
+			*logSeg = seg;
+		}
+	}
+
+	/* don't delete WAL segments a replication slot still needs */
+	slotminptr = XLogGetReplicationSlotMinimumLSN();
+	if (slotminptr.xlogid != 0 || slotminptr.xrecoff != 0)
+	{
+		uint32		log;
+		uint32		seg;
+
+		XLByteToSeg(slotminptr, log, seg);
+		if (log < *logId || (log == *logId && seg < *logSeg))
+		{
+			*logId = log;
+			*logSeg = seg;
+		}
+	}
+}
+
 /*
  * Flush all data in shared memory to disk, and fsync
  *
@@ -7515,6 +8167,7 @@ CheckPointGuts(XLogRecPtr checkPointRedo, int flags)
 	CheckPointSUBTRANS();
 	CheckPointMultiXact();
 	CheckPointRelationMap();
+	CheckPointReplicationSlots();
 	CheckPointBuffers(flags);	/* performs all required fsyncs */
 	/* We deliberately delay 2PC checkpointing as long as possible */
 	CheckPointTwoPhase(checkPointRedo);
@@ -7527,7 +8180,7 @@ CheckPointGuts(XLogRecPtr checkPointRedo, int flags)
  * It must determine whether the checkpoint represents a safe restartpoint or
  * not.  If so, the checkpoint record is stashed in shared memory so that
  * CreateRestartPoint can consult it.  (Note that the latter function is
- * executed by the bgwriter, while this one will be executed by the startup
+ * executed by the checkpointer, while this one will be executed by the startup
  * process.)
  */
 static void
@@ -7558,8 +8211,8 @@ RecoveryRestartPoint(const CheckPoint *checkPoint)
 	}
 
 	/*
-	 * Copy the checkpoint record to shared memory, so that bgwriter can use
-	 * it the next time it wants to perform a restartpoint.
+	 * Copy the checkpoint record to shared memory, so that checkpointer can
+	 * use it the next time it wants to perform a restartpoint.
 	 */
 	SpinLockAcquire(&xlogctl->info_lck);
 	XLogCtl->lastCheckPointRecPtr = ReadRecPtr;
@@ -7718,6 +8371,7 @@ CreateRestartPoint(int flags)
 		/* Get the current (or recent) end of xlog */
 		endptr = GetWalRcvWriteRecPtr(NULL);
 
+		KeepLogSeg(endptr, &_logId, &_logSeg);
 		PrevLogSeg(_logId, _logSeg);
 		RemoveOldXlogFiles(_logId, _logSeg, endptr);
 
@@ -8187,10 +8841,19 @@ static int
 get_sync_bit(int method)
 {
 	int			o_direct_flag = 0;
+	int			wal_direct_flag = 0;
+
+	/*
+	 * If direct_io covers WAL, always bypass the kernel cache, whatever the
+	 * sync method and even if the WAL is going to be read again soon.  The
+	 * walreceiver can't, see below.
+	 */
+	if ((direct_io & DIRECT_IO_WAL) && !am_walreceiver)
+		wal_direct_flag = PG_O_DIRECT;
 
 	/* If fsync is disabled, never open in sync mode */
 	if (!enableFsync)
-		return 0;
+		return wal_direct_flag;
 
 	/*
 	 * Optimize writes by bypassing kernel cache with O_DIRECT when using
@@ -8220,14 +8883,14 @@ get_sync_bit(int method)
 		case SYNC_METHOD_FSYNC:
 		case SYNC_METHOD_FSYNC_WRITETHROUGH:
 		case SYNC_METHOD_FDATASYNC:
-			return 0;
+			return wal_direct_flag;
 #ifdef OPEN_SYNC_FLAG
 		case SYNC_METHOD_OPEN:
-			return OPEN_SYNC_FLAG | o_direct_flag;
+			return OPEN_SYNC_FLAG | o_direct_flag | wal_direct_flag;
 #endif
 #ifdef OPEN_DATASYNC_FLAG
 		case SYNC_METHOD_OPEN_DSYNC:
-			return OPEN_DATASYNC_FLAG | o_direct_flag;
+			return OPEN_DATASYNC_FLAG | o_direct_flag | wal_direct_flag;
 #endif
 		default:
 			/* can't happen (unless we are out of sync with option array) */
@@ -8331,6 +8994,27 @@ pg_start_backup(PG_FUNCTION_ARGS)
 	text	   *backupid = PG_GETARG_TEXT_P(0);
 	bool		fast = PG_GETARG_BOOL(1);
 	char	   *backupidstr;
+	XLogRecPtr	startpoint;
+	char		startxlogstr[MAXFNAMELEN];
+
+	backupidstr = text_to_cstring(backupid);
+
+	startpoint = do_pg_start_backup(backupidstr, fast);
+
+	snprintf(startxlogstr, sizeof(startxlogstr), "%X/%X",
+			 startpoint.xlogid, startpoint.xrecoff);
+	PG_RETURN_TEXT_P(cstring_to_text(startxlogstr));
+}
+
+/*
+ * do_pg_start_backup is the workhorse of the user-visible pg_start_backup()
+ * function.  It is also used by the BASE_BACKUP replication command.
+ *
+ * Returns the starting WAL location of the backup.
+ */
+XLogRecPtr
+do_pg_start_backup(const char *backupidstr, bool fast)
+{
 	XLogRecPtr	checkpointloc;
 	XLogRecPtr	startpoint;
 	pg_time_t	stamp_time;
@@ -8358,8 +9042,6 @@ pg_start_backup(PG_FUNCTION_ARGS)
 			  errmsg("WAL level not sufficient for making an online backup"),
 				 errhint("wal_level must be set to \"archive\" or \"hot_standby\" at server start.")));
 
-	backupidstr = text_to_cstring(backupid);
-
 	/*
 	 * Mark backup active in shared memory.  We must do full-page WAL writes
 	 * during an on-line backup even if not doing so at other times, because
@@ -8482,9 +9164,7 @@ pg_start_backup(PG_FUNCTION_ARGS)
 	/*
 	 * We're done.  As a convenience, return the starting WAL location.
 	 */
-	snprintf(xlogfilename, sizeof(xlogfilename), "%X/%X",
-			 startpoint.xlogid, startpoint.xrecoff);
-	PG_RETURN_TEXT_P(cstring_to_text(xlogfilename));
+	return startpoint;
 }
 
 /* Error cleanup callback for pg_start_backup */
@@ -8512,6 +9192,25 @@ pg_start_backup_callback(int code, Datum arg)
  */
 Datum
 pg_stop_backup(PG_FUNCTION_ARGS)
+{
+	XLogRecPtr	stoppoint;
+	char		stopxlogstr[MAXFNAMELEN];
+
+	stoppoint = do_pg_stop_backup();
+
+	snprintf(stopxlogstr, sizeof(stopxlogstr), "%X/%X",
+			 stoppoint.xlogid, stoppoint.xrecoff);
+	PG_RETURN_TEXT_P(cstring_to_text(stopxlogstr));
+}
+
+/*
+ * do_pg_stop_backup is the workhorse of the user-visible pg_stop_backup()
+ * function.  It is also used by the BASE_BACKUP replication command.
+ *
+ * Returns the ending WAL location of the backup.
+ */
+XLogRecPtr
+do_pg_stop_backup(void)
 {
 	XLogRecPtr	startpoint;
 	XLogRecPtr	stoppoint;
@@ -8722,9 +9421,29 @@ pg_stop_backup(PG_FUNCTION_ARGS)
 	/*
 	 * We're done.  As a convenience, return the ending WAL location.
 	 */
-	snprintf(stopxlogfilename, sizeof(stopxlogfilename), "%X/%X",
-			 stoppoint.xlogid, stoppoint.xrecoff);
-	PG_RETURN_TEXT_P(cstring_to_text(stopxlogfilename));
+	return stoppoint;
+}
+
+/*
+ * do_pg_abort_backup: abort a running backup
+ *
+ * This does just the most basic steps of do_pg_stop_backup(), by taking the
+ * system out of backup mode, thus making it a lot more safe to call from
+ * an error handler.  No end-of-backup WAL record is written and no history
+ * file is created, so the aborted backup cannot be used.
+ */
+void
+do_pg_abort_backup(void)
+{
+	LWLockAcquire(WALInsertLock, LW_EXCLUSIVE);
+	XLogCtl->Insert.forcePageWrites = false;
+	LWLockRelease(WALInsertLock);
+
+	if (unlink(BACKUP_LABEL_FILE) != 0 && errno != ENOENT)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m",
+						BACKUP_LABEL_FILE)));
 }
 
 /*
@@ -8851,14 +9570,10 @@ pg_last_xlog_receive_location(PG_FUNCTION_ARGS)
 Datum
 pg_last_xlog_replay_location(PG_FUNCTION_ARGS)
 {
-	/* use volatile pointer to prevent code rearrangement */
-	volatile XLogCtlData *xlogctl = XLogCtl;
 	XLogRecPtr	recptr;
 	char		location[MAXFNAMELEN];
 
-	SpinLockAcquire(&xlogctl->info_lck);
-	recptr = xlogctl->recoveryLastRecPtr;
-	SpinLockRelease(&xlogctl->info_lck);
+	recptr = GetXLogReplayRecPtr();
 
 	if (recptr.xlogid == 0 && recptr.xrecoff == 0)
 		PG_RETURN_NULL();
@@ -9318,8 +10033,8 @@ XLogPageRead(XLogRecPtr *RecPtr, int emode, bool fetching_ckpt,
 	if (readFile >= 0 && !XLByteInSeg(*RecPtr, readId, readSeg))
 	{
 		/*
-		 * Signal bgwriter to start a restartpoint if we've replayed too much
-		 * xlog since the last one.
+		 * Signal checkpointer to start a restartpoint if we've replayed too
+		 * much xlog since the last one.
 		 */
 		if (StandbyMode && bgwriterLaunched)
 		{
@@ -9498,7 +10213,8 @@ retry:
 						{
 							RequestXLogStreaming(
 									  fetching_ckpt ? RedoStartLSN : *RecPtr,
-												 PrimaryConnInfo);
+												 PrimaryConnInfo,
+												 PrimarySlotName);
 							continue;
 						}
 					}
@@ -9656,6 +10372,80 @@ triggered:
 	return false;
 }
 
+/*
+ * Read the XLOG page at pageptr ahead of the replay position, for
+ * xlogprefetch.c.
+ *
+ * Unlike XLogPageRead, this never waits for WAL to arrive, never restores
+ * files from the archive and never reports errors; it just returns false if
+ * the page isn't available right now.  When streaming, only pages that
+ * walreceiver has already written in full are considered available.  When
+ * replaying from the archive, only the segment currently being replayed
+ * is, as the file it was restored to.  The caller must validate the page
+ * header, since a file in pg_xlog may be an old recycled segment.
+ */
+bool
+XLogPrefetchReadPage(XLogRecPtr pageptr, char *buf)
+{
+	uint32		targetId;
+	uint32		targetSeg;
+	uint32		targetPageOff;
+
+	/* Nothing to go by if replay doesn't have a file open either */
+	if (readSource == 0)
+		return false;
+
+	XLByteToSeg(pageptr, targetId, targetSeg);
+	targetPageOff = pageptr.xrecoff % XLogSegSize;
+
+	if (readSource == XLOG_FROM_STREAM)
+	{
+		XLogRecPtr	latestChunkStart;
+		XLogRecPtr	receivedPtr;
+		XLogRecPtr	pageEnd = pageptr;
+
+		pageEnd.xrecoff += XLOG_BLCKSZ;
+		receivedPtr = GetWalRcvWriteRecPtr(&latestChunkStart);
+		if (XLByteLT(receivedPtr, pageEnd))
+			return false;
+	}
+	else if (readSource == XLOG_FROM_ARCHIVE &&
+			 (targetId != readId || targetSeg != readSeg))
+		return false;
+
+	if (readAheadFile >= 0 &&
+		(targetId != readAheadId || targetSeg != readAheadSeg ||
+		 curFileTLI != readAheadTLI || readSource != readAheadSource))
+	{
+		close(readAheadFile);
+		readAheadFile = -1;
+	}
+
+	if (readAheadFile < 0)
+	{
+		char		path[MAXPGPATH];
+
+		if (readSource == XLOG_FROM_ARCHIVE)
+			snprintf(path, MAXPGPATH, XLOGDIR "/RECOVERYXLOG");
+		else
+			XLogFilePath(path, curFileTLI, targetId, targetSeg);
+
+		readAheadFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+		if (readAheadFile < 0)
+			return false;
+		readAheadId = targetId;
+		readAheadSeg = targetSeg;
+		readAheadTLI = curFileTLI;
+		readAheadSource = readSource;
+	}
+
+	if (lseek(readAheadFile, (off_t) targetPageOff, SEEK_SET) < 0 ||
+		read(readAheadFile, buf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
+		return false;
+
+	return true;
+}
+
 /*
  * Determine what log level should be used to report a corrupt WAL record
  * in the current WAL page, previously read by XLogPageRead().
@@ -0,0 +1,388 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching of data blocks referenced by WAL ahead of replay
+ *
+ * Redo routines read the pages they modify with XLogReadBuffer, one at a
+ * time, so replaying WAL that touches pages scattered all over the database
+ * is bound by random read latency.  To hide that, the startup process calls
+ * XLogPrefetchAhead before replaying each record.  It decodes records up to
+ * recovery_prefetch_distance bytes ahead of the replay position, asks each
+ * record's resource manager which blocks redo will need to read (see
+ * rm_blockrefs), and issues a prefetch hint for those that are not already
+ * in shared buffers.  By the time replay gets to the record, the read has
+ * hopefully completed in the background.
+ *
+ * The look-ahead has its own little WAL decoder, separate from ReadRecord,
+ * because it must never wait for WAL to arrive, never restore anything from
+ * the archive and never throw an error: it only looks at WAL that is already
+ * on disk (see XLogPrefetchReadPage in xlog.c), and simply stops when it
+ * runs out of it or finds something it doesn't like.  It doesn't verify
+ * record CRCs either.  None of this affects correctness, since the records
+ * are read again and fully checked by ReadRecord before they are replayed;
+ * the worst that can happen is a useless prefetch.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "catalog/pg_control.h"
+#include "storage/bufmgr.h"
+
+
+/* GUC variable: how far ahead of replay to look, in kilobytes */
+int			recovery_prefetch_distance = 256;
+
+/* number of recently prefetched blocks remembered to avoid repeats */
+#define RECENT_PREFETCH_SIZE	16
+
+typedef struct RecentPrefetch
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+} RecentPrefetch;
+
+/* Look-ahead decoder state */
+static bool prefetchActive = false;
+static XLogRecPtr decodePtr;	/* start of next record to decode */
+static XLogRecPtr decodePrevPtr;	/* start of last record decoded */
+static XLogRecPtr retryPtr;		/* don't try again before replay gets here */
+
+/* Current WAL page */
+static char *pageBuf = NULL;
+static bool pageValid = false;
+static XLogRecPtr pagePtr;
+
+/* Buffer for assembling records that cross page boundaries */
+static char *recordBuf = NULL;
+static uint32 recordBufSize = 0;
+
+static RecentPrefetch recentPrefetches[RECENT_PREFETCH_SIZE];
+static int	nextRecentPrefetch = 0;
+
+/* Statistics, reported at the end of recovery */
+static uint64 recordsDecoded = 0;
+static uint64 blocksPrefetched = 0;
+
+static XLogRecord *XLogPrefetchDecodeRecord(void);
+static bool XLogPrefetchLoadPage(XLogRecPtr ptr);
+static void XLogPrefetchBlock(RelFileNode rnode, ForkNumber forknum,
+				  BlockNumber blkno, bool needs_read, void *arg);
+
+
+/*
+ * Convert an XLogRecPtr to a linear byte position, for distance arithmetic.
+ */
+static uint64
+XLogRecPtrToBytePos(XLogRecPtr ptr)
+{
+	return (uint64) ptr.xlogid * XLogFileSize + ptr.xrecoff;
+}
+
+/*
+ * XLogPrefetchAhead
+ *
+ * Called by the startup process before replaying each record.  nextRecPtr
+ * is the end of the record about to be replayed, that is where the next
+ * record starts, and lastRecPtr is the start of the record about to be
+ * replayed.
+ */
+void
+XLogPrefetchAhead(XLogRecPtr nextRecPtr, XLogRecPtr lastRecPtr)
+{
+	uint64		limit;
+
+	if (recovery_prefetch_distance <= 0)
+		return;
+
+	/*
+	 * (Re)start decoding at the replay position if we haven't started yet,
+	 * or if replay has overtaken us.
+	 */
+	if (!prefetchActive || XLByteLT(decodePtr, nextRecPtr))
+	{
+		decodePtr = nextRecPtr;
+		decodePrevPtr = lastRecPtr;
+		retryPtr = nextRecPtr;
+		prefetchActive = true;
+	}
+
+	/* If we ran out of WAL last time, wait for replay to make progress */
+	if (XLByteLT(nextRecPtr, retryPtr))
+		return;
+
+	if (pageBuf == NULL)
+	{
+		/* malloc for the same reasons as readBuf in xlog.c */
+		pageBuf = (char *) malloc(XLOG_BLCKSZ);
+		if (pageBuf == NULL)
+			return;
+	}
+
+	limit = XLogRecPtrToBytePos(nextRecPtr) +
+		(uint64) recovery_prefetch_distance * 1024;
+
+	while (XLogRecPtrToBytePos(decodePtr) < limit)
+	{
+		XLogRecord *record = XLogPrefetchDecodeRecord();
+
+		if (record == NULL)
+		{
+			/*
+			 * No more WAL available, or we hit something invalid.  Try again
+			 * once replay has advanced by another page.
+			 */
+			retryPtr = nextRecPtr;
+			retryPtr.xrecoff += XLOG_BLCKSZ;
+			if (retryPtr.xrecoff >= XLogFileSize)
+			{
+				retryPtr.xlogid++;
+				retryPtr.xrecoff -= XLogFileSize;
+			}
+			pageValid = false;
+			break;
+		}
+
+		recordsDecoded++;
+		if (RmgrTable[record->xl_rmid].rm_blockrefs != NULL)
+			RmgrTable[record->xl_rmid].rm_blockrefs(record,
+													XLogPrefetchBlock,
+													NULL);
+	}
+}
+
+/*
+ * XLogPrefetchEnd
+ *
+ * Called at the end of redo, to release resources and report statistics.
+ */
+void
+XLogPrefetchEnd(void)
+{
+	if (recordsDecoded > 0)
+		ereport(DEBUG1,
+				(errmsg("recovery prefetch decoded %lu records ahead of replay and prefetched %lu blocks",
+						(unsigned long) recordsDecoded,
+						(unsigned long) blocksPrefetched)));
+
+	if (pageBuf)
+		free(pageBuf);
+	pageBuf = NULL;
+	pageValid = false;
+	if (recordBuf)
+		free(recordBuf);
+	recordBuf = NULL;
+	recordBufSize = 0;
+	prefetchActive = false;
+}
+
+/*
+ * Callback for rm_blockrefs: prefetch a block, unless redo won't read it or
+ * we've just asked for it.
+ */
+static void
+XLogPrefetchBlock(RelFileNode rnode, ForkNumber forknum, BlockNumber blkno,
+				  bool needs_read, void *arg)
+{
+	int			i;
+
+	if (!needs_read || !BlockNumberIsValid(blkno))
+		return;
+
+	for (i = 0; i < RECENT_PREFETCH_SIZE; i++)
+	{
+		RecentPrefetch *recent = &recentPrefetches[i];
+
+		if (recent->blkno == blkno && recent->forknum == forknum &&
+			RelFileNodeEquals(recent->rnode, rnode))
+			return;
+	}
+
+	recentPrefetches[nextRecentPrefetch].rnode = rnode;
+	recentPrefetches[nextRecentPrefetch].forknum = forknum;
+	recentPrefetches[nextRecentPrefetch].blkno = blkno;
+	nextRecentPrefetch = (nextRecentPrefetch + 1) % RECENT_PREFETCH_SIZE;
+
+	PrefetchBufferWithoutRelcache(rnode, forknum, blkno);
+	blocksPrefetched++;
+}
+
+/*
+ * Make the WAL page containing ptr the current page.  Returns false if it
+ * isn't available or doesn't look like the page we expect.
+ */
+static bool
+XLogPrefetchLoadPage(XLogRecPtr ptr)
+{
+	XLogPageHeader hdr = (XLogPageHeader) pageBuf;
+	XLogRecPtr	pageStart;
+
+	pageStart = ptr;
+	pageStart.xrecoff -= ptr.xrecoff % XLOG_BLCKSZ;
+
+	if (pageValid && XLByteEQ(pageStart, pagePtr))
+		return true;
+
+	pageValid = false;
+	if (!XLogPrefetchReadPage(pageStart, pageBuf))
+		return false;
+
+	/* a recycled segment has pages with a stale address */
+	if (hdr->xlp_magic != XLOG_PAGE_MAGIC ||
+		(hdr->xlp_info & ~XLP_ALL_FLAGS) != 0 ||
+		!XLByteEQ(hdr->xlp_pageaddr, pageStart))
+		return false;
+
+	pagePtr = pageStart;
+	pageValid = true;
+	return true;
+}
+
+/*
+ * Decode the record at decodePtr and advance past it.  This follows
+ * ReadRecord, minus the waiting, the error reporting and the CRC check.
+ * Returns NULL if the record isn't available or doesn't look valid.
+ */
+static XLogRecord *
+XLogPrefetchDecodeRecord(void)
+{
+	XLogRecPtr	recPtr = decodePtr;
+	XLogRecPtr	endPtr;
+	XLogRecord *record;
+	uint32		pageHeaderSize;
+	uint32		targetRecOff;
+	uint32		total_len;
+	uint32		len;
+
+	/* Skip to the next page if no record can fit on this one */
+	if (XLOG_BLCKSZ - (recPtr.xrecoff % XLOG_BLCKSZ) < SizeOfXLogRecord)
+		NextLogPage(recPtr);
+	if (recPtr.xrecoff >= XLogFileSize)
+	{
+		recPtr.xlogid++;
+		recPtr.xrecoff = 0;
+	}
+
+	if (!XLogPrefetchLoadPage(recPtr))
+		return NULL;
+
+	pageHeaderSize = XLogPageHeaderSize((XLogPageHeader) pageBuf);
+	targetRecOff = recPtr.xrecoff % XLOG_BLCKSZ;
+	if (targetRecOff == 0)
+	{
+		recPtr.xrecoff += pageHeaderSize;
+		targetRecOff = pageHeaderSize;
+	}
+	else if (targetRecOff < pageHeaderSize)
+		return NULL;
+	if ((((XLogPageHeader) pageBuf)->xlp_info & XLP_FIRST_IS_CONTRECORD) &&
+		targetRecOff == pageHeaderSize)
+		return NULL;
+
+	record = (XLogRecord *) (pageBuf + targetRecOff);
+
+	/* The same sanity checks as ReadRecord, except for the CRC */
+	if (record->xl_rmid > RM_MAX_ID ||
+		!XLByteEQ(record->xl_prev, decodePrevPtr))
+		return NULL;
+	if (record->xl_rmid == RM_XLOG_ID && record->xl_info == XLOG_SWITCH)
+	{
+		if (record->xl_len != 0)
+			return NULL;
+	}
+	else if (record->xl_len == 0)
+		return NULL;
+	if (record->xl_tot_len < SizeOfXLogRecord + record->xl_len ||
+		record->xl_tot_len > SizeOfXLogRecord + record->xl_len +
+		XLR_MAX_BKP_BLOCKS * (sizeof(BkpBlock) + BLCKSZ))
+		return NULL;
+
+	total_len = record->xl_tot_len;
+	if (total_len > recordBufSize)
+	{
+		uint32		newSize = total_len;
+
+		newSize += XLOG_BLCKSZ - (newSize % XLOG_BLCKSZ);
+		newSize = Max(newSize, 4 * Max(BLCKSZ, XLOG_BLCKSZ));
+		if (recordBuf)
+			free(recordBuf);
+		recordBuf = (char *) malloc(newSize);
+		if (recordBuf == NULL)
+		{
+			recordBufSize = 0;
+			return NULL;
+		}
+		recordBufSize = newSize;
+	}
+
+	len = XLOG_BLCKSZ - targetRecOff;
+	if (total_len > len)
+	{
+		/* Need to reassemble record */
+		XLogContRecord *contrecord;
+		XLogRecPtr	contPagePtr = pagePtr;
+		char	   *buffer = recordBuf;
+		uint32		gotlen = len;
+
+		memcpy(buffer, record, len);
+		buffer += len;
+		for (;;)
+		{
+			contPagePtr.xrecoff += XLOG_BLCKSZ;
+			if (contPagePtr.xrecoff >= XLogFileSize)
+			{
+				contPagePtr.xlogid++;
+				contPagePtr.xrecoff = 0;
+			}
+			if (!XLogPrefetchLoadPage(contPagePtr))
+				return NULL;
+			if (!(((XLogPageHeader) pageBuf)->xlp_info & XLP_FIRST_IS_CONTRECORD))
+				return NULL;
+			pageHeaderSize = XLogPageHeaderSize((XLogPageHeader) pageBuf);
+			contrecord = (XLogContRecord *) (pageBuf + pageHeaderSize);
+			if (contrecord->xl_rem_len == 0 ||
+				total_len != contrecord->xl_rem_len + gotlen)
+				return NULL;
+			len = XLOG_BLCKSZ - pageHeaderSize - SizeOfXLogContRecord;
+			if (contrecord->xl_rem_len > len)
+			{
+				memcpy(buffer, (char *) contrecord + SizeOfXLogContRecord, len);
+				gotlen += len;
+				buffer += len;
+				continue;
+			}
+			memcpy(buffer, (char *) contrecord + SizeOfXLogContRecord,
+				   contrecord->xl_rem_len);
+			break;
+		}
+		endPtr = contPagePtr;
+		endPtr.xrecoff += pageHeaderSize +
+			MAXALIGN(SizeOfXLogContRecord + contrecord->xl_rem_len);
+	}
+	else
+	{
+		memcpy(recordBuf, record, total_len);
+		endPtr = recPtr;
+		endPtr.xrecoff += MAXALIGN(total_len);
+
+		/* An XLOG SWITCH record extends to the end of the segment */
+		if (record->xl_rmid == RM_XLOG_ID && record->xl_info == XLOG_SWITCH)
+		{
+			endPtr.xrecoff += XLogSegSize - 1;
+			endPtr.xrecoff -= endPtr.xrecoff % XLogSegSize;
+		}
+	}
+
+	decodePrevPtr = recPtr;
+	decodePtr = endPtr;
+
+	return (XLogRecord *) recordBuf;
+}
@@ -0,0 +1,378 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogreader.c
+ *		Reading WAL records outside of recovery
+ *
+ * ReadRecord in xlog.c is tied to the startup process: it knows about
+ * archive recovery, streaming, timelines and the global state of replay.
+ * Logical decoding needs to read the WAL of a running server instead, from
+ * wherever its caller gets the pages.  This is a self-contained decoder for
+ * that, following ReadRecord's logic for page headers, records that cross
+ * page boundaries and XLOG SWITCH.  The pages are supplied by a callback,
+ * which may report that a page is not available yet; the caller can then
+ * retry later from the same position.  Record CRCs are checked with
+ * RecordIsValid.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xlog_internal.h"
+#include "access/xlogreader.h"
+#include "catalog/pg_control.h"
+
+
+/* size of the buffer for error messages */
+#define MAX_ERRORMSG_LEN	1000
+
+static bool ReadPageInternal(XLogReaderState *state, XLogRecPtr pageptr,
+				 int reqLen);
+static void report_invalid_record(XLogReaderState *state, const char *fmt,...)
+/* This extension allows gcc to check the format string */
+__attribute__((format(printf, 2, 3)));
+
+
+/*
+ * Allocate and initialize a new xlog reader, in the current memory context.
+ */
+XLogReaderState *
+XLogReaderAllocate(XLogPageReadCB pagereadfunc, void *private_data)
+{
+	XLogReaderState *state;
+
+	state = (XLogReaderState *) palloc0(sizeof(XLogReaderState));
+
+	state->read_page = pagereadfunc;
+	state->private_data = private_data;
+
+	state->readBuf = (char *) palloc(XLOG_BLCKSZ);
+	state->readLen = 0;
+
+	/* enough for all "normal" records, as in ReadRecord */
+	state->readRecordBufSize = 4 * Max(BLCKSZ, XLOG_BLCKSZ);
+	state->readRecordBuf = (char *) palloc(state->readRecordBufSize);
+
+	state->errormsg_buf = (char *) palloc(MAX_ERRORMSG_LEN + 1);
+	state->errormsg_buf[0] = '\0';
+
+	return state;
+}
+
+void
+XLogReaderFree(XLogReaderState *state)
+{
+	pfree(state->errormsg_buf);
+	pfree(state->readRecordBuf);
+	pfree(state->readBuf);
+	pfree(state);
+}
+
+/*
+ * Attempt to read an XLOG record.
+ *
+ * If RecPtr is valid, try to read a record at that position.  It may also
+ * point to the start of a page, or to the end of a page with no room for a
+ * record header, as an insert position can.  Otherwise read the record
+ * just after the last one read.
+ *
+ * Returns the record, which stays valid until the next call.  If the WAL
+ * isn't available yet, returns NULL with *errormsg set to NULL; the
+ * caller can try again later, and the reader's position is unchanged.  If
+ * the WAL is invalid, returns NULL with *errormsg set to a description of
+ * the problem.
+ */
+XLogRecord *
+XLogReadRecord(XLogReaderState *state, XLogRecPtr RecPtr, char **errormsg)
+{
+	XLogRecord *record;
+	XLogRecPtr	pagePtr;
+	XLogRecPtr	endPtr;
+	bool		randAccess = false;
+	uint32		pageHeaderSize;
+	uint32		targetRecOff;
+	uint32		total_len;
+	uint32		len;
+
+	*errormsg = NULL;
+	state->errormsg_buf[0] = '\0';
+
+	if (XLogRecPtrIsInvalid(RecPtr))
+		RecPtr = state->EndRecPtr;
+	else
+		randAccess = true;
+
+	/* Skip to the next page if no record can fit on this one */
+	if (XLOG_BLCKSZ - RecPtr.xrecoff % XLOG_BLCKSZ < SizeOfXLogRecord)
+		NextLogPage(RecPtr);
+	if (RecPtr.xrecoff >= XLogFileSize)
+	{
+		RecPtr.xlogid++;
+		RecPtr.xrecoff = 0;
+	}
+
+	pagePtr = RecPtr;
+	pagePtr.xrecoff -= RecPtr.xrecoff % XLOG_BLCKSZ;
+	targetRecOff = RecPtr.xrecoff % XLOG_BLCKSZ;
+
+	if (!ReadPageInternal(state, pagePtr, 0))
+		goto err;
+
+	pageHeaderSize = XLogPageHeaderSize((XLogPageHeader) state->readBuf);
+	if (targetRecOff == 0)
+	{
+		RecPtr.xrecoff += pageHeaderSize;
+		targetRecOff = pageHeaderSize;
+	}
+	else if (targetRecOff < pageHeaderSize)
+	{
+		report_invalid_record(state, "invalid record offset at %X/%X",
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+	if ((((XLogPageHeader) state->readBuf)->xlp_info & XLP_FIRST_IS_CONTRECORD) &&
+		targetRecOff == pageHeaderSize)
+	{
+		report_invalid_record(state, "contrecord is requested by %X/%X",
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+
+	/* Read as much of the page as the record header needs */
+	if (!ReadPageInternal(state, pagePtr, targetRecOff + SizeOfXLogRecord))
+		goto err;
+
+	record = (XLogRecord *) (state->readBuf + targetRecOff);
+
+	/* The same sanity checks as ReadRecord */
+	if (record->xl_rmid == RM_XLOG_ID && record->xl_info == XLOG_SWITCH)
+	{
+		if (record->xl_len != 0)
+		{
+			report_invalid_record(state, "invalid xlog switch record at %X/%X",
+								  RecPtr.xlogid, RecPtr.xrecoff);
+			goto err;
+		}
+	}
+	else if (record->xl_len == 0)
+	{
+		report_invalid_record(state, "record with zero length at %X/%X",
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+	if (record->xl_tot_len < SizeOfXLogRecord + record->xl_len ||
+		record->xl_tot_len > SizeOfXLogRecord + record->xl_len +
+		XLR_MAX_BKP_BLOCKS * (sizeof(BkpBlock) + BLCKSZ))
+	{
+		report_invalid_record(state, "invalid record length at %X/%X",
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+	if (record->xl_rmid > RM_MAX_ID)
+	{
+		report_invalid_record(state, "invalid resource manager ID %u at %X/%X",
+							  record->xl_rmid, RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+	if (randAccess ? !XLByteLT(record->xl_prev, RecPtr) :
+		!XLByteEQ(record->xl_prev, state->ReadRecPtr))
+	{
+		report_invalid_record(state,
+							  "record with incorrect prev-link %X/%X at %X/%X",
+							  record->xl_prev.xlogid, record->xl_prev.xrecoff,
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+
+	/* Enlarge readRecordBuf as needed, as ReadRecord does */
+	total_len = record->xl_tot_len;
+	if (total_len > state->readRecordBufSize)
+	{
+		uint32		newSize = total_len;
+
+		newSize += XLOG_BLCKSZ - (newSize % XLOG_BLCKSZ);
+		state->readRecordBuf = (char *) repalloc(state->readRecordBuf,
+												 newSize);
+		state->readRecordBufSize = newSize;
+
+		/* the page buffer is intact, but re-fetch the header pointer */
+		record = (XLogRecord *) (state->readBuf + targetRecOff);
+	}
+
+	len = XLOG_BLCKSZ - targetRecOff;
+	if (total_len > len)
+	{
+		/* Need to reassemble record */
+		XLogContRecord *contrecord;
+		char	   *buffer = state->readRecordBuf;
+		uint32		gotlen = len;
+
+		/* the first part must be on this page in full */
+		if (!ReadPageInternal(state, pagePtr, XLOG_BLCKSZ))
+			goto err;
+		memcpy(buffer, state->readBuf + targetRecOff, len);
+		buffer += len;
+
+		for (;;)
+		{
+			uint32		remaining = total_len - gotlen;
+
+			pagePtr.xrecoff += XLOG_BLCKSZ;
+			if (pagePtr.xrecoff >= XLogFileSize)
+			{
+				pagePtr.xlogid++;
+				pagePtr.xrecoff = 0;
+			}
+
+			if (!ReadPageInternal(state, pagePtr, 0))
+				goto err;
+			if (!(((XLogPageHeader) state->readBuf)->xlp_info & XLP_FIRST_IS_CONTRECORD))
+			{
+				report_invalid_record(state,
+									  "there is no contrecord flag at %X/%X",
+									  pagePtr.xlogid, pagePtr.xrecoff);
+				goto err;
+			}
+			pageHeaderSize = XLogPageHeaderSize((XLogPageHeader) state->readBuf);
+			if (!ReadPageInternal(state, pagePtr,
+								  Min(XLOG_BLCKSZ, pageHeaderSize +
+									  SizeOfXLogContRecord + remaining)))
+				goto err;
+
+			contrecord = (XLogContRecord *) (state->readBuf + pageHeaderSize);
+			if (contrecord->xl_rem_len == 0 ||
+				contrecord->xl_rem_len != remaining)
+			{
+				report_invalid_record(state,
+									  "invalid contrecord length %u at %X/%X",
+									  contrecord->xl_rem_len,
+									  pagePtr.xlogid, pagePtr.xrecoff);
+				goto err;
+			}
+			len = XLOG_BLCKSZ - pageHeaderSize - SizeOfXLogContRecord;
+			if (contrecord->xl_rem_len > len)
+			{
+				memcpy(buffer, (char *) contrecord + SizeOfXLogContRecord, len);
+				gotlen += len;
+				buffer += len;
+				continue;
+			}
+			memcpy(buffer, (char *) contrecord + SizeOfXLogContRecord,
+				   contrecord->xl_rem_len);
+			break;
+		}
+		endPtr = pagePtr;
+		endPtr.xrecoff += pageHeaderSize +
+			MAXALIGN(SizeOfXLogContRecord + contrecord->xl_rem_len);
+	}
+	else
+	{
+		if (!ReadPageInternal(state, pagePtr, targetRecOff + total_len))
+			goto err;
+		memcpy(state->readRecordBuf, state->readBuf + targetRecOff, total_len);
+		endPtr = RecPtr;
+		endPtr.xrecoff += MAXALIGN(total_len);
+
+		/* An XLOG SWITCH record extends to the end of the segment */
+		if (record->xl_rmid == RM_XLOG_ID && record->xl_info == XLOG_SWITCH)
+		{
+			endPtr.xrecoff += XLogSegSize - 1;
+			endPtr.xrecoff -= endPtr.xrecoff % XLogSegSize;
+		}
+	}
+
+	record = (XLogRecord *) state->readRecordBuf;
+	if (!RecordIsValid(record, RecPtr, LOG))
+	{
+		report_invalid_record(state, "invalid record at %X/%X",
+							  RecPtr.xlogid, RecPtr.xrecoff);
+		goto err;
+	}
+
+	state->ReadRecPtr = RecPtr;
+	state->EndRecPtr = endPtr;
+
+	return record;
+
+err:
+	if (state->errormsg_buf[0] != '\0')
+		*errormsg = state->errormsg_buf;
+	return NULL;
+}
+
+/*
+ * Make sure at least reqLen bytes of the WAL page at pageptr, and its whole
+ * page header, are in state->readBuf.  Returns false if they're not
+ * available, or if the page header is invalid; in the latter case an error
+ * message is left in state->errormsg_buf.
+ */
+static bool
+ReadPageInternal(XLogReaderState *state, XLogRecPtr pageptr, int reqLen)
+{
+	XLogPageHeader hdr = (XLogPageHeader) state->readBuf;
+	int			readLen;
+
+	/* The first page of each segment has a long header */
+	if (pageptr.xrecoff % XLogSegSize == 0)
+		reqLen = Max(reqLen, SizeOfXLogLongPHD);
+	else
+		reqLen = Max(reqLen, SizeOfXLogShortPHD);
+
+	if (state->readLen >= reqLen && XLByteEQ(pageptr, state->readPagePtr))
+		return true;
+
+	state->readLen = 0;
+	readLen = state->read_page(state, pageptr, reqLen, state->readBuf,
+							   state->private_data);
+	if (readLen < reqLen)
+		return false;
+
+	/* a recycled segment has pages with a stale address */
+	if (hdr->xlp_magic != XLOG_PAGE_MAGIC)
+	{
+		report_invalid_record(state,
+							  "invalid magic number %04X in log page at %X/%X",
+							  hdr->xlp_magic, pageptr.xlogid, pageptr.xrecoff);
+		return false;
+	}
+	if ((hdr->xlp_info & ~XLP_ALL_FLAGS) != 0)
+	{
+		report_invalid_record(state,
+							  "invalid info bits %04X in log page at %X/%X",
+							  hdr->xlp_info, pageptr.xlogid, pageptr.xrecoff);
+		return false;
+	}
+	if (!XLByteEQ(hdr->xlp_pageaddr, pageptr))
+	{
+		report_invalid_record(state,
+							  "unexpected pageaddr %X/%X in log page at %X/%X",
+							  hdr->xlp_pageaddr.xlogid,
+							  hdr->xlp_pageaddr.xrecoff,
+							  pageptr.xlogid, pageptr.xrecoff);
+		return false;
+	}
+
+	state->readPagePtr = pageptr;
+	state->readLen = readLen;
+	return true;
+}
+
+/*
+ * Construct a string in state->errormsg_buf explaining what's wrong with
+ * the current record being read.
+ */
+static void
+report_invalid_record(XLogReaderState *state, const char *fmt,...)
+{
+	va_list		args;
+
+	fmt = _(fmt);
+
+	va_start(args, fmt);
+	vsnprintf(state->errormsg_buf, MAX_ERRORMSG_LEN, fmt, args);
+	va_end(args);
+}
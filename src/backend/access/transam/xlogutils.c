@@ -18,7 +18,9 @@
 #include "postgres.h"
 
 #include "access/xlogutils.h"
+#include "bootstrap/bootstrap.h"
 #include "catalog/catalog.h"
+#include "postmaster/redoworker.h"
 #include "storage/bufmgr.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
@@ -61,6 +63,16 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	xl_invalid_page *hentry;
 	bool		found;
 
+	/*
+	 * Drops and truncations are replayed by the startup process, so a redo
+	 * worker leaves it to the startup process to keep track of the page.
+	 */
+	if (AmRedoWorkerProcess())
+	{
+		RedoWorkerReportInvalidPage(node, forkno, blkno, present);
+		return;
+	}
+
 	/*
 	 * Log references to invalid pages at DEBUG1 level.  This allows some
 	 * tracing of the cause (note the elog context mechanism will tell us
@@ -113,6 +125,16 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	}
 }
 
+/*
+ * Remember a reference to an invalid page that a redo worker came across
+ */
+void
+XLogRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+						BlockNumber blkno, bool present)
+{
+	log_invalid_page(node, forkno, blkno, present);
+}
+
 /* Forget any invalid pages >= minblkno, because they've been dropped */
 static void
 forget_invalid_pages(RelFileNode node, ForkNumber forkno, BlockNumber minblkno)
@@ -307,7 +329,17 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 		/* OK to extend the file */
 		/* we do this in recovery only - no rel-extension lock needed */
 		Assert(InRecovery);
+
+		/*
+		 * But redo workers can extend the same relation concurrently, so
+		 * they take turns, and look at the size again once it's their turn.
+		 */
+		LWLockAcquire(RedoExtensionLock, LW_EXCLUSIVE);
+		lastblock = smgrnblocks(smgr, forknum);
 		buffer = InvalidBuffer;
+		if (blkno < lastblock)
+			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
+											   mode, NULL);
 		while (blkno >= lastblock)
 		{
 			if (buffer != InvalidBuffer)
@@ -316,6 +348,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 											   P_NEW, mode, NULL);
 			lastblock++;
 		}
+		LWLockRelease(RedoExtensionLock);
 		Assert(BufferGetBlockNumber(buffer) == blkno);
 	}
 
@@ -31,6 +31,7 @@
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/redoworker.h"
 #include "postmaster/walwriter.h"
 #include "replication/walreceiver.h"
 #include "storage/bufmgr.h"
@@ -64,6 +65,8 @@ static void cleanup(void);
  * ----------------
  */
 
+AuxProcType MyAuxProcType = NotAnAuxProcess;	/* declared in bootstrap.h */
+
 Relation	boot_reldesc;		/* current relation descriptor */
 
 Form_pg_attribute attrtypes[MAXATTR];	/* points to attribute info */
@@ -178,7 +181,8 @@ static IndexList *ILHead = NULL;
  *	 AuxiliaryProcessMain
  *
  *	 The main entry point for auxiliary processes, such as the bgwriter,
- *	 walwriter, walreceiver, bootstrapper and the shared memory checker code.
+ *	 checkpointer, walwriter, walreceiver, redo workers, bootstrapper and
+ *	 the shared memory checker code.
  *
  *	 This code is here just because of historical reasons.
  */
@@ -301,6 +305,12 @@ AuxiliaryProcessMain(int argc, char *argv[])
 		proc_exit(1);
 	}
 
+	/*
+	 * Remember which kind of auxiliary process we are.  This must be set
+	 * before BaseInit, because mdinit looks at it.
+	 */
+	MyAuxProcType = auxType;
+
 	/*
 	 * Identify myself via ps
 	 */
@@ -316,12 +326,18 @@ AuxiliaryProcessMain(int argc, char *argv[])
 			case BgWriterProcess:
 				statmsg = "writer process";
 				break;
+			case CheckpointerProcess:
+				statmsg = "checkpointer process";
+				break;
 			case WalWriterProcess:
 				statmsg = "wal writer process";
 				break;
 			case WalReceiverProcess:
 				statmsg = "wal receiver process";
 				break;
+			case RedoWorkerProcess:
+				statmsg = "redo worker process";
+				break;
 			default:
 				statmsg = "??? process";
 				break;
@@ -381,9 +397,12 @@ AuxiliaryProcessMain(int argc, char *argv[])
 		 * auxiliary process.
 		 *
 		 * This will need rethinking if we ever want more than one of a
-		 * particular auxiliary process type.
+		 * particular auxiliary process type that needs to be signalled.  Redo
+		 * workers, of which there can be many, get no slot; nobody sends
+		 * them procsignals.
 		 */
-		ProcSignalInit(MaxBackends + auxType + 1);
+		if (auxType != RedoWorkerProcess)
+			ProcSignalInit(MaxBackends + auxType + 1);
 
 		/* finish setting up bufmgr.c */
 		InitBufferPoolBackend();
@@ -420,6 +439,11 @@ AuxiliaryProcessMain(int argc, char *argv[])
 			BackgroundWriterMain();
 			proc_exit(1);		/* should never return */
 
+		case CheckpointerProcess:
+			/* don't set signals, checkpointer has its own agenda */
+			CheckpointerMain();
+			proc_exit(1);		/* should never return */
+
 		case WalWriterProcess:
 			/* don't set signals, walwriter has its own agenda */
 			InitXLOGAccess();
@@ -431,6 +455,11 @@ AuxiliaryProcessMain(int argc, char *argv[])
 			WalReceiverMain();
 			proc_exit(1);		/* should never return */
 
+		case RedoWorkerProcess:
+			/* don't set signals, redo workers have their own agenda */
+			RedoWorkerMain();
+			proc_exit(1);		/* should never return */
+
 		default:
 			elog(PANIC, "unrecognized process type: %d", auxType);
 			proc_exit(1);
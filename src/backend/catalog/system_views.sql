@@ -157,6 +157,13 @@ CREATE VIEW pg_prepared_xacts AS
          LEFT JOIN pg_authid U ON P.ownerid = U.oid
          LEFT JOIN pg_database D ON P.dbid = D.oid;
 
+CREATE VIEW pg_replication_slots AS
+    SELECT L.slot_name, L.plugin, L.slot_type, L.datoid,
+           D.datname AS database, L.active, L.xmin, L.catalog_xmin,
+           L.restart_lsn, L.confirmed_flush_lsn, L.restart_lag
+    FROM pg_get_replication_slots() AS L
+         LEFT JOIN pg_database D ON L.datoid = D.oid;
+
 CREATE VIEW pg_prepared_statements AS
     SELECT * FROM pg_prepared_statement() AS P;
 
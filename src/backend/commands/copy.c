@@ -33,16 +33,20 @@
 #include "libpq/pqformat.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/clauses.h"
 #include "optimizer/planner.h"
 #include "parser/parse_relation.h"
+#include "postmaster/copyworker.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/fd.h"
 #include "tcop/tcopprot.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
 
 
 #define ISOCTAL(c) (((c) >= '0') && ((c) <= '7'))
@@ -118,12 +122,14 @@ typedef struct CopyStateData
 	char	   *escape;			/* CSV escape char (must be 1 byte) */
 	bool	   *force_quote_flags;		/* per-column CSV FQ flags */
 	bool	   *force_notnull_flags;	/* per-column CSV FNN flags */
+	int			parallel_workers;	/* number of workers to ask for */
 
 	/* these are just for error messages, see copy_in_error_callback */
 	const char *cur_relname;	/* table name for error messages */
 	int			cur_lineno;		/* line number for error messages */
 	const char *cur_attname;	/* current att for error messages */
 	const char *cur_attval;		/* current att value for error messages */
+	bool		from_worker;	/* talking to a copy worker? */
 
 	/*
 	 * Working state for COPY TO
@@ -150,6 +156,7 @@ typedef struct CopyStateData
 	 */
 	StringInfoData line_buf;
 	bool		line_buf_converted;		/* converted to server encoding? */
+	bool		line_buf_valid; /* contains the row being processed? */
 
 	/*
 	 * Finally, raw_buf holds raw data read from the data source (file or
@@ -166,6 +173,37 @@ typedef struct CopyStateData
 
 typedef CopyStateData *CopyState;
 
+/* State of a parallel COPY FROM in the leader, see CopyFromParallelNext */
+typedef struct CopyParallelState
+{
+	int			nworkers;		/* number of copy workers */
+
+	/* for parsing lines that are too long for the workers */
+	TupleDesc	tupDesc;
+	FmgrInfo   *in_functions;
+	Oid		   *typioparams;
+	int			nfields;
+	char	  **field_strings;
+
+	int			read_lineno;	/* number of lines read so far */
+	bool		eof;			/* reached the end of the input? */
+	StringInfoData chunk;		/* chunk to send to the next worker */
+	int			chunk_lines;	/* number of lines in it */
+	bool		chunk_ready;	/* filled and waiting to be sent? */
+	StringInfoData held_line;	/* line that didn't fit in the last chunk */
+	bool		have_held_line;
+
+	/*
+	 * Chunks are numbered in the order they're sent; chunk n goes to worker
+	 * n % nworkers.  pending_lines has the number of rows still to be
+	 * collected for each chunk between next_recv and next_send.
+	 */
+	int64		next_send;
+	int64		next_recv;
+	int		   *pending_lines;
+	int			max_pending;
+} CopyParallelState;
+
 /* DestReceiver for COPY (SELECT) TO */
 typedef struct
 {
@@ -241,6 +279,13 @@ if (1) \
 
 static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
 
+/*
+ * CopyFrom collects up to this many rows, or rows totalling this many bytes,
+ * before passing them to heap_multi_insert.
+ */
+#define MAX_BUFFERED_TUPLES		1000
+#define MAX_BUFFERED_BYTES		65535
+
 
 /* non-export function prototypes */
 static void DoCopyTo(CopyState cstate);
@@ -248,6 +293,27 @@ static void CopyTo(CopyState cstate);
 static void CopyOneRowTo(CopyState cstate, Oid tupleOid,
 			 Datum *values, bool *nulls);
 static void CopyFrom(CopyState cstate);
+static Oid CopyFromParseLine(CopyState cstate, Form_pg_attribute *attr,
+				  FmgrInfo *in_functions, Oid *typioparams,
+				  bool file_has_oids, int nfields, char **field_strings,
+				  Datum *values, bool *nulls);
+static void CopyFromInsertBatch(CopyState cstate, EState *estate,
+					CommandId mycid, int hi_options,
+					ResultRelInfo *resultRelInfo, TupleTableSlot *myslot,
+					BulkInsertState bistate,
+					int nBufferedTuples, HeapTuple *bufferedTuples,
+					int firstBufferedLineNo);
+static CopyParallelState *CopyFromParallelBegin(CopyState cstate,
+					  TupleDesc tupDesc, FmgrInfo *in_functions,
+					  Oid *typioparams, int nfields, char **field_strings);
+static bool CopyFromParallelNext(CopyState cstate, CopyParallelState *pstate,
+					 Datum *values, bool *nulls);
+static void CopyFromParallelEnd(CopyParallelState *pstate);
+static void CopyParallelFillChunk(CopyState cstate,
+					  CopyParallelState *pstate);
+static bool CopyWorkersCanInput(Oid typid);
+static void CopySendSetupString(StringInfo buf, const char *str);
+static char *CopyGetSetupString(StringInfo msg);
 static bool CopyReadLine(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
 static int CopyReadAttributesText(CopyState cstate, int maxfields,
@@ -838,6 +904,22 @@ DoCopy(const CopyStmt *stmt, const char *queryString)
 						 errmsg("argument to option \"%s\" must be a list of column names",
 								defel->defname)));
 		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			int64		nworkers;
+
+			if (cstate->parallel_workers > 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options")));
+			nworkers = defGetInt64(defel);
+			if (nworkers < 1 || nworkers > INT_MAX)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("argument to option \"%s\" must be a positive integer",
+								defel->defname)));
+			cstate->parallel_workers = (int) nworkers;
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -964,6 +1046,12 @@ DoCopy(const CopyStmt *stmt, const char *queryString)
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 			  errmsg("COPY force not null only available using COPY FROM")));
 
+	/* Check parallel */
+	if (cstate->parallel_workers > 0 && !is_from)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY parallel only available using COPY FROM")));
+
 	/* Don't allow the delimiter to appear in the null string. */
 	if (strchr(cstate->null_print, cstate->delim[0]) != NULL)
 		ereport(ERROR,
@@ -1161,6 +1249,7 @@ DoCopy(const CopyStmt *stmt, const char *queryString)
 	initStringInfo(&cstate->attribute_buf);
 	initStringInfo(&cstate->line_buf);
 	cstate->line_buf_converted = false;
+	cstate->line_buf_valid = false;
 	cstate->raw_buf = (char *) palloc(RAW_BUF_SIZE + 1);
 	cstate->raw_buf_index = cstate->raw_buf_len = 0;
 	cstate->processed = 0;
@@ -1562,6 +1651,10 @@ copy_in_error_callback(void *arg)
 {
 	CopyState	cstate = (CopyState) arg;
 
+	/* errors passed on from a copy worker carry the worker's context */
+	if (cstate->from_worker)
+		return;
+
 	if (cstate->binary)
 	{
 		/* can't usefully display the data */
@@ -1596,7 +1689,8 @@ copy_in_error_callback(void *arg)
 		else
 		{
 			/* error is relevant to a particular line */
-			if (cstate->line_buf_converted || !cstate->need_transcoding)
+			if (cstate->line_buf_valid &&
+				(cstate->line_buf_converted || !cstate->need_transcoding))
 			{
 				char	   *lineval;
 
@@ -1613,7 +1707,9 @@ copy_in_error_callback(void *arg)
 				 * failure to do encoding conversion (ie, bad data).  We dare
 				 * not try to convert it, and at present there's no way to
 				 * regurgitate it without conversion.  So we have to punt and
-				 * just report the line number.
+				 * just report the line number.  We also get here when the
+				 * error is about a row inserted from the batch buffer, after
+				 * line_buf has moved on to later lines.
 				 */
 				errcontext("COPY %s, line %d",
 						   cstate->cur_relname, cstate->cur_lineno);
@@ -1695,6 +1791,13 @@ CopyFrom(CopyState cstate)
 	CommandId	mycid = GetCurrentCommandId(true);
 	int			hi_options = 0; /* start with default heap_insert options */
 	BulkInsertState bistate;
+	bool		useHeapMultiInsert;
+	bool		volatile_defexprs = false;
+	int			nBufferedTuples = 0;
+	Size		bufferedTuplesSize = 0;
+	HeapTuple  *bufferedTuples = NULL;
+	int			firstBufferedLineNo = 0;
+	CopyParallelState *pstate = NULL;
 
 	Assert(cstate->rel);
 
@@ -1849,6 +1952,10 @@ CopyFrom(CopyState cstate)
 
 			if (defexpr != NULL)
 			{
+				/* Check whether the default could look at the table */
+				if (contain_volatile_functions_not_nextval(defexpr))
+					volatile_defexprs = true;
+
 				defexprs[num_defaults] = ExecPrepareExpr((Expr *) defexpr,
 														 estate);
 				defmap[num_defaults] = attnum - 1;
@@ -1868,6 +1975,25 @@ CopyFrom(CopyState cstate)
 	 */
 	ExecBSInsertTriggers(estate, resultRelInfo);
 
+	/*
+	 * It's more efficient to prepare a bunch of tuples for insertion, and
+	 * insert them in one heap_multi_insert() call, than call heap_insert()
+	 * separately for every tuple.  However, we can't do that if there are
+	 * BEFORE ROW triggers, or we need to evaluate volatile default
+	 * expressions.  Such triggers or expressions might query the table we're
+	 * inserting to, and act differently if the tuples that have already been
+	 * processed and prepared for insertion are not there.
+	 */
+	if ((resultRelInfo->ri_TrigDesc &&
+		 resultRelInfo->ri_TrigDesc->n_before_row[TRIGGER_EVENT_INSERT] > 0) ||
+		volatile_defexprs)
+		useHeapMultiInsert = false;
+	else
+	{
+		useHeapMultiInsert = true;
+		bufferedTuples = palloc(MAX_BUFFERED_TUPLES * sizeof(HeapTuple));
+	}
+
 	if (!cstate->binary)
 		file_has_oids = cstate->oids;	/* must rely on user to tell us... */
 	else
@@ -1946,6 +2072,12 @@ CopyFrom(CopyState cstate)
 		done = CopyReadLine(cstate);
 	}
 
+	/* Let copy workers parse the input, if requested and possible */
+	if (cstate->parallel_workers > 0 && !cstate->binary && !file_has_oids &&
+		!done)
+		pstate = CopyFromParallelBegin(cstate, tupDesc, in_functions,
+									   typioparams, nfields, field_strings);
+
 	while (!done)
 	{
 		bool		skip_tuple;
@@ -1955,8 +2087,12 @@ CopyFrom(CopyState cstate)
 
 		cstate->cur_lineno++;
 
-		/* Reset the per-tuple exprcontext */
-		ResetPerTupleExprContext(estate);
+		/*
+		 * Reset the per-tuple exprcontext.  We can only do this if the tuple
+		 * buffer is empty, since the buffered tuples live in it.
+		 */
+		if (nBufferedTuples == 0)
+			ResetPerTupleExprContext(estate);
 
 		/* Switch into its memory context */
 		MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
@@ -1965,13 +2101,17 @@ CopyFrom(CopyState cstate)
 		MemSet(values, 0, num_phys_attrs * sizeof(Datum));
 		MemSet(nulls, true, num_phys_attrs * sizeof(bool));
 
-		if (!cstate->binary)
+		if (pstate != NULL)
+		{
+			/* Get the next row from the workers */
+			if (!CopyFromParallelNext(cstate, pstate, values, nulls))
+			{
+				done = true;
+				break;
+			}
+		}
+		else if (!cstate->binary)
 		{
-			ListCell   *cur;
-			int			fldct;
-			int			fieldno;
-			char	   *string;
-
 			/* Actually read the line into memory here */
 			done = CopyReadLine(cstate);
 
@@ -1983,74 +2123,10 @@ CopyFrom(CopyState cstate)
 			if (done && cstate->line_buf.len == 0)
 				break;
 
-			/* Parse the line into de-escaped field values */
-			if (cstate->csv_mode)
-				fldct = CopyReadAttributesCSV(cstate, nfields, field_strings);
-			else
-				fldct = CopyReadAttributesText(cstate, nfields, field_strings);
-			fieldno = 0;
-
-			/* Read the OID field if present */
-			if (file_has_oids)
-			{
-				if (fieldno >= fldct)
-					ereport(ERROR,
-							(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
-							 errmsg("missing data for OID column")));
-				string = field_strings[fieldno++];
-
-				if (string == NULL)
-					ereport(ERROR,
-							(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
-							 errmsg("null OID in COPY data")));
-				else
-				{
-					cstate->cur_attname = "oid";
-					cstate->cur_attval = string;
-					loaded_oid = DatumGetObjectId(DirectFunctionCall1(oidin,
-												   CStringGetDatum(string)));
-					if (loaded_oid == InvalidOid)
-						ereport(ERROR,
-								(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
-								 errmsg("invalid OID in COPY data")));
-					cstate->cur_attname = NULL;
-					cstate->cur_attval = NULL;
-				}
-			}
-
-			/* Loop to read the user attributes on the line. */
-			foreach(cur, cstate->attnumlist)
-			{
-				int			attnum = lfirst_int(cur);
-				int			m = attnum - 1;
-
-				if (fieldno >= fldct)
-					ereport(ERROR,
-							(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
-							 errmsg("missing data for column \"%s\"",
-									NameStr(attr[m]->attname))));
-				string = field_strings[fieldno++];
-
-				if (cstate->csv_mode && string == NULL &&
-					cstate->force_notnull_flags[m])
-				{
-					/* Go ahead and read the NULL string */
-					string = cstate->null_print;
-				}
-
-				cstate->cur_attname = NameStr(attr[m]->attname);
-				cstate->cur_attval = string;
-				values[m] = InputFunctionCall(&in_functions[m],
-											  string,
-											  typioparams[m],
-											  attr[m]->atttypmod);
-				if (string != NULL)
-					nulls[m] = false;
-				cstate->cur_attname = NULL;
-				cstate->cur_attval = NULL;
-			}
-
-			Assert(fieldno == nfields);
+			loaded_oid = CopyFromParseLine(cstate, attr, in_functions,
+										   typioparams, file_has_oids,
+										   nfields, field_strings,
+										   values, nulls);
 		}
 		else
 		{
@@ -2172,8 +2248,6 @@ CopyFrom(CopyState cstate)
 
 		if (!skip_tuple)
 		{
-			List	   *recheckIndexes = NIL;
-
 			/* Place tuple in tuple slot */
 			ExecStoreTuple(tuple, slot, InvalidBuffer, false);
 
@@ -2181,18 +2255,49 @@ CopyFrom(CopyState cstate)
 			if (cstate->rel->rd_att->constr)
 				ExecConstraints(resultRelInfo, slot, estate);
 
-			/* OK, store the tuple and create index entries for it */
-			heap_insert(cstate->rel, tuple, mycid, hi_options, bistate);
+			if (useHeapMultiInsert)
+			{
+				/* Add this tuple to the tuple buffer */
+				if (nBufferedTuples == 0)
+					firstBufferedLineNo = cstate->cur_lineno;
+				bufferedTuples[nBufferedTuples++] = tuple;
+				bufferedTuplesSize += tuple->t_len;
 
-			if (resultRelInfo->ri_NumIndices > 0)
-				recheckIndexes = ExecInsertIndexTuples(slot, &(tuple->t_self),
-													   estate);
+				/*
+				 * If the buffer filled up, flush it.  Also flush if the total
+				 * size of all the tuples in the buffer becomes large, to
+				 * avoid using large amounts of memory for the buffers when
+				 * the tuples are exceptionally wide.
+				 */
+				if (nBufferedTuples == MAX_BUFFERED_TUPLES ||
+					bufferedTuplesSize > MAX_BUFFERED_BYTES)
+				{
+					CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+										resultRelInfo, slot, bistate,
+										nBufferedTuples, bufferedTuples,
+										firstBufferedLineNo);
+					nBufferedTuples = 0;
+					bufferedTuplesSize = 0;
+				}
+			}
+			else
+			{
+				List	   *recheckIndexes = NIL;
+
+				/* OK, store the tuple and create index entries for it */
+				heap_insert(cstate->rel, tuple, mycid, hi_options, bistate);
 
-			/* AFTER ROW INSERT Triggers */
-			ExecARInsertTriggers(estate, resultRelInfo, tuple,
-								 recheckIndexes);
+				if (resultRelInfo->ri_NumIndices > 0)
+					recheckIndexes = ExecInsertIndexTuples(slot,
+														&(tuple->t_self),
+														   estate);
 
-			list_free(recheckIndexes);
+				/* AFTER ROW INSERT Triggers */
+				ExecARInsertTriggers(estate, resultRelInfo, tuple,
+									 recheckIndexes);
+
+				list_free(recheckIndexes);
+			}
 
 			/*
 			 * We count only tuples not suppressed by a BEFORE INSERT trigger;
@@ -2203,6 +2308,16 @@ CopyFrom(CopyState cstate)
 		}
 	}
 
+	/* Flush any remaining buffered tuples */
+	if (nBufferedTuples > 0)
+		CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+							resultRelInfo, slot, bistate,
+							nBufferedTuples, bufferedTuples,
+							firstBufferedLineNo);
+
+	if (pstate != NULL)
+		CopyFromParallelEnd(pstate);
+
 	/* Done, clean up */
 	error_context_stack = errcontext.previous;
 
@@ -2248,6 +2363,697 @@ CopyFrom(CopyState cstate)
 		heap_sync(cstate->rel);
 }
 
+/*
+ * Split the text-format line in line_buf into fields, and run the input
+ * functions on them to fill in values and nulls for the columns being
+ * copied.  Returns the OID given on the line, if file_has_oids.
+ *
+ * This is also used by the copy worker processes of a parallel COPY, see
+ * CopyFromWorker.
+ */
+static Oid
+CopyFromParseLine(CopyState cstate, Form_pg_attribute *attr,
+				  FmgrInfo *in_functions, Oid *typioparams,
+				  bool file_has_oids, int nfields, char **field_strings,
+				  Datum *values, bool *nulls)
+{
+	Oid			loaded_oid = InvalidOid;
+	ListCell   *cur;
+	int			fldct;
+	int			fieldno;
+	char	   *string;
+
+	/* Parse the line into de-escaped field values */
+	if (cstate->csv_mode)
+		fldct = CopyReadAttributesCSV(cstate, nfields, field_strings);
+	else
+		fldct = CopyReadAttributesText(cstate, nfields, field_strings);
+	fieldno = 0;
+
+	/* Read the OID field if present */
+	if (file_has_oids)
+	{
+		if (fieldno >= fldct)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("missing data for OID column")));
+		string = field_strings[fieldno++];
+
+		if (string == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("null OID in COPY data")));
+		else
+		{
+			cstate->cur_attname = "oid";
+			cstate->cur_attval = string;
+			loaded_oid = DatumGetObjectId(DirectFunctionCall1(oidin,
+										   CStringGetDatum(string)));
+			if (loaded_oid == InvalidOid)
+				ereport(ERROR,
+						(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+						 errmsg("invalid OID in COPY data")));
+			cstate->cur_attname = NULL;
+			cstate->cur_attval = NULL;
+		}
+	}
+
+	/* Loop to read the user attributes on the line. */
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+		int			m = attnum - 1;
+
+		if (fieldno >= fldct)
+			ereport(ERROR,
+					(errcode(ERRCODE_BAD_COPY_FILE_FORMAT),
+					 errmsg("missing data for column \"%s\"",
+							NameStr(attr[m]->attname))));
+		string = field_strings[fieldno++];
+
+		if (cstate->csv_mode && string == NULL &&
+			cstate->force_notnull_flags[m])
+		{
+			/* Go ahead and read the NULL string */
+			string = cstate->null_print;
+		}
+
+		cstate->cur_attname = NameStr(attr[m]->attname);
+		cstate->cur_attval = string;
+		values[m] = InputFunctionCall(&in_functions[m],
+									  string,
+									  typioparams[m],
+									  attr[m]->atttypmod);
+		if (string != NULL)
+			nulls[m] = false;
+		cstate->cur_attname = NULL;
+		cstate->cur_attval = NULL;
+	}
+
+	Assert(fieldno == nfields);
+
+	return loaded_oid;
+}
+
+/*
+ * A subroutine of CopyFrom, to write the current batch of buffered heap
+ * tuples to the heap.  Also updates indexes and runs AFTER ROW INSERT
+ * triggers.
+ */
+static void
+CopyFromInsertBatch(CopyState cstate, EState *estate, CommandId mycid,
+					int hi_options, ResultRelInfo *resultRelInfo,
+					TupleTableSlot *myslot, BulkInsertState bistate,
+					int nBufferedTuples, HeapTuple *bufferedTuples,
+					int firstBufferedLineNo)
+{
+	MemoryContext oldcontext;
+	int			i;
+	int			save_cur_lineno;
+
+	/*
+	 * Print error context information correctly, if one of the operations
+	 * below fail.
+	 */
+	cstate->line_buf_valid = false;
+	save_cur_lineno = cstate->cur_lineno;
+
+	/*
+	 * heap_multi_insert leaks memory, so switch to short-lived memory context
+	 * before calling it.
+	 */
+	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
+	heap_multi_insert(cstate->rel,
+					  bufferedTuples,
+					  nBufferedTuples,
+					  mycid,
+					  hi_options,
+					  bistate);
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Update the indexes for all the inserted tuples, and run AFTER ROW
+	 * INSERT triggers.
+	 */
+	for (i = 0; i < nBufferedTuples; i++)
+	{
+		List	   *recheckIndexes = NIL;
+
+		cstate->cur_lineno = firstBufferedLineNo + i;
+		if (resultRelInfo->ri_NumIndices > 0)
+		{
+			ExecStoreTuple(bufferedTuples[i], myslot, InvalidBuffer, false);
+			recheckIndexes =
+				ExecInsertIndexTuples(myslot, &(bufferedTuples[i]->t_self),
+									  estate);
+		}
+		ExecARInsertTriggers(estate, resultRelInfo,
+							 bufferedTuples[i],
+							 recheckIndexes);
+		list_free(recheckIndexes);
+	}
+
+	/* reset cur_lineno to where we were */
+	cstate->cur_lineno = save_cur_lineno;
+}
+
+
+/*
+ * Parallel COPY FROM
+ *
+ * With the PARALLEL option, the per-field work of a text or CSV COPY FROM,
+ * which is usually what limits its speed, is done by copy worker processes
+ * (see postmaster/copyworker.c).  We still read the input and split it into
+ * lines here, using the same CopyReadLine as a serial COPY, so quoting and
+ * the end-of-data marker are handled exactly as before, and the lines are
+ * already converted to the server encoding when they are handed out.  The
+ * lines are collected into chunks, which are sent to the workers in turn.
+ * A worker splits each line into fields, runs the input functions, and
+ * sends back the row as a MinimalTuple.  We collect the rows from the
+ * workers in the same order as the chunks were sent, so rows are inserted
+ * in input order, and fill in defaults, check constraints and insert them
+ * as usual.
+ *
+ * The inserting has to stay here, because only this backend's transaction
+ * can see and lock the target table the way the COPY command expects.  For
+ * the same reason, the workers never open the table: we send them its tuple
+ * descriptor.  A worker runs input functions as our user with our datestyle
+ * and similar settings, but in its own transaction and snapshot, so we don't
+ * use workers if a column's type could see different catalog contents there
+ * than here: if the type or its input function has been created in our
+ * transaction, if it is a domain whose constraints could look at arbitrary
+ * data, a composite type whose row type may have been altered, or one of
+ * the reg* types, which look up names in the catalogs and would also see
+ * the worker's own pg_temp schema.  Arrays are judged by their element type.
+ *
+ * A line that doesn't fit in the queue to the workers is parsed here, after
+ * all the chunks before it have been collected.
+ *
+ * Chunk format: int32 line count, int32 line number of the first line, and
+ * for each line, int32 length followed by the line.  Row format: int32
+ * length followed by the MinimalTuple.
+ */
+
+/* chunks are sent when they reach this size */
+#define COPY_CHUNK_SIZE			(COPY_WORKER_QUEUE_SIZE / 4)
+
+/* workers send their rows in batches of about this size */
+#define COPY_WORKER_FLUSH_SIZE	8192
+
+/* session settings that can affect the input functions */
+static const char *const copy_worker_settings[] = {
+	"DateStyle",
+	"IntervalStyle",
+	"TimeZone",
+	"search_path",
+	"lc_monetary",
+	"array_nulls",
+	"xmloption"
+};
+
+/*
+ * Check whether copy workers can run the input function for the given type.
+ */
+static bool
+CopyWorkersCanInput(Oid typid)
+{
+	HeapTuple	tup;
+	Form_pg_type typform;
+	Oid			typinput;
+	Oid			typelem;
+	bool		result;
+
+	switch (typid)
+	{
+		case REGPROCOID:
+		case REGPROCEDUREOID:
+		case REGOPEROID:
+		case REGOPERATOROID:
+		case REGCLASSOID:
+		case REGTYPEOID:
+		case REGCONFIGOID:
+		case REGDICTIONARYOID:
+			return false;
+		default:
+			break;
+	}
+
+	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for type %u", typid);
+	typform = (Form_pg_type) GETSTRUCT(tup);
+	result = (typform->typtype != TYPTYPE_DOMAIN &&
+			  typform->typtype != TYPTYPE_COMPOSITE &&
+		!TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tup->t_data)));
+	typinput = typform->typinput;
+	/* only true arrays have typlen -1 and a typelem */
+	typelem = (typform->typlen == -1) ? typform->typelem : InvalidOid;
+	ReleaseSysCache(tup);
+
+	if (result && OidIsValid(typelem))
+		result = CopyWorkersCanInput(typelem);
+
+	if (result)
+	{
+		tup = SearchSysCache1(PROCOID, ObjectIdGetDatum(typinput));
+		if (!HeapTupleIsValid(tup))
+			elog(ERROR, "cache lookup failed for function %u", typinput);
+		result = !TransactionIdIsCurrentTransactionId(HeapTupleHeaderGetXmin(tup->t_data));
+		ReleaseSysCache(tup);
+	}
+
+	return result;
+}
+
+/*
+ * Start copy workers for a COPY FROM, and send them what they need to know.
+ * Returns NULL if no workers can be used; the caller falls back to parsing
+ * the input itself.
+ */
+static CopyParallelState *
+CopyFromParallelBegin(CopyState cstate, TupleDesc tupDesc,
+					  FmgrInfo *in_functions, Oid *typioparams,
+					  int nfields, char **field_strings)
+{
+	CopyParallelState *pstate;
+	StringInfoData buf;
+	ListCell   *cur;
+	int			nworkers;
+	int			i;
+
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+
+		if (!CopyWorkersCanInput(tupDesc->attrs[attnum - 1]->atttypid))
+			return NULL;
+	}
+
+	nworkers = CopyWorkersLaunch(Min(cstate->parallel_workers,
+									 max_copy_workers));
+	if (nworkers == 0)
+		return NULL;
+
+	/* Build the setup message, see CopyFromWorker */
+	initStringInfo(&buf);
+	pq_sendint(&buf, 0, 4);		/* length, filled in below */
+	pq_sendint(&buf, tupDesc->natts, 4);
+	for (i = 0; i < tupDesc->natts; i++)
+		pq_sendbytes(&buf, (char *) tupDesc->attrs[i],
+					 ATTRIBUTE_FIXED_PART_SIZE);
+	pq_sendint(&buf, list_length(cstate->attnumlist), 4);
+	foreach(cur, cstate->attnumlist)
+		pq_sendint(&buf, lfirst_int(cur), 4);
+	for (i = 0; i < tupDesc->natts; i++)
+		pq_sendbyte(&buf, cstate->force_notnull_flags[i]);
+	pq_sendbyte(&buf, cstate->csv_mode);
+	CopySendSetupString(&buf, cstate->delim);
+	CopySendSetupString(&buf, cstate->csv_mode ? cstate->quote : "");
+	CopySendSetupString(&buf, cstate->csv_mode ? cstate->escape : "");
+	CopySendSetupString(&buf, cstate->null_print);
+	CopySendSetupString(&buf, cstate->cur_relname);
+	for (i = 0; i < lengthof(copy_worker_settings); i++)
+		CopySendSetupString(&buf,
+						GetConfigOption(copy_worker_settings[i], false));
+	*((int32 *) buf.data) = buf.len - sizeof(int32);
+
+	cstate->from_worker = true;
+	for (i = 0; i < nworkers; i++)
+		CopyWorkerSend(i, buf.data, buf.len, false);
+	cstate->from_worker = false;
+
+	pfree(buf.data);
+
+	pstate = (CopyParallelState *) palloc0(sizeof(CopyParallelState));
+	pstate->nworkers = nworkers;
+	pstate->tupDesc = tupDesc;
+	pstate->in_functions = in_functions;
+	pstate->typioparams = typioparams;
+	pstate->nfields = nfields;
+	pstate->field_strings = field_strings;
+	initStringInfo(&pstate->chunk);
+	initStringInfo(&pstate->held_line);
+	pstate->read_lineno = cstate->cur_lineno;
+	pstate->max_pending = nworkers * 4;
+	pstate->pending_lines = (int *) palloc(pstate->max_pending * sizeof(int));
+
+	return pstate;
+}
+
+static void
+CopySendSetupString(StringInfo buf, const char *str)
+{
+	int			len = strlen(str);
+
+	pq_sendint(buf, len, 4);
+	pq_sendbytes(buf, str, len);
+}
+
+static char *
+CopyGetSetupString(StringInfo msg)
+{
+	int			len = pq_getmsgint(msg, 4);
+
+	return pnstrdup(pq_getmsgbytes(msg, len), len);
+}
+
+/*
+ * Read lines into a new chunk for the workers, until it is big enough or
+ * the input ends.  A line that would make the chunk too big to go through
+ * the queue is held back for the next chunk.  If the held line is too big
+ * even on its own, the chunk is left empty.
+ */
+static void
+CopyParallelFillChunk(CopyState cstate, CopyParallelState *pstate)
+{
+	StringInfo	chunk = &pstate->chunk;
+	int32		hdr[2];
+	int			save_lineno;
+	bool		done;
+
+	resetStringInfo(chunk);
+	pstate->chunk_lines = 0;
+	appendBinaryStringInfo(chunk, (char *) hdr, sizeof(hdr));
+
+	if (pstate->have_held_line)
+	{
+		int32		len = pstate->held_line.len;
+
+		if (chunk->len + sizeof(int32) + len > COPY_WORKER_QUEUE_SIZE)
+			return;
+		appendBinaryStringInfo(chunk, (char *) &len, sizeof(int32));
+		appendBinaryStringInfo(chunk, pstate->held_line.data, len);
+		pstate->chunk_lines++;
+		pstate->have_held_line = false;
+	}
+
+	/* errors while reading refer to the line being read */
+	save_lineno = cstate->cur_lineno;
+
+	while (!pstate->eof && chunk->len < COPY_CHUNK_SIZE)
+	{
+		int32		len;
+
+		cstate->cur_lineno = pstate->read_lineno + 1;
+		done = CopyReadLine(cstate);
+		cstate->line_buf_valid = false;
+
+		/* see the comments in CopyFrom */
+		if (done)
+		{
+			pstate->eof = true;
+			if (cstate->line_buf.len == 0)
+				break;
+		}
+		pstate->read_lineno++;
+
+		len = cstate->line_buf.len;
+		if (chunk->len + sizeof(int32) + len > COPY_WORKER_QUEUE_SIZE)
+		{
+			resetStringInfo(&pstate->held_line);
+			appendBinaryStringInfo(&pstate->held_line,
+								   cstate->line_buf.data, len);
+			pstate->have_held_line = true;
+			break;
+		}
+		appendBinaryStringInfo(chunk, (char *) &len, sizeof(int32));
+		appendBinaryStringInfo(chunk, cstate->line_buf.data, len);
+		pstate->chunk_lines++;
+	}
+
+	cstate->cur_lineno = save_lineno;
+
+	hdr[0] = pstate->chunk_lines;
+	hdr[1] = pstate->read_lineno - pstate->chunk_lines -
+		(pstate->have_held_line ? 1 : 0) + 1;
+	memcpy(chunk->data, hdr, sizeof(hdr));
+}
+
+/*
+ * Get the next row of a parallel COPY FROM into values and nulls.  Returns
+ * false at the end of the input.
+ *
+ * This also keeps the workers busy, by sending them new chunks whenever
+ * there is room in their queues.  We never wait for room, though: while a
+ * worker's queue is full, we collect rows instead, which eventually drains
+ * it.
+ */
+static bool
+CopyFromParallelNext(CopyState cstate, CopyParallelState *pstate,
+					 Datum *values, bool *nulls)
+{
+	while (pstate->next_send - pstate->next_recv < pstate->max_pending)
+	{
+		int			worker = pstate->next_send % pstate->nworkers;
+
+		if (!pstate->chunk_ready)
+		{
+			if (pstate->eof && !pstate->have_held_line)
+				break;
+			CopyParallelFillChunk(cstate, pstate);
+			if (pstate->chunk_lines == 0)
+				break;
+			pstate->chunk_ready = true;
+		}
+
+		cstate->from_worker = true;
+		if (!CopyWorkerSend(worker, pstate->chunk.data, pstate->chunk.len,
+							true))
+		{
+			cstate->from_worker = false;
+			break;
+		}
+		cstate->from_worker = false;
+
+		pstate->pending_lines[pstate->next_send % pstate->max_pending] =
+			pstate->chunk_lines;
+		pstate->next_send++;
+		pstate->chunk_ready = false;
+	}
+
+	if (pstate->next_recv < pstate->next_send)
+	{
+		int			worker = pstate->next_recv % pstate->nworkers;
+		int			slot = pstate->next_recv % pstate->max_pending;
+		int32		len;
+		MinimalTuple mtup;
+		HeapTupleData tuple;
+
+		/* Collect the next row of the oldest chunk */
+		cstate->from_worker = true;
+		CopyWorkerReceive(worker, &len, sizeof(int32));
+		mtup = (MinimalTuple) palloc(len);
+		CopyWorkerReceive(worker, mtup, len);
+		cstate->from_worker = false;
+
+		if (--pstate->pending_lines[slot] == 0)
+			pstate->next_recv++;
+
+		tuple.t_len = mtup->t_len + MINIMAL_TUPLE_OFFSET;
+		tuple.t_data = (HeapTupleHeader) ((char *) mtup - MINIMAL_TUPLE_OFFSET);
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		heap_deform_tuple(&tuple, pstate->tupDesc, values, nulls);
+
+		return true;
+	}
+
+	/* Everything sent so far has been collected; parse an overlong line */
+	if (pstate->have_held_line)
+	{
+		resetStringInfo(&cstate->line_buf);
+		appendBinaryStringInfo(&cstate->line_buf, pstate->held_line.data,
+							   pstate->held_line.len);
+		cstate->line_buf_valid = true;
+		pstate->have_held_line = false;
+
+		(void) CopyFromParseLine(cstate, pstate->tupDesc->attrs,
+								 pstate->in_functions, pstate->typioparams,
+								 false, pstate->nfields,
+								 pstate->field_strings, values, nulls);
+		cstate->line_buf_valid = false;
+
+		return true;
+	}
+
+	Assert(pstate->eof && !pstate->chunk_ready);
+	return false;
+}
+
+/*
+ * Let go of the workers of a parallel COPY FROM.
+ */
+static void
+CopyFromParallelEnd(CopyParallelState *pstate)
+{
+	CopyWorkersFinish();
+
+	pfree(pstate->chunk.data);
+	pfree(pstate->held_line.data);
+	pfree(pstate->pending_lines);
+	pfree(pstate);
+}
+
+/*
+ * Main loop of a copy worker: parse the lines the leader sends us into
+ * rows, and send them back, until the leader is done with us.
+ *
+ * This runs in a transaction started by the caller, as the leader's user.
+ */
+void
+CopyFromWorker(void)
+{
+	CopyState	cstate;
+	StringInfoData msg;
+	int32		len;
+	TupleDesc	tupDesc;
+	Form_pg_attribute *attr;
+	int			natts;
+	int			nattnums;
+	FmgrInfo   *in_functions;
+	Oid		   *typioparams;
+	Datum	   *values;
+	bool	   *nulls;
+	char	  **field_strings;
+	StringInfoData outbuf;
+	MemoryContext linecontext;
+	MemoryContext oldcontext;
+	ErrorContextCallback errcontext;
+	int			i;
+
+	/* Read the setup message, see CopyFromParallelBegin */
+	if (!CopyWorkerRead(&len, sizeof(int32)))
+		return;
+	initStringInfo(&msg);
+	enlargeStringInfo(&msg, len);
+	if (!CopyWorkerRead(msg.data, len))
+		return;
+	msg.len = len;
+
+	cstate = (CopyStateData *) palloc0(sizeof(CopyStateData));
+
+	natts = pq_getmsgint(&msg, 4);
+	tupDesc = CreateTemplateTupleDesc(natts, false);
+	attr = tupDesc->attrs;
+	for (i = 0; i < natts; i++)
+		pq_copymsgbytes(&msg, (char *) attr[i], ATTRIBUTE_FIXED_PART_SIZE);
+	nattnums = pq_getmsgint(&msg, 4);
+	for (i = 0; i < nattnums; i++)
+		cstate->attnumlist = lappend_int(cstate->attnumlist,
+										 pq_getmsgint(&msg, 4));
+	cstate->force_notnull_flags = (bool *) palloc(natts * sizeof(bool));
+	for (i = 0; i < natts; i++)
+		cstate->force_notnull_flags[i] = pq_getmsgbyte(&msg);
+	cstate->csv_mode = pq_getmsgbyte(&msg);
+	cstate->delim = CopyGetSetupString(&msg);
+	cstate->quote = CopyGetSetupString(&msg);
+	cstate->escape = CopyGetSetupString(&msg);
+	cstate->null_print = CopyGetSetupString(&msg);
+	cstate->null_print_len = strlen(cstate->null_print);
+	cstate->cur_relname = CopyGetSetupString(&msg);
+	for (i = 0; i < lengthof(copy_worker_settings); i++)
+		SetConfigOption(copy_worker_settings[i], CopyGetSetupString(&msg),
+						PGC_SUSET, PGC_S_SESSION);
+	pq_getmsgend(&msg);
+
+	/* The lines we get are in server encoding already */
+	initStringInfo(&cstate->attribute_buf);
+	initStringInfo(&cstate->line_buf);
+	cstate->line_buf_converted = true;
+
+	in_functions = (FmgrInfo *) palloc(natts * sizeof(FmgrInfo));
+	typioparams = (Oid *) palloc(natts * sizeof(Oid));
+	for (i = 0; i < natts; i++)
+	{
+		Oid			in_func_oid;
+
+		if (!list_member_int(cstate->attnumlist, i + 1))
+			continue;
+		getTypeInputInfo(attr[i]->atttypid, &in_func_oid, &typioparams[i]);
+		fmgr_info(in_func_oid, &in_functions[i]);
+	}
+
+	values = (Datum *) palloc(natts * sizeof(Datum));
+	nulls = (bool *) palloc(natts * sizeof(bool));
+	field_strings = (char **) palloc(nattnums * sizeof(char *));
+	initStringInfo(&outbuf);
+
+	linecontext = AllocSetContextCreate(CurrentMemoryContext,
+										"COPY worker line",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	/* Set up callback to identify error line number */
+	errcontext.callback = copy_in_error_callback;
+	errcontext.arg = (void *) cstate;
+	errcontext.previous = error_context_stack;
+	error_context_stack = &errcontext;
+
+	for (;;)
+	{
+		int32		hdr[2];
+		int			nlines;
+
+		if (!CopyWorkerRead(hdr, sizeof(hdr)))
+			break;
+		nlines = hdr[0];
+		cstate->cur_lineno = hdr[1] - 1;
+
+		while (nlines-- > 0)
+		{
+			MinimalTuple mtup;
+
+			CHECK_FOR_INTERRUPTS();
+
+			cstate->cur_lineno++;
+			cstate->line_buf_valid = false;
+
+			if (!CopyWorkerRead(&len, sizeof(int32)))
+				goto done;
+			resetStringInfo(&cstate->line_buf);
+			enlargeStringInfo(&cstate->line_buf, len);
+			if (!CopyWorkerRead(cstate->line_buf.data, len))
+				goto done;
+			cstate->line_buf.len = len;
+			cstate->line_buf.data[len] = '\0';
+			cstate->line_buf_valid = true;
+
+			MemoryContextReset(linecontext);
+			oldcontext = MemoryContextSwitchTo(linecontext);
+
+			MemSet(values, 0, natts * sizeof(Datum));
+			MemSet(nulls, true, natts * sizeof(bool));
+			(void) CopyFromParseLine(cstate, attr, in_functions, typioparams,
+									 false, nattnums, field_strings,
+									 values, nulls);
+			mtup = heap_form_minimal_tuple(tupDesc, values, nulls);
+
+			MemoryContextSwitchTo(oldcontext);
+
+			len = mtup->t_len;
+			appendBinaryStringInfo(&outbuf, (char *) &len, sizeof(int32));
+			appendBinaryStringInfo(&outbuf, (char *) mtup, len);
+			if (outbuf.len >= COPY_WORKER_FLUSH_SIZE)
+			{
+				CopyWorkerWrite(outbuf.data, outbuf.len);
+				resetStringInfo(&outbuf);
+			}
+		}
+
+		/* the leader is waiting for the end of the chunk, send it now */
+		if (outbuf.len > 0)
+		{
+			CopyWorkerWrite(outbuf.data, outbuf.len);
+			resetStringInfo(&outbuf);
+		}
+	}
+
+done:
+	error_context_stack = errcontext.previous;
+
+	MemoryContextDelete(linecontext);
+}
 
 /*
  * Read the next input line and stash it in line_buf, with conversion to
@@ -2263,6 +3069,7 @@ CopyReadLine(CopyState cstate)
 	bool		result;
 
 	resetStringInfo(&cstate->line_buf);
+	cstate->line_buf_valid = true;
 
 	/* Mark that encoding conversion hasn't occurred yet */
 	cstate->line_buf_converted = false;
@@ -2362,6 +3169,10 @@ CopyReadLineText(CopyState cstate)
 	char		quotec = '\0';
 	char		escapec = '\0';
 
+	/* characters the bulk scan must stop at */
+	char		scan_chars[PG_SCAN_MAX_CHARS];
+	int			scan_nchars;
+
 	if (cstate->csv_mode)
 	{
 		quotec = cstate->quote[0];
@@ -2371,6 +3182,25 @@ CopyReadLineText(CopyState cstate)
 			escapec = '\0';
 	}
 
+	/*
+	 * Outside the first character of a line, a backslash only matters in
+	 * text mode; in CSV mode the quote and escape characters matter instead.
+	 */
+	scan_chars[0] = '\n';
+	scan_chars[1] = '\r';
+	if (!cstate->csv_mode)
+	{
+		scan_chars[2] = '\\';
+		scan_nchars = 3;
+	}
+	else
+	{
+		scan_chars[2] = quotec;
+		scan_nchars = 3;
+		if (escapec != '\0')
+			scan_chars[scan_nchars++] = escapec;
+	}
+
 	mblen_str[1] = '\0';
 
 	/*
@@ -2438,6 +3268,31 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip over any run of characters that cannot end the line or
+		 * change the CSV quoting state.  They are left in raw_buf and
+		 * transferred to line_buf along with the rest of the line, just as
+		 * if the loop below had stepped over them one at a time.  In an
+		 * encoding that can embed ASCII bytes in multibyte characters, stop
+		 * at every high-bit byte so that the multibyte logic below sees it.
+		 */
+		if (!first_char_in_line)
+		{
+			const char *run_end;
+
+			run_end = pg_scan_chars(copy_raw_buf + raw_buf_ptr,
+									copy_raw_buf + copy_buf_len,
+									scan_chars, scan_nchars,
+									cstate->encoding_embeds_ascii);
+			if (run_end > copy_raw_buf + raw_buf_ptr)
+			{
+				raw_buf_ptr = run_end - copy_raw_buf;
+				last_was_esc = false;
+				if (raw_buf_ptr >= copy_buf_len)
+					continue;
+			}
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -2712,6 +3567,29 @@ GetDecimalFromHex(char hex)
 		return tolower((unsigned char) hex) - 'a' + 10;
 }
 
+/*
+ * Copy the run of characters starting at cur_ptr that contains none of
+ * chars[] into *output_ptr, advancing *output_ptr past it.  Returns the
+ * position of the first special character, or line_end_ptr.
+ */
+static inline char *
+copy_plain_run(char *cur_ptr, char *line_end_ptr, char **output_ptr,
+			   const char *chars, int nchars)
+{
+	char	   *run_end;
+	int			run_len;
+
+	run_end = (char *) pg_scan_chars(cur_ptr, line_end_ptr,
+									 chars, nchars, false);
+	run_len = run_end - cur_ptr;
+	if (run_len > 0)
+	{
+		memcpy(*output_ptr, cur_ptr, run_len);
+		*output_ptr += run_len;
+	}
+	return run_end;
+}
+
 /*
  * Parse the current line into separate attributes (fields),
  * performing de-escaping as needed.
@@ -2734,6 +3612,7 @@ static int
 CopyReadAttributesText(CopyState cstate, int maxfields, char **fieldvals)
 {
 	char		delimc = cstate->delim[0];
+	char		scan_chars[2];
 	int			fieldno;
 	char	   *output_ptr;
 	char	   *cur_ptr;
@@ -2769,6 +3648,9 @@ CopyReadAttributesText(CopyState cstate, int maxfields, char **fieldvals)
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
+	scan_chars[0] = delimc;
+	scan_chars[1] = '\\';
+
 	/* Outer loop iterates over fields */
 	fieldno = 0;
 	for (;;)
@@ -2794,6 +3676,10 @@ CopyReadAttributesText(CopyState cstate, int maxfields, char **fieldvals)
 		{
 			char		c;
 
+			/* Copy any run of characters needing no de-escaping in bulk */
+			cur_ptr = copy_plain_run(cur_ptr, line_end_ptr, &output_ptr,
+									 scan_chars, 2);
+
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
 				break;
@@ -2949,6 +3835,8 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 	char		delimc = cstate->delim[0];
 	char		quotec = cstate->quote[0];
 	char		escapec = cstate->escape[0];
+	char		unquoted_chars[2];
+	char		quoted_chars[2];
 	int			fieldno;
 	char	   *output_ptr;
 	char	   *cur_ptr;
@@ -2984,6 +3872,11 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
+	unquoted_chars[0] = delimc;
+	unquoted_chars[1] = quotec;
+	quoted_chars[0] = quotec;
+	quoted_chars[1] = escapec;
+
 	/* Outer loop iterates over fields */
 	fieldno = 0;
 	for (;;)
@@ -3018,6 +3911,8 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 			/* Not in quote */
 			for (;;)
 			{
+				cur_ptr = copy_plain_run(cur_ptr, line_end_ptr, &output_ptr,
+										 unquoted_chars, 2);
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -3041,6 +3936,8 @@ CopyReadAttributesCSV(CopyState cstate, int maxfields, char **fieldvals)
 			/* In quote */
 			for (;;)
 			{
+				cur_ptr = copy_plain_run(cur_ptr, line_end_ptr, &output_ptr,
+										 quoted_chars, 2);
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -33,6 +33,13 @@
  *		It must be called again to continue the operation.	Without RETURNING,
  *		we just loop within the node until all the work is done, then
  *		return NULL.  This avoids useless call/return overhead.
+ *
+ *		When the planner has said it's safe (see ModifyTable.multiInsert),
+ *		and there are no BEFORE ROW INSERT triggers, an INSERT collects the
+ *		new rows in a buffer and inserts them with heap_multi_insert, which
+ *		fills each heap page under a single buffer lock and WAL record.
+ *		Index entries and AFTER ROW triggers for the rows are then done for
+ *		the whole batch.
  */
 
 #include "postgres.h"
@@ -49,6 +56,15 @@
 #include "utils/tqual.h"
 
 
+/*
+ * Flush the buffered INSERT rows after this many rows, or after the total
+ * size of the rows exceeds MAX_BUFFERED_BYTES, whichever comes first.  The
+ * latter keeps memory use sane when the rows are very wide.
+ */
+#define MAX_BUFFERED_TUPLES		1000
+#define MAX_BUFFERED_BYTES		65535
+
+
 /*
  * Verify that the tuples to be produced by INSERT or UPDATE match the
  * target relation's rowtype
@@ -148,6 +164,66 @@ ExecProcessReturning(ProjectionInfo *projectReturning,
 	return ExecProject(projectReturning, NULL);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecFlushBufferedInserts
+ *
+ *		Insert the rows collected by ExecInsert into the heap, then make
+ *		their index entries and queue their AFTER ROW triggers.
+ * ----------------------------------------------------------------
+ */
+static void
+ExecFlushBufferedInserts(ModifyTableState *mtstate, EState *estate)
+{
+	ResultRelInfo *resultRelInfo = estate->es_result_relation_info;
+	HeapTuple  *tuples = mtstate->mt_bufferedTuples;
+	int			ntuples = mtstate->mt_nBufferedTuples;
+	MemoryContext oldcontext;
+	int			i;
+
+	if (ntuples == 0)
+		return;
+
+	/* heap_multi_insert leaks memory, so run it in the batch context */
+	oldcontext = MemoryContextSwitchTo(mtstate->mt_batchContext);
+	heap_multi_insert(resultRelInfo->ri_RelationDesc, tuples, ntuples,
+					  estate->es_output_cid, 0, NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	for (i = 0; i < ntuples; i++)
+	{
+		List	   *recheckIndexes = NIL;
+
+		/*
+		 * The per-tuple context holds nothing we still need (the rows are
+		 * all in the batch context), so it can be reset for each row.
+		 */
+		ResetPerTupleExprContext(estate);
+
+		if (resultRelInfo->ri_NumIndices > 0)
+		{
+			ExecStoreTuple(tuples[i], mtstate->mt_batchSlot,
+						   InvalidBuffer, false);
+			recheckIndexes = ExecInsertIndexTuples(mtstate->mt_batchSlot,
+												   &(tuples[i]->t_self),
+												   estate);
+		}
+
+		/* AFTER ROW INSERT Triggers */
+		ExecARInsertTriggers(estate, resultRelInfo, tuples[i],
+							 recheckIndexes);
+
+		list_free(recheckIndexes);
+	}
+	ExecClearTuple(mtstate->mt_batchSlot);
+
+	estate->es_lastoid = HeapTupleGetOid(tuples[ntuples - 1]);
+	setLastTid(&(tuples[ntuples - 1]->t_self));
+
+	MemoryContextReset(mtstate->mt_batchContext);
+	mtstate->mt_nBufferedTuples = 0;
+	mtstate->mt_bufferedBytes = 0;
+}
+
 /* ----------------------------------------------------------------
  *		ExecInsert
  *
@@ -158,7 +234,8 @@ ExecProcessReturning(ProjectionInfo *projectReturning,
  * ----------------------------------------------------------------
  */
 static TupleTableSlot *
-ExecInsert(TupleTableSlot *slot,
+ExecInsert(ModifyTableState *mtstate,
+		   TupleTableSlot *slot,
 		   TupleTableSlot *planSlot,
 		   EState *estate)
 {
@@ -231,6 +308,29 @@ ExecInsert(TupleTableSlot *slot,
 	if (resultRelationDesc->rd_att->constr)
 		ExecConstraints(resultRelInfo, slot, estate);
 
+	/*
+	 * If we're batching, just add a copy of the tuple to the buffer, and
+	 * flush the buffer if it's full.  There's no RETURNING in this case.
+	 */
+	if (mtstate->mt_bufferedTuples != NULL)
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(mtstate->mt_batchContext);
+		mtstate->mt_bufferedTuples[mtstate->mt_nBufferedTuples++] =
+			heap_copytuple(tuple);
+		MemoryContextSwitchTo(oldcontext);
+		mtstate->mt_bufferedBytes += tuple->t_len;
+
+		(estate->es_processed)++;
+
+		if (mtstate->mt_nBufferedTuples == MAX_BUFFERED_TUPLES ||
+			mtstate->mt_bufferedBytes > MAX_BUFFERED_BYTES)
+			ExecFlushBufferedInserts(mtstate, estate);
+
+		return NULL;
+	}
+
 	/*
 	 * insert the tuple
 	 *
@@ -742,7 +842,7 @@ ExecModifyTable(ModifyTableState *node)
 		switch (operation)
 		{
 			case CMD_INSERT:
-				slot = ExecInsert(slot, planSlot, estate);
+				slot = ExecInsert(node, slot, planSlot, estate);
 				break;
 			case CMD_UPDATE:
 				slot = ExecUpdate(tupleid, slot, planSlot,
@@ -768,6 +868,10 @@ ExecModifyTable(ModifyTableState *node)
 		}
 	}
 
+	/* Insert any rows still in the buffer */
+	if (node->mt_bufferedTuples != NULL)
+		ExecFlushBufferedInserts(node, estate);
+
 	/* Reset es_result_relation_info before exiting */
 	estate->es_result_relation_info = NULL;
 
@@ -1014,6 +1118,33 @@ ExecInitModifyTable(ModifyTable *node, EState *estate, int eflags)
 	if (estate->es_trig_tuple_slot == NULL)
 		estate->es_trig_tuple_slot = ExecInitExtraTupleSlot(estate);
 
+	/*
+	 * Set up for batching INSERTed rows, if the planner allowed it.  BEFORE
+	 * ROW triggers might look at the table and expect to see the rows
+	 * inserted so far, so we can't batch if there are any.  (AFTER ROW
+	 * triggers are fine; they're queued until the end of the statement
+	 * anyway.)
+	 */
+	resultRelInfo = estate->es_result_relations;
+	if (node->multiInsert &&
+		!(resultRelInfo->ri_TrigDesc &&
+		  resultRelInfo->ri_TrigDesc->n_before_row[TRIGGER_EVENT_INSERT] > 0))
+	{
+		Assert(operation == CMD_INSERT && nplans == 1);
+
+		mtstate->mt_bufferedTuples = (HeapTuple *)
+			palloc(MAX_BUFFERED_TUPLES * sizeof(HeapTuple));
+		mtstate->mt_batchContext =
+			AllocSetContextCreate(CurrentMemoryContext,
+								  "ModifyTable batch",
+								  ALLOCSET_DEFAULT_MINSIZE,
+								  ALLOCSET_DEFAULT_INITSIZE,
+								  ALLOCSET_DEFAULT_MAXSIZE);
+		mtstate->mt_batchSlot = ExecInitExtraTupleSlot(estate);
+		ExecSetSlotDescriptor(mtstate->mt_batchSlot,
+							  RelationGetDescr(resultRelInfo->ri_RelationDesc));
+	}
+
 	return mtstate;
 }
 
@@ -1045,6 +1176,13 @@ ExecEndModifyTable(ModifyTableState *node)
 	 */
 	EvalPlanQualEnd(&node->mt_epqstate);
 
+	/*
+	 * Release the INSERT batch buffer.  It's empty by now, since
+	 * ExecModifyTable flushes it before returning.
+	 */
+	if (node->mt_batchContext)
+		MemoryContextDelete(node->mt_batchContext);
+
 	/*
 	 * shut down subplans
 	 */
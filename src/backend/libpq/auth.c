@@ -385,7 +385,7 @@ ClientAuthentication(Port *port)
 								   NULL, 0,
 								   NI_NUMERICHOST);
 
-				if (am_walsender)
+				if (am_walsender && !am_db_walsender)
 				{
 #ifdef USE_SSL
 					ereport(FATAL,
@@ -438,7 +438,7 @@ ClientAuthentication(Port *port)
 								   NULL, 0,
 								   NI_NUMERICHOST);
 
-				if (am_walsender)
+				if (am_walsender && !am_db_walsender)
 				{
 #ifdef USE_SSL
 					ereport(FATAL,
@@ -513,9 +513,13 @@ check_db(const char *dbname, const char *role, Oid roleid, char *param_str)
 		 tok != NULL;
 		 tok = strtok(NULL, MULTI_VALUE_SEP))
 	{
-		if (am_walsender)
+		if (am_walsender && !am_db_walsender)
 		{
-			/* walsender connections can only match replication keyword */
+			/*
+			 * walsender connections can only match replication keyword,
+			 * except those for logical decoding, which are made to a
+			 * database
+			 */
 			if (strcmp(tok, "replication\n") == 0)
 				return true;
 		}
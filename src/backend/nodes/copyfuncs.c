@@ -172,6 +172,7 @@ _copyModifyTable(ModifyTable *from)
 	 * copy remainder of node
 	 */
 	COPY_SCALAR_FIELD(operation);
+	COPY_SCALAR_FIELD(multiInsert);
 	COPY_NODE_FIELD(resultRelations);
 	COPY_NODE_FIELD(plans);
 	COPY_NODE_FIELD(returningLists);
@@ -3967,6 +3967,7 @@ make_modifytable(CmdType operation, List *resultRelations,
 		node->plan.targetlist = NIL;
 
 	node->operation = operation;
+	node->multiInsert = false;	/* caller may set it */
 	node->resultRelations = resultRelations;
 	node->plans = subplans;
 	node->returningLists = returningLists;
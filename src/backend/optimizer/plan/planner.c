@@ -293,8 +293,24 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 	Plan	   *plan;
 	List	   *newHaving;
 	bool		hasOuterJoins;
+	bool		multiInsert = false;
 	ListCell   *l;
 
+	/*
+	 * An INSERT ... SELECT (or multi-row VALUES) can have the executor buffer
+	 * the new rows and insert them into the heap in batches, provided that
+	 * nothing in the query could look at the target table while rows are
+	 * held back.  Decide that before preprocessing, while all sub-selects
+	 * are still in the tree for contain_volatile_functions_not_nextval to
+	 * see.  RETURNING needs each row to be inserted as it's produced, so it
+	 * rules out buffering too.
+	 */
+	if (parse->commandType == CMD_INSERT &&
+		parse->returningList == NIL &&
+		parse->jointree->fromlist != NIL &&
+		!contain_volatile_functions_not_nextval((Node *) parse))
+		multiInsert = true;
+
 	/* Create a PlannerInfo data structure for this subquery */
 	root = makeNode(PlannerInfo);
 	root->parse = parse;
@@ -565,6 +581,7 @@ subquery_planner(PlannerGlobal *glob, Query *parse,
 											 returningLists,
 											 rowMarks,
 											 SS_assign_special_param(root));
+			((ModifyTable *) plan)->multiInsert = multiInsert;
 		}
 	}
 
@@ -42,6 +42,7 @@
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/syscache.h"
@@ -909,6 +910,25 @@ contain_volatile_functions(Node *clause)
 	return contain_volatile_functions_walker(clause, NULL);
 }
 
+/*
+ * contain_volatile_functions_not_nextval
+ *	  Like contain_volatile_functions, but ignores nextval(), and does
+ *	  look into sub-selects.
+ *
+ * This is used to decide whether the rows of an INSERT or COPY FROM can be
+ * buffered and inserted into the table in batches: a volatile function
+ * might look at the target table and expect to see the rows inserted so far.
+ * nextval() can't, and it's too common in column defaults to disqualify.
+ */
+bool
+contain_volatile_functions_not_nextval(Node *clause)
+{
+	bool		not_nextval = true;
+
+	return contain_volatile_functions_walker(clause, &not_nextval);
+}
+
+/* context is non-NULL if called from contain_volatile_functions_not_nextval */
 static bool
 contain_volatile_functions_walker(Node *node, void *context)
 {
@@ -918,10 +938,20 @@ contain_volatile_functions_walker(Node *node, void *context)
 	{
 		FuncExpr   *expr = (FuncExpr *) node;
 
-		if (func_volatile(expr->funcid) == PROVOLATILE_VOLATILE)
+		if (func_volatile(expr->funcid) == PROVOLATILE_VOLATILE &&
+			!(context != NULL && expr->funcid == F_NEXTVAL_OID))
 			return true;
 		/* else fall through to check args */
 	}
+	else if (IsA(node, Query))
+	{
+		/* Recurse into sub-selects, only if asked to */
+		if (context != NULL)
+			return query_tree_walker((Query *) node,
+									 contain_volatile_functions_walker,
+									 context, 0);
+		return false;
+	}
 	else if (IsA(node, OpExpr))
 	{
 		OpExpr	   *expr = (OpExpr *) node;
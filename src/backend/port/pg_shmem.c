@@ -0,0 +1 @@
+../../../src/backend/port/sysv_shmem.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/backend/port/tas/dummy.s
\ No newline at end of file
@@ -0,0 +1,1079 @@
+/*-------------------------------------------------------------------------
+ *
+ * copyworker.c
+ *
+ * Worker processes for parallel COPY FROM.
+ *
+ * A backend running COPY FROM with the PARALLEL option (the "leader") asks
+ * the postmaster to start some copy workers.  A copy worker is an ordinary
+ * backend connected to the leader's database as the leader's user, but it
+ * has no client: it talks to its leader only through a pair of byte queues
+ * in shared memory, one in each direction.  The leader keeps reading the
+ * input and splitting it into lines, and hands batches of lines to the
+ * workers; the workers do the expensive part, splitting the lines into
+ * fields and running the datatype input functions, and send the resulting
+ * tuples back.  What goes through the queues is up to commands/copy.c; this
+ * file only provides the transport.
+ *
+ * Starting a worker works like starting an autovacuum worker: the leader
+ * reserves a slot in shared memory, sets startingSlot to it and signals the
+ * postmaster, which forks a new backend.  The new process picks up the
+ * slot from startingSlot and resets it, so that the next worker can be
+ * started.  Only one worker can be starting at a time; if the postmaster
+ * cannot fork, it sets forkFailed and the leader gives up on that worker.
+ *
+ * If a worker hits an error, it copies the error message into its slot and
+ * exits, and the leader raises the same error when it next needs data from
+ * that worker.  If the leader's transaction, or the subtransaction that
+ * started the workers, aborts, AtAbort_CopyWorkers or AtEOSubXact_CopyWorkers
+ * detaches it from the slots, and the workers exit when they notice that.
+ * An aborting subtransaction started inside the COPY, for example by an
+ * exception block in a trigger, leaves the workers alone.
+ * A slot is free again once both sides have detached from it.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "access/xact.h"
+#include "commands/copy.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "postmaster/copyworker.h"
+#include "postmaster/fork_process.h"
+#include "postmaster/postmaster.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/pmsignal.h"
+#include "storage/proc.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/ps_status.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * GUC parameters
+ */
+int			max_copy_workers = 8;
+
+/* how long to wait for a forked worker to show up, in milliseconds */
+#define COPY_WORKER_START_TIMEOUT	10000
+
+typedef enum CopyWorkerStatus
+{
+	COPY_WORKER_STARTING,		/* reserved, worker not connected yet */
+	COPY_WORKER_RUNNING,		/* connected to the database */
+	COPY_WORKER_FAILED,			/* reported an error, see below */
+	COPY_WORKER_EXITED			/* went away without reporting an error */
+} CopyWorkerStatus;
+
+/*
+ * A single-reader, single-writer byte queue.  written and read count the
+ * bytes that have gone through the queue; the unread data is in the ring
+ * buffer between those positions.  The spinlock makes sure that the data
+ * copied into the buffer is visible before the position is advanced.
+ */
+typedef struct CopyWorkerQueue
+{
+	slock_t		mutex;
+	uint64		written;
+	uint64		read;
+	char		data[COPY_WORKER_QUEUE_SIZE];
+} CopyWorkerQueue;
+
+#define COPY_WORKER_MSG_LEN		1024
+
+typedef struct CopyWorkerSlot
+{
+	/* these fields are protected by CopyWorkerShmem->mutex */
+	bool		in_use;			/* reserved by a leader? */
+	bool		leader_attached;	/* leader still using it? */
+	bool		worker_attached;	/* worker still using it? */
+	CopyWorkerStatus status;
+	int			leader_slot;	/* slot containing the leader's latch */
+	Oid			dbid;			/* database to connect to */
+	Oid			userid;			/* user to run as */
+
+	/* set by the leader to wake up the worker, and vice versa */
+	Latch		workerLatch;
+	Latch		leaderLatch;	/* used only in the leader's first slot */
+
+	/* error report from a failed worker, valid once status is FAILED */
+	int			sqlerrcode;
+	char		message[COPY_WORKER_MSG_LEN];
+	char		detail[COPY_WORKER_MSG_LEN];
+	char		hint[COPY_WORKER_MSG_LEN];
+	char		context[COPY_WORKER_MSG_LEN];
+
+	CopyWorkerQueue input;		/* leader to worker */
+	CopyWorkerQueue output;		/* worker to leader */
+} CopyWorkerSlot;
+
+typedef struct
+{
+	slock_t		mutex;
+	int			startingSlot;	/* slot waiting for its worker, or -1 */
+	bool		forkFailed;		/* postmaster couldn't start the worker */
+	CopyWorkerSlot slots[1];	/* VARIABLE LENGTH ARRAY */
+} CopyWorkerShmemStruct;
+
+static CopyWorkerShmemStruct *CopyWorkerShmem;
+
+/* Flag to tell if we are a copy worker process */
+static bool am_copy_worker = false;
+
+/* in a worker, the slot we are serving */
+static volatile CopyWorkerSlot *MySlot = NULL;
+
+/*
+ * In a leader, the slots we have reserved, the subset of them that have a
+ * running worker, the latch we wait on, and the subtransaction that started
+ * the workers.
+ */
+static int *LeaderSlots = NULL;
+static int	nLeaderSlots = 0;
+static int *WorkerSlots = NULL;
+static int	nWorkers = 0;
+static volatile Latch *LeaderLatch = NULL;
+static SubTransactionId LeaderSubid = InvalidSubTransactionId;
+
+#ifdef EXEC_BACKEND
+static pid_t copyworker_forkexec(void);
+#endif
+NON_EXEC_STATIC void CopyWorkerMain(int argc, char *argv[]);
+
+static bool start_copy_worker(int slotno);
+static void release_leader_slots(void);
+static void leader_wait(volatile CopyWorkerSlot *slot);
+static void worker_wait(void);
+static void check_worker_status(volatile CopyWorkerSlot *slot);
+static void report_worker_error(void);
+static void copy_worker_shmem_exit(int code, Datum arg);
+static Size queue_write(volatile CopyWorkerQueue *queue, const char *data,
+			Size len);
+static Size queue_read(volatile CopyWorkerQueue *queue, char *data, Size len);
+static Size queue_free_space(volatile CopyWorkerQueue *queue);
+
+
+/*
+ * IsCopyWorkerProcess
+ *		Are we a copy worker?
+ */
+bool
+IsCopyWorkerProcess(void)
+{
+	return am_copy_worker;
+}
+
+/*
+ * CopyWorkerShmemSize
+ *		Compute space needed for copy worker related shared memory
+ */
+Size
+CopyWorkerShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(CopyWorkerShmemStruct, slots);
+	size = add_size(size, mul_size(max_copy_workers, sizeof(CopyWorkerSlot)));
+
+	return size;
+}
+
+/*
+ * CopyWorkerShmemInit
+ *		Allocate and initialize copy worker related shared memory
+ */
+void
+CopyWorkerShmemInit(void)
+{
+	bool		found;
+
+	CopyWorkerShmem = (CopyWorkerShmemStruct *)
+		ShmemInitStruct("Copy Worker Data", CopyWorkerShmemSize(), &found);
+
+	if (!IsUnderPostmaster)
+	{
+		int			i;
+
+		Assert(!found);
+
+		SpinLockInit(&CopyWorkerShmem->mutex);
+		CopyWorkerShmem->startingSlot = -1;
+		CopyWorkerShmem->forkFailed = false;
+
+		for (i = 0; i < max_copy_workers; i++)
+		{
+			CopyWorkerSlot *slot = &CopyWorkerShmem->slots[i];
+
+			slot->in_use = false;
+			slot->leader_attached = false;
+			slot->worker_attached = false;
+			InitSharedLatch(&slot->workerLatch);
+			InitSharedLatch(&slot->leaderLatch);
+			SpinLockInit(&slot->input.mutex);
+			SpinLockInit(&slot->output.mutex);
+		}
+	}
+	else
+		Assert(found);
+}
+
+
+/********************************************************************
+ *					  LEADER SIDE
+ ********************************************************************/
+
+/*
+ * CopyWorkersLaunch
+ *		Start up to nworkers copy workers for the current backend.
+ *
+ * Returns the number of workers that were started and are connected to the
+ * database; the workers are numbered from 0 in the other calls.  Fewer
+ * workers than requested are started if max_copy_workers is exhausted, or
+ * the workers cannot be started, for example because max_connections has
+ * been reached.  The workers stay with us until CopyWorkersFinish, or until
+ * the transaction aborts.
+ */
+int
+CopyWorkersLaunch(int nworkers)
+{
+	volatile CopyWorkerShmemStruct *cws = CopyWorkerShmem;
+	int			i;
+
+	/*
+	 * A COPY run from within a parallel COPY, for example by a default
+	 * expression, doesn't get workers of its own.
+	 */
+	if (nLeaderSlots > 0 || am_copy_worker)
+		return 0;
+
+	if (LeaderSlots == NULL)
+	{
+		LeaderSlots = (int *) MemoryContextAlloc(TopMemoryContext,
+											 max_copy_workers * sizeof(int));
+		WorkerSlots = (int *) MemoryContextAlloc(TopMemoryContext,
+											 max_copy_workers * sizeof(int));
+	}
+
+	/* Reserve free slots */
+	SpinLockAcquire(&cws->mutex);
+	for (i = 0; i < max_copy_workers && nLeaderSlots < nworkers; i++)
+	{
+		volatile CopyWorkerSlot *slot = &cws->slots[i];
+
+		if (slot->in_use)
+			continue;
+
+		slot->in_use = true;
+		slot->leader_attached = true;
+		slot->worker_attached = false;
+		slot->status = COPY_WORKER_STARTING;
+		slot->leader_slot = (nLeaderSlots == 0) ? i : LeaderSlots[0];
+		slot->dbid = MyDatabaseId;
+		slot->userid = GetUserId();
+		slot->input.written = slot->input.read = 0;
+		slot->output.written = slot->output.read = 0;
+		LeaderSlots[nLeaderSlots++] = i;
+	}
+	SpinLockRelease(&cws->mutex);
+
+	if (nLeaderSlots == 0)
+		return 0;
+
+	LeaderLatch = &cws->slots[LeaderSlots[0]].leaderLatch;
+	OwnLatch(LeaderLatch);
+	LeaderSubid = GetCurrentSubTransactionId();
+
+	/* Start the workers one at a time */
+	for (i = 0; i < nLeaderSlots; i++)
+	{
+		if (!start_copy_worker(LeaderSlots[i]))
+			break;
+	}
+
+	/*
+	 * Wait for the started workers to connect to the database.  A worker
+	 * that exits before that is dropped quietly, the reason has been logged
+	 * by the worker itself.  Its slot stays reserved until we're done, as
+	 * the first slot holds our latch.  From here on, anything unexpected
+	 * happening to a worker is an error.
+	 */
+	nWorkers = 0;
+	for (i = 0; i < nLeaderSlots; i++)
+	{
+		volatile CopyWorkerSlot *slot = &cws->slots[LeaderSlots[i]];
+		CopyWorkerStatus status;
+
+		for (;;)
+		{
+			SpinLockAcquire(&cws->mutex);
+			if (!slot->worker_attached && slot->status == COPY_WORKER_STARTING)
+				status = COPY_WORKER_EXITED;	/* never started */
+			else
+				status = slot->status;
+			SpinLockRelease(&cws->mutex);
+
+			if (status != COPY_WORKER_STARTING)
+				break;
+
+			WaitLatch(LeaderLatch, 1000000L);
+			ResetLatch(LeaderLatch);
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		if (status == COPY_WORKER_RUNNING)
+			WorkerSlots[nWorkers++] = LeaderSlots[i];
+		else
+			ereport(DEBUG1,
+					(errmsg("could not start copy worker")));
+	}
+
+	if (nWorkers == 0)
+		release_leader_slots();
+
+	return nWorkers;
+}
+
+/*
+ * Ask the postmaster to start a worker for the given slot, and wait for the
+ * worker to pick it up.  Returns false if the worker couldn't be started.
+ */
+static bool
+start_copy_worker(int slotno)
+{
+	volatile CopyWorkerShmemStruct *cws = CopyWorkerShmem;
+	TimestampTz start_time;
+
+	/* Wait for any other worker launch to finish */
+	for (;;)
+	{
+		SpinLockAcquire(&cws->mutex);
+		if (cws->startingSlot < 0)
+		{
+			cws->startingSlot = slotno;
+			cws->forkFailed = false;
+			SpinLockRelease(&cws->mutex);
+			break;
+		}
+		SpinLockRelease(&cws->mutex);
+
+		pg_usleep(10000L);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	SendPostmasterSignal(PMSIGNAL_START_COPY_WORKER);
+
+	start_time = GetCurrentTimestamp();
+	for (;;)
+	{
+		bool		started = false;
+		bool		failed = false;
+
+		SpinLockAcquire(&cws->mutex);
+		if (cws->startingSlot != slotno)
+			started = true;
+		else if (cws->forkFailed ||
+				 TimestampDifferenceExceeds(start_time, GetCurrentTimestamp(),
+											COPY_WORKER_START_TIMEOUT))
+		{
+			/*
+			 * Give up.  If the worker shows up after all, it will find no
+			 * slot to serve and exit.
+			 */
+			cws->startingSlot = -1;
+			cws->forkFailed = false;
+			failed = true;
+		}
+		SpinLockRelease(&cws->mutex);
+
+		if (started)
+			return true;
+		if (failed)
+			return false;
+
+		WaitLatch(LeaderLatch, 100000L);
+		ResetLatch(LeaderLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * CopyWorkerSend
+ *		Send len bytes of data to a worker.
+ *
+ * If nowait is true, the data is sent only if it fits in the queue right
+ * away, and the result tells whether it was sent.  Otherwise we wait for
+ * the worker to make room as long as necessary, and always return true.
+ */
+bool
+CopyWorkerSend(int worker, const void *data, Size len, bool nowait)
+{
+	volatile CopyWorkerSlot *slot;
+	const char *p = (const char *) data;
+
+	Assert(worker >= 0 && worker < nWorkers);
+	slot = &CopyWorkerShmem->slots[WorkerSlots[worker]];
+
+	if (nowait && queue_free_space(&slot->input) < len)
+		return false;
+
+	while (len > 0)
+	{
+		Size		n;
+
+		n = queue_write(&slot->input, p, len);
+		if (n > 0)
+		{
+			SetLatch(&slot->workerLatch);
+			p += n;
+			len -= n;
+		}
+		else
+			leader_wait(slot);
+	}
+
+	return true;
+}
+
+/*
+ * CopyWorkerReceive
+ *		Receive len bytes of data from a worker, waiting for them if needed.
+ *
+ * If the worker has failed, its error is re-thrown here.
+ */
+void
+CopyWorkerReceive(int worker, void *data, Size len)
+{
+	volatile CopyWorkerSlot *slot;
+	char	   *p = (char *) data;
+
+	Assert(worker >= 0 && worker < nWorkers);
+	slot = &CopyWorkerShmem->slots[WorkerSlots[worker]];
+
+	while (len > 0)
+	{
+		Size		n;
+
+		n = queue_read(&slot->output, p, len);
+		if (n > 0)
+		{
+			SetLatch(&slot->workerLatch);
+			p += n;
+			len -= n;
+		}
+		else
+			leader_wait(slot);
+	}
+}
+
+/*
+ * CopyWorkersFinish
+ *		Let go of our copy workers.
+ *
+ * The workers exit once they have noticed that the leader is gone.
+ */
+void
+CopyWorkersFinish(void)
+{
+	release_leader_slots();
+}
+
+/*
+ * AtAbort_CopyWorkers
+ *		Let go of our copy workers, if the error happened during COPY.
+ */
+void
+AtAbort_CopyWorkers(void)
+{
+	if (nLeaderSlots > 0)
+		release_leader_slots();
+}
+
+/*
+ * AtEOSubXact_CopyWorkers
+ *		Take care of our copy workers at subtransaction commit/abort
+ *
+ * Workers started in a committing subtransaction are reassigned to the
+ * parent.  On abort, we let go of them only if they were started in the
+ * aborting subtransaction; a subtransaction started and rolled back while
+ * the COPY runs, by a trigger say, must not take them away from it.
+ */
+void
+AtEOSubXact_CopyWorkers(bool isCommit, SubTransactionId mySubid,
+						SubTransactionId parentSubid)
+{
+	if (nLeaderSlots == 0 || LeaderSubid != mySubid)
+		return;
+
+	if (isCommit)
+		LeaderSubid = parentSubid;
+	else
+		release_leader_slots();
+}
+
+static void
+release_leader_slots(void)
+{
+	volatile CopyWorkerShmemStruct *cws = CopyWorkerShmem;
+	int			i;
+
+	if (LeaderLatch != NULL)
+	{
+		DisownLatch(LeaderLatch);
+		LeaderLatch = NULL;
+	}
+
+	for (i = 0; i < nLeaderSlots; i++)
+	{
+		volatile CopyWorkerSlot *slot = &cws->slots[LeaderSlots[i]];
+
+		SpinLockAcquire(&cws->mutex);
+		if (cws->startingSlot == LeaderSlots[i])
+			cws->startingSlot = -1;
+		slot->leader_attached = false;
+		if (!slot->worker_attached)
+			slot->in_use = false;
+		SpinLockRelease(&cws->mutex);
+
+		SetLatch(&slot->workerLatch);
+	}
+
+	nLeaderSlots = 0;
+	nWorkers = 0;
+	LeaderSubid = InvalidSubTransactionId;
+}
+
+/*
+ * Wait for something to happen in the given worker's slot, and check that
+ * the worker is still alive.
+ */
+static void
+leader_wait(volatile CopyWorkerSlot *slot)
+{
+	check_worker_status(slot);
+
+	WaitLatch(LeaderLatch, 1000000L);
+	ResetLatch(LeaderLatch);
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Throw an error if the worker serving the given slot has failed or gone.
+ */
+static void
+check_worker_status(volatile CopyWorkerSlot *slot)
+{
+	CopyWorkerStatus status;
+
+	SpinLockAcquire(&CopyWorkerShmem->mutex);
+	status = slot->status;
+	SpinLockRelease(&CopyWorkerShmem->mutex);
+
+	if (status == COPY_WORKER_FAILED)
+	{
+		char		message[COPY_WORKER_MSG_LEN];
+		char		detail[COPY_WORKER_MSG_LEN];
+		char		hint[COPY_WORKER_MSG_LEN];
+		char		context[COPY_WORKER_MSG_LEN];
+
+		strlcpy(message, (char *) slot->message, sizeof(message));
+		strlcpy(detail, (char *) slot->detail, sizeof(detail));
+		strlcpy(hint, (char *) slot->hint, sizeof(hint));
+		strlcpy(context, (char *) slot->context, sizeof(context));
+
+		ereport(ERROR,
+				(errcode(slot->sqlerrcode),
+				 errmsg_internal("%s", message),
+				 detail[0] ? errdetail("%s", detail) : 0,
+				 hint[0] ? errhint("%s", hint) : 0,
+				 context[0] ? errcontext("%s", context) : 0));
+	}
+	else if (status == COPY_WORKER_EXITED)
+		ereport(ERROR,
+				(errmsg("copy worker process exited unexpectedly")));
+}
+
+
+/********************************************************************
+ *					  WORKER SIDE
+ ********************************************************************/
+
+/*
+ * CopyWorkerRead
+ *		Read len bytes of data sent by the leader, waiting for them if needed.
+ *
+ * Returns false if the leader has gone away before sending them.  That's
+ * how the leader tells us that we are done.
+ */
+bool
+CopyWorkerRead(void *data, Size len)
+{
+	volatile CopyWorkerSlot *slot = MySlot;
+	char	   *p = (char *) data;
+
+	while (len > 0)
+	{
+		Size		n;
+
+		n = queue_read(&slot->input, p, len);
+		if (n > 0)
+		{
+			SetLatch(&CopyWorkerShmem->slots[slot->leader_slot].leaderLatch);
+			p += n;
+			len -= n;
+		}
+		else
+		{
+			bool		leader_attached;
+
+			SpinLockAcquire(&CopyWorkerShmem->mutex);
+			leader_attached = slot->leader_attached;
+			SpinLockRelease(&CopyWorkerShmem->mutex);
+
+			if (!leader_attached)
+			{
+				/* it might have sent more just before leaving, recheck */
+				if (queue_free_space(&slot->input) == COPY_WORKER_QUEUE_SIZE)
+					return false;
+				continue;
+			}
+
+			worker_wait();
+		}
+	}
+
+	return true;
+}
+
+/*
+ * CopyWorkerWrite
+ *		Send len bytes of data to the leader.
+ *
+ * If the leader goes away while we wait for it to make room in the queue,
+ * nobody is interested in our results anymore, and we just exit.
+ */
+void
+CopyWorkerWrite(const void *data, Size len)
+{
+	volatile CopyWorkerSlot *slot = MySlot;
+	const char *p = (const char *) data;
+
+	while (len > 0)
+	{
+		Size		n;
+
+		n = queue_write(&slot->output, p, len);
+		if (n > 0)
+		{
+			SetLatch(&CopyWorkerShmem->slots[slot->leader_slot].leaderLatch);
+			p += n;
+			len -= n;
+		}
+		else
+		{
+			bool		leader_attached;
+
+			SpinLockAcquire(&CopyWorkerShmem->mutex);
+			leader_attached = slot->leader_attached;
+			SpinLockRelease(&CopyWorkerShmem->mutex);
+
+			if (!leader_attached)
+				proc_exit(0);
+
+			worker_wait();
+		}
+	}
+}
+
+static void
+worker_wait(void)
+{
+	WaitLatch(&MySlot->workerLatch, 1000000L);
+	ResetLatch(&MySlot->workerLatch);
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Pass the error being handled on to the leader, which will report it.
+ */
+static void
+report_worker_error(void)
+{
+	volatile CopyWorkerSlot *slot = MySlot;
+	ErrorData  *edata;
+
+	/* CopyErrorData doesn't work in ErrorContext */
+	MemoryContextSwitchTo(TopMemoryContext);
+	edata = CopyErrorData();
+	FlushErrorState();
+
+	/* the leader reads these only after seeing the status change */
+	slot->sqlerrcode = edata->sqlerrcode;
+	strlcpy((char *) slot->message, edata->message ? edata->message : "",
+			COPY_WORKER_MSG_LEN);
+	strlcpy((char *) slot->detail, edata->detail ? edata->detail : "",
+			COPY_WORKER_MSG_LEN);
+	strlcpy((char *) slot->hint, edata->hint ? edata->hint : "",
+			COPY_WORKER_MSG_LEN);
+	strlcpy((char *) slot->context, edata->context ? edata->context : "",
+			COPY_WORKER_MSG_LEN);
+
+	SpinLockAcquire(&CopyWorkerShmem->mutex);
+	slot->status = COPY_WORKER_FAILED;
+	SpinLockRelease(&CopyWorkerShmem->mutex);
+
+	SetLatch(&CopyWorkerShmem->slots[slot->leader_slot].leaderLatch);
+}
+
+/*
+ * on_shmem_exit callback of a copy worker: detach from our slot.
+ */
+static void
+copy_worker_shmem_exit(int code, Datum arg)
+{
+	volatile CopyWorkerSlot *slot = MySlot;
+	int			leader_slot;
+
+	DisownLatch(&slot->workerLatch);
+
+	SpinLockAcquire(&CopyWorkerShmem->mutex);
+	if (slot->status == COPY_WORKER_STARTING ||
+		slot->status == COPY_WORKER_RUNNING)
+		slot->status = COPY_WORKER_EXITED;
+	slot->worker_attached = false;
+	if (!slot->leader_attached)
+		slot->in_use = false;
+	leader_slot = slot->leader_slot;
+	SpinLockRelease(&CopyWorkerShmem->mutex);
+
+	SetLatch(&CopyWorkerShmem->slots[leader_slot].leaderLatch);
+
+	MySlot = NULL;
+}
+
+
+/********************************************************************
+ *					  WORKER STARTUP
+ ********************************************************************/
+
+/*
+ * Called from postmaster to signal a failure to fork a copy worker.
+ */
+void
+CopyWorkerForkFailed(void)
+{
+	CopyWorkerShmem->forkFailed = true;
+}
+
+#ifdef EXEC_BACKEND
+/*
+ * forkexec routine for the copy worker.
+ *
+ * Format up the arglist, then fork and exec.
+ */
+static pid_t
+copyworker_forkexec(void)
+{
+	char	   *av[10];
+	int			ac = 0;
+
+	av[ac++] = "postgres";
+	av[ac++] = "--forkcopyworker";
+	av[ac++] = NULL;			/* filled in by postmaster_forkexec */
+	av[ac] = NULL;
+
+	Assert(ac < lengthof(av));
+
+	return postmaster_forkexec(ac, av);
+}
+#endif
+
+/*
+ * StartCopyWorker
+ *		Fork a copy worker process, called from postmaster.
+ */
+int
+StartCopyWorker(void)
+{
+	pid_t		worker_pid;
+
+#ifdef EXEC_BACKEND
+	switch ((worker_pid = copyworker_forkexec()))
+#else
+	switch ((worker_pid = fork_process()))
+#endif
+	{
+		case -1:
+			ereport(LOG,
+					(errmsg("could not fork copy worker process: %m")));
+			return 0;
+
+#ifndef EXEC_BACKEND
+		case 0:
+			/* in postmaster child ... */
+			/* Close the postmaster's sockets */
+			ClosePostmasterPorts(false);
+
+			/* Lose the postmaster's on-exit routines */
+			on_exit_reset();
+
+			CopyWorkerMain(0, NULL);
+			break;
+#endif
+		default:
+			return (int) worker_pid;
+	}
+
+	/* shouldn't get here */
+	return 0;
+}
+
+/*
+ * CopyWorkerMain
+ */
+NON_EXEC_STATIC void
+CopyWorkerMain(int argc, char *argv[])
+{
+	volatile CopyWorkerShmemStruct *cws;
+	sigjmp_buf	local_sigjmp_buf;
+	int			slotno;
+	Oid			dbid;
+	Oid			userid;
+	char		dbname[NAMEDATALEN];
+
+	/* we are a postmaster subprocess now */
+	IsUnderPostmaster = true;
+	am_copy_worker = true;
+
+	/* reset MyProcPid */
+	MyProcPid = getpid();
+
+	/* record Start Time for logging */
+	MyStartTime = time(NULL);
+
+	/* Identify myself via ps */
+	init_ps_display("copy worker process", "", "", "");
+
+	SetProcessingMode(InitProcessing);
+
+	/*
+	 * If possible, make this process a group leader, so that the postmaster
+	 * can signal any child processes too.
+	 */
+#ifdef HAVE_SETSID
+	if (setsid() < 0)
+		elog(FATAL, "setsid() failed: %m");
+#endif
+
+	/*
+	 * Set up signal handlers.  We operate on databases much like a regular
+	 * backend, so we use the same signal handling.  See equivalent code in
+	 * tcop/postgres.c.  We don't read postgresql.conf again during the short
+	 * life of a copy worker, so we can ignore SIGHUP.
+	 */
+	pqsignal(SIGHUP, SIG_IGN);
+	pqsignal(SIGINT, StatementCancelHandler);
+	pqsignal(SIGTERM, die);
+	pqsignal(SIGQUIT, quickdie);
+	pqsignal(SIGALRM, handle_sig_alarm);
+
+	pqsignal(SIGPIPE, SIG_IGN);
+	pqsignal(SIGUSR1, procsignal_sigusr1_handler);
+	pqsignal(SIGUSR2, SIG_IGN);
+	pqsignal(SIGFPE, FloatExceptionHandler);
+	pqsignal(SIGCHLD, SIG_DFL);
+
+	/*
+	 * Pick up the slot we were started for.  We do this before anything
+	 * that could fail, so that the leader learns about the failure when we
+	 * exit.  If there is no slot, the leader has given up on us already.
+	 */
+	cws = CopyWorkerShmem;
+	SpinLockAcquire(&cws->mutex);
+	slotno = cws->startingSlot;
+	if (slotno >= 0)
+	{
+		MySlot = &cws->slots[slotno];
+		MySlot->worker_attached = true;
+		cws->startingSlot = -1;
+	}
+	SpinLockRelease(&cws->mutex);
+
+	if (MySlot == NULL)
+	{
+		elog(DEBUG1, "copy worker started without a slot");
+		proc_exit(0);
+	}
+
+	dbid = MySlot->dbid;
+	userid = MySlot->userid;
+
+	OwnLatch(&MySlot->workerLatch);
+	on_shmem_exit(copy_worker_shmem_exit, 0);
+	SetLatch(&cws->slots[MySlot->leader_slot].leaderLatch);
+
+	/* Early initialization */
+	BaseInit();
+
+	/*
+	 * Create a per-backend PGPROC struct in shared memory, except in the
+	 * EXEC_BACKEND case where this was done in SubPostmasterMain.
+	 */
+#ifndef EXEC_BACKEND
+	InitProcess();
+#endif
+
+	/*
+	 * If an exception is encountered, processing resumes here.  We don't
+	 * report the error to the server log; the leader will report it.
+	 *
+	 * See notes in postgres.c about the design of this coding.
+	 */
+	if (sigsetjmp(local_sigjmp_buf, 1) != 0)
+	{
+		/* Since not using PG_TRY, must reset error stack by hand */
+		error_context_stack = NULL;
+
+		/* Prevents interrupts while cleaning up */
+		HOLD_INTERRUPTS();
+
+		report_worker_error();
+
+		/*
+		 * We can now go away.  ShutdownPostgres will abort our transaction,
+		 * and ProcKill will clean up the rest.
+		 */
+		proc_exit(0);
+	}
+
+	/* We can now handle ereport(ERROR) */
+	PG_exception_stack = &local_sigjmp_buf;
+
+	PG_SETMASK(&UnBlockSig);
+
+	/* statement_timeout of the leader's COPY applies, not our own */
+	SetConfigOption("statement_timeout", "0", PGC_SUSET, PGC_S_OVERRIDE);
+
+	/* Connect to the leader's database, and become the leader's user */
+	InitPostgres(NULL, dbid, NULL, dbname);
+	SetProcessingMode(NormalProcessing);
+	set_ps_display(dbname, false);
+
+	SetUserIdAndSecContext(userid, SECURITY_LOCAL_USERID_CHANGE);
+
+	SpinLockAcquire(&cws->mutex);
+	MySlot->status = COPY_WORKER_RUNNING;
+	SpinLockRelease(&cws->mutex);
+	SetLatch(&cws->slots[MySlot->leader_slot].leaderLatch);
+
+	/* Process data until the leader tells us it's done */
+	StartTransactionCommand();
+	CopyFromWorker();
+	CommitTransactionCommand();
+
+	proc_exit(0);
+}
+
+
+/********************************************************************
+ *					  SHARED QUEUES
+ ********************************************************************/
+
+/*
+ * Copy up to len bytes into the queue, as many as there is room for.
+ * Returns the number of bytes copied.
+ */
+static Size
+queue_write(volatile CopyWorkerQueue *queue, const char *data, Size len)
+{
+	uint64		written;
+	Size		n;
+	Size		offset;
+	Size		chunk;
+
+	n = Min(len, queue_free_space(queue));
+	if (n == 0)
+		return 0;
+
+	/* only we advance written, so it's safe to read it without the lock */
+	written = queue->written;
+	offset = written % COPY_WORKER_QUEUE_SIZE;
+	chunk = Min(n, COPY_WORKER_QUEUE_SIZE - offset);
+	memcpy((char *) queue->data + offset, data, chunk);
+	if (chunk < n)
+		memcpy((char *) queue->data, data + chunk, n - chunk);
+
+	SpinLockAcquire(&queue->mutex);
+	queue->written = written + n;
+	SpinLockRelease(&queue->mutex);
+
+	return n;
+}
+
+/*
+ * Copy up to len bytes out of the queue, as many as are available.
+ * Returns the number of bytes copied.
+ */
+static Size
+queue_read(volatile CopyWorkerQueue *queue, char *data, Size len)
+{
+	uint64		written;
+	uint64		read;
+	Size		n;
+	Size		offset;
+	Size		chunk;
+
+	SpinLockAcquire(&queue->mutex);
+	written = queue->written;
+	read = queue->read;
+	SpinLockRelease(&queue->mutex);
+
+	n = Min(len, written - read);
+	if (n == 0)
+		return 0;
+
+	offset = read % COPY_WORKER_QUEUE_SIZE;
+	chunk = Min(n, COPY_WORKER_QUEUE_SIZE - offset);
+	memcpy(data, (char *) queue->data + offset, chunk);
+	if (chunk < n)
+		memcpy(data + chunk, (char *) queue->data, n - chunk);
+
+	SpinLockAcquire(&queue->mutex);
+	queue->read = read + n;
+	SpinLockRelease(&queue->mutex);
+
+	return n;
+}
+
+/*
+ * How many bytes can be written to the queue right now?  Only the writer
+ * should ask, as the answer can only grow until it writes.
+ */
+static Size
+queue_free_space(volatile CopyWorkerQueue *queue)
+{
+	uint64		used;
+
+	SpinLockAcquire(&queue->mutex);
+	used = queue->written - queue->read;
+	SpinLockRelease(&queue->mutex);
+
+	return COPY_WORKER_QUEUE_SIZE - used;
+}
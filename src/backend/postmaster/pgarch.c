@@ -71,12 +71,34 @@
 
 #define NUM_ARCHIVE_RETRIES 3
 
+/*
+ * State of one archive command.  A slot is in use while its xlog name is
+ * set: either the command is running (pid != 0) or it failed and is waiting
+ * to be retried at retry_time.
+ */
+typedef struct ArchiveJob
+{
+	pid_t		pid;			/* PID of the running command, or 0 */
+	int			failures;		/* failed attempts so far */
+	time_t		retry_time;		/* when to retry after a failure */
+	char		xlog[MAX_XFN_CHARS + 1];	/* file being archived */
+	char		command[MAXPGPATH];		/* archive_command as executed */
+} ArchiveJob;
+
+
+/* ----------
+ * GUC parameters
+ * ----------
+ */
+int			max_archive_commands = 1;
 
 /* ----------
  * Local data
  * ----------
  */
 static time_t last_pgarch_start_time;
+
+static ArchiveJob archive_jobs[MAX_ARCHIVE_COMMANDS];
 static time_t last_sigterm_time = 0;
 
 /*
@@ -103,7 +125,11 @@ static void pgarch_waken(SIGNAL_ARGS);
 static void pgarch_waken_stop(SIGNAL_ARGS);
 static void pgarch_MainLoop(void);
 static void pgarch_ArchiverCopyLoop(void);
-static bool pgarch_archiveXlog(char *xlog);
+static int	pgarch_jobsInUse(void);
+static void pgarch_buildCommand(ArchiveJob *job);
+static bool pgarch_startJob(ArchiveJob *job);
+static bool pgarch_jobFinished(ArchiveJob *job, int rc);
+static bool pgarch_jobFailed(ArchiveJob *job);
 static bool pgarch_readyXlog(char *xlog);
 static void pgarch_archiveDone(char *xlog);
 
@@ -404,11 +430,16 @@ pgarch_MainLoop(void)
  * pgarch_ArchiverCopyLoop
  *
  * Archives all outstanding xlogs then returns
+ *
+ * Up to max_archive_commands archive commands are run at the same time,
+ * each on a different file.  We don't return until all of them have
+ * finished, so that a final cycle before shutdown really is final.
  */
 static void
 pgarch_ArchiverCopyLoop(void)
 {
-	char		xlog[MAX_XFN_CHARS + 1];
+	bool		give_up = false;
+	bool		rescan = true;
 
 	/*
 	 * loop through all xlogs with archive_status of .ready and archive
@@ -416,87 +447,164 @@ pgarch_ArchiverCopyLoop(void)
 	 * some backend will add files onto the list of those that need archiving
 	 * while we are still copying earlier archives
 	 */
-	while (pgarch_readyXlog(xlog))
+	for (;;)
 	{
-		int			failures = 0;
+		time_t		curtime;
+		int			nused;
+		int			i;
+
+		/*
+		 * Do not initiate any more archive commands after receiving SIGTERM,
+		 * nor after the postmaster has died unexpectedly. The first condition
+		 * is to try to keep from having init SIGKILL the command, and the
+		 * second is to avoid conflicts with another archiver spawned by a
+		 * newer postmaster.  Commands already running are still waited for.
+		 */
+		if (got_SIGTERM || !PostmasterIsAlive(true))
+			give_up = true;
+
+		/*
+		 * Check for config update.  This is so that we'll adopt a new setting
+		 * for archive_command as soon as possible, even if there is a backlog
+		 * of files to be archived.
+		 */
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
 
+		/* can't do anything if no command ... */
+		if (!give_up && !XLogArchiveCommandSet())
+		{
+			ereport(WARNING,
+					(errmsg("archive_mode enabled, yet archive_command is not set")));
+			give_up = true;
+		}
+
+#ifndef WIN32
+		/* Collect the archive commands that have finished */
 		for (;;)
 		{
-			/*
-			 * Do not initiate any more archive commands after receiving
-			 * SIGTERM, nor after the postmaster has died unexpectedly. The
-			 * first condition is to try to keep from having init SIGKILL the
-			 * command, and the second is to avoid conflicts with another
-			 * archiver spawned by a newer postmaster.
-			 */
-			if (got_SIGTERM || !PostmasterIsAlive(true))
-				return;
-
-			/*
-			 * Check for config update.  This is so that we'll adopt a new
-			 * setting for archive_command as soon as possible, even if there
-			 * is a backlog of files to be archived.
-			 */
-			if (got_SIGHUP)
-			{
-				got_SIGHUP = false;
-				ProcessConfigFile(PGC_SIGHUP);
-			}
+			pid_t		pid;
+			int			rc;
+
+			pid = waitpid(-1, &rc, WNOHANG);
+			if (pid <= 0)
+				break;
 
-			/* can't do anything if no command ... */
-			if (!XLogArchiveCommandSet())
+			for (i = 0; i < MAX_ARCHIVE_COMMANDS; i++)
 			{
-				ereport(WARNING,
-						(errmsg("archive_mode enabled, yet archive_command is not set")));
-				return;
+				if (archive_jobs[i].pid == pid)
+				{
+					archive_jobs[i].pid = 0;
+					if (!pgarch_jobFinished(&archive_jobs[i], rc))
+						give_up = true;
+					rescan = true;
+					break;
+				}
 			}
+		}
+#endif
+
+		/*
+		 * Relaunch failed commands whose retry delay has elapsed.  If we're
+		 * giving up, just forget about them; the files are still marked
+		 * .ready, so they'll be tried again in a later cycle.
+		 */
+		curtime = time(NULL);
+		for (i = 0; i < MAX_ARCHIVE_COMMANDS; i++)
+		{
+			ArchiveJob *job = &archive_jobs[i];
 
-			if (pgarch_archiveXlog(xlog))
+			if (job->xlog[0] == '\0' || job->pid != 0)
+				continue;
+			if (give_up)
+				job->xlog[0] = '\0';
+			else if (curtime >= job->retry_time)
 			{
-				/* successful */
-				pgarch_archiveDone(xlog);
-				break;			/* out of inner retry loop */
+				if (!pgarch_startJob(job))
+					give_up = true;
 			}
-			else
+		}
+
+		/* Fill the free slots with the oldest files waiting to be archived */
+		if (wakened)
+		{
+			wakened = false;
+			rescan = true;
+		}
+		while (!give_up && rescan &&
+			   pgarch_jobsInUse() < max_archive_commands)
+		{
+			ArchiveJob *job = NULL;
+
+			for (i = 0; i < MAX_ARCHIVE_COMMANDS; i++)
 			{
-				if (++failures >= NUM_ARCHIVE_RETRIES)
+				if (archive_jobs[i].xlog[0] == '\0')
 				{
-					ereport(WARNING,
-							(errmsg("transaction log file \"%s\" could not be archived: too many failures",
-									xlog)));
-					return;		/* give up archiving for now */
+					job = &archive_jobs[i];
+					break;
 				}
-				pg_usleep(1000000L);	/* wait a bit before retrying */
 			}
+			Assert(job != NULL);
+
+			if (!pgarch_readyXlog(job->xlog))
+			{
+				rescan = false;
+				break;
+			}
+			job->failures = 0;
+			if (!pgarch_startJob(job))
+				give_up = true;
 		}
+
+		nused = pgarch_jobsInUse();
+		if (nused == 0 && (give_up || !rescan))
+			return;
+
+		/* Wait a bit for the running commands to make progress */
+		pg_usleep(100000L);
 	}
 }
 
 /*
- * pgarch_archiveXlog
+ * pgarch_jobsInUse
  *
- * Invokes system(3) to copy one archive file to wherever it should go
+ * Returns the number of files that have an archive command running or
+ * waiting to be retried
+ */
+static int
+pgarch_jobsInUse(void)
+{
+	int			nused = 0;
+	int			i;
+
+	for (i = 0; i < MAX_ARCHIVE_COMMANDS; i++)
+	{
+		if (archive_jobs[i].xlog[0] != '\0')
+			nused++;
+	}
+	return nused;
+}
+
+/*
+ * pgarch_buildCommand
  *
- * Returns true if successful
+ * Constructs the archive_command to be executed for the job's file
  */
-static bool
-pgarch_archiveXlog(char *xlog)
+static void
+pgarch_buildCommand(ArchiveJob *job)
 {
-	char		xlogarchcmd[MAXPGPATH];
 	char		pathname[MAXPGPATH];
-	char		activitymsg[MAXFNAMELEN + 16];
 	char	   *dp;
 	char	   *endp;
 	const char *sp;
-	int			rc;
 
-	snprintf(pathname, MAXPGPATH, XLOGDIR "/%s", xlog);
+	snprintf(pathname, MAXPGPATH, XLOGDIR "/%s", job->xlog);
 
-	/*
-	 * construct the command to be executed
-	 */
-	dp = xlogarchcmd;
-	endp = xlogarchcmd + MAXPGPATH - 1;
+	dp = job->command;
+	endp = job->command + MAXPGPATH - 1;
 	*endp = '\0';
 
 	for (sp = XLogArchiveCommand; *sp; sp++)
@@ -515,7 +623,7 @@ pgarch_archiveXlog(char *xlog)
 				case 'f':
 					/* %f: filename of source file */
 					sp++;
-					strlcpy(dp, xlog, endp - dp);
+					strlcpy(dp, job->xlog, endp - dp);
 					dp += strlen(dp);
 					break;
 				case '%':
@@ -538,16 +646,67 @@ pgarch_archiveXlog(char *xlog)
 		}
 	}
 	*dp = '\0';
+}
+
+/*
+ * pgarch_startJob
+ *
+ * Launches the archive command for one file.  On Windows, the command is
+ * run synchronously with system(3) and has finished when we return.
+ *
+ * Returns false if the file has now failed too many times, and archiving
+ * should be given up for this cycle
+ */
+static bool
+pgarch_startJob(ArchiveJob *job)
+{
+	char		activitymsg[MAXFNAMELEN + 16];
+
+	pgarch_buildCommand(job);
 
 	ereport(DEBUG3,
 			(errmsg_internal("executing archive command \"%s\"",
-							 xlogarchcmd)));
+							 job->command)));
 
 	/* Report archive activity in PS display */
-	snprintf(activitymsg, sizeof(activitymsg), "archiving %s", xlog);
+	snprintf(activitymsg, sizeof(activitymsg), "archiving %s", job->xlog);
 	set_ps_display(activitymsg, false);
 
-	rc = system(xlogarchcmd);
+#ifndef WIN32
+	job->pid = fork_process();
+	if (job->pid == 0)
+	{
+		/* in child: run the command the same way system(3) would */
+		execl("/bin/sh", "sh", "-c", job->command, (char *) NULL);
+		_exit(127);
+	}
+	if (job->pid < 0)
+	{
+		job->pid = 0;
+		ereport(LOG,
+				(errmsg("could not fork archive command: %m")));
+		return pgarch_jobFailed(job);
+	}
+	return true;
+#else
+	return pgarch_jobFinished(job, system(job->command));
+#endif
+}
+
+/*
+ * pgarch_jobFinished
+ *
+ * Deals with the exit status of an archive command.  On success, the file
+ * is marked as archived and the job's slot is freed; on failure, the
+ * command is scheduled to be retried.
+ *
+ * Returns false if the file has now failed too many times
+ */
+static bool
+pgarch_jobFinished(ArchiveJob *job, int rc)
+{
+	char		activitymsg[MAXFNAMELEN + 16];
+
 	if (rc != 0)
 	{
 		/*
@@ -568,7 +727,7 @@ pgarch_archiveXlog(char *xlog)
 					(errmsg("archive command failed with exit code %d",
 							WEXITSTATUS(rc)),
 					 errdetail("The failed archive command was: %s",
-							   xlogarchcmd)));
+							   job->command)));
 		}
 		else if (WIFSIGNALED(rc))
 		{
@@ -578,20 +737,20 @@ pgarch_archiveXlog(char *xlog)
 						  WTERMSIG(rc)),
 				   errhint("See C include file \"ntstatus.h\" for a description of the hexadecimal value."),
 				   errdetail("The failed archive command was: %s",
-							 xlogarchcmd)));
+							 job->command)));
 #elif defined(HAVE_DECL_SYS_SIGLIST) && HAVE_DECL_SYS_SIGLIST
 			ereport(lev,
 					(errmsg("archive command was terminated by signal %d: %s",
 							WTERMSIG(rc),
 			  WTERMSIG(rc) < NSIG ? sys_siglist[WTERMSIG(rc)] : "(unknown)"),
 					 errdetail("The failed archive command was: %s",
-							   xlogarchcmd)));
+							   job->command)));
 #else
 			ereport(lev,
 					(errmsg("archive command was terminated by signal %d",
 							WTERMSIG(rc)),
 					 errdetail("The failed archive command was: %s",
-							   xlogarchcmd)));
+							   job->command)));
 #endif
 		}
 		else
@@ -600,31 +759,57 @@ pgarch_archiveXlog(char *xlog)
 				(errmsg("archive command exited with unrecognized status %d",
 						rc),
 				 errdetail("The failed archive command was: %s",
-						   xlogarchcmd)));
+						   job->command)));
 		}
 
-		snprintf(activitymsg, sizeof(activitymsg), "failed on %s", xlog);
+		snprintf(activitymsg, sizeof(activitymsg), "failed on %s", job->xlog);
 		set_ps_display(activitymsg, false);
 
-		return false;
+		return pgarch_jobFailed(job);
 	}
+
 	ereport(DEBUG1,
-			(errmsg("archived transaction log file \"%s\"", xlog)));
+			(errmsg("archived transaction log file \"%s\"", job->xlog)));
+
+	pgarch_archiveDone(job->xlog);
 
-	snprintf(activitymsg, sizeof(activitymsg), "last was %s", xlog);
+	snprintf(activitymsg, sizeof(activitymsg), "last was %s", job->xlog);
 	set_ps_display(activitymsg, false);
 
+	job->xlog[0] = '\0';
+	return true;
+}
+
+/*
+ * pgarch_jobFailed
+ *
+ * Schedules a failed archive command to be retried after a short wait,
+ * unless it has already failed NUM_ARCHIVE_RETRIES times, in which case
+ * the slot is freed and false is returned.
+ */
+static bool
+pgarch_jobFailed(ArchiveJob *job)
+{
+	if (++job->failures >= NUM_ARCHIVE_RETRIES)
+	{
+		ereport(WARNING,
+				(errmsg("transaction log file \"%s\" could not be archived: too many failures",
+						job->xlog)));
+		job->xlog[0] = '\0';
+		return false;			/* give up archiving for now */
+	}
+	job->retry_time = time(NULL) + 1;	/* wait a bit before retrying */
 	return true;
 }
 
 /*
  * pgarch_readyXlog
  *
- * Return name of the oldest xlog file that has not yet been archived.
- * No notification is set that file archiving is now in progress, so
- * this would need to be extended if multiple concurrent archival
- * tasks were created. If a failure occurs, we will completely
- * re-copy the file at the next available opportunity.
+ * Return name of the oldest xlog file that has not yet been archived,
+ * skipping the files that already have an archive command in progress.
+ * No notification of that is kept outside this process, so if a failure
+ * occurs, we will completely re-copy the file at the next available
+ * opportunity.
  *
  * It is important that we return the oldest, so that we archive xlogs
  * in order that they were written, for two reasons:
@@ -670,6 +855,19 @@ pgarch_readyXlog(char *xlog)
 			strspn(rlde->d_name, VALID_XFN_CHARS) >= basenamelen &&
 			strcmp(rlde->d_name + basenamelen, ".ready") == 0)
 		{
+			int			i;
+
+			for (i = 0; i < MAX_ARCHIVE_COMMANDS; i++)
+			{
+				if (archive_jobs[i].xlog[0] != '\0' &&
+					strncmp(archive_jobs[i].xlog, rlde->d_name,
+							basenamelen) == 0 &&
+					archive_jobs[i].xlog[basenamelen] == '\0')
+					break;
+			}
+			if (i < MAX_ARCHIVE_COMMANDS)
+				continue;		/* already being archived */
+
 			if (!found)
 			{
 				strcpy(newxlog, rlde->d_name);
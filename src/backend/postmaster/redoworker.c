@@ -0,0 +1,1048 @@
+/*-------------------------------------------------------------------------
+ *
+ * redoworker.c
+ *
+ * Worker processes for parallel WAL redo.
+ *
+ * During archive recovery, the startup process can hand WAL records to a
+ * set of redo workers instead of replaying them all itself.  The startup
+ * process keeps reading and checking the WAL; each record whose replay only
+ * touches a single data block (as reported by the resource manager's
+ * rm_blockrefs function) is queued to the worker chosen by hashing that
+ * block's relfilenode and block number.  All records for a given block thus
+ * go to the same worker, in WAL order, and blocks that hash to different
+ * workers are replayed concurrently.
+ *
+ * Every other record acts as a barrier: the startup process waits until
+ * the workers have replayed everything queued to them, and then replays
+ * the record itself.  That covers records touching several blocks (which
+ * could belong to different workers), records whose replay keeps state in
+ * the startup process (btree incomplete splits, the known-assigned XIDs of
+ * hot standby) or resolves conflicts with hot standby queries, and records
+ * such as checkpoints, clog pages and DDL that later records rely on.
+ * Transaction commit and abort records only wait when they drop relation
+ * files or hot standby is enabled: otherwise they only touch the clog,
+ * which redo of data records never looks at.
+ *
+ * Redo workers are auxiliary processes.  The startup process asks the
+ * postmaster to launch them when archive recovery starts, and tells them to
+ * exit when redo is done.  A worker that hits an error exits, and the
+ * startup process then fails too.  References to missing pages found by a
+ * worker are passed back to the startup process, which keeps track of them
+ * together with the drops and truncations that explain them (see
+ * xlogutils.c).  When the startup process replays a record that drops or
+ * truncates relation files, it makes the workers close their files before
+ * they replay anything else.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "access/hash.h"
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog_internal.h"
+#include "access/xlogutils.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "postmaster/redoworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/pmsignal.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * GUC parameters
+ */
+int			recovery_parallel_workers = 0;
+
+/* how long to wait for the workers to show up, in milliseconds */
+#define REDO_WORKER_START_TIMEOUT	10000
+
+/* how many missing-page references a worker can hold for collection */
+#define REDO_WORKER_MAX_INVALID		32
+
+/*
+ * A single-reader, single-writer queue of WAL records, as in copyworker.c.
+ * written and read count the bytes that have gone through the queue.  The
+ * worker only advances read once it has replayed a record, so an empty
+ * queue means that the worker has caught up.
+ */
+typedef struct RedoWorkerQueue
+{
+	slock_t		mutex;
+	uint64		written;
+	uint64		read;
+	char		data[REDO_WORKER_QUEUE_SIZE];
+} RedoWorkerQueue;
+
+/* Header of a queue entry; the record itself follows */
+typedef struct RedoQueueEntry
+{
+	XLogRecPtr	lsn;			/* end of the record, as passed to rm_redo */
+	uint32		len;			/* length of the record */
+} RedoQueueEntry;
+
+#define RedoQueueEntrySize(len) MAXALIGN(sizeof(RedoQueueEntry) + (len))
+
+typedef struct RedoInvalidPage
+{
+	RelFileNode node;
+	ForkNumber	forkno;
+	BlockNumber blkno;
+	bool		present;
+} RedoInvalidPage;
+
+typedef struct RedoWorkerSlot
+{
+	/* these fields are protected by RedoWorkerShmem->mutex */
+	pid_t		pid;			/* PID of the attached worker, or 0 */
+	bool		exited;			/* attached worker has gone away */
+
+	/* set by the startup process to wake up the worker */
+	Latch		workerLatch;
+
+	/* references to missing pages, not yet collected by the startup process */
+	slock_t		invalid_mutex;
+	int			ninvalid;
+	RedoInvalidPage invalid[REDO_WORKER_MAX_INVALID];
+
+	RedoWorkerQueue queue;
+} RedoWorkerSlot;
+
+typedef struct RedoWorkerShmemStruct
+{
+	slock_t		mutex;
+	int			nworkers;		/* number of slots attached to */
+	bool		accepting;		/* can more workers attach? */
+	bool		stop;			/* tells the workers to exit */
+
+	/*
+	 * Advanced by the startup process when it has replayed a record that
+	 * drops or truncates relation files.  Workers close all their files when
+	 * they see it change.
+	 */
+	uint32		closeGeneration;
+
+	/* set by the workers to wake up the startup process */
+	Latch		startupLatch;
+
+	RedoWorkerSlot slots[1];	/* VARIABLE LENGTH ARRAY */
+} RedoWorkerShmemStruct;
+
+static RedoWorkerShmemStruct *RedoWorkerShmem;
+
+/* Used by rm_blockrefs callback to choose the worker for a record */
+typedef struct RedoTarget
+{
+	int			worker;			/* worker for the blocks seen so far, or -1 */
+	bool		conflict;		/* blocks belong to different workers */
+} RedoTarget;
+
+/* State of the startup process */
+static int	nRedoWorkers = 0;
+static bool startup_exit_registered = false;
+
+/* State of a worker process */
+static volatile RedoWorkerSlot *MySlot = NULL;
+static MemoryContext RedoContext = NULL;
+static char *recordBuf = NULL;
+static uint32 recordBufSize = 0;
+static uint32 closeGeneration = 0;
+
+/* Flags set by signal handlers */
+static volatile sig_atomic_t got_SIGHUP = false;
+static volatile sig_atomic_t shutdown_requested = false;
+
+static void choose_worker(RelFileNode rnode, ForkNumber forknum,
+			  BlockNumber blkno, bool needs_read, void *arg);
+static bool record_closes_files(XLogRecord *record);
+static void queue_record(int worker, XLogRecPtr lsn, XLogRecord *record);
+static void startup_wait(void);
+static void collect_invalid_pages(void);
+static void startup_shmem_exit(int code, Datum arg);
+static void worker_wait(void);
+static bool worker_read_record(XLogRecPtr *lsn, Size *entrysize);
+static void worker_error_callback(void *arg);
+static void worker_shmem_exit(int code, Datum arg);
+static void redo_worker_quickdie(SIGNAL_ARGS);
+static void RedoWorkerSigHupHandler(SIGNAL_ARGS);
+static void RedoWorkerShutdownHandler(SIGNAL_ARGS);
+static void RedoWorkerSigUsr1Handler(SIGNAL_ARGS);
+static void queue_put(volatile RedoWorkerQueue *queue, const RedoQueueEntry *entry,
+		  const char *data);
+static void queue_copy_in(volatile RedoWorkerQueue *queue, uint64 pos,
+			  const char *data, Size len);
+static void queue_copy_out(volatile RedoWorkerQueue *queue, uint64 pos,
+			   char *data, Size len);
+static Size queue_used(volatile RedoWorkerQueue *queue);
+
+
+/*
+ * RedoWorkerShmemSize
+ *		Compute space needed for redo worker related shared memory
+ */
+Size
+RedoWorkerShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(RedoWorkerShmemStruct, slots);
+	size = add_size(size, mul_size(recovery_parallel_workers,
+								   sizeof(RedoWorkerSlot)));
+
+	return size;
+}
+
+/*
+ * RedoWorkerShmemInit
+ *		Allocate and initialize redo worker related shared memory
+ */
+void
+RedoWorkerShmemInit(void)
+{
+	bool		found;
+
+	RedoWorkerShmem = (RedoWorkerShmemStruct *)
+		ShmemInitStruct("Redo Worker Data", RedoWorkerShmemSize(), &found);
+
+	if (!IsUnderPostmaster)
+	{
+		int			i;
+
+		Assert(!found);
+
+		SpinLockInit(&RedoWorkerShmem->mutex);
+		RedoWorkerShmem->nworkers = 0;
+		RedoWorkerShmem->accepting = false;
+		RedoWorkerShmem->stop = false;
+		RedoWorkerShmem->closeGeneration = 0;
+		InitSharedLatch(&RedoWorkerShmem->startupLatch);
+
+		for (i = 0; i < recovery_parallel_workers; i++)
+		{
+			RedoWorkerSlot *slot = &RedoWorkerShmem->slots[i];
+
+			slot->pid = 0;
+			slot->exited = false;
+			InitSharedLatch(&slot->workerLatch);
+			SpinLockInit(&slot->invalid_mutex);
+			slot->ninvalid = 0;
+			SpinLockInit(&slot->queue.mutex);
+			slot->queue.written = slot->queue.read = 0;
+		}
+	}
+	else
+		Assert(found);
+}
+
+
+/********************************************************************
+ *					  STARTUP PROCESS SIDE
+ ********************************************************************/
+
+/*
+ * RedoWorkersStart
+ *		Launch the redo workers, if recovery_parallel_workers is set.
+ *
+ * Returns true if at least one worker could be started, in which case
+ * RedoWorkerDispatch hands records to them until RedoWorkersStop.
+ */
+bool
+RedoWorkersStart(void)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+	TimestampTz start_time;
+	int			i;
+
+	if (recovery_parallel_workers == 0 || !IsUnderPostmaster)
+		return false;
+
+	SpinLockAcquire(&rws->mutex);
+	rws->nworkers = 0;
+	rws->accepting = true;
+	rws->stop = false;
+	for (i = 0; i < recovery_parallel_workers; i++)
+	{
+		volatile RedoWorkerSlot *slot = &rws->slots[i];
+
+		slot->pid = 0;
+		slot->exited = false;
+		slot->ninvalid = 0;
+		slot->queue.written = slot->queue.read = 0;
+	}
+	SpinLockRelease(&rws->mutex);
+
+	OwnLatch(&RedoWorkerShmem->startupLatch);
+	if (!startup_exit_registered)
+	{
+		on_shmem_exit(startup_shmem_exit, 0);
+		startup_exit_registered = true;
+	}
+
+	SendPostmasterSignal(PMSIGNAL_START_REDO_WORKERS);
+
+	/* Wait for the workers to attach, but not forever */
+	start_time = GetCurrentTimestamp();
+	for (;;)
+	{
+		int			nattached;
+
+		ResetLatch(&RedoWorkerShmem->startupLatch);
+
+		SpinLockAcquire(&rws->mutex);
+		nattached = rws->nworkers;
+		SpinLockRelease(&rws->mutex);
+
+		if (nattached >= recovery_parallel_workers ||
+			TimestampDifferenceExceeds(start_time, GetCurrentTimestamp(),
+									   REDO_WORKER_START_TIMEOUT))
+			break;
+
+		HandleStartupProcInterrupts();
+		WaitLatch(&RedoWorkerShmem->startupLatch, 100000L);
+	}
+
+	/* Latecomers will find that they are not needed, and exit */
+	SpinLockAcquire(&rws->mutex);
+	rws->accepting = false;
+	nRedoWorkers = rws->nworkers;
+	SpinLockRelease(&rws->mutex);
+
+	if (nRedoWorkers < recovery_parallel_workers)
+		ereport(LOG,
+				(errmsg("could only start %d of %d redo worker processes",
+						nRedoWorkers, recovery_parallel_workers)));
+
+	if (nRedoWorkers == 0)
+	{
+		DisownLatch(&RedoWorkerShmem->startupLatch);
+		return false;
+	}
+
+	ereport(LOG,
+			(errmsg("parallel redo started with %d worker processes",
+					nRedoWorkers)));
+	return true;
+}
+
+/*
+ * RedoWorkerDispatch
+ *		Queue a WAL record to a redo worker, if possible.
+ *
+ * Returns true if a worker will replay the record.  Otherwise the caller
+ * must replay it; in that case we have already waited for the workers to
+ * replay everything that the record could depend on.
+ */
+bool
+RedoWorkerDispatch(XLogRecPtr lsn, XLogRecord *record)
+{
+	const RmgrData *rmgr = &RmgrTable[record->xl_rmid];
+	RedoTarget	target;
+
+	if (nRedoWorkers == 0)
+		return false;
+
+	/*
+	 * Hand the record to a worker if its resource manager says that the
+	 * reported blocks are all it touches, and they all hash to the same
+	 * worker.  A record that is too big for the queue is replayed here.
+	 */
+	if (rmgr->rm_blockrefs != NULL &&
+		RedoQueueEntrySize(record->xl_tot_len) <= REDO_WORKER_QUEUE_SIZE)
+	{
+		target.worker = -1;
+		target.conflict = false;
+		if (rmgr->rm_blockrefs(record, choose_worker, &target) &&
+			target.worker >= 0 && !target.conflict)
+		{
+			queue_record(target.worker, lsn, record);
+			return true;
+		}
+	}
+
+	/*
+	 * A transaction commit or abort only touches the clog, which redo of the
+	 * records in the queues never looks at.  But once hot standby queries
+	 * could be running, the data changes of a transaction must be in place
+	 * before it is shown as committed.
+	 */
+	if (record->xl_rmid == RM_XACT_ID &&
+		standbyState == STANDBY_DISABLED &&
+		!record_closes_files(record))
+		return false;
+
+	/* Anything else waits for the workers to catch up */
+	RedoWorkersWaitIdle();
+
+	if (record_closes_files(record))
+	{
+		volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+
+		/*
+		 * The workers are idle, and won't replay anything else before we
+		 * queue the next record, by which time the files are gone.
+		 */
+		SpinLockAcquire(&rws->mutex);
+		rws->closeGeneration++;
+		SpinLockRelease(&rws->mutex);
+	}
+
+	return false;
+}
+
+/*
+ * RedoWorkersWaitIdle
+ *		Wait until the redo workers have replayed all queued records.
+ *
+ * Missing-page references found by the workers have been passed to
+ * xlogutils.c by the time we return.
+ */
+void
+RedoWorkersWaitIdle(void)
+{
+	int			i;
+
+	if (nRedoWorkers == 0)
+		return;
+
+	for (;;)
+	{
+		bool		idle = true;
+
+		ResetLatch(&RedoWorkerShmem->startupLatch);
+
+		for (i = 0; i < nRedoWorkers; i++)
+		{
+			if (queue_used(&RedoWorkerShmem->slots[i].queue) > 0)
+			{
+				idle = false;
+				break;
+			}
+		}
+		if (idle)
+			break;
+
+		startup_wait();
+	}
+
+	collect_invalid_pages();
+}
+
+/*
+ * RedoWorkersStop
+ *		Wait for the redo workers to finish their queues, and let them go.
+ */
+void
+RedoWorkersStop(void)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+	int			i;
+
+	if (nRedoWorkers == 0)
+		return;
+
+	RedoWorkersWaitIdle();
+
+	SpinLockAcquire(&rws->mutex);
+	rws->stop = true;
+	SpinLockRelease(&rws->mutex);
+
+	for (i = 0; i < nRedoWorkers; i++)
+		SetLatch(&RedoWorkerShmem->slots[i].workerLatch);
+
+	/* Wait for them to exit */
+	for (;;)
+	{
+		bool		alldone = true;
+
+		ResetLatch(&RedoWorkerShmem->startupLatch);
+
+		SpinLockAcquire(&rws->mutex);
+		for (i = 0; i < nRedoWorkers; i++)
+		{
+			if (rws->slots[i].pid != 0)
+				alldone = false;
+		}
+		SpinLockRelease(&rws->mutex);
+
+		if (alldone)
+			break;
+
+		HandleStartupProcInterrupts();
+		WaitLatch(&RedoWorkerShmem->startupLatch, 1000000L);
+	}
+
+	nRedoWorkers = 0;
+	DisownLatch(&RedoWorkerShmem->startupLatch);
+}
+
+/*
+ * Callback for rm_blockrefs: find the worker responsible for a block.
+ */
+static void
+choose_worker(RelFileNode rnode, ForkNumber forknum, BlockNumber blkno,
+			  bool needs_read, void *arg)
+{
+	RedoTarget *target = (RedoTarget *) arg;
+	struct
+	{
+		RelFileNode rnode;
+		BlockNumber blkno;
+	}			key;
+	int			worker;
+
+	/* the struct has no padding, so we can hash it as a whole */
+	key.rnode = rnode;
+	key.blkno = blkno;
+	worker = DatumGetUInt32(hash_any((unsigned char *) &key, sizeof(key))) %
+		nRedoWorkers;
+
+	if (target->worker < 0)
+		target->worker = worker;
+	else if (target->worker != worker)
+		target->conflict = true;
+}
+
+/*
+ * Does replay of the record unlink or truncate relation files?
+ */
+static bool
+record_closes_files(XLogRecord *record)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *rec = XLogRecGetData(record);
+
+	switch (record->xl_rmid)
+	{
+		case RM_SMGR_ID:
+		case RM_DBASE_ID:
+		case RM_TBLSPC_ID:
+			return true;
+
+		case RM_XACT_ID:
+			switch (info)
+			{
+				case XLOG_XACT_COMMIT:
+					return ((xl_xact_commit *) rec)->nrels > 0;
+				case XLOG_XACT_ABORT:
+					return ((xl_xact_abort *) rec)->nrels > 0;
+				case XLOG_XACT_COMMIT_PREPARED:
+					return ((xl_xact_commit_prepared *) rec)->crec.nrels > 0;
+				case XLOG_XACT_ABORT_PREPARED:
+					return ((xl_xact_abort_prepared *) rec)->arec.nrels > 0;
+			}
+			return false;
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Add a record to a worker's queue, waiting for room if necessary.
+ */
+static void
+queue_record(int worker, XLogRecPtr lsn, XLogRecord *record)
+{
+	volatile RedoWorkerSlot *slot = &RedoWorkerShmem->slots[worker];
+	RedoQueueEntry entry;
+	Size		size;
+
+	entry.lsn = lsn;
+	entry.len = record->xl_tot_len;
+	size = RedoQueueEntrySize(entry.len);
+
+	for (;;)
+	{
+		ResetLatch(&RedoWorkerShmem->startupLatch);
+		if (REDO_WORKER_QUEUE_SIZE - queue_used(&slot->queue) >= size)
+			break;
+		SetLatch(&slot->workerLatch);
+		startup_wait();
+	}
+
+	queue_put(&slot->queue, &entry, (char *) record);
+
+	/* this is cheap if the worker is busy and the latch is already set */
+	SetLatch(&slot->workerLatch);
+}
+
+/*
+ * Wait for a worker to make progress.  The caller must have reset the
+ * latch before checking its condition.
+ */
+static void
+startup_wait(void)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+	int			i;
+
+	/* a worker may be waiting for us to make room for its reports */
+	collect_invalid_pages();
+
+	SpinLockAcquire(&rws->mutex);
+	for (i = 0; i < nRedoWorkers; i++)
+	{
+		if (rws->slots[i].exited)
+		{
+			SpinLockRelease(&rws->mutex);
+			ereport(FATAL,
+					(errmsg("redo worker process %d exited unexpectedly",
+							i)));
+		}
+	}
+	SpinLockRelease(&rws->mutex);
+
+	HandleStartupProcInterrupts();
+	WaitLatch(&RedoWorkerShmem->startupLatch, 1000000L);
+}
+
+/*
+ * Take over the missing-page references reported by the workers.
+ */
+static void
+collect_invalid_pages(void)
+{
+	RedoInvalidPage pages[REDO_WORKER_MAX_INVALID];
+	int			i;
+	int			j;
+
+	for (i = 0; i < nRedoWorkers; i++)
+	{
+		volatile RedoWorkerSlot *slot = &RedoWorkerShmem->slots[i];
+		int			n;
+
+		if (slot->ninvalid == 0)
+			continue;
+
+		SpinLockAcquire(&slot->invalid_mutex);
+		n = slot->ninvalid;
+		memcpy(pages, (char *) slot->invalid, n * sizeof(RedoInvalidPage));
+		slot->ninvalid = 0;
+		SpinLockRelease(&slot->invalid_mutex);
+
+		SetLatch(&slot->workerLatch);
+
+		for (j = 0; j < n; j++)
+			XLogRememberInvalidPage(pages[j].node, pages[j].forkno,
+									pages[j].blkno, pages[j].present);
+	}
+}
+
+/*
+ * If the startup process exits without RedoWorkersStop, for example because
+ * of an error or a shutdown request, tell the workers to exit as well.
+ */
+static void
+startup_shmem_exit(int code, Datum arg)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+	int			i;
+
+	if (nRedoWorkers == 0)
+		return;
+
+	SpinLockAcquire(&rws->mutex);
+	rws->stop = true;
+	SpinLockRelease(&rws->mutex);
+
+	for (i = 0; i < nRedoWorkers; i++)
+		SetLatch(&RedoWorkerShmem->slots[i].workerLatch);
+	nRedoWorkers = 0;
+}
+
+
+/********************************************************************
+ *					  WORKER SIDE
+ ********************************************************************/
+
+/*
+ * RedoWorkerMain
+ *		Main entry point for a redo worker process.
+ */
+void
+RedoWorkerMain(void)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+	int			slotno = -1;
+
+	/*
+	 * Properly accept or ignore signals the postmaster might send us.
+	 */
+	pqsignal(SIGHUP, RedoWorkerSigHupHandler);	/* reload config file */
+	pqsignal(SIGINT, SIG_IGN);
+	pqsignal(SIGTERM, RedoWorkerShutdownHandler);	/* request shutdown */
+	pqsignal(SIGQUIT, redo_worker_quickdie);	/* hard crash time */
+	pqsignal(SIGALRM, SIG_IGN);
+	pqsignal(SIGPIPE, SIG_IGN);
+	pqsignal(SIGUSR1, RedoWorkerSigUsr1Handler);
+	pqsignal(SIGUSR2, SIG_IGN);
+
+	/*
+	 * Reset some signals that are accepted by postmaster but not here
+	 */
+	pqsignal(SIGCHLD, SIG_DFL);
+	pqsignal(SIGTTIN, SIG_DFL);
+	pqsignal(SIGTTOU, SIG_DFL);
+	pqsignal(SIGCONT, SIG_DFL);
+	pqsignal(SIGWINCH, SIG_DFL);
+
+	PG_SETMASK(&UnBlockSig);
+
+	/* Take the next free slot, if the startup process still wants us */
+	SpinLockAcquire(&rws->mutex);
+	if (rws->accepting && !rws->stop &&
+		rws->nworkers < recovery_parallel_workers)
+	{
+		slotno = rws->nworkers++;
+		rws->slots[slotno].pid = MyProcPid;
+	}
+	SpinLockRelease(&rws->mutex);
+
+	if (slotno < 0)
+		proc_exit(0);
+
+	MySlot = &rws->slots[slotno];
+	OwnLatch(&MySlot->workerLatch);
+	on_shmem_exit(worker_shmem_exit, 0);
+	SetLatch(&RedoWorkerShmem->startupLatch);
+
+	/* Redo routines behave differently in recovery */
+	InRecovery = true;
+
+	RedoContext = AllocSetContextCreate(TopMemoryContext,
+										"Redo Worker",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	/*
+	 * Replay records until told to stop.  An error is turned into FATAL,
+	 * as we have no error recovery, and the startup process notices that
+	 * we are gone.
+	 */
+	for (;;)
+	{
+		XLogRecPtr	lsn;
+		Size		entrysize;
+		XLogRecord *record;
+		ErrorContextCallback errcontext;
+		MemoryContext oldcxt;
+		uint32		generation;
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+		if (shutdown_requested || rws->stop)
+			proc_exit(0);
+
+		if (!worker_read_record(&lsn, &entrysize))
+		{
+			worker_wait();
+			continue;
+		}
+		record = (XLogRecord *) recordBuf;
+
+		/*
+		 * If files have been dropped since the last record, close ours; a
+		 * relfilenode can be reused for a new relation.
+		 */
+		generation = rws->closeGeneration;
+		if (generation != closeGeneration)
+		{
+			smgrcloseall();
+			closeGeneration = generation;
+		}
+
+		errcontext.callback = worker_error_callback;
+		errcontext.arg = (void *) record;
+		errcontext.previous = error_context_stack;
+		error_context_stack = &errcontext;
+
+		oldcxt = MemoryContextSwitchTo(RedoContext);
+		RmgrTable[record->xl_rmid].rm_redo(lsn, record);
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextReset(RedoContext);
+
+		error_context_stack = errcontext.previous;
+
+		/* Done with the record, remove it from the queue */
+		SpinLockAcquire(&MySlot->queue.mutex);
+		MySlot->queue.read += entrysize;
+		SpinLockRelease(&MySlot->queue.mutex);
+
+		SetLatch(&RedoWorkerShmem->startupLatch);
+	}
+}
+
+/*
+ * RedoWorkerReportInvalidPage
+ *		Pass a reference to a missing page on to the startup process.
+ */
+void
+RedoWorkerReportInvalidPage(RelFileNode node, ForkNumber forkno,
+							BlockNumber blkno, bool present)
+{
+	Assert(MySlot != NULL);
+
+	for (;;)
+	{
+		bool		added = false;
+
+		SpinLockAcquire(&MySlot->invalid_mutex);
+		if (MySlot->ninvalid < REDO_WORKER_MAX_INVALID)
+		{
+			volatile RedoInvalidPage *page = &MySlot->invalid[MySlot->ninvalid++];
+
+			page->node = node;
+			page->forkno = forkno;
+			page->blkno = blkno;
+			page->present = present;
+			added = true;
+		}
+		SpinLockRelease(&MySlot->invalid_mutex);
+
+		if (added)
+			break;
+
+		/* full; the startup process collects them whenever it waits */
+		SetLatch(&RedoWorkerShmem->startupLatch);
+		worker_wait();
+	}
+}
+
+/*
+ * Wait for the startup process to give us something to do.
+ */
+static void
+worker_wait(void)
+{
+	ResetLatch(&MySlot->workerLatch);
+
+	/*
+	 * Recheck, in case the startup process set the latch before the reset.
+	 * We can go on if there is a record to replay and room to report missing
+	 * pages; the latter only runs out in RedoWorkerReportInvalidPage.
+	 */
+	if (queue_used(&MySlot->queue) > 0 &&
+		MySlot->ninvalid < REDO_WORKER_MAX_INVALID)
+		return;
+	if (shutdown_requested || RedoWorkerShmem->stop)
+		return;
+
+	/*
+	 * Emergency bailout if postmaster has died.  This is to avoid the
+	 * necessity for manual cleanup of all postmaster children.
+	 */
+	if (!PostmasterIsAlive(true))
+		exit(1);
+
+	WaitLatch(&MySlot->workerLatch, 1000000L);
+}
+
+/*
+ * Copy the next record in our queue into recordBuf.  Returns false if the
+ * queue is empty.  The record stays in the queue until the caller advances
+ * the read position by *entrysize.
+ */
+static bool
+worker_read_record(XLogRecPtr *lsn, Size *entrysize)
+{
+	volatile RedoWorkerQueue *queue = &MySlot->queue;
+	RedoQueueEntry entry;
+	uint64		read;
+
+	if (queue_used(queue) == 0)
+		return false;
+
+	/* only we advance read, so it's safe to read it without the lock */
+	read = queue->read;
+	queue_copy_out(queue, read, (char *) &entry, sizeof(RedoQueueEntry));
+
+	if (entry.len > recordBufSize)
+	{
+		if (recordBuf)
+			pfree(recordBuf);
+		recordBufSize = Max(entry.len, BLCKSZ * 4);
+		recordBuf = MemoryContextAlloc(TopMemoryContext, recordBufSize);
+	}
+	queue_copy_out(queue, read + sizeof(RedoQueueEntry), recordBuf, entry.len);
+
+	*lsn = entry.lsn;
+	*entrysize = RedoQueueEntrySize(entry.len);
+	return true;
+}
+
+/*
+ * Error context callback for errors occurring during rm_redo().
+ */
+static void
+worker_error_callback(void *arg)
+{
+	XLogRecord *record = (XLogRecord *) arg;
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	RmgrTable[record->xl_rmid].rm_desc(&buf,
+									   record->xl_info,
+									   XLogRecGetData(record));
+
+	/* don't bother emitting empty description */
+	if (buf.len > 0)
+		errcontext("xlog redo %s", buf.data);
+
+	pfree(buf.data);
+}
+
+/*
+ * on_shmem_exit callback of a worker: let the startup process know.
+ */
+static void
+worker_shmem_exit(int code, Datum arg)
+{
+	volatile RedoWorkerShmemStruct *rws = RedoWorkerShmem;
+
+	SpinLockAcquire(&rws->mutex);
+	MySlot->pid = 0;
+	MySlot->exited = true;
+	SpinLockRelease(&rws->mutex);
+
+	DisownLatch(&MySlot->workerLatch);
+	SetLatch(&RedoWorkerShmem->startupLatch);
+}
+
+/*
+ * redo_worker_quickdie() occurs when signalled SIGQUIT by the postmaster.
+ *
+ * Some backend has bought the farm, so we need to stop what we're doing
+ * and exit.
+ */
+static void
+redo_worker_quickdie(SIGNAL_ARGS)
+{
+	PG_SETMASK(&BlockSig);
+
+	/*
+	 * We DO NOT want to run proc_exit() callbacks -- we're here because
+	 * shared memory may be corrupted, so we don't want to try to clean up.
+	 * Note we do exit(2) not exit(0), to force the postmaster into a system
+	 * reset cycle, as for the startup process.
+	 */
+	on_exit_reset();
+	exit(2);
+}
+
+/* SIGHUP: set flag to re-read config file at next convenient time */
+static void
+RedoWorkerSigHupHandler(SIGNAL_ARGS)
+{
+	got_SIGHUP = true;
+	if (MySlot != NULL)
+		SetLatch(&MySlot->workerLatch);
+}
+
+/* SIGTERM: set flag to exit */
+static void
+RedoWorkerShutdownHandler(SIGNAL_ARGS)
+{
+	shutdown_requested = true;
+	if (MySlot != NULL)
+		SetLatch(&MySlot->workerLatch);
+}
+
+/* SIGUSR1: let latch facility handle the signal */
+static void
+RedoWorkerSigUsr1Handler(SIGNAL_ARGS)
+{
+	latch_sigusr1_handler();
+}
+
+
+/********************************************************************
+ *					  RECORD QUEUES
+ ********************************************************************/
+
+/*
+ * Append an entry and its record to the queue.  The caller has made sure
+ * that there is room.
+ */
+static void
+queue_put(volatile RedoWorkerQueue *queue, const RedoQueueEntry *entry,
+		  const char *data)
+{
+	uint64		written;
+
+	/* only we advance written, so it's safe to read it without the lock */
+	written = queue->written;
+	queue_copy_in(queue, written, (const char *) entry,
+				  sizeof(RedoQueueEntry));
+	queue_copy_in(queue, written + sizeof(RedoQueueEntry), data, entry->len);
+
+	SpinLockAcquire(&queue->mutex);
+	queue->written = written + RedoQueueEntrySize(entry->len);
+	SpinLockRelease(&queue->mutex);
+}
+
+/*
+ * Copy len bytes into the queue, starting at queue position pos.
+ */
+static void
+queue_copy_in(volatile RedoWorkerQueue *queue, uint64 pos, const char *data,
+			  Size len)
+{
+	Size		offset = pos % REDO_WORKER_QUEUE_SIZE;
+	Size		chunk = Min(len, REDO_WORKER_QUEUE_SIZE - offset);
+
+	memcpy((char *) queue->data + offset, data, chunk);
+	if (chunk < len)
+		memcpy((char *) queue->data, data + chunk, len - chunk);
+}
+
+/*
+ * Copy len bytes starting at queue position pos.
+ */
+static void
+queue_copy_out(volatile RedoWorkerQueue *queue, uint64 pos, char *data,
+			   Size len)
+{
+	Size		offset = pos % REDO_WORKER_QUEUE_SIZE;
+	Size		chunk = Min(len, REDO_WORKER_QUEUE_SIZE - offset);
+
+	memcpy(data, (char *) queue->data + offset, chunk);
+	if (chunk < len)
+		memcpy(data + chunk, (char *) queue->data, len - chunk);
+}
+
+/*
+ * How many bytes are in the queue right now?
+ */
+static Size
+queue_used(volatile RedoWorkerQueue *queue)
+{
+	uint64		used;
+
+	SpinLockAcquire(&queue->mutex);
+	used = queue->written - queue->read;
+	SpinLockRelease(&queue->mutex);
+
+	return (Size) used;
+}
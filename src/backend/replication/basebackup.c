@@ -0,0 +1,1248 @@
+/*-------------------------------------------------------------------------
+ *
+ * basebackup.c
+ *	  code for taking a base backup and streaming it to a standby
+ *
+ * A base backup is taken over a replication connection with the following
+ * commands, all handled in the walsender before streaming starts:
+ *
+ *	 BASE_BACKUP [LABEL 'label'] [PROGRESS] [FAST] [MAX_RATE n] [COMPRESS n]
+ *	 START_BACKUP [LABEL 'label'] [PROGRESS] [FAST]
+ *	 SEND_TABLESPACE { BASE | oid } [MAX_RATE n] [COMPRESS n]
+ *	 STOP_BACKUP
+ *
+ * BASE_BACKUP does everything in one go: it puts the server in backup
+ * mode, streams one tar archive per tablespace, and takes the server out
+ * of backup mode again.  The other three commands split the same work up
+ * so that a client can open several replication connections and receive
+ * the tablespaces in parallel: START_BACKUP and STOP_BACKUP are issued on
+ * one connection, and SEND_TABLESPACE on any number of connections while
+ * the backup is in progress.  Reading each tablespace in its own walsender
+ * lets a backup use the bandwidth of all the disks at once.
+ *
+ * Each tar archive is sent as a COPY OUT stream.  The stream can be
+ * compressed in gzip format (COMPRESS), and the rate at which files are read
+ * can be limited (MAX_RATE, in kilobytes per second) to reduce the impact
+ * on a busy primary.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include "access/xlog_internal.h"
+#include "catalog/pg_type.h"
+#include "lib/stringinfo.h"
+#include "libpq/libpq.h"
+#include "libpq/pqformat.h"
+#include "miscadmin.h"
+#include "nodes/pg_list.h"
+#include "replication/basebackup.h"
+#include "replication/walsender.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/pmsignal.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/ps_status.h"
+#include "utils/timestamp.h"
+
+/* Size of the chunks we read files in, and send to the client */
+#define TAR_SEND_SIZE 32768
+
+/* Largest file size the ustar format can describe: 11 octal digits */
+#define MAX_TAR_MEMBER_FILELEN	INT64CONST(077777777777)
+
+/* How many times per second a throttled backup checks its rate */
+#define THROTTLING_FREQUENCY	8
+
+/* Options accepted by the base backup commands */
+#define BB_OPT_LABEL		0x01
+#define BB_OPT_PROGRESS		0x02
+#define BB_OPT_FAST			0x04
+#define BB_OPT_MAX_RATE		0x08
+#define BB_OPT_COMPRESS		0x10
+
+typedef struct
+{
+	const char *label;
+	bool		progress;
+	bool		fastcheckpoint;
+	int			maxrate;		/* kilobytes per second, 0 for no limit */
+	int			compresslevel;	/* zlib level, 0 for no compression */
+} basebackup_options;
+
+typedef struct
+{
+	char	   *oid;			/* NULL for the data directory */
+	char	   *path;			/* symlink target; NULL for data directory */
+	char	   *rpath;			/* path to read from, relative to $PGDATA */
+	int64		size;			/* bytes, or -1 if not computed */
+} tablespaceinfo;
+
+/* Does this session have a backup running that it must clean up? */
+static bool backup_started_in_session = false;
+static bool cleanup_registered = false;
+
+/*
+ * Output state for the tar stream of the tablespace being sent.  Data is
+ * collected in outbuf and sent to the client as one CopyData message when
+ * the buffer fills up.
+ */
+static char outbuf[TAR_SEND_SIZE];
+static int	outbuf_len = 0;
+static int	compresslevel = 0;
+
+#ifdef HAVE_LIBZ
+static z_stream zstream;
+#endif
+
+/* Throttling state; throttling_sample is 0 if throttling is disabled */
+static int64 throttling_sample = 0;
+static int64 throttling_counter = 0;
+static int64 throttling_rate = 0;
+static TimestampTz throttled_last;
+
+static void SendBaseBackup(const char *args);
+static void StartBaseBackup(const char *args);
+static void SendBackupTablespace(const char *args);
+static void StopBaseBackup(const char *args);
+
+static void parse_basebackup_options(const char *command, const char *args,
+						 int allowed, basebackup_options *opt);
+static char *read_word(const char **cursor, const char *command);
+static char *read_string(const char **cursor, const char *command);
+static int read_integer(const char **cursor, const char *command,
+			 const char *option, int min, int max);
+
+static void begin_backup(basebackup_options *opt);
+static void base_backup_cleanup(int code, Datum arg);
+static List *get_tablespaces(bool progress);
+static void SendXlogRecPtrResult(XLogRecPtr ptr);
+static void SendTablespaceHeader(List *tablespaces);
+static void SendTablespace(char *rpath, basebackup_options *opt);
+
+static int64 sendDir(char *path, int basepathlen, bool sizeonly);
+static void sendFile(char *readfilename, char *tarfilename,
+		 struct stat * statbuf);
+static void _tarWriteHeader(char *filename, char *linktarget,
+				struct stat * statbuf);
+
+static void bb_begin(int level, int maxrate);
+static void bb_send(const char *data, size_t len);
+static void bb_end(void);
+static void bb_flush_outbuf(void);
+static void throttle(size_t increment);
+static void check_backup_interrupts(void);
+
+/*
+ * Check whether a replication command is one of the base backup commands,
+ * and if so execute it.  Returns false if the command was not recognized.
+ *
+ * The caller is responsible for sending CommandComplete and ReadyForQuery
+ * after the command has been executed.
+ */
+bool
+HandleBaseBackupCommand(const char *query_string)
+{
+	static const struct
+	{
+		const char *name;
+		void		(*handler) (const char *args);
+	}			commands[] =
+	{
+		{"BASE_BACKUP", SendBaseBackup},
+		{"START_BACKUP", StartBaseBackup},
+		{"SEND_TABLESPACE", SendBackupTablespace},
+		{"STOP_BACKUP", StopBaseBackup},
+		{NULL, NULL}
+	};
+	int			i;
+
+	for (i = 0; commands[i].name != NULL; i++)
+	{
+		size_t		len = strlen(commands[i].name);
+		MemoryContext backup_context;
+		MemoryContext old_context;
+
+		if (strncmp(query_string, commands[i].name, len) != 0 ||
+			(query_string[len] != '\0' &&
+			 !isspace((unsigned char) query_string[len])))
+			continue;
+
+		backup_context = AllocSetContextCreate(CurrentMemoryContext,
+											   "Base backup context",
+											   ALLOCSET_DEFAULT_MINSIZE,
+											   ALLOCSET_DEFAULT_INITSIZE,
+											   ALLOCSET_DEFAULT_MAXSIZE);
+		old_context = MemoryContextSwitchTo(backup_context);
+
+		commands[i].handler(query_string + len);
+
+		MemoryContextSwitchTo(old_context);
+		MemoryContextDelete(backup_context);
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * BASE_BACKUP: take a complete base backup over this connection.
+ *
+ * Sends the starting WAL location, the list of tablespaces, one COPY OUT
+ * stream per tablespace, and finally the ending WAL location.
+ */
+static void
+SendBaseBackup(const char *args)
+{
+	basebackup_options opt;
+	List	   *tablespaces;
+	ListCell   *lc;
+	XLogRecPtr	startptr;
+	XLogRecPtr	endptr;
+
+	parse_basebackup_options("BASE_BACKUP", args,
+							 BB_OPT_LABEL | BB_OPT_PROGRESS | BB_OPT_FAST |
+							 BB_OPT_MAX_RATE | BB_OPT_COMPRESS,
+							 &opt);
+
+	begin_backup(&opt);
+	startptr = do_pg_start_backup(opt.label, opt.fastcheckpoint);
+	backup_started_in_session = true;
+
+	SendXlogRecPtrResult(startptr);
+
+	tablespaces = get_tablespaces(opt.progress);
+	SendTablespaceHeader(tablespaces);
+
+	foreach(lc, tablespaces)
+	{
+		tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
+
+		SendTablespace(ti->rpath, &opt);
+	}
+
+	endptr = do_pg_stop_backup();
+	backup_started_in_session = false;
+
+	SendXlogRecPtrResult(endptr);
+}
+
+/*
+ * START_BACKUP: put the server in backup mode.
+ *
+ * Sends the starting WAL location and the list of tablespaces; the client
+ * then fetches each tablespace with SEND_TABLESPACE, possibly over other
+ * connections, and finishes with STOP_BACKUP on this connection.  If this
+ * connection is lost before that, the backup is aborted.
+ */
+static void
+StartBaseBackup(const char *args)
+{
+	basebackup_options opt;
+	XLogRecPtr	startptr;
+
+	parse_basebackup_options("START_BACKUP", args,
+							 BB_OPT_LABEL | BB_OPT_PROGRESS | BB_OPT_FAST,
+							 &opt);
+
+	if (backup_started_in_session)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("a backup is already in progress in this session")));
+
+	begin_backup(&opt);
+	startptr = do_pg_start_backup(opt.label, opt.fastcheckpoint);
+	backup_started_in_session = true;
+
+	SendXlogRecPtrResult(startptr);
+	SendTablespaceHeader(get_tablespaces(opt.progress));
+}
+
+/*
+ * SEND_TABLESPACE: stream one tablespace of the backup in progress.
+ */
+static void
+SendBackupTablespace(const char *args)
+{
+	basebackup_options opt;
+	const char *cursor = args;
+	char	   *spc;
+	char		rpath[MAXPGPATH];
+	struct stat statbuf;
+
+	spc = read_word(&cursor, "SEND_TABLESPACE");
+	if (spc == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("SEND_TABLESPACE requires a tablespace OID or BASE")));
+
+	parse_basebackup_options("SEND_TABLESPACE", cursor,
+							 BB_OPT_MAX_RATE | BB_OPT_COMPRESS, &opt);
+
+	if (!BackupInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("a backup is not in progress")));
+
+	if (pg_strcasecmp(spc, "BASE") == 0)
+	{
+		SendTablespace(NULL, &opt);
+		return;
+	}
+
+	if (strspn(spc, "0123456789") != strlen(spc))
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("invalid tablespace OID \"%s\"", spc)));
+
+	snprintf(rpath, sizeof(rpath), "pg_tblspc/%s", spc);
+	if (stat(rpath, &statbuf) != 0 || !S_ISDIR(statbuf.st_mode))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("tablespace with OID %s does not exist", spc)));
+
+	SendTablespace(rpath, &opt);
+}
+
+/*
+ * STOP_BACKUP: take the server out of the backup mode entered by
+ * START_BACKUP on this connection, and send the ending WAL location.
+ */
+static void
+StopBaseBackup(const char *args)
+{
+	basebackup_options opt;
+	XLogRecPtr	endptr;
+
+	parse_basebackup_options("STOP_BACKUP", args, 0, &opt);
+
+	if (!backup_started_in_session)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("a backup was not started in this session")));
+
+	endptr = do_pg_stop_backup();
+	backup_started_in_session = false;
+
+	SendXlogRecPtrResult(endptr);
+}
+
+/*
+ * Common preparation for the commands that start a backup.
+ */
+static void
+begin_backup(basebackup_options *opt)
+{
+	/*
+	 * Make sure the backup is aborted if the connection goes away before the
+	 * backup is stopped.  Errors are FATAL in a walsender, so this also
+	 * covers failures while sending the data.
+	 */
+	if (!cleanup_registered)
+	{
+		on_shmem_exit(base_backup_cleanup, (Datum) 0);
+		cleanup_registered = true;
+	}
+
+	if (update_process_title)
+	{
+		char		activitymsg[50];
+
+		snprintf(activitymsg, sizeof(activitymsg), "sending backup \"%s\"",
+				 opt->label);
+		set_ps_display(activitymsg, false);
+	}
+}
+
+static void
+base_backup_cleanup(int code, Datum arg)
+{
+	if (backup_started_in_session)
+	{
+		backup_started_in_session = false;
+		do_pg_abort_backup();
+	}
+}
+
+/*
+ * Collect the list of tablespaces to back up, with the data directory
+ * first.  If progress is true, also compute the size of each one so that
+ * the client can report progress.
+ */
+static List *
+get_tablespaces(bool progress)
+{
+	List	   *tablespaces = NIL;
+	tablespaceinfo *ti;
+	DIR		   *dir;
+	struct dirent *de;
+
+	dir = AllocateDir("pg_tblspc");
+	while ((de = ReadDir(dir, "pg_tblspc")) != NULL)
+	{
+		char		fullpath[MAXPGPATH];
+#ifdef HAVE_READLINK
+		char		linkpath[MAXPGPATH];
+		int			rllen;
+#endif
+
+		/* Skip special stuff */
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		snprintf(fullpath, sizeof(fullpath), "pg_tblspc/%s", de->d_name);
+
+#ifdef HAVE_READLINK
+		rllen = readlink(fullpath, linkpath, sizeof(linkpath) - 1);
+		if (rllen < 0)
+		{
+			ereport(WARNING,
+					(errmsg("could not read symbolic link \"%s\": %m",
+							fullpath)));
+			continue;
+		}
+		linkpath[rllen] = '\0';
+
+		ti = palloc(sizeof(tablespaceinfo));
+		ti->oid = pstrdup(de->d_name);
+		ti->path = pstrdup(linkpath);
+		ti->rpath = pstrdup(fullpath);
+		ti->size = progress ? sendDir(fullpath, strlen(fullpath), true) : -1;
+		tablespaces = lappend(tablespaces, ti);
+#else
+
+		/*
+		 * If the platform does not have symbolic links, it should not be
+		 * possible to have tablespaces - clearly somebody else created them.
+		 * Warn about it and ignore.
+		 */
+		ereport(WARNING,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("tablespaces are not supported on this platform")));
+#endif
+	}
+	FreeDir(dir);
+
+	/* Add the data directory at the front */
+	ti = palloc0(sizeof(tablespaceinfo));
+	ti->size = progress ? sendDir(".", 1, true) : -1;
+	tablespaces = lcons(ti, tablespaces);
+
+	return tablespaces;
+}
+
+/*
+ * Send a single-row result set holding a WAL location.
+ */
+static void
+SendXlogRecPtrResult(XLogRecPtr ptr)
+{
+	StringInfoData buf;
+	char		str[MAXFNAMELEN];
+
+	snprintf(str, sizeof(str), "%X/%X", ptr.xlogid, ptr.xrecoff);
+
+	pq_beginmessage(&buf, 'T'); /* RowDescription */
+	pq_sendint(&buf, 1, 2);		/* 1 field */
+
+	/* Field header */
+	pq_sendstring(&buf, "xlogpos");
+	pq_sendint(&buf, 0, 4);		/* table oid */
+	pq_sendint(&buf, 0, 2);		/* attnum */
+	pq_sendint(&buf, TEXTOID, 4);		/* type oid */
+	pq_sendint(&buf, -1, 2);	/* typlen */
+	pq_sendint(&buf, 0, 4);		/* typmod */
+	pq_sendint(&buf, 0, 2);		/* format code */
+	pq_endmessage(&buf);
+
+	/* Data row */
+	pq_beginmessage(&buf, 'D');
+	pq_sendint(&buf, 1, 2);		/* number of columns */
+	pq_sendint(&buf, strlen(str), 4);	/* length */
+	pq_sendbytes(&buf, str, strlen(str));
+	pq_endmessage(&buf);
+
+	/* Send a CommandComplete message */
+	pq_puttextmessage('C', "SELECT");
+}
+
+/*
+ * Send a result set describing the tablespaces: OID, location and size in
+ * kilobytes.  The data directory has NULL OID and location, and the size
+ * is NULL unless PROGRESS was requested.
+ */
+static void
+SendTablespaceHeader(List *tablespaces)
+{
+	StringInfoData buf;
+	ListCell   *lc;
+
+	pq_beginmessage(&buf, 'T'); /* RowDescription */
+	pq_sendint(&buf, 3, 2);		/* 3 fields */
+
+	pq_sendstring(&buf, "spcoid");
+	pq_sendint(&buf, 0, 4);		/* table oid */
+	pq_sendint(&buf, 0, 2);		/* attnum */
+	pq_sendint(&buf, OIDOID, 4);	/* type oid */
+	pq_sendint(&buf, 4, 2);		/* typlen */
+	pq_sendint(&buf, 0, 4);		/* typmod */
+	pq_sendint(&buf, 0, 2);		/* format code */
+
+	pq_sendstring(&buf, "spclocation");
+	pq_sendint(&buf, 0, 4);
+	pq_sendint(&buf, 0, 2);
+	pq_sendint(&buf, TEXTOID, 4);
+	pq_sendint(&buf, -1, 2);
+	pq_sendint(&buf, 0, 4);
+	pq_sendint(&buf, 0, 2);
+
+	pq_sendstring(&buf, "size");
+	pq_sendint(&buf, 0, 4);
+	pq_sendint(&buf, 0, 2);
+	pq_sendint(&buf, INT8OID, 4);
+	pq_sendint(&buf, 8, 2);
+	pq_sendint(&buf, 0, 4);
+	pq_sendint(&buf, 0, 2);
+	pq_endmessage(&buf);
+
+	foreach(lc, tablespaces)
+	{
+		tablespaceinfo *ti = (tablespaceinfo *) lfirst(lc);
+
+		/* Send one datarow message */
+		pq_beginmessage(&buf, 'D');
+		pq_sendint(&buf, 3, 2);	/* number of columns */
+		if (ti->path == NULL)
+		{
+			pq_sendint(&buf, -1, 4);	/* Length = -1 ==> NULL */
+			pq_sendint(&buf, -1, 4);
+		}
+		else
+		{
+			pq_sendint(&buf, strlen(ti->oid), 4);		/* length */
+			pq_sendbytes(&buf, ti->oid, strlen(ti->oid));
+			pq_sendint(&buf, strlen(ti->path), 4);		/* length */
+			pq_sendbytes(&buf, ti->path, strlen(ti->path));
+		}
+		if (ti->size >= 0)
+		{
+			char		sizestr[32];
+
+			snprintf(sizestr, sizeof(sizestr), INT64_FORMAT,
+					 ti->size / 1024);
+			pq_sendint(&buf, strlen(sizestr), 4);
+			pq_sendbytes(&buf, sizestr, strlen(sizestr));
+		}
+		else
+			pq_sendint(&buf, -1, 4);	/* NULL */
+
+		pq_endmessage(&buf);
+	}
+
+	/* Send a CommandComplete message */
+	pq_puttextmessage('C', "SELECT");
+}
+
+/*
+ * Send one tablespace as a tar archive in a COPY OUT stream.  rpath is the
+ * directory to send, relative to the data directory, or NULL for the data
+ * directory itself.
+ */
+static void
+SendTablespace(char *rpath, basebackup_options *opt)
+{
+	StringInfoData buf;
+	char		zeroblock[1024];
+
+	/* Send CopyOutResponse message */
+	pq_beginmessage(&buf, 'H');
+	pq_sendbyte(&buf, 0);		/* overall format */
+	pq_sendint(&buf, 0, 2);		/* natts */
+	pq_endmessage(&buf);
+
+	bb_begin(opt->compresslevel, opt->maxrate);
+
+	if (rpath == NULL)
+		sendDir(".", 1, false);
+	else
+		sendDir(rpath, strlen(rpath), false);
+
+	/* End of archive: two blocks of zeros */
+	MemSet(zeroblock, 0, sizeof(zeroblock));
+	bb_send(zeroblock, sizeof(zeroblock));
+
+	bb_end();
+
+	/* Send CopyDone message */
+	pq_putemptymessage('c');
+	if (pq_flush())
+		ereport(ERROR,
+				(errmsg("base backup could not send data, aborting backup")));
+}
+
+/*
+ * Include all files from the given directory in the output tar stream. If
+ * 'sizeonly' is true, we just calculate a total length and return it,
+ * without actually sending anything.
+ */
+static int64
+sendDir(char *path, int basepathlen, bool sizeonly)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	char		pathbuf[MAXPGPATH];
+	struct stat statbuf;
+	int64		size = 0;
+
+	dir = AllocateDir(path);
+	while ((de = ReadDir(dir, path)) != NULL)
+	{
+		/* Skip special stuff */
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		check_backup_interrupts();
+
+		snprintf(pathbuf, MAXPGPATH, "%s/%s", path, de->d_name);
+
+		/* Skip postmaster.pid in the data directory */
+		if (strcmp(pathbuf, "./postmaster.pid") == 0)
+			continue;
+
+		if (lstat(pathbuf, &statbuf) != 0)
+		{
+			if (errno != ENOENT)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not stat file or directory \"%s\": %m",
+								pathbuf)));
+
+			/* If the file went away while scanning, it's no error. */
+			continue;
+		}
+
+		/*
+		 * We can skip pg_xlog, the WAL segments need to be fetched from the
+		 * WAL archive anyway.  But include it, and its archive_status
+		 * subdirectory, as empty directories, so we get permissions right.
+		 */
+		if (strcmp(pathbuf, "./pg_xlog") == 0)
+		{
+			if (!sizeonly)
+			{
+				char		statuspath[MAXPGPATH];
+
+				_tarWriteHeader(pathbuf + basepathlen + 1, NULL, &statbuf);
+
+				snprintf(statuspath, MAXPGPATH, "%s/archive_status",
+						 pathbuf + basepathlen + 1);
+				_tarWriteHeader(statuspath, NULL, &statbuf);
+			}
+			size += 1024;		/* Size of the two directory headers */
+			continue;
+		}
+
+		/*
+		 * Skip the contents of pg_replslot: the slots of this server mean
+		 * nothing to a server restored from the backup, and would hold back
+		 * its WAL and cleanup forever.  Include the directory itself, though.
+		 */
+		if (strcmp(pathbuf, "./pg_replslot") == 0)
+		{
+			if (!sizeonly)
+				_tarWriteHeader(pathbuf + basepathlen + 1, NULL, &statbuf);
+			size += 512;		/* Size of the header just added */
+			continue;
+		}
+
+#ifdef HAVE_READLINK
+		if (S_ISLNK(statbuf.st_mode))
+		{
+			/*
+			 * Symbolic link, normally for a tablespace in pg_tblspc.  Include
+			 * the link itself; the tablespace contents are sent as a separate
+			 * archive.
+			 */
+			char		linkpath[MAXPGPATH];
+			int			rllen;
+
+			rllen = readlink(pathbuf, linkpath, sizeof(linkpath) - 1);
+			if (rllen < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read symbolic link \"%s\": %m",
+								pathbuf)));
+			linkpath[rllen] = '\0';
+
+			if (!sizeonly)
+				_tarWriteHeader(pathbuf + basepathlen + 1, linkpath, &statbuf);
+			size += 512;		/* Size of the header just added */
+		}
+		else
+#endif
+		if (S_ISDIR(statbuf.st_mode))
+		{
+			/*
+			 * Store a directory entry in the tar file so we can get the
+			 * permissions right.
+			 */
+			if (!sizeonly)
+				_tarWriteHeader(pathbuf + basepathlen + 1, NULL, &statbuf);
+			size += 512;		/* Size of the header just added */
+
+			/* call ourselves recursively for a directory */
+			size += sendDir(pathbuf, basepathlen, sizeonly);
+		}
+		else if (S_ISREG(statbuf.st_mode))
+		{
+			/* Add size, rounded up to 512byte block */
+			size += ((statbuf.st_size + 511) & ~511);
+			if (!sizeonly)
+				sendFile(pathbuf, pathbuf + basepathlen + 1, &statbuf);
+			size += 512;		/* Size of the header of the file */
+		}
+		else
+			ereport(WARNING,
+					(errmsg("skipping special file \"%s\"", pathbuf)));
+	}
+	FreeDir(dir);
+	return size;
+}
+
+/*
+ * Send a file in tar format: header, contents, and padding to a 512-byte
+ * boundary.  The length recorded in the header is the one we got from
+ * stat(); if the file changes size while we read it, we send exactly that
+ * many bytes anyway.  Any torn or missing data is fixed up by WAL replay.
+ */
+static void
+sendFile(char *readfilename, char *tarfilename, struct stat * statbuf)
+{
+	FILE	   *fp;
+	char		buf[TAR_SEND_SIZE];
+	size_t		cnt;
+	pgoff_t		len = 0;
+	size_t		pad;
+
+	fp = AllocateFile(readfilename, "rb");
+	if (fp == NULL)
+	{
+		/* If the file was removed since we stat'd it, just skip it. */
+		if (errno == ENOENT)
+			return;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", readfilename)));
+	}
+
+	if (statbuf->st_size > MAX_TAR_MEMBER_FILELEN)
+		ereport(ERROR,
+				(errmsg("archive member \"%s\" too large for tar format",
+						tarfilename)));
+
+	_tarWriteHeader(tarfilename, NULL, statbuf);
+
+	while (len < statbuf->st_size &&
+		   (cnt = fread(buf, 1, Min(sizeof(buf), statbuf->st_size - len),
+						fp)) > 0)
+	{
+		bb_send(buf, cnt);
+		len += cnt;
+	}
+
+	if (ferror(fp))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", readfilename)));
+
+	/* If the file was truncated while we were sending it, pad it with zeros */
+	if (len < statbuf->st_size)
+	{
+		MemSet(buf, 0, sizeof(buf));
+		while (len < statbuf->st_size)
+		{
+			cnt = Min(sizeof(buf), statbuf->st_size - len);
+			bb_send(buf, cnt);
+			len += cnt;
+		}
+	}
+
+	/* Pad to 512 byte boundary, per tar format requirements */
+	pad = ((len + 511) & ~511) - len;
+	if (pad > 0)
+	{
+		MemSet(buf, 0, pad);
+		bb_send(buf, pad);
+	}
+
+	FreeFile(fp);
+}
+
+/*
+ * Utility routine to print possibly larger than 32 bit integers in a
+ * portable fashion.  Filled with zeros.
+ */
+static void
+print_val(char *s, uint64 val, unsigned int base, size_t len)
+{
+	int			i;
+
+	for (i = len; i > 0; i--)
+	{
+		int			digit = val % base;
+
+		s[i - 1] = '0' + digit;
+		val = val / base;
+	}
+}
+
+/*
+ * Write a ustar header for a file, directory, or symbolic link (if
+ * linktarget is not NULL).
+ */
+static void
+_tarWriteHeader(char *filename, char *linktarget, struct stat * statbuf)
+{
+	char		h[512];
+	int			sum;
+	int			i;
+
+	if (strlen(filename) > 99)
+		ereport(ERROR,
+				(errmsg("file name too long for tar format: \"%s\"",
+						filename)));
+	if (linktarget != NULL && strlen(linktarget) > 99)
+		ereport(ERROR,
+				(errmsg("symbolic link target too long for tar format: file name \"%s\", target \"%s\"",
+						filename, linktarget)));
+
+	memset(h, 0, sizeof(h));
+
+	/* Name 100 */
+	strlcpy(&h[0], filename, 100);
+
+	/* Mode 8 */
+	print_val(&h[100], statbuf->st_mode & 07777, 8, 7);
+
+	/* User ID 8 */
+	print_val(&h[108], statbuf->st_uid, 8, 7);
+
+	/* Group 8 */
+	print_val(&h[116], statbuf->st_gid, 8, 7);
+
+	/* File size 12 - 11 digits, 1 NUL; links and directories have none */
+	if (linktarget != NULL || S_ISDIR(statbuf->st_mode))
+		print_val(&h[124], 0, 8, 11);
+	else
+		print_val(&h[124], statbuf->st_size, 8, 11);
+
+	/* Mod Time 12 */
+	print_val(&h[136], (uint64) statbuf->st_mtime, 8, 11);
+
+	/* Type 1 and link name 100 */
+	if (linktarget != NULL)
+	{
+		h[156] = '2';
+		strlcpy(&h[157], linktarget, 100);
+	}
+	else if (S_ISDIR(statbuf->st_mode))
+		h[156] = '5';
+	else
+		h[156] = '0';
+
+	/* Magic 6 and version 2 */
+	memcpy(&h[257], "ustar", 6);
+	memcpy(&h[263], "00", 2);
+
+	/* User 32 and group 32 */
+	strlcpy(&h[265], "postgres", 32);
+	strlcpy(&h[297], "postgres", 32);
+
+	/* Major and minor device 8 each */
+	print_val(&h[329], 0, 8, 7);
+	print_val(&h[337], 0, 8, 7);
+
+	/*
+	 * Checksum 8: the sum of all header bytes, with the checksum field
+	 * itself taken as eight blanks.
+	 */
+	sum = 8 * ' ';
+	for (i = 0; i < 512; i++)
+		if (i < 148 || i >= 156)
+			sum += 0xFF & h[i];
+	print_val(&h[148], sum, 8, 6);
+	h[154] = '\0';
+	h[155] = ' ';
+
+	bb_send(h, sizeof(h));
+}
+
+/*
+ * Start a new tar stream, with the given compression level and rate limit.
+ */
+static void
+bb_begin(int level, int maxrate)
+{
+	outbuf_len = 0;
+	compresslevel = level;
+
+#ifdef HAVE_LIBZ
+	if (compresslevel > 0)
+	{
+		MemSet(&zstream, 0, sizeof(zstream));
+		/* windowBits + 16 makes zlib write a gzip header and trailer */
+		if (deflateInit2(&zstream, compresslevel, Z_DEFLATED, 15 + 16, 8,
+						 Z_DEFAULT_STRATEGY) != Z_OK)
+			ereport(ERROR,
+					(errmsg("could not initialize compression library: %s",
+							zstream.msg ? zstream.msg : "unknown error")));
+		zstream.next_out = (Bytef *) outbuf;
+		zstream.avail_out = sizeof(outbuf);
+	}
+#endif
+
+	if (maxrate > 0)
+	{
+		throttling_rate = (int64) maxrate * 1024;
+		throttling_sample = throttling_rate / THROTTLING_FREQUENCY;
+		throttling_counter = 0;
+		throttled_last = GetCurrentTimestamp();
+	}
+	else
+		throttling_sample = 0;
+}
+
+/*
+ * Add data to the tar stream being sent.
+ */
+static void
+bb_send(const char *data, size_t len)
+{
+	throttle(len);
+
+#ifdef HAVE_LIBZ
+	if (compresslevel > 0)
+	{
+		zstream.next_in = (Bytef *) data;
+		zstream.avail_in = len;
+		while (zstream.avail_in > 0)
+		{
+			if (deflate(&zstream, Z_NO_FLUSH) == Z_STREAM_ERROR)
+				ereport(ERROR,
+						(errmsg("could not compress data: %s",
+								zstream.msg ? zstream.msg : "unknown error")));
+			if (zstream.avail_out == 0)
+			{
+				outbuf_len = sizeof(outbuf);
+				bb_flush_outbuf();
+			}
+		}
+		return;
+	}
+#endif
+
+	while (len > 0)
+	{
+		size_t		n = Min(len, sizeof(outbuf) - outbuf_len);
+
+		memcpy(outbuf + outbuf_len, data, n);
+		outbuf_len += n;
+		data += n;
+		len -= n;
+
+		if (outbuf_len == sizeof(outbuf))
+			bb_flush_outbuf();
+	}
+}
+
+/*
+ * Finish the tar stream, sending whatever is left in the output buffer.
+ */
+static void
+bb_end(void)
+{
+#ifdef HAVE_LIBZ
+	if (compresslevel > 0)
+	{
+		int			r;
+
+		zstream.next_in = NULL;
+		zstream.avail_in = 0;
+		do
+		{
+			r = deflate(&zstream, Z_FINISH);
+			if (r == Z_STREAM_ERROR)
+				ereport(ERROR,
+						(errmsg("could not compress data: %s",
+								zstream.msg ? zstream.msg : "unknown error")));
+			outbuf_len = sizeof(outbuf) - zstream.avail_out;
+			bb_flush_outbuf();
+		} while (r != Z_STREAM_END);
+
+		deflateEnd(&zstream);
+		return;
+	}
+#endif
+
+	bb_flush_outbuf();
+}
+
+/*
+ * Send the contents of the output buffer as one CopyData message.
+ */
+static void
+bb_flush_outbuf(void)
+{
+	if (outbuf_len > 0)
+	{
+		if (pq_putmessage('d', outbuf, outbuf_len))
+			ereport(ERROR,
+					(errmsg("base backup could not send data, aborting backup")));
+		outbuf_len = 0;
+	}
+
+#ifdef HAVE_LIBZ
+	if (compresslevel > 0)
+	{
+		zstream.next_out = (Bytef *) outbuf;
+		zstream.avail_out = sizeof(outbuf);
+	}
+#endif
+}
+
+/*
+ * Sleep as needed so that files are read at no more than the requested
+ * rate.  The rate is checked every throttling_sample bytes.
+ */
+static void
+throttle(size_t increment)
+{
+	long		secs;
+	int			usecs;
+	int64		elapsed;
+	int64		sleep;
+
+	if (throttling_sample == 0)
+		return;
+
+	throttling_counter += increment;
+	if (throttling_counter < throttling_sample)
+		return;
+
+	TimestampDifference(throttled_last, GetCurrentTimestamp(), &secs, &usecs);
+	elapsed = (int64) secs * USECS_PER_SEC + usecs;
+
+	/* How long should sending throttling_counter bytes have taken? */
+	sleep = throttling_counter * USECS_PER_SEC / throttling_rate - elapsed;
+	if (sleep > 0)
+	{
+		check_backup_interrupts();
+		pg_usleep((long) sleep);
+	}
+
+	throttling_counter = 0;
+	throttled_last = GetCurrentTimestamp();
+}
+
+/*
+ * Give up if the postmaster died or we have been asked to shut down.
+ */
+static void
+check_backup_interrupts(void)
+{
+	if (!PostmasterIsAlive(true))
+		exit(1);
+
+	if (walsender_shutdown_requested)
+		ereport(ERROR,
+				(errcode(ERRCODE_ADMIN_SHUTDOWN),
+				 errmsg("shutdown requested, aborting active base backup")));
+}
+
+/*
+ * Parse the options of a base backup command.  'allowed' is a mask of
+ * BB_OPT_* flags for the options the command accepts.
+ */
+static void
+parse_basebackup_options(const char *command, const char *args,
+						 int allowed, basebackup_options *opt)
+{
+	const char *cursor = args;
+	int			seen = 0;
+	char	   *word;
+
+	MemSet(opt, 0, sizeof(*opt));
+	opt->label = "base backup";
+
+	while ((word = read_word(&cursor, command)) != NULL)
+	{
+		int			flag;
+
+		if (pg_strcasecmp(word, "LABEL") == 0)
+			flag = BB_OPT_LABEL;
+		else if (pg_strcasecmp(word, "PROGRESS") == 0)
+			flag = BB_OPT_PROGRESS;
+		else if (pg_strcasecmp(word, "FAST") == 0)
+			flag = BB_OPT_FAST;
+		else if (pg_strcasecmp(word, "MAX_RATE") == 0)
+			flag = BB_OPT_MAX_RATE;
+		else if (pg_strcasecmp(word, "COMPRESS") == 0)
+			flag = BB_OPT_COMPRESS;
+		else
+			flag = 0;
+
+		if ((flag & allowed) == 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("unrecognized option \"%s\" in %s command",
+							word, command)));
+		if (seen & flag)
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("duplicate option \"%s\" in %s command",
+							word, command)));
+		seen |= flag;
+
+		switch (flag)
+		{
+			case BB_OPT_LABEL:
+				opt->label = read_string(&cursor, command);
+				break;
+			case BB_OPT_PROGRESS:
+				opt->progress = true;
+				break;
+			case BB_OPT_FAST:
+				opt->fastcheckpoint = true;
+				break;
+			case BB_OPT_MAX_RATE:
+				opt->maxrate = read_integer(&cursor, command, "MAX_RATE",
+											32, INT_MAX / 1024);
+				break;
+			case BB_OPT_COMPRESS:
+				opt->compresslevel = read_integer(&cursor, command,
+												  "COMPRESS", 0, 9);
+#ifndef HAVE_LIBZ
+				if (opt->compresslevel > 0)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("compression is not supported by this build")));
+#endif
+				break;
+		}
+	}
+}
+
+/*
+ * Read a keyword or number from the command, or return NULL at the end of
+ * the command.
+ */
+static char *
+read_word(const char **cursor, const char *command)
+{
+	const char *p = *cursor;
+	const char *start;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (*p == '\0')
+	{
+		*cursor = p;
+		return NULL;
+	}
+
+	start = p;
+	while (isalnum((unsigned char) *p) || *p == '_')
+		p++;
+	if (p == start)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("syntax error in %s command at \"%s\"",
+						command, start)));
+
+	*cursor = p;
+	return pnstrdup(start, p - start);
+}
+
+/*
+ * Read a single-quoted string literal from the command.  Embedded quotes
+ * are written as two quotes.
+ */
+static char *
+read_string(const char **cursor, const char *command)
+{
+	const char *p = *cursor;
+	StringInfoData buf;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (*p != '\'')
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("syntax error in %s command: string literal expected",
+						command)));
+	p++;
+
+	initStringInfo(&buf);
+	for (;;)
+	{
+		if (*p == '\0')
+			ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("unterminated quoted string in %s command",
+							command)));
+		if (*p == '\'')
+		{
+			if (p[1] != '\'')
+				break;
+			p++;
+		}
+		appendStringInfoChar(&buf, *p);
+		p++;
+	}
+
+	*cursor = p + 1;
+	return buf.data;
+}
+
+/*
+ * Read an integer argument of an option from the command, and check that
+ * it's within [min, max].
+ */
+static int
+read_integer(const char **cursor, const char *command, const char *option,
+			 int min, int max)
+{
+	char	   *word = read_word(cursor, command);
+	char	   *endptr;
+	long		val;
+
+	if (word == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("option \"%s\" requires a value", option)));
+
+	errno = 0;
+	val = strtol(word, &endptr, 10);
+	if (*endptr != '\0' || errno != 0 || val < min || val > max)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid value \"%s\" for option \"%s\"", word, option),
+				 errdetail("Valid values are between %d and %d.", min, max)));
+
+	return (int) val;
+}
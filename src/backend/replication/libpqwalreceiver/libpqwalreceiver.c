@@ -47,9 +47,11 @@ static bool justconnected = false;
 static char *recvBuf = NULL;
 
 /* Prototypes for interface functions */
-static bool libpqrcv_connect(char *conninfo, XLogRecPtr startpoint);
+static bool libpqrcv_connect(char *conninfo, XLogRecPtr startpoint,
+				 char *slotname);
 static bool libpqrcv_receive(int timeout, unsigned char *type,
 				 char **buffer, int *len);
+static void libpqrcv_send(const char *buffer, int nbytes);
 static void libpqrcv_disconnect(void);
 
 /* Prototypes for private functions */
@@ -64,10 +66,11 @@ _PG_init(void)
 {
 	/* Tell walreceiver how to reach us */
 	if (walrcv_connect != NULL || walrcv_receive != NULL ||
-		walrcv_disconnect != NULL)
+		walrcv_send != NULL || walrcv_disconnect != NULL)
 		elog(ERROR, "libpqwalreceiver already loaded");
 	walrcv_connect = libpqrcv_connect;
 	walrcv_receive = libpqrcv_receive;
+	walrcv_send = libpqrcv_send;
 	walrcv_disconnect = libpqrcv_disconnect;
 }
 
@@ -75,7 +78,7 @@ _PG_init(void)
  * Establish the connection to the primary server for XLOG streaming
  */
 static bool
-libpqrcv_connect(char *conninfo, XLogRecPtr startpoint)
+libpqrcv_connect(char *conninfo, XLogRecPtr startpoint, char *slotname)
 {
 	char		conninfo_repl[MAXCONNINFO + 37];
 	char	   *primary_sysid;
@@ -83,7 +86,7 @@ libpqrcv_connect(char *conninfo, XLogRecPtr startpoint)
 	TimeLineID	primary_tli;
 	TimeLineID	standby_tli;
 	PGresult   *res;
-	char		cmd[64];
+	char		cmd[64 + NAMEDATALEN];
 
 	/*
 	 * Connect using deliberately undocumented parameter: replication. The
@@ -153,11 +156,18 @@ libpqrcv_connect(char *conninfo, XLogRecPtr startpoint)
 						primary_tli, standby_tli)));
 	ThisTimeLineID = primary_tli;
 
-	/* Start streaming from the point requested by startup process */
-	snprintf(cmd, sizeof(cmd), "START_REPLICATION %X/%X",
-			 startpoint.xlogid, startpoint.xrecoff);
+	/*
+	 * Start streaming from the point requested by startup process, through
+	 * our replication slot if we have one.
+	 */
+	if (slotname[0] != '\0')
+		snprintf(cmd, sizeof(cmd), "START_REPLICATION SLOT %s %X/%X",
+				 slotname, startpoint.xlogid, startpoint.xrecoff);
+	else
+		snprintf(cmd, sizeof(cmd), "START_REPLICATION %X/%X",
+				 startpoint.xlogid, startpoint.xrecoff);
 	res = libpqrcv_PQexec(cmd);
-	if (PQresultStatus(res) != PGRES_COPY_OUT)
+	if (PQresultStatus(res) != PGRES_COPY_BOTH)
 	{
 		PQclear(res);
 		ereport(ERROR,
@@ -303,6 +313,7 @@ libpqrcv_PQexec(const char *query)
 
 		if (PQresultStatus(lastResult) == PGRES_COPY_IN ||
 			PQresultStatus(lastResult) == PGRES_COPY_OUT ||
+			PQresultStatus(lastResult) == PGRES_COPY_BOTH ||
 			PQstatus(streamConn) == CONNECTION_BAD)
 			break;
 	}
@@ -398,3 +409,18 @@ libpqrcv_receive(int timeout, unsigned char *type, char **buffer, int *len)
 
 	return true;
 }
+
+/*
+ * Send a message to XLOG stream.
+ *
+ * ereports on error.
+ */
+static void
+libpqrcv_send(const char *buffer, int nbytes)
+{
+	if (PQputCopyData(streamConn, buffer, nbytes) <= 0 ||
+		PQflush(streamConn))
+		ereport(ERROR,
+				(errmsg("could not send data to WAL stream: %s",
+						PQerrorMessage(streamConn))));
+}
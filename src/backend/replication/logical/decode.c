@@ -0,0 +1,348 @@
+/*-------------------------------------------------------------------------
+ *
+ * decode.c
+ *	  Decoding of WAL records into the reorder buffer.
+ *
+ * Heap insert, update and delete records of the current database are
+ * turned into row changes, queued under the xid that made them; commit and
+ * abort records of the xact resource manager replay or discard them.
+ * Everything else is of no interest here.
+ *
+ * This relies on heapam logging the tuple data of logically logged tables
+ * even when it backs up the whole page, and logging the key of the old row
+ * of updates and deletes, which it only does with wal_level = logical.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "replication/logical.h"
+#include "storage/standby.h"
+
+
+static void DecodeXactOp(LogicalDecodingContext *ctx, XLogRecord *record);
+static void DecodeInsert(LogicalDecodingContext *ctx, XLogRecord *record);
+static void DecodeUpdate(LogicalDecodingContext *ctx, XLogRecord *record);
+static void DecodeDelete(LogicalDecodingContext *ctx, XLogRecord *record);
+static void DecodeMultiInsert(LogicalDecodingContext *ctx, XLogRecord *record);
+static HeapTuple DecodeTuple(LogicalDecodingContext *ctx, char *data,
+			Size len, uint16 t_infomask2, uint16 t_infomask, uint8 t_hoff);
+static ReorderBufferChange *NewChange(LogicalDecodingContext *ctx,
+		  ReorderBufferChangeType action, RelFileNode *relnode);
+
+
+/*
+ * Decode one WAL record, the one just read by ctx->reader.
+ */
+void
+DecodeRecordIntoReorderBuffer(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+
+	switch (record->xl_rmid)
+	{
+		case RM_XACT_ID:
+			DecodeXactOp(ctx, record);
+			break;
+
+		case RM_STANDBY_ID:
+			if (info == XLOG_RUNNING_XACTS)
+			{
+				xl_running_xacts *running;
+
+				running = (xl_running_xacts *) XLogRecGetData(record);
+				ReorderBufferAbortOld(ctx->reorder, running->oldestRunningXid);
+				LogicalDecodingRunningXacts(ctx, ctx->reader->ReadRecPtr,
+											running->oldestRunningXid);
+			}
+			break;
+
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+					DecodeInsert(ctx, record);
+					break;
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+					DecodeUpdate(ctx, record);
+					break;
+				case XLOG_HEAP_DELETE:
+					DecodeDelete(ctx, record);
+					break;
+				default:
+					break;
+			}
+			break;
+
+		case RM_HEAP2_ID:
+			if ((info & XLOG_HEAP_OPMASK) == XLOG_HEAP2_MULTI_INSERT)
+				DecodeMultiInsert(ctx, record);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void
+DecodeXactOp(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	XLogReaderState *reader = ctx->reader;
+	uint8		info = record->xl_info & ~XLR_INFO_MASK;
+	char	   *data = XLogRecGetData(record);
+	TransactionId xid;
+	TransactionId *subxacts;
+	xl_xact_commit *xlrec;
+	xl_xact_abort *xlabort;
+
+	switch (info)
+	{
+		case XLOG_XACT_COMMIT:
+		case XLOG_XACT_COMMIT_PREPARED:
+			if (info == XLOG_XACT_COMMIT)
+			{
+				xid = record->xl_xid;
+				xlrec = (xl_xact_commit *) data;
+			}
+			else
+			{
+				xl_xact_commit_prepared *prec = (xl_xact_commit_prepared *) data;
+
+				xid = prec->xid;
+				xlrec = &prec->crec;
+			}
+			subxacts = (TransactionId *) &(xlrec->xnodes[xlrec->nrels]);
+
+			/*
+			 * A transaction that was already running when we started may
+			 * have made changes we didn't see, so don't emit any of it.
+			 * Neither emit one that a replication slot's client confirmed
+			 * before.
+			 */
+			if (TransactionIdPrecedes(xid, ctx->start_xid) ||
+				XLByteLE(reader->ReadRecPtr, ctx->confirmed_flush))
+			{
+				ReorderBufferAbort(ctx->reorder, xid,
+								   xlrec->nsubxacts, subxacts);
+				break;
+			}
+
+			ReorderBufferCommit(ctx->reorder, xid,
+								xlrec->nsubxacts, subxacts,
+								reader->ReadRecPtr, reader->EndRecPtr,
+								xlrec->xact_time);
+			break;
+
+		case XLOG_XACT_ABORT:
+		case XLOG_XACT_ABORT_PREPARED:
+			if (info == XLOG_XACT_ABORT)
+			{
+				xid = record->xl_xid;
+				xlabort = (xl_xact_abort *) data;
+			}
+			else
+			{
+				xl_xact_abort_prepared *prec = (xl_xact_abort_prepared *) data;
+
+				xid = prec->xid;
+				xlabort = &prec->arec;
+			}
+			subxacts = (TransactionId *) &(xlabort->xnodes[xlabort->nrels]);
+
+			ReorderBufferAbort(ctx->reorder, xid, xlabort->nsubxacts, subxacts);
+			break;
+
+		default:
+
+			/*
+			 * PREPARE needn't be handled, the changes of a prepared
+			 * transaction are emitted once it's committed.  ASSIGNMENT
+			 * records only matter to hot standby, the commit record lists
+			 * all the subtransactions again.
+			 */
+			break;
+	}
+}
+
+/*
+ * Build a tuple from the xl_heap_header fields and the tuple data logged
+ * for it: the null bitmap, padding, oid and column data.
+ */
+static HeapTuple
+DecodeTuple(LogicalDecodingContext *ctx, char *data, Size len,
+			uint16 t_infomask2, uint16 t_infomask, uint8 t_hoff)
+{
+	HeapTuple	tuple;
+	HeapTupleHeader header;
+
+	tuple = ReorderBufferGetTuple(ctx->reorder,
+								  len + offsetof(HeapTupleHeaderData, t_bits));
+	header = tuple->t_data;
+
+	MemSet(header, 0, offsetof(HeapTupleHeaderData, t_bits));
+	memcpy((char *) header + offsetof(HeapTupleHeaderData, t_bits), data, len);
+	header->t_infomask2 = t_infomask2;
+	header->t_infomask = t_infomask;
+	header->t_hoff = t_hoff;
+
+	return tuple;
+}
+
+static ReorderBufferChange *
+NewChange(LogicalDecodingContext *ctx, ReorderBufferChangeType action,
+		  RelFileNode *relnode)
+{
+	ReorderBufferChange *change = ReorderBufferGetChange(ctx->reorder);
+
+	change->action = action;
+	change->lsn = ctx->reader->ReadRecPtr;
+	change->relnode = *relnode;
+	return change;
+}
+
+static void
+DecodeInsert(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	xl_heap_insert *xlrec = (xl_heap_insert *) XLogRecGetData(record);
+	xl_heap_header xlhdr;
+	ReorderBufferChange *change;
+
+	if (xlrec->target.node.dbNode != MyDatabaseId)
+		return;
+
+	/* no tuple data if the page was backed up and the table isn't logged */
+	if (record->xl_len <= SizeOfHeapInsert + SizeOfHeapHeader)
+		return;
+
+	memcpy(&xlhdr, (char *) xlrec + SizeOfHeapInsert, SizeOfHeapHeader);
+
+	change = NewChange(ctx, REORDER_BUFFER_CHANGE_INSERT, &xlrec->target.node);
+	change->newtuple = DecodeTuple(ctx,
+						(char *) xlrec + SizeOfHeapInsert + SizeOfHeapHeader,
+						record->xl_len - SizeOfHeapInsert - SizeOfHeapHeader,
+						xlhdr.t_infomask2, xlhdr.t_infomask, xlhdr.t_hoff);
+	change->newtuple->t_self = xlrec->target.tid;
+
+	ReorderBufferQueueChange(ctx->reorder, record->xl_xid, change);
+}
+
+static void
+DecodeUpdate(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	xl_heap_update *xlrec = (xl_heap_update *) XLogRecGetData(record);
+	char	   *data = (char *) xlrec + SizeOfHeapUpdate;
+	xl_heap_header xlhdr;
+	Size		newlen;
+	ReorderBufferChange *change;
+
+	if (xlrec->target.node.dbNode != MyDatabaseId)
+		return;
+
+	if (record->xl_len <= SizeOfHeapUpdate + SizeOfHeapHeader)
+		return;
+
+	change = NewChange(ctx, REORDER_BUFFER_CHANGE_UPDATE, &xlrec->target.node);
+
+	memcpy(&xlhdr, data, SizeOfHeapHeader);
+	data += SizeOfHeapHeader;
+	newlen = record->xl_len - SizeOfHeapUpdate - SizeOfHeapHeader -
+		xlrec->old_key_len;
+	change->newtuple = DecodeTuple(ctx, data, newlen,
+						   xlhdr.t_infomask2, xlhdr.t_infomask, xlhdr.t_hoff);
+	ItemPointerSetBlockNumber(&change->newtuple->t_self,
+							  ItemPointerGetBlockNumber(&xlrec->newtid));
+	ItemPointerSetOffsetNumber(&change->newtuple->t_self,
+							   ItemPointerGetOffsetNumber(&xlrec->newtid));
+	data += newlen;
+
+	/* the key of the old row follows, if it changed */
+	if (xlrec->old_key_len > 0)
+	{
+		memcpy(&xlhdr, data, SizeOfHeapHeader);
+		data += SizeOfHeapHeader;
+		change->oldtuple = DecodeTuple(ctx, data,
+									xlrec->old_key_len - SizeOfHeapHeader,
+						   xlhdr.t_infomask2, xlhdr.t_infomask, xlhdr.t_hoff);
+		change->oldtuple->t_self = xlrec->target.tid;
+	}
+
+	ReorderBufferQueueChange(ctx->reorder, record->xl_xid, change);
+}
+
+static void
+DecodeDelete(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	xl_heap_delete *xlrec = (xl_heap_delete *) XLogRecGetData(record);
+	xl_heap_header xlhdr;
+	ReorderBufferChange *change;
+
+	if (xlrec->target.node.dbNode != MyDatabaseId)
+		return;
+
+	/* only logically logged tables have the old key in the record */
+	if (record->xl_len <= SizeOfHeapDelete + SizeOfHeapHeader)
+		return;
+
+	memcpy(&xlhdr, (char *) xlrec + SizeOfHeapDelete, SizeOfHeapHeader);
+
+	change = NewChange(ctx, REORDER_BUFFER_CHANGE_DELETE, &xlrec->target.node);
+	change->oldtuple = DecodeTuple(ctx,
+						(char *) xlrec + SizeOfHeapDelete + SizeOfHeapHeader,
+						record->xl_len - SizeOfHeapDelete - SizeOfHeapHeader,
+						xlhdr.t_infomask2, xlhdr.t_infomask, xlhdr.t_hoff);
+	change->oldtuple->t_self = xlrec->target.tid;
+
+	ReorderBufferQueueChange(ctx->reorder, record->xl_xid, change);
+}
+
+static void
+DecodeMultiInsert(LogicalDecodingContext *ctx, XLogRecord *record)
+{
+	char	   *recstart = XLogRecGetData(record);
+	char	   *data = recstart;
+	xl_heap_multi_insert *xlrec = (xl_heap_multi_insert *) data;
+	bool		isinit = (record->xl_info & XLOG_HEAP_INIT_PAGE) != 0;
+	int			i;
+
+	if (xlrec->node.dbNode != MyDatabaseId)
+		return;
+
+	data += SizeOfHeapMultiInsert;
+	if (!isinit)
+		data += sizeof(OffsetNumber) * xlrec->ntuples;
+
+	/* no tuple data if the page was backed up and the table isn't logged */
+	if (data - recstart >= record->xl_len)
+		return;
+
+	/* same layout as heap_xlog_multi_insert reads */
+	for (i = 0; i < xlrec->ntuples; i++)
+	{
+		xl_multi_insert_tuple *xlhdr;
+		ReorderBufferChange *change;
+		OffsetNumber offnum;
+
+		xlhdr = (xl_multi_insert_tuple *) SHORTALIGN(data);
+		data = ((char *) xlhdr) + SizeOfMultiInsertTuple;
+
+		change = NewChange(ctx, REORDER_BUFFER_CHANGE_INSERT, &xlrec->node);
+		change->newtuple = DecodeTuple(ctx, data, xlhdr->datalen,
+									   xlhdr->t_infomask2, xlhdr->t_infomask,
+									   xlhdr->t_hoff);
+		offnum = isinit ? FirstOffsetNumber + i : xlrec->offsets[i];
+		ItemPointerSet(&change->newtuple->t_self, xlrec->blkno, offnum);
+		data += xlhdr->datalen;
+
+		ReorderBufferQueueChange(ctx->reorder, record->xl_xid, change);
+	}
+}
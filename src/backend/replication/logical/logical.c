@@ -0,0 +1,502 @@
+/*-------------------------------------------------------------------------
+ *
+ * logical.c
+ *	  Decoding WAL into the row changes of committed transactions, and
+ *	  handing them to an output plugin.
+ *
+ * The caller reads WAL records with the context's XLogReader and passes
+ * them to DecodeRecordIntoReorderBuffer; committed transactions come out of
+ * the reorder buffer into the callbacks here, which look up the relation
+ * of each change and call the output plugin.
+ *
+ * Changes are interpreted with the catalog as it is now, not as it was when
+ * they were made.  That is safe for everything that matters to the tuple
+ * format: changing a column's type rewrites the table, which gives it a new
+ * relfilenode, and a dropped column stays in the tuple descriptor.  Changes
+ * to relations that no longer exist are skipped.
+ *
+ * Decoding starts at the current insert position.  Transactions that were
+ * already running then have made changes before it, which we can't see, so
+ * only transactions with an xid from ReadNewTransactionId() on are decoded.
+ *
+ * Decoding normally runs in a walsender, but the SQL functions in
+ * logicalfuncs.c also decode the changes retained by a slot, inside the
+ * transaction of the calling query.
+ *
+ * A replication slot lets decoding resume where the client left off.  At
+ * each running-xacts record we note a candidate restart point: the record
+ * itself or the first change of the oldest transaction still in the reorder
+ * buffer, whichever is older, with the record's oldest running xid as the
+ * xid to decode from.  Once the client confirms the last commit sent before
+ * the record, the slot moves there.  Commits at or before the confirmed
+ * location are skipped on resume.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/heapam.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "catalog/catalog.h"
+#include "catalog/pg_class.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "replication/logical.h"
+#include "storage/spin.h"
+#include "utils/fmgroids.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/tqual.h"
+
+
+/* entry of the cache mapping relfilenodes to relation OIDs */
+typedef struct RelfilenodeMapEntry
+{
+	RelFileNode relnode;		/* hash key */
+	Oid			relid;			/* InvalidOid if there's no such relation */
+} RelfilenodeMapEntry;
+
+static HTAB *RelfilenodeMapHash = NULL;
+
+/* memory context the output plugin callbacks were called in */
+static MemoryContext decoding_cxt = NULL;
+
+static void RelfilenodeMapInvalidateCallback(Datum arg, Oid relid);
+static Oid	RelidByRelfilenode(RelFileNode *relnode);
+static void begin_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void change_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn,
+				  ReorderBufferChange *change);
+static void commit_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void flush_output(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+			 TransactionId xid);
+static void LogicalAdvanceSlot(LogicalDecodingContext *ctx);
+
+
+/*
+ * Set up decoding of the WAL written from now on, with the given output
+ * plugin, or from where the given replication slot left off.  read_page
+ * reads WAL for the XLogReader, do_write ships the output of the plugin.
+ */
+LogicalDecodingContext *
+CreateLogicalDecodingContext(const char *plugin,
+							 ReplicationSlot *slot,
+							 XLogPageReadCB read_page,
+							 LogicalOutputWriterWrite do_write,
+							 void *writer_private)
+{
+	LogicalDecodingContext *ctx;
+	MemoryContext context;
+	MemoryContext oldcontext;
+	LogicalOutputPluginInit plugin_init;
+
+	if (wal_level < WAL_LEVEL_LOGICAL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical decoding requires wal_level \"logical\"")));
+
+	if (RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical decoding cannot be used during recovery")));
+
+	context = AllocSetContextCreate(CurrentMemoryContext,
+									"Logical Decoding",
+									ALLOCSET_DEFAULT_MINSIZE,
+									ALLOCSET_DEFAULT_INITSIZE,
+									ALLOCSET_DEFAULT_MAXSIZE);
+	oldcontext = MemoryContextSwitchTo(context);
+
+	ctx = (LogicalDecodingContext *) palloc0(sizeof(LogicalDecodingContext));
+	ctx->context = context;
+
+	/* look up the plugin before doing anything else that could fail */
+	plugin_init = (LogicalOutputPluginInit)
+		load_external_function((char *) plugin, "_PG_output_plugin_init",
+							   false, NULL);
+	if (plugin_init == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_FUNCTION),
+				 errmsg("output plugin \"%s\" does not define _PG_output_plugin_init",
+						plugin)));
+	plugin_init(&ctx->callbacks);
+	if (ctx->callbacks.begin_cb == NULL ||
+		ctx->callbacks.change_cb == NULL ||
+		ctx->callbacks.commit_cb == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("output plugin \"%s\" must register begin, change and commit callbacks",
+						plugin)));
+
+	/*
+	 * Every transaction that gets an xid from now on writes all its changes
+	 * after the current insert position, since assigning the xid comes
+	 * before writing any WAL.  Fetch the position first.
+	 */
+	if (slot != NULL)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *vslot = slot;
+
+		SpinLockAcquire(&vslot->mutex);
+		ctx->start_lsn = vslot->data.restart_lsn;
+		ctx->start_xid = vslot->data.catalog_xmin;
+		ctx->confirmed_flush = vslot->data.confirmed_flush;
+		SpinLockRelease(&vslot->mutex);
+		ctx->slot = slot;
+	}
+	else
+	{
+		ctx->start_lsn = GetXLogInsertRecPtr();
+		ctx->start_xid = ReadNewTransactionId();
+	}
+
+	ctx->reader = XLogReaderAllocate(read_page, writer_private);
+	if (ctx->reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	ctx->reorder = ReorderBufferAllocate();
+	ctx->reorder->begin = begin_cb_wrapper;
+	ctx->reorder->apply_change = change_cb_wrapper;
+	ctx->reorder->commit = commit_cb_wrapper;
+	ctx->reorder->private_data = ctx;
+
+	ctx->out = makeStringInfo();
+	ctx->write = do_write;
+	ctx->output_writer_private = writer_private;
+
+	if (RelfilenodeMapHash == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(RelFileNode);
+		ctl.entrysize = sizeof(RelfilenodeMapEntry);
+		ctl.hash = tag_hash;
+		ctl.hcxt = CacheMemoryContext;
+		RelfilenodeMapHash = hash_create("logical decoding relfilenode map",
+										 64, &ctl,
+									HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+		CacheRegisterRelcacheCallback(RelfilenodeMapInvalidateCallback,
+									  (Datum) 0);
+	}
+
+	if (ctx->callbacks.startup_cb != NULL)
+	{
+		ctx->callbacks.startup_cb(ctx);
+		flush_output(ctx, ctx->start_lsn, InvalidTransactionId);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	elog(DEBUG1, "logical decoding starts at %X/%X, with transaction %u",
+		 ctx->start_lsn.xlogid, ctx->start_lsn.xrecoff, ctx->start_xid);
+
+	return ctx;
+}
+
+void
+FreeLogicalDecodingContext(LogicalDecodingContext *ctx)
+{
+
+	if (ctx->callbacks.shutdown_cb != NULL)
+		ctx->callbacks.shutdown_cb(ctx);
+
+	ReorderBufferFree(ctx->reorder);
+	XLogReaderFree(ctx->reader);
+	MemoryContextDelete(ctx->context);
+}
+
+/*
+ * Called at each running-xacts record decoded, at lsn.  Transactions
+ * older than oldestRunningXid were all finished before it, so decoding can
+ * later restart here, or at the oldest transaction we're still collecting,
+ * and skip anything older.
+ */
+void
+LogicalDecodingRunningXacts(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+							TransactionId oldestRunningXid)
+{
+	ReorderBufferTXN *oldest;
+
+	/* without a slot, nothing remembers where we were */
+	if (ctx->slot == NULL)
+		return;
+
+	/* keep the pending candidate until it's been confirmed */
+	if (ctx->candidate_valid)
+		return;
+
+	ctx->candidate_restart_lsn = lsn;
+	oldest = ReorderBufferGetOldestTXN(ctx->reorder);
+	if (oldest != NULL && XLByteLT(oldest->first_lsn, lsn))
+		ctx->candidate_restart_lsn = oldest->first_lsn;
+	ctx->candidate_xmin = oldestRunningXid;
+	ctx->candidate_confirm_lsn = ctx->last_commit_lsn;
+	ctx->candidate_valid = true;
+
+	/* if everything sent so far is already confirmed, move right away */
+	LogicalAdvanceSlot(ctx);
+}
+
+/*
+ * The client has confirmed having received all transactions that committed
+ * at or before lsn.  Remember that in the slot, and move its restart point
+ * forward if that makes a candidate safe.
+ */
+void
+LogicalConfirmReceivedLocation(LogicalDecodingContext *ctx, XLogRecPtr lsn)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlot *slot = ctx->slot;
+
+	if (slot == NULL)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	if (XLByteLT(slot->data.confirmed_flush, lsn))
+	{
+		slot->data.confirmed_flush = lsn;
+		slot->dirty = true;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	LogicalAdvanceSlot(ctx);
+}
+
+/*
+ * Move the slot to the candidate restart point, if the client has
+ * confirmed everything sent before it.
+ */
+static void
+LogicalAdvanceSlot(LogicalDecodingContext *ctx)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlot *slot = ctx->slot;
+	bool		advanced = false;
+
+	if (!ctx->candidate_valid)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	if (XLByteLE(ctx->candidate_confirm_lsn, slot->data.confirmed_flush))
+	{
+		if (XLByteLT(slot->data.restart_lsn, ctx->candidate_restart_lsn))
+			slot->data.restart_lsn = ctx->candidate_restart_lsn;
+		if (TransactionIdPrecedes(slot->data.catalog_xmin, ctx->candidate_xmin))
+			slot->data.catalog_xmin = ctx->candidate_xmin;
+		slot->dirty = true;
+		advanced = true;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (advanced)
+	{
+		ctx->candidate_valid = false;
+		ReplicationSlotsComputeRequiredXmin();
+		ReplicationSlotsComputeRequiredLSN();
+	}
+}
+
+/*
+ * Ship what the plugin wrote, if anything.
+ */
+static void
+flush_output(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid)
+{
+	if (ctx->out->len > 0)
+	{
+		ctx->write(ctx, lsn, xid);
+		resetStringInfo(ctx->out);
+	}
+}
+
+/*
+ * The relcache doesn't tell us which relfilenodes changed, so forget them
+ * all on any invalidation.  They're cheap to look up again.
+ */
+static void
+RelfilenodeMapInvalidateCallback(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	RelfilenodeMapEntry *entry;
+
+	hash_seq_init(&status, RelfilenodeMapHash);
+	while ((entry = (RelfilenodeMapEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (hash_search(RelfilenodeMapHash, (void *) &entry->relnode,
+						HASH_REMOVE, NULL) == NULL)
+			elog(ERROR, "hash table corrupted");
+	}
+}
+
+/*
+ * Find the relation of the current database that has the given relfilenode,
+ * or InvalidOid if there's none.  Mapped relations are system catalogs,
+ * which we don't decode, so they needn't be found.
+ *
+ * Must be called in a transaction.
+ */
+static Oid
+RelidByRelfilenode(RelFileNode *relnode)
+{
+	RelfilenodeMapEntry *entry;
+	bool		found;
+	Relation	classrel;
+	HeapScanDesc scan;
+	ScanKeyData skey;
+	HeapTuple	tuple;
+	Oid			relid = InvalidOid;
+
+	entry = (RelfilenodeMapEntry *) hash_search(RelfilenodeMapHash,
+												(void *) relnode,
+												HASH_FIND, NULL);
+	if (entry != NULL)
+		return entry->relid;
+
+	/* there's no index on relfilenode, so scan pg_class */
+	ScanKeyInit(&skey,
+				Anum_pg_class_relfilenode,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(relnode->relNode));
+
+	classrel = heap_open(RelationRelationId, AccessShareLock);
+	scan = heap_beginscan(classrel, SnapshotNow, 1, &skey);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classform = (Form_pg_class) GETSTRUCT(tuple);
+		Oid			spcNode;
+
+		spcNode = OidIsValid(classform->reltablespace) ?
+			classform->reltablespace : MyDatabaseTableSpace;
+		if (spcNode == relnode->spcNode)
+		{
+			relid = HeapTupleGetOid(tuple);
+			break;
+		}
+	}
+	heap_endscan(scan);
+	heap_close(classrel, AccessShareLock);
+
+	/* the scan may have run invalidation callbacks; enter it only now */
+	entry = (RelfilenodeMapEntry *) hash_search(RelfilenodeMapHash,
+												(void *) relnode,
+												HASH_ENTER, &found);
+	entry->relid = relid;
+
+	return relid;
+}
+
+/*
+ * Reorder buffer callbacks.  Each committed transaction is passed to the
+ * plugin inside a transaction, so that it can look at the catalogs: one of
+ * our own in a walsender, the caller's in the SQL functions.
+ *
+ * The plugin only gets to see transactions that changed user tables; the
+ * begin callback is held back until the first such change.  Changes to
+ * catalogs are in the WAL only when their page wasn't backed up, so it
+ * would be down to chance whether a DDL command shows up as an empty
+ * transaction.
+ */
+static void
+begin_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = (LogicalDecodingContext *) rb->private_data;
+
+	ctx->own_xact = !IsTransactionOrTransactionBlock();
+	if (ctx->own_xact)
+	{
+		decoding_cxt = CurrentMemoryContext;
+		StartTransactionCommand();
+	}
+	ctx->txn_begun = false;
+}
+
+static void
+change_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn,
+				  ReorderBufferChange *change)
+{
+	LogicalDecodingContext *ctx = (LogicalDecodingContext *) rb->private_data;
+	Oid			relid;
+	Relation	relation;
+	HeapTuple	tuple;
+
+	relid = RelidByRelfilenode(&change->relnode);
+	if (!OidIsValid(relid))
+	{
+		elog(DEBUG2, "skipping change to relation with relfilenode %u that no longer exists",
+			 change->relnode.relNode);
+		return;
+	}
+
+	relation = try_relation_open(relid, AccessShareLock);
+	if (relation == NULL)
+		return;
+
+	/* only plain user tables are of interest */
+	if (relation->rd_rel->relkind != RELKIND_RELATION ||
+		IsSystemRelation(relation))
+	{
+		relation_close(relation, AccessShareLock);
+		return;
+	}
+
+	/*
+	 * A tuple can have fewer columns than the descriptor, if columns were
+	 * added since, but not more.
+	 */
+	tuple = change->newtuple ? change->newtuple : change->oldtuple;
+	if (HeapTupleHeaderGetNatts(tuple->t_data) > RelationGetNumberOfAttributes(relation))
+	{
+		elog(DEBUG2, "skipping change to relation \"%s\" that doesn't match its tuple descriptor",
+			 RelationGetRelationName(relation));
+		relation_close(relation, AccessShareLock);
+		return;
+	}
+
+	if (change->newtuple)
+		change->newtuple->t_tableOid = relid;
+	if (change->oldtuple)
+		change->oldtuple->t_tableOid = relid;
+
+	if (!ctx->txn_begun)
+	{
+		ctx->callbacks.begin_cb(ctx, txn);
+		flush_output(ctx, txn->first_lsn, txn->xid);
+		ctx->txn_begun = true;
+	}
+
+	ctx->callbacks.change_cb(ctx, txn, relation, change);
+	flush_output(ctx, change->lsn, txn->xid);
+
+	relation_close(relation, NoLock);
+}
+
+static void
+commit_cb_wrapper(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	LogicalDecodingContext *ctx = (LogicalDecodingContext *) rb->private_data;
+
+	if (ctx->txn_begun)
+	{
+		ctx->callbacks.commit_cb(ctx, txn, txn->final_lsn);
+		flush_output(ctx, txn->final_lsn, txn->xid);
+		ctx->last_commit_lsn = txn->final_lsn;
+	}
+
+	/* commits only read-only work, so this can't write WAL */
+	if (ctx->own_xact)
+	{
+		CommitTransactionCommand();
+		MemoryContextSwitchTo(decoding_cxt);
+	}
+}
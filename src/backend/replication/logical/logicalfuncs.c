@@ -0,0 +1,370 @@
+/*-------------------------------------------------------------------------
+ *
+ * logicalfuncs.c
+ *	  SQL functions to read the changes retained by a logical replication
+ *	  slot.
+ *
+ * pg_logical_slot_get_changes decodes the WAL from where the slot's client
+ * left off up to the WAL flushed when it's called, and returns what the
+ * slot's output plugin makes of it as rows.  It then confirms everything it
+ * has read, like a client streaming from the slot would, so the next call
+ * continues from there.  pg_logical_slot_peek_changes does the same, except
+ * that it doesn't confirm anything, so the same changes are returned again.
+ *
+ * Unlike in a walsender, decoding runs inside the transaction of the
+ * calling query, which logical.c copes with.  Changes made by that
+ * transaction itself are not committed yet, so they are never returned.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/transam.h"
+#include "access/xlog_internal.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "replication/logical.h"
+#include "storage/fd.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+
+
+/* private state of the page reader and the writer */
+typedef struct DecodingOutputState
+{
+	XLogRecPtr	end_of_wal;		/* decode the WAL up to here */
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+} DecodingOutputState;
+
+/* the WAL segment file being read, if any */
+static int	readFile = -1;
+static uint32 readId = 0;
+static uint32 readSeg = 0;
+static uint32 readOff = 0;
+
+static Datum pg_logical_slot_get_changes_guts(FunctionCallInfo fcinfo,
+								 bool confirm);
+static int	logical_read_local_xlog_page(XLogReaderState *state,
+							 XLogRecPtr targetPagePtr, int reqLen,
+							 char *cur_page, void *private_data);
+static void logical_read_wal(char *buf, XLogRecPtr recptr, Size nbytes);
+static void logical_close_wal(void);
+static void LogicalOutputWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+				   TransactionId xid);
+
+
+/*
+ * pg_logical_slot_get_changes(slot_name)
+ */
+Datum
+pg_logical_slot_get_changes(PG_FUNCTION_ARGS)
+{
+	return pg_logical_slot_get_changes_guts(fcinfo, true);
+}
+
+/*
+ * pg_logical_slot_peek_changes(slot_name)
+ */
+Datum
+pg_logical_slot_peek_changes(PG_FUNCTION_ARGS)
+{
+	return pg_logical_slot_get_changes_guts(fcinfo, false);
+}
+
+static Datum
+pg_logical_slot_get_changes_guts(FunctionCallInfo fcinfo, bool confirm)
+{
+	Name		name = PG_GETARG_NAME(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	DecodingOutputState p;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to use replication slots")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* need to build tuplestore in query context */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/* this must match the definition of the functions in pg_proc.h */
+	tupdesc = CreateTemplateTupleDesc(3, false);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "location",
+					   TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "xid",
+					   XIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "data",
+					   TEXTOID, -1, 0);
+
+	tupstore =
+		tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random,
+							  false, work_mem);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	p.end_of_wal = GetFlushRecPtr();
+	p.tupstore = tupstore;
+	p.tupdesc = tupdesc;
+
+	ReplicationSlotAcquire(NameStr(*name));
+
+	PG_TRY();
+	{
+		LogicalDecodingContext *ctx;
+		XLogRecPtr	startptr;
+		XLogRecord *record;
+		char	   *errm;
+
+		if (MyReplicationSlot->data.database != MyDatabaseId)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("replication slot \"%s\" is not a logical slot of this database",
+							NameStr(*name))));
+
+		ctx = CreateLogicalDecodingContext(NameStr(MyReplicationSlot->data.plugin),
+										   MyReplicationSlot,
+										   logical_read_local_xlog_page,
+										   LogicalOutputWrite, &p);
+
+		startptr = ctx->start_lsn;
+		for (;;)
+		{
+			record = XLogReadRecord(ctx->reader, startptr, &errm);
+			if (record == NULL)
+			{
+				if (errm != NULL)
+					ereport(ERROR,
+							(errmsg("could not decode WAL at %X/%X: %s",
+									ctx->reader->EndRecPtr.xlogid,
+									ctx->reader->EndRecPtr.xrecoff, errm)));
+				break;
+			}
+			startptr.xlogid = 0;
+			startptr.xrecoff = 0;
+
+			DecodeRecordIntoReorderBuffer(ctx, record);
+
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		/*
+		 * Every transaction that committed before the end of the last record
+		 * read has been returned, or skipped as returned before.
+		 */
+		if (confirm && !XLogRecPtrIsInvalid(ctx->reader->EndRecPtr))
+			LogicalConfirmReceivedLocation(ctx, ctx->reader->EndRecPtr);
+
+		FreeLogicalDecodingContext(ctx);
+	}
+	PG_CATCH();
+	{
+		logical_close_wal();
+		ReplicationSlotRelease();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	logical_close_wal();
+	ReplicationSlotRelease();
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	return (Datum) 0;
+}
+
+/*
+ * XLogReader callback: read a page of the WAL, up to the end of the WAL
+ * flushed when we started.
+ */
+static int
+logical_read_local_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
+							 int reqLen, char *cur_page, void *private_data)
+{
+	DecodingOutputState *p = (DecodingOutputState *) private_data;
+	XLogRecPtr	endptr = p->end_of_wal;
+	int			count;
+
+	if (XLByteLE(endptr, targetPagePtr))
+		return -1;
+
+	if (endptr.xlogid != targetPagePtr.xlogid ||
+		endptr.xrecoff - targetPagePtr.xrecoff >= XLOG_BLCKSZ)
+		count = XLOG_BLCKSZ;
+	else
+	{
+		count = endptr.xrecoff - targetPagePtr.xrecoff;
+		if (count < reqLen)
+			return -1;
+	}
+
+	logical_read_wal(cur_page, targetPagePtr, count);
+
+	return count;
+}
+
+/*
+ * Read nbytes of WAL from recptr on into buf.  This is like XLogRead in
+ * walsender.c, but reads the WAL of our current timeline.
+ */
+static void
+logical_read_wal(char *buf, XLogRecPtr recptr, Size nbytes)
+{
+	XLogRecPtr	startRecPtr = recptr;
+	char		path[MAXPGPATH];
+	uint32		lastRemovedLog;
+	uint32		lastRemovedSeg;
+	uint32		log;
+	uint32		seg;
+
+	while (nbytes > 0)
+	{
+		uint32		startoff;
+		int			segbytes;
+		int			readbytes;
+
+		startoff = recptr.xrecoff % XLogSegSize;
+
+		if (readFile < 0 || !XLByteInSeg(recptr, readId, readSeg))
+		{
+			/* Switch to another logfile segment */
+			logical_close_wal();
+
+			XLByteToSeg(recptr, readId, readSeg);
+			XLogFilePath(path, ThisTimeLineID, readId, readSeg);
+
+			readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+			if (readFile < 0)
+			{
+				if (errno == ENOENT)
+				{
+					char		filename[MAXFNAMELEN];
+
+					XLogFileName(filename, ThisTimeLineID, readId, readSeg);
+					ereport(ERROR,
+							(errcode_for_file_access(),
+							 errmsg("requested WAL segment %s has already been removed",
+									filename)));
+				}
+				else
+					ereport(ERROR,
+							(errcode_for_file_access(),
+							 errmsg("could not open file \"%s\" (log file %u, segment %u): %m",
+									path, readId, readSeg)));
+			}
+			readOff = 0;
+		}
+
+		/* Need to seek in the file? */
+		if (readOff != startoff)
+		{
+			if (lseek(readFile, (off_t) startoff, SEEK_SET) < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not seek in log file %u, segment %u to offset %u: %m",
+								readId, readSeg, startoff)));
+			readOff = startoff;
+		}
+
+		/* How many bytes are within this segment? */
+		if (nbytes > (XLogSegSize - startoff))
+			segbytes = XLogSegSize - startoff;
+		else
+			segbytes = nbytes;
+
+		readbytes = read(readFile, buf, segbytes);
+		if (readbytes <= 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+			errmsg("could not read from log file %u, segment %u, offset %u, "
+				   "length %lu: %m",
+				   readId, readSeg, readOff, (unsigned long) segbytes)));
+
+		/* Update state for read */
+		XLByteAdvance(recptr, readbytes);
+
+		readOff += readbytes;
+		nbytes -= readbytes;
+		buf += readbytes;
+	}
+
+	/* check that the segment wasn't recycled while we read it */
+	XLogGetLastRemoved(&lastRemovedLog, &lastRemovedSeg);
+	XLByteToSeg(startRecPtr, log, seg);
+	if (log < lastRemovedLog ||
+		(log == lastRemovedLog && seg <= lastRemovedSeg))
+	{
+		char		filename[MAXFNAMELEN];
+
+		XLogFileName(filename, ThisTimeLineID, log, seg);
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("requested WAL segment %s has already been removed",
+						filename)));
+	}
+}
+
+static void
+logical_close_wal(void)
+{
+	if (readFile >= 0)
+	{
+		close(readFile);
+		readFile = -1;
+	}
+}
+
+/*
+ * LogicalOutputWriterWrite callback: add a row with the plugin's output.
+ */
+static void
+LogicalOutputWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+				   TransactionId xid)
+{
+	DecodingOutputState *p = (DecodingOutputState *) ctx->output_writer_private;
+	Datum		values[3];
+	bool		nulls[3];
+	char		location[MAXFNAMELEN];
+
+	MemSet(nulls, 0, sizeof(nulls));
+
+	snprintf(location, sizeof(location), "%X/%X", lsn.xlogid, lsn.xrecoff);
+	values[0] = CStringGetTextDatum(location);
+	if (TransactionIdIsValid(xid))
+		values[1] = TransactionIdGetDatum(xid);
+	else
+		nulls[1] = true;
+	values[2] = PointerGetDatum(cstring_to_text_with_len(ctx->out->data,
+														 ctx->out->len));
+
+	tuplestore_putvalues(p->tupstore, p->tupdesc, values, nulls);
+}
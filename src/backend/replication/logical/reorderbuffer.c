@@ -0,0 +1,530 @@
+/*-------------------------------------------------------------------------
+ *
+ * reorderbuffer.c
+ *	  Reassembly of the row changes decoded from WAL into transactions.
+ *
+ * WAL contains the changes of all concurrently running transactions,
+ * interleaved, and we only learn at commit or abort whether a transaction's
+ * changes are to be emitted at all.  So the decoder queues each change here
+ * under the xid that made it, and when the commit record arrives, the
+ * changes of the transaction and of its committed subtransactions (which
+ * have xids of their own) are replayed to the callbacks in WAL order, by
+ * merging their per-xid streams.  Aborted transactions are thrown away.
+ *
+ * To bound memory use, once a transaction has more than
+ * max_changes_in_memory changes queued, they are written out to a temporary
+ * file and read back at commit.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/transam.h"
+#include "replication/reorderbuffer.h"
+#include "storage/buffile.h"
+#include "utils/memutils.h"
+
+
+/* spill a transaction's changes to disk once it has this many in memory */
+static const int max_changes_in_memory = 4096;
+
+/* format of a change written to a spill file */
+typedef struct ReorderBufferDiskChange
+{
+	ReorderBufferChangeType action;
+	XLogRecPtr	lsn;
+	RelFileNode relnode;
+	uint32		oldlen;			/* t_len of oldtuple, 0 if none */
+	uint32		newlen;			/* t_len of newtuple, 0 if none */
+	/* DATA OF OLD TUPLE, THEN OF NEW TUPLE, FOLLOW */
+} ReorderBufferDiskChange;
+
+/* state for reading the changes of one transaction back in WAL order */
+typedef struct ReorderBufferIter
+{
+	ReorderBufferTXN *txn;
+	bool		reading_file;	/* still reading the spill file? */
+	ReorderBufferChange *next_mem;	/* next change in memory to return */
+	ReorderBufferChange *current;	/* current change, NULL at the end */
+	bool		current_from_file;	/* must current be freed after use? */
+} ReorderBufferIter;
+
+static ReorderBufferTXN *ReorderBufferTXNByXid(ReorderBuffer *rb,
+					  TransactionId xid, bool create);
+static void ReorderBufferReturnChange(ReorderBuffer *rb,
+						  ReorderBufferChange *change);
+static void ReorderBufferCleanupTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static void ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
+static HeapTuple ReorderBufferRestoreTuple(ReorderBuffer *rb, BufFile *file,
+						  uint32 len);
+static ReorderBufferChange *ReorderBufferRestoreChange(ReorderBuffer *rb,
+						   BufFile *file);
+static void ReorderBufferIterNext(ReorderBuffer *rb, ReorderBufferIter *it);
+
+
+/*
+ * Allocate a new, empty reorder buffer in the current memory context.  The
+ * caller must fill in the callbacks.
+ */
+ReorderBuffer *
+ReorderBufferAllocate(void)
+{
+	ReorderBuffer *rb;
+	HASHCTL		hash_ctl;
+
+	rb = (ReorderBuffer *) palloc0(sizeof(ReorderBuffer));
+
+	rb->context = AllocSetContextCreate(CurrentMemoryContext,
+										"ReorderBuffer",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(TransactionId);
+	hash_ctl.entrysize = sizeof(ReorderBufferTXN);
+	hash_ctl.hash = tag_hash;
+	hash_ctl.hcxt = rb->context;
+	rb->by_txn = hash_create("ReorderBuffer transactions", 1000, &hash_ctl,
+							 HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+
+	return rb;
+}
+
+/*
+ * Free a reorder buffer, with all the transactions still in it.
+ */
+void
+ReorderBufferFree(ReorderBuffer *rb)
+{
+	HASH_SEQ_STATUS status;
+	ReorderBufferTXN *txn;
+
+	/* the spill files aren't memory, close them explicitly */
+	hash_seq_init(&status, rb->by_txn);
+	while ((txn = (ReorderBufferTXN *) hash_seq_search(&status)) != NULL)
+	{
+		if (txn->spill_file)
+			BufFileClose(txn->spill_file);
+	}
+
+	MemoryContextDelete(rb->context);
+	pfree(rb);
+}
+
+/*
+ * Get a change to fill in and pass to ReorderBufferQueueChange.
+ */
+ReorderBufferChange *
+ReorderBufferGetChange(ReorderBuffer *rb)
+{
+	return (ReorderBufferChange *)
+		MemoryContextAllocZero(rb->context, sizeof(ReorderBufferChange));
+}
+
+/*
+ * Get a tuple with room for len bytes of tuple data, for a change.  The
+ * tuple header and the data are allocated as one chunk, as heap_copytuple
+ * does.
+ */
+HeapTuple
+ReorderBufferGetTuple(ReorderBuffer *rb, Size len)
+{
+	HeapTuple	tuple;
+
+	tuple = (HeapTuple) MemoryContextAlloc(rb->context, HEAPTUPLESIZE + len);
+	tuple->t_len = len;
+	ItemPointerSetInvalid(&tuple->t_self);
+	tuple->t_tableOid = InvalidOid;
+	tuple->t_data = (HeapTupleHeader) ((char *) tuple + HEAPTUPLESIZE);
+
+	return tuple;
+}
+
+static void
+ReorderBufferReturnChange(ReorderBuffer *rb, ReorderBufferChange *change)
+{
+	if (change->oldtuple)
+		pfree(change->oldtuple);
+	if (change->newtuple)
+		pfree(change->newtuple);
+	pfree(change);
+}
+
+/*
+ * Look up the transaction with the given xid, optionally creating it.
+ */
+static ReorderBufferTXN *
+ReorderBufferTXNByXid(ReorderBuffer *rb, TransactionId xid, bool create)
+{
+	ReorderBufferTXN *txn;
+	bool		found;
+
+	txn = (ReorderBufferTXN *) hash_search(rb->by_txn, (void *) &xid,
+										   create ? HASH_ENTER : HASH_FIND,
+										   &found);
+	if (create && !found)
+	{
+		/* hash_search has filled in the xid */
+		MemSet(&txn->first_lsn, 0, sizeof(XLogRecPtr));
+		MemSet(&txn->final_lsn, 0, sizeof(XLogRecPtr));
+		MemSet(&txn->end_lsn, 0, sizeof(XLogRecPtr));
+		txn->commit_time = 0;
+		txn->changes = NULL;
+		txn->changes_tail = NULL;
+		txn->nentries = 0;
+		txn->nentries_mem = 0;
+		txn->spill_file = NULL;
+	}
+
+	return txn;
+}
+
+/*
+ * Queue a change made by transaction (or subtransaction) xid.  The reorder
+ * buffer takes ownership of the change, which must have been obtained from
+ * ReorderBufferGetChange, and of its tuples.
+ */
+void
+ReorderBufferQueueChange(ReorderBuffer *rb, TransactionId xid,
+						 ReorderBufferChange *change)
+{
+	ReorderBufferTXN *txn = ReorderBufferTXNByXid(rb, xid, true);
+
+	if (txn->nentries == 0)
+		txn->first_lsn = change->lsn;
+
+	change->next = NULL;
+	if (txn->changes_tail)
+		txn->changes_tail->next = change;
+	else
+		txn->changes = change;
+	txn->changes_tail = change;
+	txn->nentries++;
+	txn->nentries_mem++;
+
+	if (txn->nentries_mem >= max_changes_in_memory)
+		ReorderBufferSerializeTXN(rb, txn);
+}
+
+/*
+ * Transaction xid committed, with the given committed subtransactions.
+ * Replay all their changes to the callbacks, in WAL order, and forget
+ * about them.
+ *
+ * Nothing is replayed if none of them made any changes.
+ */
+void
+ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
+					int nsubxacts, TransactionId *subxacts,
+					XLogRecPtr commit_lsn, XLogRecPtr end_lsn,
+					TimestampTz commit_time)
+{
+	ReorderBufferTXN *txn;
+	ReorderBufferIter *iters;
+	int			niters = 0;
+	int			nentries = 0;
+	int			i;
+
+	/*
+	 * Collect the transactions that have changes.  The top transaction is
+	 * created if need be, since it's what the callbacks get to see.
+	 */
+	iters = (ReorderBufferIter *) palloc((nsubxacts + 1) *
+										 sizeof(ReorderBufferIter));
+	for (i = -1; i < nsubxacts; i++)
+	{
+		ReorderBufferTXN *subtxn;
+
+		subtxn = ReorderBufferTXNByXid(rb, i < 0 ? xid : subxacts[i], false);
+		if (subtxn == NULL)
+			continue;
+		nentries += subtxn->nentries;
+		iters[niters++].txn = subtxn;
+	}
+
+	if (nentries == 0)
+	{
+		for (i = 0; i < niters; i++)
+			ReorderBufferCleanupTXN(rb, iters[i].txn);
+		pfree(iters);
+		return;
+	}
+
+	txn = ReorderBufferTXNByXid(rb, xid, true);
+	txn->final_lsn = commit_lsn;
+	txn->end_lsn = end_lsn;
+	txn->commit_time = commit_time;
+
+	/* Start reading each transaction's changes, beginning with the file */
+	for (i = 0; i < niters; i++)
+	{
+		ReorderBufferIter *it = &iters[i];
+
+		if (it->txn->nentries > 0 &&
+			(XLogRecPtrIsInvalid(txn->first_lsn) ||
+			 XLByteLT(it->txn->first_lsn, txn->first_lsn)))
+			txn->first_lsn = it->txn->first_lsn;
+
+		it->reading_file = false;
+		if (it->txn->spill_file)
+		{
+			if (BufFileSeek(it->txn->spill_file, 0, 0L, SEEK_SET) != 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not rewind reorder buffer spill file: %m")));
+			it->reading_file = true;
+		}
+		it->next_mem = it->txn->changes;
+		ReorderBufferIterNext(rb, it);
+	}
+
+	rb->begin(rb, txn);
+
+	/* Merge the streams, always applying the oldest change next */
+	for (;;)
+	{
+		ReorderBufferIter *oldest = NULL;
+
+		for (i = 0; i < niters; i++)
+		{
+			if (iters[i].current != NULL &&
+				(oldest == NULL ||
+				 XLByteLT(iters[i].current->lsn, oldest->current->lsn)))
+				oldest = &iters[i];
+		}
+		if (oldest == NULL)
+			break;
+
+		rb->apply_change(rb, txn, oldest->current);
+
+		if (oldest->current_from_file)
+			ReorderBufferReturnChange(rb, oldest->current);
+		ReorderBufferIterNext(rb, oldest);
+	}
+
+	rb->commit(rb, txn);
+
+	for (i = 0; i < niters; i++)
+	{
+		if (iters[i].txn != txn)
+			ReorderBufferCleanupTXN(rb, iters[i].txn);
+	}
+	ReorderBufferCleanupTXN(rb, txn);
+	pfree(iters);
+}
+
+/*
+ * Transaction xid aborted, with the given subtransactions.  Forget their
+ * changes.  This also works for a subtransaction that aborts on its own.
+ */
+void
+ReorderBufferAbort(ReorderBuffer *rb, TransactionId xid,
+				   int nsubxacts, TransactionId *subxacts)
+{
+	ReorderBufferTXN *txn;
+	int			i;
+
+	for (i = -1; i < nsubxacts; i++)
+	{
+		txn = ReorderBufferTXNByXid(rb, i < 0 ? xid : subxacts[i], false);
+		if (txn != NULL)
+			ReorderBufferCleanupTXN(rb, txn);
+	}
+}
+
+/*
+ * Forget all transactions older than oldestRunningXid.  They can't be
+ * running anymore, but we never saw their commit or abort record, which
+ * happens if the server crashed while they were running: after a crash,
+ * transactions that were in progress aren't marked as aborted in WAL.
+ */
+void
+ReorderBufferAbortOld(ReorderBuffer *rb, TransactionId oldestRunningXid)
+{
+	HASH_SEQ_STATUS status;
+	ReorderBufferTXN *txn;
+
+	hash_seq_init(&status, rb->by_txn);
+	while ((txn = (ReorderBufferTXN *) hash_seq_search(&status)) != NULL)
+	{
+		if (TransactionIdPrecedes(txn->xid, oldestRunningXid))
+		{
+			elog(DEBUG2, "discarding changes of transaction %u that is no longer running",
+				 txn->xid);
+			/* deleting the entry just returned is OK during a scan */
+			ReorderBufferCleanupTXN(rb, txn);
+		}
+	}
+}
+
+/*
+ * Return the transaction with the oldest first change, or NULL if there
+ * are none.  Decoding must restart before it to see all of its changes.
+ */
+ReorderBufferTXN *
+ReorderBufferGetOldestTXN(ReorderBuffer *rb)
+{
+	HASH_SEQ_STATUS status;
+	ReorderBufferTXN *txn;
+	ReorderBufferTXN *oldest = NULL;
+
+	hash_seq_init(&status, rb->by_txn);
+	while ((txn = (ReorderBufferTXN *) hash_seq_search(&status)) != NULL)
+	{
+		if (oldest == NULL || XLByteLT(txn->first_lsn, oldest->first_lsn))
+			oldest = txn;
+	}
+	return oldest;
+}
+
+/*
+ * Free all the changes of a transaction, and the transaction itself.
+ */
+static void
+ReorderBufferCleanupTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	ReorderBufferChange *change;
+	TransactionId xid = txn->xid;
+
+	change = txn->changes;
+	while (change != NULL)
+	{
+		ReorderBufferChange *next = change->next;
+
+		ReorderBufferReturnChange(rb, change);
+		change = next;
+	}
+
+	if (txn->spill_file)
+		BufFileClose(txn->spill_file);
+
+	if (hash_search(rb->by_txn, (void *) &xid, HASH_REMOVE, NULL) == NULL)
+		elog(ERROR, "transaction %u not found in reorder buffer", xid);
+}
+
+/*
+ * Append the changes of txn that are in memory to its spill file, and free
+ * them.
+ */
+static void
+ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
+{
+	ReorderBufferChange *change;
+
+	if (txn->spill_file == NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(rb->context);
+
+		/* the file has to survive the transactions we run to decode */
+		txn->spill_file = BufFileCreateTemp(true);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	elog(DEBUG2, "spilling %d changes of transaction %u to disk",
+		 txn->nentries_mem, txn->xid);
+
+	change = txn->changes;
+	while (change != NULL)
+	{
+		ReorderBufferChange *next = change->next;
+		ReorderBufferDiskChange ondisk;
+
+		ondisk.action = change->action;
+		ondisk.lsn = change->lsn;
+		ondisk.relnode = change->relnode;
+		ondisk.oldlen = change->oldtuple ? change->oldtuple->t_len : 0;
+		ondisk.newlen = change->newtuple ? change->newtuple->t_len : 0;
+
+		if (BufFileWrite(txn->spill_file, &ondisk, sizeof(ondisk)) != sizeof(ondisk) ||
+			(ondisk.oldlen > 0 &&
+			 BufFileWrite(txn->spill_file, change->oldtuple->t_data,
+						  ondisk.oldlen) != ondisk.oldlen) ||
+			(ondisk.newlen > 0 &&
+			 BufFileWrite(txn->spill_file, change->newtuple->t_data,
+						  ondisk.newlen) != ondisk.newlen))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to reorder buffer spill file: %m")));
+
+		ReorderBufferReturnChange(rb, change);
+		change = next;
+	}
+
+	txn->changes = NULL;
+	txn->changes_tail = NULL;
+	txn->nentries_mem = 0;
+}
+
+static HeapTuple
+ReorderBufferRestoreTuple(ReorderBuffer *rb, BufFile *file, uint32 len)
+{
+	HeapTuple	tuple;
+
+	if (len == 0)
+		return NULL;
+
+	tuple = ReorderBufferGetTuple(rb, len);
+	if (BufFileRead(file, tuple->t_data, len) != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorder buffer spill file: %m")));
+	return tuple;
+}
+
+/*
+ * Read the next change from a spill file, or return NULL at its end.
+ */
+static ReorderBufferChange *
+ReorderBufferRestoreChange(ReorderBuffer *rb, BufFile *file)
+{
+	ReorderBufferDiskChange ondisk;
+	ReorderBufferChange *change;
+	size_t		nread;
+
+	nread = BufFileRead(file, &ondisk, sizeof(ondisk));
+	if (nread == 0)
+		return NULL;
+	if (nread != sizeof(ondisk))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorder buffer spill file: %m")));
+
+	change = ReorderBufferGetChange(rb);
+	change->action = ondisk.action;
+	change->lsn = ondisk.lsn;
+	change->relnode = ondisk.relnode;
+	change->oldtuple = ReorderBufferRestoreTuple(rb, file, ondisk.oldlen);
+	change->newtuple = ReorderBufferRestoreTuple(rb, file, ondisk.newlen);
+
+	return change;
+}
+
+/*
+ * Advance an iterator to the next change of its transaction: first those in
+ * the spill file, then those still in memory.
+ */
+static void
+ReorderBufferIterNext(ReorderBuffer *rb, ReorderBufferIter *it)
+{
+	if (it->reading_file)
+	{
+		it->current = ReorderBufferRestoreChange(rb, it->txn->spill_file);
+		if (it->current != NULL)
+		{
+			it->current_from_file = true;
+			return;
+		}
+		it->reading_file = false;
+	}
+
+	it->current = it->next_mem;
+	it->current_from_file = false;
+	if (it->next_mem != NULL)
+		it->next_mem = it->next_mem->next;
+}
@@ -0,0 +1,767 @@
+/*-------------------------------------------------------------------------
+ *
+ * slot.c
+ *	  Replication slot management.
+ *
+ * A replication slot remembers, across disconnections and restarts, how far
+ * a replication consumer has got: the oldest WAL it might still request,
+ * and the oldest transactions whose row versions it might still need.
+ * Checkpoints keep the WAL from the oldest restart_lsn of all slots, and
+ * GetOldestXmin and GetSnapshotData keep the rows the oldest slot xmin can
+ * see, so that a consumer that is down for a while can resume where it left
+ * off instead of having to be rebuilt from scratch.  The price is that a
+ * slot whose consumer never comes back holds back both until it's dropped,
+ * which is why pg_replication_slots shows how far behind each slot is.
+ *
+ * The slots live in shared memory, one array of max_replication_slots
+ * entries.  Creating or dropping a slot requires ReplicationSlotAllocationLock
+ * in exclusive mode, which is held while the slot's file is written or
+ * removed.  ReplicationSlotControlLock protects the in_use flags, and is
+ * only held in exclusive mode to flip one, never across disk I/O, so that
+ * slot lookups don't wait for the disk.  The fields of a slot are protected
+ * by its spinlock.
+ * A slot can be in use by at most one walsender at a time.
+ *
+ * Each slot is also saved in a file in pg_replslot, named after the slot,
+ * when it's created and at every checkpoint after it has changed.  The
+ * checkpoint saves the slots before it removes any WAL, so after a crash a
+ * slot never points to WAL that's no longer there; at worst it's a little
+ * behind, and the consumer receives some data again.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/transam.h"
+#include "access/xlog_internal.h"
+#include "miscadmin.h"
+#include "replication/slot.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/pg_crc.h"
+
+
+/* directory the slots are saved in, relative to the data directory */
+#define REPLSLOT_DIR		"pg_replslot"
+
+/*
+ * Format of the file a slot is saved in.  The CRC covers everything after
+ * it.
+ */
+typedef struct ReplicationSlotOnDisk
+{
+	uint32		magic;
+	pg_crc32	checksum;
+	uint32		version;
+	ReplicationSlotPersistentData slotdata;
+} ReplicationSlotOnDisk;
+
+#define SLOT_MAGIC		0x1051CA1		/* format identifier */
+#define SLOT_VERSION	1		/* version for new files */
+
+#define SlotChecksummedSize \
+	(sizeof(ReplicationSlotOnDisk) - offsetof(ReplicationSlotOnDisk, version))
+
+/* Control array for replication slots in shared memory */
+ReplicationSlotCtlData *ReplicationSlotCtl = NULL;
+
+/* The slot acquired by this walsender, if any */
+ReplicationSlot *MyReplicationSlot = NULL;
+
+/* GUC variable */
+int			max_replication_slots = 0;	/* the maximum number of slots */
+
+static void ReplicationSlotValidateName(const char *name);
+static ReplicationSlot *SearchSlot(const char *name);
+static void SaveSlot(ReplicationSlot *slot, const char *name);
+static void RestoreSlotFromDisk(const char *name);
+static void fsync_slot_dir(void);
+
+
+/* Report shared-memory space needed by ReplicationSlotsShmemInit */
+Size
+ReplicationSlotsShmemSize(void)
+{
+	Size		size = 0;
+
+	if (max_replication_slots == 0)
+		return size;
+
+	size = offsetof(ReplicationSlotCtlData, replication_slots);
+	size = add_size(size,
+					mul_size(max_replication_slots, sizeof(ReplicationSlot)));
+
+	return size;
+}
+
+/* Allocate and initialize the shared memory of replication slots */
+void
+ReplicationSlotsShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	if (max_replication_slots == 0)
+		return;
+
+	ReplicationSlotCtl = (ReplicationSlotCtlData *)
+		ShmemInitStruct("ReplicationSlot Ctl", ReplicationSlotsShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		/* First time through, so initialize */
+		MemSet(ReplicationSlotCtl, 0, ReplicationSlotsShmemSize());
+
+		for (i = 0; i < max_replication_slots; i++)
+			SpinLockInit(&ReplicationSlotCtl->replication_slots[i].mutex);
+	}
+}
+
+/*
+ * Check that a slot name is usable as a file name: lower case letters,
+ * digits and underscores.
+ */
+static void
+ReplicationSlotValidateName(const char *name)
+{
+	const char *cp;
+
+	if (strlen(name) == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_NAME),
+				 errmsg("replication slot name \"%s\" is too short",
+						name)));
+
+	if (strlen(name) >= NAMEDATALEN)
+		ereport(ERROR,
+				(errcode(ERRCODE_NAME_TOO_LONG),
+				 errmsg("replication slot name \"%s\" is too long",
+						name)));
+
+	for (cp = name; *cp; cp++)
+	{
+		if (!((*cp >= 'a' && *cp <= 'z') ||
+			  (*cp >= '0' && *cp <= '9') ||
+			  *cp == '_'))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_NAME),
+					 errmsg("replication slot name \"%s\" contains invalid character",
+							name),
+					 errhint("Replication slot names may only contain lower case letters, numbers, and the underscore character.")));
+	}
+}
+
+/*
+ * Find the slot with the given name.  Caller must hold
+ * ReplicationSlotControlLock.
+ */
+static ReplicationSlot *
+SearchSlot(const char *name)
+{
+	int			i;
+
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+
+		if (slot->in_use && strcmp(NameStr(slot->data.name), name) == 0)
+			return slot;
+	}
+	return NULL;
+}
+
+/*
+ * Create a new replication slot, and save it to disk.
+ *
+ * A logical slot belongs to the current database, and starts out at the
+ * current insert position, like decoding without a slot does.  A physical
+ * slot doesn't retain any WAL until it's first used.
+ */
+void
+ReplicationSlotCreate(const char *name, bool logical, const char *plugin)
+{
+	ReplicationSlot *slot;
+	int			i;
+
+	if (max_replication_slots == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("replication slots can only be used if max_replication_slots > 0")));
+
+	ReplicationSlotValidateName(name);
+
+	if (logical && wal_level < WAL_LEVEL_LOGICAL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical decoding requires wal_level \"logical\"")));
+	if (logical && RecoveryInProgress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical decoding cannot be used during recovery")));
+
+	/*
+	 * Holding the allocation lock keeps anyone else from creating a slot
+	 * with the same name, or in the same entry, while we write the file.
+	 */
+	LWLockAcquire(ReplicationSlotAllocationLock, LW_EXCLUSIVE);
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
+	if (SearchSlot(name) != NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_DUPLICATE_OBJECT),
+				 errmsg("replication slot \"%s\" already exists", name)));
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		if (!ReplicationSlotCtl->replication_slots[i].in_use)
+			break;
+	}
+	LWLockRelease(ReplicationSlotControlLock);
+
+	if (i >= max_replication_slots)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("all replication slots are in use"),
+				 errhint("Free one or increase max_replication_slots.")));
+	slot = &ReplicationSlotCtl->replication_slots[i];
+
+	/* nobody else looks at a slot that's not in use */
+	MemSet(&slot->data, 0, sizeof(ReplicationSlotPersistentData));
+	namestrcpy(&slot->data.name, name);
+	slot->active = false;
+	slot->dirty = true;
+	if (logical)
+	{
+		slot->data.database = MyDatabaseId;
+		namestrcpy(&slot->data.plugin, plugin);
+
+		/*
+		 * Every transaction that gets an xid from now on writes all its
+		 * changes after the current insert position, see
+		 * CreateLogicalDecodingContext.
+		 */
+		slot->data.restart_lsn = GetXLogInsertRecPtr();
+		slot->data.confirmed_flush = slot->data.restart_lsn;
+		slot->data.catalog_xmin = ReadNewTransactionId();
+	}
+	else
+		slot->data.database = InvalidOid;
+
+	/*
+	 * Make sure the slot survives a crash before anyone relies on it.  If
+	 * this fails, the entry simply stays unused.
+	 */
+	SaveSlot(slot, name);
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_EXCLUSIVE);
+	SpinLockAcquire(&slot->mutex);
+	slot->in_use = true;
+	SpinLockRelease(&slot->mutex);
+	LWLockRelease(ReplicationSlotControlLock);
+
+	LWLockRelease(ReplicationSlotAllocationLock);
+
+	ReplicationSlotsComputeRequiredXmin();
+	ReplicationSlotsComputeRequiredLSN();
+}
+
+/*
+ * Drop a replication slot, releasing the WAL and rows it held back.
+ */
+void
+ReplicationSlotDrop(const char *name)
+{
+	ReplicationSlot *slot;
+	char		path[MAXPGPATH];
+	bool		active;
+
+	if (max_replication_slots == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("replication slots can only be used if max_replication_slots > 0")));
+
+	/* keep the entry from being reused until the file is gone */
+	LWLockAcquire(ReplicationSlotAllocationLock, LW_EXCLUSIVE);
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_EXCLUSIVE);
+
+	slot = SearchSlot(name);
+	if (slot == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("replication slot \"%s\" does not exist", name)));
+
+	SpinLockAcquire(&slot->mutex);
+	active = slot->active;
+	if (!active)
+		slot->in_use = false;
+	SpinLockRelease(&slot->mutex);
+
+	LWLockRelease(ReplicationSlotControlLock);
+
+	if (active)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_IN_USE),
+				 errmsg("replication slot \"%s\" is active", name)));
+
+	/*
+	 * The slot is gone from shared memory now, so nobody can acquire or save
+	 * it any more.  If the file can't be removed, put the slot back; its data
+	 * is still intact, since nobody else can take the entry before we
+	 * release the allocation lock.
+	 */
+	snprintf(path, MAXPGPATH, REPLSLOT_DIR "/%s", name);
+	if (unlink(path) != 0 && errno != ENOENT)
+	{
+		int			save_errno = errno;
+
+		LWLockAcquire(ReplicationSlotControlLock, LW_EXCLUSIVE);
+		SpinLockAcquire(&slot->mutex);
+		slot->in_use = true;
+		SpinLockRelease(&slot->mutex);
+		LWLockRelease(ReplicationSlotControlLock);
+
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", path)));
+	}
+	fsync_slot_dir();
+
+	LWLockRelease(ReplicationSlotAllocationLock);
+
+	ReplicationSlotsComputeRequiredXmin();
+	ReplicationSlotsComputeRequiredLSN();
+}
+
+/*
+ * Acquire the named slot for use by this walsender, until
+ * ReplicationSlotRelease.
+ */
+void
+ReplicationSlotAcquire(const char *name)
+{
+	ReplicationSlot *slot;
+	bool		active = false;
+
+	Assert(MyReplicationSlot == NULL);
+
+	if (max_replication_slots == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("replication slots can only be used if max_replication_slots > 0")));
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
+
+	slot = SearchSlot(name);
+	if (slot != NULL)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *vslot = slot;
+
+		SpinLockAcquire(&vslot->mutex);
+		active = vslot->active;
+		vslot->active = true;
+		SpinLockRelease(&vslot->mutex);
+	}
+
+	LWLockRelease(ReplicationSlotControlLock);
+
+	if (slot == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_OBJECT),
+				 errmsg("replication slot \"%s\" does not exist", name)));
+	if (active)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_IN_USE),
+				 errmsg("replication slot \"%s\" is already active", name)));
+
+	MyReplicationSlot = slot;
+}
+
+/*
+ * Release the slot acquired by this walsender, if any.  Its data stays as
+ * it was, until the next consumer acquires it.
+ */
+void
+ReplicationSlotRelease(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlot *slot = MyReplicationSlot;
+
+	if (slot == NULL)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->active = false;
+	SpinLockRelease(&slot->mutex);
+
+	MyReplicationSlot = NULL;
+}
+
+/*
+ * Mark the acquired slot as changed, after updating its data, so that the
+ * next checkpoint saves it.
+ */
+void
+ReplicationSlotMarkDirty(void)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlot *slot = MyReplicationSlot;
+
+	Assert(slot != NULL);
+
+	SpinLockAcquire(&slot->mutex);
+	slot->dirty = true;
+	SpinLockRelease(&slot->mutex);
+}
+
+/*
+ * Compute the oldest xmin of all slots, and advertise it in the ProcArray
+ * for GetOldestXmin and GetSnapshotData.
+ */
+void
+ReplicationSlotsComputeRequiredXmin(void)
+{
+	TransactionId agg_xmin = InvalidTransactionId;
+	int			i;
+
+	if (max_replication_slots == 0)
+		return;
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
+
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+		TransactionId xmin;
+		TransactionId catalog_xmin;
+
+		if (!slot->in_use)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		xmin = slot->data.xmin;
+		catalog_xmin = slot->data.catalog_xmin;
+		SpinLockRelease(&slot->mutex);
+
+		if (TransactionIdIsNormal(xmin) &&
+			(!TransactionIdIsValid(agg_xmin) ||
+			 TransactionIdPrecedes(xmin, agg_xmin)))
+			agg_xmin = xmin;
+		if (TransactionIdIsNormal(catalog_xmin) &&
+			(!TransactionIdIsValid(agg_xmin) ||
+			 TransactionIdPrecedes(catalog_xmin, agg_xmin)))
+			agg_xmin = catalog_xmin;
+	}
+
+	LWLockRelease(ReplicationSlotControlLock);
+
+	ProcArraySetReplicationSlotXmin(agg_xmin);
+}
+
+/*
+ * Compute the oldest restart_lsn of all slots, and tell xlog.c to keep the
+ * WAL from there on.
+ */
+void
+ReplicationSlotsComputeRequiredLSN(void)
+{
+	XLogRecPtr	min_required = {0, 0};
+	int			i;
+
+	if (max_replication_slots == 0)
+		return;
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
+
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+		XLogRecPtr	restart_lsn;
+
+		if (!slot->in_use)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		restart_lsn = slot->data.restart_lsn;
+		SpinLockRelease(&slot->mutex);
+
+		if (restart_lsn.xlogid == 0 && restart_lsn.xrecoff == 0)
+			continue;
+
+		if ((min_required.xlogid == 0 && min_required.xrecoff == 0) ||
+			XLByteLT(restart_lsn, min_required))
+			min_required = restart_lsn;
+	}
+
+	LWLockRelease(ReplicationSlotControlLock);
+
+	XLogSetReplicationSlotMinimumLSN(min_required);
+}
+
+/*
+ * Load the slots saved in pg_replslot into shared memory, at server start.
+ */
+void
+StartupReplicationSlots(void)
+{
+	DIR		   *replication_dir;
+	struct dirent *replication_de;
+
+	elog(DEBUG1, "starting up replication slots");
+
+	replication_dir = AllocateDir(REPLSLOT_DIR);
+	while ((replication_de = ReadDir(replication_dir, REPLSLOT_DIR)) != NULL)
+	{
+		size_t		namelen = strlen(replication_de->d_name);
+
+		if (strcmp(replication_de->d_name, ".") == 0 ||
+			strcmp(replication_de->d_name, "..") == 0)
+			continue;
+
+		/* a leftover of a save that was interrupted by a crash */
+		if (namelen > 4 &&
+			strcmp(replication_de->d_name + namelen - 4, ".tmp") == 0)
+		{
+			char		path[MAXPGPATH];
+
+			snprintf(path, MAXPGPATH, REPLSLOT_DIR "/%s",
+					 replication_de->d_name);
+			unlink(path);
+			continue;
+		}
+
+		RestoreSlotFromDisk(replication_de->d_name);
+	}
+	FreeDir(replication_dir);
+
+	ReplicationSlotsComputeRequiredXmin();
+	ReplicationSlotsComputeRequiredLSN();
+}
+
+/*
+ * Load one saved slot into shared memory.
+ */
+static void
+RestoreSlotFromDisk(const char *name)
+{
+	ReplicationSlotOnDisk cp;
+	char		path[MAXPGPATH];
+	pg_crc32	checksum;
+	int			fd;
+	int			i;
+
+	snprintf(path, MAXPGPATH, REPLSLOT_DIR "/%s", name);
+
+	fd = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+	if (fd < 0)
+		ereport(PANIC,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+
+	errno = 0;
+	if (read(fd, &cp, sizeof(cp)) != sizeof(cp))
+	{
+		/* if read didn't set errno, assume the file is truncated */
+		if (errno == 0)
+			errno = EIO;
+		ereport(PANIC,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", path)));
+	}
+	close(fd);
+
+	if (cp.magic != SLOT_MAGIC)
+		ereport(PANIC,
+				(errmsg("replication slot file \"%s\" has wrong magic number: %u instead of %u",
+						path, cp.magic, SLOT_MAGIC)));
+	if (cp.version != SLOT_VERSION)
+		ereport(PANIC,
+				(errmsg("replication slot file \"%s\" has unsupported version %u",
+						path, cp.version)));
+
+	INIT_CRC32(checksum);
+	COMP_CRC32(checksum, (char *) &cp.version, SlotChecksummedSize);
+	FIN_CRC32(checksum);
+	if (!EQ_CRC32(checksum, cp.checksum))
+		ereport(PANIC,
+				(errmsg("replication slot file \"%s\" has incorrect checksum",
+						path)));
+
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+
+		if (slot->in_use)
+			continue;
+
+		slot->data = cp.slotdata;
+		slot->active = false;
+		slot->dirty = false;
+		slot->in_use = true;
+		return;
+	}
+
+	ereport(FATAL,
+			(errmsg("too many replication slots active before shutdown"),
+			 errhint("Increase max_replication_slots and try again.")));
+}
+
+/*
+ * Save the slots that have changed since they were last saved.  This is
+ * called during checkpoints, before any WAL is removed.
+ */
+void
+CheckPointReplicationSlots(void)
+{
+	int			i;
+
+	if (max_replication_slots == 0)
+		return;
+
+	elog(DEBUG1, "performing replication slot checkpoint");
+
+	/*
+	 * Prevent the slots from being created or dropped under us.  in_use only
+	 * changes while the allocation lock is held exclusively, so we don't need
+	 * ReplicationSlotControlLock, and don't hold up slot lookups while we
+	 * write.
+	 */
+	LWLockAcquire(ReplicationSlotAllocationLock, LW_SHARED);
+
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+		char		name[NAMEDATALEN];
+
+		if (!slot->in_use)
+			continue;
+
+		strlcpy(name, NameStr(slot->data.name), NAMEDATALEN);
+		SaveSlot(slot, name);
+	}
+
+	LWLockRelease(ReplicationSlotAllocationLock);
+}
+
+/*
+ * Save a slot to its file, if it has changed.  The file is written under a
+ * temporary name and renamed into place, so that a crash leaves either the
+ * old or the new version behind.
+ */
+static void
+SaveSlot(ReplicationSlot *slot, const char *name)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile ReplicationSlot *vslot = slot;
+	ReplicationSlotOnDisk cp;
+	char		tmppath[MAXPGPATH];
+	char		path[MAXPGPATH];
+	int			fd;
+
+	/*
+	 * Take a copy of the data, and clear the dirty flag before writing it
+	 * out.  If the slot changes while we write, it's marked dirty again and
+	 * the next checkpoint saves it; if writing fails, we mark it dirty
+	 * again, below.
+	 */
+	SpinLockAcquire(&vslot->mutex);
+	if (!vslot->dirty)
+	{
+		SpinLockRelease(&vslot->mutex);
+		return;
+	}
+	vslot->dirty = false;
+	memcpy(&cp.slotdata, (ReplicationSlotPersistentData *) &vslot->data,
+		   sizeof(ReplicationSlotPersistentData));
+	SpinLockRelease(&vslot->mutex);
+
+	cp.magic = SLOT_MAGIC;
+	cp.version = SLOT_VERSION;
+	INIT_CRC32(cp.checksum);
+	COMP_CRC32(cp.checksum, (char *) &cp.version, SlotChecksummedSize);
+	FIN_CRC32(cp.checksum);
+
+	snprintf(tmppath, MAXPGPATH, REPLSLOT_DIR "/%s.tmp", name);
+	snprintf(path, MAXPGPATH, REPLSLOT_DIR "/%s", name);
+
+	fd = BasicOpenFile(tmppath, O_CREAT | O_TRUNC | O_WRONLY | PG_BINARY,
+					   S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		goto failed;
+
+	errno = 0;
+	if (write(fd, &cp, sizeof(cp)) != sizeof(cp))
+	{
+		int			save_errno = errno;
+
+		close(fd);
+		/* if write didn't set errno, assume problem is no disk space */
+		errno = save_errno ? save_errno : ENOSPC;
+		goto failed;
+	}
+
+	if (pg_fsync(fd) != 0)
+	{
+		int			save_errno = errno;
+
+		close(fd);
+		errno = save_errno;
+		goto failed;
+	}
+	close(fd);
+
+	if (rename(tmppath, path) != 0)
+		goto failed;
+	fsync_slot_dir();
+
+	return;
+
+failed:
+	{
+		int			save_errno = errno;
+
+		SpinLockAcquire(&vslot->mutex);
+		vslot->dirty = true;
+		SpinLockRelease(&vslot->mutex);
+		errno = save_errno;
+	}
+
+	ereport(ERROR,
+			(errcode_for_file_access(),
+			 errmsg("could not save replication slot \"%s\" to file \"%s\": %m",
+					name, path)));
+}
+
+/*
+ * Make the creation, renaming and removal of slot files durable.  Not all
+ * platforms can fsync a directory, so errors are ignored.
+ */
+static void
+fsync_slot_dir(void)
+{
+	int			fd;
+
+	fd = BasicOpenFile(REPLSLOT_DIR, O_RDONLY | PG_BINARY, 0);
+	if (fd >= 0)
+	{
+		(void) pg_fsync(fd);
+		close(fd);
+	}
+}
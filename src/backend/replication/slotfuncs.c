@@ -0,0 +1,243 @@
+/*-------------------------------------------------------------------------
+ *
+ * slotfuncs.c
+ *	  SQL functions to manage replication slots and look at their state.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/transam.h"
+#include "access/xlog_internal.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "replication/slot.h"
+#include "storage/lwlock.h"
+#include "utils/builtins.h"
+#include "utils/tuplestore.h"
+
+
+static void
+check_permissions(void)
+{
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to manage replication slots")));
+}
+
+/*
+ * pg_create_physical_replication_slot(name)
+ */
+Datum
+pg_create_physical_replication_slot(PG_FUNCTION_ARGS)
+{
+	Name		name = PG_GETARG_NAME(0);
+
+	check_permissions();
+
+	ReplicationSlotCreate(NameStr(*name), false, NULL);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * pg_create_logical_replication_slot(name, plugin)
+ *
+ * The slot belongs to the current database, and retains the changes of
+ * transactions that start from now on.
+ */
+Datum
+pg_create_logical_replication_slot(PG_FUNCTION_ARGS)
+{
+	Name		name = PG_GETARG_NAME(0);
+	char	   *plugin = text_to_cstring(PG_GETARG_TEXT_PP(1));
+
+	check_permissions();
+
+	ReplicationSlotCreate(NameStr(*name), true, plugin);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * pg_drop_replication_slot(name)
+ */
+Datum
+pg_drop_replication_slot(PG_FUNCTION_ARGS)
+{
+	Name		name = PG_GETARG_NAME(0);
+
+	check_permissions();
+
+	ReplicationSlotDrop(NameStr(*name));
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Number of bytes of WAL from 'from' to 'to'.
+ */
+static int64
+xlog_distance(XLogRecPtr from, XLogRecPtr to)
+{
+	return ((int64) to.xlogid - (int64) from.xlogid) * XLogFileSize +
+		((int64) to.xrecoff - (int64) from.xrecoff);
+}
+
+/*
+ * pg_get_replication_slots() - the state of all replication slots, with
+ * how far behind the current WAL position each one's restart point is.
+ */
+Datum
+pg_get_replication_slots(PG_FUNCTION_ARGS)
+{
+#define PG_GET_REPLICATION_SLOTS_COLS 10
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	XLogRecPtr	currptr;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* need to build tuplestore in query context */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	/*
+	 * build tupdesc for result tuples. This must match the definition of the
+	 * pg_replication_slots view in system_views.sql
+	 */
+	tupdesc = CreateTemplateTupleDesc(PG_GET_REPLICATION_SLOTS_COLS, false);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "slot_name",
+					   NAMEOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "plugin",
+					   NAMEOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "slot_type",
+					   TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "datoid",
+					   OIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "active",
+					   BOOLOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "xmin",
+					   XIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "catalog_xmin",
+					   XIDOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "restart_lsn",
+					   TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 9, "confirmed_flush_lsn",
+					   TEXTOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 10, "restart_lag",
+					   INT8OID, -1, 0);
+
+	tupstore =
+		tuplestore_begin_heap(rsinfo->allowedModes & SFRM_Materialize_Random,
+							  false, work_mem);
+
+	/* generate junk in short-term context */
+	MemoryContextSwitchTo(oldcontext);
+
+	/* the lag is measured against the WAL we have, primary or standby */
+	if (RecoveryInProgress())
+		currptr = GetXLogReplayRecPtr();
+	else
+		currptr = GetXLogInsertRecPtr();
+
+	LWLockAcquire(ReplicationSlotControlLock, LW_SHARED);
+	for (i = 0; i < max_replication_slots; i++)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *slot = &ReplicationSlotCtl->replication_slots[i];
+		ReplicationSlotPersistentData data;
+		bool		active;
+		char		location[MAXFNAMELEN];
+		Datum		values[PG_GET_REPLICATION_SLOTS_COLS];
+		bool		nulls[PG_GET_REPLICATION_SLOTS_COLS];
+
+		if (!slot->in_use)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		data = slot->data;
+		active = slot->active;
+		SpinLockRelease(&slot->mutex);
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = NameGetDatum(&data.name);
+		if (OidIsValid(data.database))
+		{
+			values[1] = NameGetDatum(&data.plugin);
+			values[2] = CStringGetTextDatum("logical");
+		}
+		else
+		{
+			nulls[1] = true;
+			values[2] = CStringGetTextDatum("physical");
+		}
+		values[3] = ObjectIdGetDatum(data.database);
+		values[4] = BoolGetDatum(active);
+
+		if (TransactionIdIsValid(data.xmin))
+			values[5] = TransactionIdGetDatum(data.xmin);
+		else
+			nulls[5] = true;
+		if (TransactionIdIsValid(data.catalog_xmin))
+			values[6] = TransactionIdGetDatum(data.catalog_xmin);
+		else
+			nulls[6] = true;
+
+		if (!XLogRecPtrIsInvalid(data.restart_lsn))
+		{
+			snprintf(location, sizeof(location), "%X/%X",
+					 data.restart_lsn.xlogid, data.restart_lsn.xrecoff);
+			values[7] = CStringGetTextDatum(location);
+			values[9] = Int64GetDatum(XLByteLT(data.restart_lsn, currptr) ?
+									xlog_distance(data.restart_lsn, currptr) : 0);
+		}
+		else
+		{
+			nulls[7] = true;
+			nulls[9] = true;
+		}
+
+		if (OidIsValid(data.database))
+		{
+			snprintf(location, sizeof(location), "%X/%X",
+					 data.confirmed_flush.xlogid, data.confirmed_flush.xrecoff);
+			values[8] = CStringGetTextDatum(location);
+		}
+		else
+			nulls[8] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(ReplicationSlotControlLock);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	return (Datum) 0;
+}
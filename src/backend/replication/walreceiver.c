@@ -13,7 +13,9 @@
  * writing them to the disk as long as the connection is alive. As XLOG
  * records are received and flushed to disk, it updates the
  * WalRcv->receivedUpTo variable in shared memory, to inform the startup
- * process of how far it can proceed with XLOG replay.
+ * process of how far it can proceed with XLOG replay.  It also reports
+ * the written, flushed and replayed positions back to the primary, which
+ * uses them to release transactions waiting for synchronous replication.
  *
  * Normal termination is by SIGTERM, which instructs the walreceiver to
  * exit(0). Emergency termination is by SIGQUIT; like any postmaster child
@@ -38,13 +40,16 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include "access/transam.h"
 #include "access/xlog_internal.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
 #include "replication/walprotocol.h"
 #include "replication/walreceiver.h"
+#include "replication/walsender.h"
 #include "storage/ipc.h"
 #include "storage/pmsignal.h"
+#include "storage/procarray.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
@@ -54,9 +59,14 @@
 /* Global variable to indicate if this process is a walreceiver process */
 bool		am_walreceiver;
 
+/* GUC variables */
+int			wal_receiver_status_interval;
+bool		hot_standby_feedback;
+
 /* libpqreceiver hooks to these when loaded */
 walrcv_connect_type walrcv_connect = NULL;
 walrcv_receive_type walrcv_receive = NULL;
+walrcv_send_type walrcv_send = NULL;
 walrcv_disconnect_type walrcv_disconnect = NULL;
 
 #define NAPTIME_PER_CYCLE 100	/* max sleep time between cycles (100ms) */
@@ -87,6 +97,12 @@ static struct
 	XLogRecPtr	Flush;			/* last byte + 1 flushed in the standby */
 }	LogstreamResult;
 
+/* Last reply sent to the primary; used to suppress redundant replies */
+static StandbyReplyMessage reply_message;
+
+/* Last Hot Standby feedback sent to the primary */
+static StandbyHSFeedbackMessage feedback_message;
+
 /*
  * About SIGTERM handling:
  *
@@ -113,6 +129,8 @@ static void WalRcvDie(int code, Datum arg);
 static void XLogWalRcvProcessMsg(unsigned char type, char *buf, Size len);
 static void XLogWalRcvWrite(char *buf, Size nbytes, XLogRecPtr recptr);
 static void XLogWalRcvFlush(void);
+static void XLogWalRcvSendReply(void);
+static void XLogWalRcvSendHSFeedback(void);
 
 /* Signal handlers */
 static void WalRcvSigHupHandler(SIGNAL_ARGS);
@@ -158,6 +176,7 @@ void
 WalReceiverMain(void)
 {
 	char		conninfo[MAXCONNINFO];
+	char		slotname[NAMEDATALEN];
 	XLogRecPtr	startpoint;
 
 	/* use volatile pointer to prevent code rearrangement */
@@ -206,6 +225,7 @@ WalReceiverMain(void)
 
 	/* Fetch information required to start streaming */
 	strlcpy(conninfo, (char *) walrcv->conninfo, MAXCONNINFO);
+	strlcpy(slotname, (char *) walrcv->slotname, NAMEDATALEN);
 	startpoint = walrcv->receivedUpto;
 	SpinLockRelease(&walrcv->mutex);
 
@@ -247,7 +267,7 @@ WalReceiverMain(void)
 	/* Load the libpq-specific functions */
 	load_file("libpqwalreceiver", false);
 	if (walrcv_connect == NULL || walrcv_receive == NULL ||
-		walrcv_disconnect == NULL)
+		walrcv_send == NULL || walrcv_disconnect == NULL)
 		elog(ERROR, "libpqwalreceiver didn't initialize correctly");
 
 	/*
@@ -261,7 +281,7 @@ WalReceiverMain(void)
 
 	/* Establish the connection to the primary for XLOG streaming */
 	EnableWalRcvImmediateExit();
-	walrcv_connect(conninfo, startpoint);
+	walrcv_connect(conninfo, startpoint, slotname);
 	DisableWalRcvImmediateExit();
 
 	/* Loop until end-of-streaming or error */
@@ -311,6 +331,17 @@ WalReceiverMain(void)
 			 */
 			XLogWalRcvFlush();
 		}
+
+		/*
+		 * Let the primary know how far we have got, if anything changed
+		 * or the status interval has elapsed.  This is done on every cycle
+		 * so that replay progress is reported even when no new WAL
+		 * arrives.
+		 */
+		XLogWalRcvSendReply();
+
+		/* Likewise, tell it how old the snapshots of our queries are */
+		XLogWalRcvSendHSFeedback();
 	}
 }
 
@@ -532,6 +563,9 @@ XLogWalRcvFlush(void)
 		/* Signal the startup process that new WAL has arrived */
 		WakeupRecovery();
 
+		/* ... and any walsenders cascading it to further standbys */
+		WalSndWakeup();
+
 		/* Report XLOG streaming progress in PS display */
 		if (update_process_title)
 		{
@@ -544,3 +578,118 @@ XLogWalRcvFlush(void)
 		}
 	}
 }
+
+/*
+ * Send reply message to primary indicating our current XLOG positions.
+ *
+ * A reply is sent if any of the positions have advanced since the last
+ * reply, or if wal_receiver_status_interval has elapsed, so that the
+ * primary can release transactions waiting for synchronous replication
+ * as soon as possible.
+ */
+static void
+XLogWalRcvSendReply(void)
+{
+	char		buf[sizeof(StandbyReplyMessage) + 1];
+	TimestampTz now;
+	XLogRecPtr	applyPtr;
+
+	/*
+	 * If the user doesn't want status to be reported to the primary, be sure
+	 * to exit before doing anything at all.
+	 */
+	if (wal_receiver_status_interval <= 0)
+		return;
+
+	/* Get current timestamp and replay position. */
+	now = GetCurrentTimestamp();
+	applyPtr = GetXLogReplayRecPtr();
+
+	if (XLByteEQ(reply_message.write, LogstreamResult.Write) &&
+		XLByteEQ(reply_message.flush, LogstreamResult.Flush) &&
+		XLByteEQ(reply_message.apply, applyPtr) &&
+		!TimestampDifferenceExceeds(reply_message.sendTime, now,
+									wal_receiver_status_interval * 1000))
+		return;
+
+	/* Construct a new message */
+	reply_message.write = LogstreamResult.Write;
+	reply_message.flush = LogstreamResult.Flush;
+	reply_message.apply = applyPtr;
+	reply_message.sendTime = now;
+
+	elog(DEBUG2, "sending write %X/%X flush %X/%X apply %X/%X",
+		 reply_message.write.xlogid, reply_message.write.xrecoff,
+		 reply_message.flush.xlogid, reply_message.flush.xrecoff,
+		 reply_message.apply.xlogid, reply_message.apply.xrecoff);
+
+	/* Prepend with the message type and send it. */
+	buf[0] = 'r';
+	memcpy(&buf[1], &reply_message, sizeof(StandbyReplyMessage));
+	walrcv_send(buf, sizeof(StandbyReplyMessage) + 1);
+}
+
+/*
+ * Send Hot Standby feedback to the primary: the xmin of the queries running
+ * on this standby, which the primary's walsender advertises as its own xmin
+ * so that vacuum on the primary doesn't remove rows they can still see, and
+ * the queries aren't cancelled to replay such removals.
+ *
+ * Feedback is sent every wal_receiver_status_interval.  When
+ * hot_standby_feedback is turned off, an invalid xmin is sent once to clear
+ * the primary's.
+ */
+static void
+XLogWalRcvSendHSFeedback(void)
+{
+	char		buf[sizeof(StandbyHSFeedbackMessage) + 1];
+	TimestampTz now;
+	TransactionId nextXid;
+	uint32		nextEpoch;
+	TransactionId xmin;
+
+	if (wal_receiver_status_interval <= 0)
+		return;
+
+	now = GetCurrentTimestamp();
+
+	if (hot_standby_feedback)
+	{
+		/* send feedback at most once per interval */
+		if (!TimestampDifferenceExceeds(feedback_message.sendTime, now,
+										wal_receiver_status_interval * 1000))
+			return;
+
+		/* nothing to report until queries are allowed */
+		if (!HotStandbyActive())
+			return;
+
+		xmin = GetOldestXmin(true, false);
+
+		/* get the epoch of xmin, which is the current one or the one before */
+		GetNextXidAndEpoch(&nextXid, &nextEpoch);
+		if (TransactionIdFollows(xmin, nextXid))
+			nextEpoch--;
+	}
+	else
+	{
+		/* feedback was turned off, clear the primary's xmin once */
+		if (!TransactionIdIsValid(feedback_message.xmin))
+			return;
+
+		xmin = InvalidTransactionId;
+		nextEpoch = 0;
+	}
+
+	feedback_message.xmin = xmin;
+	feedback_message.epoch = nextEpoch;
+	feedback_message.sendTime = now;
+
+	elog(DEBUG2, "sending hot standby feedback xmin %u epoch %u",
+		 feedback_message.xmin, feedback_message.epoch);
+
+	/* Prepend with the message type and send it. */
+	buf[0] = 'h';
+	memcpy(&buf[1], &feedback_message, sizeof(StandbyHSFeedbackMessage));
+	walrcv_send(buf, sizeof(StandbyHSFeedbackMessage) + 1);
+}
@@ -37,17 +37,24 @@
 #include <signal.h>
 #include <unistd.h>
 
+#include "access/transam.h"
 #include "access/xlog_internal.h"
 #include "catalog/pg_type.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
+#include "replication/basebackup.h"
+#include "replication/logical.h"
+#include "replication/slot.h"
+#include "replication/syncrep.h"
 #include "replication/walprotocol.h"
+#include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/pmsignal.h"
+#include "storage/proc.h"
 #include "tcop/tcopprot.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
@@ -58,10 +65,14 @@
 WalSndCtlData *WalSndCtl = NULL;
 
 /* My slot in the shared memory array */
-static WalSnd *MyWalSnd = NULL;
+WalSnd	   *MyWalSnd = NULL;
 
 /* Global state */
 bool		am_walsender = false;		/* Am I a walsender process ? */
+bool		am_cascading_walsender = false;	/* Am I cascading WAL to
+											 * another standby ? */
+bool		am_db_walsender = false;	/* Am I connected to a database for
+										 * logical decoding ? */
 
 /* User-settable parameters for walsender */
 int			max_wal_senders = 0;	/* the maximum number of concurrent walsenders */
@@ -72,6 +83,7 @@ int			WalSndDelay = 200;	/* max sleep time between some actions */
  * but for walsender to read the XLOG.
  */
 static int	sendFile = -1;
+static TimeLineID sendTimeLineID = 0;	/* timeline of the WAL we send */
 static uint32 sendId = 0;
 static uint32 sendSeg = 0;
 static uint32 sendOff = 0;
@@ -82,9 +94,20 @@ static uint32 sendOff = 0;
  */
 static XLogRecPtr sentPtr = {0, 0};
 
+/*
+ * State of logical decoding, if START_LOGICAL_REPLICATION was used.  The
+ * first record is read at logical_startptr, the rest follow it.
+ */
+static LogicalDecodingContext *logical_decoding_ctx = NULL;
+static XLogRecPtr logical_startptr = {0, 0};
+static StringInfoData logical_output_message;
+
+/* Buffer for processing reply messages. */
+static StringInfoData reply_message;
+
 /* Flags set by signal handlers for later service in main loop */
 static volatile sig_atomic_t got_SIGHUP = false;
-static volatile sig_atomic_t shutdown_requested = false;
+volatile sig_atomic_t walsender_shutdown_requested = false;
 static volatile sig_atomic_t ready_to_stop = false;
 
 /* Signal handlers */
@@ -101,7 +124,22 @@ static void WalSndHandshake(void);
 static void WalSndKill(int code, Datum arg);
 static void XLogRead(char *buf, XLogRecPtr recptr, Size nbytes);
 static bool XLogSend(char *msgbuf, bool *caughtup);
-static void CheckClosedConnection(void);
+static int	SplitCommandWords(const char *args, char **words, int maxwords);
+static void CreateReplicationSlotCommand(const char *query_string);
+static void DropReplicationSlotCommand(const char *query_string);
+static void StartReplication(const char *query_string);
+static void StartLogicalReplication(const char *query_string);
+static int	logical_read_xlog_page(XLogReaderState *state,
+					   XLogRecPtr targetPagePtr, int reqLen,
+					   char *cur_page, void *private_data);
+static void WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn,
+				TransactionId xid);
+static bool XLogSendLogical(bool *caughtup);
+static void WalSndSetState(WalSndState state);
+static void ProcessRepliesIfAny(void);
+static void ProcessStandbyMessage(void);
+static void ProcessStandbyReplyMessage(void);
+static void ProcessStandbyHSFeedbackMessage(void);
 
 
 /* Main entry point for walsender process */
@@ -110,10 +148,17 @@ WalSenderMain(void)
 {
 	MemoryContext walsnd_context;
 
-	if (RecoveryInProgress())
-		ereport(FATAL,
-				(errcode(ERRCODE_CANNOT_CONNECT_NOW),
-				 errmsg("recovery is still in progress, can't accept WAL streaming connections")));
+	/*
+	 * A standby can serve the WAL it has received to further standbys,
+	 * forming a cascade.  Its WAL is on the recovery target timeline, which
+	 * we remember now: if the standby is promoted, ThisTimeLineID changes
+	 * under us.
+	 */
+	am_cascading_walsender = RecoveryInProgress();
+	if (am_cascading_walsender)
+		sendTimeLineID = GetRecoveryTargetTLI();
+	else
+		sendTimeLineID = ThisTimeLineID;
 
 	/* Create a per-walsender data structure in shared memory */
 	InitWalSnd();
@@ -144,6 +189,8 @@ WalSenderMain(void)
 	WalSndHandshake();
 
 	/* Initialize shared memory status */
+	WalSndSetState(WALSNDSTATE_CATCHUP);
+	SyncRepInitConfig();
 	{
 		/* use volatile pointer to prevent code rearrangement */
 		volatile WalSnd *walsnd = MyWalSnd;
@@ -208,7 +255,6 @@ WalSndHandshake(void)
 			case 'Q':			/* Query message */
 				{
 					const char *query_string;
-					XLogRecPtr	recptr;
 
 					query_string = pq_getmsgstring(&input_message);
 					pq_getmsgend(&input_message);
@@ -226,7 +272,7 @@ WalSndHandshake(void)
 
 						snprintf(sysid, sizeof(sysid), UINT64_FORMAT,
 								 GetSystemIdentifier());
-						snprintf(tli, sizeof(tli), "%u", ThisTimeLineID);
+						snprintf(tli, sizeof(tli), "%u", sendTimeLineID);
 
 						/* Send a RowDescription message */
 						pq_beginmessage(&buf, 'T');
@@ -265,44 +311,49 @@ WalSndHandshake(void)
 						ReadyForQuery(DestRemote);
 						/* ReadyForQuery did pq_flush for us */
 					}
-					else if (sscanf(query_string, "START_REPLICATION %X/%X",
-									&recptr.xlogid, &recptr.xrecoff) == 2)
+					else if (strncmp(query_string, "CREATE_REPLICATION_SLOT ",
+									 strlen("CREATE_REPLICATION_SLOT ")) == 0)
 					{
-						StringInfoData buf;
+						CreateReplicationSlotCommand(query_string);
 
-						/*
-						 * Check that we're logging enough information in the
-						 * WAL for log-shipping.
-						 *
-						 * NOTE: This only checks the current value of
-						 * wal_level. Even if the current setting is not
-						 * 'minimal', there can be old WAL in the pg_xlog
-						 * directory that was created with 'minimal'. So this
-						 * is not bulletproof, the purpose is just to give a
-						 * user-friendly error message that hints how to
-						 * configure the system correctly.
-						 */
-						if (wal_level == WAL_LEVEL_MINIMAL)
-							ereport(FATAL,
-									(errcode(ERRCODE_CANNOT_CONNECT_NOW),
-									 errmsg("standby connections not allowed because wal_level=minimal")));
-
-						/* Send a CopyOutResponse message, and start streaming */
-						pq_beginmessage(&buf, 'H');
-						pq_sendbyte(&buf, 0);
-						pq_sendint(&buf, 0, 2);
-						pq_endmessage(&buf);
-						pq_flush();
+						/* Send CommandComplete and ReadyForQuery messages */
+						EndCommand("CREATE_REPLICATION_SLOT", DestRemote);
+						ReadyForQuery(DestRemote);
+						/* ReadyForQuery did pq_flush for us */
+					}
+					else if (strncmp(query_string, "DROP_REPLICATION_SLOT ",
+									 strlen("DROP_REPLICATION_SLOT ")) == 0)
+					{
+						DropReplicationSlotCommand(query_string);
 
-						/*
-						 * Initialize position to the received one, then the
-						 * xlog records begin to be shipped from that position
-						 */
-						sentPtr = recptr;
+						/* Send CommandComplete and ReadyForQuery messages */
+						EndCommand("DROP_REPLICATION_SLOT", DestRemote);
+						ReadyForQuery(DestRemote);
+						/* ReadyForQuery did pq_flush for us */
+					}
+					else if (strncmp(query_string, "START_REPLICATION ",
+									 strlen("START_REPLICATION ")) == 0)
+					{
+						StartReplication(query_string);
 
 						/* break out of the loop */
 						replication_started = true;
 					}
+					else if (strncmp(query_string, "START_LOGICAL_REPLICATION ",
+									 strlen("START_LOGICAL_REPLICATION ")) == 0)
+					{
+						StartLogicalReplication(query_string);
+
+						/* break out of the loop */
+						replication_started = true;
+					}
+					else if (HandleBaseBackupCommand(query_string))
+					{
+						/* Send CommandComplete and ReadyForQuery messages */
+						EndCommand("SELECT", DestRemote);
+						ReadyForQuery(DestRemote);
+						/* ReadyForQuery did pq_flush for us */
+					}
 					else
 					{
 						ereport(FATAL,
@@ -332,44 +383,241 @@ WalSndHandshake(void)
 }
 
 /*
- * Check if the remote end has closed the connection.
+ * Process any incoming messages while streaming. Also checks if the remote
+ * end has closed the connection.
  */
 static void
-CheckClosedConnection(void)
+ProcessRepliesIfAny(void)
 {
 	unsigned char firstchar;
 	int			r;
 
-	r = pq_getbyte_if_available(&firstchar);
-	if (r < 0)
+	for (;;)
+	{
+		r = pq_getbyte_if_available(&firstchar);
+		if (r < 0)
+		{
+			/* unexpected error or EOF */
+			ereport(COMMERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("unexpected EOF on standby connection")));
+			proc_exit(0);
+		}
+		if (r == 0)
+		{
+			/* no data available without blocking */
+			break;
+		}
+
+		/* Handle the very limited subset of commands expected in this phase */
+		switch (firstchar)
+		{
+				/*
+				 * 'd' means a standby reply wrapped in a CopyData packet.
+				 */
+			case 'd':
+				ProcessStandbyMessage();
+				break;
+
+				/*
+				 * 'X' means that the standby is closing down the socket.
+				 */
+			case 'X':
+				proc_exit(0);
+
+			default:
+				ereport(FATAL,
+						(errcode(ERRCODE_PROTOCOL_VIOLATION),
+						 errmsg("invalid standby message type %d",
+								firstchar)));
+		}
+	}
+}
+
+/*
+ * Process a status update message received from standby.
+ */
+static void
+ProcessStandbyMessage(void)
+{
+	char		msgtype;
+
+	resetStringInfo(&reply_message);
+
+	/*
+	 * Read the message contents.
+	 */
+	if (pq_getmessage(&reply_message, 0))
 	{
-		/* unexpected error or EOF */
 		ereport(COMMERROR,
 				(errcode(ERRCODE_PROTOCOL_VIOLATION),
 				 errmsg("unexpected EOF on standby connection")));
 		proc_exit(0);
 	}
-	if (r == 0)
+
+	/*
+	 * Check message type from the first byte.
+	 */
+	msgtype = pq_getmsgbyte(&reply_message);
+
+	switch (msgtype)
 	{
-		/* no data available without blocking */
+		case 'r':
+			ProcessStandbyReplyMessage();
+			break;
+
+		case 'h':
+			ProcessStandbyHSFeedbackMessage();
+			break;
+
+		default:
+			ereport(COMMERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("unexpected message type \"%c\"", msgtype)));
+			proc_exit(0);
+	}
+}
+
+/*
+ * Regular reply from standby advising of WAL positions on standby server.
+ */
+static void
+ProcessStandbyReplyMessage(void)
+{
+	StandbyReplyMessage reply;
+
+	pq_copymsgbytes(&reply_message, (char *) &reply, sizeof(StandbyReplyMessage));
+
+	elog(DEBUG2, "write %X/%X flush %X/%X apply %X/%X",
+		 reply.write.xlogid, reply.write.xrecoff,
+		 reply.flush.xlogid, reply.flush.xrecoff,
+		 reply.apply.xlogid, reply.apply.xrecoff);
+
+	/*
+	 * Update shared state for this WalSender process based on reply data from
+	 * standby.
+	 */
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = MyWalSnd;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->write = reply.write;
+		walsnd->flush = reply.flush;
+		walsnd->apply = reply.apply;
+		SpinLockRelease(&walsnd->mutex);
+	}
+
+	/*
+	 * A cascading standby can't confirm commits on the primary, and neither
+	 * can a logical decoding client: it only sees committed transactions.
+	 */
+	if (!am_cascading_walsender && !am_db_walsender)
+		SyncRepReleaseWaiters();
+
+	/*
+	 * The slot needn't retain what the standby has flushed any more, nor the
+	 * transactions a logical client has received.
+	 */
+	if (MyReplicationSlot != NULL)
+	{
+		if (am_db_walsender)
+			LogicalConfirmReceivedLocation(logical_decoding_ctx, reply.flush);
+		else if (!XLogRecPtrIsInvalid(reply.flush))
+		{
+			/* use volatile pointer to prevent code rearrangement */
+			volatile ReplicationSlot *slot = MyReplicationSlot;
+			bool		changed = false;
+
+			SpinLockAcquire(&slot->mutex);
+			if (XLByteLT(slot->data.restart_lsn, reply.flush))
+			{
+				slot->data.restart_lsn = reply.flush;
+				slot->dirty = true;
+				changed = true;
+			}
+			SpinLockRelease(&slot->mutex);
+
+			if (changed)
+				ReplicationSlotsComputeRequiredLSN();
+		}
+	}
+}
+
+/*
+ * Hot Standby feedback: the xmin of the queries on the standby.  We
+ * advertise it as the xmin of our PGPROC, which makes GetOldestXmin and
+ * GetSnapshotData hold back the removal of rows those queries can see, in
+ * all databases, just as if the queries ran here.  With a replication slot,
+ * it's kept in the slot instead, so that it keeps holding back removal
+ * while the standby is disconnected.
+ *
+ * The standby may report an xmin that rows have already been removed for;
+ * its queries are then cancelled as without feedback, but later ones are
+ * protected.
+ */
+static void
+ProcessStandbyHSFeedbackMessage(void)
+{
+	StandbyHSFeedbackMessage reply;
+	TransactionId newxmin = InvalidTransactionId;
+
+	pq_copymsgbytes(&reply_message, (char *) &reply, sizeof(StandbyHSFeedbackMessage));
+
+	elog(DEBUG2, "hot standby feedback xmin %u epoch %u",
+		 reply.xmin, reply.epoch);
+
+	/*
+	 * A logical decoding walsender runs transactions of its own, which
+	 * manage its xmin.
+	 */
+	if (am_db_walsender)
 		return;
+
+	/*
+	 * Ignore an xmin that's in the future or more than an epoch in the past,
+	 * which can only come from a confused standby; and clear ours when the
+	 * standby reports none.
+	 */
+	if (TransactionIdIsNormal(reply.xmin))
+	{
+		TransactionId nextXid;
+		uint32		nextEpoch;
+
+		GetNextXidAndEpoch(&nextXid, &nextEpoch);
+		if (TransactionIdPrecedesOrEquals(reply.xmin, nextXid))
+		{
+			if (reply.epoch == nextEpoch)
+				newxmin = reply.xmin;
+		}
+		else
+		{
+			if (reply.epoch + 1 == nextEpoch)
+				newxmin = reply.xmin;
+		}
+		if (!TransactionIdIsValid(newxmin))
+			return;
 	}
 
-	/* Handle the very limited subset of commands expected in this phase */
-	switch (firstchar)
+	if (MyReplicationSlot != NULL)
 	{
-			/*
-			 * 'X' means that the standby is closing down the socket.
-			 */
-		case 'X':
-			proc_exit(0);
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *slot = MyReplicationSlot;
 
-		default:
-			ereport(FATAL,
-					(errcode(ERRCODE_PROTOCOL_VIOLATION),
-					 errmsg("invalid standby closing message type %d",
-							firstchar)));
+		SpinLockAcquire(&slot->mutex);
+		slot->data.xmin = newxmin;
+		slot->dirty = true;
+		SpinLockRelease(&slot->mutex);
+
+		ReplicationSlotsComputeRequiredXmin();
+		return;
 	}
+
+	/*
+	 * Set our xmin without ProcArrayLock, as GetSnapshotData does for a
+	 * backend's own xmin; readers fetch it just once.
+	 */
+	MyProc->xmin = newxmin;
 }
 
 /* Main loop of walsender process */
@@ -386,6 +634,12 @@ WalSndLoop(void)
 	 */
 	output_message = palloc(1 + sizeof(WalDataMessageHeader) + MAX_SEND_SIZE);
 
+	/*
+	 * Allocate buffer that will be used for processing reply messages.  As
+	 * above, do this just once to reduce palloc overhead.
+	 */
+	initStringInfo(&reply_message);
+
 	/* Loop forever, unless we get an error */
 	for (;;)
 	{
@@ -401,6 +655,27 @@ WalSndLoop(void)
 		{
 			got_SIGHUP = false;
 			ProcessConfigFile(PGC_SIGHUP);
+			SyncRepInitConfig();
+		}
+
+		/*
+		 * Process any replies from the standby, and notice if it has closed
+		 * the connection.
+		 */
+		ProcessRepliesIfAny();
+
+		/*
+		 * If the standby we're running on has been promoted, the WAL after
+		 * the end of recovery is on a new timeline that the downstream
+		 * standby doesn't know about yet.  Send what's left of the old
+		 * timeline and exit; the downstream standby reconnects and follows
+		 * the timeline switch as it would after failover to a new primary.
+		 */
+		if (am_cascading_walsender && !ready_to_stop && !RecoveryInProgress())
+		{
+			ereport(LOG,
+					(errmsg("terminating walsender process to force cascaded standby to update timeline and reconnect")));
+			ready_to_stop = true;
 		}
 
 		/*
@@ -412,11 +687,11 @@ WalSndLoop(void)
 			if (!XLogSend(output_message, &caughtup))
 				break;
 			if (caughtup)
-				shutdown_requested = true;
+				walsender_shutdown_requested = true;
 		}
 
 		/* Normal exit from the walsender is here */
-		if (shutdown_requested)
+		if (walsender_shutdown_requested)
 		{
 			/* Inform the standby that XLOG streaming was done */
 			pq_puttextmessage('C', "COPY 0");
@@ -442,7 +717,7 @@ WalSndLoop(void)
 
 			if (!XLogSend(output_message, &caughtup))
 				break;
-			if (caughtup && !got_SIGHUP && !ready_to_stop && !shutdown_requested)
+			if (caughtup && !got_SIGHUP && !ready_to_stop && !walsender_shutdown_requested)
 			{
 				/*
 				 * XXX: We don't really need the periodic wakeups anymore,
@@ -454,9 +729,6 @@ WalSndLoop(void)
 				WaitLatchOrSocket(&MyWalSnd->latch, MyProcPort->sock,
 								  WalSndDelay * 1000L);
 			}
-
-			/* Check if the connection was closed */
-			CheckClosedConnection();
 		}
 		else
 		{
@@ -464,6 +736,18 @@ WalSndLoop(void)
 			if (!XLogSend(output_message, &caughtup))
 				break;
 		}
+
+		/*
+		 * Once we have sent everything that was available, the standby is
+		 * eligible to become the synchronous standby.
+		 */
+		if (caughtup && MyWalSnd->state == WALSNDSTATE_CATCHUP)
+		{
+			ereport(DEBUG1,
+					(errmsg("standby \"%s\" has now caught up with primary",
+							application_name)));
+			WalSndSetState(WALSNDSTATE_STREAMING);
+		}
 	}
 
 	/*
@@ -514,7 +798,11 @@ InitWalSnd(void)
 			 * Found a free slot. Reserve it for us.
 			 */
 			walsnd->pid = MyProcPid;
+			walsnd->state = WALSNDSTATE_STARTUP;
 			MemSet(&walsnd->sentPtr, 0, sizeof(XLogRecPtr));
+			MemSet(&walsnd->write, 0, sizeof(XLogRecPtr));
+			MemSet(&walsnd->flush, 0, sizeof(XLogRecPtr));
+			MemSet(&walsnd->apply, 0, sizeof(XLogRecPtr));
 			SpinLockRelease(&walsnd->mutex);
 			/* don't need the lock anymore */
 			OwnLatch((Latch *) &walsnd->latch);
@@ -547,10 +835,30 @@ WalSndKill(int code, Datum arg)
 	MyWalSnd->pid = 0;
 	DisownLatch(&MyWalSnd->latch);
 
+	/* let another walsender use our replication slot */
+	ReplicationSlotRelease();
+
 	/* WalSnd struct isn't mine anymore */
 	MyWalSnd = NULL;
 }
 
+/* Set state for current walsender (only called in walsender) */
+static void
+WalSndSetState(WalSndState state)
+{
+	/* use volatile pointer to prevent code rearrangement */
+	volatile WalSnd *walsnd = MyWalSnd;
+
+	Assert(am_walsender);
+
+	if (walsnd->state == state)
+		return;
+
+	SpinLockAcquire(&walsnd->mutex);
+	walsnd->state = state;
+	SpinLockRelease(&walsnd->mutex);
+}
+
 /*
  * Read 'nbytes' bytes from WAL into 'buf', starting at location 'recptr'
  *
@@ -582,7 +890,7 @@ XLogRead(char *buf, XLogRecPtr recptr, Size nbytes)
 				close(sendFile);
 
 			XLByteToSeg(recptr, sendId, sendSeg);
-			XLogFilePath(path, ThisTimeLineID, sendId, sendSeg);
+			XLogFilePath(path, sendTimeLineID, sendId, sendSeg);
 
 			sendFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
 			if (sendFile < 0)
@@ -596,7 +904,7 @@ XLogRead(char *buf, XLogRecPtr recptr, Size nbytes)
 				{
 					char		filename[MAXFNAMELEN];
 
-					XLogFileName(filename, ThisTimeLineID, sendId, sendSeg);
+					XLogFileName(filename, sendTimeLineID, sendId, sendSeg);
 					ereport(ERROR,
 							(errcode_for_file_access(),
 							 errmsg("requested WAL segment %s has already been removed",
@@ -658,7 +966,7 @@ XLogRead(char *buf, XLogRecPtr recptr, Size nbytes)
 	{
 		char		filename[MAXFNAMELEN];
 
-		XLogFileName(filename, ThisTimeLineID, log, seg);
+		XLogFileName(filename, sendTimeLineID, log, seg);
 		ereport(ERROR,
 				(errcode_for_file_access(),
 				 errmsg("requested WAL segment %s has already been removed",
@@ -688,6 +996,9 @@ XLogSend(char *msgbuf, bool *caughtup)
 	Size		nbytes;
 	WalDataMessageHeader msghdr;
 
+	if (logical_decoding_ctx != NULL)
+		return XLogSendLogical(caughtup);
+
 	/*
 	 * Attempt to send all data that's already been written out and fsync'd to
 	 * disk.  We cannot go further than what's been written out given the
@@ -695,8 +1006,14 @@ XLogSend(char *msgbuf, bool *caughtup)
 	 * send WAL that is not securely down to disk on the master: if the master
 	 * subsequently crashes and restarts, slaves must not have applied any WAL
 	 * that gets lost on the master.
+	 *
+	 * On a cascading standby, the same goes for WAL received from upstream:
+	 * send only what walreceiver has flushed to disk here.
 	 */
-	SendRqstPtr = GetFlushRecPtr();
+	if (am_cascading_walsender)
+		SendRqstPtr = GetWalRcvWriteRecPtr(NULL);
+	else
+		SendRqstPtr = GetFlushRecPtr();
 
 	/* Quick exit if nothing to do */
 	if (XLByteLE(SendRqstPtr, sentPtr))
@@ -805,6 +1122,393 @@ XLogSend(char *msgbuf, bool *caughtup)
 	return true;
 }
 
+/*
+ * Split the arguments of a replication command into the words separated by
+ * spaces, returning how many there are.  At most maxwords are stored; more
+ * than that are counted as maxwords + 1.  Unused entries are set to NULL.
+ */
+static int
+SplitCommandWords(const char *args, char **words, int maxwords)
+{
+	char	   *copy = pstrdup(args);
+	char	   *word;
+	int			nwords = 0;
+
+	memset(words, 0, maxwords * sizeof(char *));
+	for (word = strtok(copy, " "); word != NULL; word = strtok(NULL, " "))
+	{
+		if (nwords == maxwords)
+			return maxwords + 1;
+		words[nwords++] = word;
+	}
+	return nwords;
+}
+
+/*
+ * Handle CREATE_REPLICATION_SLOT name PHYSICAL, or
+ * CREATE_REPLICATION_SLOT name LOGICAL plugin.  Replies with the slot's name
+ * and the location it retains WAL from, if any yet.
+ */
+static void
+CreateReplicationSlotCommand(const char *query_string)
+{
+	char	   *words[3];
+	int			nwords;
+	bool		logical = false;
+	StringInfoData buf;
+	char		xpos[MAXFNAMELEN];
+
+	nwords = SplitCommandWords(query_string + strlen("CREATE_REPLICATION_SLOT "),
+							   words, 3);
+	if (nwords == 2 && strcmp(words[1], "PHYSICAL") == 0)
+		logical = false;
+	else if (nwords == 3 && strcmp(words[1], "LOGICAL") == 0)
+		logical = true;
+	else
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid standby query string: %s", query_string)));
+
+	/* a logical slot belongs to the database we're connected to */
+	if (logical && !am_db_walsender)
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("logical replication requires a database connection"),
+				 errhint("Connect with replication=database.")));
+
+	ReplicationSlotCreate(words[0], logical, logical ? words[2] : NULL);
+
+	/* hold the slot while reading its position */
+	ReplicationSlotAcquire(words[0]);
+	snprintf(xpos, sizeof(xpos), "%X/%X",
+			 MyReplicationSlot->data.restart_lsn.xlogid,
+			 MyReplicationSlot->data.restart_lsn.xrecoff);
+	ReplicationSlotRelease();
+
+	/* Send a RowDescription message */
+	pq_beginmessage(&buf, 'T');
+	pq_sendint(&buf, 2, 2);		/* 2 fields */
+
+	/* first field */
+	pq_sendstring(&buf, "slot_name");	/* col name */
+	pq_sendint(&buf, 0, 4);		/* table oid */
+	pq_sendint(&buf, 0, 2);		/* attnum */
+	pq_sendint(&buf, TEXTOID, 4);		/* type oid */
+	pq_sendint(&buf, -1, 2);	/* typlen */
+	pq_sendint(&buf, 0, 4);		/* typmod */
+	pq_sendint(&buf, 0, 2);		/* format code */
+
+	/* second field */
+	pq_sendstring(&buf, "consistent_point");	/* col name */
+	pq_sendint(&buf, 0, 4);		/* table oid */
+	pq_sendint(&buf, 0, 2);		/* attnum */
+	pq_sendint(&buf, TEXTOID, 4);		/* type oid */
+	pq_sendint(&buf, -1, 2);	/* typlen */
+	pq_sendint(&buf, 0, 4);		/* typmod */
+	pq_sendint(&buf, 0, 2);		/* format code */
+	pq_endmessage(&buf);
+
+	/* Send a DataRow message */
+	pq_beginmessage(&buf, 'D');
+	pq_sendint(&buf, 2, 2);		/* # of columns */
+	pq_sendint(&buf, strlen(words[0]), 4);		/* col1 len */
+	pq_sendbytes(&buf, words[0], strlen(words[0]));
+	pq_sendint(&buf, strlen(xpos), 4);	/* col2 len */
+	pq_sendbytes(&buf, xpos, strlen(xpos));
+	pq_endmessage(&buf);
+}
+
+/*
+ * Handle DROP_REPLICATION_SLOT name.
+ */
+static void
+DropReplicationSlotCommand(const char *query_string)
+{
+	char	   *words[1];
+
+	if (SplitCommandWords(query_string + strlen("DROP_REPLICATION_SLOT "),
+						  words, 1) != 1)
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid standby query string: %s", query_string)));
+
+	ReplicationSlotDrop(words[0]);
+}
+
+/*
+ * Handle START_REPLICATION [SLOT name] XXX/XXX: enter COPY BOTH mode to
+ * stream WAL from the given location.  With a slot, the WAL the standby
+ * hasn't flushed yet is retained for it across disconnections.
+ */
+static void
+StartReplication(const char *query_string)
+{
+	char	   *words[3];
+	int			nwords;
+	char	   *startpos;
+	XLogRecPtr	recptr;
+	StringInfoData buf;
+
+	nwords = SplitCommandWords(query_string + strlen("START_REPLICATION "),
+							   words, 3);
+	if (nwords == 1)
+		startpos = words[0];
+	else if (nwords == 3 && strcmp(words[0], "SLOT") == 0)
+		startpos = words[2];
+	else
+		startpos = NULL;
+	if (startpos == NULL ||
+		sscanf(startpos, "%X/%X", &recptr.xlogid, &recptr.xrecoff) != 2)
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid standby query string: %s", query_string)));
+
+	/*
+	 * Check that we're logging enough information in the WAL for
+	 * log-shipping.
+	 *
+	 * NOTE: This only checks the current value of wal_level. Even if the
+	 * current setting is not 'minimal', there can be old WAL in the pg_xlog
+	 * directory that was created with 'minimal'. So this is not bulletproof,
+	 * the purpose is just to give a user-friendly error message that hints
+	 * how to configure the system correctly.
+	 */
+	if (wal_level == WAL_LEVEL_MINIMAL)
+		ereport(FATAL,
+				(errcode(ERRCODE_CANNOT_CONNECT_NOW),
+				 errmsg("standby connections not allowed because wal_level=minimal")));
+
+	if (nwords == 3)
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile ReplicationSlot *slot;
+		bool		start_retaining = false;
+
+		ReplicationSlotAcquire(words[1]);
+		slot = MyReplicationSlot;
+		if (OidIsValid(slot->data.database))
+			ereport(FATAL,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("replication slot \"%s\" is a logical slot",
+							words[1]),
+					 errhint("Use START_LOGICAL_REPLICATION with it.")));
+
+		/* a new slot starts retaining WAL from where it's first used */
+		SpinLockAcquire(&slot->mutex);
+		if (XLogRecPtrIsInvalid(slot->data.restart_lsn))
+		{
+			slot->data.restart_lsn = recptr;
+			slot->dirty = true;
+			start_retaining = true;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		if (start_retaining)
+			ReplicationSlotsComputeRequiredLSN();
+	}
+
+	/*
+	 * Send a CopyBothResponse message, and start streaming.  The standby
+	 * sends its reply messages back on the same connection.
+	 */
+	pq_beginmessage(&buf, 'W');
+	pq_sendbyte(&buf, 0);
+	pq_sendint(&buf, 0, 2);
+	pq_endmessage(&buf);
+	pq_flush();
+
+	/*
+	 * Initialize position to the received one, then the xlog records begin
+	 * to be shipped from that position
+	 */
+	sentPtr = recptr;
+}
+
+/*
+ * Handle START_LOGICAL_REPLICATION plugin: set up decoding of the WAL
+ * written from now on into the changes of committed transactions, formatted
+ * by the given output plugin, and enter COPY BOTH mode to stream them.
+ *
+ * With START_LOGICAL_REPLICATION SLOT name, decoding instead resumes where
+ * the slot's client left off, with the slot's plugin.
+ */
+static void
+StartLogicalReplication(const char *query_string)
+{
+	char	   *words[2];
+	int			nwords;
+	char	   *plugin = NULL;
+	StringInfoData buf;
+
+	if (!am_db_walsender)
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("logical replication requires a database connection"),
+				 errhint("Connect with replication=database.")));
+
+	if (am_cascading_walsender)
+		ereport(FATAL,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("logical replication cannot be used during recovery")));
+
+	nwords = SplitCommandWords(query_string + strlen("START_LOGICAL_REPLICATION "),
+							   words, 2);
+	if (nwords == 1)
+		plugin = words[0];
+	else if (nwords == 2 && strcmp(words[0], "SLOT") == 0)
+	{
+		ReplicationSlotAcquire(words[1]);
+		if (MyReplicationSlot->data.database != MyDatabaseId)
+			ereport(FATAL,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("replication slot \"%s\" is not a logical slot of this database",
+							words[1])));
+		plugin = NameStr(MyReplicationSlot->data.plugin);
+	}
+	else
+		ereport(FATAL,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid standby query string: %s", query_string)));
+
+	logical_decoding_ctx = CreateLogicalDecodingContext(plugin,
+												MyReplicationSlot,
+												logical_read_xlog_page,
+												WalSndWriteData, NULL);
+	logical_startptr = logical_decoding_ctx->start_lsn;
+	sentPtr = logical_startptr;
+	initStringInfo(&logical_output_message);
+
+	/* Send a CopyBothResponse message, and start streaming */
+	pq_beginmessage(&buf, 'W');
+	pq_sendbyte(&buf, 0);
+	pq_sendint(&buf, 0, 2);
+	pq_endmessage(&buf);
+	pq_flush();
+}
+
+/*
+ * XLogReader callback for logical decoding: read the part of a WAL page
+ * that has been flushed, like XLogSend sends only flushed WAL.
+ */
+static int
+logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr,
+					   int reqLen, char *cur_page, void *private_data)
+{
+	XLogRecPtr	flushptr = GetFlushRecPtr();
+	int			count;
+
+	if (XLByteLE(flushptr, targetPagePtr))
+		return -1;
+
+	if (flushptr.xlogid != targetPagePtr.xlogid ||
+		flushptr.xrecoff - targetPagePtr.xrecoff >= XLOG_BLCKSZ)
+		count = XLOG_BLCKSZ;
+	else
+	{
+		count = flushptr.xrecoff - targetPagePtr.xrecoff;
+		if (count < reqLen)
+			return -1;
+	}
+
+	XLogRead(cur_page, targetPagePtr, count);
+
+	return count;
+}
+
+/*
+ * Send the output the plugin wrote for a change or transaction boundary, in
+ * a WAL data message whose start is the location of the change.
+ */
+static void
+WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid)
+{
+	WalDataMessageHeader msghdr;
+
+	msghdr.dataStart = lsn;
+	msghdr.walEnd = GetFlushRecPtr();
+	msghdr.sendTime = GetCurrentTimestamp();
+
+	resetStringInfo(&logical_output_message);
+	appendStringInfoChar(&logical_output_message, 'w');
+	appendBinaryStringInfo(&logical_output_message, (char *) &msghdr,
+						   sizeof(WalDataMessageHeader));
+	appendBinaryStringInfo(&logical_output_message, ctx->out->data,
+						   ctx->out->len);
+
+	pq_putmessage('d', logical_output_message.data,
+				  logical_output_message.len);
+}
+
+/*
+ * Logical decoding counterpart of XLogSend: decode the WAL flushed so far,
+ * which sends the output for transactions that commit.  To keep
+ * replies flowing, no more than MAX_SEND_SIZE bytes of WAL are read at a
+ * time.
+ *
+ * Returns true if OK, false if trouble.
+ */
+static bool
+XLogSendLogical(bool *caughtup)
+{
+	LogicalDecodingContext *ctx = logical_decoding_ctx;
+	XLogRecPtr	endptr;
+	XLogRecord *record;
+	char	   *errm;
+
+	*caughtup = false;
+
+	endptr = sentPtr;
+	XLByteAdvance(endptr, MAX_SEND_SIZE);
+
+	while (XLByteLT(sentPtr, endptr))
+	{
+		record = XLogReadRecord(ctx->reader, logical_startptr, &errm);
+		if (record == NULL)
+		{
+			if (errm != NULL)
+				ereport(ERROR,
+						(errmsg("could not decode WAL at %X/%X: %s",
+								sentPtr.xlogid, sentPtr.xrecoff, errm)));
+
+			/* nothing more has been flushed yet */
+			*caughtup = true;
+			break;
+		}
+		logical_startptr.xlogid = 0;
+		logical_startptr.xrecoff = 0;
+
+		DecodeRecordIntoReorderBuffer(ctx, record);
+
+		sentPtr = ctx->reader->EndRecPtr;
+	}
+
+	/* Flush pending output to the client */
+	if (pq_flush())
+		return false;
+
+	/* Update shared memory status */
+	{
+		/* use volatile pointer to prevent code rearrangement */
+		volatile WalSnd *walsnd = MyWalSnd;
+
+		SpinLockAcquire(&walsnd->mutex);
+		walsnd->sentPtr = sentPtr;
+		SpinLockRelease(&walsnd->mutex);
+	}
+
+	/* Report progress of decoding in PS display */
+	if (update_process_title)
+	{
+		char		activitymsg[50];
+
+		snprintf(activitymsg, sizeof(activitymsg), "decoding %X/%X",
+				 sentPtr.xlogid, sentPtr.xrecoff);
+		set_ps_display(activitymsg, false);
+	}
+
+	return true;
+}
+
 /* SIGHUP: set flag to re-read config file at next convenient time */
 static void
 WalSndSigHupHandler(SIGNAL_ARGS)
@@ -818,7 +1522,7 @@ WalSndSigHupHandler(SIGNAL_ARGS)
 static void
 WalSndShutdownHandler(SIGNAL_ARGS)
 {
-	shutdown_requested = true;
+	walsender_shutdown_requested = true;
 	if (MyWalSnd)
 		SetLatch(&MyWalSnd->latch);
 }
@@ -922,6 +1626,9 @@ WalSndShmemInit(void)
 		/* First time through, so initialize */
 		MemSet(WalSndCtl, 0, WalSndShmemSize());
 
+		for (i = 0; i < NUM_SYNC_REP_WAIT_MODE; i++)
+			SHMQueueInit(&(WalSndCtl->SyncRepQueue[i]));
+
 		for (i = 0; i < max_wal_senders; i++)
 		{
 			WalSnd	   *walsnd = &WalSndCtl->walsnds[i];
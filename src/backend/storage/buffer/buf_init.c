@@ -21,6 +21,7 @@
 BufferDesc *BufferDescriptors;
 char	   *BufferBlocks;
 int32	   *PrivateRefCount;
+CkptSortItem *CkptBufferIds;
 
 
 /*
@@ -73,20 +74,30 @@ void
 InitBufferPool(void)
 {
 	bool		foundBufs,
-				foundDescs;
+				foundDescs,
+				foundIds;
 
 	BufferDescriptors = (BufferDesc *)
 		ShmemInitStruct("Buffer Descriptors",
 						NBuffers * sizeof(BufferDesc), &foundDescs);
 
+	/* Align the buffers so that they can be used for direct I/O */
 	BufferBlocks = (char *)
-		ShmemInitStruct("Buffer Blocks",
-						NBuffers * (Size) BLCKSZ, &foundBufs);
-
-	if (foundDescs || foundBufs)
+		TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER,
+				  ShmemInitStruct("Buffer Blocks",
+								  NBuffers * (Size) BLCKSZ +
+								  ALIGNOF_DIRECT_IO_BUFFER,
+								  &foundBufs));
+
+	/* Needed by BufferSync to sort the buffers a checkpoint writes */
+	CkptBufferIds = (CkptSortItem *)
+		ShmemInitStruct("Checkpoint BufferIds",
+						NBuffers * sizeof(CkptSortItem), &foundIds);
+
+	if (foundDescs || foundBufs || foundIds)
 	{
-		/* both should be present or neither */
-		Assert(foundDescs && foundBufs);
+		/* all should be present or neither */
+		Assert(foundDescs && foundBufs && foundIds);
 		/* note: this path is only taken in EXEC_BACKEND case */
 	}
 	else
@@ -168,8 +179,12 @@ BufferShmemSize(void)
 	/* size of buffer descriptors */
 	size = add_size(size, mul_size(NBuffers, sizeof(BufferDesc)));
 
-	/* size of data pages */
+	/* size of data pages, plus alignment padding */
 	size = add_size(size, mul_size(NBuffers, BLCKSZ));
+	size = add_size(size, ALIGNOF_DIRECT_IO_BUFFER);
+
+	/* size of the checkpoint sort array */
+	size = add_size(size, mul_size(NBuffers, sizeof(CkptSortItem)));
 
 	/* size of stuff controlled by freelist.c */
 	size = add_size(size, StrategyShmemSize());
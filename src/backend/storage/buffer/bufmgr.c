@@ -74,25 +74,113 @@ double		bgwriter_lru_multiplier = 2.0;
  */
 int			target_prefetch_pages = 0;
 
+/*
+ * Number of blocks a checkpoint writes before asking the kernel to start
+ * writing them back (see ScheduleCheckpointWriteback).  Zero disables.
+ */
+int			checkpoint_flush_after = 32;
+
+/*
+ * Most I/O is done one buffer at a time, but ReadBufferBatch and the
+ * checkpoint and bgwriter writes can have up to this many buffers' I/O in
+ * progress at once.  Each one holds an io_in_progress lock (and a write
+ * also holds a content lock), so this must stay well below
+ * MAX_SIMUL_LWLOCKS.
+ */
+#define MAX_IO_IN_PROGRESS		32
+
+/* results of StartBufferIOExtended */
+typedef enum
+{
+	BUFFER_IO_STARTED,			/* we now own the I/O */
+	BUFFER_IO_DONE,				/* someone else already did the work */
+	BUFFER_IO_BUSY				/* someone else is doing it (nowait only) */
+} BufferIOState;
+
 /* local state for StartBufferIO and related functions */
-static volatile BufferDesc *InProgressBuf = NULL;
-static bool IsForInput;
+static volatile BufferDesc *InProgressBufs[MAX_IO_IN_PROGRESS];
+static bool InProgressForInput[MAX_IO_IN_PROGRESS];
+static int	NumInProgressBufs = 0;
+
+/*
+ * writes started by SyncOneBuffer, see CompleteBufferWrites.  A request may
+ * cover a run of buffers; its first entry has the handle and the number of
+ * buffers in the run, and the other entries have nbufs = 0.
+ */
+typedef struct PendingWrite
+{
+	volatile BufferDesc *buf;
+	int			nbufs;
+	AioHandle	handle;
+} PendingWrite;
+
+static PendingWrite PendingWrites[MAX_IO_IN_PROGRESS];
+static int	NumPendingWrites = 0;
+
+/*
+ * Ranges of blocks written by the current checkpoint that the kernel hasn't
+ * yet been asked to write back, see ScheduleCheckpointWriteback.  There are
+ * never more ranges than blocks, so checkpoint_flush_after bounds both.
+ */
+typedef struct PendingWriteback
+{
+	BufferTag	tag;			/* first block of the range */
+	int			nblocks;
+} PendingWriteback;
+
+static PendingWriteback PendingWritebacks[WRITEBACK_MAX_PENDING_FLUSHES];
+static int	NumPendingWritebacks = 0;
+static int	NumPendingWritebackBlocks = 0;
+
+/*
+ * Per-tablespace state of a checkpoint's writes, used by BufferSync to
+ * spread the writes over the tablespaces.
+ */
+typedef struct CkptTsStatus
+{
+	Oid			tsId;
+	double		progress;		/* in units of buffers of the whole checkpoint */
+	double		progress_slice; /* progress per buffer of this tablespace */
+	int			num_to_scan;	/* number of its buffers in CkptBufferIds */
+	int			num_scanned;	/* number of them processed so far */
+	int			index;			/* next of its entries in CkptBufferIds */
+} CkptTsStatus;
 
 /* local state for LockBufferForCleanup */
 static volatile BufferDesc *PinCountWaitBuf = NULL;
 
 
+#ifdef USE_PREFETCH
+static void PrefetchSharedBuffer(SMgrRelation smgr_reln, ForkNumber forkNum,
+					 BlockNumber blockNum);
+#endif
 static Buffer ReadBuffer_common(SMgrRelation reln,
 				  ForkNumber forkNum, BlockNumber blockNum,
 				  ReadBufferMode mode, BufferAccessStrategy strategy,
 				  bool *hit);
+static int ReadBufferBatch_shared(Relation reln, ForkNumber forkNum,
+					   BlockNumber *blockNums, int nblocks,
+					   BufferAccessStrategy strategy, Buffer *buffers);
+static void CheckReadBuffer(SMgrRelation smgr, ForkNumber forkNum,
+				BlockNumber blockNum, ReadBufferMode mode, Block bufBlock);
+static void CompleteReadBuffer(SMgrRelation smgr, ForkNumber forkNum,
+				   BlockNumber blockNum, ReadBufferMode mode,
+				   Block bufBlock, AioHandle handle);
 static bool PinBuffer(volatile BufferDesc *buf, BufferAccessStrategy strategy);
 static void PinBuffer_Locked(volatile BufferDesc *buf);
 static void UnpinBuffer(volatile BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
-static int	SyncOneBuffer(int buf_id, bool skip_recently_used);
+static int	buffertag_comparator(const void *a, const void *b);
+static void ScheduleCheckpointWriteback(BufferTag *tag, int nblocks);
+static void IssuePendingWritebacks(void);
+static int	SyncOneBuffer(int buf_id, bool skip_recently_used,
+			  int *nneighbours);
+static int GetDirtyNeighbours(volatile BufferDesc *buf,
+				   volatile BufferDesc **neighbours, int maxNeighbours);
 static void WaitIO(volatile BufferDesc *buf);
 static bool StartBufferIO(volatile BufferDesc *buf, bool forInput);
+static BufferIOState StartBufferIOExtended(volatile BufferDesc *buf,
+					  bool forInput, bool nowait);
 static void TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 				  int set_flag_bits);
 static void shared_buffer_write_error_callback(void *arg);
@@ -100,8 +188,12 @@ static void local_buffer_write_error_callback(void *arg);
 static volatile BufferDesc *BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 			BlockNumber blockNum,
 			BufferAccessStrategy strategy,
-			bool *foundPtr);
+			bool startIO, bool *foundPtr);
 static void FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln);
+static int FlushBufferRunStart(volatile BufferDesc **bufs, int nbufs,
+					SMgrRelation reln, AioHandle *handle);
+static void FlushBufferRunComplete(volatile BufferDesc **bufs, int nbufs,
+					   SMgrRelation reln, AioHandle handle);
 static void AtProcExit_Buffers(int code, Datum arg);
 
 
@@ -135,43 +227,72 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
 	}
 	else
-	{
-		BufferTag	newTag;		/* identity of requested block */
-		uint32		newHash;	/* hash value for newTag */
-		LWLockId	newPartitionLock;	/* buffer partition lock for it */
-		int			buf_id;
+		PrefetchSharedBuffer(reln->rd_smgr, forkNum, blockNum);
+#endif   /* USE_PREFETCH */
+}
+
+/*
+ * PrefetchBufferWithoutRelcache -- like PrefetchBuffer, but doesn't require
+ *		a relcache entry for the relation.
+ *
+ * As with ReadBufferWithoutRelcache, this may not be used on temporary
+ * relations; it is meant for prefetching ahead of XLOG replay.
+ */
+void
+PrefetchBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
+							  BlockNumber blockNum)
+{
+#ifdef USE_PREFETCH
+	SMgrRelation smgr = smgropen(rnode, InvalidBackendId);
+
+	PrefetchSharedBuffer(smgr, forkNum, blockNum);
+#endif   /* USE_PREFETCH */
+}
 
-		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
+#ifdef USE_PREFETCH
+/*
+ * PrefetchSharedBuffer -- guts of prefetching a block into shared buffers
+ */
+static void
+PrefetchSharedBuffer(SMgrRelation smgr_reln, ForkNumber forkNum,
+					 BlockNumber blockNum)
+{
+	BufferTag	newTag;			/* identity of requested block */
+	uint32		newHash;		/* hash value for newTag */
+	LWLockId	newPartitionLock;		/* buffer partition lock for it */
+	int			buf_id;
 
-		/* determine its hash code and partition lock ID */
-		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
+	Assert(BlockNumberIsValid(blockNum));
 
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
-		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
+	/* create a tag so we can lookup the buffer */
+	INIT_BUFFERTAG(newTag, smgr_reln->smgr_rnode.node, forkNum, blockNum);
 
-		/* If not in buffers, initiate prefetch */
-		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
+	/* determine its hash code and partition lock ID */
+	newHash = BufTableHashCode(&newTag);
+	newPartitionLock = BufMappingPartitionLock(newHash);
 
-		/*
-		 * If the block *is* in buffers, we do nothing.  This is not really
-		 * ideal: the block might be just about to be evicted, which would be
-		 * stupid since we know we are going to need it soon.  But the only
-		 * easy answer is to bump the usage_count, which does not seem like a
-		 * great solution: when the caller does ultimately touch the block,
-		 * usage_count would get bumped again, resulting in too much
-		 * favoritism for blocks that are involved in a prefetch sequence. A
-		 * real fix would involve some additional per-buffer state, and it's
-		 * not clear that there's enough of a problem to justify that.
-		 */
-	}
-#endif   /* USE_PREFETCH */
+	/* see if the block is in the buffer pool already */
+	LWLockAcquire(newPartitionLock, LW_SHARED);
+	buf_id = BufTableLookup(&newTag, newHash);
+	LWLockRelease(newPartitionLock);
+
+	/* If not in buffers, initiate prefetch */
+	if (buf_id < 0)
+		smgrprefetch(smgr_reln, forkNum, blockNum);
+
+	/*
+	 * If the block *is* in buffers, we do nothing.  This is not really ideal:
+	 * the block might be just about to be evicted, which would be stupid
+	 * since we know we are going to need it soon.  But the only easy answer
+	 * is to bump the usage_count, which does not seem like a great solution:
+	 * when the caller does ultimately touch the block, usage_count would get
+	 * bumped again, resulting in too much favoritism for blocks that are
+	 * involved in a prefetch sequence. A real fix would involve some
+	 * additional per-buffer state, and it's not clear that there's enough of
+	 * a problem to justify that.
+	 */
 }
+#endif   /* USE_PREFETCH */
 
 
 /*
@@ -270,6 +391,489 @@ ReadBufferWithoutRelcache(RelFileNode rnode, ForkNumber forkNum,
 	return ReadBuffer_common(smgr, forkNum, blockNum, mode, strategy, &hit);
 }
 
+/*
+ * ReadBufferBatch -- read several blocks of a relation fork at once
+ *
+ * This is equivalent to calling ReadBufferExtended in RBM_NORMAL mode for
+ * each of blockNums[0 .. nblocks-1], and returns the pinned buffers in
+ * buffers[].  The difference is that the reads of blocks that are not in
+ * the buffer pool are all started before any of them is waited for, so
+ * that with asynchronous I/O (see storage/file/aio.c) the kernel can work
+ * on them concurrently, and that runs of adjacent missing blocks are read
+ * with a single vectored request.  All the reads are complete at return.
+ *
+ * Returns the number of blocks that were not found in the buffer pool.
+ */
+int
+ReadBufferBatch(Relation reln, ForkNumber forkNum, BlockNumber *blockNums,
+				int nblocks, BufferAccessStrategy strategy, Buffer *buffers)
+{
+	int			nmisses = 0;
+	int			i;
+
+	/* Open it at the smgr level if not already done */
+	RelationOpenSmgr(reln);
+
+	/* Local buffers are private to us; just read the blocks one by one */
+	if (SmgrIsTemp(reln->rd_smgr))
+	{
+		/* see comments in ReadBufferExtended */
+		if (RELATION_IS_OTHER_TEMP(reln))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				errmsg("cannot access temporary tables of other sessions")));
+
+		for (i = 0; i < nblocks; i++)
+		{
+			bool		hit;
+
+			pgstat_count_buffer_read(reln);
+			buffers[i] = ReadBuffer_common(reln->rd_smgr, forkNum,
+										   blockNums[i], RBM_NORMAL,
+										   strategy, &hit);
+			if (hit)
+				pgstat_count_buffer_hit(reln);
+			else
+				nmisses++;
+		}
+		return nmisses;
+	}
+
+	for (i = 0; i < nblocks; i += MAX_IO_IN_PROGRESS)
+		nmisses += ReadBufferBatch_shared(reln, forkNum, blockNums + i,
+										  Min(nblocks - i, MAX_IO_IN_PROGRESS),
+										  strategy, buffers + i);
+
+	return nmisses;
+}
+
+/*
+ * ReadBufferBatch_shared -- subroutine for ReadBufferBatch
+ *
+ * Reads at most MAX_IO_IN_PROGRESS blocks of a non-temporary relation.
+ *
+ * We must never sleep waiting for another backend's buffer I/O while we
+ * have reads of our own in progress: that backend might be waiting for one
+ * of ours in turn.  So we first pin all the buffers, with no I/O in
+ * progress; then start the reads of the buffers whose I/O we can claim
+ * without waiting; wait for those to complete; and only then deal with the
+ * buffers that someone else was busy with.  Returns the number of blocks
+ * that were not found in the buffer pool.
+ *
+ * Consecutive entries of blockNums[] that are adjacent blocks are read
+ * with one smgrstartreadv call (or a few, if the run crosses a segment
+ * boundary).  Without asynchronous I/O the reads are done synchronously
+ * as they are started, but the same locking rules apply.
+ */
+static int
+ReadBufferBatch_shared(Relation reln, ForkNumber forkNum,
+					   BlockNumber *blockNums, int nblocks,
+					   BufferAccessStrategy strategy, Buffer *buffers)
+{
+	SMgrRelation smgr = reln->rd_smgr;
+	volatile BufferDesc *bufHdrs[MAX_IO_IN_PROGRESS];
+	AioHandle	handles[MAX_IO_IN_PROGRESS];
+	int			runLen[MAX_IO_IN_PROGRESS];
+	bool		started[MAX_IO_IN_PROGRESS];
+	bool		valid[MAX_IO_IN_PROGRESS];
+	bool		hit[MAX_IO_IN_PROGRESS];
+	char	   *blocks[MAX_IO_IN_PROGRESS];
+	int			nmisses = 0;
+	int			i;
+	int			j;
+
+	Assert(nblocks <= MAX_IO_IN_PROGRESS);
+	Assert(NumInProgressBufs == 0);
+
+	/* Pin all the buffers */
+	for (i = 0; i < nblocks; i++)
+	{
+		/* Make sure we will have room to remember the buffer pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		TRACE_POSTGRESQL_BUFFER_READ_START(forkNum, blockNums[i],
+										   smgr->smgr_rnode.node.spcNode,
+										   smgr->smgr_rnode.node.dbNode,
+										   smgr->smgr_rnode.node.relNode,
+										   smgr->smgr_rnode.backend,
+										   false);
+
+		bufHdrs[i] = BufferAlloc(smgr, forkNum, blockNums[i], strategy,
+								 false, &valid[i]);
+		hit[i] = valid[i];
+		blocks[i] = (char *) BufHdrGetBlock(bufHdrs[i]);
+		started[i] = false;
+		runLen[i] = 0;
+	}
+
+	/* Claim the I/O of the buffers we can claim without waiting */
+	for (i = 0; i < nblocks; i++)
+	{
+		if (valid[i])
+			continue;
+
+		switch (StartBufferIOExtended(bufHdrs[i], true, true))
+		{
+			case BUFFER_IO_STARTED:
+				started[i] = true;
+				break;
+			case BUFFER_IO_DONE:
+				valid[i] = hit[i] = true;
+				break;
+			case BUFFER_IO_BUSY:
+				/* deal with it below */
+				break;
+		}
+	}
+
+	/*
+	 * Start the reads, a run of adjacent blocks at a time.  runLen[i] is the
+	 * number of blocks covered by the request that starts at entry i.
+	 */
+	i = 0;
+	while (i < nblocks)
+	{
+		int			n = 1;
+
+		if (!started[i])
+		{
+			i++;
+			continue;
+		}
+
+		while (i + n < nblocks && started[i + n] &&
+			   blockNums[i + n] == blockNums[i + n - 1] + 1)
+			n++;
+
+		runLen[i] = smgrstartreadv(smgr, forkNum, blockNums[i], &blocks[i],
+								   n, &handles[i]);
+		i += runLen[i];
+	}
+	AioSubmit();
+
+	/* Wait for them */
+	for (i = 0; i < nblocks; i++)
+	{
+		if (runLen[i] == 0)
+			continue;
+
+		smgrcompletereadv(smgr, forkNum, blockNums[i], &blocks[i], runLen[i],
+						  handles[i]);
+		for (j = i; j < i + runLen[i]; j++)
+		{
+			CheckReadBuffer(smgr, forkNum, blockNums[j], RBM_NORMAL,
+							(Block) blocks[j]);
+			TerminateBufferIO(bufHdrs[j], false, BM_VALID);
+			valid[j] = true;
+		}
+	}
+
+	/*
+	 * Now that we have no I/O in progress, it's safe to wait for the
+	 * buffers others were busy with.  If their I/O failed, StartBufferIO
+	 * lets us retry it, synchronously.
+	 */
+	for (i = 0; i < nblocks; i++)
+	{
+		if (valid[i])
+			continue;
+
+		if (StartBufferIO(bufHdrs[i], true))
+		{
+			smgrread(smgr, forkNum, blockNums[i], blocks[i]);
+			CheckReadBuffer(smgr, forkNum, blockNums[i], RBM_NORMAL,
+							(Block) blocks[i]);
+			TerminateBufferIO(bufHdrs[i], false, BM_VALID);
+		}
+		else
+			hit[i] = true;
+	}
+
+	/* Finally, update the statistics as ReadBufferExtended would */
+	for (i = 0; i < nblocks; i++)
+	{
+		pgstat_count_buffer_read(reln);
+		if (hit[i])
+		{
+			pgstat_count_buffer_hit(reln);
+			pgBufferUsage.shared_blks_hit++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageHit;
+		}
+		else
+		{
+			pgBufferUsage.shared_blks_read++;
+			if (VacuumCostActive)
+				VacuumCostBalance += VacuumCostPageMiss;
+			nmisses++;
+		}
+
+		TRACE_POSTGRESQL_BUFFER_READ_DONE(forkNum, blockNums[i],
+										  smgr->smgr_rnode.node.spcNode,
+										  smgr->smgr_rnode.node.dbNode,
+										  smgr->smgr_rnode.node.relNode,
+										  smgr->smgr_rnode.backend,
+										  false,
+										  hit[i]);
+
+		buffers[i] = BufferDescriptorGetBuffer(bufHdrs[i]);
+	}
+
+	return nmisses;
+}
+
+
+/*
+ * Read streams
+ *
+ * A read stream lets a scan that knows (or can guess) which blocks it is
+ * going to read next have them read ahead of time.  The scan supplies a
+ * callback that predicts the block numbers, and calls ReadStreamReadBuffer
+ * in place of ReadBufferExtended.  The stream keeps a queue of predicted
+ * blocks, up to "distance" of them; whenever it runs out of buffers, it
+ * reads the next few queued blocks with ReadBufferBatch, so that their I/O
+ * overlaps, and issues PrefetchBuffer hints for the rest of the queue.
+ *
+ * The look-ahead distance adapts to what the scan finds: it is doubled
+ * whenever a batch had to do I/O, and shrinks by one when a batch was
+ * satisfied entirely from the buffer pool, so a scan of a cached relation
+ * doesn't hold more pins or issue more hints than necessary.
+ *
+ * A wrong prediction costs little: if the block the scan asks for isn't
+ * the one at the head of the queue, the queue is discarded, the block is
+ * read directly, and the callback is asked to restart from there.  We
+ * compare the request with the head of the queue before reading anything,
+ * so a scan going in a direction the callback doesn't know about (say, a
+ * backward heap scan) reads no blocks in vain.
+ */
+
+/* maximum look-ahead distance */
+#define READ_STREAM_MAX_DISTANCE	64
+
+/* maximum number of blocks read and pinned at once */
+#define READ_STREAM_MAX_BATCH		16
+
+struct ReadStream
+{
+	Relation	rel;
+	ForkNumber	forkNum;
+	BufferAccessStrategy strategy;
+	ReadStreamBlockCallback callback;
+	void	   *callback_private;
+
+	int			distance;		/* current look-ahead distance */
+	int			maxBatch;		/* max number of buffers we pin at a time */
+
+	/* state for calling the callback */
+	bool		restart;		/* must restart callback from prevBlock */
+	bool		finished;		/* callback has returned InvalidBlockNumber */
+	BlockNumber prevBlock;		/* last block predicted or read directly */
+
+	/* circular queue of predicted blocks that haven't been read yet */
+	BlockNumber queue[READ_STREAM_MAX_DISTANCE];
+	int			queueHead;
+	int			queueLen;
+	int			queueHinted;	/* # of leading entries already prefetched */
+
+	/* blocks read in the last batch, not yet handed out */
+	BlockNumber readyBlocks[READ_STREAM_MAX_BATCH];
+	Buffer		readyBuffers[READ_STREAM_MAX_BATCH];
+	int			readyNext;
+	int			readyLen;
+};
+
+/*
+ * ReadStreamBegin -- set up a read stream for a relation fork
+ *
+ * The stream doesn't read anything until the first ReadStreamReadBuffer
+ * call, so it's cheap to create one for a scan that may end early.
+ */
+ReadStream *
+ReadStreamBegin(Relation reln, ForkNumber forkNum,
+				BufferAccessStrategy strategy,
+				ReadStreamBlockCallback callback, void *callback_private)
+{
+	ReadStream *stream;
+	int			maxBatch;
+
+	stream = (ReadStream *) palloc(sizeof(ReadStream));
+	stream->rel = reln;
+	stream->forkNum = forkNum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private = callback_private;
+
+	/*
+	 * Don't let a single backend pin more than its fair share of the buffer
+	 * pool, else concurrent scans could run us out of unpinned buffers.
+	 */
+	maxBatch = NBuffers / Max(MaxBackends, 1);
+	stream->maxBatch = Max(Min(maxBatch, READ_STREAM_MAX_BATCH), 1);
+	stream->distance = 1;
+
+	stream->restart = true;
+	stream->finished = false;
+	stream->prevBlock = InvalidBlockNumber;
+
+	stream->queueHead = 0;
+	stream->queueLen = 0;
+	stream->queueHinted = 0;
+	stream->readyNext = 0;
+	stream->readyLen = 0;
+
+	return stream;
+}
+
+/*
+ * ReadStreamFillQueue -- top up the queue of predicted blocks
+ */
+static void
+ReadStreamFillQueue(ReadStream *stream)
+{
+	while (stream->queueLen < stream->distance && !stream->finished)
+	{
+		BlockNumber blockNum;
+
+		blockNum = stream->callback(stream->callback_private,
+									stream->prevBlock, stream->restart);
+		stream->restart = false;
+
+		if (!BlockNumberIsValid(blockNum))
+		{
+			stream->finished = true;
+			break;
+		}
+
+		stream->queue[(stream->queueHead + stream->queueLen) %
+					  READ_STREAM_MAX_DISTANCE] = blockNum;
+		stream->queueLen++;
+		stream->prevBlock = blockNum;
+	}
+}
+
+/*
+ * ReadStreamReadBatch -- read the next batch of queued blocks
+ *
+ * The queue must not be empty, and all previously read buffers must have
+ * been handed out.
+ */
+static void
+ReadStreamReadBatch(ReadStream *stream)
+{
+	int			nblocks;
+	int			nmisses;
+	int			firstHint;
+	int			i;
+
+	Assert(stream->queueLen > 0);
+	Assert(stream->readyNext == stream->readyLen);
+
+	nblocks = Min(stream->queueLen, Min(stream->distance, stream->maxBatch));
+	for (i = 0; i < nblocks; i++)
+		stream->readyBlocks[i] =
+			stream->queue[(stream->queueHead + i) % READ_STREAM_MAX_DISTANCE];
+
+	/*
+	 * Hint the blocks beyond this batch to the kernel, so that they are on
+	 * their way by the time we read them.  Without asynchronous I/O the
+	 * batch itself is read one run of adjacent blocks at a time, so hint
+	 * all but its first run too.
+	 */
+	firstHint = nblocks;
+	if (!AioAvailable())
+	{
+		for (firstHint = 1; firstHint < nblocks; firstHint++)
+		{
+			if (stream->readyBlocks[firstHint] !=
+				stream->readyBlocks[firstHint - 1] + 1)
+				break;
+		}
+	}
+	for (i = Max(firstHint, stream->queueHinted); i < stream->queueLen; i++)
+		PrefetchBuffer(stream->rel, stream->forkNum,
+				stream->queue[(stream->queueHead + i) % READ_STREAM_MAX_DISTANCE]);
+	stream->queueHinted = Max(stream->queueHinted, stream->queueLen);
+
+	nmisses = ReadBufferBatch(stream->rel, stream->forkNum,
+							  stream->readyBlocks, nblocks,
+							  stream->strategy, stream->readyBuffers);
+	stream->readyNext = 0;
+	stream->readyLen = nblocks;
+
+	stream->queueHead = (stream->queueHead + nblocks) % READ_STREAM_MAX_DISTANCE;
+	stream->queueLen -= nblocks;
+	stream->queueHinted = Max(stream->queueHinted - nblocks, 0);
+
+	/* Adjust the look-ahead distance */
+	if (nmisses > 0)
+		stream->distance = Min(stream->distance * 2, READ_STREAM_MAX_DISTANCE);
+	else if (stream->distance > 1)
+		stream->distance--;
+}
+
+/*
+ * ReadStreamReadBuffer -- return a pinned buffer for the given block
+ *
+ * This is equivalent to ReadBufferExtended in RBM_NORMAL mode with the
+ * stream's strategy, but if blockNum is the block the callback predicted,
+ * it has usually been read already.
+ */
+Buffer
+ReadStreamReadBuffer(ReadStream *stream, BlockNumber blockNum)
+{
+	if (stream->readyNext == stream->readyLen)
+	{
+		ReadStreamFillQueue(stream);
+		if (stream->queueLen > 0 &&
+			stream->queue[stream->queueHead] == blockNum)
+			ReadStreamReadBatch(stream);
+	}
+
+	if (stream->readyNext < stream->readyLen &&
+		stream->readyBlocks[stream->readyNext] == blockNum)
+		return stream->readyBuffers[stream->readyNext++];
+
+	/* The prediction was wrong; start over from this block */
+	ReadStreamReset(stream);
+	stream->prevBlock = blockNum;
+
+	return ReadBufferExtended(stream->rel, stream->forkNum, blockNum,
+							  RBM_NORMAL, stream->strategy);
+}
+
+/*
+ * ReadStreamReset -- forget all predicted blocks
+ *
+ * Releases the pins on any buffers read ahead.  The callback will be asked
+ * to restart from the beginning the next time, unless ReadStreamReadBuffer
+ * reads a block directly.
+ */
+void
+ReadStreamReset(ReadStream *stream)
+{
+	while (stream->readyNext < stream->readyLen)
+		ReleaseBuffer(stream->readyBuffers[stream->readyNext++]);
+	stream->readyNext = stream->readyLen = 0;
+
+	stream->queueHead = 0;
+	stream->queueLen = 0;
+	stream->queueHinted = 0;
+
+	stream->restart = true;
+	stream->finished = false;
+	stream->prevBlock = InvalidBlockNumber;
+}
+
+/*
+ * ReadStreamEnd -- release a read stream
+ */
+void
+ReadStreamEnd(ReadStream *stream)
+{
+	ReadStreamReset(stream);
+	pfree(stream);
+}
+
 
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
@@ -319,7 +923,7 @@ ReadBuffer_common(SMgrRelation smgr, ForkNumber forkNum,
 		 * lookup the buffer.  IO_IN_PROGRESS is set if the requested block is
 		 * not currently in memory.
 		 */
-		bufHdr = BufferAlloc(smgr, forkNum, blockNum, strategy, &found);
+		bufHdr = BufferAlloc(smgr, forkNum, blockNum, strategy, true, &found);
 		if (found)
 			pgBufferUsage.shared_blks_hit++;
 		else
@@ -431,27 +1035,11 @@ ReadBuffer_common(SMgrRelation smgr, ForkNumber forkNum,
 			MemSet((char *) bufBlock, 0, BLCKSZ);
 		else
 		{
-			smgrread(smgr, forkNum, blockNum, (char *) bufBlock);
+			AioHandle	handle;
 
-			/* check for garbage data */
-			if (!PageHeaderIsValid((PageHeader) bufBlock))
-			{
-				if (mode == RBM_ZERO_ON_ERROR || zero_damaged_pages)
-				{
-					ereport(WARNING,
-							(errcode(ERRCODE_DATA_CORRUPTED),
-							 errmsg("invalid page header in block %u of relation %s; zeroing out page",
-									blockNum,
-									relpath(smgr->smgr_rnode, forkNum))));
-					MemSet((char *) bufBlock, 0, BLCKSZ);
-				}
-				else
-					ereport(ERROR,
-							(errcode(ERRCODE_DATA_CORRUPTED),
-					 errmsg("invalid page header in block %u of relation %s",
-							blockNum,
-							relpath(smgr->smgr_rnode, forkNum))));
-			}
+			handle = smgrstartread(smgr, forkNum, blockNum, (char *) bufBlock);
+			CompleteReadBuffer(smgr, forkNum, blockNum, mode, bufBlock,
+							   handle);
 		}
 	}
 
@@ -480,6 +1068,52 @@ ReadBuffer_common(SMgrRelation smgr, ForkNumber forkNum,
 	return BufferDescriptorGetBuffer(bufHdr);
 }
 
+/*
+ * CompleteReadBuffer -- wait for a read started with smgrstartread, and
+ *		check the page that was read.
+ *
+ * The caller still has to mark the buffer valid.
+ */
+static void
+CompleteReadBuffer(SMgrRelation smgr, ForkNumber forkNum,
+				   BlockNumber blockNum, ReadBufferMode mode,
+				   Block bufBlock, AioHandle handle)
+{
+	smgrcompleteread(smgr, forkNum, blockNum, (char *) bufBlock, handle);
+	CheckReadBuffer(smgr, forkNum, blockNum, mode, bufBlock);
+}
+
+/*
+ * CheckReadBuffer -- check a page that was just read in
+ *
+ * An invalid page header is an error, unless the mode or zero_damaged_pages
+ * says to zero the page instead.
+ */
+static void
+CheckReadBuffer(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
+				ReadBufferMode mode, Block bufBlock)
+{
+	/* check for garbage data */
+	if (!PageHeaderIsValid((PageHeader) bufBlock))
+	{
+		if (mode == RBM_ZERO_ON_ERROR || zero_damaged_pages)
+		{
+			ereport(WARNING,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid page header in block %u of relation %s; zeroing out page",
+							blockNum,
+							relpath(smgr->smgr_rnode, forkNum))));
+			MemSet((char *) bufBlock, 0, BLCKSZ);
+		}
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid page header in block %u of relation %s",
+							blockNum,
+							relpath(smgr->smgr_rnode, forkNum))));
+	}
+}
+
 /*
  * BufferAlloc -- subroutine for ReadBuffer.  Handles lookup of a shared
  *		buffer.  If no buffer exists already, selects a replacement
@@ -497,13 +1131,17 @@ ReadBuffer_common(SMgrRelation smgr, ForkNumber forkNum,
  * *foundPtr is actually redundant with the buffer's BM_VALID flag, but
  * we keep it for simplicity in ReadBuffer.
  *
+ * If startIO is false, the buffer is not marked IO_IN_PROGRESS, and we
+ * don't wait for anyone else's I/O on it; *foundPtr then just tells whether
+ * the buffer was valid, and the caller must do StartBufferIO itself.
+ *
  * No locks are held either at entry or exit.
  */
 static volatile BufferDesc *
 BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 			BlockNumber blockNum,
 			BufferAccessStrategy strategy,
-			bool *foundPtr)
+			bool startIO, bool *foundPtr)
 {
 	BufferTag	newTag;			/* identity of requested block */
 	uint32		newHash;		/* hash value for newTag */
@@ -542,7 +1180,9 @@ BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 
 		*foundPtr = TRUE;
 
-		if (!valid)
+		if (!valid && !startIO)
+			*foundPtr = FALSE;
+		else if (!valid)
 		{
 			/*
 			 * We can only get here if (a) someone else is still reading in
@@ -817,7 +1457,9 @@ BufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 	 * lock.  If StartBufferIO returns false, then someone else managed to
 	 * read it before we did, so there's nothing left for BufferAlloc() to do.
 	 */
-	if (StartBufferIO(buf, true))
+	if (!startIO)
+		*foundPtr = FALSE;
+	else if (StartBufferIO(buf, true))
 		*foundPtr = FALSE;
 	else
 		*foundPtr = TRUE;
@@ -1157,22 +1799,32 @@ UnpinBuffer(volatile BufferDesc *buf, bool fixOwner)
  * This is called at checkpoint time to write out all dirty shared buffers.
  * The checkpoint request flags should be passed in; currently the only one
  * examined is CHECKPOINT_IMMEDIATE, which disables delays between writes.
+ *
+ * The buffers are written in file order rather than in buffer order, which
+ * turns the writes into mostly sequential I/O and lets SyncOneBuffer combine
+ * neighbours into one request.  The tablespaces are worked through in
+ * parallel, each at a rate proportional to its share of the dirty buffers,
+ * so that no single disk gets all the writes at once.  And every
+ * checkpoint_flush_after blocks we ask the kernel to start writing back what
+ * we have written, so that the fsyncs at the end of the checkpoint don't
+ * find gigabytes of dirty data in the page cache.
  */
 static void
 BufferSync(int flags)
 {
 	int			buf_id;
-	int			num_to_scan;
 	int			num_to_write;
 	int			num_written;
-
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+	int			num_processed;
+	CkptTsStatus *spaces;
+	int			num_spaces;
+	int			i;
 
 	/*
 	 * Loop over all buffers, and mark the ones that need to be written with
 	 * BM_CHECKPOINT_NEEDED.  Count them as we go (num_to_write), so that we
-	 * can estimate how much work needs to be done.
+	 * can estimate how much work needs to be done, and remember their tags
+	 * in CkptBufferIds for sorting.
 	 *
 	 * This allows us to write only those pages that were dirty when the
 	 * checkpoint began, and not those that get dirtied while it proceeds.
@@ -1198,8 +1850,11 @@ BufferSync(int flags)
 
 		if (bufHdr->flags & BM_DIRTY)
 		{
+			CkptSortItem *item = &CkptBufferIds[num_to_write++];
+
 			bufHdr->flags |= BM_CHECKPOINT_NEEDED;
-			num_to_write++;
+			item->tag = bufHdr->tag;
+			item->buf_id = buf_id;
 		}
 
 		UnlockBufHdr(bufHdr);
@@ -1211,19 +1866,82 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_START(NBuffers, num_to_write);
 
 	/*
-	 * Loop over all buffers again, and write the ones (still) marked with
-	 * BM_CHECKPOINT_NEEDED.  In this loop, we start at the clock sweep point
-	 * since we might as well dump soon-to-be-recycled buffers first.
+	 * Sort the buffers to write by tag.  The tag can change as soon as we've
+	 * released the header lock above, so the order is only a good guess; we
+	 * check each buffer's flag again before writing it, and SyncOneBuffer
+	 * writes whatever page the buffer holds by then.
+	 */
+	qsort(CkptBufferIds, num_to_write, sizeof(CkptSortItem),
+		  buffertag_comparator);
+
+	/*
+	 * Collect the tablespaces, which are now contiguous runs in the sorted
+	 * array.  There are rarely more than a handful, so a plain array that
+	 * we search linearly is good enough.
+	 */
+	num_spaces = 1;
+	for (i = 1; i < num_to_write; i++)
+	{
+		if (CkptBufferIds[i].tag.rnode.spcNode !=
+			CkptBufferIds[i - 1].tag.rnode.spcNode)
+			num_spaces++;
+	}
+	spaces = (CkptTsStatus *) palloc(sizeof(CkptTsStatus) * num_spaces);
+	num_spaces = 0;
+	for (i = 0; i < num_to_write; i++)
+	{
+		Oid			tsId = CkptBufferIds[i].tag.rnode.spcNode;
+
+		if (num_spaces == 0 || spaces[num_spaces - 1].tsId != tsId)
+		{
+			CkptTsStatus *ts = &spaces[num_spaces++];
+
+			ts->tsId = tsId;
+			ts->progress = 0;
+			ts->num_to_scan = 0;
+			ts->num_scanned = 0;
+			ts->index = i;
+		}
+		spaces[num_spaces - 1].num_to_scan++;
+	}
+	for (i = 0; i < num_spaces; i++)
+		spaces[i].progress_slice =
+			(double) num_to_write / spaces[i].num_to_scan;
+
+	NumPendingWritebacks = 0;
+	NumPendingWritebackBlocks = 0;
+
+	/*
+	 * Write the buffers (still) marked with BM_CHECKPOINT_NEEDED, each time
+	 * taking the next one from the tablespace that is furthest behind.
 	 *
 	 * Note that we don't read the buffer alloc count here --- that should be
 	 * left untouched till the next BgBufferSync() call.
 	 */
-	buf_id = StrategySyncStart(NULL, NULL);
-	num_to_scan = NBuffers;
 	num_written = 0;
-	while (num_to_scan-- > 0)
+	num_processed = 0;
+	for (;;)
 	{
-		volatile BufferDesc *bufHdr = &BufferDescriptors[buf_id];
+		CkptTsStatus *ts = NULL;
+		CkptSortItem *item;
+		volatile BufferDesc *bufHdr;
+
+		for (i = 0; i < num_spaces; i++)
+		{
+			if (spaces[i].num_scanned < spaces[i].num_to_scan &&
+				(ts == NULL || spaces[i].progress < ts->progress))
+				ts = &spaces[i];
+		}
+		if (ts == NULL)
+			break;				/* all done */
+
+		item = &CkptBufferIds[ts->index];
+		bufHdr = &BufferDescriptors[item->buf_id];
+
+		ts->index++;
+		ts->num_scanned++;
+		ts->progress += ts->progress_slice;
+		num_processed++;
 
 		/*
 		 * We don't need to acquire the lock here, because we're only looking
@@ -1239,39 +1957,43 @@ BufferSync(int flags)
 		 */
 		if (bufHdr->flags & BM_CHECKPOINT_NEEDED)
 		{
-			if (SyncOneBuffer(buf_id, false) & BUF_WRITTEN)
+			int			nneighbours;
+
+			/*
+			 * SyncOneBuffer also writes out the following blocks of the
+			 * relation, if they need to be written for this checkpoint too.
+			 * Those are usually the next entries of the sorted array, which
+			 * we'll then find already clean.
+			 */
+			if (SyncOneBuffer(item->buf_id, false, &nneighbours) & BUF_WRITTEN)
 			{
-				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				BgWriterStats.m_buf_written_checkpoints++;
-				num_written++;
+				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(item->buf_id);
+				BgWriterStats.m_buf_written_checkpoints += 1 + nneighbours;
+				num_written += 1 + nneighbours;
 
-				/*
-				 * We know there are at most num_to_write buffers with
-				 * BM_CHECKPOINT_NEEDED set; so we can stop scanning if
-				 * num_written reaches num_to_write.
-				 *
-				 * Note that num_written doesn't include buffers written by
-				 * other backends, or by the bgwriter cleaning scan. That
-				 * means that the estimate of how much progress we've made is
-				 * conservative, and also that this test will often fail to
-				 * trigger.  But it seems worth making anyway.
-				 */
-				if (num_written >= num_to_write)
-					break;
+				ScheduleCheckpointWriteback(&item->tag, 1 + nneighbours);
 
 				/*
-				 * Perform normal bgwriter duties and sleep to throttle our
-				 * I/O rate.
+				 * Absorb fsync requests and sleep to throttle our
+				 * I/O rate.  (It calls CompleteBufferWrites before sleeping.)
+				 *
+				 * Progress is measured by the buffers we've processed, which
+				 * includes those that other processes wrote for us; that
+				 * makes the estimate a bit optimistic, unlike counting only
+				 * our own writes, which would keep us behind schedule.
 				 */
 				CheckpointWriteDelay(flags,
-									 (double) num_written / num_to_write);
+									 (double) num_processed / num_to_write);
 			}
 		}
-
-		if (++buf_id >= NBuffers)
-			buf_id = 0;
 	}
 
+	pfree(spaces);
+
+	/* Wait for the writes still in progress, and start their writeback */
+	CompleteBufferWrites();
+	IssuePendingWritebacks();
+
 	/*
 	 * Update checkpoint statistics. As noted above, this doesn't include
 	 * buffers written by other backends or bgwriter scan.
@@ -1281,6 +2003,105 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_write);
 }
 
+/*
+ * buffertag_comparator -- qsort comparator for CkptSortItems and
+ * PendingWritebacks, both of which start with a BufferTag
+ *
+ * Orders by tablespace, database, relation, fork and block number, which is
+ * the order of the blocks on disk as far as we can tell.
+ */
+static int
+buffertag_comparator(const void *a, const void *b)
+{
+	const BufferTag *ta = (const BufferTag *) a;
+	const BufferTag *tb = (const BufferTag *) b;
+
+	if (ta->rnode.spcNode != tb->rnode.spcNode)
+		return (ta->rnode.spcNode < tb->rnode.spcNode) ? -1 : 1;
+	if (ta->rnode.dbNode != tb->rnode.dbNode)
+		return (ta->rnode.dbNode < tb->rnode.dbNode) ? -1 : 1;
+	if (ta->rnode.relNode != tb->rnode.relNode)
+		return (ta->rnode.relNode < tb->rnode.relNode) ? -1 : 1;
+	if (ta->forkNum != tb->forkNum)
+		return (ta->forkNum < tb->forkNum) ? -1 : 1;
+	if (ta->blockNum != tb->blockNum)
+		return (ta->blockNum < tb->blockNum) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * ScheduleCheckpointWriteback -- remember blocks written by the checkpoint
+ *
+ * Records that the nblocks blocks starting at *tag have been written (or at
+ * least that their writes have been started).  Once checkpoint_flush_after
+ * blocks have accumulated, the kernel is asked to write them back.
+ */
+static void
+ScheduleCheckpointWriteback(BufferTag *tag, int nblocks)
+{
+	PendingWriteback *pending;
+
+	if (checkpoint_flush_after <= 0)
+		return;
+
+	Assert(NumPendingWritebacks < WRITEBACK_MAX_PENDING_FLUSHES);
+	pending = &PendingWritebacks[NumPendingWritebacks++];
+	pending->tag = *tag;
+	pending->nblocks = nblocks;
+	NumPendingWritebackBlocks += nblocks;
+
+	if (NumPendingWritebackBlocks >= checkpoint_flush_after)
+		IssuePendingWritebacks();
+}
+
+/*
+ * IssuePendingWritebacks -- start writeback of the blocks remembered by
+ * ScheduleCheckpointWriteback
+ *
+ * Adjacent ranges are merged, so that the kernel sees as few and as large
+ * requests as possible.
+ */
+static void
+IssuePendingWritebacks(void)
+{
+	int			i;
+
+	if (NumPendingWritebacks == 0)
+		return;
+
+	/* The writes must have reached the kernel first */
+	CompleteBufferWrites();
+
+	qsort(PendingWritebacks, NumPendingWritebacks, sizeof(PendingWriteback),
+		  buffertag_comparator);
+
+	i = 0;
+	while (i < NumPendingWritebacks)
+	{
+		BufferTag	tag = PendingWritebacks[i].tag;
+		BlockNumber nblocks = PendingWritebacks[i].nblocks;
+
+		/* absorb following ranges that overlap or continue this one */
+		for (i++; i < NumPendingWritebacks; i++)
+		{
+			PendingWriteback *next = &PendingWritebacks[i];
+
+			if (!RelFileNodeEquals(next->tag.rnode, tag.rnode) ||
+				next->tag.forkNum != tag.forkNum ||
+				next->tag.blockNum > tag.blockNum + nblocks)
+				break;
+			nblocks = Max(nblocks,
+						  next->tag.blockNum + next->nblocks - tag.blockNum);
+		}
+
+		smgrwriteback(smgropen(tag.rnode, InvalidBackendId), tag.forkNum,
+					  tag.blockNum, nblocks);
+	}
+
+	NumPendingWritebacks = 0;
+	NumPendingWritebackBlocks = 0;
+}
+
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
  *
@@ -1487,9 +2308,6 @@ BgBufferSync(void)
 	 * requirements, or hit the bgwriter_lru_maxpages limit.
 	 */
 
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
-
 	num_to_scan = bufs_to_lap;
 	num_written = 0;
 	reusable_buffers = reusable_buffers_est;
@@ -1497,7 +2315,7 @@ BgBufferSync(void)
 	/* Execute the LRU scan */
 	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
 	{
-		int			buffer_state = SyncOneBuffer(next_to_clean, true);
+		int			buffer_state = SyncOneBuffer(next_to_clean, true, NULL);
 
 		if (++next_to_clean >= NBuffers)
 		{
@@ -1519,6 +2337,9 @@ BgBufferSync(void)
 			reusable_buffers++;
 	}
 
+	/* Wait for the writes still in progress */
+	CompleteBufferWrites();
+
 	BgWriterStats.m_buf_written_clean += num_written;
 
 #ifdef BGW_DEBUG
@@ -1567,13 +2388,28 @@ BgBufferSync(void)
  * (BUF_WRITTEN could be set in error if FlushBuffers finds the buffer clean
  * after locking it, but we don't care all that much.)
  *
- * Note: caller must have done ResourceOwnerEnlargeBuffers.
+ * The write is only started here; the buffer stays pinned and share-locked
+ * until the caller calls CompleteBufferWrites, which it must do before
+ * doing anything else that might block.  That way many writes can be in
+ * progress at once when asynchronous I/O is in use.
+ *
+ * If nneighbours isn't NULL, the following blocks of the relation that are
+ * in the buffer pool and still need to be written for the checkpoint are
+ * written out with the same request, and *nneighbours is set to how many
+ * there were.
  */
 static int
-SyncOneBuffer(int buf_id, bool skip_recently_used)
+SyncOneBuffer(int buf_id, bool skip_recently_used, int *nneighbours)
 {
 	volatile BufferDesc *bufHdr = &BufferDescriptors[buf_id];
 	int			result = 0;
+	BufferIOState ioState;
+
+	if (nneighbours)
+		*nneighbours = 0;
+
+	/* Make sure we can handle the pin */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
 
 	/*
 	 * Check whether buffer needs writing.
@@ -1603,20 +2439,197 @@ SyncOneBuffer(int buf_id, bool skip_recently_used)
 	}
 
 	/*
-	 * Pin it, share-lock it, write it.  (FlushBuffer will do nothing if the
-	 * buffer is clean by the time we've locked it.)
+	 * Pin it, share-lock it, write it.  (There's nothing to do if the buffer
+	 * is clean by the time we've locked it.)
+	 *
+	 * We must not sleep on a lock while we have writes in progress, since
+	 * whoever holds it might be waiting for one of our buffers; so if the
+	 * content lock or the I/O isn't immediately available, finish our
+	 * pending writes first.
 	 */
 	PinBuffer_Locked(bufHdr);
-	LWLockAcquire(bufHdr->content_lock, LW_SHARED);
+	if (!LWLockConditionalAcquire(bufHdr->content_lock, LW_SHARED))
+	{
+		CompleteBufferWrites();
+		LWLockAcquire(bufHdr->content_lock, LW_SHARED);
+	}
+
+	ioState = StartBufferIOExtended(bufHdr, false, true);
+	if (ioState == BUFFER_IO_BUSY)
+	{
+		CompleteBufferWrites();
+		ioState = StartBufferIOExtended(bufHdr, false, false);
+	}
+
+	if (ioState == BUFFER_IO_STARTED)
+	{
+		SMgrRelation reln = smgropen(bufHdr->tag.rnode, InvalidBackendId);
+		volatile BufferDesc *run[PG_IOV_MAX];
+		int			nrun = 1;
+		int			nstarted = 0;
+
+		run[0] = bufHdr;
+		if (nneighbours)
+		{
+			*nneighbours = GetDirtyNeighbours(bufHdr, &run[1],
+								Min(PG_IOV_MAX,
+									MAX_IO_IN_PROGRESS - NumPendingWrites) - 1);
+			nrun += *nneighbours;
+		}
+
+		while (nstarted < nrun)
+		{
+			AioHandle	handle;
+			int			n;
+			int			i;
 
-	FlushBuffer(bufHdr, NULL);
+			n = FlushBufferRunStart(&run[nstarted], nrun - nstarted, reln,
+									&handle);
+			for (i = 0; i < n; i++)
+			{
+				PendingWrites[NumPendingWrites + i].buf = run[nstarted + i];
+				PendingWrites[NumPendingWrites + i].nbufs = (i == 0) ? n : 0;
+				PendingWrites[NumPendingWrites + i].handle =
+					(i == 0) ? handle : InvalidAioHandle;
+			}
+			NumPendingWrites += n;
+			nstarted += n;
+		}
 
-	LWLockRelease(bufHdr->content_lock);
-	UnpinBuffer(bufHdr, true);
+		/*
+		 * Without asynchronous I/O the write is already done, so don't hold
+		 * on to the locks.
+		 */
+		if (NumPendingWrites >= MAX_IO_IN_PROGRESS ||
+			NumPendingWrites >= aio_queue_depth ||
+			!AioAvailable())
+			CompleteBufferWrites();
+	}
+	else
+	{
+		LWLockRelease(bufHdr->content_lock);
+		UnpinBuffer(bufHdr, true);
+	}
 
 	return result | BUF_WRITTEN;
 }
 
+/*
+ * CompleteBufferWrites -- wait for the writes started by SyncOneBuffer
+ *
+ * This releases the buffers' content locks and pins.
+ */
+void
+CompleteBufferWrites(void)
+{
+	int			i;
+	int			j;
+
+	AioSubmit();
+
+	for (i = 0; i < NumPendingWrites; i += PendingWrites[i].nbufs)
+	{
+		volatile BufferDesc *run[PG_IOV_MAX];
+		int			nbufs = PendingWrites[i].nbufs;
+
+		Assert(nbufs > 0);
+		run[0] = PendingWrites[i].buf;
+		for (j = 1; j < nbufs; j++)
+			run[j] = PendingWrites[i + j].buf;
+
+		FlushBufferRunComplete(run, nbufs,
+							   smgropen(run[0]->tag.rnode, InvalidBackendId),
+							   PendingWrites[i].handle);
+
+		for (j = 0; j < nbufs; j++)
+		{
+			LWLockRelease(run[j]->content_lock);
+			UnpinBuffer(run[j], true);
+		}
+	}
+	NumPendingWrites = 0;
+}
+
+/*
+ * GetDirtyNeighbours -- find buffers to write out along with a buffer
+ *
+ * Looks for the blocks following buf's block in the buffer pool, and
+ * collects those that need to be written for the checkpoint, up to
+ * maxNeighbours of them, stopping at the first one that doesn't.  Like buf
+ * itself, each one collected is pinned, share-locked, and has its output
+ * I/O started.  As we have I/O in progress, we don't wait for any lock:
+ * a buffer we can't lock right away just ends the run.
+ *
+ * Returns the number of buffers stored into neighbours[].
+ */
+static int
+GetDirtyNeighbours(volatile BufferDesc *buf,
+				   volatile BufferDesc **neighbours, int maxNeighbours)
+{
+	BufferTag	tag;
+	int			n = 0;
+
+	/* We have the I/O in progress, so the tag can't change under us */
+	tag = buf->tag;
+
+	while (n < maxNeighbours)
+	{
+		uint32		hash;
+		LWLockId	partitionLock;
+		int			buf_id;
+		volatile BufferDesc *nbuf;
+
+		if (tag.blockNum + 1 == InvalidBlockNumber)
+			break;
+		tag.blockNum++;
+
+		/* Make sure we can handle the pin */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+		/*
+		 * Pin the buffer while holding the mapping lock, so that it can't be
+		 * replaced by another page in the meantime.
+		 */
+		hash = BufTableHashCode(&tag);
+		partitionLock = BufMappingPartitionLock(hash);
+		LWLockAcquire(partitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&tag, hash);
+		if (buf_id < 0)
+		{
+			LWLockRelease(partitionLock);
+			break;
+		}
+		nbuf = &BufferDescriptors[buf_id];
+
+		LockBufHdr(nbuf);
+		if ((nbuf->flags & (BM_VALID | BM_DIRTY | BM_CHECKPOINT_NEEDED)) !=
+			(BM_VALID | BM_DIRTY | BM_CHECKPOINT_NEEDED))
+		{
+			UnlockBufHdr(nbuf);
+			LWLockRelease(partitionLock);
+			break;
+		}
+		PinBuffer_Locked(nbuf);
+		LWLockRelease(partitionLock);
+
+		if (!LWLockConditionalAcquire(nbuf->content_lock, LW_SHARED))
+		{
+			UnpinBuffer(nbuf, true);
+			break;
+		}
+		if (StartBufferIOExtended(nbuf, false, true) != BUFFER_IO_STARTED)
+		{
+			LWLockRelease(nbuf->content_lock);
+			UnpinBuffer(nbuf, true);
+			break;
+		}
+
+		neighbours[n++] = nbuf;
+	}
+
+	return n;
+}
+
 
 /*
  *		AtEOXact_Buffers - clean up at end of transaction.
@@ -1827,8 +2840,7 @@ BufferGetTag(Buffer buffer, RelFileNode *rnode, ForkNumber *forknum,
 static void
 FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln)
 {
-	XLogRecPtr	recptr;
-	ErrorContextCallback errcontext;
+	AioHandle	handle;
 
 	/*
 	 * Acquire the buffer's io_in_progress lock.  If StartBufferIO returns
@@ -1838,60 +2850,132 @@ FlushBuffer(volatile BufferDesc *buf, SMgrRelation reln)
 	if (!StartBufferIO(buf, false))
 		return;
 
-	/* Setup error traceback support for ereport() */
-	errcontext.callback = shared_buffer_write_error_callback;
-	errcontext.arg = (void *) buf;
-	errcontext.previous = error_context_stack;
-	error_context_stack = &errcontext;
-
 	/* Find smgr relation for buffer */
 	if (reln == NULL)
 		reln = smgropen(buf->tag.rnode, InvalidBackendId);
 
-	TRACE_POSTGRESQL_BUFFER_FLUSH_START(buf->tag.forkNum,
-										buf->tag.blockNum,
-										reln->smgr_rnode.node.spcNode,
-										reln->smgr_rnode.node.dbNode,
-										reln->smgr_rnode.node.relNode);
+	(void) FlushBufferRunStart(&buf, 1, reln, &handle);
+	FlushBufferRunComplete(&buf, 1, reln, handle);
+}
+
+/*
+ * FlushBufferRunStart -- start writing out a run of buffers
+ *
+ * The buffers must hold adjacent blocks of one relation fork, in order.
+ * The caller must have done StartBufferIO on each, and must hold a pin and
+ * share lock on them until the write has been finished with
+ * FlushBufferRunComplete.
+ *
+ * A single request may not cover the whole run (see smgrstartwritev), so
+ * this returns the number of buffers covered, and *handle is set to the
+ * handle for them.  The caller must start another request for the rest.
+ */
+static int
+FlushBufferRunStart(volatile BufferDesc **bufs, int nbufs, SMgrRelation reln,
+					AioHandle *handle)
+{
+	XLogRecPtr	recptr;
+	ErrorContextCallback errcontext;
+	char	   *blocks[PG_IOV_MAX];
+	int			nstarted;
+	int			i;
+
+	Assert(nbufs > 0 && nbufs <= PG_IOV_MAX);
+
+	/* Setup error traceback support for ereport() */
+	errcontext.callback = shared_buffer_write_error_callback;
+	errcontext.arg = (void *) bufs[0];
+	errcontext.previous = error_context_stack;
+	error_context_stack = &errcontext;
 
 	/*
-	 * Force XLOG flush up to buffer's LSN.  This implements the basic WAL
-	 * rule that log updates must hit disk before any of the data-file changes
-	 * they describe do.
+	 * Force XLOG flush up to the buffers' highest LSN.  This implements the
+	 * basic WAL rule that log updates must hit disk before any of the
+	 * data-file changes they describe do.
 	 */
-	recptr = BufferGetLSN(buf);
+	recptr = BufferGetLSN(bufs[0]);
+	for (i = 0; i < nbufs; i++)
+	{
+		TRACE_POSTGRESQL_BUFFER_FLUSH_START(bufs[i]->tag.forkNum,
+											bufs[i]->tag.blockNum,
+											reln->smgr_rnode.node.spcNode,
+											reln->smgr_rnode.node.dbNode,
+											reln->smgr_rnode.node.relNode);
+
+		if (XLByteLT(recptr, BufferGetLSN(bufs[i])))
+			recptr = BufferGetLSN(bufs[i]);
+	}
 	XLogFlush(recptr);
 
 	/*
-	 * Now it's safe to write buffer to disk. Note that no one else should
-	 * have been able to write it while we were busy with log flushing because
-	 * we have the io_in_progress lock.
+	 * Now it's safe to write the buffers to disk. Note that no one else
+	 * should have been able to write them while we were busy with log
+	 * flushing because we have the io_in_progress locks.
 	 */
 
-	/* To check if block content changes while flushing. - vadim 01/17/97 */
-	LockBufHdr(buf);
-	buf->flags &= ~BM_JUST_DIRTIED;
-	UnlockBufHdr(buf);
+	for (i = 0; i < nbufs; i++)
+	{
+		Assert(i == 0 || bufs[i]->tag.blockNum == bufs[i - 1]->tag.blockNum + 1);
 
-	smgrwrite(reln,
-			  buf->tag.forkNum,
-			  buf->tag.blockNum,
-			  (char *) BufHdrGetBlock(buf),
-			  false);
+		/* To check if block content changes while flushing. - vadim 01/17/97 */
+		LockBufHdr(bufs[i]);
+		bufs[i]->flags &= ~BM_JUST_DIRTIED;
+		UnlockBufHdr(bufs[i]);
 
-	pgBufferUsage.shared_blks_written++;
+		blocks[i] = (char *) BufHdrGetBlock(bufs[i]);
+	}
 
-	/*
-	 * Mark the buffer as clean (unless BM_JUST_DIRTIED has become set) and
-	 * end the io_in_progress state.
-	 */
-	TerminateBufferIO(buf, true, 0);
+	nstarted = smgrstartwritev(reln,
+							   bufs[0]->tag.forkNum,
+							   bufs[0]->tag.blockNum,
+							   blocks,
+							   nbufs,
+							   false,
+							   handle);
 
-	TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(buf->tag.forkNum,
-									   buf->tag.blockNum,
-									   reln->smgr_rnode.node.spcNode,
-									   reln->smgr_rnode.node.dbNode,
-									   reln->smgr_rnode.node.relNode);
+	pgBufferUsage.shared_blks_written += nstarted;
+
+	/* Pop the error context stack */
+	error_context_stack = errcontext.previous;
+
+	return nstarted;
+}
+
+/*
+ * FlushBufferRunComplete -- finish a write started by FlushBufferRunStart
+ *
+ * nbufs is the number of buffers FlushBufferRunStart returned.
+ */
+static void
+FlushBufferRunComplete(volatile BufferDesc **bufs, int nbufs,
+					   SMgrRelation reln, AioHandle handle)
+{
+	ErrorContextCallback errcontext;
+	int			i;
+
+	/* Setup error traceback support for ereport() */
+	errcontext.callback = shared_buffer_write_error_callback;
+	errcontext.arg = (void *) bufs[0];
+	errcontext.previous = error_context_stack;
+	error_context_stack = &errcontext;
+
+	smgrcompletewritev(reln, bufs[0]->tag.forkNum, bufs[0]->tag.blockNum,
+					   nbufs, false, handle);
+
+	for (i = 0; i < nbufs; i++)
+	{
+		/*
+		 * Mark the buffer as clean (unless BM_JUST_DIRTIED has become set)
+		 * and end the io_in_progress state.
+		 */
+		TerminateBufferIO(bufs[i], true, 0);
+
+		TRACE_POSTGRESQL_BUFFER_FLUSH_DONE(bufs[i]->tag.forkNum,
+										   bufs[i]->tag.blockNum,
+										   reln->smgr_rnode.node.spcNode,
+										   reln->smgr_rnode.node.dbNode,
+										   reln->smgr_rnode.node.relNode);
+	}
 
 	/* Pop the error context stack */
 	error_context_stack = errcontext.previous;
@@ -2521,8 +3605,11 @@ ConditionalLockBufferForCleanup(Buffer buffer)
 /*
  *	Functions for buffer I/O handling
  *
- *	Note: We assume that nested buffer I/O never occurs.
- *	i.e at most one io_in_progress lock is held per proc.
+ *	Note: a process can have I/O in progress on up to MAX_IO_IN_PROGRESS
+ *	buffers at once, holding all of their io_in_progress locks.  While it
+ *	has any, it must not wait for another buffer's I/O, since the process
+ *	doing that might be waiting for one of ours; it uses the nowait mode
+ *	of StartBufferIOExtended instead.
  *
  *	Also note that these are used only for shared buffers, not local ones.
  */
@@ -2580,7 +3667,21 @@ WaitIO(volatile BufferDesc *buf)
 static bool
 StartBufferIO(volatile BufferDesc *buf, bool forInput)
 {
-	Assert(!InProgressBuf);
+	return StartBufferIOExtended(buf, forInput, false) == BUFFER_IO_STARTED;
+}
+
+/*
+ * StartBufferIOExtended: StartBufferIO with the option not to wait
+ *
+ * With nowait, we return BUFFER_IO_BUSY instead of blocking if someone else
+ * has I/O in progress on the buffer.  This is the only mode allowed while
+ * we have I/O in progress on other buffers.
+ */
+static BufferIOState
+StartBufferIOExtended(volatile BufferDesc *buf, bool forInput, bool nowait)
+{
+	Assert(NumInProgressBufs < MAX_IO_IN_PROGRESS);
+	Assert(nowait || NumInProgressBufs == 0);
 
 	for (;;)
 	{
@@ -2588,7 +3689,14 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 		 * Grab the io_in_progress lock so that other processes can wait for
 		 * me to finish the I/O.
 		 */
-		LWLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
+		if (nowait)
+		{
+			if (!LWLockConditionalAcquire(buf->io_in_progress_lock,
+										  LW_EXCLUSIVE))
+				return BUFFER_IO_BUSY;
+		}
+		else
+			LWLockAcquire(buf->io_in_progress_lock, LW_EXCLUSIVE);
 
 		LockBufHdr(buf);
 
@@ -2603,6 +3711,8 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 		 */
 		UnlockBufHdr(buf);
 		LWLockRelease(buf->io_in_progress_lock);
+		if (nowait)
+			return BUFFER_IO_BUSY;
 		WaitIO(buf);
 	}
 
@@ -2613,17 +3723,18 @@ StartBufferIO(volatile BufferDesc *buf, bool forInput)
 		/* someone else already did the I/O */
 		UnlockBufHdr(buf);
 		LWLockRelease(buf->io_in_progress_lock);
-		return false;
+		return BUFFER_IO_DONE;
 	}
 
 	buf->flags |= BM_IO_IN_PROGRESS;
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = buf;
-	IsForInput = forInput;
+	InProgressBufs[NumInProgressBufs] = buf;
+	InProgressForInput[NumInProgressBufs] = forInput;
+	NumInProgressBufs++;
 
-	return true;
+	return BUFFER_IO_STARTED;
 }
 
 /*
@@ -2647,7 +3758,18 @@ static void
 TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 				  int set_flag_bits)
 {
-	Assert(buf == InProgressBuf);
+	int			i;
+
+	/* forget it, keeping the array dense */
+	for (i = 0; i < NumInProgressBufs; i++)
+	{
+		if (InProgressBufs[i] == buf)
+			break;
+	}
+	Assert(i < NumInProgressBufs);
+	NumInProgressBufs--;
+	InProgressBufs[i] = InProgressBufs[NumInProgressBufs];
+	InProgressForInput[i] = InProgressForInput[NumInProgressBufs];
 
 	LockBufHdr(buf);
 
@@ -2659,8 +3781,6 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
 
 	UnlockBufHdr(buf);
 
-	InProgressBuf = NULL;
-
 	LWLockRelease(buf->io_in_progress_lock);
 }
 
@@ -2672,14 +3792,23 @@ TerminateBufferIO(volatile BufferDesc *buf, bool clear_dirty,
  *
  *	If I/O was in progress, we always set BM_IO_ERROR, even though it's
  *	possible the error condition wasn't related to the I/O.
+ *
+ *	Asynchronous requests may still be reading into or writing from the
+ *	buffers, so we first wait for all of them to finish.
  */
 void
 AbortBufferIO(void)
 {
-	volatile BufferDesc *buf = InProgressBuf;
+	AtAbort_Aio();
 
-	if (buf)
+	/* the content locks and pins of pending writes are released elsewhere */
+	NumPendingWrites = 0;
+
+	while (NumInProgressBufs > 0)
 	{
+		volatile BufferDesc *buf = InProgressBufs[NumInProgressBufs - 1];
+		bool		isForInput = InProgressForInput[NumInProgressBufs - 1];
+
 		/*
 		 * Since LWLockReleaseAll has already been called, we're not holding
 		 * the buffer's io_in_progress_lock. We have to re-acquire it so that
@@ -2690,7 +3819,7 @@ AbortBufferIO(void)
 
 		LockBufHdr(buf);
 		Assert(buf->flags & BM_IO_IN_PROGRESS);
-		if (IsForInput)
+		if (isForInput)
 		{
 			Assert(!(buf->flags & BM_DIRTY));
 			/* We'd better not think buffer is valid yet */
@@ -428,10 +428,14 @@ GetLocalBufferStorage(void)
 		/* But not more than what we need for all remaining local bufs */
 		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
 		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
+		num_bufs = Min(num_bufs,
+					   (MaxAllocSize - ALIGNOF_DIRECT_IO_BUFFER) / BLCKSZ);
 
+		/* Align the buffers so that they can be used for direct I/O */
 		cur_block = (char *) MemoryContextAlloc(LocalBufferContext,
-												num_bufs * BLCKSZ);
+												num_bufs * BLCKSZ +
+												ALIGNOF_DIRECT_IO_BUFFER);
+		cur_block = (char *) TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER, cur_block);
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
@@ -0,0 +1,602 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Asynchronous block I/O.
+ *
+ * This module lets callers start reads and writes of file ranges and
+ * collect the results later, so that many requests can be in progress at
+ * once.  With io_method = io_uring, requests are put on a per-process
+ * io_uring submission queue, handed to the kernel in batches by AioSubmit,
+ * and picked up from the completion queue when somebody waits for them.
+ * With io_method = sync, or if the kernel turns out not to support
+ * io_uring, fd.c instead does each request synchronously when it is
+ * started and records the result with AioCompleted; callers don't need to
+ * know which happened.  (A backend can't use threads, so a pool of I/O
+ * worker threads is not an option for the fallback.)
+ *
+ * A request transfers one contiguous range of the file, but may scatter it
+ * to (or gather it from) up to PG_IOV_MAX separate buffers, like preadv()
+ * and pwritev().
+ *
+ * A request is identified by an AioHandle, which stays allocated until
+ * the caller collects the result with AioWait.  At most aio_queue_depth
+ * requests are given to the kernel at a time; starting another one first
+ * waits for one of those to complete.
+ *
+ * The memory of a request must not be reused until the request has been
+ * waited for.  After an error, AtAbort_Aio waits for everything that is
+ * still in progress before the caller's buffers can be released.
+ *
+ * Callers must also call AioSubmit before closing a file descriptor that
+ * queued requests refer to; the kernel takes its own reference to the file
+ * when the request is submitted, so closing it after that is harmless.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+#ifdef USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "storage/aio.h"
+#include "utils/memutils.h"
+
+
+/* GUC variables */
+int			io_method = DEFAULT_IO_METHOD;
+int			aio_queue_depth = 32;
+
+typedef enum AioSlotState
+{
+	AIO_SLOT_FREE,				/* not in use */
+	AIO_SLOT_PENDING,			/* queued or submitted, not yet complete */
+	AIO_SLOT_DONE				/* complete, result not yet collected */
+} AioSlotState;
+
+typedef struct AioSlot
+{
+	AioSlotState state;
+	bool		isWrite;
+	int			fd;
+	struct iovec *iov;			/* PG_IOV_MAX entries, allocated on first use */
+	int			iovcnt;
+	off_t		offset;
+	int			result;			/* bytes transferred, or -1 on error */
+	int			err;			/* errno, if result is -1 */
+} AioSlot;
+
+/*
+ * Array of request slots, indexed by AioHandle; enlarged as needed.  The
+ * kernel may look at a request's iovecs when it's submitted, after the
+ * array has been moved, so they are allocated separately.
+ */
+static AioSlot *AioSlots = NULL;
+static int	NumAioSlots = 0;
+
+static AioHandle AioGetSlot(void);
+
+#ifdef USE_IO_URING
+
+typedef enum RingState
+{
+	RING_UNINITIALIZED,
+	RING_READY,
+	RING_FAILED					/* setup failed, use synchronous I/O */
+} RingState;
+
+static RingState ringState = RING_UNINITIALIZED;
+static int	ringFd = -1;
+
+/* submission queue, as mapped from the kernel */
+static unsigned *sqTail;
+static unsigned sqMask;
+static unsigned *sqArray;
+static struct io_uring_sqe *sqes;
+
+/* completion queue */
+static unsigned *cqHead;
+static unsigned *cqTail;
+static unsigned cqMask;
+static struct io_uring_cqe *cqes;
+
+static int	numQueued = 0;		/* requests in the SQ, not yet submitted */
+static int	numInFlight = 0;	/* queued or submitted, not yet complete */
+
+static void AioSetupRing(void);
+static AioHandle AioStart(bool isWrite, int fd, const struct iovec *iov,
+		 int iovcnt, off_t offset);
+static void AioQueue(AioHandle handle);
+static void AioSubmitInternal(int elevel);
+static void AioReap(bool wait, int elevel);
+
+/*
+ * The ring indexes are shared with the kernel.  Entries must be filled in
+ * before we advance the index that hands them over, and must not be looked
+ * at before we have read the index the kernel advanced.
+ */
+static unsigned
+ring_load(unsigned *p)
+{
+	unsigned	val = *((volatile unsigned *) p);
+
+	__sync_synchronize();
+	return val;
+}
+
+static void
+ring_store(unsigned *p, unsigned val)
+{
+	__sync_synchronize();
+	*((volatile unsigned *) p) = val;
+}
+
+/*
+ * Set up this process's io_uring.  On failure, log the reason and fall
+ * back to synchronous I/O for the rest of the process's life.
+ */
+static void
+AioSetupRing(void)
+{
+	struct io_uring_params p;
+	size_t		sqSize;
+	size_t		cqSize;
+	size_t		sqesSize;
+	char	   *sq;
+	char	   *cq;
+	void	   *sqesMap;
+
+	Assert(ringState == RING_UNINITIALIZED);
+	ringState = RING_FAILED;	/* until we get through all of this */
+
+	memset(&p, 0, sizeof(p));
+	ringFd = syscall(__NR_io_uring_setup, aio_queue_depth, &p);
+	if (ringFd < 0)
+	{
+		ereport(LOG,
+				(errmsg("could not set up io_uring, using synchronous I/O instead: %m")));
+		return;
+	}
+
+	/* IORING_OP_READ and IORING_OP_WRITE arrived together with this flag */
+	if (!(p.features & IORING_FEAT_RW_CUR_POS))
+	{
+		close(ringFd);
+		ereport(LOG,
+				(errmsg("kernel io_uring support is too old, using synchronous I/O instead")));
+		return;
+	}
+
+	sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sqSize = cqSize = Max(sqSize, cqSize);
+	sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  ringFd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto fail;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq = sq;
+	else
+	{
+		cq = mmap(NULL, cqSize, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+		{
+			munmap(sq, sqSize);
+			goto fail;
+		}
+	}
+
+	sqesMap = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (sqesMap == MAP_FAILED)
+	{
+		if (cq != sq)
+			munmap(cq, cqSize);
+		munmap(sq, sqSize);
+		goto fail;
+	}
+
+	sqTail = (unsigned *) (sq + p.sq_off.tail);
+	sqMask = *(unsigned *) (sq + p.sq_off.ring_mask);
+	sqArray = (unsigned *) (sq + p.sq_off.array);
+	sqes = (struct io_uring_sqe *) sqesMap;
+
+	cqHead = (unsigned *) (cq + p.cq_off.head);
+	cqTail = (unsigned *) (cq + p.cq_off.tail);
+	cqMask = *(unsigned *) (cq + p.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+	ringState = RING_READY;
+	return;
+
+fail:
+	ereport(LOG,
+			(errmsg("could not map io_uring queues, using synchronous I/O instead: %m")));
+	close(ringFd);
+	ringFd = -1;
+}
+
+/*
+ * Start a request.  The caller has checked that AioAvailable().
+ */
+static AioHandle
+AioStart(bool isWrite, int fd, const struct iovec *iov, int iovcnt,
+		 off_t offset)
+{
+	AioHandle	handle;
+	AioSlot    *slot;
+
+	Assert(ringState == RING_READY);
+	Assert(iovcnt >= 1 && iovcnt <= PG_IOV_MAX);
+
+	/* Don't give the kernel more than aio_queue_depth requests at once */
+	while (numInFlight >= aio_queue_depth)
+	{
+		AioSubmitInternal(ERROR);
+		AioReap(true, ERROR);
+	}
+
+	handle = AioGetSlot();
+	slot = &AioSlots[handle];
+	slot->state = AIO_SLOT_PENDING;
+	slot->isWrite = isWrite;
+	slot->fd = fd;
+	if (slot->iov == NULL)
+		slot->iov = (struct iovec *)
+			MemoryContextAlloc(TopMemoryContext,
+							   PG_IOV_MAX * sizeof(struct iovec));
+	memcpy(slot->iov, iov, iovcnt * sizeof(struct iovec));
+	slot->iovcnt = iovcnt;
+	slot->offset = offset;
+	numInFlight++;
+
+	AioQueue(handle);
+
+	return handle;
+}
+
+/*
+ * Put a pending request on the submission queue.
+ *
+ * There is always room: the queue has at least aio_queue_depth entries,
+ * and no more than that many requests are in flight.
+ */
+static void
+AioQueue(AioHandle handle)
+{
+	AioSlot    *slot = &AioSlots[handle];
+	unsigned	tail = *sqTail;
+	unsigned	index = tail & sqMask;
+	struct io_uring_sqe *sqe = &sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->fd = slot->fd;
+	sqe->off = slot->offset;
+	if (slot->iovcnt == 1)
+	{
+		sqe->opcode = slot->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+		sqe->addr = (unsigned long) slot->iov[0].iov_base;
+		sqe->len = slot->iov[0].iov_len;
+	}
+	else
+	{
+		sqe->opcode = slot->isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->addr = (unsigned long) slot->iov;
+		sqe->len = slot->iovcnt;
+	}
+	sqe->user_data = handle;
+	sqArray[index] = index;
+
+	ring_store(sqTail, tail + 1);
+	numQueued++;
+}
+
+/*
+ * Hand all queued requests to the kernel.
+ */
+static void
+AioSubmitInternal(int elevel)
+{
+	while (numQueued > 0)
+	{
+		int			ret;
+
+		ret = syscall(__NR_io_uring_enter, ringFd, numQueued, 0, 0, NULL, 0);
+		if (ret < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			/* the kernel is short of resources; make room and retry */
+			if ((errno == EAGAIN || errno == EBUSY) &&
+				numInFlight > numQueued)
+			{
+				AioReap(true, elevel);
+				continue;
+			}
+			elog(elevel, "could not submit asynchronous I/O requests: %m");
+			return;
+		}
+		numQueued -= ret;
+	}
+}
+
+/*
+ * Process the completion queue.  If 'wait' is true and nothing has
+ * completed yet, sleep until something does.  Requests that failed with a
+ * transient error are queued again.
+ *
+ * When waiting, the caller must have submitted what it is waiting for.
+ */
+static void
+AioReap(bool wait, int elevel)
+{
+	for (;;)
+	{
+		unsigned	head = *cqHead;
+		unsigned	tail = ring_load(cqTail);
+		bool		found = (head != tail);
+
+		while (head != tail)
+		{
+			struct io_uring_cqe *cqe = &cqes[head & cqMask];
+			AioHandle	handle = (AioHandle) cqe->user_data;
+			int			res = cqe->res;
+			AioSlot    *slot = &AioSlots[handle];
+
+			head++;
+
+			Assert(slot->state == AIO_SLOT_PENDING);
+			if (res == -EAGAIN || res == -EINTR)
+			{
+				AioQueue(handle);
+				continue;
+			}
+
+			if (res < 0)
+			{
+				slot->result = -1;
+				slot->err = -res;
+			}
+			else
+			{
+				slot->result = res;
+				slot->err = 0;
+			}
+			slot->state = AIO_SLOT_DONE;
+			numInFlight--;
+		}
+		ring_store(cqHead, head);
+
+		if (found || !wait)
+			break;
+
+		Assert(numInFlight > numQueued);
+		if (syscall(__NR_io_uring_enter, ringFd, 0, 1,
+					IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+			errno != EINTR)
+		{
+			elog(elevel, "could not wait for asynchronous I/O: %m");
+			return;
+		}
+	}
+}
+#endif   /* USE_IO_URING */
+
+/*
+ * Find a free request slot, enlarging the array if necessary.
+ */
+static AioHandle
+AioGetSlot(void)
+{
+	AioHandle	handle;
+
+	for (handle = 0; handle < NumAioSlots; handle++)
+	{
+		if (AioSlots[handle].state == AIO_SLOT_FREE)
+			return handle;
+	}
+
+	/* AIO_SLOT_FREE is zero, so zeroing the new part frees the slots */
+	if (AioSlots == NULL)
+	{
+		NumAioSlots = 16;
+		AioSlots = (AioSlot *)
+			MemoryContextAllocZero(TopMemoryContext,
+								   NumAioSlots * sizeof(AioSlot));
+	}
+	else
+	{
+		AioSlots = (AioSlot *) repalloc(AioSlots,
+										NumAioSlots * 2 * sizeof(AioSlot));
+		MemSet(&AioSlots[NumAioSlots], 0, NumAioSlots * sizeof(AioSlot));
+		NumAioSlots *= 2;
+	}
+
+	return handle;
+}
+
+/*
+ * Is asynchronous I/O in use in this process?
+ *
+ * If not, fd.c does requests synchronously and uses AioCompleted to make
+ * a handle for the result.
+ */
+bool
+AioAvailable(void)
+{
+#ifdef USE_IO_URING
+	if (io_method != IO_METHOD_IO_URING)
+		return false;
+	if (ringState == RING_UNINITIALIZED)
+		AioSetupRing();
+	return ringState == RING_READY;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Start reading 'amount' bytes at 'offset' of kernel file descriptor 'fd'
+ * into 'buffer'.  AioAvailable() must be true.
+ */
+AioHandle
+AioStartRead(int fd, char *buffer, int amount, off_t offset)
+{
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return AioStartReadv(fd, &iov, 1, offset);
+}
+
+/*
+ * Start writing 'amount' bytes from 'buffer' at 'offset' of kernel file
+ * descriptor 'fd'.  AioAvailable() must be true.
+ */
+AioHandle
+AioStartWrite(int fd, char *buffer, int amount, off_t offset)
+{
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return AioStartWritev(fd, &iov, 1, offset);
+}
+
+/*
+ * Start reading the file range at 'offset' of kernel file descriptor 'fd'
+ * into the 'iovcnt' buffers described by 'iov', like preadv().  The iovec
+ * array itself may be reused right away.  AioAvailable() must be true.
+ */
+AioHandle
+AioStartReadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+#ifdef USE_IO_URING
+	return AioStart(false, fd, iov, iovcnt, offset);
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	return InvalidAioHandle;	/* keep compiler quiet */
+#endif
+}
+
+/*
+ * Start writing the 'iovcnt' buffers described by 'iov' to the file range
+ * at 'offset' of kernel file descriptor 'fd', like pwritev().  See
+ * AioStartReadv.
+ */
+AioHandle
+AioStartWritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+#ifdef USE_IO_URING
+	return AioStart(true, fd, iov, iovcnt, offset);
+#else
+	elog(ERROR, "asynchronous I/O is not supported by this build");
+	return InvalidAioHandle;	/* keep compiler quiet */
+#endif
+}
+
+/*
+ * Make a handle for a request that has already been done synchronously.
+ * 'result' is the return value of the read or write call; if it is
+ * negative, errno is remembered too.
+ */
+AioHandle
+AioCompleted(int result)
+{
+	int			save_errno = errno;
+	AioHandle	handle;
+	AioSlot    *slot;
+
+	handle = AioGetSlot();
+	slot = &AioSlots[handle];
+	slot->state = AIO_SLOT_DONE;
+	slot->result = result;
+	slot->err = (result < 0) ? save_errno : 0;
+
+	return handle;
+}
+
+/*
+ * Hand all requests started so far to the kernel, without waiting for
+ * them.  Callers that start a batch of requests should call this once
+ * they are done starting them.
+ */
+void
+AioSubmit(void)
+{
+#ifdef USE_IO_URING
+	if (numQueued > 0)
+		AioSubmitInternal(ERROR);
+#endif
+}
+
+/*
+ * Wait for a request to complete, and release its handle.
+ *
+ * Returns the number of bytes transferred like read() or write() would,
+ * or -1 with errno set.
+ */
+int
+AioWait(AioHandle handle)
+{
+	AioSlot    *slot;
+	int			result;
+
+	Assert(handle >= 0 && handle < NumAioSlots);
+	Assert(AioSlots[handle].state != AIO_SLOT_FREE);
+
+#ifdef USE_IO_URING
+	while (AioSlots[handle].state == AIO_SLOT_PENDING)
+	{
+		AioSubmitInternal(ERROR);
+		AioReap(true, ERROR);
+	}
+#endif
+
+	slot = &AioSlots[handle];
+	result = slot->result;
+	slot->state = AIO_SLOT_FREE;
+
+	errno = slot->err;
+	return result;
+}
+
+/*
+ * Clean up after an error.
+ *
+ * Requests still in progress may be reading into or writing from memory
+ * that is about to be released or reused, so wait for all of them; then
+ * forget all handles.  Failing to wait is fatal for the same reason.
+ */
+void
+AtAbort_Aio(void)
+{
+	AioHandle	handle;
+
+#ifdef USE_IO_URING
+	while (numInFlight > 0)
+	{
+		AioSubmitInternal(PANIC);
+		AioReap(true, PANIC);
+	}
+#endif
+
+	for (handle = 0; handle < NumAioSlots; handle++)
+		AioSlots[handle].state = AIO_SLOT_FREE;
+}
@@ -56,6 +56,7 @@
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
+#include "utils/memutils.h"
 #include "utils/resowner.h"
 
 
@@ -91,6 +92,14 @@
  */
 int			max_files_per_process = 1000;
 
+/*
+ * Which kinds of files to open with O_DIRECT, bypassing the kernel's page
+ * cache; a combination of the DIRECT_IO_* bits.  fd.c itself only looks at
+ * the open flags of each file, the callers that open data files and WAL
+ * segments consult this.
+ */
+int			direct_io = 0;
+
 /*
  * Maximum number of file descriptors to open for either VFD entries or
  * AllocateFile/AllocateDir operations.  This is initialized to a conservative
@@ -132,6 +141,15 @@ static int	max_safe_fds = 32;	/* default if not changed */
  */
 static bool have_xact_temporary_files = false;
 
+/*
+ * Aligned buffer that requests on O_DIRECT files are copied through when the
+ * caller's buffer isn't suitably aligned; see FileNeedsBounce.  It is
+ * allocated on first use and enlarged as needed.
+ */
+static char *bounceBuffer = NULL;		/* aligned start of the buffer */
+static char *bounceBufferRaw = NULL;	/* as returned by palloc */
+static int	bounceBufferSize = 0;
+
 typedef struct vfd
 {
 	int			fd;				/* current FD, or VFD_CLOSED if none */
@@ -245,6 +263,14 @@ static File AllocateVfd(void);
 static void FreeVfd(File file);
 
 static int	FileAccess(File file);
+static int	FileReadv(File file, struct iovec *iov, int iovcnt, off_t offset);
+static int	FileWritev(File file, struct iovec *iov, int iovcnt, off_t offset);
+static bool FileNeedsBounce(File file, struct iovec *iov, int iovcnt);
+static char *GetBounceBuffer(int size);
+static int	FileReadvBounce(File file, struct iovec *iov, int iovcnt,
+				off_t offset);
+static int	FileWritevBounce(File file, struct iovec *iov, int iovcnt,
+				 off_t offset);
 static File OpenTemporaryFileInTablespace(Oid tblspcOid, bool rejectError);
 static void AtProcExit_Files(int code, Datum arg);
 static void CleanupTempFiles(bool isProcExit);
@@ -326,12 +352,17 @@ pg_fdatasync(int fd)
 /*
  * pg_flush_data --- advise OS that the data described won't be needed soon
  *
- * Not all platforms have posix_fadvise; treat as noop if not available.
+ * The point is to get the kernel to start writing the data back now, so that
+ * a later fsync has less to do.  sync_file_range() does exactly that without
+ * waiting; otherwise posix_fadvise(DONTNEED) starts writeback as a side
+ * effect on many systems.  Treat as noop if neither is available.
  */
 int
 pg_flush_data(int fd, off_t offset, off_t amount)
 {
-#if defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+#if defined(HAVE_SYNC_FILE_RANGE) && defined(SYNC_FILE_RANGE_WRITE)
+	return sync_file_range(fd, offset, amount, SYNC_FILE_RANGE_WRITE);
+#elif defined(USE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
 	return posix_fadvise(fd, offset, amount, POSIX_FADV_DONTNEED);
 #else
 	return 0;
@@ -603,6 +634,9 @@ LruDelete(File file)
 	vfdP->seekPos = lseek(vfdP->fd, (off_t) 0, SEEK_CUR);
 	Assert(vfdP->seekPos != (off_t) -1);
 
+	/* queued asynchronous requests may still refer to the kernel FD */
+	AioSubmit();
+
 	/* close the file */
 	if (close(vfdP->fd))
 		elog(ERROR, "could not close file \"%s\": %m", vfdP->fileName);
@@ -1046,6 +1080,9 @@ FileClose(File file)
 		/* remove the file from the lru ring */
 		Delete(file);
 
+		/* queued asynchronous requests may still refer to the kernel FD */
+		AioSubmit();
+
 		/* close the file */
 		if (close(vfdP->fd))
 			elog(ERROR, "could not close file \"%s\": %m", vfdP->fileName);
@@ -1110,6 +1147,13 @@ FilePrefetch(File file, off_t offset, int amount)
 			   file, VfdCache[file].fileName,
 			   (int64) offset, amount));
 
+	/*
+	 * Reads of an O_DIRECT file don't look at the page cache, so there's no
+	 * point in loading it.
+	 */
+	if (VfdCache[file].fileFlags & PG_O_DIRECT)
+		return 0;
+
 	returnCode = FileAccess(file);
 	if (returnCode < 0)
 		return returnCode;
@@ -1128,6 +1172,8 @@ int
 FileRead(File file, char *buffer, int amount)
 {
 	int			returnCode;
+	struct iovec iov;
+	char	   *readBuffer = buffer;
 
 	Assert(FileIsValid(file));
 
@@ -1140,11 +1186,20 @@ FileRead(File file, char *buffer, int amount)
 	if (returnCode < 0)
 		return returnCode;
 
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+	if (FileNeedsBounce(file, &iov, 1))
+		readBuffer = GetBounceBuffer(amount);
+
 retry:
-	returnCode = read(VfdCache[file].fd, buffer, amount);
+	returnCode = read(VfdCache[file].fd, readBuffer, amount);
 
 	if (returnCode >= 0)
+	{
 		VfdCache[file].seekPos += returnCode;
+		if (readBuffer != buffer)
+			memcpy(buffer, readBuffer, returnCode);
+	}
 	else
 	{
 		/*
@@ -1183,6 +1238,7 @@ int
 FileWrite(File file, char *buffer, int amount)
 {
 	int			returnCode;
+	struct iovec iov;
 
 	Assert(FileIsValid(file));
 
@@ -1195,6 +1251,16 @@ FileWrite(File file, char *buffer, int amount)
 	if (returnCode < 0)
 		return returnCode;
 
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+	if (FileNeedsBounce(file, &iov, 1))
+	{
+		char	   *bounce = GetBounceBuffer(amount);
+
+		memcpy(bounce, buffer, amount);
+		buffer = bounce;
+	}
+
 retry:
 	errno = 0;
 	returnCode = write(VfdCache[file].fd, buffer, amount);
@@ -1235,6 +1301,344 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileStartRead - start reading 'amount' bytes at 'offset' of the file
+ * into 'buffer'.
+ *
+ * Returns a handle to collect the result with, see AioWait.  If
+ * asynchronous I/O is not in use, the read is done right here and the
+ * handle just carries its result.  Either way, the logical seek position
+ * must not be relied on afterwards.
+ */
+AioHandle
+FileStartRead(File file, char *buffer, int amount, off_t offset)
+{
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return FileStartReadv(file, &iov, 1, offset);
+}
+
+/*
+ * FileStartWrite - start writing 'amount' bytes from 'buffer' at 'offset'
+ * of the file.  See FileStartRead.
+ *
+ * As with FileWrite, a short write that doesn't set errno is reported as
+ * ENOSPC by the synchronous path; callers should treat any short write
+ * that way.
+ */
+AioHandle
+FileStartWrite(File file, char *buffer, int amount, off_t offset)
+{
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return FileStartWritev(file, &iov, 1, offset);
+}
+
+/*
+ * FileStartReadv - start reading the range at 'offset' of the file into the
+ * 'iovcnt' (at most PG_IOV_MAX) buffers described by 'iov'
+ *
+ * This is the vectored form of FileStartRead: a run of adjacent blocks can
+ * be read into separate buffers with a single system call.  The iovec array
+ * may be reused as soon as this returns.
+ */
+AioHandle
+FileStartReadv(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt >= 1 && iovcnt <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileStartReadv: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset, iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return AioCompleted(returnCode);
+
+	/* misaligned requests on O_DIRECT files are done synchronously */
+	if (FileNeedsBounce(file, iov, iovcnt))
+		return AioCompleted(FileReadvBounce(file, iov, iovcnt, offset));
+
+	if (AioAvailable())
+		return AioStartReadv(VfdCache[file].fd, iov, iovcnt, offset);
+
+	return AioCompleted(FileReadv(file, iov, iovcnt, offset));
+}
+
+/*
+ * FileStartWritev - start writing the 'iovcnt' buffers described by 'iov'
+ * to the range at 'offset' of the file.  See FileStartReadv and
+ * FileStartWrite.
+ */
+AioHandle
+FileStartWritev(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert(iovcnt >= 1 && iovcnt <= PG_IOV_MAX);
+
+	DO_DB(elog(LOG, "FileStartWritev: %d (%s) " INT64_FORMAT " %d",
+			   file, VfdCache[file].fileName,
+			   (int64) offset, iovcnt));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return AioCompleted(returnCode);
+
+	if (FileNeedsBounce(file, iov, iovcnt))
+		return AioCompleted(FileWritevBounce(file, iov, iovcnt, offset));
+
+	if (AioAvailable())
+		return AioStartWritev(VfdCache[file].fd, iov, iovcnt, offset);
+
+	return AioCompleted(FileWritev(file, iov, iovcnt, offset));
+}
+
+/*
+ * FileReadv - synchronous scatter read, like preadv()
+ *
+ * Returns the number of bytes read, or -1 with errno set.  Where preadv()
+ * isn't available, we seek and read the buffers one at a time.
+ */
+static int
+FileReadv(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+#ifdef HAVE_PREADV
+retry:
+	returnCode = preadv(VfdCache[file].fd, iov, iovcnt, offset);
+
+	/* OK to retry if interrupted */
+	if (returnCode < 0 && errno == EINTR)
+		goto retry;
+#else
+	int			i;
+
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		return -1;
+
+	returnCode = 0;
+	for (i = 0; i < iovcnt; i++)
+	{
+		int			nbytes;
+
+		nbytes = FileRead(file, iov[i].iov_base, iov[i].iov_len);
+		if (nbytes < 0)
+			return -1;
+		returnCode += nbytes;
+		if (nbytes < (int) iov[i].iov_len)
+			break;				/* EOF */
+	}
+#endif
+
+	return returnCode;
+}
+
+/*
+ * FileWritev - synchronous gather write, like pwritev()
+ *
+ * As with FileWrite, a short write that doesn't set errno is reported as
+ * ENOSPC.
+ */
+static int
+FileWritev(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	int			returnCode;
+
+#ifdef HAVE_PWRITEV
+retry:
+	errno = 0;
+	returnCode = pwritev(VfdCache[file].fd, iov, iovcnt, offset);
+
+	/* OK to retry if interrupted */
+	if (returnCode < 0 && errno == EINTR)
+		goto retry;
+
+	/* if write didn't set errno, assume problem is no disk space */
+	if (returnCode >= 0 && errno == 0)
+	{
+		int			total = 0;
+		int			i;
+
+		for (i = 0; i < iovcnt; i++)
+			total += (int) iov[i].iov_len;
+		if (returnCode != total)
+			errno = ENOSPC;
+	}
+#else
+	int			i;
+
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		return -1;
+
+	returnCode = 0;
+	for (i = 0; i < iovcnt; i++)
+	{
+		int			nbytes;
+
+		nbytes = FileWrite(file, iov[i].iov_base, iov[i].iov_len);
+		if (nbytes < 0)
+			return -1;
+		returnCode += nbytes;
+		if (nbytes < (int) iov[i].iov_len)
+			break;				/* errno is set */
+	}
+#endif
+
+	return returnCode;
+}
+
+/*
+ * FileNeedsBounce - must a request be copied through the bounce buffer?
+ *
+ * O_DIRECT transfers data straight between the caller's buffer and the
+ * device, so the kernel rejects buffers that aren't aligned to the device's
+ * sector size.  Shared buffers, local buffers and the WAL buffers are always
+ * aligned suitably, but some bulk operations (heap rewrites, B-tree builds,
+ * ALTER TABLE SET TABLESPACE) write palloc'd pages.  Rather than teach all
+ * of those about alignment, we copy their pages through an aligned buffer.
+ */
+static bool
+FileNeedsBounce(File file, struct iovec *iov, int iovcnt)
+{
+	int			i;
+
+	if (!(VfdCache[file].fileFlags & PG_O_DIRECT))
+		return false;
+
+	for (i = 0; i < iovcnt; i++)
+	{
+		if ((intptr_t) iov[i].iov_base % ALIGNOF_DIRECT_IO_BUFFER != 0 ||
+			iov[i].iov_len % ALIGNOF_DIRECT_IO_BUFFER != 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * GetBounceBuffer - return the bounce buffer, enlarged to at least 'size'
+ * bytes if necessary
+ */
+static char *
+GetBounceBuffer(int size)
+{
+	if (size > bounceBufferSize)
+	{
+		/* forget the old buffer first, in case the allocation fails */
+		if (bounceBufferRaw)
+			pfree(bounceBufferRaw);
+		bounceBufferRaw = NULL;
+		bounceBufferSize = 0;
+
+		bounceBufferRaw = MemoryContextAlloc(TopMemoryContext,
+											 size + ALIGNOF_DIRECT_IO_BUFFER);
+		bounceBuffer = (char *) TYPEALIGN(ALIGNOF_DIRECT_IO_BUFFER,
+										  bounceBufferRaw);
+		bounceBufferSize = size;
+	}
+
+	return bounceBuffer;
+}
+
+/*
+ * FileReadvBounce - FileReadv through the bounce buffer
+ */
+static int
+FileReadvBounce(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	struct iovec bounce;
+	int			returnCode;
+	int			remaining;
+	char	   *p;
+	int			i;
+
+	bounce.iov_len = 0;
+	for (i = 0; i < iovcnt; i++)
+		bounce.iov_len += iov[i].iov_len;
+	bounce.iov_base = GetBounceBuffer(bounce.iov_len);
+
+	returnCode = FileReadv(file, &bounce, 1, offset);
+
+	/* hand out whatever was read */
+	p = bounce.iov_base;
+	remaining = returnCode;
+	for (i = 0; i < iovcnt && remaining > 0; i++)
+	{
+		int			nbytes = Min(remaining, (int) iov[i].iov_len);
+
+		memcpy(iov[i].iov_base, p, nbytes);
+		p += nbytes;
+		remaining -= nbytes;
+	}
+
+	return returnCode;
+}
+
+/*
+ * FileWritevBounce - FileWritev through the bounce buffer
+ */
+static int
+FileWritevBounce(File file, struct iovec *iov, int iovcnt, off_t offset)
+{
+	struct iovec bounce;
+	char	   *p;
+	int			i;
+
+	bounce.iov_len = 0;
+	for (i = 0; i < iovcnt; i++)
+		bounce.iov_len += iov[i].iov_len;
+	bounce.iov_base = GetBounceBuffer(bounce.iov_len);
+
+	p = bounce.iov_base;
+	for (i = 0; i < iovcnt; i++)
+	{
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+
+	return FileWritev(file, &bounce, 1, offset);
+}
+
+/*
+ * FileWriteback - ask the kernel to start writing back the given range of
+ * the file, without waiting for it
+ *
+ * Data written to an O_DIRECT file doesn't stay in the page cache, so
+ * there's nothing to do for those.
+ */
+void
+FileWriteback(File file, off_t offset, off_t amount)
+{
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileWriteback: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	if (VfdCache[file].fileFlags & PG_O_DIRECT)
+		return;
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return;
+
+	(void) pg_flush_data(VfdCache[file].fd, offset, amount);
+}
+
 int
 FileSync(File file)
 {
@@ -1350,6 +1754,63 @@ FileTruncate(File file, off_t offset)
 	return returnCode;
 }
 
+/*
+ * FileFallocate - make sure disk space is allocated for the given range of
+ * the file, extending the file if needed.  The new space reads as zeroes.
+ *
+ * This uses posix_fallocate() where available, which is much cheaper than
+ * writing out zeroes, and falls back to writing zeroes if the platform or
+ * filesystem doesn't support it.  Returns 0 on success, or -1 with errno
+ * set on failure.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount)
+{
+	static char zerobuf[BLCKSZ];
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileFallocate: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+#ifdef HAVE_POSIX_FALLOCATE
+	returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	if (returnCode == 0)
+		return 0;
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+	{
+		errno = returnCode;
+		return -1;
+	}
+	/* not supported by this filesystem, fall back to writing zeroes */
+#endif
+
+	if (FileSeek(file, offset, SEEK_SET) != offset)
+		return -1;
+	while (amount > 0)
+	{
+		int			chunk = (int) Min(amount, (off_t) BLCKSZ);
+
+		returnCode = FileWrite(file, zerobuf, chunk);
+		if (returnCode != chunk)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (returnCode >= 0)
+				errno = ENOSPC;
+			return -1;
+		}
+		amount -= chunk;
+	}
+
+	return 0;
+}
+
 /*
  * Return the pathname associated with an open file.
  *
@@ -192,6 +192,69 @@ RecordPageWithFreeSpace(Relation rel, BlockNumber heapBlk, Size spaceAvail)
 	fsm_set_and_search(rel, addr, slot, new_cat, 0);
 }
 
+/*
+ * RecordNewPagesWithFreeSpace - update info about a range of new pages.
+ *
+ * Like calling RecordPageWithFreeSpace for each of the heap blocks startBlk
+ * to endBlk - 1, which all have spaceAvail free, except that the upper
+ * levels of the tree are updated too.  That makes the pages visible to
+ * searchers right away, rather than after the next FreeSpaceMapVacuum, which
+ * is what we want after extending a relation by many pages at once.
+ */
+void
+RecordNewPagesWithFreeSpace(Relation rel, BlockNumber startBlk,
+							BlockNumber endBlk, Size spaceAvail)
+{
+	uint8		new_cat = fsm_space_avail_to_cat(spaceAvail);
+	BlockNumber blkno = startBlk;
+
+	while (blkno < endBlk)
+	{
+		FSMAddress	addr;
+		uint16		slot;
+		Buffer		buf;
+		Page		page;
+		bool		changed = false;
+		uint8		max_avail;
+
+		/* Set all the slots of the range that are on this FSM page */
+		addr = fsm_get_location(blkno, &slot);
+
+		buf = fsm_readbuf(rel, addr, true);
+		LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+		page = BufferGetPage(buf);
+
+		for (; blkno < endBlk && slot < SlotsPerFSMPage; blkno++, slot++)
+		{
+			if (fsm_set_avail(page, slot, new_cat))
+				changed = true;
+		}
+		if (changed)
+			MarkBufferDirty(buf);
+		max_avail = fsm_get_max_avail(page);
+		UnlockReleaseBuffer(buf);
+
+		/*
+		 * Propagate the new maximum up the tree, stopping as soon as a level
+		 * doesn't change.
+		 */
+		while (changed && addr.level != FSM_ROOT_LEVEL)
+		{
+			addr = fsm_get_parent(addr, &slot);
+
+			buf = fsm_readbuf(rel, addr, true);
+			LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+			page = BufferGetPage(buf);
+
+			changed = fsm_set_avail(page, slot, max_avail);
+			if (changed)
+				MarkBufferDirty(buf);
+			max_avail = fsm_get_max_avail(page);
+			UnlockReleaseBuffer(buf);
+		}
+	}
+}
+
 /*
  * XLogRecordPageWithFreeSpace - like RecordPageWithFreeSpace, for use in
  *		WAL replay
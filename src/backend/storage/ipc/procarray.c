@@ -82,6 +82,12 @@ typedef struct ProcArrayStruct
 	 */
 	TransactionId lastOverflowedXid;
 
+	/*
+	 * Oldest xmin of all replication slots, or InvalidTransactionId if none.
+	 * Protected by ProcArrayLock.
+	 */
+	TransactionId replication_slot_xmin;
+
 	/*
 	 * We declare procs[] as 1 entry because C wants a fixed-size array, but
 	 * actually it is maxProcs entries long.
@@ -230,6 +236,7 @@ CreateSharedProcArray(void)
 		procArray->headKnownAssignedXids = 0;
 		SpinLockInit(&procArray->known_assigned_xids_lck);
 		procArray->lastOverflowedXid = InvalidTransactionId;
+		procArray->replication_slot_xmin = InvalidTransactionId;
 	}
 
 	/* Create or attach to the KnownAssignedXids arrays too, if needed */
@@ -1035,12 +1042,27 @@ TransactionIdIsActive(TransactionId xid)
 }
 
 
+/*
+ * ProcArraySetReplicationSlotXmin
+ *
+ * Install the oldest xmin of all replication slots, which GetOldestXmin
+ * and GetSnapshotData take into account.
+ */
+void
+ProcArraySetReplicationSlotXmin(TransactionId xmin)
+{
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	procArray->replication_slot_xmin = xmin;
+	LWLockRelease(ProcArrayLock);
+}
+
 /*
  * GetOldestXmin -- returns oldest transaction that was running
  *					when any current transaction was started.
  *
  * If allDbs is TRUE then all backends are considered; if allDbs is FALSE
- * then only backends running in my own database are considered.
+ * then only backends running in my own database are considered, plus
+ * walsenders, which aren't connected to any database.
  *
  * If ignoreVacuum is TRUE then backends with the PROC_IN_VACUUM flag set are
  * ignored.
@@ -1065,6 +1087,7 @@ GetOldestXmin(bool allDbs, bool ignoreVacuum)
 {
 	ProcArrayStruct *arrayP = procArray;
 	TransactionId result;
+	TransactionId replication_slot_xmin;
 	int			index;
 
 	/* Cannot look for individual databases during recovery */
@@ -1089,7 +1112,14 @@ GetOldestXmin(bool allDbs, bool ignoreVacuum)
 		if (ignoreVacuum && (proc->vacuumFlags & PROC_IN_VACUUM))
 			continue;
 
-		if (allDbs || proc->databaseId == MyDatabaseId)
+		/*
+		 * A walsender isn't connected to any database, but advertises the
+		 * xmin of its standby's queries on behalf of all databases (see
+		 * hot_standby_feedback).
+		 */
+		if (allDbs ||
+			proc->databaseId == MyDatabaseId ||
+			proc->databaseId == InvalidOid)
 		{
 			/* Fetch xid just once - see GetNewTransactionId */
 			TransactionId xid = proc->xid;
@@ -1126,8 +1156,19 @@ GetOldestXmin(bool allDbs, bool ignoreVacuum)
 				result = kaxmin;
 	}
 
+	/* fetch into local variable while ProcArrayLock is held */
+	replication_slot_xmin = procArray->replication_slot_xmin;
+
 	LWLockRelease(ProcArrayLock);
 
+	/*
+	 * Replication slots hold back the removal of rows their consumers might
+	 * still need, in all databases, like hot standby feedback does.
+	 */
+	if (TransactionIdIsNormal(replication_slot_xmin) &&
+		TransactionIdPrecedes(replication_slot_xmin, result))
+		result = replication_slot_xmin;
+
 	/*
 	 * Compute the cutoff XID, being careful not to generate a "permanent"
 	 * XID.
@@ -1187,6 +1228,7 @@ GetSnapshotData(Snapshot snapshot)
 	TransactionId xmin;
 	TransactionId xmax;
 	TransactionId globalxmin;
+	TransactionId replication_slot_xmin;
 	int			index;
 	int			count = 0;
 	int			subcount = 0;
@@ -1366,6 +1408,9 @@ GetSnapshotData(Snapshot snapshot)
 	if (!TransactionIdIsValid(MyProc->xmin))
 		MyProc->xmin = TransactionXmin = xmin;
 
+	/* fetch into local variable while ProcArrayLock is held */
+	replication_slot_xmin = procArray->replication_slot_xmin;
+
 	LWLockRelease(ProcArrayLock);
 
 	/*
@@ -1376,6 +1421,11 @@ GetSnapshotData(Snapshot snapshot)
 	if (TransactionIdPrecedes(xmin, globalxmin))
 		globalxmin = xmin;
 
+	/* Check whether there's a replication slot requiring an older xmin */
+	if (TransactionIdIsNormal(replication_slot_xmin) &&
+		TransactionIdPrecedes(replication_slot_xmin, globalxmin))
+		globalxmin = replication_slot_xmin;
+
 	/* Update global variables too */
 	RecentGlobalXmin = globalxmin - vacuum_defer_cleanup_age;
 	if (!TransactionIdIsNormal(RecentGlobalXmin))
@@ -1441,7 +1491,7 @@ GetRunningTransactionData(void)
 	 * the lock, so we can't look at numProcs.  Likewise, we allocate much
 	 * more subxip storage than is probably needed.
 	 *
-	 * Should only be allocated in bgwriter, since only ever executed during
+	 * Should only be allocated in checkpointer, since only ever executed during
 	 * checkpoints.
 	 */
 	if (CurrentRunningXacts->xids == NULL)
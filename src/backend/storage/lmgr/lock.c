@@ -1894,6 +1894,43 @@ GetLockConflicts(const LOCKTAG *locktag, LOCKMODE lockmode)
 	return vxids;
 }
 
+/*
+ * LockWaiterCount
+ *		Return the number of processes waiting for the given lock.
+ *
+ * As with GetLockConflicts, the result can be out of date by the time it's
+ * returned, so it is only good as a hint.
+ */
+int
+LockWaiterCount(const LOCKTAG *locktag)
+{
+	LOCKMETHODID lockmethodid = locktag->locktag_lockmethodid;
+	LOCK	   *lock;
+	uint32		hashcode;
+	LWLockId	partitionLock;
+	int			waiters = 0;
+
+	if (lockmethodid <= 0 || lockmethodid >= lengthof(LockMethods))
+		elog(ERROR, "unrecognized lock method: %d", lockmethodid);
+
+	hashcode = LockTagHashCode(locktag);
+	partitionLock = LockHashPartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_SHARED);
+
+	lock = (LOCK *) hash_search_with_hash_value(LockMethodLockHash,
+												(void *) locktag,
+												hashcode,
+												HASH_FIND,
+												NULL);
+	if (lock)
+		waiters = lock->waitProcs.size;
+
+	LWLockRelease(partitionLock);
+
+	return waiters;
+}
+
 
 /*
  * AtPrepare_Locks
@@ -39,6 +39,8 @@
 #include "access/xact.h"
 #include "miscadmin.h"
 #include "postmaster/autovacuum.h"
+#include "postmaster/redoworker.h"
+#include "replication/syncrep.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
 #include "storage/pmsignal.h"
@@ -194,6 +196,7 @@ InitProcGlobal(void)
 	for (i = 0; i < MaxConnections; i++)
 	{
 		PGSemaphoreCreate(&(procs[i].sem));
+		InitSharedLatch(&procs[i].procLatch);
 		procs[i].links.next = (SHM_QUEUE *) ProcGlobal->freeProcs;
 		ProcGlobal->freeProcs = &procs[i];
 	}
@@ -212,6 +215,7 @@ InitProcGlobal(void)
 	for (i = 0; i < autovacuum_max_workers + 1; i++)
 	{
 		PGSemaphoreCreate(&(procs[i].sem));
+		InitSharedLatch(&procs[i].procLatch);
 		procs[i].links.next = (SHM_QUEUE *) ProcGlobal->autovacFreeProcs;
 		ProcGlobal->autovacFreeProcs = &procs[i];
 	}
@@ -224,6 +228,7 @@ InitProcGlobal(void)
 	{
 		AuxiliaryProcs[i].pid = 0;		/* marks auxiliary proc as not in use */
 		PGSemaphoreCreate(&(AuxiliaryProcs[i].sem));
+		InitSharedLatch(&AuxiliaryProcs[i].procLatch);
 	}
 
 	/* Create ProcStructLock spinlock, too */
@@ -326,6 +331,13 @@ InitProcess(void)
 		SHMQueueInit(&(MyProc->myProcLocks[i]));
 	MyProc->recoveryConflictPending = false;
 
+	/* Initialize fields for sync rep */
+	MyProc->waitLSN.xlogid = 0;
+	MyProc->waitLSN.xrecoff = 0;
+	MyProc->syncRepState = SYNC_REP_NOT_WAITING;
+	SHMQueueElemInit(&(MyProc->syncRepLinks));
+	OwnLatch(&MyProc->procLatch);
+
 	/*
 	 * We might be reusing a semaphore that belonged to a failed process. So
 	 * be careful and reinitialize its value here.	(This is not strictly
@@ -390,7 +402,7 @@ InitProcessPhase2(void)
 void
 InitAuxiliaryProcess(void)
 {
-	PGPROC	   *auxproc;
+	PGPROC	   *auxproc = NULL;
 	int			proctype;
 	int			i;
 
@@ -673,6 +685,11 @@ ProcKill(int code, Datum arg)
 	 */
 	LWLockReleaseAll();
 
+	/* Make sure we're out of the sync rep lists */
+	SyncRepCleanupAtProcExit();
+
+	DisownLatch(&MyProc->procLatch);
+
 	SpinLockAcquire(ProcStructLock);
 
 	/* Return PGPROC structure (and semaphore) to appropriate freelist */
@@ -1380,6 +1397,20 @@ ProcSendSignal(int pid)
 		 */
 		if (pid == procglobal->startupProcPid)
 			proc = procglobal->startupProc;
+		else
+		{
+			int			i;
+
+			/* Redo workers are auxiliary processes, too */
+			for (i = 0; i < NUM_AUXILIARY_PROCS; i++)
+			{
+				if (AuxiliaryProcs[i].pid == pid)
+				{
+					proc = &AuxiliaryProcs[i];
+					break;
+				}
+			}
+		}
 
 		SpinLockRelease(ProcStructLock);
 	}
@@ -20,6 +20,7 @@
 
 #include "catalog/catalog.h"
 #include "miscadmin.h"
+#include "bootstrap/bootstrap.h"
 #include "postmaster/bgwriter.h"
 #include "storage/fd.h"
 #include "storage/bufmgr.h"
@@ -38,6 +39,13 @@
 #define FORGET_DATABASE_FSYNC	(InvalidBlockNumber-1)
 #define UNLINK_RELATION_REQUEST (InvalidBlockNumber-2)
 
+/*
+ * open(2) flags for relation segment files.  With direct_io covering data
+ * files, they bypass the kernel's page cache.
+ */
+#define MD_OPEN_FLAGS \
+	(O_RDWR | PG_BINARY | ((direct_io & DIRECT_IO_DATA) ? PG_O_DIRECT : 0))
+
 /*
  * On Windows, we have to interpret EACCES as possibly meaning the same as
  * ENOENT, because if a file is unlinked-but-not-yet-gone on that platform,
@@ -69,7 +77,7 @@
  *	Inactive segments are those that once contained data but are currently
  *	not needed because of an mdtruncate() operation.  The reason for leaving
  *	them present at size zero, rather than unlinking them, is that other
- *	backends and/or the bgwriter might be holding open file references to
+ *	backends and/or the checkpointer might be holding open file references to
  *	such segments.	If the relation expands again after mdtruncate(), such
  *	that a deactivated segment becomes active again, it is important that
  *	such file references still be valid --- else data might get written
@@ -103,7 +111,7 @@ static MemoryContext MdCxt;		/* context for all md.c allocations */
 
 
 /*
- * In some contexts (currently, standalone backends and the bgwriter process)
+ * In some contexts (currently, standalone backends and the checkpointer)
  * we keep track of pending fsync operations: we need to remember all relation
  * segments that have been written since the last checkpoint, so that we can
  * fsync them down to disk before completing the next checkpoint.  This hash
@@ -114,8 +122,8 @@ static MemoryContext MdCxt;		/* context for all md.c allocations */
  * be deleted after the next checkpoint, but we use a linked list instead of
  * a hash table, because we don't expect there to be any duplicate requests.
  *
- * (Regular backends do not track pending operations locally, but forward
- * them to the bgwriter.)
+ * (Regular backends and the bgwriter do not track pending operations
+ * locally, but forward them to the checkpointer.)
  */
 typedef struct
 {
@@ -166,6 +174,7 @@ static MdfdVec *_mdfd_openseg(SMgrRelation reln, ForkNumber forkno,
 			  BlockNumber segno, int oflags);
 static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 			 BlockNumber blkno, bool skipFsync, ExtensionBehavior behavior);
+static int	_mdfd_maxrun(BlockNumber blocknum, int nblocks);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 		   MdfdVec *seg);
 
@@ -184,11 +193,10 @@ mdinit(void)
 
 	/*
 	 * Create pending-operations hashtable if we need it.  Currently, we need
-	 * it if we are standalone (not under a postmaster) OR if we are a
-	 * bootstrap-mode subprocess of a postmaster (that is, a startup or
-	 * bgwriter process).
+	 * it if we are standalone (not under a postmaster) or if we are a startup
+	 * or checkpointer auxiliary process.
 	 */
-	if (!IsUnderPostmaster || IsBootstrapProcessingMode())
+	if (!IsUnderPostmaster || AmStartupProcess() || AmCheckpointerProcess())
 	{
 		HASHCTL		hash_ctl;
 
@@ -206,10 +214,10 @@ mdinit(void)
 }
 
 /*
- * In archive recovery, we rely on bgwriter to do fsyncs, but we will have
+ * In archive recovery, we rely on checkpointer to do fsyncs, but we will have
  * already created the pendingOpsTable during initialization of the startup
  * process.  Calling this function drops the local pendingOpsTable so that
- * subsequent requests will be forwarded to bgwriter.
+ * subsequent requests will be forwarded to checkpointer.
  */
 void
 SetForwardFsyncRequests(void)
@@ -255,7 +263,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 
 	if (fd < 0)
 	{
@@ -268,7 +276,7 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 		 * already, even if isRedo is not set.	(See also mdopen)
 		 */
 		if (isRedo || IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -484,6 +492,73 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add new zeroed-out blocks to the specified relation.
+ *
+ *		Like mdextend, but adds nblocks blocks at once and fills them with
+ *		zeroes.  The space is allocated with FileFallocate, so on most
+ *		platforms no zero pages are actually written.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 int nblocks, bool skipFsync)
+{
+	MdfdVec    *v;
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/*
+	 * If a relation manages to grow to 2^32-1 blocks, refuse to extend it any
+	 * more --- we mustn't create a block whose number actually is
+	 * InvalidBlockNumber.
+	 */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	/* a range can cross segment boundaries, so do one segment at a time */
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+
+		if (segstartblock + remblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+		else
+			numblocks = remblocks;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync,
+						 EXTENSION_CREATE);
+
+		if (FileFallocate(v->mdfd_vfd, seekpos,
+						  (off_t) BLCKSZ * numblocks) != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not extend file \"%s\": %m",
+							FilePathName(v->mdfd_vfd)),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		remblocks -= numblocks;
+		curblocknum += numblocks;
+	}
+}
+
 /*
  *	mdopen() -- Open the specified relation.
  *
@@ -507,7 +582,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY, 0600);
+	fd = PathNameOpenFile(path, MD_OPEN_FLAGS, 0600);
 
 	if (fd < 0)
 	{
@@ -518,7 +593,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, ExtensionBehavior behavior)
 		 * substitute for mdcreate() in bootstrap mode only. (See mdcreate)
 		 */
 		if (IsBootstrapProcessingMode())
-			fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY, 0600);
+			fd = PathNameOpenFile(path, MD_OPEN_FLAGS | O_CREAT | O_EXCL, 0600);
 		if (fd < 0)
 		{
 			if (behavior == EXTENSION_RETURN_NULL &&
@@ -582,7 +657,14 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 	off_t		seekpos;
 	MdfdVec    *v;
 
-	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+	/*
+	 * A prefetch is only a hint, so don't complain if the file or segment
+	 * isn't there.  That's normal while prefetching ahead of WAL replay,
+	 * which may refer to relations that are created or dropped later on.
+	 */
+	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_RETURN_NULL);
+	if (v == NULL)
+		return;
 
 	seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
 
@@ -600,9 +682,89 @@ void
 mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	   char *buffer)
 {
+	mdreadv(reln, forknum, blocknum, &buffer, 1);
+}
+
+/*
+ *	mdwrite() -- Write the supplied block at the appropriate location.
+ *
+ *		This is to be used only for updating already-existing blocks of a
+ *		relation (ie, those before the current EOF).  To extend a relation,
+ *		use mdextend().
+ */
+void
+mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char *buffer, bool skipFsync)
+{
+	mdwritev(reln, forknum, blocknum, &buffer, 1, skipFsync);
+}
+
+/*
+ *	mdreadv() -- Read a run of adjacent blocks from a relation.
+ *
+ *		Each segment's part of the run is read with one system call.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, int nblocks)
+{
+	while (nblocks > 0)
+	{
+		AioHandle	handle;
+		int			nread;
+
+		nread = mdstartreadv(reln, forknum, blocknum, buffers, nblocks,
+							 &handle);
+		mdcompletereadv(reln, forknum, blocknum, buffers, nread, handle);
+
+		blocknum += nread;
+		buffers += nread;
+		nblocks -= nread;
+	}
+}
+
+/*
+ *	mdwritev() -- Write a run of adjacent blocks of a relation.
+ *
+ *		The same restrictions as for mdwrite() apply.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, int nblocks, bool skipFsync)
+{
+	while (nblocks > 0)
+	{
+		AioHandle	handle;
+		int			nwritten;
+
+		nwritten = mdstartwritev(reln, forknum, blocknum, buffers, nblocks,
+								 skipFsync, &handle);
+		mdcompletewritev(reln, forknum, blocknum, nwritten, skipFsync,
+						 handle);
+
+		blocknum += nwritten;
+		buffers += nwritten;
+		nblocks -= nwritten;
+	}
+}
+
+/*
+ *	mdstartreadv() -- Start reading a run of adjacent blocks from a relation.
+ *
+ *		The run is cut short at the end of the first segment it touches.
+ *		Returns the number of blocks the request covers; the read must be
+ *		finished with mdcompletereadv() before the buffers can be used.
+ */
+int
+mdstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 char **buffers, int nblocks, AioHandle *handle)
+{
+	struct iovec iov[PG_IOV_MAX];
 	off_t		seekpos;
-	int			nbytes;
 	MdfdVec    *v;
+	int			i;
+
+	Assert(nblocks > 0);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -616,13 +778,29 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not seek to block %u in file \"%s\": %m",
-						blocknum, FilePathName(v->mdfd_vfd))));
+	nblocks = _mdfd_maxrun(blocknum, nblocks);
+	for (i = 0; i < nblocks; i++)
+	{
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	*handle = FileStartReadv(v->mdfd_vfd, iov, nblocks, seekpos);
+
+	return nblocks;
+}
+
+/*
+ *	mdcompletereadv() -- Wait for a read started by mdstartreadv().
+ */
+void
+mdcompletereadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				char **buffers, int nblocks, AioHandle handle)
+{
+	int			nbytes;
+	MdfdVec    *v;
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ);
+	nbytes = AioWait(handle);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -630,10 +808,17 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 									   reln->smgr_rnode.node.relNode,
 									   reln->smgr_rnode.backend,
 									   nbytes,
-									   BLCKSZ);
+									   nblocks * BLCKSZ);
 
-	if (nbytes != BLCKSZ)
+	if (nbytes != nblocks * BLCKSZ)
 	{
+		int			save_errno = errno;
+		int			i;
+
+		/* the segment is open already, we just need its name */
+		v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
+
+		errno = save_errno;
 		if (nbytes < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
@@ -646,37 +831,46 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		 * read a nonexistent block.  However, if zero_damaged_pages is ON or
 		 * we are InRecovery, we should instead return zeroes without
 		 * complaining.  This allows, for example, the case of trying to
-		 * update a block that was later truncated away.
+		 * update a block that was later truncated away.  The blocks that
+		 * were read completely are fine either way.
 		 */
 		if (zero_damaged_pages || InRecovery)
-			MemSet(buffer, 0, BLCKSZ);
+		{
+			for (i = nbytes / BLCKSZ; i < nblocks; i++)
+				MemSet(buffers[i], 0, BLCKSZ);
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_DATA_CORRUPTED),
 					 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
-							blocknum, FilePathName(v->mdfd_vfd),
-							nbytes, BLCKSZ)));
+							blocknum + nbytes / BLCKSZ,
+							FilePathName(v->mdfd_vfd),
+							nbytes % BLCKSZ, BLCKSZ)));
 	}
 }
 
 /*
- *	mdwrite() -- Write the supplied block at the appropriate location.
+ *	mdstartwritev() -- Start writing a run of adjacent blocks.
  *
- *		This is to be used only for updating already-existing blocks of a
- *		relation (ie, those before the current EOF).  To extend a relation,
- *		use mdextend().
+ *		As with mdstartreadv(), the run is cut short at the end of the first
+ *		segment, and the number of blocks covered is returned.  The buffers
+ *		must not be changed until the write has been finished with
+ *		mdcompletewritev().
  */
-void
-mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
-		char *buffer, bool skipFsync)
+int
+mdstartwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  char **buffers, int nblocks, bool skipFsync, AioHandle *handle)
 {
+	struct iovec iov[PG_IOV_MAX];
 	off_t		seekpos;
-	int			nbytes;
 	MdfdVec    *v;
+	int			i;
+
+	Assert(nblocks > 0);
 
 	/* This assert is too expensive to have on normally ... */
 #ifdef CHECK_WRITE_VS_EXTEND
-	Assert(blocknum < mdnblocks(reln, forknum));
+	Assert(blocknum + nblocks <= mdnblocks(reln, forknum));
 #endif
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_START(forknum, blocknum,
@@ -691,13 +885,35 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not seek to block %u in file \"%s\": %m",
-						blocknum, FilePathName(v->mdfd_vfd))));
+	nblocks = _mdfd_maxrun(blocknum, nblocks);
+	for (i = 0; i < nblocks; i++)
+	{
+		iov[i].iov_base = buffers[i];
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	*handle = FileStartWritev(v->mdfd_vfd, iov, nblocks, seekpos);
 
-	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ);
+	return nblocks;
+}
+
+/*
+ *	mdcompletewritev() -- Wait for a write started by mdstartwritev().
+ *
+ *		The segment is registered for fsync only once the write is done, so
+ *		that a checkpoint that absorbs the request cannot fsync the file
+ *		before the data has reached the kernel.
+ */
+void
+mdcompletewritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				 int nblocks, bool skipFsync, AioHandle handle)
+{
+	int			nbytes;
+	int			save_errno;
+	MdfdVec    *v;
+
+	nbytes = AioWait(handle);
+	save_errno = errno;
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -705,10 +921,13 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 										reln->smgr_rnode.node.relNode,
 										reln->smgr_rnode.backend,
 										nbytes,
-										BLCKSZ);
+										nblocks * BLCKSZ);
+
+	v = _mdfd_getseg(reln, forknum, blocknum, skipFsync, EXTENSION_FAIL);
 
-	if (nbytes != BLCKSZ)
+	if (nbytes != nblocks * BLCKSZ)
 	{
+		errno = save_errno;
 		if (nbytes < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
@@ -718,9 +937,9 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		ereport(ERROR,
 				(errcode(ERRCODE_DISK_FULL),
 				 errmsg("could not write block %u in file \"%s\": wrote only %d of %d bytes",
-						blocknum,
+						blocknum + nbytes / BLCKSZ,
 						FilePathName(v->mdfd_vfd),
-						nbytes, BLCKSZ),
+						nbytes % BLCKSZ, BLCKSZ),
 				 errhint("Check free disk space.")));
 	}
 
@@ -728,6 +947,42 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	mdwriteback() -- Ask the kernel to start writing back a range of blocks.
+ *
+ *		The range may span segments.  Segments that don't exist (anymore)
+ *		are silently skipped: the relation may have been truncated or
+ *		dropped since the blocks were written, and this is only a hint.
+ */
+void
+mdwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			BlockNumber nblocks)
+{
+	while (nblocks > 0)
+	{
+		BlockNumber nflush;
+		off_t		seekpos;
+		MdfdVec    *v;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, true,
+						 EXTENSION_RETURN_NULL);
+		if (v == NULL)
+			return;
+
+		/* don't cross a segment boundary */
+		nflush = Min(nblocks,
+					 ((BlockNumber) RELSEG_SIZE) -
+					 blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		seekpos = (off_t) BLCKSZ *(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		FileWriteback(v->mdfd_vfd, seekpos, (off_t) BLCKSZ * nflush);
+
+		nblocks -= nflush;
+		blocknum += nflush;
+	}
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
@@ -935,7 +1190,7 @@ mdsync(void)
 		elog(ERROR, "cannot sync without a pendingOpsTable");
 
 	/*
-	 * If we are in the bgwriter, the sync had better include all fsync
+	 * If we are in the checkpointer, the sync had better include all fsync
 	 * requests that were queued by backends up to this point.	The tightest
 	 * race condition that could occur is that a buffer that must be written
 	 * and fsync'd for the checkpoint could have been dumped by a backend just
@@ -1011,7 +1266,7 @@ mdsync(void)
 			int			failures;
 
 			/*
-			 * If in bgwriter, we want to absorb pending requests every so
+			 * If in checkpointer, we want to absorb pending requests every so
 			 * often to prevent overflow of the fsync request queue.  It is
 			 * unspecified whether newly-added entries will be visited by
 			 * hash_seq_search, but we don't care since we don't need to
@@ -1048,12 +1303,13 @@ mdsync(void)
 				 * say "but an unreferenced SMgrRelation is still a leak!" Not
 				 * really, because the only case in which a checkpoint is done
 				 * by a process that isn't about to shut down is in the
-				 * bgwriter, and it will periodically do smgrcloseall(). This
-				 * fact justifies our not closing the reln in the success path
-				 * either, which is a good thing since in non-bgwriter cases
-				 * we couldn't safely do that.)  Furthermore, in many cases
-				 * the relation will have been dirtied through this same smgr
-				 * relation, and so we can save a file open/close cycle.
+				 * checkpointer, and it will periodically do smgrcloseall().
+				 * This fact justifies our not closing the reln in the success
+				 * path either, which is a good thing since in
+				 * non-checkpointer cases we couldn't safely do that.)
+				 * Furthermore, in many cases the relation will have been
+				 * dirtied through this same smgr relation, and so we can save
+				 * a file open/close cycle.
 				 */
 				reln = smgropen(entry->tag.rnode.node,
 								entry->tag.rnode.backend);
@@ -1207,9 +1463,10 @@ mdpostckpt(void)
  *
  * If there is a local pending-ops table, just make an entry in it for
  * mdsync to process later.  Otherwise, try to pass off the fsync request
- * to the background writer process.  If that fails, just do the fsync
+ * to the checkpointer process.  If that fails, just do the fsync
  * locally before returning (we expect this will not happen often enough
- * to be a performance problem).
+ * to be a performance problem, since the checkpointer compacts its queue
+ * before giving up).
  */
 static void
 register_dirty_segment(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
@@ -1224,6 +1481,9 @@ register_dirty_segment(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
 		if (ForwardFsyncRequest(reln->smgr_rnode, forknum, seg->mdfd_segno))
 			return;				/* passed it off successfully */
 
+		ereport(DEBUG1,
+				(errmsg("could not forward fsync request because request queue is full")));
+
 		if (FileSync(seg->mdfd_vfd) < 0)
 			ereport(ERROR,
 					(errcode_for_file_access(),
@@ -1249,7 +1509,7 @@ register_unlink(RelFileNodeBackend rnode)
 	else
 	{
 		/*
-		 * Notify the bgwriter about it.  If we fail to queue the request
+		 * Notify the checkpointer about it.  If we fail to queue the request
 		 * message, we have to sleep and try again, because we can't simply
 		 * delete the file now.  Ugly, but hopefully won't happen often.
 		 *
@@ -1263,10 +1523,10 @@ register_unlink(RelFileNodeBackend rnode)
 }
 
 /*
- * RememberFsyncRequest() -- callback from bgwriter side of fsync request
+ * RememberFsyncRequest() -- callback from checkpointer side of fsync request
  *
  * We stuff most fsync requests into the local hash table for execution
- * during the bgwriter's next checkpoint.  UNLINK requests go into a
+ * during the checkpointer's next checkpoint.  UNLINK requests go into a
  * separate linked list, however, because they get processed separately.
  *
  * The range of possible segment numbers is way less than the range of
@@ -1408,21 +1668,21 @@ ForgetRelationFsyncRequests(RelFileNodeBackend rnode, ForkNumber forknum)
 	else if (IsUnderPostmaster)
 	{
 		/*
-		 * Notify the bgwriter about it.  If we fail to queue the revoke
+		 * Notify the checkpointer about it.  If we fail to queue the revoke
 		 * message, we have to sleep and try again ... ugly, but hopefully
 		 * won't happen often.
 		 *
 		 * XXX should we CHECK_FOR_INTERRUPTS in this loop?  Escaping with an
 		 * error would leave the no-longer-used file still present on disk,
-		 * which would be bad, so I'm inclined to assume that the bgwriter
+		 * which would be bad, so I'm inclined to assume that the checkpointer
 		 * will always empty the queue soon.
 		 */
 		while (!ForwardFsyncRequest(rnode, forknum, FORGET_RELATION_FSYNC))
 			pg_usleep(10000L);	/* 10 msec seems a good number */
 
 		/*
-		 * Note we don't wait for the bgwriter to actually absorb the revoke
-		 * message; see mdsync() for the implications.
+		 * Note we don't wait for the checkpointer to actually absorb the
+		 * revoke message; see mdsync() for the implications.
 		 */
 	}
 }
@@ -1504,7 +1764,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags, 0600);
+	fd = PathNameOpenFile(fullpath, MD_OPEN_FLAGS | oflags, 0600);
 
 	pfree(fullpath);
 
@@ -1562,9 +1822,11 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 			 * active segment are of size RELSEG_SIZE; therefore, pad them out
 			 * with zeroes if needed.  (This only matters if caller is
 			 * extending the relation discontiguously, but that can happen in
-			 * hash indexes.)
+			 * hash indexes.)  Callers passing EXTENSION_RETURN_NULL only want
+			 * to look at existing data, so don't create anything for them.
 			 */
-			if (behavior == EXTENSION_CREATE || InRecovery)
+			if (behavior == EXTENSION_CREATE ||
+				(InRecovery && behavior != EXTENSION_RETURN_NULL))
 			{
 				if (_mdnblocks(reln, forknum, v) < RELSEG_SIZE)
 				{
@@ -1599,6 +1861,23 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 	return v;
 }
 
+/*
+ * _mdfd_maxrun() -- How many of the nblocks blocks starting at blocknum
+ *		can be transferred with one request?
+ *
+ * A request can't cross a segment boundary, nor use more than PG_IOV_MAX
+ * buffers.
+ */
+static int
+_mdfd_maxrun(BlockNumber blocknum, int nblocks)
+{
+	BlockNumber segleft;
+
+	segleft = ((BlockNumber) RELSEG_SIZE) - blocknum % ((BlockNumber) RELSEG_SIZE);
+
+	return (int) Min((BlockNumber) Min(nblocks, PG_IOV_MAX), segleft);
+}
+
 /*
  * Get number of blocks present in a single disk file
  */
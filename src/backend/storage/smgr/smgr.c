@@ -49,12 +49,33 @@ typedef struct f_smgr
 											bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 							BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+							BlockNumber blocknum, int nblocks, bool skipFsync);
 	void		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 											  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
 										  BlockNumber blocknum, char *buffer);
 	void		(*smgr_write) (SMgrRelation reln, ForkNumber forknum,
 							BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_readv) (SMgrRelation reln, ForkNumber forknum,
+						 BlockNumber blocknum, char **buffers, int nblocks);
+	void		(*smgr_writev) (SMgrRelation reln, ForkNumber forknum,
+										 BlockNumber blocknum, char **buffers,
+											int nblocks, bool skipFsync);
+	int			(*smgr_startreadv) (SMgrRelation reln, ForkNumber forknum,
+										 BlockNumber blocknum, char **buffers,
+											int nblocks, AioHandle *handle);
+	void		(*smgr_completereadv) (SMgrRelation reln, ForkNumber forknum,
+										 BlockNumber blocknum, char **buffers,
+											   int nblocks, AioHandle handle);
+	int			(*smgr_startwritev) (SMgrRelation reln, ForkNumber forknum,
+										 BlockNumber blocknum, char **buffers,
+							   int nblocks, bool skipFsync, AioHandle *handle);
+	void		(*smgr_completewritev) (SMgrRelation reln, ForkNumber forknum,
+											BlockNumber blocknum, int nblocks,
+								   bool skipFsync, AioHandle handle);
+	void		(*smgr_writeback) (SMgrRelation reln, ForkNumber forknum,
+							BlockNumber blocknum, BlockNumber nblocks);
 	BlockNumber (*smgr_nblocks) (SMgrRelation reln, ForkNumber forknum);
 	void		(*smgr_truncate) (SMgrRelation reln, ForkNumber forknum,
 										   BlockNumber nblocks);
@@ -68,8 +89,10 @@ typedef struct f_smgr
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
 	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdnblocks, mdtruncate, mdimmedsync,
-		mdpreckpt, mdsync, mdpostckpt
+		mdzeroextend, mdprefetch, mdread, mdwrite, mdreadv, mdwritev,
+		mdstartreadv, mdcompletereadv, mdstartwritev, mdcompletewritev,
+		mdwriteback, mdnblocks, mdtruncate, mdimmedsync, mdpreckpt, mdsync,
+		mdpostckpt
 	}
 };
 
@@ -382,6 +405,22 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											   buffer, skipFsync);
 }
 
+/*
+ *	smgrzeroextend() -- Add new zeroed-out blocks to a file.
+ *
+ *		Like smgrextend(), but adds nblocks blocks starting at blocknum,
+ *		without the caller having to supply a buffer for each.  The new
+ *		blocks read as all zeroes, and no data pages go through the kernel
+ *		if the storage manager can avoid it.
+ */
+void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   int nblocks, bool skipFsync)
+{
+	(*(smgrsw[reln->smgr_which].smgr_zeroextend)) (reln, forknum, blocknum,
+												   nblocks, skipFsync);
+}
+
 /*
  *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
  */
@@ -429,6 +468,178 @@ smgrwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											  buffer, skipFsync);
 }
 
+/*
+ *	smgrstartread() -- Start reading a particular block into the supplied
+ *					   buffer, without waiting for the read to finish.
+ *
+ *		The read must be finished with smgrcompleteread() before the buffer
+ *		contents can be used; until then, the buffer must stay allocated.
+ *		Starting several reads before completing any of them lets them
+ *		proceed concurrently when asynchronous I/O is in use (see aio.c).
+ */
+AioHandle
+smgrstartread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  char *buffer)
+{
+	AioHandle	handle;
+
+	(void) (*(smgrsw[reln->smgr_which].smgr_startreadv)) (reln, forknum,
+														  blocknum, &buffer,
+														  1, &handle);
+	return handle;
+}
+
+/*
+ *	smgrcompleteread() -- Wait for a read started by smgrstartread().
+ *
+ *		Errors are reported the same way as by smgrread().
+ */
+void
+smgrcompleteread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				 char *buffer, AioHandle handle)
+{
+	(*(smgrsw[reln->smgr_which].smgr_completereadv)) (reln, forknum, blocknum,
+													  &buffer, 1, handle);
+}
+
+/*
+ *	smgrstartwrite() -- Start writing the supplied buffer out, without
+ *						waiting for the write to finish.
+ *
+ *		The buffer must not be modified until the write has been finished
+ *		with smgrcompletewrite().  The same restrictions as for smgrwrite()
+ *		apply.
+ */
+AioHandle
+smgrstartwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   char *buffer, bool skipFsync)
+{
+	AioHandle	handle;
+
+	(void) (*(smgrsw[reln->smgr_which].smgr_startwritev)) (reln, forknum,
+														   blocknum, &buffer,
+														   1, skipFsync,
+														   &handle);
+	return handle;
+}
+
+/*
+ *	smgrcompletewrite() -- Wait for a write started by smgrstartwrite().
+ *
+ *		skipFsync must be the same as was passed to smgrstartwrite().
+ */
+void
+smgrcompletewrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				  bool skipFsync, AioHandle handle)
+{
+	(*(smgrsw[reln->smgr_which].smgr_completewritev)) (reln, forknum, blocknum,
+													   1, skipFsync, handle);
+}
+
+/*
+ *	smgrreadv() -- read a run of adjacent blocks into the supplied buffers.
+ *
+ *		Reads blocks blocknum .. blocknum + nblocks - 1 into buffers[0 ..
+ *		nblocks - 1], with as few system calls as the storage manager can
+ *		manage.  The run may span segment boundaries.
+ */
+void
+smgrreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		  char **buffers, int nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_readv)) (reln, forknum, blocknum,
+											  buffers, nblocks);
+}
+
+/*
+ *	smgrwritev() -- write a run of adjacent blocks from the supplied buffers.
+ *
+ *		The vectored counterpart of smgrwrite(); the same restrictions apply.
+ */
+void
+smgrwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		   char **buffers, int nblocks, bool skipFsync)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writev)) (reln, forknum, blocknum,
+											   buffers, nblocks, skipFsync);
+}
+
+/*
+ *	smgrstartreadv() -- Start reading a run of adjacent blocks, without
+ *						waiting for the read to finish.
+ *
+ *		A single request may not be able to cover the whole run, for
+ *		instance because it crosses a segment boundary.  Returns the number
+ *		of blocks the started request covers, at least one; the caller
+ *		starts another request for the rest.  *handle is set to the handle
+ *		to pass to smgrcompletereadv() along with the same blocknum and the
+ *		returned number of blocks.
+ */
+int
+smgrstartreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   char **buffers, int nblocks, AioHandle *handle)
+{
+	return (*(smgrsw[reln->smgr_which].smgr_startreadv)) (reln, forknum,
+														  blocknum, buffers,
+														  nblocks, handle);
+}
+
+/*
+ *	smgrcompletereadv() -- Wait for a read started by smgrstartreadv().
+ */
+void
+smgrcompletereadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				  char **buffers, int nblocks, AioHandle handle)
+{
+	(*(smgrsw[reln->smgr_which].smgr_completereadv)) (reln, forknum, blocknum,
+													  buffers, nblocks,
+													  handle);
+}
+
+/*
+ *	smgrstartwritev() -- Start writing a run of adjacent blocks, without
+ *						 waiting for the write to finish.
+ *
+ *		Like smgrstartreadv(), returns the number of blocks covered.
+ */
+int
+smgrstartwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				char **buffers, int nblocks, bool skipFsync,
+				AioHandle *handle)
+{
+	return (*(smgrsw[reln->smgr_which].smgr_startwritev)) (reln, forknum,
+														   blocknum, buffers,
+														   nblocks, skipFsync,
+														   handle);
+}
+
+/*
+ *	smgrcompletewritev() -- Wait for a write started by smgrstartwritev().
+ */
+void
+smgrcompletewritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+				   int nblocks, bool skipFsync, AioHandle handle)
+{
+	(*(smgrsw[reln->smgr_which].smgr_completewritev)) (reln, forknum, blocknum,
+													   nblocks, skipFsync,
+													   handle);
+}
+
+/*
+ *	smgrwriteback() -- Ask the kernel to start writing back a range of
+ *					   blocks that have been written with smgrwrite().
+ *
+ *		This is only a hint to smooth out the I/O before the blocks are
+ *		fsync'd; it doesn't wait, and it doesn't make anything durable.
+ */
+void
+smgrwriteback(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			  BlockNumber nblocks)
+{
+	(*(smgrsw[reln->smgr_which].smgr_writeback)) (reln, forknum, blocknum,
+												  nblocks);
+}
+
 /*
  *	smgrnblocks() -- Calculate the number of blocks in the
  *					 supplied relation.
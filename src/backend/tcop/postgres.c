@@ -2679,6 +2679,10 @@ die(SIGNAL_ARGS)
 		}
 	}
 
+	/* If we're still here, waken anything waiting on the process latch */
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
 	errno = save_errno;
 }
 
@@ -2717,6 +2721,10 @@ StatementCancelHandler(SIGNAL_ARGS)
 		}
 	}
 
+	/* If we're still here, waken anything waiting on the process latch */
+	if (MyProc)
+		SetLatch(&MyProc->procLatch);
+
 	errno = save_errno;
 }
 
@@ -35,6 +35,7 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
+#include "postmaster/copyworker.h"
 #include "postmaster/postmaster.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
@@ -280,9 +281,11 @@ CheckMyDatabase(const char *name, bool am_superuser)
 	 * a way to recover from disabling all access to all databases, for
 	 * example "UPDATE pg_database SET datallowconn = false;".
 	 *
-	 * We do not enforce them for autovacuum worker processes either.
+	 * We do not enforce them for autovacuum worker processes either, nor
+	 * for copy workers, which work on behalf of an existing session.
 	 */
-	if (IsUnderPostmaster && !IsAutoVacuumWorkerProcess())
+	if (IsUnderPostmaster && !IsAutoVacuumWorkerProcess() &&
+		!IsCopyWorkerProcess())
 	{
 		/*
 		 * Check that the database is currently allowing connections.
@@ -591,9 +594,11 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 	 * postgres user ID, and see if we are a superuser.
 	 *
 	 * In standalone mode and in autovacuum worker processes, we use a fixed
-	 * ID, otherwise we figure it out from the authenticated user name.
+	 * ID, otherwise we figure it out from the authenticated user name.  Copy
+	 * workers also start out with the fixed ID, and switch to the user ID
+	 * of the backend they work for.
 	 */
-	if (bootstrap || IsAutoVacuumWorkerProcess())
+	if (bootstrap || IsAutoVacuumWorkerProcess() || IsCopyWorkerProcess())
 	{
 		InitializeSessionUserIdStandalone();
 		am_superuser = true;
@@ -649,12 +654,22 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 				(errcode(ERRCODE_TOO_MANY_CONNECTIONS),
 				 errmsg("remaining connection slots are reserved for non-replication superuser connections")));
 
+	/*
+	 * A walsender for logical decoding connects to its database like a
+	 * regular backend does below, but needs superuser privileges like any
+	 * other walsender.
+	 */
+	if (am_db_walsender && !am_superuser)
+		ereport(FATAL,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to start walsender")));
+
 	/*
 	 * If walsender, we don't want to connect to any particular database.
 	 * Just finish the backend startup by processing any options from the
 	 * startup packet, and we're done.
 	 */
-	if (am_walsender)
+	if (am_walsender && !am_db_walsender)
 	{
 		Assert(!bootstrap);
 
@@ -30,6 +30,7 @@
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
+#include "access/xlogprefetch.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
 #include "commands/prepare.h"
@@ -52,9 +53,15 @@
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/copyworker.h"
+#include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
+#include "postmaster/redoworker.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
+#include "replication/slot.h"
+#include "replication/syncrep.h"
+#include "replication/walreceiver.h"
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
 #include "storage/standby.h"
@@ -127,6 +134,7 @@ extern char *default_tablespace;
 extern char *temp_tablespaces;
 extern bool synchronize_seqscans;
 extern bool fullPageWrites;
+extern bool fullPageCompression;
 extern int	ssl_renegotiation_limit;
 
 #ifdef TRACE_SORT
@@ -347,6 +355,43 @@ static const struct config_enum_entry constraint_exclusion_options[] = {
 	{NULL, 0, false}
 };
 
+/*
+ * Although only "on", "off", "local", "remote_write" and "remote_apply" are
+ * documented, we accept all the likely variants of "on" and "off".
+ */
+static const struct config_enum_entry synchronous_commit_options[] = {
+	{"local", SYNCHRONOUS_COMMIT_LOCAL_FLUSH, false},
+	{"remote_write", SYNCHRONOUS_COMMIT_REMOTE_WRITE, false},
+	{"remote_apply", SYNCHRONOUS_COMMIT_REMOTE_APPLY, false},
+	{"on", SYNCHRONOUS_COMMIT_ON, false},
+	{"off", SYNCHRONOUS_COMMIT_OFF, false},
+	{"true", SYNCHRONOUS_COMMIT_ON, true},
+	{"false", SYNCHRONOUS_COMMIT_OFF, true},
+	{"yes", SYNCHRONOUS_COMMIT_ON, true},
+	{"no", SYNCHRONOUS_COMMIT_OFF, true},
+	{"1", SYNCHRONOUS_COMMIT_ON, true},
+	{"0", SYNCHRONOUS_COMMIT_OFF, true},
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry io_method_options[] = {
+	{"sync", IO_METHOD_SYNC, false},
+#ifdef USE_IO_URING
+	{"io_uring", IO_METHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
+static const struct config_enum_entry direct_io_options[] = {
+	{"off", 0, false},
+#ifdef O_DIRECT
+	{"data", DIRECT_IO_DATA, false},
+	{"wal", DIRECT_IO_WAL, false},
+	{"all", DIRECT_IO_DATA | DIRECT_IO_WAL, false},
+#endif
+	{NULL, 0, false}
+};
+
 /*
  * Options for enum values stored in other modules
  */
@@ -745,14 +790,6 @@ static struct config_bool ConfigureNamesBool[] =
 		&enableFsync,
 		true, NULL, NULL
 	},
-	{
-		{"synchronous_commit", PGC_USERSET, WAL_SETTINGS,
-			gettext_noop("Sets immediate fsync at commit."),
-			NULL
-		},
-		&XactSyncCommit,
-		true, NULL, NULL
-	},
 	{
 		{"zero_damaged_pages", PGC_SUSET, DEVELOPER_OPTIONS,
 			gettext_noop("Continues processing past damaged page headers."),
@@ -778,6 +815,14 @@ static struct config_bool ConfigureNamesBool[] =
 		&fullPageWrites,
 		true, NULL, NULL
 	},
+	{
+		{"full_page_compression", PGC_SIGHUP, WAL_SETTINGS,
+			gettext_noop("Compresses full pages written to WAL."),
+			gettext_noop("Pages that don't compress well are written uncompressed.")
+		},
+		&fullPageCompression,
+		false, NULL, NULL
+	},
 	{
 		{"silent_mode", PGC_POSTMASTER, LOGGING_WHERE,
 			gettext_noop("Runs the server silently."),
@@ -1261,6 +1306,15 @@ static struct config_bool ConfigureNamesBool[] =
 		false, NULL, NULL
 	},
 
+	{
+		{"hot_standby_feedback", PGC_SIGHUP, WAL_STANDBY_SERVERS,
+			gettext_noop("Allows feedback from a hot standby to the primary that will avoid query conflicts."),
+			NULL
+		},
+		&hot_standby_feedback,
+		false, NULL, NULL
+	},
+
 	{
 		{"allow_system_table_mods", PGC_POSTMASTER, DEVELOPER_OPTIONS,
 			gettext_noop("Allows modifications of the structure of system tables."),
@@ -1320,6 +1374,14 @@ static struct config_int ConfigureNamesInt[] =
 		&XLogArchiveTimeout,
 		0, 0, INT_MAX, NULL, NULL
 	},
+	{
+		{"max_archive_commands", PGC_SIGHUP, WAL_ARCHIVING,
+			gettext_noop("Sets the maximum number of archive commands run at the same time."),
+			NULL
+		},
+		&max_archive_commands,
+		1, 1, MAX_ARCHIVE_COMMANDS, NULL, NULL
+	},
 	{
 		{"post_auth_delay", PGC_BACKEND, DEVELOPER_OPTIONS,
 			gettext_noop("Waits N seconds on connection startup after authentication."),
@@ -1424,6 +1486,16 @@ static struct config_int ConfigureNamesInt[] =
 		30 * 1000, -1, INT_MAX / 1000, NULL, NULL
 	},
 
+	{
+		{"wal_receiver_status_interval", PGC_SIGHUP, WAL_STANDBY_SERVERS,
+			gettext_noop("Sets the maximum interval between WAL receiver status reports to the primary."),
+			NULL,
+			GUC_UNIT_S
+		},
+		&wal_receiver_status_interval,
+		10, 0, INT_MAX / 1000, NULL, NULL
+	},
+
 	{
 		{"max_connections", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
 			gettext_noop("Sets the maximum number of concurrent connections."),
@@ -1759,6 +1831,16 @@ static struct config_int ConfigureNamesInt[] =
 		30, 0, INT_MAX, NULL, NULL
 	},
 
+	{
+		{"checkpoint_flush_after", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Number of blocks a checkpoint writes before the kernel is asked to write them back."),
+			gettext_noop("Zero disables forced writeback."),
+			GUC_UNIT_BLOCKS
+		},
+		&checkpoint_flush_after,
+		32, 0, WRITEBACK_MAX_PENDING_FLUSHES, NULL, NULL
+	},
+
 	{
 		{"wal_buffers", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the number of disk-page buffers in shared memory for WAL."),
@@ -1779,6 +1861,36 @@ static struct config_int ConfigureNamesInt[] =
 		200, 1, 10000, NULL, NULL
 	},
 
+	{
+		{"recovery_prefetch_distance",
+#ifdef USE_PREFETCH
+			PGC_SIGHUP,
+#else
+			PGC_INTERNAL,
+#endif
+			WAL_SETTINGS,
+			gettext_noop("Sets how far ahead of replay recovery looks for data blocks to prefetch."),
+			gettext_noop("Zero disables prefetching during recovery."),
+			GUC_UNIT_KB
+		},
+		&recovery_prefetch_distance,
+#ifdef USE_PREFETCH
+		256, 0, 1024 * 1024,
+#else
+		0, 0, 0,
+#endif
+		NULL, NULL
+	},
+
+	{
+		{"recovery_parallel_workers", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of processes that replay WAL in parallel during archive recovery."),
+			gettext_noop("Zero replays all WAL in the startup process.")
+		},
+		&recovery_parallel_workers,
+		0, 0, MAX_REDO_WORKERS, NULL, NULL
+	},
+
 	{
 		/* see max_connections */
 		{"max_wal_senders", PGC_POSTMASTER, WAL_REPLICATION,
@@ -1789,6 +1901,16 @@ static struct config_int ConfigureNamesInt[] =
 		0, 0, MAX_BACKENDS, NULL, NULL
 	},
 
+	{
+		/* see max_connections */
+		{"max_replication_slots", PGC_POSTMASTER, WAL_REPLICATION,
+			gettext_noop("Sets the maximum number of simultaneously defined replication slots."),
+			NULL
+		},
+		&max_replication_slots,
+		0, 0, MAX_BACKENDS, NULL, NULL
+	},
+
 	{
 		{"wal_sender_delay", PGC_SIGHUP, WAL_REPLICATION,
 			gettext_noop("WAL sender sleep time between WAL replications."),
@@ -1891,6 +2013,24 @@ static struct config_int ConfigureNamesInt[] =
 		assign_effective_io_concurrency, NULL
 	},
 
+	{
+		{"aio_queue_depth", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of asynchronous I/O requests each process has in progress at once."),
+			NULL
+		},
+		&aio_queue_depth,
+		32, 1, 4096, NULL, NULL
+	},
+
+	{
+		{"max_copy_workers", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of simultaneously running parallel COPY worker processes."),
+			NULL
+		},
+		&max_copy_workers,
+		8, 0, MAX_BACKENDS, NULL, NULL
+	},
+
 	{
 		{"log_rotation_age", PGC_SIGHUP, LOGGING_WHERE,
 			gettext_noop("Automatic log file rotation will occur after N minutes."),
@@ -2268,6 +2408,16 @@ static struct config_string ConfigureNamesString[] =
 		"", NULL, show_archive_command
 	},
 
+	{
+		{"synchronous_standby_names", PGC_SIGHUP, WAL_REPLICATION,
+			gettext_noop("List of names of potential synchronous standbys."),
+			NULL,
+			GUC_LIST_INPUT
+		},
+		&SyncRepStandbyNames,
+		"", assign_synchronous_standby_names, NULL
+	},
+
 	{
 		{"client_encoding", PGC_USERSET, CLIENT_CONN_LOCALE,
 			gettext_noop("Sets the client's character set encoding."),
@@ -2860,6 +3010,33 @@ static struct config_enum ConfigureNamesEnum[] =
 		WAL_LEVEL_MINIMAL, wal_level_options, NULL
 	},
 
+	{
+		{"io_method", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method used for reading and writing data files."),
+			NULL
+		},
+		&io_method,
+		DEFAULT_IO_METHOD, io_method_options, NULL, NULL
+	},
+
+	{
+		{"direct_io", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects which files are read and written bypassing the kernel's page cache."),
+			NULL
+		},
+		&direct_io,
+		0, direct_io_options, NULL, NULL
+	},
+
+	{
+		{"synchronous_commit", PGC_USERSET, WAL_SETTINGS,
+			gettext_noop("Sets the current transaction's synchronization level."),
+			NULL
+		},
+		&synchronous_commit,
+		SYNCHRONOUS_COMMIT_ON, synchronous_commit_options, NULL, NULL
+	},
+
 	{
 		{"wal_sync_method", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Selects the method used for forcing WAL updates to disk."),
@@ -2459,6 +2459,7 @@ main(int argc, char *argv[])
 		"pg_xlog/archive_status",
 		"pg_clog",
 		"pg_notify",
+		"pg_replslot",
 		"pg_subtrans",
 		"pg_twophase",
 		"pg_multixact/members",
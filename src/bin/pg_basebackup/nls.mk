@@ -0,0 +1,5 @@
+# $PostgreSQL$
+CATALOG_NAME	:= pg_basebackup
+AVAIL_LANGUAGES	:=
+GETTEXT_FILES	:= pg_basebackup.c
+GETTEXT_TRIGGERS:= _ simple_prompt
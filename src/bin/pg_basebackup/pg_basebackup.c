@@ -0,0 +1,1133 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_basebackup --- take a base backup of a running server over the
+ *					 replication protocol
+ *
+ * The backup is started and stopped on one replication connection.  The
+ * tablespaces are fetched with SEND_TABLESPACE, spread over up to --jobs
+ * connections so that each tablespace is read by its own walsender and
+ * the disks are read in parallel.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+#include "libpq-fe.h"
+
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include "getopt_long.h"
+
+
+/* Largest number of parallel connections we allow */
+#define MAX_JOBS		32
+
+/* Lowest per-connection rate limit the server accepts, in kB/s */
+#define MIN_MAX_RATE	32
+
+enum trivalue
+{
+	TRI_DEFAULT,
+	TRI_NO,
+	TRI_YES
+};
+
+/* One tablespace to fetch; the data directory has oid NULL */
+typedef struct
+{
+	char	   *oid;
+	char	   *location;
+	int64		size;			/* kilobytes, or -1 if unknown */
+} TablespaceInfo;
+
+/*
+ * State of the tar stream of one tablespace.  In tar mode the stream is
+ * written to a file as is; in plain mode it is unpacked into 'basedir'.
+ */
+typedef struct
+{
+	TablespaceInfo *ts;
+	char		basedir[MAXPGPATH];
+	FILE	   *tarfile;		/* tar mode output */
+
+	/* plain mode: unpacking state */
+	char		header[512];
+	int			headerlen;		/* bytes of the next header collected */
+	FILE	   *file;			/* file being written, or NULL */
+	char		filename[MAXPGPATH];
+	int64		remaining;		/* bytes of member data still to come */
+	int			padding;		/* padding bytes after the member data */
+#ifdef HAVE_LIBZ
+	z_stream	zstream;
+	bool		zinit;
+#endif
+} TarStream;
+
+typedef enum
+{
+	CONN_IDLE,					/* free to take another tablespace */
+	CONN_WAIT_COPY,				/* SEND_TABLESPACE sent, no COPY yet */
+	CONN_COPYING,				/* receiving the tar stream */
+	CONN_FINISHING				/* COPY done, collecting the result */
+} ConnState;
+
+typedef struct
+{
+	PGconn	   *conn;
+	ConnState	state;
+	TarStream	stream;
+} Worker;
+
+/* Global options */
+static const char *progname;
+static char *basedir = NULL;
+static char format = 'p';		/* p(lain)/t(ar) */
+static char *label = "pg_basebackup base backup";
+static bool showprogress = false;
+static bool verbose = false;
+static bool fastcheckpoint = false;
+static int	compresslevel = 0;
+static int	maxrate = 0;		/* kB/s for the whole backup, 0 = no limit */
+static int	jobs = 1;
+static char *dbhost = NULL;
+static char *dbport = NULL;
+static char *dbuser = NULL;
+static enum trivalue prompt_password = TRI_DEFAULT;
+
+/* Progress counters */
+static int64 totalsize;			/* kilobytes */
+static int64 totaldone;			/* bytes */
+static int	tablespacecount;
+
+static TablespaceInfo *tablespaces;
+static int	ntablespaces;
+
+static void *pg_malloc(size_t size);
+static char *pg_strdup(const char *s);
+static void usage(void);
+static void disconnect_and_exit(int code);
+static PGconn *GetConnection(void);
+static void verify_dir_is_empty_or_create(char *dirname);
+static void progress_report(bool force);
+static int	compare_tablespace_size(const void *a, const void *b);
+static void ReadTablespaceList(PGresult *res);
+static void start_stream(Worker *w, TablespaceInfo *ts);
+static bool receive_data(Worker *w);
+static void stream_data(TarStream *s, const char *data, int len);
+static void end_stream(TarStream *s);
+static void extract_data(TarStream *s, const char *data, int len);
+static void extract_member(TarStream *s);
+static int64 read_tar_number(const char *s, int len);
+static void BaseBackup(void);
+
+static Worker *workers;
+static int	nworkers;
+
+
+/*
+ * routines to check mem allocations and fail noisily.
+ */
+static void *
+pg_malloc(size_t size)
+{
+	void	   *result;
+
+	result = malloc(size);
+	if (!result)
+	{
+		fprintf(stderr, _("%s: out of memory\n"), progname);
+		exit(1);
+	}
+	return result;
+}
+
+static char *
+pg_strdup(const char *s)
+{
+	char	   *result;
+
+	result = strdup(s);
+	if (!result)
+	{
+		fprintf(stderr, _("%s: out of memory\n"), progname);
+		exit(1);
+	}
+	return result;
+}
+
+
+static void
+usage(void)
+{
+	printf(_("%s takes a base backup of a running PostgreSQL server.\n\n"),
+		   progname);
+	printf(_("Usage:\n"));
+	printf(_("  %s [OPTION]...\n"), progname);
+	printf(_("\nOptions controlling the output:\n"));
+	printf(_("  -D, --pgdata=DIRECTORY   receive base backup into directory\n"));
+	printf(_("  -F, --format=p|t         output format (plain, tar)\n"));
+	printf(_("  -Z, --compress=0-9       compress the backup stream\n"));
+	printf(_("  -r, --max-rate=RATE      maximum total transfer rate in kB/s\n"));
+	printf(_("  -j, --jobs=NUM           use this many connections to fetch tablespaces\n"));
+	printf(_("\nGeneral options:\n"));
+	printf(_("  -c, --checkpoint=fast|spread\n"
+			 "                           set fast or spread checkpointing\n"));
+	printf(_("  -l, --label=LABEL        set backup label\n"));
+	printf(_("  -P, --progress           show progress information\n"));
+	printf(_("  -v, --verbose            output verbose messages\n"));
+	printf(_("  --help                   show this help, then exit\n"));
+	printf(_("  --version                output version information, then exit\n"));
+	printf(_("\nConnection options:\n"));
+	printf(_("  -h, --host=HOSTNAME      database server host or socket directory\n"));
+	printf(_("  -p, --port=PORT          database server port number\n"));
+	printf(_("  -U, --username=NAME      connect as specified database user\n"));
+	printf(_("  -w, --no-password        never prompt for password\n"));
+	printf(_("  -W, --password           force password prompt (should happen automatically)\n"));
+	printf(_("\nReport bugs to <pgsql-bugs@postgresql.org>.\n"));
+}
+
+
+static void
+disconnect_and_exit(int code)
+{
+	int			i;
+
+	if (workers != NULL)
+		for (i = 0; i < nworkers; i++)
+			if (workers[i].conn != NULL)
+				PQfinish(workers[i].conn);
+
+	exit(code);
+}
+
+
+/*
+ * Open a replication connection to the server.  The password, if one was
+ * needed, is remembered for the following connections.
+ */
+static PGconn *
+GetConnection(void)
+{
+	PGconn	   *conn;
+	bool		new_pass;
+	static char *password = NULL;
+
+	if (prompt_password == TRI_YES && !password)
+		password = simple_prompt("Password: ", 100, false);
+
+	do
+	{
+#define PARAMS_ARRAY_SIZE	8
+		const char *keywords[PARAMS_ARRAY_SIZE];
+		const char *values[PARAMS_ARRAY_SIZE];
+
+		keywords[0] = "host";
+		values[0] = dbhost;
+		keywords[1] = "port";
+		values[1] = dbport;
+		keywords[2] = "user";
+		values[2] = dbuser;
+		keywords[3] = "password";
+		values[3] = password;
+		keywords[4] = "dbname";
+		values[4] = "replication";
+		keywords[5] = "replication";
+		values[5] = "true";
+		keywords[6] = "fallback_application_name";
+		values[6] = progname;
+		keywords[7] = NULL;
+		values[7] = NULL;
+
+		new_pass = false;
+		conn = PQconnectdbParams(keywords, values, true);
+
+		if (!conn)
+		{
+			fprintf(stderr, _("%s: could not connect to server\n"), progname);
+			disconnect_and_exit(1);
+		}
+
+		if (PQstatus(conn) == CONNECTION_BAD &&
+			PQconnectionNeedsPassword(conn) &&
+			password == NULL &&
+			prompt_password != TRI_NO)
+		{
+			PQfinish(conn);
+			password = simple_prompt("Password: ", 100, false);
+			new_pass = true;
+		}
+	} while (new_pass);
+
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		fprintf(stderr, _("%s: could not connect to server: %s\n"),
+				progname, PQerrorMessage(conn));
+		PQfinish(conn);
+		disconnect_and_exit(1);
+	}
+
+	return conn;
+}
+
+
+/*
+ * Verify that the given directory exists and is empty. If it does not
+ * exist, it is created. If it exists but is not empty, an error will
+ * be given and the process ended.
+ */
+static void
+verify_dir_is_empty_or_create(char *dirname)
+{
+	DIR		   *dir;
+	struct dirent *de;
+
+	dir = opendir(dirname);
+	if (dir == NULL)
+	{
+		if (errno == ENOENT && mkdir(dirname, S_IRWXU) == 0)
+			return;
+		fprintf(stderr, _("%s: could not access directory \"%s\": %s\n"),
+				progname, dirname, strerror(errno));
+		disconnect_and_exit(1);
+	}
+
+	while ((de = readdir(dir)) != NULL)
+	{
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		fprintf(stderr, _("%s: directory \"%s\" exists but is not empty\n"),
+				progname, dirname);
+		closedir(dir);
+		disconnect_and_exit(1);
+	}
+	closedir(dir);
+}
+
+
+/*
+ * Print a progress report based on the global variables.  Unless force is
+ * true, at most one report is printed per second.
+ */
+static void
+progress_report(bool force)
+{
+	static time_t last_progress_report = 0;
+	time_t		now = time(NULL);
+	int			percent;
+	char		totaldone_str[32];
+	char		totalsize_str[32];
+
+	if (!showprogress || (now == last_progress_report && !force))
+		return;
+	last_progress_report = now;
+
+	percent = totalsize ? (int) ((totaldone / 1024) * 100 / totalsize) : 0;
+
+	/*
+	 * Avoid overflowing past 100% or the full size. This may make the total
+	 * size number change as we approach the end of the backup (the estimate
+	 * will always be wrong if WAL is included), but that's better than
+	 * having the done column be bigger than the total.
+	 */
+	if (percent > 100)
+		percent = 100;
+	if (totaldone / 1024 > totalsize)
+		totalsize = totaldone / 1024;
+
+	snprintf(totaldone_str, sizeof(totaldone_str), INT64_FORMAT,
+			 totaldone / 1024);
+	snprintf(totalsize_str, sizeof(totalsize_str), INT64_FORMAT, totalsize);
+
+	fprintf(stderr, _("%s/%s kB (%d%%), %d/%d tablespaces\r"),
+			totaldone_str, totalsize_str, percent,
+			tablespacecount, ntablespaces);
+}
+
+
+/* Sort tablespaces largest first, so the big ones start early */
+static int
+compare_tablespace_size(const void *a, const void *b)
+{
+	const TablespaceInfo *ta = (const TablespaceInfo *) a;
+	const TablespaceInfo *tb = (const TablespaceInfo *) b;
+
+	if (ta->size > tb->size)
+		return -1;
+	if (ta->size < tb->size)
+		return 1;
+	return 0;
+}
+
+
+/*
+ * Read the result set describing the tablespaces, sent by START_BACKUP.
+ */
+static void
+ReadTablespaceList(PGresult *res)
+{
+	int			i;
+
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQnfields(res) != 3)
+	{
+		fprintf(stderr, _("%s: could not get tablespace list: %s\n"),
+				progname, PQresultErrorMessage(res));
+		disconnect_and_exit(1);
+	}
+
+	ntablespaces = PQntuples(res);
+	tablespaces = pg_malloc(ntablespaces * sizeof(TablespaceInfo));
+	totalsize = 0;
+
+	for (i = 0; i < ntablespaces; i++)
+	{
+		TablespaceInfo *ts = &tablespaces[i];
+
+		ts->oid = PQgetisnull(res, i, 0) ? NULL :
+			pg_strdup(PQgetvalue(res, i, 0));
+		ts->location = PQgetisnull(res, i, 1) ? NULL :
+			pg_strdup(PQgetvalue(res, i, 1));
+		if (PQgetisnull(res, i, 2))
+			ts->size = -1;
+		else
+		{
+			sscanf(PQgetvalue(res, i, 2), INT64_FORMAT, &ts->size);
+			totalsize += ts->size;
+		}
+
+		/*
+		 * In plain mode, tablespaces are restored into their original
+		 * location, which must be empty.  Check them all before starting
+		 * to transfer anything.
+		 */
+		if (format == 'p' && ts->location != NULL)
+			verify_dir_is_empty_or_create(ts->location);
+	}
+
+	if (ntablespaces > 1)
+		qsort(tablespaces, ntablespaces, sizeof(TablespaceInfo),
+			  compare_tablespace_size);
+}
+
+
+/*
+ * Ask the server for one tablespace on a free connection.
+ */
+static void
+start_stream(Worker *w, TablespaceInfo *ts)
+{
+	TarStream  *s = &w->stream;
+	char		query[128];
+	int			len;
+
+	len = snprintf(query, sizeof(query), "SEND_TABLESPACE %s",
+				   ts->oid ? ts->oid : "BASE");
+	if (maxrate > 0)
+		len += snprintf(query + len, sizeof(query) - len, " MAX_RATE %d",
+						Max(maxrate / nworkers, MIN_MAX_RATE));
+	if (compresslevel > 0)
+		snprintf(query + len, sizeof(query) - len, " COMPRESS %d",
+				 compresslevel);
+
+	if (PQsendQuery(w->conn, query) == 0)
+	{
+		fprintf(stderr, _("%s: could not send command \"%s\": %s"),
+				progname, query, PQerrorMessage(w->conn));
+		disconnect_and_exit(1);
+	}
+
+	if (verbose)
+		fprintf(stderr, _("%s: fetching tablespace %s\n"),
+				progname, ts->location ? ts->location : "base");
+
+	memset(s, 0, sizeof(TarStream));
+	s->ts = ts;
+
+	if (format == 't')
+	{
+		char		filename[MAXPGPATH];
+
+		snprintf(filename, sizeof(filename), "%s/%s.tar%s", basedir,
+				 ts->oid ? ts->oid : "base",
+				 compresslevel > 0 ? ".gz" : "");
+		s->tarfile = fopen(filename, "wb");
+		if (s->tarfile == NULL)
+		{
+			fprintf(stderr, _("%s: could not create file \"%s\": %s\n"),
+					progname, filename, strerror(errno));
+			disconnect_and_exit(1);
+		}
+	}
+	else
+	{
+		strlcpy(s->basedir, ts->location ? ts->location : basedir,
+				sizeof(s->basedir));
+#ifdef HAVE_LIBZ
+		if (compresslevel > 0)
+		{
+			/* windowBits + 16: expect a gzip header */
+			if (inflateInit2(&s->zstream, 15 + 16) != Z_OK)
+			{
+				fprintf(stderr, _("%s: could not initialize decompression\n"),
+						progname);
+				disconnect_and_exit(1);
+			}
+			s->zinit = true;
+		}
+#endif
+	}
+
+	w->state = CONN_WAIT_COPY;
+}
+
+
+/*
+ * Process whatever has arrived on a busy connection.  Returns true when
+ * the connection has finished its tablespace and is idle again.
+ */
+static bool
+receive_data(Worker *w)
+{
+	PGresult   *res;
+
+	if (PQconsumeInput(w->conn) == 0)
+	{
+		fprintf(stderr, _("%s: could not receive data: %s"),
+				progname, PQerrorMessage(w->conn));
+		disconnect_and_exit(1);
+	}
+
+	if (w->state == CONN_WAIT_COPY)
+	{
+		if (PQisBusy(w->conn))
+			return false;
+		res = PQgetResult(w->conn);
+		if (PQresultStatus(res) != PGRES_COPY_OUT)
+		{
+			fprintf(stderr, _("%s: could not get COPY data stream: %s"),
+					progname, PQerrorMessage(w->conn));
+			disconnect_and_exit(1);
+		}
+		PQclear(res);
+		w->state = CONN_COPYING;
+	}
+
+	if (w->state == CONN_COPYING)
+	{
+		for (;;)
+		{
+			char	   *copybuf;
+			int			r;
+
+			r = PQgetCopyData(w->conn, &copybuf, 1);
+			if (r == 0)
+				return false;	/* no complete row yet */
+			if (r == -1)
+				break;			/* end of copy stream */
+			if (r == -2)
+			{
+				fprintf(stderr, _("%s: could not read COPY data: %s"),
+						progname, PQerrorMessage(w->conn));
+				disconnect_and_exit(1);
+			}
+
+			stream_data(&w->stream, copybuf, r);
+			PQfreemem(copybuf);
+		}
+
+		end_stream(&w->stream);
+		w->state = CONN_FINISHING;
+	}
+
+	/* CONN_FINISHING: collect the command result */
+	while (!PQisBusy(w->conn))
+	{
+		res = PQgetResult(w->conn);
+		if (res == NULL)
+		{
+			w->state = CONN_IDLE;
+			tablespacecount++;
+			progress_report(true);
+			return true;
+		}
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			fprintf(stderr, _("%s: final receive failed: %s"),
+					progname, PQerrorMessage(w->conn));
+			disconnect_and_exit(1);
+		}
+		PQclear(res);
+	}
+	return false;
+}
+
+
+/*
+ * Handle a chunk of a tablespace's tar stream.
+ */
+static void
+stream_data(TarStream *s, const char *data, int len)
+{
+	if (s->tarfile != NULL)
+	{
+		if (fwrite(data, len, 1, s->tarfile) != 1)
+		{
+			fprintf(stderr, _("%s: could not write to tar file: %s\n"),
+					progname, strerror(errno));
+			disconnect_and_exit(1);
+		}
+		totaldone += len;
+		progress_report(false);
+		return;
+	}
+
+#ifdef HAVE_LIBZ
+	if (s->zinit)
+	{
+		char		buf[65536];
+		int			r;
+
+		s->zstream.next_in = (Bytef *) data;
+		s->zstream.avail_in = len;
+		do
+		{
+			s->zstream.next_out = (Bytef *) buf;
+			s->zstream.avail_out = sizeof(buf);
+			r = inflate(&s->zstream, Z_NO_FLUSH);
+			if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+			{
+				fprintf(stderr, _("%s: could not decompress data: %s\n"),
+						progname, s->zstream.msg ? s->zstream.msg : "?");
+				disconnect_and_exit(1);
+			}
+			extract_data(s, buf, sizeof(buf) - s->zstream.avail_out);
+		} while ((s->zstream.avail_in > 0 || s->zstream.avail_out == 0) &&
+				 r != Z_STREAM_END);
+		return;
+	}
+#endif
+
+	extract_data(s, data, len);
+}
+
+
+static void
+end_stream(TarStream *s)
+{
+	if (s->tarfile != NULL)
+	{
+		if (fclose(s->tarfile) != 0)
+		{
+			fprintf(stderr, _("%s: could not close tar file: %s\n"),
+					progname, strerror(errno));
+			disconnect_and_exit(1);
+		}
+		s->tarfile = NULL;
+		return;
+	}
+
+#ifdef HAVE_LIBZ
+	if (s->zinit)
+	{
+		inflateEnd(&s->zstream);
+		s->zinit = false;
+	}
+#endif
+
+	if (s->file != NULL || s->remaining > 0)
+	{
+		fprintf(stderr, _("%s: COPY stream ended before last file was finished\n"),
+				progname);
+		disconnect_and_exit(1);
+	}
+}
+
+
+/*
+ * Unpack a chunk of an uncompressed tar stream in plain mode.
+ */
+static void
+extract_data(TarStream *s, const char *data, int len)
+{
+	totaldone += len;
+	progress_report(false);
+
+	while (len > 0)
+	{
+		int			n;
+
+		if (s->remaining > 0)
+		{
+			/* member data */
+			n = (int) Min((int64) len, s->remaining);
+			if (fwrite(data, n, 1, s->file) != 1)
+			{
+				fprintf(stderr, _("%s: could not write to file \"%s\": %s\n"),
+						progname, s->filename, strerror(errno));
+				disconnect_and_exit(1);
+			}
+			s->remaining -= n;
+			if (s->remaining == 0)
+			{
+				fclose(s->file);
+				s->file = NULL;
+			}
+		}
+		else if (s->padding > 0)
+		{
+			n = Min(len, s->padding);
+			s->padding -= n;
+		}
+		else
+		{
+			/* collect the next header */
+			n = Min(len, 512 - s->headerlen);
+			memcpy(s->header + s->headerlen, data, n);
+			s->headerlen += n;
+			if (s->headerlen == 512)
+			{
+				s->headerlen = 0;
+				extract_member(s);
+			}
+		}
+
+		data += n;
+		len -= n;
+	}
+}
+
+
+/*
+ * Act on a complete tar header: create the directory, symlink or file it
+ * describes.
+ */
+static void
+extract_member(TarStream *s)
+{
+	char	   *h = s->header;
+	char		name[101];
+	char		linktarget[101];
+	int			filemode;
+	int64		size;
+
+	/* End of archive marker: zero blocks */
+	if (h[0] == '\0')
+		return;
+
+	strlcpy(name, h, sizeof(name));
+	strlcpy(linktarget, &h[157], sizeof(linktarget));
+	filemode = (int) read_tar_number(&h[100], 7);
+	size = read_tar_number(&h[124], 11);
+
+	if (snprintf(s->filename, sizeof(s->filename), "%s/%s",
+				 s->basedir, name) >= (int) sizeof(s->filename))
+	{
+		fprintf(stderr, _("%s: file name too long: \"%s/%s\"\n"),
+				progname, s->basedir, name);
+		disconnect_and_exit(1);
+	}
+
+	switch (h[156])
+	{
+		case '5':
+			/* Directory; strip the trailing slash, if any */
+			if (s->filename[strlen(s->filename) - 1] == '/')
+				s->filename[strlen(s->filename) - 1] = '\0';
+			if (mkdir(s->filename, S_IRWXU) != 0 && errno != EEXIST)
+			{
+				fprintf(stderr, _("%s: could not create directory \"%s\": %s\n"),
+						progname, s->filename, strerror(errno));
+				disconnect_and_exit(1);
+			}
+#ifndef WIN32
+			if (chmod(s->filename, (mode_t) filemode))
+				fprintf(stderr, _("%s: could not set permissions on directory \"%s\": %s\n"),
+						progname, s->filename, strerror(errno));
+#endif
+			break;
+
+		case '2':
+			/* Symbolic link, for a tablespace in pg_tblspc */
+			if (s->filename[strlen(s->filename) - 1] == '/')
+				s->filename[strlen(s->filename) - 1] = '\0';
+			if (symlink(linktarget, s->filename) != 0)
+			{
+				fprintf(stderr, _("%s: could not create symbolic link from \"%s\" to \"%s\": %s\n"),
+						progname, s->filename, linktarget, strerror(errno));
+				disconnect_and_exit(1);
+			}
+			break;
+
+		case '0':
+			/* Regular file */
+			s->file = fopen(s->filename, "wb");
+			if (s->file == NULL)
+			{
+				fprintf(stderr, _("%s: could not create file \"%s\": %s\n"),
+						progname, s->filename, strerror(errno));
+				disconnect_and_exit(1);
+			}
+#ifndef WIN32
+			if (chmod(s->filename, (mode_t) filemode))
+				fprintf(stderr, _("%s: could not set permissions on file \"%s\": %s\n"),
+						progname, s->filename, strerror(errno));
+#endif
+			s->remaining = size;
+			s->padding = ((size + 511) & ~511) - size;
+			if (size == 0)
+			{
+				fclose(s->file);
+				s->file = NULL;
+			}
+			break;
+
+		default:
+			fprintf(stderr, _("%s: unrecognized link indicator \"%c\"\n"),
+					progname, h[156]);
+			disconnect_and_exit(1);
+	}
+}
+
+
+/*
+ * Parse an octal number field of a tar header.
+ */
+static int64
+read_tar_number(const char *s, int len)
+{
+	int64		result = 0;
+
+	while (len-- > 0 && *s >= '0' && *s <= '7')
+		result = (result << 3) + (*s++ - '0');
+
+	return result;
+}
+
+
+static void
+BaseBackup(void)
+{
+	PGconn	   *conn;
+	PGresult   *res;
+	char		query[MAXPGPATH + 64];
+	char	   *quoted;
+	char	   *startpos;
+	int			next = 0;
+	int			nbusy;
+	int			i;
+
+	/* Start the backup on the first connection */
+	workers = pg_malloc(jobs * sizeof(Worker));
+	memset(workers, 0, jobs * sizeof(Worker));
+	nworkers = 1;
+	conn = workers[0].conn = GetConnection();
+
+	quoted = pg_malloc(strlen(label) * 2 + 1);
+	PQescapeStringConn(conn, quoted, label, strlen(label), NULL);
+	snprintf(query, sizeof(query), "START_BACKUP LABEL '%s' %s %s",
+			 quoted,
+			 showprogress ? "PROGRESS" : "",
+			 fastcheckpoint ? "FAST" : "");
+	free(quoted);
+
+	if (PQsendQuery(conn, query) == 0)
+	{
+		fprintf(stderr, _("%s: could not send base backup command: %s"),
+				progname, PQerrorMessage(conn));
+		disconnect_and_exit(1);
+	}
+
+	/* First result set: starting WAL position */
+	res = PQgetResult(conn);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		fprintf(stderr, _("%s: could not start base backup: %s"),
+				progname, PQerrorMessage(conn));
+		disconnect_and_exit(1);
+	}
+	startpos = pg_strdup(PQgetvalue(res, 0, 0));
+	PQclear(res);
+	if (verbose)
+		fprintf(stderr, _("%s: backup started at xlog position %s\n"),
+				progname, startpos);
+
+	/* Second result set: the tablespaces */
+	res = PQgetResult(conn);
+	ReadTablespaceList(res);
+	PQclear(res);
+
+	while ((res = PQgetResult(conn)) != NULL)
+		PQclear(res);
+
+	/* Open the additional connections */
+	while (nworkers < Min(jobs, ntablespaces))
+		workers[nworkers++].conn = GetConnection();
+
+	/* Hand out the tablespaces and receive them until all are done */
+	nbusy = 0;
+	for (;;)
+	{
+		fd_set		input_mask;
+		int			maxfd = -1;
+
+		for (i = 0; i < nworkers && next < ntablespaces; i++)
+		{
+			if (workers[i].state == CONN_IDLE)
+			{
+				start_stream(&workers[i], &tablespaces[next++]);
+				nbusy++;
+			}
+		}
+
+		if (nbusy == 0)
+			break;
+
+		FD_ZERO(&input_mask);
+		for (i = 0; i < nworkers; i++)
+		{
+			if (workers[i].state != CONN_IDLE)
+			{
+				int			sock = PQsocket(workers[i].conn);
+
+				FD_SET(sock, &input_mask);
+				maxfd = Max(maxfd, sock);
+			}
+		}
+
+		if (select(maxfd + 1, &input_mask, NULL, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, _("%s: select() failed: %s\n"),
+					progname, strerror(errno));
+			disconnect_and_exit(1);
+		}
+
+		for (i = 0; i < nworkers; i++)
+		{
+			if (workers[i].state != CONN_IDLE &&
+				FD_ISSET(PQsocket(workers[i].conn), &input_mask) &&
+				receive_data(&workers[i]))
+				nbusy--;
+		}
+	}
+
+	if (showprogress)
+	{
+		progress_report(true);
+		fprintf(stderr, "\n");	/* Need to move to next line */
+	}
+
+	/* Finally, stop the backup on the connection that started it */
+	res = PQexec(conn, "STOP_BACKUP");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		fprintf(stderr, _("%s: could not stop base backup: %s"),
+				progname, PQerrorMessage(conn));
+		disconnect_and_exit(1);
+	}
+	if (verbose)
+		fprintf(stderr, _("%s: backup ended at xlog position %s\n"),
+				progname, PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	for (i = 0; i < nworkers; i++)
+	{
+		PQfinish(workers[i].conn);
+		workers[i].conn = NULL;
+	}
+
+	if (verbose)
+		fprintf(stderr, _("%s: base backup completed\n"), progname);
+}
+
+
+int
+main(int argc, char **argv)
+{
+	static struct option long_options[] = {
+		{"help", no_argument, NULL, '?'},
+		{"version", no_argument, NULL, 'V'},
+		{"pgdata", required_argument, NULL, 'D'},
+		{"format", required_argument, NULL, 'F'},
+		{"checkpoint", required_argument, NULL, 'c'},
+		{"compress", required_argument, NULL, 'Z'},
+		{"max-rate", required_argument, NULL, 'r'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"label", required_argument, NULL, 'l'},
+		{"host", required_argument, NULL, 'h'},
+		{"port", required_argument, NULL, 'p'},
+		{"username", required_argument, NULL, 'U'},
+		{"no-password", no_argument, NULL, 'w'},
+		{"password", no_argument, NULL, 'W'},
+		{"verbose", no_argument, NULL, 'v'},
+		{"progress", no_argument, NULL, 'P'},
+		{NULL, 0, NULL, 0}
+	};
+	int			c;
+	int			option_index;
+
+	progname = get_progname(argv[0]);
+	set_pglocale_pgservice(argv[0], PG_TEXTDOMAIN("pg_basebackup"));
+
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)
+		{
+			usage();
+			exit(0);
+		}
+		else if (strcmp(argv[1], "-V") == 0
+				 || strcmp(argv[1], "--version") == 0)
+		{
+			puts("pg_basebackup (PostgreSQL) " PG_VERSION);
+			exit(0);
+		}
+	}
+
+	while ((c = getopt_long(argc, argv, "D:F:l:Z:r:j:c:h:p:U:wWvP",
+							long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+			case 'D':
+				basedir = pg_strdup(optarg);
+				break;
+			case 'F':
+				if (strcmp(optarg, "p") == 0 || strcmp(optarg, "plain") == 0)
+					format = 'p';
+				else if (strcmp(optarg, "t") == 0 || strcmp(optarg, "tar") == 0)
+					format = 't';
+				else
+				{
+					fprintf(stderr, _("%s: invalid output format \"%s\", must be \"plain\" or \"tar\"\n"),
+							progname, optarg);
+					exit(1);
+				}
+				break;
+			case 'l':
+				label = pg_strdup(optarg);
+				break;
+			case 'Z':
+				compresslevel = atoi(optarg);
+				if (compresslevel < 0 || compresslevel > 9)
+				{
+					fprintf(stderr, _("%s: invalid compression level \"%s\"\n"),
+							progname, optarg);
+					exit(1);
+				}
+				break;
+			case 'r':
+				maxrate = atoi(optarg);
+				if (maxrate < MIN_MAX_RATE)
+				{
+					fprintf(stderr, _("%s: transfer rate must be at least %d kB/s\n"),
+							progname, MIN_MAX_RATE);
+					exit(1);
+				}
+				break;
+			case 'j':
+				jobs = atoi(optarg);
+				if (jobs < 1 || jobs > MAX_JOBS)
+				{
+					fprintf(stderr, _("%s: number of parallel jobs must be between 1 and %d\n"),
+							progname, MAX_JOBS);
+					exit(1);
+				}
+				break;
+			case 'c':
+				if (pg_strcasecmp(optarg, "fast") == 0)
+					fastcheckpoint = true;
+				else if (pg_strcasecmp(optarg, "spread") == 0)
+					fastcheckpoint = false;
+				else
+				{
+					fprintf(stderr, _("%s: invalid checkpoint argument \"%s\", must be \"fast\" or \"spread\"\n"),
+							progname, optarg);
+					exit(1);
+				}
+				break;
+			case 'h':
+				dbhost = pg_strdup(optarg);
+				break;
+			case 'p':
+				dbport = pg_strdup(optarg);
+				break;
+			case 'U':
+				dbuser = pg_strdup(optarg);
+				break;
+			case 'w':
+				prompt_password = TRI_NO;
+				break;
+			case 'W':
+				prompt_password = TRI_YES;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'P':
+				showprogress = true;
+				break;
+			default:
+
+				/*
+				 * getopt_long already emitted a complaint
+				 */
+				fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+						progname);
+				exit(1);
+		}
+	}
+
+	/*
+	 * Any non-option arguments?
+	 */
+	if (optind < argc)
+	{
+		fprintf(stderr,
+				_("%s: too many command-line arguments (first is \"%s\")\n"),
+				progname, argv[optind]);
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	if (basedir == NULL)
+	{
+		fprintf(stderr, _("%s: no target directory specified\n"), progname);
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+#ifndef HAVE_LIBZ
+	if (compresslevel > 0 && format == 'p')
+	{
+		fprintf(stderr,
+				_("%s: this build does not support compression\n"),
+				progname);
+		exit(1);
+	}
+#endif
+
+	verify_dir_is_empty_or_create(basedir);
+
+	BaseBackup();
+
+	return 0;
+}
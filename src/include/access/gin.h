@@ -146,6 +146,29 @@ typedef struct
 	ItemPointerData key;
 } PostingItem;
 
+/*
+ * Compressed posting list (see ginpostinglist.c).  The first item pointer
+ * is stored as is; each following one is stored as the varbyte-encoded
+ * difference from its predecessor.  Posting tree leaf pages hold a series
+ * of these segments, an entry tuple holds a single one.
+ */
+typedef struct
+{
+	ItemPointerData first;		/* first item in this segment */
+	uint16		nbytes;			/* number of bytes that follow */
+	unsigned char bytes[1];		/* varbyte-encoded deltas (VARIABLE LENGTH) */
+} GinPostingList;
+
+#define SizeOfGinPostingList(plist) \
+	(offsetof(GinPostingList, bytes) + SHORTALIGN((plist)->nbytes))
+#define GinNextPostingListSegment(cur) \
+	((GinPostingList *) (((char *) (cur)) + SizeOfGinPostingList((cur))))
+
+/* a segment holding just its first item */
+#define GinPostingListSegmentMinSize	offsetof(GinPostingList, bytes)
+/* target size of the segments on posting tree leaf pages */
+#define GinPostingListSegmentMaxSize	256
+
 #define PostingItemGetBlockNumber(pointer) \
 	BlockIdGetBlockNumber(&(pointer)->child_blkno)
 
@@ -164,7 +187,7 @@ typedef struct
 
 #define GinGetOrigSizePosting(itup) GinItemPointerGetBlockNumber(&(itup)->t_tid)
 #define GinSetOrigSizePosting(itup,n)	ItemPointerSetBlockNumber(&(itup)->t_tid,(n))
-#define GinGetPosting(itup)			( (ItemPointer)(( ((char*)(itup)) + SHORTALIGN(GinGetOrigSizePosting(itup)) )) )
+#define GinGetPosting(itup)			( (GinPostingList *)(( ((char*)(itup)) + SHORTALIGN(GinGetOrigSizePosting(itup)) )) )
 
 #define GinMaxItemSize \
 	MAXALIGN_DOWN(((BLCKSZ - SizeOfPageHeaderData - \
@@ -177,15 +200,32 @@ typedef struct
 #define GinDataPageGetRightBound(page)	((ItemPointer) PageGetContents(page))
 #define GinDataPageGetData(page)	\
 	(PageGetContents(page) + MAXALIGN(sizeof(ItemPointerData)))
-#define GinSizeOfItem(page) \
-	(GinPageIsLeaf(page) ? sizeof(ItemPointerData) : sizeof(PostingItem))
+
+/* non-leaf pages hold an array of PostingItems */
 #define GinDataPageGetItem(page,i)	\
-	(GinDataPageGetData(page) + ((i)-1) * GinSizeOfItem(page))
+	(GinDataPageGetData(page) + ((i)-1) * sizeof(PostingItem))
 
 #define GinDataPageGetFreeSpace(page)	\
 	(BLCKSZ - MAXALIGN(SizeOfPageHeaderData) \
 	 - MAXALIGN(sizeof(ItemPointerData)) \
-	 - GinPageGetOpaque(page)->maxoff * GinSizeOfItem(page) \
+	 - GinPageGetOpaque(page)->maxoff * sizeof(PostingItem) \
+	 - MAXALIGN(sizeof(GinPageOpaqueData)))
+
+/*
+ * Leaf pages hold a series of compressed posting list segments, and
+ * pd_lower marks the end of the last one.  maxoff is the number of items.
+ */
+#define GinDataLeafPageGetPostingList(page) \
+	((GinPostingList *) GinDataPageGetData(page))
+#define GinDataLeafPageGetPostingListSize(page) \
+	(((PageHeader) (page))->pd_lower - (GinDataPageGetData(page) - (char *) (page)))
+#define GinDataLeafPageSetPostingListSize(page, size) \
+	(((PageHeader) (page))->pd_lower = \
+	 (GinDataPageGetData(page) - (char *) (page)) + (size))
+
+#define GinDataLeafMaxContentSize	\
+	(BLCKSZ - MAXALIGN(SizeOfPageHeaderData) \
+	 - MAXALIGN(sizeof(ItemPointerData)) \
 	 - MAXALIGN(sizeof(GinPageOpaqueData)))
 
 /*
@@ -241,7 +281,8 @@ typedef struct ginxlogCreatePostingTree
 	RelFileNode node;
 	BlockNumber blkno;
 	uint32		nitem;
-	/* follows list of heap's ItemPointer */
+	uint32		size;
+	/* follows compressed posting list of nitem items, size bytes long */
 } ginxlogCreatePostingTree;
 
 #define XLOG_GIN_INSERT  0x20
@@ -258,8 +299,8 @@ typedef struct ginxlogInsert
 	OffsetNumber nitem;
 
 	/*
-	 * follows: tuples or ItemPointerData or PostingItem or list of
-	 * ItemPointerData
+	 * follows: tuple, PostingItem, or list of ItemPointerData to be merged
+	 * into a posting tree leaf page
 	 */
 } ginxlogInsert;
 
@@ -283,7 +324,15 @@ typedef struct ginxlogSplit
 	BlockNumber updateBlkno;
 
 	ItemPointerData rightbound; /* used only in posting tree */
-	/* follows: list of tuple or ItemPointerData or PostingItem */
+
+	/* sizes of compressed contents, used only on posting tree leaves */
+	uint16		lsize;
+	uint16		rsize;
+
+	/*
+	 * follows: list of tuples or PostingItems, or compressed posting lists of
+	 * left and right page
+	 */
 } ginxlogSplit;
 
 #define XLOG_GIN_VACUUM_PAGE	0x40
@@ -293,7 +342,7 @@ typedef struct ginxlogVacuumPage
 	RelFileNode node;
 	BlockNumber blkno;
 	OffsetNumber nitem;
-	/* follows content of page */
+	/* follows content of page (compressed posting list on data pages) */
 } ginxlogVacuumPage;
 
 #define XLOG_GIN_DELETE_PAGE	0x50
@@ -427,6 +476,12 @@ typedef struct GinBtreeData
 	uint32		curitem;
 
 	PostingItem pitem;
+
+	/* leaf page items merged with the new ones, see dataIsEnoughSpace */
+	ItemPointerData *leafItems;
+	uint32		nleafItems;
+	uint32		nleafNew;		/* # of btree->items merged in */
+	bool		leafAppend;		/* new items all go after the old ones? */
 } GinBtreeData;
 
 extern GinBtreeStack *ginPrepareFindLeafPage(GinBtree btree, BlockNumber blkno);
@@ -439,11 +494,12 @@ extern void findParents(GinBtree btree, GinBtreeStack *stack, BlockNumber rootBl
 extern IndexTuple GinFormTuple(Relation index, GinState *ginstate,
 			 OffsetNumber attnum, Datum key,
 			 ItemPointerData *ipd, uint32 nipd, bool errorTooBig);
-extern void GinShortenTuple(IndexTuple itup, uint32 nipd);
+extern ItemPointer ginReadTuple(IndexTuple itup, int *nitems);
 extern void prepareEntryScan(GinBtree btree, Relation index, OffsetNumber attnum,
 				 Datum value, GinState *ginstate);
 extern void entryFillRoot(GinBtree btree, Buffer root, Buffer lbuf, Buffer rbuf);
 extern IndexTuple ginPageGetLinkItup(Buffer buf);
+extern IndexTuple ginPageGetLinkItupByPage(Page page, BlockNumber blkno);
 
 /* gindatapage.c */
 extern int	compareItemPointers(ItemPointer a, ItemPointer b);
@@ -453,6 +509,10 @@ extern uint32 MergeItemPointers(ItemPointerData *dst,
 
 extern void GinDataPageAddItem(Page page, void *data, OffsetNumber offset);
 extern void PageDeletePostingItem(Page page, OffsetNumber offset);
+extern ItemPointer GinDataLeafPageGetItems(Page page, int *nitems,
+						ItemPointer advancePast);
+extern int GinDataLeafPageSetItems(Page page, ItemPointerData *items,
+						int nitems, Size maxsize);
 
 typedef struct
 {
@@ -468,6 +528,13 @@ extern Buffer scanBeginPostingTree(GinPostingTreeScan *gdi);
 extern void dataFillRoot(GinBtree btree, Buffer root, Buffer lbuf, Buffer rbuf);
 extern void prepareDataScan(GinBtree btree, Relation index);
 
+/* ginpostinglist.c */
+extern GinPostingList *ginCompressPostingList(ItemPointerData *ipd, int nipd,
+					   int maxsize, int *nwritten);
+extern ItemPointer ginPostingListDecode(GinPostingList *plist, int *ndecoded);
+extern ItemPointer ginPostingListDecodeAllSegments(GinPostingList *segment,
+								int len, int *ndecoded);
+
 /* ginscan.c */
 
 typedef struct GinScanEntryData *GinScanEntry;
@@ -519,6 +586,13 @@ typedef struct GinScanKeyData
 	/* array of ItemPointer result, reported to consistentFn */
 	bool	   *entryRes;
 
+	/*
+	 * entries that an item must match for consistentFn to succeed; the scan
+	 * skips the other entries ahead to the items of these
+	 */
+	bool	   *entryRequired;
+	uint32		nrequired;
+
 	/* array of scans per entry */
 	GinScanEntry scanEntry;
 	Pointer    *extra_data;
@@ -599,6 +673,13 @@ extern void ginInsertRecordBA(BuildAccumulator *accum,
 extern void ginBeginBAScan(BuildAccumulator *accum);
 extern ItemPointerData *ginGetEntry(BuildAccumulator *accum, OffsetNumber *attnum, Datum *entry, uint32 *n);
 
+/* ginsort.c */
+typedef struct GinSortState GinSortState;
+
+extern GinSortState *ginSortBegin(Relation index, GinState *ginstate);
+extern void ginSortDumpAccum(GinSortState *gs, BuildAccumulator *accum);
+extern void ginSortFinish(GinSortState *gs, BuildAccumulator *accum);
+
 /* ginfast.c */
 
 typedef struct GinTupleCollector
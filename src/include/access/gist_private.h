@@ -17,6 +17,8 @@
 #include "access/gist.h"
 #include "access/itup.h"
 #include "storage/bufmgr.h"
+#include "storage/buffile.h"
+#include "utils/hsearch.h"
 
 #define GIST_UNLOCK BUFFER_LOCK_UNLOCK
 #define GIST_SHARE	BUFFER_LOCK_SHARE
@@ -218,6 +220,9 @@ typedef struct
 
 	/* pointer to heap tuple */
 	ItemPointerData key;
+
+	/* set by gistplacetopage when the root page had to be split */
+	bool		rootSplit;
 } GISTInsertState;
 
 /* root page of a gist index */
@@ -233,10 +238,100 @@ typedef struct
 #define  GistTupleSetValid(itup)	ItemPointerSetOffsetNumber( &((itup)->t_tid), TUPLE_IS_VALID )
 #define  GistTupleSetInvalid(itup)	ItemPointerSetOffsetNumber( &((itup)->t_tid), TUPLE_IS_INVALID )
 
+/*
+ * Buffering build support.
+ *
+ * During a buffering build, index tuples are not inserted into the tree one
+ * at a time.  Instead, internal pages on every levelStep'th level (counting
+ * up from the leaves, which are level 0) get a "node buffer", and incoming
+ * tuples are only routed down to the topmost such buffer.  When a buffer
+ * becomes half full, it is emptied: its tuples are moved down to the
+ * buffers on the next buffered level, or inserted into the leaf pages if
+ * there is none.  Since all the tuples from one buffer end up in the same
+ * subtree, the pages of that subtree stay cached while they are processed,
+ * turning the random I/O of a plain build into mostly sequential I/O.
+ *
+ * Node buffers are stored in a temporary file, as a chain of pages.  Only
+ * the last page of each buffer is kept in memory, and only while the buffer
+ * is "loaded".
+ */
+
+/* A page of a node buffer, as stored in the temporary file */
+typedef struct
+{
+	BlockNumber prev;			/* previous page of the same buffer, or
+								 * InvalidBlockNumber */
+	uint32		freespace;		/* bytes free in tupledata */
+	char		tupledata[1];	/* index tuples, stored from the end */
+} GISTNodeBufferPage;
+
+#define BUFFER_PAGE_DATA_OFFSET MAXALIGN(offsetof(GISTNodeBufferPage, tupledata))
+/* Free space available in an empty node buffer page */
+#define PAGE_FREE_SPACE_EMPTY	(BLCKSZ - BUFFER_PAGE_DATA_OFFSET)
+#define PAGE_IS_EMPTY(nbp)		((nbp)->freespace == PAGE_FREE_SPACE_EMPTY)
+/* Start of the used part of a node buffer page */
+#define PAGE_FREE_SPACE_PTR(nbp) \
+	((char *) (nbp) + BUFFER_PAGE_DATA_OFFSET + (nbp)->freespace)
+#define PAGE_NO_SPACE(nbp, itup) \
+	((nbp)->freespace < MAXALIGN(IndexTupleSize(itup)))
+
+/* Buffer attached to an internal index page during buffering build */
+typedef struct
+{
+	BlockNumber nodeBlocknum;	/* index block the buffer belongs to (hash
+								 * key, must be first) */
+	int32		blocksCount;	/* number of non-empty pages in the buffer */
+	BlockNumber pageBlocknum;	/* temp file block of the last page, when
+								 * the buffer is not loaded */
+	GISTNodeBufferPage *pageBuffer;		/* in-memory last page, or NULL */
+	bool		queuedForEmptying;		/* in the emptying queue? */
+	int			level;			/* level of the node page */
+} GISTNodeBuffer;
+
+/*
+ * A buffer is queued for emptying once it is half full, and emptying of its
+ * parent buffer is suspended as soon as it becomes overflowed.
+ */
+#define BUFFER_HALF_FILLED(nodeBuffer, gfbb) \
+	((nodeBuffer)->blocksCount > (gfbb)->pagesPerBuffer / 2)
+#define BUFFER_OVERFLOWED(nodeBuffer, gfbb) \
+	((nodeBuffer)->blocksCount > (gfbb)->pagesPerBuffer)
+
+/* Working state of the node buffers of a buffering build */
+typedef struct
+{
+	MemoryContext context;		/* context for the buffers and their pages */
+
+	BufFile    *pfile;			/* temporary file holding buffer pages */
+	long		nFileBlocks;	/* current size of the temporary file */
+
+	/* blocks of the temporary file that are free for reuse */
+	long	   *freeBlocks;
+	int			nFreeBlocks;
+	int			freeBlocksLen;
+
+	HTAB	   *nodeBuffersTab; /* GISTNodeBuffers, hashed by block number */
+
+	List	   *bufferEmptyingQueue;	/* buffers waiting to be emptied */
+
+	int			levelStep;		/* distance between buffered levels */
+	int			pagesPerBuffer; /* nominal size of a buffer, in pages */
+
+	/* lists of the buffers on each level, for the final emptying */
+	List	  **buffersOnLevels;
+	int			buffersOnLevelsLen;
+
+	/* buffers whose last page is currently held in memory */
+	GISTNodeBuffer **loadedBuffers;
+	int			loadedBuffersCount;
+	int			loadedBuffersLen;
+} GISTBuildBuffers;
+
 /* gist.c */
-extern Datum gistbuild(PG_FUNCTION_ARGS);
 extern Datum gistinsert(PG_FUNCTION_ARGS);
 extern MemoryContext createTempGistContext(void);
+extern bool gistdoinsert(Relation r, IndexTuple itup, Size freespace,
+			 GISTSTATE *GISTstate);
 extern void initGISTstate(GISTSTATE *giststate, Relation index);
 extern void freeGISTstate(GISTSTATE *giststate);
 extern void gistmakedeal(GISTInsertState *state, GISTSTATE *giststate);
@@ -277,6 +372,17 @@ extern Datum gistgetbitmap(PG_FUNCTION_ARGS);
 #define GIST_MIN_FILLFACTOR			10
 #define GIST_DEFAULT_FILLFACTOR		90
 
+/*
+ * GiST reloptions.  The fillfactor must stay at the same offset as in
+ * StdRdOptions, so that RelationGetTargetPageFreeSpace works.
+ */
+typedef struct GiSTOptions
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int			fillfactor;		/* page fill factor in percent (0..100) */
+	int			bufferingModeOffset;	/* offset of buffering mode string */
+} GiSTOptions;
+
 extern Datum gistoptions(PG_FUNCTION_ARGS);
 extern bool gistfitpage(IndexTuple *itvec, int len);
 extern bool gistnospace(Page page, IndexTuple *itvec, int len, OffsetNumber todelete, Size freespace);
@@ -326,6 +432,22 @@ extern void gistMakeUnionKey(GISTSTATE *giststate, int attno,
 				 GISTENTRY *entry2, bool isnull2,
 				 Datum *dst, bool *dstisnull);
 
+/* gistbuild.c */
+extern Datum gistbuild(PG_FUNCTION_ARGS);
+extern void gistValidateBufferingOption(char *value);
+
+/* gistbuildbuffers.c */
+extern GISTBuildBuffers *gistInitBuildBuffers(int pagesPerBuffer,
+					 int levelStep);
+extern GISTNodeBuffer *gistGetNodeBuffer(GISTBuildBuffers *gfbb,
+				  BlockNumber nodeBlocknum, int level);
+extern void gistPushItupToNodeBuffer(GISTBuildBuffers *gfbb,
+						 GISTNodeBuffer *nodeBuffer, IndexTuple itup);
+extern bool gistPopItupFromNodeBuffer(GISTBuildBuffers *gfbb,
+						  GISTNodeBuffer *nodeBuffer, IndexTuple *itup);
+extern void gistUnloadNodeBuffers(GISTBuildBuffers *gfbb);
+extern void gistFreeBuildBuffers(GISTBuildBuffers *gfbb);
+
 /* gistvacuum.c */
 extern Datum gistbulkdelete(PG_FUNCTION_ARGS);
 extern Datum gistvacuumcleanup(PG_FUNCTION_ARGS);
@@ -50,6 +50,26 @@ typedef uint32 Bucket;
 #define LH_BUCKET_PAGE			(1 << 1)
 #define LH_BITMAP_PAGE			(1 << 2)
 #define LH_META_PAGE			(1 << 3)
+#define LH_BUCKET_BEING_POPULATED	(1 << 4)
+#define LH_BUCKET_BEING_SPLIT	(1 << 5)
+
+#define LH_PAGE_TYPE \
+	(LH_OVERFLOW_PAGE|LH_BUCKET_PAGE|LH_BITMAP_PAGE|LH_META_PAGE)
+
+/*
+ * The two split flags are set only on primary bucket pages.  While a bucket
+ * split is in progress, the old bucket's primary page is marked
+ * LH_BUCKET_BEING_SPLIT and the new bucket's primary page is marked
+ * LH_BUCKET_BEING_POPULATED; both flags are cleared when the last tuple has
+ * been relocated.  See README for details.
+ */
+#define H_BUCKET_BEING_SPLIT(opaque) \
+	(((opaque)->hasho_flag & LH_BUCKET_BEING_SPLIT) != 0)
+#define H_BUCKET_BEING_POPULATED(opaque) \
+	(((opaque)->hasho_flag & LH_BUCKET_BEING_POPULATED) != 0)
+#define H_BUCKET_SPLIT_PENDING(opaque) \
+	(((opaque)->hasho_flag & \
+	  (LH_BUCKET_BEING_SPLIT | LH_BUCKET_BEING_POPULATED)) != 0)
 
 typedef struct HashPageOpaqueData
 {
@@ -91,6 +111,23 @@ typedef struct HashScanOpaqueData
 	 */
 	BlockNumber hashso_bucket_blkno;
 
+	/*
+	 * If the bucket is still being populated by an unfinished split, we must
+	 * also scan the bucket it is being split from, and hold a share lock on
+	 * it.  hashso_split_bucket_blkno is zero when that is not the case.
+	 */
+	Bucket		hashso_split_bucket;
+	BlockNumber hashso_split_bucket_blkno;
+
+	/*
+	 * We hold a pin (but no lock) on the primary page of each bucket we are
+	 * scanning, for the life of the scan.  During hot standby, that is what
+	 * keeps WAL replay from moving tuples out from under us, since the
+	 * startup process does not take the lmgr locks described above.
+	 */
+	Buffer		hashso_bucket_buf;
+	Buffer		hashso_split_bucket_buf;
+
 	/*
 	 * We also want to remember which buffer we're currently examining in the
 	 * scan. We keep the buffer pinned (but not locked) across hashgettuple
@@ -239,6 +276,146 @@ typedef HashMetaPageData *HashMetaPage;
 #define HASHPROC		1
 
 
+/*
+ * XLOG records for hash operations
+ */
+#define XLOG_HASH_INSERT			0x00	/* add tuple to a bucket page */
+#define XLOG_HASH_ADD_OVFL_PAGE		0x10	/* chain new overflow page */
+#define XLOG_HASH_UPDATE_BITMAP		0x20	/* set or clear a bitmap bit */
+#define XLOG_HASH_METAPAGE			0x30	/* overwrite metapage contents */
+#define XLOG_HASH_MOVE_TUPLES		0x40	/* move tuples between pages */
+#define XLOG_HASH_FREE_OVFL_PAGE	0x50	/* unlink a free overflow page */
+#define XLOG_HASH_DELETE			0x60	/* delete tuples from a page */
+#define XLOG_HASH_SPLIT_ALLOCATE	0x70	/* begin a bucket split */
+#define XLOG_HASH_SPLIT_COMPLETE	0x80	/* finish a bucket split */
+
+/*
+ * This is what we need to know about a single-tuple insertion.  The metapage
+ * is the record's second buffer; its tuple count is incremented on replay.
+ */
+typedef struct xl_hash_insert
+{
+	RelFileNode node;
+	BlockNumber blkno;			/* page the tuple was added to */
+	OffsetNumber offnum;		/* and its offset there */
+	/* INDEX TUPLE FOLLOWS AT END OF STRUCT */
+} xl_hash_insert;
+
+#define SizeOfHashInsert	(offsetof(xl_hash_insert, offnum) + sizeof(OffsetNumber))
+
+/*
+ * Chain a freshly allocated overflow page after the tail page of a bucket.
+ * The new page is initialized from scratch on replay.
+ */
+typedef struct xl_hash_add_ovfl_page
+{
+	RelFileNode node;
+	BlockNumber ovflblkno;		/* the new overflow page */
+	BlockNumber prevblkno;		/* tail page it is chained to */
+	Bucket		bucket;
+} xl_hash_add_ovfl_page;
+
+/*
+ * Set or clear one bit of an overflow-page bitmap.
+ */
+typedef struct xl_hash_update_bitmap
+{
+	RelFileNode node;
+	BlockNumber mapblkno;		/* bitmap page */
+	uint32		bitmapbit;		/* bit number within that page */
+	bool		setbit;			/* TRUE to set, FALSE to clear */
+} xl_hash_update_bitmap;
+
+/*
+ * Metapage changes other than the ones made by inserts and splits (overflow
+ * page accounting, bitmap page list, VACUUM's tuple count) are logged by
+ * copying the whole HashMetaPageData.
+ */
+typedef struct xl_hash_metapage
+{
+	RelFileNode node;
+	HashMetaPageData metadata;
+} xl_hash_metapage;
+
+/*
+ * Move tuples from one page to another; used both by bucket splits and by
+ * _hash_squeezebucket.  The tuples are added to wblkno (the record's first
+ * buffer) and the listed offsets are deleted from rblkno (the second
+ * buffer) atomically.  bucket_blkno is the primary page of the bucket that
+ * loses the tuples, which replay cleanup-locks to keep hot standby scans
+ * from observing the move half done.
+ */
+typedef struct xl_hash_move_tuples
+{
+	RelFileNode node;
+	BlockNumber bucket_blkno;	/* primary page of the source bucket */
+	BlockNumber wblkno;			/* page receiving the tuples */
+	BlockNumber rblkno;			/* page losing the tuples */
+	uint16		ntuples;
+	/* OFFSET NUMBERS, THEN MAXALIGN'D INDEX TUPLES FOLLOW */
+} xl_hash_move_tuples;
+
+#define SizeOfHashMoveTuples	(offsetof(xl_hash_move_tuples, ntuples) + sizeof(uint16))
+
+/*
+ * Remove an empty overflow page from its bucket chain.  The page itself is
+ * reinitialized as an unused page on replay; clearing its bitmap bit is a
+ * separate XLOG_HASH_UPDATE_BITMAP record.
+ */
+typedef struct xl_hash_free_ovfl_page
+{
+	RelFileNode node;
+	BlockNumber bucket_blkno;	/* primary page of the bucket */
+	BlockNumber ovflblkno;		/* page being freed */
+	BlockNumber prevblkno;		/* its neighbours in the bucket chain */
+	BlockNumber nextblkno;
+} xl_hash_free_ovfl_page;
+
+/*
+ * VACUUM's deletion of dead tuples from one page of a bucket.
+ */
+typedef struct xl_hash_delete
+{
+	RelFileNode node;
+	BlockNumber bucket_blkno;	/* primary page of the bucket */
+	BlockNumber blkno;			/* page the tuples are deleted from */
+	/* TARGET OFFSET NUMBERS FOLLOW AT THE END */
+} xl_hash_delete;
+
+#define SizeOfHashDelete	(offsetof(xl_hash_delete, blkno) + sizeof(BlockNumber))
+
+/*
+ * Start splitting old_bucket: update the metapage's bucket mapping, mark the
+ * old bucket's primary page as being split, and initialize the new bucket's
+ * primary page.  If the split starts a new splitpoint, lastblkno is the last
+ * block of it, which must exist so the physical EOF matches hashm_spares.
+ */
+typedef struct xl_hash_split_allocate
+{
+	RelFileNode node;
+	Bucket		old_bucket;
+	Bucket		new_bucket;
+	BlockNumber old_blkno;		/* primary pages of the two buckets */
+	BlockNumber new_blkno;
+	BlockNumber lastblkno;		/* end of new splitpoint, or invalid */
+	uint32		maxbucket;		/* new metapage bucket mapping */
+	uint32		highmask;
+	uint32		lowmask;
+	uint32		ovflpoint;
+	uint32		ovflpoint_spares;	/* hashm_spares[ovflpoint] */
+} xl_hash_split_allocate;
+
+/*
+ * All tuples have been relocated; clear the split flags on both buckets.
+ */
+typedef struct xl_hash_split_complete
+{
+	RelFileNode node;
+	BlockNumber old_blkno;
+	BlockNumber new_blkno;
+} xl_hash_split_complete;
+
+
 /* public routines */
 
 extern Datum hashbuild(PG_FUNCTION_ARGS);
@@ -285,10 +462,14 @@ extern Datum hash_uint32(uint32 k);
 extern void _hash_doinsert(Relation rel, IndexTuple itup);
 extern OffsetNumber _hash_pgaddtup(Relation rel, Buffer buf,
 			   Size itemsize, IndexTuple itup);
+extern void _hash_move_tuples(Relation rel, Buffer wbuf, Buffer rbuf,
+				  BlockNumber bucket_blkno, IndexTuple *itups,
+				  OffsetNumber *itup_offsets, uint16 nitups);
 
 /* hashovfl.c */
 extern Buffer _hash_addovflpage(Relation rel, Buffer metabuf, Buffer buf);
 extern BlockNumber _hash_freeovflpage(Relation rel, Buffer ovflbuf,
+				   BlockNumber bucket_blkno,
 				   BufferAccessStrategy bstrategy);
 extern void _hash_initbitmap(Relation rel, HashMetaPage metap,
 				 BlockNumber blkno);
@@ -309,12 +490,13 @@ extern Buffer _hash_getbuf_with_strategy(Relation rel, BlockNumber blkno,
 						   BufferAccessStrategy bstrategy);
 extern void _hash_relbuf(Relation rel, Buffer buf);
 extern void _hash_dropbuf(Relation rel, Buffer buf);
-extern void _hash_wrtbuf(Relation rel, Buffer buf);
 extern void _hash_chgbufaccess(Relation rel, Buffer buf, int from_access,
 				   int to_access);
 extern uint32 _hash_metapinit(Relation rel, double num_tuples);
 extern void _hash_pageinit(Page page, Size size);
 extern void _hash_expandtable(Relation rel, Buffer metabuf);
+extern void _hash_log_metapage(Relation rel, Buffer metabuf);
+extern void _hash_finish_split(Relation rel, Buffer metabuf, Bucket bucket);
 
 /* hashscan.c */
 extern void _hash_regscan(IndexScanDesc scan);
@@ -326,6 +508,7 @@ extern void ReleaseResources_hash(void);
 extern bool _hash_next(IndexScanDesc scan, ScanDirection dir);
 extern bool _hash_first(IndexScanDesc scan, ScanDirection dir);
 extern bool _hash_step(IndexScanDesc scan, Buffer *bufP, ScanDirection dir);
+extern void _hash_dropscanbuf(Relation rel, HashScanOpaque so);
 
 /* hashsort.c */
 typedef struct HSpool HSpool;	/* opaque struct in hashsort.c */
@@ -348,8 +531,12 @@ extern IndexTuple _hash_form_tuple(Relation index,
 				 Datum *values, bool *isnull);
 extern OffsetNumber _hash_binsearch(Page page, uint32 hash_value);
 extern OffsetNumber _hash_binsearch_last(Page page, uint32 hash_value);
+extern Bucket _hash_get_oldbucket(Bucket new_bucket);
+extern Bucket _hash_get_newbucket(Bucket old_bucket, uint32 lowmask,
+					uint32 maxbucket);
+extern bool _hash_tuple_moves_to(uint32 hashkey, Bucket new_bucket);
 
-/* hash.c */
+/* hashxlog.c */
 extern void hash_redo(XLogRecPtr lsn, XLogRecord *record);
 extern void hash_desc(StringInfo buf, uint8 xl_info, char *rec);
 
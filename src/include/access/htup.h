@@ -577,12 +577,13 @@ typedef HeapTupleData *HeapTuple;
  * We ran out of opcodes, so heapam.c now has a second RmgrId.	These opcodes
  * are associated with RM_HEAP2_ID, but are not logically different from
  * the ones above associated with RM_HEAP_ID.  We apply XLOG_HEAP_OPMASK,
- * although currently XLOG_HEAP_INIT_PAGE is not used for any of these.
+ * and XLOG_HEAP_INIT_PAGE can be set for XLOG_HEAP2_MULTI_INSERT.
  */
 #define XLOG_HEAP2_FREEZE		0x00
 #define XLOG_HEAP2_CLEAN		0x10
 /* 0x20 is free, was XLOG_HEAP2_CLEAN_MOVE */
 #define XLOG_HEAP2_CLEANUP_INFO 0x30
+#define XLOG_HEAP2_MULTI_INSERT 0x40
 
 /*
  * All what we need to find changed tuple
@@ -600,11 +601,16 @@ typedef struct xl_heaptid
 
 #define SizeOfHeapTid		(offsetof(xl_heaptid, tid) + SizeOfIptrData)
 
-/* This is what we need to know about delete */
+/*
+ * This is what we need to know about delete.  With wal_level = logical, an
+ * xl_heap_header and the tuple data of the deleted row's key follow the
+ * struct; the record length tells whether they are present.
+ */
 typedef struct xl_heap_delete
 {
 	xl_heaptid	target;			/* deleted tuple id */
 	bool		all_visible_cleared;	/* PD_ALL_VISIBLE was cleared */
+	/* OLD KEY xl_heap_header AND TUPLE DATA MAY FOLLOW AT END OF STRUCT */
 } xl_heap_delete;
 
 #define SizeOfHeapDelete	(offsetof(xl_heap_delete, all_visible_cleared) + sizeof(bool))
@@ -636,6 +642,38 @@ typedef struct xl_heap_insert
 
 #define SizeOfHeapInsert	(offsetof(xl_heap_insert, all_visible_cleared) + sizeof(bool))
 
+/*
+ * This is what we need to know about a multi-insert.  The record consists
+ * of the xl_heap_multi_insert header, followed by an xl_multi_insert_tuple
+ * and the tuple data for each tuple.  'offsets' array is omitted if the
+ * whole page is reinitialized (XLOG_HEAP_INIT_PAGE), in which case the
+ * tuples are stored in order starting at FirstOffsetNumber.
+ */
+typedef struct xl_heap_multi_insert
+{
+	RelFileNode node;
+	BlockNumber blkno;
+	bool		all_visible_cleared;	/* PD_ALL_VISIBLE was cleared */
+	uint16		ntuples;
+	OffsetNumber offsets[1];
+
+	/* TUPLE DATA (xl_multi_insert_tuples) FOLLOW AT END OF STRUCT */
+} xl_heap_multi_insert;
+
+#define SizeOfHeapMultiInsert	offsetof(xl_heap_multi_insert, offsets)
+
+/* Like xl_heap_header, but with the length of the data that follows */
+typedef struct xl_multi_insert_tuple
+{
+	uint16		datalen;		/* size of tuple data that follows */
+	uint16		t_infomask2;
+	uint16		t_infomask;
+	uint8		t_hoff;
+	/* TUPLE DATA FOLLOWS AT END OF STRUCT */
+} xl_multi_insert_tuple;
+
+#define SizeOfMultiInsertTuple	(offsetof(xl_multi_insert_tuple, t_hoff) + sizeof(uint8))
+
 /* This is what we need to know about update|hot_update */
 typedef struct xl_heap_update
 {
@@ -643,10 +681,12 @@ typedef struct xl_heap_update
 	ItemPointerData newtid;		/* new inserted tuple id */
 	bool		all_visible_cleared;	/* PD_ALL_VISIBLE was cleared */
 	bool		new_all_visible_cleared;		/* same for the page of newtid */
+	uint16		old_key_len;	/* length of old key data, 0 if none */
 	/* NEW TUPLE xl_heap_header AND TUPLE DATA FOLLOWS AT END OF STRUCT */
+	/* OLD KEY xl_heap_header AND TUPLE DATA, IF ANY, FOLLOW THAT */
 } xl_heap_update;
 
-#define SizeOfHeapUpdate	(offsetof(xl_heap_update, new_all_visible_cleared) + sizeof(bool))
+#define SizeOfHeapUpdate	(offsetof(xl_heap_update, old_key_len) + sizeof(uint16))
 
 /*
  * This is what we need to know about vacuum page cleanup/redirect
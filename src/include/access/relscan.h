@@ -34,6 +34,7 @@ typedef struct HeapScanDescData
 	BlockNumber rs_nblocks;		/* number of blocks to scan */
 	BlockNumber rs_startblock;	/* block # to start at */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
+	ReadStream *rs_stream;		/* read-ahead stream; NULL for bitmap scans */
 	bool		rs_syncscan;	/* report location to syncscan logic? */
 
 	/* scan current state */
@@ -84,6 +85,14 @@ typedef struct IndexScanDescData
 	bool		xs_hot_dead;	/* T if all members of HOT chain are dead */
 	OffsetNumber xs_next_hot;	/* next member of HOT chain, if any */
 	TransactionId xs_prev_xmax; /* previous HOT chain member's XMAX, if any */
+
+	/*
+	 * An AM that can tell which heap blocks its upcoming index entries point
+	 * to sets xs_stream_next, and index_getnext then reads the heap through
+	 * a read stream.  The callback is passed the IndexScanDesc.
+	 */
+	ReadStreamBlockCallback xs_stream_next;		/* NULL if not supported */
+	ReadStream *xs_stream;		/* heap read-ahead stream, if any */
 } IndexScanDescData;
 
 /* Struct for heap-or-index scans of system tables */
@@ -15,6 +15,7 @@
 #include "access/xlogdefs.h"
 #include "lib/stringinfo.h"
 #include "storage/buf.h"
+#include "storage/relfilenode.h"
 #include "utils/pg_crc.h"
 #include "utils/timestamp.h"
 
@@ -85,6 +86,17 @@ typedef struct XLogRecord
  */
 #define XLR_BKP_REMOVABLE		0x01
 
+/*
+ * Callback used by a resource manager's rm_blockrefs function (see
+ * xlog_internal.h) to report a data block that redo of a record will
+ * modify.  needs_read is false if redo doesn't need the old contents of the
+ * block, because the record carries a full-page image of it or redo
+ * reinitializes it from scratch.
+ */
+typedef void (*XLogBlockRefCallback) (RelFileNode rnode, ForkNumber forknum,
+									  BlockNumber blkno, bool needs_read,
+									  void *arg);
+
 /* Sync methods */
 #define SYNC_METHOD_FSYNC		0
 #define SYNC_METHOD_FDATASYNC	1
@@ -204,7 +216,8 @@ typedef enum WalLevel
 {
 	WAL_LEVEL_MINIMAL = 0,
 	WAL_LEVEL_ARCHIVE,
-	WAL_LEVEL_HOT_STANDBY
+	WAL_LEVEL_HOT_STANDBY,
+	WAL_LEVEL_LOGICAL
 } WalLevel;
 extern int	wal_level;
 
@@ -220,6 +233,9 @@ extern int	wal_level;
 /* Do we need to WAL-log information required only for Hot Standby? */
 #define XLogStandbyInfoActive() (wal_level >= WAL_LEVEL_HOT_STANDBY)
 
+/* Do we need to WAL-log information required only for logical decoding? */
+#define XLogLogicalInfoActive() (wal_level >= WAL_LEVEL_LOGICAL)
+
 #ifdef WAL_DEBUG
 extern bool XLOG_DEBUG;
 #endif
@@ -257,6 +273,11 @@ typedef struct CheckpointStatsData
 	int			ckpt_segs_added;	/* # of new xlog segments created */
 	int			ckpt_segs_removed;		/* # of xlog segments deleted */
 	int			ckpt_segs_recycled;		/* # of xlog segments recycled */
+
+	/* full-page images logged since the previous checkpoint */
+	uint64		ckpt_fpi_written;	/* # of backup blocks */
+	uint64		ckpt_fpi_bytes; /* bytes of backup block data */
+	uint64		ckpt_fpi_raw_bytes;		/* same, before compression */
 } CheckpointStatsData;
 
 extern CheckpointStatsData CheckpointStats;
@@ -281,6 +302,7 @@ extern void xlog_desc(StringInfo buf, uint8 xl_info, char *rec);
 extern void issue_xlog_fsync(int fd, uint32 log, uint32 seg);
 
 extern bool RecoveryInProgress(void);
+extern bool HotStandbyActive(void);
 extern bool XLogInsertAllowed(void);
 extern void GetXLogReceiptTime(TimestampTz *rtime, bool *fromStream);
 
@@ -298,6 +320,10 @@ extern void XLogPutNextOid(Oid nextOid);
 extern XLogRecPtr GetRedoRecPtr(void);
 extern XLogRecPtr GetInsertRecPtr(void);
 extern XLogRecPtr GetFlushRecPtr(void);
+extern XLogRecPtr GetXLogInsertRecPtr(void);
+extern XLogRecPtr GetXLogReplayRecPtr(void);
+extern void XLogSetReplicationSlotMinimumLSN(XLogRecPtr lsn);
+extern XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 extern void GetNextXidAndEpoch(TransactionId *xid, uint32 *epoch);
 extern TimeLineID GetRecoveryTargetTLI(void);
 
@@ -305,4 +331,14 @@ extern void HandleStartupProcInterrupts(void);
 extern void StartupProcessMain(void);
 extern void WakeupRecovery(void);
 
+/*
+ * Starting/stopping a base backup
+ */
+extern XLogRecPtr do_pg_start_backup(const char *backupidstr, bool fast);
+extern XLogRecPtr do_pg_stop_backup(void);
+extern void do_pg_abort_backup(void);
+
+/* File path names (all relative to $PGDATA) */
+#define BACKUP_LABEL_FILE		"backup_label"
+
 #endif   /* XLOG_H */
@@ -33,6 +33,12 @@
  * XLOG record's CRC, either).  Hence, the amount of block data actually
  * present following the BkpBlock struct is BLCKSZ - hole_length bytes.
  *
+ * If full_page_compression is on, the remaining BLCKSZ - hole_length bytes
+ * are further compressed, and compress_length bytes of compressed data
+ * follow the struct instead.  The compressed data lacks the PGLZ_Header;
+ * its raw size is implied by hole_length.  Pages that don't compress well
+ * are stored uncompressed, with compress_method = BKPBLOCK_COMPRESS_NONE.
+ *
  * Note that we don't attempt to align either the BkpBlock struct or the
  * block's data.  So, the struct must be copied to aligned local storage
  * before use.
@@ -44,10 +50,22 @@ typedef struct BkpBlock
 	BlockNumber block;			/* block number */
 	uint16		hole_offset;	/* number of bytes before "hole" */
 	uint16		hole_length;	/* number of bytes in "hole" */
+	uint16		compress_method;	/* BKPBLOCK_COMPRESS_xxx */
+	uint16		compress_length;	/* number of bytes of compressed data */
 
 	/* ACTUAL BLOCK DATA FOLLOWS AT END OF STRUCT */
 } BkpBlock;
 
+#define BKPBLOCK_COMPRESS_NONE	0	/* stored as is, minus the hole */
+#define BKPBLOCK_COMPRESS_PGLZ	1	/* compressed with pglz_compress */
+
+/* number of bytes of block data following a BkpBlock */
+#define BkpBlockDataLength(bkpb) \
+	((bkpb)->compress_method == BKPBLOCK_COMPRESS_NONE ? \
+	 BLCKSZ - (bkpb)->hole_length : (bkpb)->compress_length)
+
+extern char *RestoreBkpBlockImage(BkpBlock *bkpb, char *blk, char *page);
+
 /*
  * When there is not enough space on current page for whole record, we
  * continue on the next page with continuation record.	(However, the
@@ -71,7 +89,7 @@ typedef struct XLogContRecord
 /*
  * Each page of XLOG file has a header like this:
  */
-#define XLOG_PAGE_MAGIC 0xD065	/* can be used as WAL version indicator */
+#define XLOG_PAGE_MAGIC 0xD06A	/* can be used as WAL version indicator */
 
 typedef struct XLogPageHeaderData
 {
@@ -242,6 +260,14 @@ typedef XLogLongPageHeaderData *XLogLongPageHeader;
  * Method table for resource managers.
  *
  * RmgrTable[] is indexed by RmgrId values (see rmgr.h).
+ *
+ * rm_blockrefs is optional.  It is used to look ahead in the WAL during
+ * recovery, so it can be called on records that are never replayed, and
+ * must cope with any contents that pass the basic record header checks.
+ * It returns true if replaying the record right now would change nothing
+ * but the reported blocks (and free space map and visibility map hints), so
+ * that a redo worker can replay it independently of records for other
+ * blocks; see postmaster/redoworker.c.
  */
 typedef struct RmgrData
 {
@@ -251,10 +277,22 @@ typedef struct RmgrData
 	void		(*rm_startup) (void);
 	void		(*rm_cleanup) (void);
 	bool		(*rm_safe_restartpoint) (void);
+	bool		(*rm_blockrefs) (XLogRecord *rptr,
+									 XLogBlockRefCallback callback, void *arg);
 } RmgrData;
 
 extern const RmgrData RmgrTable[];
 
+/*
+ * Exported for xlogprefetch.c
+ */
+extern bool XLogPrefetchReadPage(XLogRecPtr pageptr, char *buf);
+
+/*
+ * Exported for xlogreader.c
+ */
+extern bool RecordIsValid(XLogRecord *record, XLogRecPtr recptr, int emode);
+
 /*
  * Exported to support xlog switching from bgwriter
  */
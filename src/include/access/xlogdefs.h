@@ -83,22 +83,6 @@ typedef struct XLogRecPtr
  */
 typedef uint32 TimeLineID;
 
-/*
- *	Because O_DIRECT bypasses the kernel buffers, and because we never
- *	read those buffers except during crash recovery, it is a win to use
- *	it in all cases where we sync on each write().	We could allow O_DIRECT
- *	with fsync(), but because skipping the kernel buffer forces writes out
- *	quickly, it seems best just to use it for O_SYNC.  It is hard to imagine
- *	how fsync() could be a win for O_DIRECT compared to O_SYNC and O_DIRECT.
- *	Also, O_DIRECT is never enough to force data to the drives, it merely
- *	tries to bypass the kernel cache, so we still need O_SYNC or fsync().
- */
-#ifdef O_DIRECT
-#define PG_O_DIRECT				O_DIRECT
-#else
-#define PG_O_DIRECT				0
-#endif
-
 /*
  * This chunk of hackery attempts to determine which file sync methods
  * are available on the current platform, and to choose an appropriate
@@ -135,11 +119,16 @@ typedef uint32 TimeLineID;
 
 /*
  * Limitation of buffer-alignment for direct IO depends on OS and filesystem,
- * but XLOG_BLCKSZ is assumed to be enough for it.
+ * but XLOG_BLCKSZ (or ALIGNOF_DIRECT_IO_BUFFER, if larger) is assumed to be
+ * enough for it.
  */
 #ifdef O_DIRECT
+#if XLOG_BLCKSZ > ALIGNOF_DIRECT_IO_BUFFER
 #define ALIGNOF_XLOG_BUFFER		XLOG_BLCKSZ
 #else
+#define ALIGNOF_XLOG_BUFFER		ALIGNOF_DIRECT_IO_BUFFER
+#endif
+#else
 #define ALIGNOF_XLOG_BUFFER		ALIGNOF_BUFFER
 #endif
 
@@ -0,0 +1,22 @@
+/*
+ * xlogprefetch.h
+ *
+ * Prefetching of data blocks referenced by WAL ahead of replay
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ */
+#ifndef XLOGPREFETCH_H
+#define XLOGPREFETCH_H
+
+#include "access/xlogdefs.h"
+
+/* GUC variable */
+extern int	recovery_prefetch_distance;
+
+extern void XLogPrefetchAhead(XLogRecPtr nextRecPtr, XLogRecPtr lastRecPtr);
+extern void XLogPrefetchEnd(void);
+
+#endif   /* XLOGPREFETCH_H */
@@ -0,0 +1,71 @@
+/*
+ * xlogreader.h
+ *
+ * Reading WAL records outside of recovery
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ */
+#ifndef XLOGREADER_H
+#define XLOGREADER_H
+
+#include "access/xlog.h"
+
+typedef struct XLogReaderState XLogReaderState;
+
+/*
+ * Callback to read (part of) the WAL page starting at targetPagePtr into
+ * readBuf.  At least reqLen bytes from the start of the page are needed.
+ * Returns the number of valid bytes read, which may be more than reqLen,
+ * or -1 if that much of the page is not available yet.  Errors should be
+ * thrown with ereport.
+ */
+typedef int (*XLogPageReadCB) (XLogReaderState *state,
+										   XLogRecPtr targetPagePtr,
+										   int reqLen,
+										   char *readBuf,
+										   void *private_data);
+
+struct XLogReaderState
+{
+	/* ----------------------------------------
+	 * Public parameters
+	 * ----------------------------------------
+	 */
+	XLogPageReadCB read_page;	/* page reading callback */
+	void	   *private_data;	/* opaque data for the callback */
+
+	/* ----------------------------------------
+	 * Decoding state, read-only for callers
+	 * ----------------------------------------
+	 */
+	XLogRecPtr	ReadRecPtr;		/* start of last record read */
+	XLogRecPtr	EndRecPtr;		/* end+1 of last record read */
+
+	/* ----------------------------------------
+	 * private members
+	 * ----------------------------------------
+	 */
+
+	/* Current WAL page, and how much of it is valid */
+	char	   *readBuf;
+	XLogRecPtr	readPagePtr;
+	int			readLen;
+
+	/* Buffer for the current record, reassembled if it crosses pages */
+	char	   *readRecordBuf;
+	uint32		readRecordBufSize;
+
+	/* Buffer for the error message of the last failure */
+	char	   *errormsg_buf;
+};
+
+extern XLogReaderState *XLogReaderAllocate(XLogPageReadCB pagereadfunc,
+				   void *private_data);
+extern void XLogReaderFree(XLogReaderState *state);
+extern XLogRecord *XLogReadRecord(XLogReaderState *state, XLogRecPtr RecPtr,
+			   char **errormsg);
+
+#endif   /* XLOGREADER_H */
@@ -18,16 +18,29 @@
 
 typedef enum
 {
-	CheckerProcess,
+	NotAnAuxProcess = -1,
+	CheckerProcess = 0,
 	BootstrapProcess,
 	StartupProcess,
 	BgWriterProcess,
+	CheckpointerProcess,
 	WalWriterProcess,
 	WalReceiverProcess,
+	RedoWorkerProcess,
 
 	NUM_AUXPROCTYPES			/* Must be last! */
 } AuxProcType;
 
+extern AuxProcType MyAuxProcType;
+
+#define AmBootstrapProcess()		(MyAuxProcType == BootstrapProcess)
+#define AmStartupProcess()			(MyAuxProcType == StartupProcess)
+#define AmBackgroundWriterProcess() (MyAuxProcType == BgWriterProcess)
+#define AmCheckpointerProcess()		(MyAuxProcType == CheckpointerProcess)
+#define AmWalWriterProcess()		(MyAuxProcType == WalWriterProcess)
+#define AmWalReceiverProcess()		(MyAuxProcType == WalReceiverProcess)
+#define AmRedoWorkerProcess()		(MyAuxProcType == RedoWorkerProcess)
+
 /*
  * MAXATTR is the maximum number of attributes in a relation supported
  * at bootstrap time (i.e., the max possible in a system table).
@@ -3381,6 +3381,19 @@ DESCR("current xlog flush location");
 DATA(insert OID = 3821 ( pg_last_xlog_replay_location	PGNSP PGUID 12 1 0 0 f f f t f v 0 0 25 "" _null_ _null_ _null_ _null_ pg_last_xlog_replay_location _null_ _null_ _null_ ));
 DESCR("last xlog replay location");
 
+DATA(insert OID = 3539 ( pg_create_physical_replication_slot	PGNSP PGUID 12 1 0 0 f f f t f v 1 0 2278 "19" _null_ _null_ _null_ _null_ pg_create_physical_replication_slot _null_ _null_ _null_ ));
+DESCR("create a physical replication slot");
+DATA(insert OID = 3540 ( pg_create_logical_replication_slot	PGNSP PGUID 12 1 0 0 f f f t f v 2 0 2278 "19 25" _null_ _null_ _null_ _null_ pg_create_logical_replication_slot _null_ _null_ _null_ ));
+DESCR("create a logical replication slot");
+DATA(insert OID = 3541 ( pg_drop_replication_slot	PGNSP PGUID 12 1 0 0 f f f t f v 1 0 2278 "19" _null_ _null_ _null_ _null_ pg_drop_replication_slot _null_ _null_ _null_ ));
+DESCR("drop a replication slot");
+DATA(insert OID = 3542 ( pg_get_replication_slots	PGNSP PGUID 12 1 10 0 f f f f t v 0 0 2249 "" "{19,19,25,26,16,28,28,25,25,20}" "{o,o,o,o,o,o,o,o,o,o}" "{slot_name,plugin,slot_type,datoid,active,xmin,catalog_xmin,restart_lsn,confirmed_flush_lsn,restart_lag}" _null_ pg_get_replication_slots _null_ _null_ _null_ ));
+DESCR("information about replication slots");
+DATA(insert OID = 3543 ( pg_logical_slot_get_changes	PGNSP PGUID 12 1000 1000 0 f f f t t v 1 0 2249 "19" "{19,25,28,25}" "{i,o,o,o}" "{slot_name,location,xid,data}" _null_ pg_logical_slot_get_changes _null_ _null_ _null_ ));
+DESCR("get the changes retained by a logical replication slot, and confirm them");
+DATA(insert OID = 3544 ( pg_logical_slot_peek_changes	PGNSP PGUID 12 1000 1000 0 f f f t t v 1 0 2249 "19" "{19,25,28,25}" "{i,o,o,o}" "{slot_name,location,xid,data}" _null_ pg_logical_slot_peek_changes _null_ _null_ _null_ ));
+DESCR("get the changes retained by a logical replication slot, without confirming them");
+
 DATA(insert OID = 2621 ( pg_reload_conf			PGNSP PGUID 12 1 0 0 f f f t f v 0 0 16 "" _null_ _null_ _null_ _null_ pg_reload_conf _null_ _null_ _null_ ));
 DESCR("reload configuration files");
 DATA(insert OID = 2622 ( pg_rotate_logfile		PGNSP PGUID 12 1 0 0 f f f t f v 0 0 16 "" _null_ _null_ _null_ _null_ pg_rotate_logfile _null_ _null_ _null_ ));
@@ -22,4 +22,6 @@ extern uint64 DoCopy(const CopyStmt *stmt, const char *queryString);
 
 extern DestReceiver *CreateCopyDestReceiver(void);
 
+extern void CopyFromWorker(void);
+
 #endif   /* COPY_H */
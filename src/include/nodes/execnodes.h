@@ -1032,6 +1032,12 @@ typedef struct ModifyTableState
 	int			mt_whichplan;	/* which one is being executed (0..n-1) */
 	EPQState	mt_epqstate;	/* for evaluating EvalPlanQual rechecks */
 	bool		fireBSTriggers; /* do we need to fire stmt triggers? */
+	/* INSERTed rows waiting for heap_multi_insert, if batching them */
+	HeapTuple  *mt_bufferedTuples;	/* NULL if not batching */
+	int			mt_nBufferedTuples;
+	Size		mt_bufferedBytes;	/* total t_len of mt_bufferedTuples */
+	MemoryContext mt_batchContext;	/* holds the buffered tuples */
+	TupleTableSlot *mt_batchSlot;	/* for inserting their index entries */
 } ModifyTableState;
 
 /* ----------------
@@ -164,6 +164,7 @@ typedef struct ModifyTable
 {
 	Plan		plan;
 	CmdType		operation;		/* INSERT, UPDATE, or DELETE */
+	bool		multiInsert;	/* INSERT may insert rows in batches? */
 	List	   *resultRelations;	/* integer list of RT indexes */
 	List	   *plans;			/* plan(s) producing source data */
 	List	   *returningLists; /* per-target-table RETURNING tlists */
@@ -0,0 +1 @@
+/root/repo/src/backend/parser/gram.h
\ No newline at end of file
@@ -100,6 +100,16 @@
  */
 #define ALIGNOF_BUFFER	32
 
+/*
+ * Required alignment of buffers for direct I/O (see the direct_io setting).
+ * O_DIRECT requests must start at a memory address, and span a length, that
+ * is a multiple of the logical sector size of the device, which is at most
+ * 4kB on current hardware.  Shared buffers, local buffers and the WAL
+ * buffers are aligned this way; fd.c copies other requests on O_DIRECT
+ * files through an aligned buffer.
+ */
+#define ALIGNOF_DIRECT_IO_BUFFER	4096
+
 /*
  * Disable UNIX sockets for certain operating systems.
  */
@@ -133,6 +143,16 @@
 #define USE_PREFETCH
 #endif
 
+/*
+ * USE_IO_URING controls whether io_method = io_uring is available, ie,
+ * whether storage/file/aio.c can submit asynchronous I/O through the Linux
+ * io_uring interface.  The kernel headers are enough; a kernel that turns
+ * out not to support it is detected at runtime.
+ */
+#ifdef HAVE_LINUX_IO_URING_H
+#define USE_IO_URING
+#endif
+
 /*
  * This is the default directory in which AF_UNIX socket files are
  * placed.	Caution: changing this risks breaking your existing client
@@ -151,6 +151,11 @@ extern int	pg_strncasecmp(const char *s1, const char *s2, size_t n);
 extern unsigned char pg_toupper(unsigned char ch);
 extern unsigned char pg_tolower(unsigned char ch);
 
+/* Fast search for the first of a few special characters in a buffer */
+#define PG_SCAN_MAX_CHARS	4
+extern const char *pg_scan_chars(const char *start, const char *end,
+			  const char *chars, int nchars, bool stop_at_highbit);
+
 #ifdef USE_REPL_SNPRINTF
 
 /*
@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * copyworker.h
+ *	  Exports from postmaster/copyworker.c.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _COPYWORKER_H
+#define _COPYWORKER_H
+
+/* size of each of the two byte queues between a worker and its leader */
+#define COPY_WORKER_QUEUE_SIZE	65536
+
+/* GUC variables */
+extern int	max_copy_workers;
+
+/* Status inquiry functions */
+extern bool IsCopyWorkerProcess(void);
+
+/* Functions for the COPY leader backend */
+extern int	CopyWorkersLaunch(int nworkers);
+extern bool CopyWorkerSend(int worker, const void *data, Size len,
+			   bool nowait);
+extern void CopyWorkerReceive(int worker, void *data, Size len);
+extern void CopyWorkersFinish(void);
+extern void AtAbort_CopyWorkers(void);
+extern void AtEOSubXact_CopyWorkers(bool isCommit, SubTransactionId mySubid,
+						SubTransactionId parentSubid);
+
+/* Functions for the worker processes */
+extern bool CopyWorkerRead(void *data, Size len);
+extern void CopyWorkerWrite(const void *data, Size len);
+
+/* Functions to start copy workers, called from postmaster */
+extern int	StartCopyWorker(void);
+extern void CopyWorkerForkFailed(void);
+
+#ifdef EXEC_BACKEND
+extern void CopyWorkerMain(int argc, char *argv[]);
+#endif
+
+/* shared memory stuff */
+extern Size CopyWorkerShmemSize(void);
+extern void CopyWorkerShmemInit(void);
+
+#endif   /* _COPYWORKER_H */
@@ -13,6 +13,12 @@
 #ifndef _PGARCH_H
 #define _PGARCH_H
 
+/* upper limit for max_archive_commands */
+#define MAX_ARCHIVE_COMMANDS	64
+
+/* GUC options */
+extern int	max_archive_commands;
+
 /* ----------
  * Functions called from postmaster
  * ----------
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * redoworker.h
+ *	  Exports from postmaster/redoworker.c.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _REDOWORKER_H
+#define _REDOWORKER_H
+
+#include "access/xlog.h"
+
+/* upper limit for recovery_parallel_workers */
+#define MAX_REDO_WORKERS		64
+
+/* size of the record queue of each redo worker */
+#define REDO_WORKER_QUEUE_SIZE	(512 * 1024)
+
+/* GUC variables */
+extern int	recovery_parallel_workers;
+
+/* Functions for the startup process */
+extern bool RedoWorkersStart(void);
+extern bool RedoWorkerDispatch(XLogRecPtr lsn, XLogRecord *record);
+extern void RedoWorkersWaitIdle(void);
+extern void RedoWorkersStop(void);
+
+/* Functions for the worker processes */
+extern void RedoWorkerMain(void);
+extern void RedoWorkerReportInvalidPage(RelFileNode node, ForkNumber forkno,
+							BlockNumber blkno, bool present);
+
+/* shared memory stuff */
+extern Size RedoWorkerShmemSize(void);
+extern void RedoWorkerShmemInit(void);
+
+#endif   /* _REDOWORKER_H */
@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ *
+ * logical.h
+ *	  Decoding WAL into the row changes of committed transactions.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef LOGICAL_H
+#define LOGICAL_H
+
+#include "access/xlogreader.h"
+#include "lib/stringinfo.h"
+#include "replication/output_plugin.h"
+#include "replication/reorderbuffer.h"
+#include "replication/slot.h"
+
+typedef struct LogicalDecodingContext LogicalDecodingContext;
+
+/*
+ * Callback to ship the output the plugin wrote into ctx->out for the change
+ * or transaction boundary at lsn, made by transaction xid.
+ */
+typedef void (*LogicalOutputWriterWrite) (LogicalDecodingContext *ctx,
+													  XLogRecPtr lsn,
+													  TransactionId xid);
+
+struct LogicalDecodingContext
+{
+	/* memory context everything is allocated in */
+	MemoryContext context;
+
+	XLogReaderState *reader;
+	ReorderBuffer *reorder;
+	OutputPluginCallbacks callbacks;
+
+	/*
+	 * Decoding starts at start_lsn.  Transactions with an xid before
+	 * start_xid were possibly already running then, so they are skipped.
+	 */
+	XLogRecPtr	start_lsn;
+	TransactionId start_xid;
+
+	/*
+	 * When decoding for a replication slot: the slot, and the commit
+	 * location up to which transactions were already delivered, so are
+	 * skipped.
+	 */
+	ReplicationSlot *slot;
+	XLogRecPtr	confirmed_flush;
+
+	/*
+	 * A later point the slot can restart decoding at, once the client has
+	 * confirmed the commit at candidate_confirm_lsn, the last one sent
+	 * before the point was found.
+	 */
+	bool		candidate_valid;
+	XLogRecPtr	candidate_restart_lsn;
+	TransactionId candidate_xmin;
+	XLogRecPtr	candidate_confirm_lsn;
+
+	/* commit location of the last transaction sent */
+	XLogRecPtr	last_commit_lsn;
+
+	/*
+	 * While replaying a transaction: did we start a transaction of our own
+	 * for the plugin, and has the plugin's begin callback been called yet?
+	 */
+	bool		own_xact;
+	bool		txn_begun;
+
+	/* output of the plugin, and how to ship it */
+	StringInfo	out;
+	LogicalOutputWriterWrite write;
+
+	/* private data of the output plugin and of the writer */
+	void	   *output_plugin_private;
+	void	   *output_writer_private;
+};
+
+extern LogicalDecodingContext *CreateLogicalDecodingContext(const char *plugin,
+							 ReplicationSlot *slot,
+							 XLogPageReadCB read_page,
+							 LogicalOutputWriterWrite do_write,
+							 void *writer_private);
+extern void FreeLogicalDecodingContext(LogicalDecodingContext *ctx);
+extern void LogicalDecodingRunningXacts(LogicalDecodingContext *ctx,
+							XLogRecPtr lsn, TransactionId oldestRunningXid);
+extern void LogicalConfirmReceivedLocation(LogicalDecodingContext *ctx,
+							   XLogRecPtr lsn);
+
+/* in decode.c */
+extern void DecodeRecordIntoReorderBuffer(LogicalDecodingContext *ctx,
+							  XLogRecord *record);
+
+/* SQL callable functions, in logicalfuncs.c */
+extern Datum pg_logical_slot_get_changes(PG_FUNCTION_ARGS);
+extern Datum pg_logical_slot_peek_changes(PG_FUNCTION_ARGS);
+
+#endif   /* LOGICAL_H */
@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+ *
+ * output_plugin.h
+ *	  Interface for the output plugins of logical decoding.
+ *
+ * An output plugin is a shared library that formats the decoded changes of
+ * committed transactions.  It must define a function
+ *
+ *		void _PG_output_plugin_init(OutputPluginCallbacks *cb)
+ *
+ * that fills in the callbacks.  Each callback writes its output, if any,
+ * into ctx->out, which is sent to the client as one message afterwards.
+ * The begin, change and commit callbacks run inside a transaction, so they
+ * can do catalog lookups.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef OUTPUT_PLUGIN_H
+#define OUTPUT_PLUGIN_H
+
+#include "replication/reorderbuffer.h"
+#include "utils/relcache.h"
+
+struct LogicalDecodingContext;
+
+/* called once when decoding starts; optional */
+typedef void (*LogicalDecodeStartupCB) (struct LogicalDecodingContext *ctx);
+
+/* called at the start of each committed transaction */
+typedef void (*LogicalDecodeBeginCB) (struct LogicalDecodingContext *ctx,
+												  ReorderBufferTXN *txn);
+
+/* called for each change of the transaction, in the order they were made */
+typedef void (*LogicalDecodeChangeCB) (struct LogicalDecodingContext *ctx,
+												   ReorderBufferTXN *txn,
+												   Relation relation,
+												   ReorderBufferChange *change);
+
+/* called at the end of each committed transaction */
+typedef void (*LogicalDecodeCommitCB) (struct LogicalDecodingContext *ctx,
+												   ReorderBufferTXN *txn,
+												   XLogRecPtr commit_lsn);
+
+/* called once when decoding stops; optional */
+typedef void (*LogicalDecodeShutdownCB) (struct LogicalDecodingContext *ctx);
+
+typedef struct OutputPluginCallbacks
+{
+	LogicalDecodeStartupCB startup_cb;
+	LogicalDecodeBeginCB begin_cb;
+	LogicalDecodeChangeCB change_cb;
+	LogicalDecodeCommitCB commit_cb;
+	LogicalDecodeShutdownCB shutdown_cb;
+} OutputPluginCallbacks;
+
+typedef void (*LogicalOutputPluginInit) (OutputPluginCallbacks *cb);
+
+#endif   /* OUTPUT_PLUGIN_H */
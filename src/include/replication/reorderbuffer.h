@@ -0,0 +1,118 @@
+/*-------------------------------------------------------------------------
+ *
+ * reorderbuffer.h
+ *	  Reassembly of the row changes decoded from WAL into transactions.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include "access/htup.h"
+#include "access/xlogdefs.h"
+#include "storage/relfilenode.h"
+#include "utils/hsearch.h"
+#include "utils/timestamp.h"
+
+/* types of the changes we decode */
+typedef enum ReorderBufferChangeType
+{
+	REORDER_BUFFER_CHANGE_INSERT,
+	REORDER_BUFFER_CHANGE_UPDATE,
+	REORDER_BUFFER_CHANGE_DELETE
+} ReorderBufferChangeType;
+
+/*
+ * A single row change.
+ *
+ * newtuple is the inserted row, or the new version of an updated row.
+ * oldtuple identifies the updated or deleted row: its primary key columns,
+ * with all other columns null, or the whole old row if the table has no
+ * primary key.  For an update that didn't change the key, oldtuple is NULL.
+ * Values stored out of line in TOAST tables are not available; they are
+ * left as TOAST pointers in the tuples.
+ */
+typedef struct ReorderBufferChange
+{
+	ReorderBufferChangeType action;
+	XLogRecPtr	lsn;			/* location of the change's WAL record */
+	RelFileNode relnode;		/* relation the change applies to */
+	HeapTuple	oldtuple;
+	HeapTuple	newtuple;
+
+	/* private: next change of the same transaction */
+	struct ReorderBufferChange *next;
+} ReorderBufferChange;
+
+typedef struct ReorderBufferTXN
+{
+	TransactionId xid;
+
+	/* location of the first change of the transaction */
+	XLogRecPtr	first_lsn;
+
+	/* location of the commit record, and the end of it */
+	XLogRecPtr	final_lsn;
+	XLogRecPtr	end_lsn;
+
+	TimestampTz commit_time;
+
+	/*
+	 * private: the changes of this transaction that are in memory, in WAL
+	 * order, and the number of changes in total and in memory.  The older
+	 * ones are in spill_file once there have been too many.
+	 */
+	ReorderBufferChange *changes;
+	ReorderBufferChange *changes_tail;
+	int			nentries;
+	int			nentries_mem;
+	struct BufFile *spill_file;
+} ReorderBufferTXN;
+
+typedef struct ReorderBuffer ReorderBuffer;
+
+/* callbacks used to replay a committed transaction */
+typedef void (*ReorderBufferBeginCB) (ReorderBuffer *rb,
+												  ReorderBufferTXN *txn);
+typedef void (*ReorderBufferApplyChangeCB) (ReorderBuffer *rb,
+														ReorderBufferTXN *txn,
+												 ReorderBufferChange *change);
+typedef void (*ReorderBufferCommitCB) (ReorderBuffer *rb,
+												   ReorderBufferTXN *txn);
+
+struct ReorderBuffer
+{
+	ReorderBufferBeginCB begin;
+	ReorderBufferApplyChangeCB apply_change;
+	ReorderBufferCommitCB commit;
+
+	/* opaque data for the callbacks */
+	void	   *private_data;
+
+	/* private: transactions by xid, and memory for the changes */
+	HTAB	   *by_txn;
+	MemoryContext context;
+};
+
+extern ReorderBuffer *ReorderBufferAllocate(void);
+extern void ReorderBufferFree(ReorderBuffer *rb);
+
+extern ReorderBufferChange *ReorderBufferGetChange(ReorderBuffer *rb);
+extern HeapTuple ReorderBufferGetTuple(ReorderBuffer *rb, Size len);
+extern void ReorderBufferQueueChange(ReorderBuffer *rb, TransactionId xid,
+						 ReorderBufferChange *change);
+extern void ReorderBufferCommit(ReorderBuffer *rb, TransactionId xid,
+					int nsubxacts, TransactionId *subxacts,
+					XLogRecPtr commit_lsn, XLogRecPtr end_lsn,
+					TimestampTz commit_time);
+extern void ReorderBufferAbort(ReorderBuffer *rb, TransactionId xid,
+				   int nsubxacts, TransactionId *subxacts);
+extern void ReorderBufferAbortOld(ReorderBuffer *rb,
+					  TransactionId oldestRunningXid);
+extern ReorderBufferTXN *ReorderBufferGetOldestTXN(ReorderBuffer *rb);
+
+#endif   /* REORDERBUFFER_H */
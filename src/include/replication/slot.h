@@ -0,0 +1,90 @@
+/*-------------------------------------------------------------------------
+ *
+ * slot.h
+ *	  Replication slots: the WAL and xmin a replication consumer still needs.
+ *
+ * Portions Copyright (c) 2010-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SLOT_H
+#define SLOT_H
+
+#include "access/xlogdefs.h"
+#include "fmgr.h"
+#include "storage/spin.h"
+
+/*
+ * The part of a replication slot that is saved on disk.
+ *
+ * restart_lsn is the oldest WAL the consumer might still ask for; WAL from
+ * there on isn't removed.  xmin is the hot standby feedback of a physical
+ * consumer, and catalog_xmin is where a logical consumer's decoding
+ * restarts: transactions older than it are known to have been delivered.
+ * Neither xmin lets VACUUM remove rows that such transactions could see.
+ * confirmed_flush is the commit location up to which a logical consumer
+ * has confirmed receipt of all transactions.
+ */
+typedef struct ReplicationSlotPersistentData
+{
+	NameData	name;
+	Oid			database;		/* InvalidOid for a physical slot */
+	NameData	plugin;			/* output plugin of a logical slot */
+	XLogRecPtr	restart_lsn;
+	TransactionId xmin;
+	TransactionId catalog_xmin;
+	XLogRecPtr	confirmed_flush;
+} ReplicationSlotPersistentData;
+
+/*
+ * Shared memory state of a replication slot.
+ */
+typedef struct ReplicationSlot
+{
+	slock_t		mutex;			/* protects the fields below */
+
+	bool		in_use;			/* does this slot exist? */
+	bool		active;			/* is a walsender using it? */
+	bool		dirty;			/* data changed since it was last saved? */
+
+	ReplicationSlotPersistentData data;
+} ReplicationSlot;
+
+typedef struct ReplicationSlotCtlData
+{
+	ReplicationSlot replication_slots[1];	/* VARIABLE LENGTH ARRAY */
+} ReplicationSlotCtlData;
+
+extern ReplicationSlotCtlData *ReplicationSlotCtl;
+
+/* the slot the current walsender acquired, if any */
+extern ReplicationSlot *MyReplicationSlot;
+
+/* GUC options */
+extern int	max_replication_slots;
+
+extern Size ReplicationSlotsShmemSize(void);
+extern void ReplicationSlotsShmemInit(void);
+
+extern void ReplicationSlotCreate(const char *name, bool logical,
+					  const char *plugin);
+extern void ReplicationSlotDrop(const char *name);
+extern void ReplicationSlotAcquire(const char *name);
+extern void ReplicationSlotRelease(void);
+extern void ReplicationSlotMarkDirty(void);
+
+extern void ReplicationSlotsComputeRequiredXmin(void);
+extern void ReplicationSlotsComputeRequiredLSN(void);
+
+extern void StartupReplicationSlots(void);
+extern void CheckPointReplicationSlots(void);
+
+/* SQL callable functions, in slotfuncs.c */
+extern Datum pg_create_physical_replication_slot(PG_FUNCTION_ARGS);
+extern Datum pg_create_logical_replication_slot(PG_FUNCTION_ARGS);
+extern Datum pg_drop_replication_slot(PG_FUNCTION_ARGS);
+extern Datum pg_get_replication_slots(PG_FUNCTION_ARGS);
+
+#endif   /* SLOT_H */
@@ -13,17 +13,36 @@
 #define _WALSENDER_H
 
 #include "access/xlog.h"
+#include "replication/syncrep.h"
 #include "storage/latch.h"
+#include "storage/shmem.h"
 #include "storage/spin.h"
 
+typedef enum WalSndState
+{
+	WALSNDSTATE_STARTUP = 0,
+	WALSNDSTATE_CATCHUP,
+	WALSNDSTATE_STREAMING
+} WalSndState;
+
 /*
  * Each walsender has a WalSnd struct in shared memory.
  */
 typedef struct WalSnd
 {
 	pid_t		pid;			/* this walsender's process id, or 0 */
+	WalSndState state;			/* this walsender's state */
 	XLogRecPtr	sentPtr;		/* WAL has been sent up to this point */
 
+	/*
+	 * The xlog locations that have been written, flushed, and applied by
+	 * standby-side.  These may be invalid if the standby-side has not offered
+	 * values yet.
+	 */
+	XLogRecPtr	write;
+	XLogRecPtr	flush;
+	XLogRecPtr	apply;
+
 	slock_t		mutex;			/* locks shared variables shown above */
 
 	/*
@@ -31,18 +50,51 @@ typedef struct WalSnd
 	 * to do.
 	 */
 	Latch		latch;
+
+	/*
+	 * The priority order of the standby managed by this WALSender, as listed
+	 * in synchronous_standby_names, or 0 if not-listed.  Protected by
+	 * SyncRepLock.
+	 */
+	int			sync_standby_priority;
 } WalSnd;
 
 /* There is one WalSndCtl struct for the whole database cluster */
 typedef struct
 {
+	/*
+	 * Synchronous replication queues, one for each wait mode, with one or
+	 * more backends waiting for confirmation in LSN order.  Protected by
+	 * SyncRepLock.
+	 */
+	SHM_QUEUE	SyncRepQueue[NUM_SYNC_REP_WAIT_MODE];
+
+	/*
+	 * Current location of the head of the queue for each wait mode; all
+	 * waiters up to this LSN have been released.  Protected by SyncRepLock.
+	 */
+	XLogRecPtr	lsn[NUM_SYNC_REP_WAIT_MODE];
+
+	/*
+	 * Are any sync standbys defined?  Waiting backends can't reload the
+	 * config file safely, so the checkpointer updates this value as needed.
+	 * Protected by SyncRepLock.
+	 */
+	bool		sync_standbys_defined;
+
 	WalSnd		walsnds[1];		/* VARIABLE LENGTH ARRAY */
 } WalSndCtlData;
 
 extern WalSndCtlData *WalSndCtl;
 
+/* My slot in the shared memory array */
+extern WalSnd *MyWalSnd;
+
 /* global state */
 extern bool am_walsender;
+extern bool am_cascading_walsender;
+extern bool am_db_walsender;
+extern volatile sig_atomic_t walsender_shutdown_requested;
 
 /* user-settable parameters */
 extern int	WalSndDelay;
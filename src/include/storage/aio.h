@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Asynchronous block I/O definitions.
+ *
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+#include <sys/uio.h>
+
+/*
+ * Handle of an I/O request started with AioStartRead/AioStartWrite (or
+ * completed synchronously, see AioCompleted).  It stays valid until the
+ * result is collected with AioWait.
+ */
+typedef int AioHandle;
+
+#define InvalidAioHandle	(-1)
+
+/* maximum number of iovecs in a vectored request */
+#define PG_IOV_MAX			32
+
+/* possible values for io_method */
+typedef enum IoMethod
+{
+	IO_METHOD_SYNC,				/* plain read()/write() */
+	IO_METHOD_IO_URING			/* Linux io_uring */
+} IoMethod;
+
+#ifdef USE_IO_URING
+#define DEFAULT_IO_METHOD	IO_METHOD_IO_URING
+#else
+#define DEFAULT_IO_METHOD	IO_METHOD_SYNC
+#endif
+
+/* GUC parameters */
+extern int	io_method;
+extern int	aio_queue_depth;
+
+extern bool AioAvailable(void);
+extern AioHandle AioStartRead(int fd, char *buffer, int amount, off_t offset);
+extern AioHandle AioStartWrite(int fd, char *buffer, int amount, off_t offset);
+extern AioHandle AioStartReadv(int fd, const struct iovec *iov, int iovcnt,
+			  off_t offset);
+extern AioHandle AioStartWritev(int fd, const struct iovec *iov, int iovcnt,
+			   off_t offset);
+extern AioHandle AioCompleted(int result);
+extern void AioSubmit(void);
+extern int	AioWait(AioHandle handle);
+extern void AtAbort_Aio(void);
+
+#endif   /* AIO_H */
@@ -14,6 +14,8 @@
 #ifndef BUF_H
 #define BUF_H
 
+#include "storage/block.h"
+
 /*
  * Buffer identifiers.
  *
@@ -43,4 +45,20 @@ typedef int Buffer;
  */
 typedef struct BufferAccessStrategyData *BufferAccessStrategy;
 
+/*
+ * Read stream objects.
+ *
+ * ReadStream is private to bufmgr.c.  The callback supplies the block
+ * numbers the stream should read ahead: it is called with the block that
+ * was handed out last and returns the next one, or InvalidBlockNumber if
+ * it can't tell yet.  If restart is true, the consumer has gone its own way
+ * and just read prevBlock directly (prevBlock is InvalidBlockNumber at the
+ * start of the scan); the callback should predict the blocks following it.
+ */
+typedef struct ReadStream ReadStream;
+
+typedef BlockNumber (*ReadStreamBlockCallback) (void *callback_private,
+															BlockNumber prevBlock,
+															bool restart);
+
 #endif   /* BUF_H */
@@ -167,8 +167,21 @@ typedef struct sbufdesc
 #define UnlockBufHdr(bufHdr)	SpinLockRelease(&(bufHdr)->buf_hdr_lock)
 
 
+/*
+ * The checkpoint sorts the buffers it has to write by tag (that is, by
+ * tablespace, database, relation, fork and block) in an array of these.
+ * The array lives in shared memory, with room for all of NBuffers, so that
+ * a checkpoint never has to allocate it.
+ */
+typedef struct CkptSortItem
+{
+	BufferTag	tag;
+	int			buf_id;
+} CkptSortItem;
+
 /* in buf_init.c */
 extern PGDLLIMPORT BufferDesc *BufferDescriptors;
+extern CkptSortItem *CkptBufferIds;
 
 /* in localbuf.c */
 extern BufferDesc *LocalBufferDescriptors;
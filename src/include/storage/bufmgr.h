@@ -49,6 +49,10 @@ extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
 extern int	target_prefetch_pages;
+extern int	checkpoint_flush_after;
+
+/* upper limit for checkpoint_flush_after */
+#define WRITEBACK_MAX_PENDING_FLUSHES	256
 
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
@@ -156,6 +160,8 @@ extern PGDLLIMPORT int32 *LocalRefCount;
  */
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 			   BlockNumber blockNum);
+extern void PrefetchBufferWithoutRelcache(RelFileNode rnode,
+							  ForkNumber forkNum, BlockNumber blockNum);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 				   BlockNumber blockNum, ReadBufferMode mode,
@@ -163,6 +169,15 @@ extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 extern Buffer ReadBufferWithoutRelcache(RelFileNode rnode,
 						  ForkNumber forkNum, BlockNumber blockNum,
 						  ReadBufferMode mode, BufferAccessStrategy strategy);
+extern int ReadBufferBatch(Relation reln, ForkNumber forkNum,
+				BlockNumber *blockNums, int nblocks,
+				BufferAccessStrategy strategy, Buffer *buffers);
+extern ReadStream *ReadStreamBegin(Relation reln, ForkNumber forkNum,
+				BufferAccessStrategy strategy,
+				ReadStreamBlockCallback callback, void *callback_private);
+extern Buffer ReadStreamReadBuffer(ReadStream *stream, BlockNumber blockNum);
+extern void ReadStreamReset(ReadStream *stream);
+extern void ReadStreamEnd(ReadStream *stream);
 extern void ReleaseBuffer(Buffer buffer);
 extern void UnlockReleaseBuffer(Buffer buffer);
 extern void MarkBufferDirty(Buffer buffer);
@@ -204,6 +219,7 @@ extern void AbortBufferIO(void);
 
 extern void BufmgrCommit(void);
 extern void BgBufferSync(void);
+extern void CompleteBufferWrites(void);
 
 extern void AtProcExit_LocalBuffers(void);
 
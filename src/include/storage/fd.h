@@ -39,6 +39,9 @@
 #define FD_H
 
 #include <dirent.h>
+#include <fcntl.h>
+
+#include "storage/aio.h"
 
 
 /*
@@ -50,8 +53,25 @@ typedef char *FileName;
 typedef int File;
 
 
-/* GUC parameter */
+/*
+ * O_DIRECT bypasses the kernel's page cache.  Where the platform lacks it,
+ * PG_O_DIRECT is 0 and direct I/O can't be enabled.  Note that O_DIRECT is
+ * never enough to force data to the drives, so we still need fsync() or
+ * O_SYNC for durability.
+ */
+#ifdef O_DIRECT
+#define PG_O_DIRECT				O_DIRECT
+#else
+#define PG_O_DIRECT				0
+#endif
+
+/* bits of the direct_io setting */
+#define DIRECT_IO_DATA			0x01	/* relation data files */
+#define DIRECT_IO_WAL			0x02	/* WAL segments */
+
+/* GUC parameters */
 extern int	max_files_per_process;
+extern int	direct_io;
 
 
 /*
@@ -65,9 +85,19 @@ extern void FileClose(File file);
 extern int	FilePrefetch(File file, off_t offset, int amount);
 extern int	FileRead(File file, char *buffer, int amount);
 extern int	FileWrite(File file, char *buffer, int amount);
+extern AioHandle FileStartRead(File file, char *buffer, int amount,
+			  off_t offset);
+extern AioHandle FileStartWrite(File file, char *buffer, int amount,
+			   off_t offset);
+extern AioHandle FileStartReadv(File file, struct iovec *iov, int iovcnt,
+			   off_t offset);
+extern AioHandle FileStartWritev(File file, struct iovec *iov, int iovcnt,
+				off_t offset);
+extern void FileWriteback(File file, off_t offset, off_t amount);
 extern int	FileSync(File file);
 extern off_t FileSeek(File file, off_t offset, int whence);
 extern int	FileTruncate(File file, off_t offset);
+extern int	FileFallocate(File file, off_t offset, off_t amount);
 extern char *FilePathName(File file);
 
 /* Operations that allow use of regular stdio --- USE WITH CAUTION */
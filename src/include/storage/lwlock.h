@@ -59,7 +59,7 @@ typedef enum LWLockId
 	MultiXactOffsetControlLock,
 	MultiXactMemberControlLock,
 	RelCacheInitLock,
-	BgWriterCommLock,
+	CheckpointerCommLock,
 	TwoPhaseStateLock,
 	TablespaceCreateLock,
 	BtreeVacuumLock,
@@ -70,6 +70,10 @@ typedef enum LWLockId
 	RelationMappingLock,
 	AsyncCtlLock,
 	AsyncQueueLock,
+	RedoExtensionLock,
+	SyncRepLock,
+	ReplicationSlotAllocationLock,
+	ReplicationSlotControlLock,
 	/* Individual lock IDs end here */
 	FirstBufMappingLock,
 	FirstLockMgrLock = FirstBufMappingLock + NUM_BUFFER_PARTITIONS,
@@ -28,7 +28,9 @@ typedef enum
 	PMSIGNAL_ROTATE_LOGFILE,	/* send SIGUSR1 to syslogger to rotate logfile */
 	PMSIGNAL_START_AUTOVAC_LAUNCHER,	/* start an autovacuum launcher */
 	PMSIGNAL_START_AUTOVAC_WORKER,		/* start an autovacuum worker */
+	PMSIGNAL_START_COPY_WORKER, /* start a copy worker */
 	PMSIGNAL_START_WALRECEIVER, /* start a walreceiver */
+	PMSIGNAL_START_REDO_WORKERS,	/* start redo worker processes */
 
 	NUM_PMSIGNALS				/* Must be last value of enum! */
 } PMSignalReason;
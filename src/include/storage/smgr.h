@@ -17,6 +17,7 @@
 #include "access/xlog.h"
 #include "fmgr.h"
 #include "storage/backendid.h"
+#include "storage/aio.h"
 #include "storage/block.h"
 #include "storage/relfilenode.h"
 
@@ -84,12 +85,41 @@ extern void smgrdounlink(SMgrRelation reln, ForkNumber forknum,
 			 bool isRedo);
 extern void smgrextend(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void smgrzeroextend(SMgrRelation reln, ForkNumber forknum,
+			   BlockNumber blocknum, int nblocks, bool skipFsync);
 extern void smgrprefetch(SMgrRelation reln, ForkNumber forknum,
 			 BlockNumber blocknum);
 extern void smgrread(SMgrRelation reln, ForkNumber forknum,
 		 BlockNumber blocknum, char *buffer);
 extern void smgrwrite(SMgrRelation reln, ForkNumber forknum,
 		  BlockNumber blocknum, char *buffer, bool skipFsync);
+extern AioHandle smgrstartread(SMgrRelation reln, ForkNumber forknum,
+			  BlockNumber blocknum, char *buffer);
+extern void smgrcompleteread(SMgrRelation reln, ForkNumber forknum,
+				 BlockNumber blocknum, char *buffer, AioHandle handle);
+extern AioHandle smgrstartwrite(SMgrRelation reln, ForkNumber forknum,
+			   BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void smgrcompletewrite(SMgrRelation reln, ForkNumber forknum,
+				  BlockNumber blocknum, bool skipFsync, AioHandle handle);
+extern void smgrreadv(SMgrRelation reln, ForkNumber forknum,
+		  BlockNumber blocknum, char **buffers, int nblocks);
+extern void smgrwritev(SMgrRelation reln, ForkNumber forknum,
+		   BlockNumber blocknum, char **buffers, int nblocks,
+		   bool skipFsync);
+extern int smgrstartreadv(SMgrRelation reln, ForkNumber forknum,
+			   BlockNumber blocknum, char **buffers, int nblocks,
+			   AioHandle *handle);
+extern void smgrcompletereadv(SMgrRelation reln, ForkNumber forknum,
+				  BlockNumber blocknum, char **buffers, int nblocks,
+				  AioHandle handle);
+extern int smgrstartwritev(SMgrRelation reln, ForkNumber forknum,
+				BlockNumber blocknum, char **buffers, int nblocks,
+				bool skipFsync, AioHandle *handle);
+extern void smgrcompletewritev(SMgrRelation reln, ForkNumber forknum,
+				   BlockNumber blocknum, int nblocks, bool skipFsync,
+				   AioHandle handle);
+extern void smgrwriteback(SMgrRelation reln, ForkNumber forknum,
+			  BlockNumber blocknum, BlockNumber nblocks);
 extern BlockNumber smgrnblocks(SMgrRelation reln, ForkNumber forknum);
 extern void smgrtruncate(SMgrRelation reln, ForkNumber forknum,
 			 BlockNumber nblocks);
@@ -109,12 +139,32 @@ extern bool mdexists(SMgrRelation reln, ForkNumber forknum);
 extern void mdunlink(RelFileNodeBackend rnode, ForkNumber forknum, bool isRedo);
 extern void mdextend(SMgrRelation reln, ForkNumber forknum,
 		 BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, int nblocks, bool skipFsync);
 extern void mdprefetch(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber blocknum);
 extern void mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	   char *buffer);
 extern void mdwrite(SMgrRelation reln, ForkNumber forknum,
 		BlockNumber blocknum, char *buffer, bool skipFsync);
+extern void mdreadv(SMgrRelation reln, ForkNumber forknum,
+		BlockNumber blocknum, char **buffers, int nblocks);
+extern void mdwritev(SMgrRelation reln, ForkNumber forknum,
+		 BlockNumber blocknum, char **buffers, int nblocks, bool skipFsync);
+extern int mdstartreadv(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, char **buffers, int nblocks,
+			 AioHandle *handle);
+extern void mdcompletereadv(SMgrRelation reln, ForkNumber forknum,
+				BlockNumber blocknum, char **buffers, int nblocks,
+				AioHandle handle);
+extern int mdstartwritev(SMgrRelation reln, ForkNumber forknum,
+			  BlockNumber blocknum, char **buffers, int nblocks,
+			  bool skipFsync, AioHandle *handle);
+extern void mdcompletewritev(SMgrRelation reln, ForkNumber forknum,
+				 BlockNumber blocknum, int nblocks, bool skipFsync,
+				 AioHandle handle);
+extern void mdwriteback(SMgrRelation reln, ForkNumber forknum,
+			BlockNumber blocknum, BlockNumber nblocks);
 extern BlockNumber mdnblocks(SMgrRelation reln, ForkNumber forknum);
 extern void mdtruncate(SMgrRelation reln, ForkNumber forknum,
 		   BlockNumber nblocks);
@@ -0,0 +1 @@
+../../../src/backend/utils/mb/encnames.c
\ No newline at end of file
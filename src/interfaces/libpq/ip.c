@@ -0,0 +1 @@
+../../../src/backend/libpq/ip.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../../src/port/noblock.c
\ No newline at end of file
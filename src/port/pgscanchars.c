@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------------
+ *
+ * pgscanchars.c
+ *	  Fast search for special characters in a buffer.
+ *
+ * COPY FROM spends much of its time looking for the handful of characters
+ * that mean something to it (newlines, delimiters, quotes, backslashes) in
+ * long runs of plain data.  pg_scan_chars() finds the first such character,
+ * examining 16 bytes at a time with SSE2 or 32 bytes at a time with AVX2
+ * when the compiler targets those instruction sets, and one byte at a time
+ * otherwise.  There is no run-time CPU detection: AVX2 is only used if the
+ * whole build is compiled for it (e.g. CFLAGS=-mavx2), while SSE2 is part
+ * of the baseline of every x86-64 compiler.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define USE_AVX2_SCAN
+#elif defined(__SSE2__) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define USE_SSE2_SCAN
+#endif
+
+
+#if defined(USE_AVX2_SCAN) || defined(USE_SSE2_SCAN)
+/*
+ * Position of the lowest set bit in a nonzero mask.
+ */
+static int
+lowest_bit_pos(uint32 mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	int			pos = 0;
+
+	while ((mask & 1) == 0)
+	{
+		mask >>= 1;
+		pos++;
+	}
+	return pos;
+#endif
+}
+#endif
+
+/*
+ * pg_scan_chars
+ *
+ * Return a pointer to the first byte in [start, end) that equals one of
+ * chars[0 .. nchars-1], or that has its high bit set if stop_at_highbit is
+ * true.  Returns end if there is no such byte.  nchars must be between 1
+ * and PG_SCAN_MAX_CHARS; duplicates in chars[] are harmless.
+ */
+const char *
+pg_scan_chars(const char *start, const char *end,
+			  const char *chars, int nchars, bool stop_at_highbit)
+{
+	const char *p = start;
+	char		c0,
+				c1,
+				c2,
+				c3;
+
+	/* unused slots repeat the first character, so they never add hits */
+	c0 = chars[0];
+	c1 = (nchars > 1) ? chars[1] : c0;
+	c2 = (nchars > 2) ? chars[2] : c0;
+	c3 = (nchars > 3) ? chars[3] : c0;
+
+#if defined(USE_AVX2_SCAN)
+	{
+		const __m256i v0 = _mm256_set1_epi8(c0);
+		const __m256i v1 = _mm256_set1_epi8(c1);
+		const __m256i v2 = _mm256_set1_epi8(c2);
+		const __m256i v3 = _mm256_set1_epi8(c3);
+
+		while (end - p >= 32)
+		{
+			__m256i		chunk = _mm256_loadu_si256((const __m256i *) p);
+			__m256i		hits;
+			uint32		mask;
+
+			hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, v0),
+												   _mm256_cmpeq_epi8(chunk, v1)),
+								   _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v2),
+												   _mm256_cmpeq_epi8(chunk, v3)));
+			mask = (uint32) _mm256_movemask_epi8(hits);
+			if (stop_at_highbit)
+				mask |= (uint32) _mm256_movemask_epi8(chunk);
+			if (mask != 0)
+				return p + lowest_bit_pos(mask);
+			p += 32;
+		}
+	}
+#endif
+
+#if defined(USE_AVX2_SCAN) || defined(USE_SSE2_SCAN)
+	{
+		const __m128i v0 = _mm_set1_epi8(c0);
+		const __m128i v1 = _mm_set1_epi8(c1);
+		const __m128i v2 = _mm_set1_epi8(c2);
+		const __m128i v3 = _mm_set1_epi8(c3);
+
+		while (end - p >= 16)
+		{
+			__m128i		chunk = _mm_loadu_si128((const __m128i *) p);
+			__m128i		hits;
+			uint32		mask;
+
+			hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v0),
+											 _mm_cmpeq_epi8(chunk, v1)),
+								_mm_or_si128(_mm_cmpeq_epi8(chunk, v2),
+											 _mm_cmpeq_epi8(chunk, v3)));
+			mask = (uint32) _mm_movemask_epi8(hits);
+			if (stop_at_highbit)
+				mask |= (uint32) _mm_movemask_epi8(chunk);
+			if (mask != 0)
+				return p + lowest_bit_pos(mask);
+			p += 16;
+		}
+	}
+#endif
+
+	/* scalar fallback, and the tail left over by the vector loops */
+	for (; p < end; p++)
+	{
+		char		c = *p;
+
+		if (c == c0 || c == c1 || c == c2 || c == c3)
+			break;
+		if (stop_at_highbit && IS_HIGHBIT_SET(c))
+			break;
+	}
+
+	return p;
+}
@@ -167,3 +167,104 @@ COPY testeoc TO stdout CSV;
 DROP TABLE x, y;
 DROP FUNCTION fn_x_before();
 DROP FUNCTION fn_x_after();
+
+-- parallel COPY FROM.  The results must be the same whether or not copy
+-- workers could be started.
+CREATE TEMP TABLE par (a int, b text, c numeric);
+
+COPY par FROM stdin (PARALLEL 2);
+1	one	1.5
+2	two	\N
+3	three	3.25
+\.
+
+COPY par FROM stdin (FORMAT csv, PARALLEL 2);
+4,"four, quoted",4
+5,"five ""5""",
+\.
+
+SELECT * FROM par ORDER BY a;
+
+-- errors from a worker report the right line
+COPY par FROM stdin (PARALLEL 2);
+6	six	6
+7	seven	7
+eight	8	8
+9	nine	9
+\.
+
+-- a line too long for the workers' queue is parsed by the leader
+\copy (SELECT i, CASE WHEN i = 11 THEN repeat('x', 70000) ELSE 'short' END, i FROM generate_series(10, 12) i) TO 'results/copy2_long.data'
+\copy par FROM 'results/copy2_long.data' (PARALLEL 2)
+
+SELECT a, length(b), c FROM par WHERE a >= 6 ORDER BY a;
+
+-- columns of these types are parsed by the leader
+CREATE DOMAIN par_pos AS int CHECK (VALUE > 0);
+CREATE TEMP TABLE par_dom (a par_pos, b text);
+
+COPY par_dom FROM stdin (PARALLEL 2);
+1	one
+2	two
+\.
+
+COPY par_dom FROM stdin (PARALLEL 2);
+3	three
+-4	minus four
+\.
+
+SELECT * FROM par_dom ORDER BY a;
+
+CREATE TEMP TABLE par_row (x int);
+CREATE TEMP TABLE par_misc (r regclass, c par_row);
+
+BEGIN;
+CREATE TEMP TABLE par_new ();
+ALTER TABLE par_row ADD COLUMN y text;
+COPY par_misc FROM stdin (PARALLEL 2);
+par_new	(1,one)
+par_row	(2,two)
+\.
+SELECT * FROM par_misc ORDER BY c;
+COMMIT;
+
+-- an exception block in a trigger doesn't take the workers away
+CREATE FUNCTION par_trig() RETURNS trigger AS $$
+BEGIN
+	BEGIN
+		NEW.c := 1 / NEW.c;
+	EXCEPTION WHEN division_by_zero THEN
+		NEW.c := -1;
+	END;
+	RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+CREATE TRIGGER par_trig BEFORE INSERT ON par
+FOR EACH ROW EXECUTE PROCEDURE par_trig();
+
+DELETE FROM par;
+COPY par FROM stdin (PARALLEL 2);
+1	one	0
+2	two	2
+3	three	0
+4	four	4
+\.
+
+SELECT * FROM par ORDER BY a;
+
+DROP TABLE par, par_dom, par_misc, par_row;
+DROP DOMAIN par_pos;
+DROP FUNCTION par_trig();
+
+-- rows are inserted in batches; an error found when a batch is flushed
+-- still reports the line it came from
+CREATE TEMP TABLE copybatch (a int PRIMARY KEY, b text);
+COPY copybatch FROM stdin;
+1	one
+2	two
+3	three
+2	again
+4	four
+\.
+SELECT count(*) FROM copybatch;
+DROP TABLE copybatch;
@@ -90,6 +90,49 @@ CREATE INDEX ggpolygonind ON gpolygon_tbl USING gist (f1);
 
 CREATE INDEX ggcircleind ON gcircle_tbl USING gist (f1);
 
+-- test the buffering build options.  The build only switches to buffering
+-- mode after 4096 tuples, and only pages above the leaf level's parents get
+-- buffers, so the tree must be at least three levels deep by then.  The low
+-- fillfactor makes it that deep, and the small maintenance_work_mem makes
+-- the buffers small enough that they are emptied while the build goes on,
+-- not only at the end.
+CREATE TEMP TABLE gpoint_tbl AS
+    SELECT point(x, y) AS f1
+    FROM generate_series(1, 150) x, generate_series(1, 150) y;
+
+SET maintenance_work_mem = '1MB';
+CREATE INDEX gpointind_buf ON gpoint_tbl USING gist (f1)
+    WITH (buffering = on, fillfactor = 10);
+RESET maintenance_work_mem;
+
+SET enable_seqscan = OFF;
+SET enable_indexscan = ON;
+SET enable_bitmapscan = OFF;
+
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ box '(10,10,30,40)';
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ box '(10,10,30,40)';
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ box '(0,0,100,100)';
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ circle '<(50,50),10>';
+
+SET enable_seqscan = ON;
+SET enable_indexscan = OFF;
+
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ box '(10,10,30,40)';
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ box '(0,0,100,100)';
+SELECT count(*) FROM gpoint_tbl WHERE f1 <@ circle '<(50,50),10>';
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+
+DROP INDEX gpointind_buf;
+
+CREATE INDEX ggpolygonind_buf ON gpolygon_tbl USING gist (f1) WITH (buffering = off);
+DROP INDEX ggpolygonind_buf;
+
+CREATE INDEX ggpolygonind_buf ON gpolygon_tbl USING gist (f1) WITH (buffering = invalid_value);
+
 SET enable_seqscan = ON;
 SET enable_indexscan = OFF;
 SET enable_bitmapscan = OFF;
@@ -284,6 +327,49 @@ RESET enable_seqscan;
 RESET enable_indexscan;
 RESET enable_bitmapscan;
 
+-- Build a GIN index bigger than maintenance_work_mem, so that the build
+-- sorts the entries in several runs and merges them.  There are keys in
+-- every row, in every tenth row and in every thousandth row, so some get
+-- posting lists and some posting trees, and most span several runs.
+CREATE TEMP TABLE gin_sort_tbl AS
+    SELECT g AS id, ARRAY[g, -(g % 10) - 1, g % 1000 + 200000] AS a
+    FROM generate_series(1, 100000) g;
+
+SET maintenance_work_mem = '1MB';
+CREATE INDEX gin_sort_idx ON gin_sort_tbl USING gin (a);
+RESET maintenance_work_mem;
+
+SET enable_seqscan = OFF;
+SET enable_indexscan = OFF;
+SET enable_bitmapscan = ON;
+
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-3}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-3}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{200007}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{54321}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-1,200000}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-2,200000}';
+SELECT count(*) FROM gin_sort_tbl WHERE a && '{5,99999,200999}';
+SELECT count(*) FROM gin_sort_tbl WHERE a && '{-1,-2,-3,-4,-5,-6,-7,-8,-9,-10}';
+
+SET enable_seqscan = ON;
+SET enable_bitmapscan = OFF;
+
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-3}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{200007}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{54321}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-1,200000}';
+SELECT count(*) FROM gin_sort_tbl WHERE a @> '{-2,200000}';
+SELECT count(*) FROM gin_sort_tbl WHERE a && '{5,99999,200999}';
+SELECT count(*) FROM gin_sort_tbl WHERE a && '{-1,-2,-3,-4,-5,-6,-7,-8,-9,-10}';
+
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_bitmapscan;
+
+DROP TABLE gin_sort_tbl;
+
 --
 -- HASH
 --
@@ -29,3 +29,66 @@ insert into inserttest values(10, 20, '40'), (-1, 2, DEFAULT),
 select * from inserttest;
 
 drop table inserttest;
+
+--
+-- INSERT ... SELECT and multi-row VALUES insert their rows in batches,
+-- unless something could see the rows inserted so far
+--
+create table inserttest_batch (id int4 primary key, payload text);
+
+-- a duplicate key within one batch fails the whole statement
+insert into inserttest_batch select g % 10, 'x' from generate_series(1, 20) g;
+select count(*) from inserttest_batch;
+
+-- AFTER ROW triggers fire for every row, across several batches
+create table inserttest_log (id int4);
+create function inserttest_log_row() returns trigger language plpgsql as $$
+begin
+    insert into inserttest_log values (new.id);
+    return null;
+end$$;
+create trigger inserttest_after after insert on inserttest_batch
+    for each row execute procedure inserttest_log_row();
+
+insert into inserttest_batch select g, 'x' from generate_series(1, 2500) g;
+select count(*), min(id), max(id) from inserttest_batch;
+select count(*), count(distinct id), min(id), max(id) from inserttest_log;
+set enable_seqscan = off;
+select count(*) from inserttest_batch where id between 998 and 1003;
+reset enable_seqscan;
+
+-- wide rows fill a batch before it has its maximum number of rows
+truncate inserttest_batch, inserttest_log;
+insert into inserttest_batch select g, repeat('x', 1000) from generate_series(1, 200) g;
+select count(*), sum(length(payload)) from inserttest_batch;
+select count(*), count(distinct id) from inserttest_log;
+drop trigger inserttest_after on inserttest_batch;
+
+-- a BEFORE ROW trigger sees the rows inserted before its own
+truncate inserttest_batch;
+create function inserttest_count_rows() returns trigger language plpgsql as $$
+begin
+    new.payload := (select count(*) from inserttest_batch)::text;
+    return new;
+end$$;
+create trigger inserttest_before before insert on inserttest_batch
+    for each row execute procedure inserttest_count_rows();
+
+insert into inserttest_batch select g, null::text from generate_series(1, 5) g;
+select * from inserttest_batch order by id;
+drop trigger inserttest_before on inserttest_batch;
+
+-- and so does a volatile default
+truncate inserttest_batch;
+create function inserttest_next_id() returns int4 language sql volatile as
+    'select coalesce(max(id), 0) + 1 from inserttest_batch';
+alter table inserttest_batch alter column id set default inserttest_next_id();
+
+insert into inserttest_batch (payload) select g::text from generate_series(1, 5) g;
+select * from inserttest_batch order by id;
+
+drop table inserttest_batch;
+drop table inserttest_log;
+drop function inserttest_log_row();
+drop function inserttest_count_rows();
+drop function inserttest_next_id();
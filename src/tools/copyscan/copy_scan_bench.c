@@ -0,0 +1,458 @@
+/*
+ * $PostgreSQL$
+ *
+ *
+ *	copy_scan_bench.c
+ *		measure the COPY FROM line and field scanning loops
+ *
+ * This splits text-format (TSV) or CSV data into lines and fields the way
+ * CopyReadLineText and CopyReadAttributesText/CSV do, once stepping over
+ * the input a byte at a time and once skipping plain runs with
+ * pg_scan_chars(), and reports the throughput of each.  Both passes must
+ * agree on the number of lines, fields and de-escaped bytes.
+ */
+
+#include "postgres_fe.h"
+
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "getopt_long.h"
+
+
+#define SAMPLE_ROWS		500000
+
+#define LABEL_FORMAT	"\t%-30s"
+
+typedef struct ScanResult
+{
+	long		lines;
+	long		fields;
+	long		outbytes;
+} ScanResult;
+
+static int	loops = 5;
+static char delimc = '\0';
+
+static void die(const char *str);
+static char *read_file(const char *filename, size_t *len);
+static char *make_sample(bool csv, size_t *len);
+static void run_test(const char *label, const char *data, size_t len,
+		 bool csv);
+static void scan_text(const char *data, size_t len, char *outbuf,
+		  bool vectorized, ScanResult *result);
+static void scan_csv(const char *data, size_t len, char *outbuf,
+		 bool vectorized, ScanResult *result);
+
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"csv", no_argument, NULL, 'c'},
+		{"delimiter", required_argument, NULL, 'd'},
+		{"loops", required_argument, NULL, 'l'},
+		{NULL, 0, NULL, 0}
+	};
+	bool		csv = false;
+	int			c;
+	int			optindex;
+
+	while ((c = getopt_long(argc, argv, "cd:l:", long_options,
+							&optindex)) != -1)
+	{
+		switch (c)
+		{
+			case 'c':
+				csv = true;
+				break;
+			case 'd':
+				if (strlen(optarg) != 1)
+					die("delimiter must be a single character");
+				delimc = optarg[0];
+				break;
+			case 'l':
+				loops = atoi(optarg);
+				if (loops <= 0)
+					die("loops must be positive");
+				break;
+			default:
+				fprintf(stderr,
+						"Usage: %s [-c|--csv] [-d delimiter] [-l loops] [file ...]\n",
+						argv[0]);
+				exit(1);
+		}
+	}
+
+	printf("Loops = %d\n\n", loops);
+
+	if (optind < argc)
+	{
+		for (; optind < argc; optind++)
+		{
+			size_t		len;
+			char	   *data = read_file(argv[optind], &len);
+
+			run_test(argv[optind], data, len, csv);
+			free(data);
+		}
+	}
+	else
+	{
+		size_t		len;
+		char	   *data;
+
+		data = make_sample(false, &len);
+		run_test("generated TSV", data, len, false);
+		free(data);
+
+		data = make_sample(true, &len);
+		run_test("generated CSV", data, len, true);
+		free(data);
+	}
+
+	return 0;
+}
+
+static void
+die(const char *str)
+{
+	fprintf(stderr, "%s\n", str);
+	exit(1);
+}
+
+static char *
+read_file(const char *filename, size_t *len)
+{
+	struct stat st;
+	char	   *data;
+	size_t		done = 0;
+	int			fd;
+
+	if ((fd = open(filename, O_RDONLY | PG_BINARY, 0)) == -1 ||
+		fstat(fd, &st) != 0)
+		die("Cannot open input file.");
+	data = malloc(st.st_size + 1);
+	if (data == NULL)
+		die("out of memory");
+	while (done < (size_t) st.st_size)
+	{
+		ssize_t		n = read(fd, data + done, st.st_size - done);
+
+		if (n <= 0)
+			die("read failed");
+		done += n;
+	}
+	close(fd);
+	*len = done;
+	return data;
+}
+
+/*
+ * Build sample data resembling a typical fact table: a few integers, a
+ * timestamp, some short and some longer text columns, with an occasional
+ * escaped or quoted value.
+ */
+static char *
+make_sample(bool csv, size_t *len)
+{
+	static const char *words[] = {
+		"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+		"hotel", "india", "juliet", "kilo", "lima", "mike", "november"
+	};
+	char		delim = delimc ? delimc : (csv ? ',' : '\t');
+	size_t		size = (size_t) SAMPLE_ROWS * 200;
+	char	   *data = malloc(size);
+	size_t		pos = 0;
+	int			i;
+
+	if (data == NULL)
+		die("out of memory");
+
+	srandom(42);
+	for (i = 0; i < SAMPLE_ROWS; i++)
+	{
+		const char *w1 = words[random() % lengthof(words)];
+		const char *w2 = words[random() % lengthof(words)];
+		const char *w3 = words[random() % lengthof(words)];
+		int			n;
+
+		if (csv && i % 10 == 0)
+			n = snprintf(data + pos, size - pos,
+						 "%d%c%ld%c2010-11-%02d 12:%02d:00%c%s%c\"%s, \"\"%s\"\" and %s\"\n",
+						 i, delim, random() % 100000, delim,
+						 i % 28 + 1, i % 60, delim, w1, delim, w1, w2, w3);
+		else if (!csv && i % 10 == 0)
+			n = snprintf(data + pos, size - pos,
+						 "%d%c%ld%c2010-11-%02d 12:%02d:00%c%s%c%s\\t%s\\\\%s\n",
+						 i, delim, random() % 100000, delim,
+						 i % 28 + 1, i % 60, delim, w1, delim, w1, w2, w3);
+		else
+			n = snprintf(data + pos, size - pos,
+						 "%d%c%ld%c2010-11-%02d 12:%02d:00%c%s%c%s %s %s %s %s\n",
+						 i, delim, random() % 100000, delim,
+						 i % 28 + 1, i % 60, delim, w1, delim,
+						 w2, w3, w1, w2, w3);
+		if (n < 0 || (size_t) n >= size - pos)
+			die("sample buffer too small");
+		pos += n;
+	}
+
+	*len = pos;
+	return data;
+}
+
+static double
+elapsed_sec(struct timeval start_t, struct timeval stop_t)
+{
+	return (stop_t.tv_sec - start_t.tv_sec) +
+		(stop_t.tv_usec - start_t.tv_usec) / 1000000.0;
+}
+
+static void
+run_test(const char *label, const char *data, size_t len, bool csv)
+{
+	char	   *outbuf = malloc(len + 1);
+	ScanResult	bytewise;
+	ScanResult	vectorized;
+	struct timeval start_t;
+	struct timeval stop_t;
+	double		mb = (double) len * loops / (1024.0 * 1024.0);
+	int			i;
+
+	if (outbuf == NULL)
+		die("out of memory");
+
+	printf("%s (%s, %lu bytes):\n", label, csv ? "CSV" : "text",
+		   (unsigned long) len);
+
+	gettimeofday(&start_t, NULL);
+	for (i = 0; i < loops; i++)
+	{
+		if (csv)
+			scan_csv(data, len, outbuf, false, &bytewise);
+		else
+			scan_text(data, len, outbuf, false, &bytewise);
+	}
+	gettimeofday(&stop_t, NULL);
+	printf(LABEL_FORMAT, "byte at a time");
+	printf("%9.1f MB/s\n", mb / elapsed_sec(start_t, stop_t));
+
+	gettimeofday(&start_t, NULL);
+	for (i = 0; i < loops; i++)
+	{
+		if (csv)
+			scan_csv(data, len, outbuf, true, &vectorized);
+		else
+			scan_text(data, len, outbuf, true, &vectorized);
+	}
+	gettimeofday(&stop_t, NULL);
+	printf(LABEL_FORMAT, "pg_scan_chars");
+	printf("%9.1f MB/s\n", mb / elapsed_sec(start_t, stop_t));
+
+	if (bytewise.lines != vectorized.lines ||
+		bytewise.fields != vectorized.fields ||
+		bytewise.outbytes != vectorized.outbytes)
+		die("results of the two scans differ");
+
+	printf(LABEL_FORMAT, "lines/fields/bytes");
+	printf("%ld/%ld/%ld\n\n", bytewise.lines, bytewise.fields,
+		   bytewise.outbytes);
+
+	free(outbuf);
+}
+
+/*
+ * Copy a plain run into *out and return the first special character.
+ */
+static const char *
+copy_run(const char *p, const char *end, char **out,
+		 const char *chars, int nchars)
+{
+	const char *run_end = pg_scan_chars(p, end, chars, nchars, false);
+
+	memcpy(*out, p, run_end - p);
+	*out += run_end - p;
+	return run_end;
+}
+
+/*
+ * Text format: a line ends at an unescaped newline, fields are separated
+ * by the delimiter, and backslash escapes the next character.
+ */
+static void
+scan_text(const char *data, size_t len, char *outbuf, bool vectorized,
+		  ScanResult *result)
+{
+	const char *p = data;
+	const char *end = data + len;
+	char		delim = delimc ? delimc : '\t';
+	char		line_chars[2] = {'\n', '\\'};
+	char		field_chars[2];
+	char	   *out = outbuf;
+
+	field_chars[0] = delim;
+	field_chars[1] = '\\';
+	memset(result, 0, sizeof(ScanResult));
+
+	while (p < end)
+	{
+		const char *line_start = p;
+		const char *line_end;
+
+		/* find end of line, as CopyReadLineText does */
+		for (;;)
+		{
+			if (vectorized)
+				p = pg_scan_chars(p, end, line_chars, 2, false);
+			if (p >= end)
+				break;
+			if (*p == '\n')
+				break;
+			if (*p == '\\' && p + 1 < end)
+				p++;
+			p++;
+		}
+		line_end = p;
+		if (p < end)
+			p++;
+		result->lines++;
+
+		/* split into fields, as CopyReadAttributesText does */
+		for (;;)
+		{
+			const char *q = line_start;
+			bool		found_delim = false;
+
+			for (;;)
+			{
+				if (vectorized)
+					q = copy_run(q, line_end, &out, field_chars, 2);
+				if (q >= line_end)
+					break;
+				if (*q == delim)
+				{
+					q++;
+					found_delim = true;
+					break;
+				}
+				if (*q == '\\' && q + 1 < line_end)
+					q++;
+				*out++ = *q++;
+			}
+			*out++ = '\0';
+			result->fields++;
+			if (!found_delim)
+				break;
+			line_start = q;
+		}
+		result->outbytes += out - outbuf;
+		out = outbuf;
+	}
+}
+
+/*
+ * CSV format: newlines and delimiters inside double quotes are data, and
+ * a doubled quote inside quotes stands for one quote.
+ */
+static void
+scan_csv(const char *data, size_t len, char *outbuf, bool vectorized,
+		 ScanResult *result)
+{
+	const char *p = data;
+	const char *end = data + len;
+	char		delim = delimc ? delimc : ',';
+	char		line_chars[2] = {'\n', '"'};
+	char		unquoted_chars[2];
+	char		quoted_chars[1] = {'"'};
+	char	   *out = outbuf;
+
+	unquoted_chars[0] = delim;
+	unquoted_chars[1] = '"';
+	memset(result, 0, sizeof(ScanResult));
+
+	while (p < end)
+	{
+		const char *line_start = p;
+		const char *line_end;
+		bool		in_quote = false;
+
+		/* find end of line, as CopyReadLineText does */
+		for (;;)
+		{
+			if (vectorized)
+				p = pg_scan_chars(p, end, line_chars, 2, false);
+			if (p >= end)
+				break;
+			if (*p == '\n' && !in_quote)
+				break;
+			if (*p == '"')
+				in_quote = !in_quote;
+			p++;
+		}
+		line_end = p;
+		if (p < end)
+			p++;
+		result->lines++;
+
+		/* split into fields, as CopyReadAttributesCSV does */
+		for (;;)
+		{
+			const char *q = line_start;
+			bool		found_delim = false;
+
+			for (;;)
+			{
+				/* not in quote */
+				for (;;)
+				{
+					if (vectorized)
+						q = copy_run(q, line_end, &out, unquoted_chars, 2);
+					if (q >= line_end)
+						goto endfield;
+					if (*q == delim)
+					{
+						q++;
+						found_delim = true;
+						goto endfield;
+					}
+					if (*q == '"')
+					{
+						q++;
+						break;
+					}
+					*out++ = *q++;
+				}
+				/* in quote */
+				for (;;)
+				{
+					if (vectorized)
+						q = copy_run(q, line_end, &out, quoted_chars, 1);
+					if (q >= line_end)
+						die("unterminated CSV quoted field");
+					if (*q == '"')
+					{
+						q++;
+						if (q < line_end && *q == '"')
+						{
+							*out++ = *q++;
+							continue;
+						}
+						break;
+					}
+					*out++ = *q++;
+				}
+			}
+	endfield:
+			*out++ = '\0';
+			result->fields++;
+			if (!found_delim)
+				break;
+			line_start = q;
+		}
+		result->outbytes += out - outbuf;
+		out = outbuf;
+	}
+}